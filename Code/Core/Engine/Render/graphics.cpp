@@ -285,6 +285,12 @@ block_gpu_fence(GpuFence* fence, FenceValue value)
   fence->already_waiting = false;
 }
 
+void
+signal_on_gpu_fence(GpuFence* fence, FenceValue value, OsEvent* event)
+{
+  HASSERT(fence->d3d12_fence->SetEventOnCompletion(value, event->handle));
+}
+
 CmdQueue
 init_cmd_queue(const GpuDevice* device, CmdQueueType type)
 {
@@ -536,6 +542,48 @@ gpu_linear_alloc(void* allocator, u32 size, u32 alignment)
   return ret;
 }
 
+GpuTlsfAllocator
+init_gpu_tlsf_allocator(AllocHeap heap, u32 size, u32 max_allocs, GpuHeapLocation location)
+{
+  GpuTlsfAllocator ret = {0};
+  ret.physical_memory  = alloc_gpu_physical_memory(size, location);
+  ret.sub_allocator    = init_tlsf_sub_allocator(heap, size, max_allocs);
+
+  return ret;
+}
+
+void
+destroy_gpu_tlsf_allocator(GpuTlsfAllocator* allocator)
+{
+  free_gpu_physical_memory(&allocator->physical_memory);
+  zero_memory(allocator, sizeof(GpuTlsfAllocator));
+}
+
+GpuAllocation
+gpu_tlsf_alloc(void* allocator, u32 size, u32 alignment)
+{
+  GpuTlsfAllocator* self       = (GpuTlsfAllocator*)allocator;
+  SubAllocation     allocation = tlsf_sub_alloc(&self->sub_allocator, size, alignment);
+
+  GpuAllocation ret = {0};
+  fill_gpu_physical_allocation_struct(&ret, self->physical_memory, allocation.offset, size, allocation.metadata);
+
+  return ret;
+}
+
+void
+gpu_tlsf_free(void* allocator, const GpuAllocation& allocation)
+{
+  GpuTlsfAllocator* self = (GpuTlsfAllocator*)allocator;
+  ASSERT_MSG_FATAL(allocation.d3d12_heap == self->physical_memory.d3d12_heap, "Attempted to free a GPU allocation into a TLSF allocator it didn't come from!");
+
+  SubAllocation sub_allocation = {0};
+  sub_allocation.offset        = (u32)allocation.offset;
+  sub_allocation.metadata      = allocation.metadata;
+
+  tlsf_sub_free(&self->sub_allocator, sub_allocation);
+}
+
 static void
 init_gpu_profiler(void)
 {
@@ -2288,14 +2336,14 @@ alloc_gpu_rt_blas(
   prebuild_info.ScratchDataSizeInBytes               = ALIGN_POW2(prebuild_info.ScratchDataSizeInBytes,   D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
   prebuild_info.ResultDataMaxSizeInBytes             = ALIGN_POW2(prebuild_info.ResultDataMaxSizeInBytes, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
 
-  GpuBufferDesc buffer_desc = {};
-  buffer_desc.size          = (u32)prebuild_info.ResultDataMaxSizeInBytes;
-  buffer_desc.is_rt_bvh     = true;
+  // Same size and alignment alloc_gpu_buffer would use, the allocation just needs to stick around
+  u32 buffer_size  = ALIGN_POW2((u32)prebuild_info.ResultDataMaxSizeInBytes, 256);
 
   GpuRtBlas ret;
   ret.desc         = desc;
   ret.scratch_size = (u32)prebuild_info.ScratchDataSizeInBytes;
-  ret.buffer       = alloc_gpu_buffer(g_GpuDevice, heap, buffer_desc, name);
+  ret.allocation   = GPU_HEAP_ALLOC(heap, buffer_size, (u32)KiB(64));
+  ret.buffer       = init_gpu_buffer(ret.allocation, buffer_size, name, true);
   return ret;
 }
 
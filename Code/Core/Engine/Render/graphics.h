@@ -6,6 +6,9 @@
 #include "Core/Foundation/Containers/ring_buffer.h"
 #include "Core/Foundation/Containers/hash_table.h"
 
+#include "Core/Foundation/tlsf_allocator.h"
+#include "Core/Foundation/threading.h"
+
 #include "Core/Foundation/Gpu/gpu.h"
 
 #include "Core/Foundation/math.h"
@@ -57,6 +60,8 @@ void       destroy_gpu_fence(GpuFence* fence);
 bool       is_gpu_fence_complete(GpuFence* fence, FenceValue value);
 FenceValue poll_gpu_fence_value(GpuFence* fence);
 void       block_gpu_fence(GpuFence* fence, FenceValue value);
+// Signals event once the fence reaches value instead of blocking on it (right away if it already has).
+void       signal_on_gpu_fence(GpuFence* fence, FenceValue value, OsEvent* event);
 
 enum CmdQueueType : u8
 {
@@ -205,6 +210,35 @@ reset_gpu_linear_allocator(GpuLinearAllocator* allocator)
   allocator->pos = 0;
 }
 
+GpuAllocation gpu_tlsf_alloc(void* allocator, u32 size, u32 alignment);
+void          gpu_tlsf_free (void* allocator, const GpuAllocation& allocation);
+// General purpose GPU heap allocator, the TLSF metadata lives on the CPU and the node index is stored in the allocation metadata
+struct GpuTlsfAllocator
+{
+  GpuPhysicalMemory physical_memory;
+  TlsfSubAllocator  sub_allocator;
+
+  operator GpuAllocHeap()
+  {
+    GpuAllocHeap ret = {0};
+    ret.alloc_fn     = &gpu_tlsf_alloc;
+    ret.allocator    = this;
+    return ret;
+  }
+
+  operator GpuFreeHeap()
+  {
+    GpuFreeHeap ret = {0};
+    ret.alloc_fn    = &gpu_tlsf_alloc;
+    ret.free_fn     = &gpu_tlsf_free;
+    ret.allocator   = this;
+    return ret;
+  }
+};
+
+GpuTlsfAllocator init_gpu_tlsf_allocator(AllocHeap heap, u32 size, u32 max_allocs, GpuHeapLocation location);
+void destroy_gpu_tlsf_allocator(GpuTlsfAllocator* allocator);
+
 enum GpuTextureUsageFlags
 {
 };
@@ -382,6 +416,8 @@ struct GpuRtBlasDesc
 struct GpuRtBlas
 {
   GpuBuffer     buffer;
+  // Where buffer lives in the heap it came out of, so that it can be freed back into it
+  GpuAllocation allocation;
 
   GpuRtBlasDesc desc;
   u32           scratch_size = 0;
@@ -249,6 +249,13 @@ render_handler_debug_ui(const RenderEntry*, u32)
 
   ImGui::Text("VRAM: %s", gpu_memory_fmt);
 
+  char resident_cpu_fmt[32];
+  char resident_gpu_fmt[32];
+  bytes_to_readable_str(resident_cpu_fmt, sizeof(resident_cpu_fmt), (f64)atomic_load(g_AssetStreamingStats.resident_cpu_bytes));
+  bytes_to_readable_str(resident_gpu_fmt, sizeof(resident_gpu_fmt), (f64)atomic_load(g_AssetStreamingStats.resident_gpu_bytes));
+
+  ImGui::Text("Assets: %s CPU, %s GPU (%llu unloaded)", resident_cpu_fmt, resident_gpu_fmt, atomic_load(g_AssetStreamingStats.evicted_assets));
+
   if (g_GpuDevice->flags & kGpuFlagsEnableDevelopmentStablePower)
   {
     ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "Development GPU Stable Power");
@@ -1218,27 +1218,27 @@ submit_scene(const SwapChain* swap_chain, GpuTexture* back_buffer)
   view_ctx->render_batches     = HEAP_ALLOC(RenderBatch, g_FrameHeap, kMaxRenderBatches);
   view_ctx->render_batch_count = 0;
 
-  u32 sort_key = 0;
+  u16 pass = 0;
   if (g_RenderHandlerState.frame_id == 0)
   {
-    submit_render_entry(view_ctx, kRenderLayerInit, kRenderHandlerUploadBlueNoiseTexture, sort_key++, nullptr);
+    submit_render_entry(view_ctx, kRenderLayerInit, kRenderHandlerUploadBlueNoiseTexture, render_sort_key(pass++), nullptr);
   }
 
   // Submit frame init
-  submit_render_entry(view_ctx, kRenderLayerInit,   kRenderHandlerFrameInit,       sort_key++, nullptr);
-  submit_render_entry(view_ctx, kRenderLayerInit,   kRenderHandlerSceneUpload,     sort_key++, nullptr);
-  submit_render_entry(view_ctx, kRenderLayerInit,   kRenderHandlerBuildTlas,       sort_key++, nullptr);
-  submit_render_entry(view_ctx, kRenderLayerInit,   kRenderHandlerRtDiffuseGiInit, sort_key++, nullptr);
+  submit_render_entry(view_ctx, kRenderLayerInit,   kRenderHandlerFrameInit,       render_sort_key(pass++), nullptr);
+  submit_render_entry(view_ctx, kRenderLayerInit,   kRenderHandlerSceneUpload,     render_sort_key(pass++), nullptr);
+  submit_render_entry(view_ctx, kRenderLayerInit,   kRenderHandlerBuildTlas,       render_sort_key(pass++), nullptr);
+  submit_render_entry(view_ctx, kRenderLayerInit,   kRenderHandlerRtDiffuseGiInit, render_sort_key(pass++), nullptr);
 
-  sort_key = 0;
+  pass = 0;
   if (!g_RenderHandlerState.settings.disable_diffuse_gi)
   {
-    submit_render_entry(view_ctx, kRenderLayerRtDiffuseGi, kRenderHandlerRtDiffuseGiTraceRays,        sort_key++, nullptr);
-    submit_render_entry(view_ctx, kRenderLayerRtDiffuseGi, kRenderHandlerRtDiffuseGiProbeBlend,       sort_key++, nullptr);
+    submit_render_entry(view_ctx, kRenderLayerRtDiffuseGi, kRenderHandlerRtDiffuseGiTraceRays,        render_sort_key(pass++), nullptr);
+    submit_render_entry(view_ctx, kRenderLayerRtDiffuseGi, kRenderHandlerRtDiffuseGiProbeBlend,       render_sort_key(pass++), nullptr);
   }
 
   // Two pass occlusion culling
-  sort_key = 0;
+  pass = 0;
   {
     auto* params_generate_multi_draw_args  = HEAP_ALLOC(GBufferGenerateMultiDrawArgsEntry, g_FrameHeap, 2);
     params_generate_multi_draw_args[0].phase = 0;
@@ -1249,37 +1249,37 @@ submit_scene(const SwapChain* swap_chain, GpuTexture* back_buffer)
     params_gbuffer_opaque[1].should_clear_targets = false;
 
     // Phase one
-    submit_render_entry(view_ctx, kRenderLayerGBuffer, kRenderHandlerGBufferGenerateMultiDrawArgs, sort_key++, params_generate_multi_draw_args + 0);
-    submit_render_entry(view_ctx, kRenderLayerGBuffer, kRenderHandlerGBufferOpaque,                sort_key++, params_gbuffer_opaque           + 0);
+    submit_render_entry(view_ctx, kRenderLayerGBuffer, kRenderHandlerGBufferGenerateMultiDrawArgs, render_sort_key(pass++), params_generate_multi_draw_args + 0);
+    submit_render_entry(view_ctx, kRenderLayerGBuffer, kRenderHandlerGBufferOpaque,                render_sort_key(pass++), params_gbuffer_opaque           + 0);
 
     // Generate HZB
-    submit_render_entry(view_ctx, kRenderLayerGBuffer, kRenderHandlerGenerateHZB,                  sort_key++, nullptr);
+    submit_render_entry(view_ctx, kRenderLayerGBuffer, kRenderHandlerGenerateHZB,                  render_sort_key(pass++), nullptr);
 
     // Phase two
-    submit_render_entry(view_ctx, kRenderLayerGBuffer, kRenderHandlerGBufferGenerateMultiDrawArgs, sort_key++, params_generate_multi_draw_args + 1);
-    submit_render_entry(view_ctx, kRenderLayerGBuffer, kRenderHandlerGBufferOpaque,                sort_key++, params_gbuffer_opaque           + 1);
+    submit_render_entry(view_ctx, kRenderLayerGBuffer, kRenderHandlerGBufferGenerateMultiDrawArgs, render_sort_key(pass++), params_generate_multi_draw_args + 1);
+    submit_render_entry(view_ctx, kRenderLayerGBuffer, kRenderHandlerGBufferOpaque,                render_sort_key(pass++), params_gbuffer_opaque           + 1);
 
     // Generate HZB again
-    submit_render_entry(view_ctx, kRenderLayerGBuffer, kRenderHandlerGenerateHZB,                  sort_key++, nullptr);
+    submit_render_entry(view_ctx, kRenderLayerGBuffer, kRenderHandlerGenerateHZB,                  render_sort_key(pass++), nullptr);
   }
 
-  sort_key = 0;
-  submit_render_entry(view_ctx, kRenderLayerLighting, kRenderHandlerLighting, sort_key++, nullptr);
+  pass = 0;
+  submit_render_entry(view_ctx, kRenderLayerLighting, kRenderHandlerLighting, render_sort_key(pass++), nullptr);
 
-  sort_key = 0;
-  submit_render_entry(view_ctx, kRenderLayerPost,     kRenderHandlerTemporalAA,     sort_key++, nullptr);
-  submit_render_entry(view_ctx, kRenderLayerPost,     kRenderHandlerDoFGenerateCoC, sort_key++, nullptr);
-  submit_render_entry(view_ctx, kRenderLayerPost,     kRenderHandlerDoFBokehBlur,   sort_key++, nullptr);
-  submit_render_entry(view_ctx, kRenderLayerPost,     kRenderHandlerDoFComposite,   sort_key++, nullptr);
-  submit_render_entry(view_ctx, kRenderLayerPost,     kRenderHandlerTonemapping,    sort_key++, nullptr);
+  pass = 0;
+  submit_render_entry(view_ctx, kRenderLayerPost,     kRenderHandlerTemporalAA,     render_sort_key(pass++), nullptr);
+  submit_render_entry(view_ctx, kRenderLayerPost,     kRenderHandlerDoFGenerateCoC, render_sort_key(pass++), nullptr);
+  submit_render_entry(view_ctx, kRenderLayerPost,     kRenderHandlerDoFBokehBlur,   render_sort_key(pass++), nullptr);
+  submit_render_entry(view_ctx, kRenderLayerPost,     kRenderHandlerDoFComposite,   render_sort_key(pass++), nullptr);
+  submit_render_entry(view_ctx, kRenderLayerPost,     kRenderHandlerTonemapping,    render_sort_key(pass++), nullptr);
 
-  sort_key = 0;
+  pass = 0;
   if (g_RenderHandlerState.settings.enabled_debug_draw)
   {
-    submit_render_entry(view_ctx, kRenderLayerDebugDraw, kRenderHandlerIndirectDebugDraw, sort_key++, nullptr);
+    submit_render_entry(view_ctx, kRenderLayerDebugDraw, kRenderHandlerIndirectDebugDraw, render_sort_key(pass++), nullptr);
   }
 
-  sort_key = 0;
+  pass = 0;
   if (g_RenderHandlerState.settings.debug_layer != kRenderDebugDefault)
   {
     switch (g_RenderHandlerState.settings.debug_layer)
@@ -1291,37 +1291,38 @@ submit_scene(const SwapChain* swap_chain, GpuTexture* back_buffer)
       case kRenderDebugHZB1:
       case kRenderDebugHZB2:
       case kRenderDebugHZB3: 
-      case kRenderDebugGiVariance: submit_render_entry(view_ctx, kRenderLayerGBuffer, kRenderHandlerDebugBuffers, U32_MAX, nullptr); break;
+      case kRenderDebugGiVariance: submit_render_entry(view_ctx, kRenderLayerGBuffer, kRenderHandlerDebugBuffers, render_sort_key(kRenderSortPassLast), nullptr); break;
       default: break;
     }
 
-    submit_render_entry(view_ctx, kRenderLayerPost, kRenderHandlerDebugBufferBlit, U32_MAX, nullptr);
+    submit_render_entry(view_ctx, kRenderLayerPost, kRenderHandlerDebugBufferBlit, render_sort_key(kRenderSortPassLast), nullptr);
   }
 
-  sort_key = 0;
-  submit_render_entry(view_ctx, kRenderLayerUI, kRenderHandlerDebugUi, sort_key++, nullptr);
+  pass = 0;
+  submit_render_entry(view_ctx, kRenderLayerUI, kRenderHandlerDebugUi, render_sort_key(pass++), nullptr);
 
-  sort_key = 0;
+  pass = 0;
   {
     BlitEntry* blit = HEAP_ALLOC(BlitEntry, g_FrameHeap, 1);
     blit->back_buffer = back_buffer;
     blit->src         = &g_RenderHandlerState.buffers.tonemapped_buffer;
-    submit_render_entry(view_ctx, kRenderLayerSubmit, kRenderHandlerBackBufferBlit,  sort_key++, blit);
+    submit_render_entry(view_ctx, kRenderLayerSubmit, kRenderHandlerBackBufferBlit,  render_sort_key(pass++), blit);
   }
 
   // Sort the batches/entries
   radix_sort(view_ctx->render_batches, view_ctx->render_batch_count, sizeof(RenderBatch), offsetof(RenderBatch, layer));
+  ParallelDispatch dispatch = get_job_system_parallel_dispatch();
   for (u32 ibatch = 0; ibatch < view_ctx->render_batch_count; ibatch++)
   {
     const RenderBatch* batch = view_ctx->render_batches + ibatch;
-    radix_sort(batch->entries, batch->entry_count, sizeof(RenderEntry), offsetof(RenderEntry, sort_key));
+    radix_sort_u64(batch->entries, batch->entry_count, sizeof(RenderEntry), offsetof(RenderEntry, sort_key), kSortIncreasing, &dispatch);
   }
 
   return view_ctx;
 }
 
 void
-submit_render_entry  (ViewCtx* view_ctx, RenderLayer layer, RenderHandlerId handler, u32 sort_key, void* data)
+submit_render_entry  (ViewCtx* view_ctx, RenderLayer layer, RenderHandlerId handler, u64 sort_key, void* data)
 {
   RenderEntry* entry = HEAP_ALLOC(RenderEntry, g_FrameHeap, 1);
   entry->sort_key = sort_key;
@@ -1417,20 +1418,24 @@ init_unified_geometry_buffer(const GpuDevice* device)
 {
   zero_memory(&g_UnifiedGeometryBuffer, sizeof(g_UnifiedGeometryBuffer));
 
+  // Roughly one allocation per LOD of every model subset
+  static constexpr u32 kMaxGeometryAllocs = 0x20000;
+  static constexpr u32 kMaxBlasAllocs     = 0x8000;
+
   GpuBufferDesc vertex_uber_desc = {0};
   vertex_uber_desc.size = kVertexBufferSize;
 
   g_UnifiedGeometryBuffer.lock              = init_spin_lock();
   g_UnifiedGeometryBuffer.vertex_buffer     = alloc_gpu_buffer_no_heap(device, vertex_uber_desc, kGpuHeapGpuOnly, "Vertex Buffer");
-  g_UnifiedGeometryBuffer.vertex_buffer_pos = 0;
+  g_UnifiedGeometryBuffer.vertex_allocator  = init_tlsf_sub_allocator(g_InitHeap, (u32)(kVertexBufferSize / sizeof(Vertex)), kMaxGeometryAllocs);
 
   GpuBufferDesc index_uber_desc = {0};
   index_uber_desc.size = kIndexBufferSize;
 
-  g_UnifiedGeometryBuffer.index_buffer     = alloc_gpu_buffer_no_heap(device, index_uber_desc, kGpuHeapGpuOnly, "Index Buffer");
-  g_UnifiedGeometryBuffer.index_buffer_pos = 0;
+  g_UnifiedGeometryBuffer.index_buffer      = alloc_gpu_buffer_no_heap(device, index_uber_desc, kGpuHeapGpuOnly, "Index Buffer");
+  g_UnifiedGeometryBuffer.index_allocator   = init_tlsf_sub_allocator(g_InitHeap, (u32)(kIndexBufferSize / sizeof(u16)), kMaxGeometryAllocs);
 
-  g_UnifiedGeometryBuffer.blas_allocator   = init_gpu_linear_allocator(MiB(256), kGpuHeapGpuOnly);
+  g_UnifiedGeometryBuffer.blas_allocator    = init_gpu_tlsf_allocator(g_InitHeap, MiB(256), kMaxBlasAllocs, kGpuHeapGpuOnly);
 }
 
 void
@@ -1438,34 +1443,35 @@ destroy_unified_geometry_buffer()
 {
   free_gpu_buffer(&g_UnifiedGeometryBuffer.vertex_buffer);
   free_gpu_buffer(&g_UnifiedGeometryBuffer.index_buffer);
+  destroy_gpu_tlsf_allocator(&g_UnifiedGeometryBuffer.blas_allocator);
 
   zero_memory(&g_UnifiedGeometryBuffer, sizeof(g_UnifiedGeometryBuffer));
 }
 
-u64
-alloc_uber_vertex(u64 size)
+SubAllocation
+alloc_uber_vertex(u32 vertex_count)
 {
   spin_acquire(&g_UnifiedGeometryBuffer.lock);
   defer { spin_release(&g_UnifiedGeometryBuffer.lock); };
 
-  u64 ret      = g_UnifiedGeometryBuffer.vertex_buffer_pos;
-  u64 capacity = g_UnifiedGeometryBuffer.vertex_buffer.desc.size;
-  ASSERT_MSG_FATAL(ret + size <= capacity, "Failed to allocate %llu bytes from uber vertex buffer which already has %llu/%llu bytes allocated (%f %%). Consider bumping kVertexBufferSize.", size, ret, capacity, ((f64)ret / (f64)capacity * 100.0));
-  g_UnifiedGeometryBuffer.vertex_buffer_pos += size;
-  return ret;
+  const TlsfSubAllocator& allocator = g_UnifiedGeometryBuffer.vertex_allocator;
+
+  Option<SubAllocation> ret = try_tlsf_sub_alloc(&g_UnifiedGeometryBuffer.vertex_allocator, vertex_count, 1);
+  ASSERT_MSG_FATAL(ret, "Failed to allocate %u vertices from uber vertex buffer which already has %u/%u vertices allocated (%f %%, largest free block is %u). Consider bumping kVertexBufferSize.", vertex_count, allocator.used_size, allocator.size, ((f64)allocator.used_size / (f64)allocator.size * 100.0), tlsf_sub_allocator_largest_free_block(allocator));
+  return unwrap(ret);
 }
 
-u64
-alloc_uber_index(u64 size)
+SubAllocation
+alloc_uber_index(u32 index_count)
 {
   spin_acquire(&g_UnifiedGeometryBuffer.lock);
   defer { spin_release(&g_UnifiedGeometryBuffer.lock); };
 
-  u64 ret      = g_UnifiedGeometryBuffer.index_buffer_pos;
-  u64 capacity = g_UnifiedGeometryBuffer.index_buffer.desc.size;
-  ASSERT_MSG_FATAL(ret + size <= capacity, "Failed to allocate %llu bytes from uber index buffer which already has %llu/%llu bytes allocated (%f %%). Consider bumping kIndexBufferSize.", size, ret, capacity, ((f64)ret / (f64)capacity * 100.0));
-  g_UnifiedGeometryBuffer.index_buffer_pos += size;
-  return ret;
+  const TlsfSubAllocator& allocator = g_UnifiedGeometryBuffer.index_allocator;
+
+  Option<SubAllocation> ret = try_tlsf_sub_alloc(&g_UnifiedGeometryBuffer.index_allocator, index_count, 1);
+  ASSERT_MSG_FATAL(ret, "Failed to allocate %u indices from uber index buffer which already has %u/%u indices allocated (%f %%, largest free block is %u). Consider bumping kIndexBufferSize.", index_count, allocator.used_size, allocator.size, ((f64)allocator.used_size / (f64)allocator.size * 100.0), tlsf_sub_allocator_largest_free_block(allocator));
+  return unwrap(ret);
 }
 
 GpuRtBlas
@@ -1486,6 +1492,35 @@ alloc_uber_blas(u32 vertex_start, u32 vertex_count, u32 index_start, u32 index_c
   return alloc_gpu_rt_blas(g_UnifiedGeometryBuffer.blas_allocator, g_UnifiedGeometryBuffer.vertex_buffer, g_UnifiedGeometryBuffer.index_buffer, desc, name);
 }
 
+void
+free_uber_vertex(SubAllocation allocation)
+{
+  spin_acquire(&g_UnifiedGeometryBuffer.lock);
+  defer { spin_release(&g_UnifiedGeometryBuffer.lock); };
+
+  tlsf_sub_free(&g_UnifiedGeometryBuffer.vertex_allocator, allocation);
+}
+
+void
+free_uber_index(SubAllocation allocation)
+{
+  spin_acquire(&g_UnifiedGeometryBuffer.lock);
+  defer { spin_release(&g_UnifiedGeometryBuffer.lock); };
+
+  tlsf_sub_free(&g_UnifiedGeometryBuffer.index_allocator, allocation);
+}
+
+void
+free_uber_blas(GpuRtBlas* blas)
+{
+  spin_acquire(&g_UnifiedGeometryBuffer.lock);
+  defer { spin_release(&g_UnifiedGeometryBuffer.lock); };
+
+  free_gpu_buffer(&blas->buffer);
+  GPU_HEAP_FREE((GpuFreeHeap)g_UnifiedGeometryBuffer.blas_allocator, blas->allocation);
+  zero_struct(blas);
+}
+
 /////////// HELPER GPU FUNCTIONS /////////////
 void
 gpu_clear_render_target(CmdList* cmd, RenderTarget* rtv, const Vec4& clear_color)
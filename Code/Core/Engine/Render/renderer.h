@@ -280,9 +280,32 @@ static const char* kRenderHandlerNames[] =
 static_assert(ARRAY_LENGTH(kRenderHandlerNames) == kRenderHandlerCount, "Mismatched render handler names! Double check you added it correctly here (in the right order)");
 
 
+// Render entries are sorted within their layer by a key packed from, most significant first:
+//   [63:48] pass     - order of the pass within the layer
+//   [47:24] material - keeps entries with the same pipeline state next to each other
+//   [23:0]  depth    - front to back
+static constexpr u16 kRenderSortPassLast     = U16_MAX;
+static constexpr u32 kRenderSortMaterialBits = 24;
+static constexpr u32 kRenderSortDepthBits    = 24;
+
+// depth is [0, 1] with 0 drawn first, anything outside gets clamped
+inline u64
+render_sort_key(u16 pass, u32 material = 0, f32 depth = 0.0f)
+{
+  static constexpr u32 kMaterialMask = (1U << kRenderSortMaterialBits) - 1;
+  static constexpr u32 kDepthMax     = (1U << kRenderSortDepthBits) - 1;
+
+  ASSERT_MSG_FATAL(material <= kMaterialMask, "Material %u doesn't fit in the %u bits of the render sort key!", material, kRenderSortMaterialBits);
+
+  u32 quantized_depth = (u32)(CLAMP(depth, 0.0f, 1.0f) * (f32)kDepthMax);
+  return ((u64)pass << (kRenderSortMaterialBits + kRenderSortDepthBits)) |
+         ((u64)(material & kMaterialMask) << kRenderSortDepthBits) |
+         (u64)quantized_depth;
+}
+
 struct RenderEntry
 {
-  u32             sort_key = 0;
+  u64             sort_key = 0;
   RenderHandlerId handler  = kRenderHandlerFrameInit;
   void*           data     = nullptr;
 };
@@ -314,7 +337,7 @@ struct ViewCtx
   u32          render_batch_count = 0;
 };
 
-void submit_render_entry  (ViewCtx* view_ctx, RenderLayer layer, RenderHandlerId handler, u32 sort_key, void* data);
+void submit_render_entry  (ViewCtx* view_ctx, RenderLayer layer, RenderHandlerId handler, u64 sort_key, void* data);
 void submit_render_entries(ViewCtx* view_ctx, RenderLayer layer, RenderEntry* entries, u32 count);
 
 
@@ -542,14 +565,15 @@ void     render_view_ctx(ViewCtx* view_ctx);
 struct UnifiedGeometryBuffer
 {
   SpinLock  lock;
-  // TODO(Brandon): In the future, we don't really want to linear allocate these buffers.
-  // We want uber buffers, but we want to be able to allocate and free vertices as we need.
   GpuBuffer vertex_buffer;
   GpuBuffer index_buffer;
-  u64       vertex_buffer_pos = 0;
-  u64       index_buffer_pos  = 0;
 
-  GpuLinearAllocator blas_allocator;
+  // Models get unloaded, so the vertex/index ranges come out of TLSF allocators over the two buffers. These count in
+  // vertices/indices and not bytes, Vertex isn't a power of 2 in size.
+  TlsfSubAllocator vertex_allocator;
+  TlsfSubAllocator index_allocator;
+
+  GpuTlsfAllocator blas_allocator;
 };
 
 
@@ -558,9 +582,14 @@ extern UnifiedGeometryBuffer g_UnifiedGeometryBuffer;
 void init_unified_geometry_buffer(const GpuDevice* device);
 void destroy_unified_geometry_buffer();
 
-THREAD_SAFE u64       alloc_uber_vertex(u64 size);
-THREAD_SAFE u64       alloc_uber_index(u64 size);
-THREAD_SAFE GpuRtBlas alloc_uber_blas(u32 vertex_start, u32 vertex_count, u32 index_start, u32 index_count, const char* name);
+// The offsets of the allocations are in vertices/indices
+THREAD_SAFE SubAllocation alloc_uber_vertex(u32 vertex_count);
+THREAD_SAFE SubAllocation alloc_uber_index(u32 index_count);
+THREAD_SAFE GpuRtBlas     alloc_uber_blas(u32 vertex_start, u32 vertex_count, u32 index_start, u32 index_count, const char* name);
+// The GPU can't be using any of these anymore, wait on a fence before freeing them
+THREAD_SAFE void          free_uber_vertex(SubAllocation allocation);
+THREAD_SAFE void          free_uber_index(SubAllocation allocation);
+THREAD_SAFE void          free_uber_blas(GpuRtBlas* blas);
 
 
 
@@ -0,0 +1,79 @@
+#pragma once
+#include "Core/Foundation/types.h"
+#include "Core/Foundation/assets.h"
+
+// The part of an asset the streamer keeps track of, which the load queue and the residency bookkeeping need without
+// any of the GPU side of things.
+
+enum AssetState : u32
+{
+  kAssetUnloaded = 0,
+  // Waiting in the streamer's load queue, the load can still be cancelled or re-prioritised in this state
+  kAssetLoadRequested,
+  kAssetStreaming,
+  kAssetUninitialized,
+  kAssetReady,
+  kAssetFailedToLoad,
+  kAssetFailedToInitialize,
+};
+
+struct Asset
+{
+  AssetId    id                 = kNullAssetId;
+  AssetType  type               = AssetType::kModel;
+  u32        state              = kAssetUnloaded;
+
+  // Only touched by the asset streaming thread. stream_queue_index is 0 while the asset isn't in the load queue and one
+  // past its slot in there while it is.
+  f32        stream_priority    = 0.0f;
+  u32        stream_queue_index = 0;
+
+  // How many handles are holding on to the asset (see acquire_asset/release_asset) and how many times it went from
+  // unused to used. Assets nothing holds on to anymore stay loaded in the streamer's eviction list (lru_next isn't null)
+  // until the residency budget needs their memory back. All of these are guarded by the streamer's residency lock.
+  u32        ref_count          = 0;
+  u32        use_count          = 0;
+  Asset*     lru_prev           = nullptr;
+  Asset*     lru_next           = nullptr;
+
+  // What the asset has allocated for itself, only touched by the asset streaming thread
+  u64        cpu_bytes          = 0;
+  u64        gpu_bytes          = 0;
+};
+
+// Assets get streamed in highest priority first, ties go in the order they were kicked. The priorities that come out of
+// the camera helpers below are all in [0, 1], so explicit ones outside of that range always go before/after them.
+static constexpr f32 kAssetStreamPriorityBackground = 0.0f;
+static constexpr f32 kAssetStreamPriorityCritical   = 2.0f;
+
+// screen_coverage is the fraction of the screen the asset covers
+inline f32
+get_asset_stream_priority_from_coverage(f32 screen_coverage)
+{
+  return CLAMP(screen_coverage, 0.0f, 1.0f);
+}
+
+// 1 right at the camera, 0.5 at 1 meter out, 0.1 at 9 meters out...
+inline f32
+get_asset_stream_priority_from_distance(f32 distance)
+{
+  return 1.0f / (1.0f + MAX(distance, 0.0f));
+}
+
+enum AssetEvictionPolicy : u8
+{
+  // Evicts whatever has gone unused for the longest
+  kAssetEvictionLru,
+  // Evicts whatever has been used the least out of the few that have gone unused for the longest, so that assets that
+  // keep coming back (a hallway the camera keeps going through) stick around over ones that were only seen once.
+  kAssetEvictionFrequencyWeighted,
+};
+
+// Assets that nothing holds on to anymore get unloaded once what's loaded goes over either of these. Assets that are
+// still held on to never get unloaded, so these are soft limits: loads don't wait on them.
+struct AssetResidencyBudget
+{
+  u64                 cpu_bytes = MiB(256);
+  u64                 gpu_bytes = MiB(1536);
+  AssetEvictionPolicy policy    = kAssetEvictionLru;
+};
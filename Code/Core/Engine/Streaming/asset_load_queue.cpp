@@ -0,0 +1,166 @@
+#include "Core/Foundation/threading.h"
+
+#include "Core/Engine/Streaming/asset_load_queue.h"
+
+AssetLoadQueue
+init_asset_load_queue(AllocHeap heap, u32 capacity)
+{
+  AssetLoadQueue ret;
+  ret.entries  = HEAP_ALLOC(AssetLoadQueueEntry, heap, capacity);
+  ret.capacity = capacity;
+  ret.count    = 0;
+  ret.sequence = 0;
+
+  return ret;
+}
+
+bool
+request_asset_load(Asset* asset)
+{
+  u32 state = kAssetUnloaded;
+  return atomic_ref_compare_exchange_strong(&asset->state, &state, (u32)kAssetLoadRequested) || state == kAssetLoadRequested;
+}
+
+bool
+cancel_asset_load_request(Asset* asset)
+{
+  u32 state = kAssetLoadRequested;
+  return atomic_ref_compare_exchange_strong(&asset->state, &state, (u32)kAssetUnloaded);
+}
+
+static bool
+asset_load_queue_entry_before(const AssetLoadQueueEntry& lhs, const AssetLoadQueueEntry& rhs)
+{
+  if (lhs.priority != rhs.priority)
+  {
+    return lhs.priority > rhs.priority;
+  }
+
+  // Wraps around, which only matters if something has been waiting for billions of kicks
+  return (s32)(lhs.sequence - rhs.sequence) < 0;
+}
+
+static void
+asset_load_queue_set(AssetLoadQueue* queue, u32 index, const AssetLoadQueueEntry& entry)
+{
+  queue->entries[index]           = entry;
+  entry.asset->stream_queue_index = index + 1;
+}
+
+static void
+asset_load_queue_sift_up(AssetLoadQueue* queue, u32 index)
+{
+  AssetLoadQueueEntry entry = queue->entries[index];
+  while (index > 0)
+  {
+    u32 parent = (index - 1) / 2;
+    if (!asset_load_queue_entry_before(entry, queue->entries[parent]))
+    {
+      break;
+    }
+
+    asset_load_queue_set(queue, index, queue->entries[parent]);
+    index = parent;
+  }
+  asset_load_queue_set(queue, index, entry);
+}
+
+static void
+asset_load_queue_sift_down(AssetLoadQueue* queue, u32 index)
+{
+  AssetLoadQueueEntry entry = queue->entries[index];
+  while (true)
+  {
+    u32 child = index * 2 + 1;
+    if (child >= queue->count)
+    {
+      break;
+    }
+
+    if (child + 1 < queue->count && asset_load_queue_entry_before(queue->entries[child + 1], queue->entries[child]))
+    {
+      child++;
+    }
+
+    if (!asset_load_queue_entry_before(queue->entries[child], entry))
+    {
+      break;
+    }
+
+    asset_load_queue_set(queue, index, queue->entries[child]);
+    index = child;
+  }
+  asset_load_queue_set(queue, index, entry);
+}
+
+void
+update_asset_load_queue(AssetLoadQueue* queue, const AssetStreamRequest& request)
+{
+  Asset* asset = request.asset;
+
+  // Already streaming in (or cancelled), nothing left to schedule
+  if (atomic_ref_load(&asset->state) != kAssetLoadRequested)
+  {
+    return;
+  }
+
+  if (asset->stream_queue_index == 0)
+  {
+    ASSERT_MSG_FATAL(queue->count < queue->capacity, "Asset load queue is full! This shouldn't be possible since an asset can't be in there twice.");
+
+    AssetLoadQueueEntry entry;
+    entry.asset            = asset;
+    entry.priority         = request.priority;
+    entry.sequence         = queue->sequence++;
+    asset->stream_priority = request.priority;
+
+    queue->entries[queue->count++] = entry;
+    asset_load_queue_sift_up(queue, queue->count - 1);
+    return;
+  }
+
+  u32                  index    = asset->stream_queue_index - 1;
+  AssetLoadQueueEntry* entry    = &queue->entries[index];
+  f32                  priority = request.type == kAssetStreamRequestLoad ? MAX(entry->priority, request.priority) : request.priority;
+  if (priority == entry->priority)
+  {
+    return;
+  }
+
+  bool raised            = priority > entry->priority;
+  entry->priority        = priority;
+  asset->stream_priority = priority;
+  if (raised)
+  {
+    asset_load_queue_sift_up(queue, index);
+  }
+  else
+  {
+    asset_load_queue_sift_down(queue, index);
+  }
+}
+
+Asset*
+try_pop_asset_load_queue(AssetLoadQueue* queue, const AssetFileIoBudget& budget)
+{
+  // NOTE(bshihabi): Assets only come out of the load queue once there's room for them in the header stage. Everything
+  // still in the load queue can be re-prioritised or cancelled, so the later they get kicked the better.
+  if (queue->count == 0                                                             ||
+      budget.assets_queued >= kMaxQueuedFileIoAssets                                ||
+      budget.bytes_queued + budget.bytes_in_flight >= kMaxFileIoBytesInFlight)
+  {
+    return nullptr;
+  }
+
+  Asset* ret = queue->entries[0].asset;
+  ret->stream_queue_index = 0;
+
+  queue->count--;
+  if (queue->count > 0)
+  {
+    asset_load_queue_set(queue, 0, queue->entries[queue->count]);
+    asset_load_queue_sift_down(queue, 0);
+  }
+
+  return ret;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "Core/Foundation/types.h"
+#include "Core/Foundation/memory.h"
+
+#include "Core/Engine/Streaming/asset.h"
+
+// How many assets can be out of the load queue and waiting on their header read (or on the byte budget). Priorities
+// can't reorder anything past this point, so this is only big enough to keep the latency of small loose files hidden.
+static constexpr u32 kMaxQueuedFileIoAssets     = 8;
+// Nothing else comes out of the load queue once this many bytes are queued up or being read, and loose files don't get
+// their content read kicked. Everything that is already out of the load queue is in front of a newly kicked critical
+// asset, so this is pretty much how long that has to wait (~11ms of reads at 3 GB/s). It's a soft limit: whatever gets
+// through while there's still some room left goes through whole, so nothing can ever be too big to load.
+static constexpr u64 kMaxFileIoBytesInFlight    = MiB(32);
+
+enum AssetStreamRequestType : u32
+{
+  // Puts the asset in the load queue, or bumps its priority up if it's already in there
+  kAssetStreamRequestLoad,
+  // Sets the priority of an asset that's already in the load queue
+  kAssetStreamRequestReprioritize,
+};
+
+struct AssetStreamRequest
+{
+  Asset*                 asset    = nullptr;
+  AssetStreamRequestType type     = kAssetStreamRequestLoad;
+  f32                    priority = kAssetStreamPriorityBackground;
+};
+
+struct AssetLoadQueueEntry
+{
+  Asset* asset    = nullptr;
+  f32    priority = kAssetStreamPriorityBackground;
+  // Breaks ties between equal priorities so that they go in the order they were kicked
+  u32    sequence = 0;
+};
+
+// Binary heap of every asset that was kicked but hasn't started streaming in yet, highest priority on top. Only the
+// streaming thread touches this.
+struct AssetLoadQueue
+{
+  AssetLoadQueueEntry* entries  = nullptr;
+  u32                  capacity = 0;
+  u32                  count    = 0;
+  u32                  sequence = 0;
+};
+
+// What's come out of the load queue and hasn't finished reading yet, which is what keeps anything else from coming out.
+// Only the streaming thread touches this.
+struct AssetFileIoBudget
+{
+  // Assets that came out of the load queue and are waiting in the header stage
+  u32 assets_queued   = 0;
+  // What the packed assets in the header stage are going to read, the asset pack TOC already knows that
+  u64 bytes_queued    = 0;
+  // Sum of the content reads, from when they get kicked until they get processed
+  u64 bytes_in_flight = 0;
+};
+
+AssetLoadQueue init_asset_load_queue(AllocHeap heap, u32 capacity);
+
+// Returns whether the asset is waiting in the load queue now, which is the only time the streaming thread needs to hear
+// about a kick. Assets that are already streaming in, loaded, or broken are left alone.
+THREAD_SAFE bool request_asset_load(Asset* asset);
+// Returns false if the asset already started streaming in. The asset stays in the load queue, the streaming thread
+// throws it out once it gets to the top. If it gets kicked again before then it just goes back to waiting where it was.
+THREAD_SAFE bool cancel_asset_load_request(Asset* asset);
+
+void        update_asset_load_queue(AssetLoadQueue* queue, const AssetStreamRequest& request);
+// Returns nullptr once the load queue is empty or the budget doesn't have room for anything else. Cancelled assets
+// still come out of here, whatever kicks the load has to skip anything that isn't kAssetLoadRequested anymore.
+Asset*      try_pop_asset_load_queue(AssetLoadQueue* queue, const AssetFileIoBudget& budget);
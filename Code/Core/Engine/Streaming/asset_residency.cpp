@@ -0,0 +1,165 @@
+#include "Core/Engine/Streaming/asset_residency.h"
+
+void
+init_asset_residency(AssetResidency* residency)
+{
+  residency->lock               = init_spin_lock();
+  residency->lru                = Asset();
+  residency->lru.lru_prev       = &residency->lru;
+  residency->lru.lru_next       = &residency->lru;
+  residency->budget             = AssetResidencyBudget();
+  residency->resident_cpu_bytes = 0;
+  residency->resident_gpu_bytes = 0;
+  residency->retiring_cpu_bytes = 0;
+  residency->retiring_gpu_bytes = 0;
+}
+
+// Both of these need the lock
+static void
+link_asset_lru(Asset* prev, Asset* asset)
+{
+  ASSERT_MSG_FATAL(asset->lru_next == nullptr, "Asset 0x%x is already in the eviction list! This is a bug in the asset streamer.", asset->id);
+  asset->lru_prev           = prev;
+  asset->lru_next           = prev->lru_next;
+  prev->lru_next->lru_prev  = asset;
+  prev->lru_next            = asset;
+}
+
+static void
+unlink_asset_lru(Asset* asset)
+{
+  asset->lru_prev->lru_next = asset->lru_next;
+  asset->lru_next->lru_prev = asset->lru_prev;
+  asset->lru_prev           = nullptr;
+  asset->lru_next           = nullptr;
+}
+
+void
+acquire_asset_locked(AssetResidency* residency, Asset* asset)
+{
+  if (asset->ref_count == 0)
+  {
+    asset->use_count++;
+    if (asset->lru_next != nullptr)
+    {
+      unlink_asset_lru(asset);
+    }
+  }
+  asset->ref_count++;
+}
+
+bool
+release_asset_locked(AssetResidency* residency, Asset* asset, bool evict_first)
+{
+  ASSERT_MSG_FATAL(asset->ref_count > 0, "Asset 0x%x was released more times than it was acquired!", asset->id);
+  asset->ref_count--;
+  if (asset->ref_count > 0)
+  {
+    return false;
+  }
+
+  // Nothing wants it anymore, so don't bother loading it if it's still waiting in the load queue
+  u32 state = kAssetLoadRequested;
+  if (atomic_ref_compare_exchange_strong(&asset->state, &state, (u32)kAssetUnloaded) || state != kAssetReady)
+  {
+    // Assets that are still streaming in go in the eviction list once they're ready (see mark_asset_ready)
+    return false;
+  }
+
+  link_asset_lru(evict_first ? &residency->lru : residency->lru.lru_prev, asset);
+  return true;
+}
+
+void
+mark_asset_ready(AssetResidency* residency, Asset* asset)
+{
+  spin_acquire(&residency->lock);
+  defer { spin_release(&residency->lock); };
+
+  atomic_ref_store(&asset->state, (u32)kAssetReady);
+  if (asset->ref_count == 0)
+  {
+    link_asset_lru(residency->lru.lru_prev, asset);
+  }
+}
+
+Asset*
+pick_asset_to_evict(AssetResidency* residency, AssetEvictionPolicy policy)
+{
+  Asset* sentinel = &residency->lru;
+  Asset* ret      = sentinel->lru_next;
+  if (ret == sentinel)
+  {
+    return nullptr;
+  }
+
+  if (policy == kAssetEvictionFrequencyWeighted)
+  {
+    // Ties go to the one that's gone unused for the longest
+    Asset* candidate = ret->lru_next;
+    for (u32 icandidate = 1; icandidate < kAssetEvictionCandidates && candidate != sentinel; icandidate++, candidate = candidate->lru_next)
+    {
+      if (candidate->use_count < ret->use_count)
+      {
+        ret = candidate;
+      }
+    }
+  }
+
+  return ret;
+}
+
+Asset*
+take_asset_to_evict(AssetResidency* residency, const AssetResidencyBudget& budget)
+{
+  if (residency->resident_cpu_bytes - residency->retiring_cpu_bytes <= budget.cpu_bytes &&
+      residency->resident_gpu_bytes - residency->retiring_gpu_bytes <= budget.gpu_bytes)
+  {
+    return nullptr;
+  }
+
+  spin_acquire(&residency->lock);
+  defer { spin_release(&residency->lock); };
+
+  Asset* ret = pick_asset_to_evict(residency, budget.policy);
+  if (ret != nullptr)
+  {
+    unlink_asset_lru(ret);
+    atomic_ref_store(&ret->state, (u32)kAssetUnloaded);
+  }
+
+  return ret;
+}
+
+void
+add_asset_cpu_bytes(AssetResidency* residency, Asset* asset, u64 size)
+{
+  asset->cpu_bytes              += size;
+  residency->resident_cpu_bytes += size;
+}
+
+void
+add_asset_gpu_bytes(AssetResidency* residency, Asset* asset, u64 size)
+{
+  asset->gpu_bytes              += size;
+  residency->resident_gpu_bytes += size;
+}
+
+void
+retire_asset_bytes(AssetResidency* residency, Asset* asset)
+{
+  residency->retiring_cpu_bytes += asset->cpu_bytes;
+  residency->retiring_gpu_bytes += asset->gpu_bytes;
+  asset->cpu_bytes               = 0;
+  asset->gpu_bytes               = 0;
+}
+
+void
+free_retired_bytes(AssetResidency* residency, u64 cpu_bytes, u64 gpu_bytes)
+{
+  ASSERT_MSG_FATAL(residency->retiring_cpu_bytes >= cpu_bytes && residency->retiring_gpu_bytes >= gpu_bytes, "Freed more than was retired! This is a bug in the asset streamer.");
+  residency->resident_cpu_bytes -= cpu_bytes;
+  residency->resident_gpu_bytes -= gpu_bytes;
+  residency->retiring_cpu_bytes -= cpu_bytes;
+  residency->retiring_gpu_bytes -= gpu_bytes;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "Core/Foundation/types.h"
+#include "Core/Foundation/threading.h"
+
+#include "Core/Engine/Streaming/asset.h"
+
+// How far back into the eviction list kAssetEvictionFrequencyWeighted looks for the least used asset
+static constexpr u32 kAssetEvictionCandidates = 8;
+
+// Which assets nothing holds on to anymore, and how much memory everything that's loaded is using. Whatever actually
+// frees an asset's memory is up to the streamer, this only decides which ones go and keeps count.
+struct AssetResidency
+{
+  // Guards the ref counts, the eviction list and the budget. The eviction list is circular with lru as the sentinel,
+  // the assets that have gone unused for the longest are at the front.
+  SpinLock             lock;
+  Asset                lru;
+  AssetResidencyBudget budget;
+
+  // Only touched by the streaming thread. The retiring bytes are the part of the resident bytes that was already
+  // unloaded and is waiting to get freed, so they don't count towards the budget anymore.
+  u64                  resident_cpu_bytes = 0;
+  u64                  resident_gpu_bytes = 0;
+  u64                  retiring_cpu_bytes = 0;
+  u64                  retiring_gpu_bytes = 0;
+};
+
+// The eviction list points back into residency, so it can't be moved after this.
+void   init_asset_residency(AssetResidency* residency);
+
+// Both of these need the lock. Returns whether the asset went in the eviction list. Dependencies of an asset that's
+// being unloaded go in with evict_first, nothing has used them since whatever was using them did.
+void   acquire_asset_locked(AssetResidency* residency, Asset* asset);
+bool   release_asset_locked(AssetResidency* residency, Asset* asset, bool evict_first);
+
+// Assets that nothing holds on to anymore go in the eviction list once they're loaded, the ref count and the state
+// change under the same lock so that release_asset_locked and this always agree on which one of them does that.
+THREAD_SAFE void mark_asset_ready(AssetResidency* residency, Asset* asset);
+
+// Needs the lock. Returns nullptr if nothing can be evicted.
+Asset* pick_asset_to_evict(AssetResidency* residency, AssetEvictionPolicy policy);
+
+// Takes the next asset that has to go out of the eviction list and unloads it, returns nullptr once what's loaded fits
+// in the budget (or everything that's left is still being held on to). The asset's memory has to be retired next.
+Asset* take_asset_to_evict(AssetResidency* residency, const AssetResidencyBudget& budget);
+
+// The streaming thread's side of the byte counts: whatever an asset allocates while it's loading, handing all of it off
+// to get freed once it's unloaded, and it actually getting freed.
+void   add_asset_cpu_bytes(AssetResidency* residency, Asset* asset, u64 size);
+void   add_asset_gpu_bytes(AssetResidency* residency, Asset* asset, u64 size);
+void   retire_asset_bytes (AssetResidency* residency, Asset* asset);
+void   free_retired_bytes (AssetResidency* residency, u64 cpu_bytes, u64 gpu_bytes);
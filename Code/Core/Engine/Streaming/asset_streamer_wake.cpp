@@ -0,0 +1,41 @@
+#include "Core/Engine/Streaming/asset_streamer_wake.h"
+
+AssetStreamerWake
+init_asset_streamer_wake()
+{
+  AssetStreamerWake ret;
+  ret.event    = init_os_event();
+  ret.sleeping = 0;
+
+  return ret;
+}
+
+void
+destroy_asset_streamer_wake(AssetStreamerWake* wake)
+{
+  destroy_os_event(&wake->event);
+}
+
+void
+wake_asset_streamer(AssetStreamerWake* wake)
+{
+  // Pairs with the fence in begin_asset_streamer_sleep: either it sees whatever we just pushed before going to sleep, or we see it sleeping.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (atomic_ref_load(&wake->sleeping))
+  {
+    os_event_signal(&wake->event);
+  }
+}
+
+void
+begin_asset_streamer_sleep(AssetStreamerWake* wake)
+{
+  atomic_ref_store(&wake->sleeping, 1U);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+void
+end_asset_streamer_sleep(AssetStreamerWake* wake)
+{
+  atomic_ref_store(&wake->sleeping, 0U);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "Core/Foundation/types.h"
+#include "Core/Foundation/threading.h"
+
+// How the asset streaming thread goes to sleep once it runs out of work without sleeping through anything that shows up
+// while it does. Kicks happen all the time, so they only signal the event while the streaming thread is (about to be)
+// asleep:
+//
+//   Kicking thread                          Streaming thread
+//   push the request                        sleeping = 1
+//   fence                                   fence
+//   if (sleeping) signal                    if (no requests) wait
+//                                           sleeping = 0
+//
+// Either the streaming thread sees the request, or the kick sees it sleeping. IO completions, GPU fences and the main
+// thread signal the event every time and don't need any of this, signals stick around until the next wait.
+struct AssetStreamerWake
+{
+  OsEvent                 event;
+  // Set while the streaming thread is (about to be) asleep. Accessed atomically.
+  alignas(kCacheLineSize) u32 sleeping = 0;
+};
+
+AssetStreamerWake init_asset_streamer_wake();
+void              destroy_asset_streamer_wake(AssetStreamerWake* wake);
+
+// Call after pushing whatever the streaming thread needs to pick up.
+THREAD_SAFE void  wake_asset_streamer(AssetStreamerWake* wake);
+
+// Only ever called by the streaming thread, asset_streamer_sleep puts these together. They're split up so that tests can
+// step through every interleaving with the kicks.
+void              begin_asset_streamer_sleep(AssetStreamerWake* wake);
+void              end_asset_streamer_sleep  (AssetStreamerWake* wake);
+
+// has_requests is whatever kicks push to before calling wake_asset_streamer. Returns false if the whole timeout went by
+// without anything waking the streaming thread up.
+template <typename F>
+inline bool
+asset_streamer_sleep(AssetStreamerWake* wake, u32 timeout_ms, F has_requests)
+{
+  begin_asset_streamer_sleep(wake);
+  bool ret = has_requests() || os_event_wait(&wake->event, timeout_ms);
+  end_asset_streamer_sleep(wake);
+
+  return ret;
+}
@@ -2,20 +2,22 @@
 #include "Core/Foundation/profiling.h"
 
 #include "Core/Foundation/Containers/push_buffer.h"
+#include "Core/Foundation/Containers/mpmc_ring_queue.h"
+#include "Core/Foundation/Containers/sharded_hash_table.h"
 #include "Core/Foundation/bit_allocator.h"
+#include "Core/Foundation/compression.h"
 
 #include "Core/Engine/memory.h"
 #include "Core/Engine/asset_streaming.h"
+#include "Core/Engine/job_system.h"
+#include "Core/Engine/Streaming/asset_load_queue.h"
+#include "Core/Engine/Streaming/asset_residency.h"
+#include "Core/Engine/Streaming/asset_streamer_wake.h"
 #include "Core/Engine/Render/renderer.h"
 
 #include "Core/Engine/Vendor/DirectStorage/dstorage.h"
 #include "Core/Engine/Vendor/DirectStorage/dstorageerr.h"
 
-struct AssetStreamRequest
-{
-  AssetType asset_type = AssetType::kUnknown;
-  AssetId   asset_id   = kNullAssetId;
-};
 enum StreamingCmd : u32
 {
   // 
@@ -24,23 +26,30 @@ enum StreamingCmd : u32
 
   // Model cmds
   kModelCpuStreamHeader,
+  kModelCpuStreamPacked,
   kModelCpuStreamContent,
   kModelGpuStreamContent,
   kModelStreamDependencies,
+  kModelFree,
   kModelCmdEnd,           // Leave this at the end here, so that we can determine streaming cmd type
 
   // Material cmds
   kMaterialCpuStreamHeader,
+  kMaterialCpuStreamPacked,
   kMaterialCpuStreamContent,
   kMaterialStreamDependencies,
   kMaterialGpuStreamContent,
+  kMaterialFree,
   kMaterialCmdEnd,        // Leave this at the end here, so that we can determine streaming cmd type
 
   // Texture cmds
   kTextureCpuStreamHeader,
+  kTextureCpuStreamPacked,
   kTextureCpuStreamContent,
   kTextureGpuStreamContent,
   kTextureMainThreadInitialize,
+  kTextureFree,
+  kTextureMainThreadFree,
   kTextureCmdEnd,         // Leave this at the end here, so that we can determine streaming cmd type
 };
 
@@ -69,6 +78,16 @@ struct MainThreadCmdHeader
   StreamingCmd     cmd              = kNullStreamingCmd;
 };
 
+// Everything an unloaded asset had allocated, which gets freed once the GPU can't be using any of it anymore
+struct AssetFreeCmdHeader
+{
+  StreamingCmd     cmd              = kNullStreamingCmd;
+  FenceValue       gpu_fence_value  = 0;
+
+  u64              cpu_bytes        = 0;
+  u64              gpu_bytes        = 0;
+};
+
 struct AssetDependencyCmdHeader
 {
   StreamingCmd     cmd              = kNullStreamingCmd;
@@ -82,7 +101,9 @@ struct AssetDependencyCmdHeader
 
 struct AssetStreamer
 {
-  SpinLocked<RingQueue<AssetStreamRequest>> asset_stream_requests;
+  MpmcRingQueue<AssetStreamRequest>         asset_stream_requests;
+
+  AssetLoadQueue                            load_queue;
 
   PushBuffer                                header_file_io_buffer;
   PushBuffer                                content_file_io_buffer;
@@ -97,22 +118,46 @@ struct AssetStreamer
   // Caches the next in queue file I/O and Gpu commands
   FileStreamingCmdHeader                    next_header_file_io_cmd;
   FileStreamingCmdHeader                    next_content_file_io_cmd;
-  u32                                       file_io_assets_in_flight = 0;
+  // The header stage is header_file_io_buffer, the content reads are everything in content_file_io_buffer
+  AssetFileIoBudget                         file_io_budget;
   GpuStreamingCmdHeader                     next_gpu_cmd;
 
   GpuRingBuffer                             gpu_staging_buffer;
   GpuBuffer                                 gpu_scratch_buffer;
 
   // TODO(bshihabi): We should really use virtual memory for this
-  GpuLinearAllocator                        gpu_texture_allocator;
+  GpuTlsfAllocator                          gpu_texture_allocator;
 
   CmdList                                   gpu_cmd_buffer;
   CmdListAllocator                          gpu_cmd_buffer_allocator;
 
   Thread                                    thread;
 
-  // Used to allocate metadata for models/materials. Not sure what the best allocator is for this with _no_ fragmentation
-  LinearAllocator                           metadata_allocator;
+  // Kicks, file reads and the GPU fence all signal this, the streaming thread sleeps on it whenever it runs out of work
+  AssetStreamerWake                         wake;
+  // The fence value the wake event was last armed on, so every GPU command only registers once
+  FenceValue                                gpu_wake_fence_value = 0;
+
+  // The retiring bytes in here are whatever is waiting in residency_free_queue on the GPU
+  AssetResidency                            residency;
+  PushBuffer                                residency_free_queue;
+  AssetFreeCmdHeader                        next_free_cmd;
+
+  // The main thread signals this on the graphics queue at the start of every frame. Anything the frame that's being
+  // recorded uses is done once it reaches one past the last value it was signaled with.
+  GpuFence                                  residency_fence;
+  FenceValue                                residency_wake_fence_value = 0;
+  alignas(kCacheLineSize) Atomic<u64>       residency_fence_value      = 0;
+
+  // One kCompressionChunkSize bounce buffer per job worker plus one for the streaming thread, see
+  // decompress_to_gpu_staging
+  u8*                                       decompress_bounce_buffers = nullptr;
+
+  // Assets/Built/assets.pack if there is one. Assets in its TOC get read straight out of asset_pack_file with a single
+  // read each, anything that isn't in there still gets loaded out of its own built asset file. The pack always wins
+  // over the loose file, which is why AssetBuilder deletes it before it rebuilds anything.
+  AssetPack                                 asset_pack;
+  AsyncFileStream                           asset_pack_file;
 
   alignas(kCacheLineSize) Atomic<u64>       kill            = 0;
 };
@@ -128,6 +173,26 @@ flush_gpu_cmds(AssetStreamer* streamer)
   return ret;
 }
 
+// Asset metadata gets freed again when the asset is unloaded, so it comes out of the resource heap
+template <typename T>
+static Array<T>
+alloc_asset_metadata(AssetStreamer* streamer, Asset* asset, size_t count)
+{
+  add_asset_cpu_bytes(&streamer->residency, asset, sizeof(T) * count);
+  return init_array<T>((AllocHeap)g_ResourceHeap, count);
+}
+
+template <typename T>
+static void
+free_asset_metadata(Array<T>* array)
+{
+  if (array->memory != nullptr)
+  {
+    HEAP_FREE(g_ResourceHeap, array->memory);
+  }
+  zero_struct(array);
+}
+
 static u64
 alloc_gpu_staging_bytes_blocking(AssetStreamer* streamer, u32 size, u32 alignment = 1)
 {
@@ -145,16 +210,105 @@ alloc_gpu_staging_bytes_blocking(AssetStreamer* streamer, u32 size, u32 alignmen
   }
 }
 
+// Each job decompresses this many chunks (64 KiB each) before it checks whether it should split off the rest
+static constexpr u64 kDecompressChunkGrain = 4;
+
+// The chunks get decompressed in parallel on the job system workers, the streaming thread decompresses its share and
+// sleeps until everyone else is done.
+//
+// NOTE(bshihabi): The staging buffer is write-combined (upload heap), and LZ4 reads back what it has already
+// decompressed, so the chunks get decompressed into a cached bounce buffer first and then copied over. Stored chunks
+// are just a copy so they go straight in. Nothing in a range waits on anything, so each range can use the bounce
+// buffer of whichever worker it started on.
+static DONT_IGNORE_RETURN bool
+decompress_to_gpu_staging(AssetStreamer* streamer, u8* dst, const u8* blob)
+{
+  u32  chunk_count = get_compressed_blob_chunk_count(blob);
+  bool failed      = false;
+
+  parallel_for(0, chunk_count, kDecompressChunkGrain, [&](u64 begin, u64 end)
+  {
+    const CompressedBlobHeader* header = (const CompressedBlobHeader*)blob;
+
+    u8* bounce = header->codec != kCompressionCodecNone ? streamer->decompress_bounce_buffers + (u64)get_job_worker_index() * kCompressionChunkSize : nullptr;
+    for (u32 ichunk = (u32)begin; ichunk < (u32)end; ichunk++)
+    {
+      u8*  chunk_dst = dst + (u64)ichunk * kCompressionChunkSize;
+      bool ok        = bounce != nullptr ? decompress_blob_chunk(blob, ichunk, bounce) : decompress_blob_chunk(blob, ichunk, chunk_dst);
+      if (!ok)
+      {
+        atomic_ref_store(&failed, true, std::memory_order_relaxed);
+        continue;
+      }
+
+      if (bounce != nullptr)
+      {
+        memcpy(chunk_dst, bounce, get_compressed_blob_chunk_size(blob, ichunk));
+      }
+    }
+  });
+
+  return !failed;
+}
+
+static const AssetPackEntry*
+find_packed_asset(AssetStreamer* streamer, AssetId asset_id, AssetType asset_type)
+{
+  const AssetPackEntry* ret = find_asset_pack_entry(streamer->asset_pack, asset_id);
+  if (ret == nullptr)
+  {
+    return nullptr;
+  }
+
+  bool valid_entry = ret->asset_type     == asset_type                          &&
+                     ret->header_size    == get_asset_header_size(asset_type)   &&
+                     ret->content_offset == ret->header_offset + ret->header_size;
+  if (!valid_entry)
+  {
+    dbgln("Asset 0x%x has a corrupted asset pack entry, loading it from its built asset file instead.", asset_id);
+    return nullptr;
+  }
+
+  return ret;
+}
+
+// The TOC already says how big packed assets are, so they don't need a header read before their content read. They
+// still go through the header queue (without any IO) so that they get rate limited along with everything else.
+static void
+push_packed_asset_cmd(AssetStreamer* streamer, StreamingCmd cmd, const AssetPackEntry& entry, const void* pkt, u64 pkt_size)
+{
+  // NOTE(bshihabi): The header reads of loose files double as readahead for their content while they wait on the rate
+  // limiter, packed assets would otherwise have nothing in flight until they get through it. Cold loads out of the pack
+  // were 20-60% slower than loose files without this.
+  prefetch_file_range(streamer->asset_pack_file, entry.header_offset, entry.header_size + entry.content_size);
+
+  void* file_io_memory = push_buffer_begin_edit(&streamer->header_file_io_buffer, sizeof(FileStreamingCmdHeader) + pkt_size);
+  defer { push_buffer_end_edit(&streamer->header_file_io_buffer, file_io_memory); };
+  streamer->file_io_budget.assets_queued++;
+  streamer->file_io_budget.bytes_queued += entry.header_size + entry.content_size;
+
+  void* scratch_memory = file_io_memory;
+
+  FileStreamingCmdHeader* header = (FileStreamingCmdHeader*)ALLOC_OFF(scratch_memory, sizeof(FileStreamingCmdHeader));
+  header->cmd                    = cmd;
+  header->file_promise           = kAsyncFileError;
+  header->io_byte_count          = 0;
+  header->request_timestamp      = begin_cpu_profiler_timestamp();
+
+  void* dst_pkt                  = ALLOC_OFF(scratch_memory, pkt_size);
+  memcpy(dst_pkt, pkt, pkt_size);
+}
+
 struct ModelRegistry
 {
   // TODO(bshihabi): Use TLSF allocator here (or page allocator)
   LinearAllocator                       allocator;
-  SpinLocked<HashTable<AssetId, Model>> asset_map;
+  ShardedHashTable<AssetId, Model> asset_map;
 };
 
 struct MaterialRegistry
 {
-  SpinLocked<HashTable<AssetId, Material>> asset_map;
+  ShardedHashTable<AssetId, Material> asset_map;
 
   // Used to allocate material slots on the Gpu
   BitAllocator                             gpu_material_slot_allocator;
@@ -166,7 +320,7 @@ struct TextureRegistry
 {
   // TODO(bshihabi): Use TLSF allocator here (or page allocator)
   LinearAllocator                         allocator;
-  SpinLocked<HashTable<AssetId, Texture>> asset_map;
+  ShardedHashTable<AssetId, Texture> asset_map;
 };
 
 struct AssetRegistry
@@ -180,8 +334,8 @@ AssetStreamer* g_AssetStreamer = nullptr;
 AssetRegistry* g_AssetRegistry = nullptr;
 AssetStreamingStatistics g_AssetStreamingStats;
 
-// Only block on the file I/O thread 
-static constexpr u32 kFileIOBlockRateMs = 2;
+// The streaming thread sleeps until something signals it, this is only a safety net in case a wake-up ever gets lost
+static constexpr u32 kAssetStreamerWakeTimeoutMs = 100;
 
 //////////////////////////////
 //     Model Streaming      //
@@ -194,7 +348,7 @@ init_model_registry(void)
 
   ModelRegistry ret;
   ret.allocator  = init_linear_allocator(model_manager_mem, kModelManagerSize);
-  ret.asset_map  = init_hash_table<AssetId, Model>(g_InitHeap, kMaxAssets);
+  ret.asset_map  = init_sharded_hash_table<AssetId, Model>(g_InitHeap, kMaxAssets);
   return ret;
 }
 
@@ -210,14 +364,23 @@ struct ModelFileHeaderStreamingPacket
   ModelAsset         asset_header;
 };
 
+// Used for streaming stuff from the asset pack
+struct ModelFilePackedStreamingPacket
+{
+  Model*           model = nullptr;
+  AssetPackEntry   entry;
+};
+
 // Used for streaming stuff from files
 struct ModelFileContentStreamingPacket
 {
-  Model*           model = nullptr;
-  u64              size  = 0;
-  void*            buf   = nullptr;
+  Model*           model  = nullptr;
+  u64              size   = 0;
+  void*            buf    = nullptr;
   ModelAsset       asset_header;
   AsyncFileStream  file_stream;
+  // Read out of the asset pack, the header came in with the same read and sits right in front of buf
+  bool             packed = false;
 };
 
 struct ModelGpuContentStreamingPacket
@@ -236,7 +399,7 @@ static void
 kick_model_load(ModelRegistry* registry, AssetStreamer* streamer, AssetId asset_id)
 {
   Model* model = nullptr;
-  ACQUIRE(&registry->asset_map, auto* asset_map)
+  ACQUIRE(sharded_hash_table_shard(&registry->asset_map, asset_id), auto* asset_map)
   {
     model = hash_table_find(asset_map, asset_id);
     ASSERT_MSG_FATAL(model != nullptr, "Model 0x%x was not initialized in the ModelRegistry! This indicates that there was some out-of-order event that occurred as this is responsible for the calling kick_model_load before the asset streaming thread gets it.", asset_id);
@@ -246,9 +409,18 @@ kick_model_load(ModelRegistry* registry, AssetStreamer* streamer, AssetId asset_
     ASSERT_MSG_FATAL(model->asset.type == AssetType::kModel, "ModelRegistry is in a bad state, found non-model asset in the asset map with type %u", model->asset.type);
   };
 
-  // Add the model to the load queue if no one has requested it to be loaded yet
-  if (InterlockedCompareExchange(&model->asset.state, kAssetLoadRequested, kAssetUnloaded) == kAssetUnloaded)
+  // Start streaming the model in, unless its load got cancelled while it was waiting in the load queue
+  if (InterlockedCompareExchange(&model->asset.state, kAssetStreaming, kAssetLoadRequested) == kAssetLoadRequested)
   {
+    if (const AssetPackEntry* entry = find_packed_asset(streamer, asset_id, AssetType::kModel))
+    {
+      ModelFilePackedStreamingPacket pkt;
+      pkt.model = model;
+      pkt.entry = *entry;
+      push_packed_asset_cmd(streamer, kModelCpuStreamPacked, *entry, &pkt, sizeof(pkt));
+      return;
+    }
+
     // Open the built asset file
     char asset_path[kAssetPathSize];
     asset_id_to_path(asset_path, asset_id);
@@ -265,6 +437,7 @@ kick_model_load(ModelRegistry* registry, AssetStreamer* streamer, AssetId asset_
                            sizeof(ModelFileHeaderStreamingPacket);
     void* file_io_memory = push_buffer_begin_edit(&streamer->header_file_io_buffer, scratch_size);
     defer { push_buffer_end_edit(&streamer->header_file_io_buffer, file_io_memory); };
+    streamer->file_io_budget.assets_queued++;
 
     void* scratch_memory = file_io_memory;
 
@@ -284,7 +457,7 @@ kick_model_load(ModelRegistry* registry, AssetStreamer* streamer, AssetId asset_
     header->request_timestamp = begin_cpu_profiler_timestamp();
 
     // If the file read fails, then we already allocated the memory so we can't abort now, we just mark the file promise as failed and the consumer will ignore the packet.
-    Result<void, FileError> file_read_ok = read_file(pkt->file_stream, &header->file_promise, &pkt->asset_header, pkt->size, 0);
+    Result<void, FileError> file_read_ok = read_file(pkt->file_stream, &header->file_promise, &pkt->asset_header, pkt->size, 0, &streamer->wake.event);
     if (!file_read_ok)
     {
       dbgln("Failed to read file for asset 0x%x.", asset_id);
@@ -340,15 +513,14 @@ process_model_file_request(AssetStreamer* streamer, FileStreamingCmdHeader heade
       }
 
       // Update the model with the correct number of model subsets and allocate the arrays
-      model->subsets          = init_array<ModelSubset   >(streamer->metadata_allocator, src_pkt.asset_header.num_model_subsets);
-      model->subset_rt_blases = init_array<GpuRtBlas     >(streamer->metadata_allocator, src_pkt.asset_header.num_model_subsets);
-      model->materials        = init_array<MaterialHandle>(streamer->metadata_allocator, src_pkt.asset_header.num_model_subsets);
+      model->subsets          = alloc_asset_metadata<ModelSubset   >(streamer, &model->asset, src_pkt.asset_header.num_model_subsets);
+      model->subset_rt_blases = alloc_asset_metadata<GpuRtBlas     >(streamer, &model->asset, src_pkt.asset_header.num_model_subsets);
+      model->materials        = alloc_asset_metadata<MaterialHandle>(streamer, &model->asset, src_pkt.asset_header.num_model_subsets);
 
       // Bytes to read from the asset file for the content
       u64   read_size    = src_pkt.asset_header.num_model_subsets * sizeof(ModelAsset::ModelSubset)                                                                      +
                            src_pkt.asset_header.num_model_subsets * src_pkt.asset_header.lod_count * sizeof(ModelAsset::ModelSubsetLod) +
-                           src_pkt.asset_header.vertices_size                                                                           +
-                           src_pkt.asset_header.indices_size;
+                           src_pkt.asset_header.geometry_compressed_size;
 
       // Allocate some scratch memory in the ring buffer to read the file data
       u64   scratch_size = sizeof(FileStreamingCmdHeader)          +
@@ -371,12 +543,62 @@ process_model_file_request(AssetStreamer* streamer, FileStreamingCmdHeader heade
       dst_pkt->asset_header     = src_pkt.asset_header;
       dst_pkt->buf              = ALLOC_OFF(scratch_memory, read_size);
       dst_pkt->size             = read_size;
+      dst_pkt->packed           = false;
 
       // Fill in the statistics
       dst_header->io_byte_count     = dst_pkt->size;
       dst_header->request_timestamp = begin_cpu_profiler_timestamp();
+      streamer->file_io_budget.bytes_in_flight += dst_header->io_byte_count;
+
+      Result<void, FileError> stream_ok = read_file(dst_pkt->file_stream, &dst_header->file_promise, dst_pkt->buf, dst_pkt->size, src_pkt.size, &streamer->wake.event);
+      if (!stream_ok)
+      {
+        dbgln("Failed to stream asset 0x%x. File read failed.", asset_id);
+        model->asset.state       = kAssetFailedToLoad;
+        return;
+      }
+    } break;
+    // Streaming in of the header and content together out of the asset pack
+    case kModelCpuStreamPacked:
+    {
+      ModelFilePackedStreamingPacket src_pkt;
+      push_buffer_pop(&streamer->header_file_io_buffer, &src_pkt, sizeof(src_pkt));
+
+      Model*  model    = src_pkt.model;
+      AssetId asset_id = model->asset.id;
+
+      // The header gets read in right in front of the content, so the content stage sees the same buf as always
+      u64   read_size    = src_pkt.entry.header_size + src_pkt.entry.content_size;
+
+      u64   scratch_size = sizeof(FileStreamingCmdHeader)          +
+                           sizeof(ModelFileContentStreamingPacket) +
+                           read_size;
+
+      void* file_io_memory = push_buffer_begin_edit(&streamer->content_file_io_buffer, scratch_size);
+      defer { push_buffer_end_edit(&streamer->content_file_io_buffer, file_io_memory); };
+
+      void* scratch_memory = file_io_memory;
+
+      auto* dst_header          = (FileStreamingCmdHeader*         )ALLOC_OFF(scratch_memory, sizeof(FileStreamingCmdHeader));
+      dst_header->cmd           = kModelCpuStreamContent;
+      dst_header->file_promise  = kAsyncFileError;
+
+      auto* dst_pkt             = (ModelFileContentStreamingPacket*)ALLOC_OFF(scratch_memory, sizeof(ModelFileContentStreamingPacket));
+      u8*   read_buf            = (u8*                             )ALLOC_OFF(scratch_memory, read_size);
+      dst_pkt->model            = model;
+      dst_pkt->file_stream      = streamer->asset_pack_file;
+      dst_pkt->buf              = read_buf + src_pkt.entry.header_size;
+      dst_pkt->size             = src_pkt.entry.content_size;
+      dst_pkt->packed           = true;
+      zero_struct(&dst_pkt->asset_header);
+
+      // Fill in the statistics
+      dst_header->io_byte_count     = read_size;
+      dst_header->request_timestamp = begin_cpu_profiler_timestamp();
+      streamer->file_io_budget.bytes_queued    -= read_size;
+      streamer->file_io_budget.bytes_in_flight += dst_header->io_byte_count;
 
-      Result<void, FileError> stream_ok = read_file(dst_pkt->file_stream, &dst_header->file_promise, dst_pkt->buf, dst_pkt->size, src_pkt.size);
+      Result<void, FileError> stream_ok = read_file(streamer->asset_pack_file, &dst_header->file_promise, read_buf, read_size, src_pkt.entry.header_offset, &streamer->wake.event);
       if (!stream_ok)
       {
         dbgln("Failed to stream asset 0x%x. File read failed.", asset_id);
@@ -389,6 +611,19 @@ process_model_file_request(AssetStreamer* streamer, FileStreamingCmdHeader heade
       ModelFileContentStreamingPacket src_pkt;
       push_buffer_pop(&streamer->content_file_io_buffer, &src_pkt, sizeof(src_pkt));
 
+      // Packed assets only have their header once the read is done
+      if (src_pkt.packed)
+      {
+        if (await_result == kAwaitFailed)
+        {
+          push_buffer_pop(&streamer->content_file_io_buffer, sizeof(ModelAsset) + src_pkt.size);
+          src_pkt.model->asset.state = kAssetFailedToLoad;
+          return;
+        }
+
+        memcpy(&src_pkt.asset_header, (u8*)src_pkt.buf - sizeof(ModelAsset), sizeof(ModelAsset));
+      }
+
       // !!! WARNING !!!
       //
       // The first sizeof(ModelAsset) bytes of this pointer are invalid.
@@ -424,7 +659,7 @@ process_model_file_request(AssetStreamer* streamer, FileStreamingCmdHeader heade
       }
 
       // Now that we know there's not some weird corruption happening, we can safely pop off the rest of the packet
-      defer { push_buffer_pop(&streamer->content_file_io_buffer, src_pkt.size); };
+      defer { push_buffer_pop(&streamer->content_file_io_buffer, src_pkt.size + (src_pkt.packed ? sizeof(ModelAsset) : 0)); };
 
       ASSERT_MSG_FATAL(await_result != kAwaitInFlight, "In flight requests should be handled earlier up the call stack, something went wrong in the asset streamer.");
       if (await_result == kAwaitFailed)
@@ -438,6 +673,48 @@ process_model_file_request(AssetStreamer* streamer, FileStreamingCmdHeader heade
         return;
       }
 
+      if (src_pkt.packed)
+      {
+        u64 content_size = src_pkt.asset_header.num_model_subsets * sizeof(ModelAsset::ModelSubset)                                       +
+                           src_pkt.asset_header.num_model_subsets * src_pkt.asset_header.lod_count * sizeof(ModelAsset::ModelSubsetLod) +
+                           src_pkt.asset_header.geometry_compressed_size;
+        if (content_size > src_pkt.size)
+        {
+          dbgln("Skipping corrupted asset 0x%x, its asset pack entry is smaller than its content.", asset_id);
+          model->asset.state = kAssetFailedToLoad;
+          return;
+        }
+
+        // The header stage does this for models that aren't packed
+        model->subsets          = alloc_asset_metadata<ModelSubset   >(streamer, &model->asset, src_pkt.asset_header.num_model_subsets);
+        model->subset_rt_blases = alloc_asset_metadata<GpuRtBlas     >(streamer, &model->asset, src_pkt.asset_header.num_model_subsets);
+        model->materials        = alloc_asset_metadata<MaterialHandle>(streamer, &model->asset, src_pkt.asset_header.num_model_subsets);
+      }
+
+      // Decompression trusts the blob's header and chunk table, so those need to be checked first
+      u64  geometry_size = src_pkt.asset_header.vertices_size + src_pkt.asset_header.indices_size;
+      u8*  geometry      = buf + src_pkt.asset_header.vertices;
+      bool valid_blob    = src_pkt.asset_header.vertices                                                >= sizeof(ModelAsset)                &&
+                           src_pkt.asset_header.vertices + src_pkt.asset_header.geometry_compressed_size <= sizeof(ModelAsset) + src_pkt.size &&
+                           validate_compressed_blob(geometry, src_pkt.asset_header.geometry_compressed_size, geometry_size);
+      if (!valid_blob)
+      {
+        dbgln("Skipping corrupted asset 0x%x, its compressed geometry is invalid.", asset_id);
+        model->asset.state = kAssetFailedToLoad;
+        return;
+      }
+
+      // All of the geometry gets decompressed straight into the staging buffer at once, and then every LOD gets copied
+      // out of wherever it is in there.
+      u8* gpu_scratch_mapped_base = (u8*)unwrap(streamer->gpu_staging_buffer.buffer.mapped);
+      u8* geometry_staging        = gpu_scratch_mapped_base + alloc_gpu_staging_bytes_blocking(streamer, (u32)geometry_size);
+      if (!decompress_to_gpu_staging(streamer, geometry_staging, geometry))
+      {
+        dbgln("Skipping corrupted asset 0x%x, its geometry failed to decompress.", asset_id);
+        model->asset.state = kAssetFailedToLoad;
+        return;
+      }
+
       // For statistics
       u64 gpu_io_byte_count = 0;
 
@@ -448,32 +725,28 @@ process_model_file_request(AssetStreamer* streamer, FileStreamingCmdHeader heade
         ModelSubset* runtime_subset = array_add(&model->subsets);
         runtime_subset->center      = asset_subset->center;
         runtime_subset->radius      = asset_subset->radius;
-        runtime_subset->lods        = init_array<ModelSubsetLod>(streamer->metadata_allocator, src_pkt.asset_header.lod_count);
+        runtime_subset->lods        = alloc_asset_metadata<ModelSubsetLod>(streamer, &model->asset, src_pkt.asset_header.lod_count);
 
         // Copy vertex/index data and populate runtime LODs
         ModelAsset::ModelSubsetLod* asset_lod = (ModelAsset::ModelSubsetLod*)(buf + asset_subset->lods);
         for (u32 ilod = 0; ilod < src_pkt.asset_header.lod_count; ilod++, asset_lod++)
         {
-          u64 vertex_offset_bytes = alloc_uber_vertex(asset_lod->num_vertices * sizeof(Vertex));
-          u64 index_offset_bytes  = alloc_uber_index (asset_lod->num_indices  * sizeof(u16));
-
-          ModelSubsetLod* runtime_lod = array_add(&runtime_subset->lods);
-          runtime_lod->vertex_start   = (u32)vertex_offset_bytes / sizeof(Vertex);
-          runtime_lod->vertex_count   = (u32)asset_lod->num_vertices;
-          runtime_lod->index_start    = (u32)index_offset_bytes  / sizeof(u16);
-          runtime_lod->index_count    = (u32)asset_lod->num_indices;
-          runtime_lod->error          = asset_lod->error;
+          ModelSubsetLod* runtime_lod    = array_add(&runtime_subset->lods);
+          runtime_lod->vertex_allocation = alloc_uber_vertex((u32)asset_lod->num_vertices);
+          runtime_lod->index_allocation  = alloc_uber_index ((u32)asset_lod->num_indices);
+          runtime_lod->vertex_start      = runtime_lod->vertex_allocation.offset;
+          runtime_lod->vertex_count      = (u32)asset_lod->num_vertices;
+          runtime_lod->index_start       = runtime_lod->index_allocation.offset;
+          runtime_lod->index_count       = (u32)asset_lod->num_indices;
+          runtime_lod->error             = asset_lod->error;
 
           u32 lod_vertex_size_in_bytes = (u32)(sizeof(Vertex) * asset_lod->num_vertices);
           u32 lod_index_size_in_bytes  = (u32)(sizeof(u16)    * asset_lod->num_indices);
+          add_asset_gpu_bytes(&streamer->residency, &model->asset, lod_vertex_size_in_bytes + lod_index_size_in_bytes);
 
-          u8* gpu_scratch_mapped_base  = (u8*)unwrap(streamer->gpu_staging_buffer.buffer.mapped);
-          u8* gpu_scratch_mapped       = gpu_scratch_mapped_base + alloc_gpu_staging_bytes_blocking(streamer, lod_vertex_size_in_bytes + lod_index_size_in_bytes);
-
-          u8* lod_vertex_staging       = ALLOC_OFF(gpu_scratch_mapped, lod_vertex_size_in_bytes);
-          u8* lod_index_staging        = ALLOC_OFF(gpu_scratch_mapped, lod_index_size_in_bytes );
-          memcpy(lod_vertex_staging, buf + asset_lod->vertices, lod_vertex_size_in_bytes);
-          memcpy(lod_index_staging,  buf + asset_lod->indices,  lod_index_size_in_bytes );
+          // The LOD's offset pointers are into the decompressed geometry, which starts at vertices
+          u8* lod_vertex_staging       = geometry_staging + (asset_lod->vertices - src_pkt.asset_header.vertices);
+          u8* lod_index_staging        = geometry_staging + (asset_lod->indices  - src_pkt.asset_header.vertices);
 
           gpu_copy_buffer(
             &streamer->gpu_cmd_buffer,
@@ -503,11 +776,12 @@ process_model_file_request(AssetStreamer* streamer, FileStreamingCmdHeader heade
         GpuRtBlas* subset_rt_blas    = array_add(&model->subset_rt_blases);
         const ModelSubsetLod* rt_lod = &runtime_subset->lods[runtime_subset->rt_blas_lod];
         *subset_rt_blas              = alloc_uber_blas(rt_lod->vertex_start, rt_lod->vertex_count, rt_lod->index_start, rt_lod->index_count, "Content subset RT BLAS");
+        add_asset_gpu_bytes(&streamer->residency, &model->asset, subset_rt_blas->allocation.size);
 
         // Kick off the material loads
         {
           MaterialHandle* dst = array_add(&model->materials);
-          *dst                = kick_material_load(asset_subset->material);
+          *dst                = kick_material_load(asset_subset->material, model->asset.stream_priority);
         }
       }
 
@@ -663,7 +937,7 @@ process_model_dep_request(AssetStreamer* streamer, AssetDependencyCmdHeader head
       }
 
       // The asset is now ready
-      model->asset.state = kAssetReady;
+      mark_asset_ready(&streamer->residency, &model->asset);
     } break;
     default: UNREACHABLE; break;
   }
@@ -677,7 +951,7 @@ static MaterialRegistry
 init_material_registry(void)
 {
   MaterialRegistry ret;
-  ret.asset_map                   = init_hash_table<AssetId, Material>(g_InitHeap, kMaxAssets);
+  ret.asset_map                   = init_sharded_hash_table<AssetId, Material>(g_InitHeap, kMaxAssets);
   ret.gpu_material_slot_allocator = init_bit_allocator(g_InitHeap, kMaxAssets);
 
   GpuBufferDesc desc = {0};
@@ -703,6 +977,12 @@ struct MaterialFileHeaderStreamingPacket
   MaterialAsset   asset_header;
 };
 
+struct MaterialFilePackedStreamingPacket
+{
+  Material*       material    = nullptr;
+  AssetPackEntry  entry;
+};
+
 struct MaterialFileContentStreamingPacket
 {
   Material*       material    = nullptr;
@@ -710,6 +990,8 @@ struct MaterialFileContentStreamingPacket
   void*           buf         = nullptr;
   MaterialAsset   asset_header;
   AsyncFileStream file_stream;
+  // Read out of the asset pack, the header came in with the same read and sits right in front of buf
+  bool            packed      = false;
 };
 
 struct MaterialDependencyStreamingPacket
@@ -728,7 +1010,7 @@ static void
 kick_material_load(MaterialRegistry* registry, AssetStreamer* streamer, AssetId asset_id)
 {
   Material* material = nullptr;
-  ACQUIRE(&registry->asset_map, auto* asset_map)
+  ACQUIRE(sharded_hash_table_shard(&registry->asset_map, asset_id), auto* asset_map)
   {
     material = hash_table_find(asset_map, asset_id);
     ASSERT_MSG_FATAL(material != nullptr, "Material 0x%x was not initialized in the MaterialRegistry! This indicates that there was some out-of-order event that occurred as this is responsible for the calling kick_material_load before the asset streaming thread gets it.", asset_id);
@@ -737,18 +1019,8 @@ kick_material_load(MaterialRegistry* registry, AssetStreamer* streamer, AssetId
     ASSERT_MSG_FATAL(material->asset.type == AssetType::kMaterial, "MaterialRegistry is in a bad state, found non-material asset in the asset map with type %u", material->asset.type);
   };
 
-  if (InterlockedCompareExchange(&material->asset.state, kAssetLoadRequested, kAssetUnloaded) == kAssetUnloaded)
+  if (InterlockedCompareExchange(&material->asset.state, kAssetStreaming, kAssetLoadRequested) == kAssetLoadRequested)
   {
-    char asset_path[kAssetPathSize];
-    asset_id_to_path(asset_path, asset_id);
-    Result<AsyncFileStream, FileError> file_open_ok = open_file_async(asset_path, kFileStreamRead);
-    if (!file_open_ok)
-    {
-      dbgln("Failed to open file for asset 0x%x.", asset_id);
-      material->asset.state = kAssetFailedToLoad;
-      return;
-    }
-
     Option<u32> gpu_id   = bit_alloc(&registry->gpu_material_slot_allocator);
     if (!gpu_id)
     {
@@ -759,10 +1031,31 @@ kick_material_load(MaterialRegistry* registry, AssetStreamer* streamer, AssetId
 
     material->gpu_id     = unwrap_or(gpu_id, 0);
 
+    if (const AssetPackEntry* entry = find_packed_asset(streamer, asset_id, AssetType::kMaterial))
+    {
+      MaterialFilePackedStreamingPacket pkt;
+      pkt.material = material;
+      pkt.entry    = *entry;
+      push_packed_asset_cmd(streamer, kMaterialCpuStreamPacked, *entry, &pkt, sizeof(pkt));
+      return;
+    }
+
+    char asset_path[kAssetPathSize];
+    asset_id_to_path(asset_path, asset_id);
+    Result<AsyncFileStream, FileError> file_open_ok = open_file_async(asset_path, kFileStreamRead);
+    if (!file_open_ok)
+    {
+      dbgln("Failed to open file for asset 0x%x.", asset_id);
+      bit_free(&registry->gpu_material_slot_allocator, material->gpu_id);
+      material->asset.state = kAssetFailedToLoad;
+      return;
+    }
+
     u64   scratch_size   = sizeof(FileStreamingCmdHeader)            +
                            sizeof(MaterialFileHeaderStreamingPacket);
     void* file_io_memory = push_buffer_begin_edit(&streamer->header_file_io_buffer, scratch_size);
     defer { push_buffer_end_edit(&streamer->header_file_io_buffer, file_io_memory); };
+    streamer->file_io_budget.assets_queued++;
 
     void* scratch_memory = file_io_memory;
 
@@ -779,7 +1072,7 @@ kick_material_load(MaterialRegistry* registry, AssetStreamer* streamer, AssetId
     header->io_byte_count     = pkt->size;
     header->request_timestamp = begin_cpu_profiler_timestamp();
 
-    Result<void, FileError> file_read_ok = read_file(pkt->file_stream, &header->file_promise, &pkt->asset_header, pkt->size, 0);
+    Result<void, FileError> file_read_ok = read_file(pkt->file_stream, &header->file_promise, &pkt->asset_header, pkt->size, 0, &streamer->wake.event);
     if (!file_read_ok)
     {
       dbgln("Failed to read file for asset 0x%x.", asset_id);
@@ -850,12 +1143,61 @@ process_material_file_request(AssetStreamer* streamer, FileStreamingCmdHeader he
       dst_pkt->asset_header          = src_pkt.asset_header;
       dst_pkt->buf                   = ALLOC_OFF(scratch_memory, read_size);
       dst_pkt->size                  = read_size;
+      dst_pkt->packed                = false;
 
       // Fill in the statistics
       dst_header->io_byte_count      = dst_pkt->size;
       dst_header->request_timestamp  = begin_cpu_profiler_timestamp();
+      streamer->file_io_budget.bytes_in_flight += dst_header->io_byte_count;
 
-      Result<void, FileError> stream_ok = read_file(dst_pkt->file_stream, &dst_header->file_promise, dst_pkt->buf, dst_pkt->size, src_pkt.size);
+      Result<void, FileError> stream_ok = read_file(dst_pkt->file_stream, &dst_header->file_promise, dst_pkt->buf, dst_pkt->size, src_pkt.size, &streamer->wake.event);
+      if (!stream_ok)
+      {
+        dbgln("Failed to stream asset 0x%x. File read failed.", asset_id);
+        material->asset.state   = kAssetFailedToLoad;
+        return;
+      }
+    } break;
+    case kMaterialCpuStreamPacked:
+    {
+      MaterialFilePackedStreamingPacket src_pkt;
+      push_buffer_pop(&streamer->header_file_io_buffer, &src_pkt, sizeof(src_pkt));
+
+      Material* material = src_pkt.material;
+      AssetId   asset_id = material->asset.id;
+
+      // The header gets read in right in front of the content, so the content stage sees the same buf as always
+      u64   read_size    = src_pkt.entry.header_size + src_pkt.entry.content_size;
+
+      u64   scratch_size = sizeof(FileStreamingCmdHeader)             +
+                           sizeof(MaterialFileContentStreamingPacket) +
+                           read_size;
+
+      void* file_io_memory = push_buffer_begin_edit(&streamer->content_file_io_buffer, scratch_size);
+      defer { push_buffer_end_edit(&streamer->content_file_io_buffer, file_io_memory); };
+
+      void* scratch_memory = file_io_memory;
+
+      auto* dst_header               = (FileStreamingCmdHeader*            )ALLOC_OFF(scratch_memory, sizeof(FileStreamingCmdHeader));
+      dst_header->cmd                = kMaterialCpuStreamContent;
+      dst_header->file_promise       = kAsyncFileError;
+
+      auto* dst_pkt                  = (MaterialFileContentStreamingPacket*)ALLOC_OFF(scratch_memory, sizeof(MaterialFileContentStreamingPacket));
+      u8*   read_buf                 = (u8*                                )ALLOC_OFF(scratch_memory, read_size);
+      dst_pkt->material              = material;
+      dst_pkt->file_stream           = streamer->asset_pack_file;
+      dst_pkt->buf                   = read_buf + src_pkt.entry.header_size;
+      dst_pkt->size                  = src_pkt.entry.content_size;
+      dst_pkt->packed                = true;
+      zero_struct(&dst_pkt->asset_header);
+
+      // Fill in the statistics
+      dst_header->io_byte_count      = read_size;
+      dst_header->request_timestamp  = begin_cpu_profiler_timestamp();
+      streamer->file_io_budget.bytes_queued    -= read_size;
+      streamer->file_io_budget.bytes_in_flight += dst_header->io_byte_count;
+
+      Result<void, FileError> stream_ok = read_file(streamer->asset_pack_file, &dst_header->file_promise, read_buf, read_size, src_pkt.entry.header_offset, &streamer->wake.event);
       if (!stream_ok)
       {
         dbgln("Failed to stream asset 0x%x. File read failed.", asset_id);
@@ -868,6 +1210,19 @@ process_material_file_request(AssetStreamer* streamer, FileStreamingCmdHeader he
       MaterialFileContentStreamingPacket src_pkt;
       push_buffer_pop(&streamer->content_file_io_buffer, &src_pkt, sizeof(src_pkt));
 
+      // Packed assets only have their header once the read is done
+      if (src_pkt.packed)
+      {
+        if (await_result == kAwaitFailed)
+        {
+          push_buffer_pop(&streamer->content_file_io_buffer, sizeof(MaterialAsset) + src_pkt.size);
+          src_pkt.material->asset.state = kAssetFailedToLoad;
+          return;
+        }
+
+        memcpy(&src_pkt.asset_header, (u8*)src_pkt.buf - sizeof(MaterialAsset), sizeof(MaterialAsset));
+      }
+
       // !!! WARNING !!!
       //
       // The first sizeof(MaterialAsset) bytes of this pointer are invalid.
@@ -901,7 +1256,7 @@ process_material_file_request(AssetStreamer* streamer, FileStreamingCmdHeader he
         return;
       }
 
-      defer { push_buffer_pop(&streamer->content_file_io_buffer, src_pkt.size); };
+      defer { push_buffer_pop(&streamer->content_file_io_buffer, src_pkt.size + (src_pkt.packed ? sizeof(MaterialAsset) : 0)); };
 
       ASSERT_MSG_FATAL(await_result != kAwaitInFlight, "In flight requests should be handled earlier up the call stack, something went wrong in the asset streamer.");
       if (await_result == kAwaitFailed)
@@ -914,8 +1269,15 @@ process_material_file_request(AssetStreamer* streamer, FileStreamingCmdHeader he
         return;
       }
 
+      if (src_pkt.packed && src_pkt.asset_header.num_textures * sizeof(AssetRef<TextureAsset>) > src_pkt.size)
+      {
+        dbgln("Skipping corrupted asset 0x%x, its asset pack entry is smaller than its content.", asset_id);
+        material->asset.state = kAssetFailedToLoad;
+        return;
+      }
+
       // Initialize the texture handles
-      material->textures = init_array<TextureHandle>(streamer->metadata_allocator, src_pkt.asset_header.num_textures);
+      material->textures = alloc_asset_metadata<TextureHandle>(streamer, &material->asset, src_pkt.asset_header.num_textures);
 
       u32 unstreamed_textures = 0;
 
@@ -923,7 +1285,7 @@ process_material_file_request(AssetStreamer* streamer, FileStreamingCmdHeader he
       for (u32 itexture = 0; itexture < src_pkt.asset_header.num_textures; itexture++)
       {
         TextureHandle* dst = array_add(&material->textures);
-        *dst               = kick_texture_load(texture_asset_ids[itexture]);
+        *dst               = kick_texture_load(texture_asset_ids[itexture], material->asset.stream_priority);
         if (!dst->is_loaded())
         {
           unstreamed_textures++;
@@ -1084,7 +1446,8 @@ process_material_gpu_request(AssetStreamer* streamer, GpuStreamingCmdHeader head
         return;
       }
 
-      material->asset.state = kAssetReady;
+      add_asset_gpu_bytes(&streamer->residency, &material->asset, sizeof(MaterialGpu));
+      mark_asset_ready(&streamer->residency, &material->asset);
     } break;
     default: UNREACHABLE; break;
   }
@@ -1101,7 +1464,7 @@ init_texture_registry(void)
 
   TextureRegistry ret;
   ret.allocator  = init_linear_allocator(texture_registry_mem, kTextureRegistrySize);
-  ret.asset_map  = init_hash_table<AssetId, Texture>(g_InitHeap, kMaxAssets);
+  ret.asset_map  = init_sharded_hash_table<AssetId, Texture>(g_InitHeap, kMaxAssets);
   return ret;
 }
 
@@ -1113,6 +1476,12 @@ struct TextureFileHeaderStreamingPacket
   TextureAsset    asset_header;
 };
 
+struct TextureFilePackedStreamingPacket
+{
+  Texture*        texture     = nullptr;
+  AssetPackEntry  entry;
+};
+
 struct TextureFileContentStreamingPacket
 {
   Texture*        texture     = nullptr;
@@ -1120,6 +1489,8 @@ struct TextureFileContentStreamingPacket
   void*           buf         = nullptr;
   TextureAsset    asset_header;
   AsyncFileStream file_stream;
+  // Read out of the asset pack, the header came in with the same read and sits right in front of buf
+  bool            packed      = false;
 };
 
 struct TextureGpuContentStreamingPacket
@@ -1138,7 +1509,7 @@ static void
 kick_texture_load(TextureRegistry* registry, AssetStreamer* streamer, AssetId asset_id)
 {
   Texture* texture = nullptr;
-  ACQUIRE(&registry->asset_map, auto* asset_map)
+  ACQUIRE(sharded_hash_table_shard(&registry->asset_map, asset_id), auto* asset_map)
   {
     texture = hash_table_find(asset_map, asset_id);
     ASSERT_MSG_FATAL(texture != nullptr, "Texture 0x%x was not initialized in the TextureRegistry! This indicates that there was some out-of-order event that occurred as this is responsible for the calling kick_texture_load before the asset streaming thread gets it.", asset_id);
@@ -1147,8 +1518,17 @@ kick_texture_load(TextureRegistry* registry, AssetStreamer* streamer, AssetId as
     ASSERT_MSG_FATAL(texture->asset.type == AssetType::kTexture,  "TextureRegistry is in a bad state, found non-texture asset in the asset map with type %u", texture->asset.type);
   };
 
-  if (InterlockedCompareExchange(&texture->asset.state, kAssetLoadRequested, kAssetUnloaded) == kAssetUnloaded)
+  if (InterlockedCompareExchange(&texture->asset.state, kAssetStreaming, kAssetLoadRequested) == kAssetLoadRequested)
   {
+    if (const AssetPackEntry* entry = find_packed_asset(streamer, asset_id, AssetType::kTexture))
+    {
+      TextureFilePackedStreamingPacket pkt;
+      pkt.texture = texture;
+      pkt.entry   = *entry;
+      push_packed_asset_cmd(streamer, kTextureCpuStreamPacked, *entry, &pkt, sizeof(pkt));
+      return;
+    }
+
     char asset_path[kAssetPathSize];
     asset_id_to_path(asset_path, asset_id);
     Result<AsyncFileStream, FileError> file_open_ok = open_file_async(asset_path, kFileStreamRead);
@@ -1163,6 +1543,7 @@ kick_texture_load(TextureRegistry* registry, AssetStreamer* streamer, AssetId as
                            sizeof(TextureFileHeaderStreamingPacket);
     void* file_io_memory = push_buffer_begin_edit(&streamer->header_file_io_buffer, scratch_size);
     defer { push_buffer_end_edit(&streamer->header_file_io_buffer, file_io_memory); };
+    streamer->file_io_budget.assets_queued++;
 
     void* scratch_memory = file_io_memory;
 
@@ -1178,7 +1559,7 @@ kick_texture_load(TextureRegistry* registry, AssetStreamer* streamer, AssetId as
     header->io_byte_count     = pkt->size;
     header->request_timestamp = begin_cpu_profiler_timestamp();
 
-    Result<void, FileError> file_read_ok = read_file(pkt->file_stream, &header->file_promise, &pkt->asset_header, pkt->size, 0);
+    Result<void, FileError> file_read_ok = read_file(pkt->file_stream, &header->file_promise, &pkt->asset_header, pkt->size, 0, &streamer->wake.event);
     if (!file_read_ok)
     {
       dbgln("Failed to read file for asset 0x%x.", asset_id);
@@ -1260,13 +1641,62 @@ process_texture_file_request(AssetStreamer* streamer, FileStreamingCmdHeader hea
       dst_pkt->asset_header          = src_pkt.asset_header;
       dst_pkt->buf                   = ALLOC_OFF(scratch_memory, read_size);
       dst_pkt->size                  = read_size;
+      dst_pkt->packed                = false;
 
       // Fill in the statistics
       dst_header->io_byte_count      = dst_pkt->size;
       dst_header->request_timestamp  = begin_cpu_profiler_timestamp();
+      streamer->file_io_budget.bytes_in_flight += dst_header->io_byte_count;
 
       // Issue the async file I/O read request
-      Result<void, FileError> stream_ok = read_file(dst_pkt->file_stream, &dst_header->file_promise, dst_pkt->buf, dst_pkt->size, src_pkt.size);
+      Result<void, FileError> stream_ok = read_file(dst_pkt->file_stream, &dst_header->file_promise, dst_pkt->buf, dst_pkt->size, src_pkt.size, &streamer->wake.event);
+      if (!stream_ok)
+      {
+        dbgln("Failed to stream asset 0x%x. File read failed.", asset_id);
+        texture->asset.state     = kAssetFailedToLoad;
+        return;
+      }
+    } break;
+    case kTextureCpuStreamPacked:
+    {
+      TextureFilePackedStreamingPacket src_pkt;
+      push_buffer_pop(&streamer->header_file_io_buffer, &src_pkt, sizeof(src_pkt));
+
+      Texture* texture  = src_pkt.texture;
+      AssetId  asset_id = texture->asset.id;
+
+      // The header gets read in right in front of the content, so the content stage sees the same buf as always
+      u64   read_size    = src_pkt.entry.header_size + src_pkt.entry.content_size;
+
+      u64   scratch_size = sizeof(FileStreamingCmdHeader)            +
+                           sizeof(TextureFileContentStreamingPacket) +
+                           read_size;
+
+      void* file_io_memory = push_buffer_begin_edit(&streamer->content_file_io_buffer, scratch_size);
+      defer { push_buffer_end_edit(&streamer->content_file_io_buffer, file_io_memory); };
+
+      void* scratch_memory = file_io_memory;
+
+      auto* dst_header               = (FileStreamingCmdHeader*           )ALLOC_OFF(scratch_memory, sizeof(FileStreamingCmdHeader));
+      dst_header->cmd                = kTextureCpuStreamContent;
+      dst_header->file_promise       = kAsyncFileError;
+
+      auto* dst_pkt                  = (TextureFileContentStreamingPacket*)ALLOC_OFF(scratch_memory, sizeof(TextureFileContentStreamingPacket));
+      u8*   read_buf                 = (u8*                               )ALLOC_OFF(scratch_memory, read_size);
+      dst_pkt->texture               = texture;
+      dst_pkt->file_stream           = streamer->asset_pack_file;
+      dst_pkt->buf                   = read_buf + src_pkt.entry.header_size;
+      dst_pkt->size                  = src_pkt.entry.content_size;
+      dst_pkt->packed                = true;
+      zero_struct(&dst_pkt->asset_header);
+
+      // Fill in the statistics
+      dst_header->io_byte_count      = read_size;
+      dst_header->request_timestamp  = begin_cpu_profiler_timestamp();
+      streamer->file_io_budget.bytes_queued    -= read_size;
+      streamer->file_io_budget.bytes_in_flight += dst_header->io_byte_count;
+
+      Result<void, FileError> stream_ok = read_file(streamer->asset_pack_file, &dst_header->file_promise, read_buf, read_size, src_pkt.entry.header_offset, &streamer->wake.event);
       if (!stream_ok)
       {
         dbgln("Failed to stream asset 0x%x. File read failed.", asset_id);
@@ -1279,6 +1709,19 @@ process_texture_file_request(AssetStreamer* streamer, FileStreamingCmdHeader hea
       TextureFileContentStreamingPacket src_pkt;
       push_buffer_pop(&streamer->content_file_io_buffer, &src_pkt, sizeof(src_pkt));
 
+      // Packed assets only have their header once the read is done
+      if (src_pkt.packed)
+      {
+        if (await_result == kAwaitFailed)
+        {
+          push_buffer_pop(&streamer->content_file_io_buffer, sizeof(TextureAsset) + src_pkt.size);
+          src_pkt.texture->asset.state = kAssetFailedToLoad;
+          return;
+        }
+
+        memcpy(&src_pkt.asset_header, (u8*)src_pkt.buf - sizeof(TextureAsset), sizeof(TextureAsset));
+      }
+
       // !!! WARNING !!!
       //
       // The first sizeof(MaterialAsset) bytes of this pointer are invalid.
@@ -1316,7 +1759,7 @@ process_texture_file_request(AssetStreamer* streamer, FileStreamingCmdHeader hea
         return;
       }
 
-      defer { push_buffer_pop(&streamer->content_file_io_buffer, src_pkt.size); };
+      defer { push_buffer_pop(&streamer->content_file_io_buffer, src_pkt.size + (src_pkt.packed ? sizeof(TextureAsset) : 0)); };
 
       ASSERT_MSG_FATAL(await_result != kAwaitInFlight, "In flight requests should be handled earlier up the call stack, something went wrong in the asset streamer.");
       if (await_result == kAwaitFailed)
@@ -1329,12 +1772,44 @@ process_texture_file_request(AssetStreamer* streamer, FileStreamingCmdHeader hea
         return;
       }
 
-      // TODO(bshihabi): Allocate a GpuTexture, copy src_pkt.buf into the GPU staging buffer, and issue the upload command
+      if (src_pkt.packed)
+      {
+        // The header stage does this for textures that aren't packed
+        texture->width       = src_pkt.asset_header.width;
+        texture->height      = src_pkt.asset_header.height;
+        texture->color_space = src_pkt.asset_header.color_space;
+      }
+
+      // Decompression trusts the blob's header and chunk table, so those need to be checked first
+      bool valid_blob = src_pkt.asset_header.data                                       >= sizeof(TextureAsset)                &&
+                        src_pkt.asset_header.data + src_pkt.asset_header.compressed_size <= sizeof(TextureAsset) + src_pkt.size &&
+                        validate_compressed_blob(texture_data, src_pkt.asset_header.compressed_size, src_pkt.asset_header.uncompressed_size);
+
+      // The mip copies read straight out of the staging buffer
+      u32 mip_count  = src_pkt.asset_header.mip_count;
+      valid_blob    &= mip_count >= 1 && mip_count <= kMaxTextureMips;
+      for (u32 imip = 0; valid_blob && imip < mip_count; imip++)
+      {
+        valid_blob &= (u64)src_pkt.asset_header.mip_offsets[imip] + src_pkt.asset_header.mip_sizes[imip] <= src_pkt.asset_header.uncompressed_size;
+      }
+
+      if (!valid_blob)
+      {
+        dbgln("Skipping corrupted asset 0x%x, its compressed data is invalid.", asset_id);
+        texture->asset.state = kAssetFailedToLoad;
+        return;
+      }
+
       u8* gpu_scratch_mapped_base = (u8*)unwrap(streamer->gpu_staging_buffer.buffer.mapped);
       u8* gpu_scratch_mapped      = gpu_scratch_mapped_base + alloc_gpu_staging_bytes_blocking(streamer, src_pkt.asset_header.uncompressed_size, kGpuTextureAlignment);
 
-      // Copy the data to staging buffer
-      memcpy(gpu_scratch_mapped, texture_data, src_pkt.asset_header.uncompressed_size);
+      // Decompress the data straight into the staging buffer
+      if (!decompress_to_gpu_staging(streamer, gpu_scratch_mapped, texture_data))
+      {
+        dbgln("Skipping corrupted asset 0x%x, its data failed to decompress.", asset_id);
+        texture->asset.state = kAssetFailedToLoad;
+        return;
+      }
 
       // Allocate the GpuTexture
       // TODO(bshihabi): Make this reserve virtual memory and only make required mips resident
@@ -1342,17 +1817,28 @@ process_texture_file_request(AssetStreamer* streamer, FileStreamingCmdHeader hea
       gpu_texture_desc.width             = texture->width;
       gpu_texture_desc.height            = texture->height;
       gpu_texture_desc.array_size        = 1;
+      gpu_texture_desc.mip_levels        = (u8)mip_count;
       gpu_texture_desc.format            = src_pkt.asset_header.gpu_format;
       gpu_texture_desc.color_clear_value = Vec4(0.0f, 0.0f, 0.0f, 0.0f);
-      texture->gpu_texture               = alloc_gpu_texture(streamer->gpu_texture_allocator, gpu_texture_desc, "Content Gpu Texture");
 
-      gpu_copy_texture(
-        &streamer->gpu_cmd_buffer,
-        &texture->gpu_texture,
-        streamer->gpu_staging_buffer.buffer,
-        gpu_scratch_mapped - gpu_scratch_mapped_base,
-        src_pkt.asset_header.uncompressed_size
-      );
+      // Same thing alloc_gpu_texture does, but the allocation needs to stick around so that the texture can be freed
+      u64 gpu_texture_alignment          = 1;
+      u64 gpu_texture_size               = query_gpu_texture_size(gpu_texture_desc, &gpu_texture_alignment);
+      texture->gpu_allocation            = GPU_HEAP_ALLOC((GpuAllocHeap)streamer->gpu_texture_allocator, (u32)gpu_texture_size, (u32)gpu_texture_alignment);
+      texture->gpu_texture               = init_gpu_texture(texture->gpu_allocation, gpu_texture_desc, "Content Gpu Texture");
+      add_asset_gpu_bytes(&streamer->residency, &texture->asset, gpu_texture_size);
+
+      for (u32 imip = 0; imip < mip_count; imip++)
+      {
+        gpu_copy_texture(
+          &streamer->gpu_cmd_buffer,
+          &texture->gpu_texture,
+          streamer->gpu_staging_buffer.buffer,
+          gpu_scratch_mapped - gpu_scratch_mapped_base + src_pkt.asset_header.mip_offsets[imip],
+          src_pkt.asset_header.mip_sizes[imip],
+          imip
+        );
+      }
       gpu_texture_layout_transition(&streamer->gpu_cmd_buffer, &texture->gpu_texture, kGpuTextureLayoutGeneral);
 
       u64   scratch_size      = sizeof(GpuStreamingCmdHeader) + sizeof(TextureGpuContentStreamingPacket);
@@ -1459,40 +1945,321 @@ process_texture_main_thread(PushBuffer* main_thread_cmd_queue, MainThreadCmdHead
       // Allocate the descriptor on the main thread and initialize the SRV.
       texture->srv_descriptor = alloc_descriptor(g_DescriptorCbvSrvUavPool);
       GpuTextureSrvDesc desc;
-      desc.mip_levels        = 1;
+      desc.mip_levels        = texture->gpu_texture.desc.mip_levels;
       desc.most_detailed_mip = 0;
       desc.array_size        = 1;
       desc.format            = texture->gpu_texture.desc.format;
       init_texture_srv(&texture->srv_descriptor, &texture->gpu_texture, desc);
 
-      texture->asset.state   = kAssetReady;
+      mark_asset_ready(&g_AssetStreamer->residency, &texture->asset);
+    } break;
+    case kTextureMainThreadFree:
+    {
+      GpuDescriptor srv_descriptor;
+      push_buffer_pop(main_thread_cmd_queue, &srv_descriptor, sizeof(srv_descriptor));
+
+      free_descriptor(g_DescriptorCbvSrvUavPool, &srv_descriptor);
     } break;
     default: UNREACHABLE; break;
   }
 }
 
+//////////////////////////////
+//        Residency         //
+//////////////////////////////
+
+struct ModelFreePacket
+{
+  Array<ModelSubset>    subsets;
+  Array<GpuRtBlas>      subset_rt_blases;
+  Array<MaterialHandle> materials;
+};
+
+struct MaterialFreePacket
+{
+  Array<TextureHandle>  textures;
+  u32                   gpu_id = 0;
+};
+
+struct TextureFreePacket
+{
+  GpuTexture            gpu_texture;
+  GpuAllocation         gpu_allocation;
+  GpuDescriptor         srv_descriptor;
+};
+
 static void
+push_asset_free_cmd(AssetStreamer* streamer, Asset* asset, StreamingCmd cmd, FenceValue gpu_fence_value, const void* pkt, u64 pkt_size)
+{
+  void* free_memory = push_buffer_begin_edit(&streamer->residency_free_queue, sizeof(AssetFreeCmdHeader) + pkt_size);
+  defer { push_buffer_end_edit(&streamer->residency_free_queue, free_memory); };
+
+  void* scratch_memory     = free_memory;
+
+  auto* header             = (AssetFreeCmdHeader*)ALLOC_OFF(scratch_memory, sizeof(AssetFreeCmdHeader));
+  header->cmd              = cmd;
+  header->gpu_fence_value  = gpu_fence_value;
+  header->cpu_bytes        = asset->cpu_bytes;
+  header->gpu_bytes        = asset->gpu_bytes;
+
+  void* dst_pkt            = ALLOC_OFF(scratch_memory, pkt_size);
+  memcpy(dst_pkt, pkt, pkt_size);
+
+  retire_asset_bytes(&streamer->residency, asset);
+}
+
+// The asset is already out of the eviction list and unloaded. Everything it had gets handed off to the free queue and
+// the asset is left the way it was before it was ever loaded, so that it can get kicked again right away.
+//
+// NOTE(bshihabi): Every asset type starts with its Asset, that's the only reason the casts below work.
+static void
+evict_asset(AssetStreamer* streamer, Asset* asset, FenceValue gpu_fence_value)
+{
+  switch (asset->type)
+  {
+    case AssetType::kModel:
+    {
+      Model* model = (Model*)asset;
+
+      ModelFreePacket pkt;
+      pkt.subsets          = model->subsets;
+      pkt.subset_rt_blases = model->subset_rt_blases;
+      pkt.materials        = model->materials;
+      push_asset_free_cmd(streamer, asset, kModelFree, gpu_fence_value, &pkt, sizeof(pkt));
+
+      spin_acquire(&streamer->residency.lock);
+      for (MaterialHandle material : model->materials)
+      {
+        release_asset_locked(&streamer->residency, &material.deref()->asset, true);
+      }
+      spin_release(&streamer->residency.lock);
+
+      zero_struct(&model->subsets);
+      zero_struct(&model->subset_rt_blases);
+      zero_struct(&model->materials);
+    } break;
+    case AssetType::kMaterial:
+    {
+      Material* material = (Material*)asset;
+
+      MaterialFreePacket pkt;
+      pkt.textures = material->textures;
+      pkt.gpu_id   = material->gpu_id;
+      push_asset_free_cmd(streamer, asset, kMaterialFree, gpu_fence_value, &pkt, sizeof(pkt));
+
+      spin_acquire(&streamer->residency.lock);
+      for (TextureHandle texture : material->textures)
+      {
+        release_asset_locked(&streamer->residency, &texture.deref()->asset, true);
+      }
+      spin_release(&streamer->residency.lock);
+
+      zero_struct(&material->textures);
+      material->gpu_id = 0;
+    } break;
+    case AssetType::kTexture:
+    {
+      Texture* texture = (Texture*)asset;
+
+      TextureFreePacket pkt;
+      pkt.gpu_texture    = texture->gpu_texture;
+      pkt.gpu_allocation = texture->gpu_allocation;
+      pkt.srv_descriptor = texture->srv_descriptor;
+      push_asset_free_cmd(streamer, asset, kTextureFree, gpu_fence_value, &pkt, sizeof(pkt));
+
+      zero_struct(&texture->gpu_texture);
+      zero_struct(&texture->gpu_allocation);
+      zero_struct(&texture->srv_descriptor);
+    } break;
+    default: UNREACHABLE;
+  }
+
+  atomic_add(&g_AssetStreamingStats.evicted_assets, (u64)1);
+}
+
+static void
+process_asset_free(AssetStreamer* streamer, AssetFreeCmdHeader header)
+{
+  switch (header.cmd)
+  {
+    case kModelFree:
+    {
+      ModelFreePacket src_pkt;
+      push_buffer_pop(&streamer->residency_free_queue, &src_pkt, sizeof(src_pkt));
+
+      for (ModelSubset& subset : src_pkt.subsets)
+      {
+        for (const ModelSubsetLod& lod : subset.lods)
+        {
+          free_uber_vertex(lod.vertex_allocation);
+          free_uber_index (lod.index_allocation);
+        }
+        free_asset_metadata(&subset.lods);
+      }
+
+      for (GpuRtBlas& blas : src_pkt.subset_rt_blases)
+      {
+        free_uber_blas(&blas);
+      }
+
+      free_asset_metadata(&src_pkt.subsets);
+      free_asset_metadata(&src_pkt.subset_rt_blases);
+      free_asset_metadata(&src_pkt.materials);
+    } break;
+    case kMaterialFree:
+    {
+      MaterialFreePacket src_pkt;
+      push_buffer_pop(&streamer->residency_free_queue, &src_pkt, sizeof(src_pkt));
+
+      bit_free(&g_AssetRegistry->material_registry.gpu_material_slot_allocator, src_pkt.gpu_id);
+      free_asset_metadata(&src_pkt.textures);
+    } break;
+    case kTextureFree:
+    {
+      TextureFreePacket src_pkt;
+      push_buffer_pop(&streamer->residency_free_queue, &src_pkt, sizeof(src_pkt));
+
+      free_gpu_texture(&src_pkt.gpu_texture);
+      GPU_HEAP_FREE((GpuFreeHeap)streamer->gpu_texture_allocator, src_pkt.gpu_allocation);
+
+      // Descriptors can only be freed on the main thread
+      void* main_thread_memory = push_buffer_begin_edit(&streamer->main_thread_cmd_queue, sizeof(MainThreadCmdHeader) + sizeof(GpuDescriptor));
+      defer { push_buffer_end_edit(&streamer->main_thread_cmd_queue, main_thread_memory); };
+
+      void* scratch_memory     = main_thread_memory;
+
+      auto* dst_header         = (MainThreadCmdHeader*)ALLOC_OFF(scratch_memory, sizeof(MainThreadCmdHeader));
+      dst_header->cmd          = kTextureMainThreadFree;
+
+      auto* dst_descriptor     = (GpuDescriptor*      )ALLOC_OFF(scratch_memory, sizeof(GpuDescriptor));
+      *dst_descriptor          = src_pkt.srv_descriptor;
+    } break;
+    default: ASSERT_MSG_FATAL(false, "Invalid streaming command received %u!", header.cmd); break;
+  }
+
+  free_retired_bytes(&streamer->residency, header.cpu_bytes, header.gpu_bytes);
+}
+
+static bool
+process_asset_frees(AssetStreamer* streamer)
+{
+  bool ret = false;
+  while (true)
+  {
+    if (streamer->next_free_cmd.cmd == kNullStreamingCmd)
+    {
+      if (!try_push_buffer_pop(&streamer->residency_free_queue, &streamer->next_free_cmd, sizeof(AssetFreeCmdHeader)))
+      {
+        return ret;
+      }
+    }
+
+    // Same as process_gpu_io, have the fence wake us up once the GPU is done with it
+    FenceValue value = poll_gpu_fence_value(&streamer->residency_fence);
+    if (value < streamer->next_free_cmd.gpu_fence_value)
+    {
+      if (streamer->residency_wake_fence_value != streamer->next_free_cmd.gpu_fence_value)
+      {
+        signal_on_gpu_fence(&streamer->residency_fence, streamer->next_free_cmd.gpu_fence_value, &streamer->wake.event);
+        streamer->residency_wake_fence_value = streamer->next_free_cmd.gpu_fence_value;
+      }
+      return ret;
+    }
+
+    process_asset_free(streamer, streamer->next_free_cmd);
+    zero_memory(&streamer->next_free_cmd, sizeof(streamer->next_free_cmd));
+    ret = true;
+  }
+}
+
+static bool
+process_asset_residency(AssetStreamer* streamer)
+{
+  bool ret = process_asset_frees(streamer);
+
+  spin_acquire(&streamer->residency.lock);
+  AssetResidencyBudget budget = streamer->residency.budget;
+  spin_release(&streamer->residency.lock);
+
+  while (Asset* asset = take_asset_to_evict(&streamer->residency, budget))
+  {
+    // It could still have been used by the frame that was being recorded when it was released. That frame was
+    // recorded after the last signal (loaded after the asset was taken out of the list), so it's done at the next one.
+    FenceValue gpu_fence_value = atomic_load(streamer->residency_fence_value) + 1;
+    evict_asset(streamer, asset, gpu_fence_value);
+    ret = true;
+  }
+
+  atomic_store(&g_AssetStreamingStats.resident_cpu_bytes, streamer->residency.resident_cpu_bytes);
+  atomic_store(&g_AssetStreamingStats.resident_gpu_bytes, streamer->residency.resident_gpu_bytes);
+
+  return ret;
+}
+
+//////////////////////////////
+//        Load Queue        //
+//////////////////////////////
+
+// Enough for every model, material and texture to be waiting at once, an asset is never in the load queue twice
+static constexpr u32 kAssetLoadQueueSize        = kMaxAssets * 3;
+
+// All of these return whether they got anything done, the streaming thread only goes to sleep once nothing did
+static bool
+process_asset_load_queue(AssetStreamer* streamer)
+{
+  bool ret = false;
+
+  // The internal kicks skip anything whose load got cancelled while it was waiting
+  while (Asset* asset = try_pop_asset_load_queue(&streamer->load_queue, streamer->file_io_budget))
+  {
+    switch (asset->type)
+    {
+      case AssetType::kModel:    kick_model_load   (&g_AssetRegistry->model_registry,    streamer, asset->id); break;
+      case AssetType::kMaterial: kick_material_load(&g_AssetRegistry->material_registry, streamer, asset->id); break;
+      case AssetType::kTexture:  kick_texture_load (&g_AssetRegistry->texture_registry,  streamer, asset->id); break;
+      default: UNREACHABLE;
+    }
+    ret = true;
+  }
+
+  return ret;
+}
+
+static bool
 process_header_file_io(AssetStreamer* streamer)
 {
-  static constexpr u32 kMaxContentFileIoAssetsInFlight = 8;
+  bool ret = false;
 
-  // Rate limit the header file requests because file I/O buffer is often bottleneck and we don't want to fill it up too fast
-  while (streamer->file_io_assets_in_flight < kMaxContentFileIoAssetsInFlight)
+  while (true)
   {
     // Pop the next file I/O command off the stack if ready and we don't already have one that we're waiting for
     if (streamer->next_header_file_io_cmd.cmd == kNullStreamingCmd)
     {
       if (!try_push_buffer_pop(&streamer->header_file_io_buffer, &streamer->next_header_file_io_cmd, sizeof(FileStreamingCmdHeader)))
       {
-        return;
+        return ret;
       }
     }
 
-    AwaitError ready = await_io(streamer->next_header_file_io_cmd.file_promise, kFileIOBlockRateMs);
-    // If it's still in flight after some time, then move on and try again later
+    // Packed assets don't have a header read to wait on, their only read gets kicked once they're through the rate limiter
+    StreamingCmd cmd    = streamer->next_header_file_io_cmd.cmd;
+    bool         packed = cmd == kModelCpuStreamPacked || cmd == kMaterialCpuStreamPacked || cmd == kTextureCpuStreamPacked;
+
+    // Rate limit loose files by how many bytes the content reads have in flight, the file I/O buffer is often the
+    // bottleneck and we don't want to fill it up too fast.
+    //
+    // NOTE(bshihabi): Packed assets already went through the byte budget on their way out of the load queue. Holding
+    // them back here on bytes that are only queued (and not in flight) could stall the header queue for good.
+    if (!packed && streamer->file_io_budget.bytes_in_flight >= kMaxFileIoBytesInFlight)
+    {
+      return ret;
+    }
+
+    AwaitError ready = packed ? kAwaitCompleted : await_io(&streamer->next_header_file_io_cmd.file_promise, 0);
+    // If it's still in flight then move on, the wake event gets signaled when it's done
     if (ready == kAwaitInFlight)
     {
-      return;
+      return ret;
     }
 
     // Add the statistics
@@ -1502,19 +2269,29 @@ process_header_file_io(AssetStreamer* streamer)
 
     switch (streamer->next_header_file_io_cmd.cmd)
     {
-      case kModelCpuStreamHeader:    process_model_file_request   (streamer, streamer->next_header_file_io_cmd, ready);  break;
-      case kMaterialCpuStreamHeader: process_material_file_request(streamer, streamer->next_header_file_io_cmd, ready);  break;
-      case kTextureCpuStreamHeader:  process_texture_file_request (streamer, streamer->next_header_file_io_cmd, ready);  break;
-      default: ASSERT_MSG_FATAL(false, "Invalid streaming command received %u!", streamer->next_header_file_io_cmd.cmd); return;
+      case kModelCpuStreamHeader:
+      case kModelCpuStreamPacked:    process_model_file_request   (streamer, streamer->next_header_file_io_cmd, ready);  break;
+      case kMaterialCpuStreamHeader:
+      case kMaterialCpuStreamPacked: process_material_file_request(streamer, streamer->next_header_file_io_cmd, ready);  break;
+      case kTextureCpuStreamHeader:
+      case kTextureCpuStreamPacked:  process_texture_file_request (streamer, streamer->next_header_file_io_cmd, ready);  break;
+      default: ASSERT_MSG_FATAL(false, "Invalid streaming command received %u!", streamer->next_header_file_io_cmd.cmd); return ret;
     }
     zero_memory(&streamer->next_header_file_io_cmd, sizeof(streamer->next_header_file_io_cmd));
-    streamer->file_io_assets_in_flight++;
+
+    ASSERT_MSG_FATAL(streamer->file_io_budget.assets_queued > 0, "assets_queued is 0 which means there is a mismatch between pushes and pops of the header queue. This is a bug in the asset streamer.");
+    streamer->file_io_budget.assets_queued--;
+    ret = true;
   }
+
+  return ret;
 }
 
-static void
+static bool
 process_content_file_io(AssetStreamer* streamer)
 {
+  bool ret = false;
+
   // Consume in-flight content file I/O requests as fast as possible since they are the bottleneck typically
   while (true)
   {
@@ -1523,15 +2300,15 @@ process_content_file_io(AssetStreamer* streamer)
     {
       if (!try_push_buffer_pop(&streamer->content_file_io_buffer, &streamer->next_content_file_io_cmd, sizeof(FileStreamingCmdHeader)))
       {
-        return;
+        return ret;
       }
     }
 
-    AwaitError ready = await_io(streamer->next_content_file_io_cmd.file_promise, kFileIOBlockRateMs);
-    // If it's still in flight after some time, then move on and try again later
+    AwaitError ready = await_io(&streamer->next_content_file_io_cmd.file_promise, 0);
+    // If it's still in flight then move on, the wake event gets signaled when it's done
     if (ready == kAwaitInFlight)
     {
-      return;
+      return ret;
     }
 
     // Add the statistics
@@ -1544,18 +2321,21 @@ process_content_file_io(AssetStreamer* streamer)
       case kModelCpuStreamContent:    process_model_file_request   (streamer, streamer->next_content_file_io_cmd, ready); break;
       case kMaterialCpuStreamContent: process_material_file_request(streamer, streamer->next_content_file_io_cmd, ready); break;
       case kTextureCpuStreamContent:  process_texture_file_request (streamer, streamer->next_content_file_io_cmd, ready); break;
-      default: ASSERT_MSG_FATAL(false, "Invalid streaming command received %u!", streamer->next_content_file_io_cmd.cmd); return;
+      default: ASSERT_MSG_FATAL(false, "Invalid streaming command received %u!", streamer->next_content_file_io_cmd.cmd); return ret;
     }
+    u64 io_byte_count = streamer->next_content_file_io_cmd.io_byte_count;
     zero_memory(&streamer->next_content_file_io_cmd, sizeof(streamer->next_content_file_io_cmd));
 
-    ASSERT_MSG_FATAL(streamer->file_io_assets_in_flight > 0, "file_io_assets_in_flight is 0 which means there is a mismatch between increments and decrements for the rate limiter. This is a bug in the asset streamer.");
-    streamer->file_io_assets_in_flight--;
+    ASSERT_MSG_FATAL(streamer->file_io_budget.bytes_in_flight >= io_byte_count, "bytes_in_flight is less than what just finished which means there is a mismatch between increments and decrements for the rate limiter. This is a bug in the asset streamer.");
+    streamer->file_io_budget.bytes_in_flight -= io_byte_count;
+    ret = true;
   }
 }
 
-static void
+static bool
 process_gpu_io(AssetStreamer* streamer)
 {
+  bool ret = false;
   while (true)
   {
     // Pop the next file I/O command off the stack if ready and we don't already have one that we're waiting for
@@ -1563,15 +2343,20 @@ process_gpu_io(AssetStreamer* streamer)
     {
       if (!try_push_buffer_pop(&streamer->gpu_io_buffer, &streamer->next_gpu_cmd, sizeof(GpuStreamingCmdHeader)))
       {
-        return;
+        return ret;
       }
     }
 
     FenceValue value = poll_gpu_fence_value(&streamer->gpu_cmd_buffer_allocator.fence);
-    // If we're still waiting for the GPU to finish this command, then move on and try again later
+    // If we're still waiting for the GPU to finish this command, have the fence wake us up once it's done and move on
     if (value < streamer->next_gpu_cmd.gpu_fence_value)
     {
-      return;
+      if (streamer->gpu_wake_fence_value != streamer->next_gpu_cmd.gpu_fence_value)
+      {
+        signal_on_gpu_fence(&streamer->gpu_cmd_buffer_allocator.fence, streamer->next_gpu_cmd.gpu_fence_value, &streamer->wake.event);
+        streamer->gpu_wake_fence_value = streamer->next_gpu_cmd.gpu_fence_value;
+      }
+      return ret;
     }
 
     // Add the statistics
@@ -1598,31 +2383,37 @@ process_gpu_io(AssetStreamer* streamer)
     {
       ASSERT_MSG_FATAL(false, "Invalid streaming command received %u!", streamer->next_content_file_io_cmd.cmd);
     }
+    ret = true;
   }
 }
 
-static void
+static bool
 process_main_thread(AssetStreamer* streamer)
 {
+  bool ret = false;
   while (true)
   {
     MainThreadCmdHeader header;
     if (!try_push_buffer_pop(&streamer->main_thread_cmd_queue, &header, sizeof(header)))
     {
-      return;
+      return ret;
     }
 
     switch (header.cmd)
     {
-      case kTextureMainThreadInitialize: process_texture_main_thread(&streamer->main_thread_cmd_queue, header); break;
+      case kTextureMainThreadInitialize:
+      case kTextureMainThreadFree:       process_texture_main_thread(&streamer->main_thread_cmd_queue, header); break;
       default: ASSERT_MSG_FATAL(false, "Invalid streaming command received %u!", header.cmd); break;
     }
+    ret = true;
   }
 }
 
-static void
+static bool
 process_asset_dependencies(AssetStreamer* streamer)
 {
+  bool ret = false;
+
   // TODO(bshihabi): This is a bit hacky, but we basically copy all of the packets around to avoid cyclical dependencies.
   // This is my temporary solution for "out of order" consumption queue.
   u32 asset_count = streamer->num_asset_waiting_for_dependencies;
@@ -1663,7 +2454,7 @@ process_asset_dependencies(AssetStreamer* streamer)
         // Pop off the old packet since we pushed it around the queue
         push_buffer_pop(&streamer->asset_dependency_queue, sizeof(Asset*) * header.dependency_count + header.pkt_size);
 
-        return;
+        return ret;
       }
     }
 
@@ -1677,15 +2468,107 @@ process_asset_dependencies(AssetStreamer* streamer)
     }
 
     streamer->num_asset_waiting_for_dependencies--;
+    ret = true;
   }
+
+  return ret;
 }
 
+static void
+push_asset_stream_request(AssetStreamer* streamer, Asset* asset, AssetStreamRequestType type, f32 priority)
+{
+  AssetStreamRequest request;
+  request.asset    = asset;
+  request.type     = type;
+  request.priority = priority;
+
+  for (u32 itry = 0; /*TODO(bshihabi): Potentially put a max amount here in case of deadlock...*/ ; itry++)
+  {
+    bool ok = try_mpmc_ring_queue_push(&streamer->asset_stream_requests, request);
+
+    if (ok)
+    {
+      break;
+    }
+
+    if (itry == 0)
+    {
+      dbgln("Asset stream request queue is full! This will stall the calling thread requesting asset 0x%x (this should not be the case as it could hold up other work). Consider increasing the size of the ring queue for g_AssetStreamer->asset_streaming_requests.", asset->id);
+    }
+    _mm_pause();
+    _mm_pause();
+    _mm_pause();
+    _mm_pause();
+  }
+
+  wake_asset_streamer(&streamer->wake);
+}
+
+bool
+set_asset_stream_priority(const Asset* asset, f32 priority)
+{
+  // NOTE(bshihabi): Handles only hand out const Assets so that no one messes with the state from the outside, this is
+  // the streamer's own state so it's fine.
+  Asset* dst = const_cast<Asset*>(asset);
+  if (atomic_ref_load(&dst->state) != kAssetLoadRequested)
+  {
+    return false;
+  }
+
+  push_asset_stream_request(g_AssetStreamer, dst, kAssetStreamRequestReprioritize, priority);
+  return true;
+}
+
+bool
+cancel_asset_load(const Asset* asset)
+{
+  return cancel_asset_load_request(const_cast<Asset*>(asset));
+}
+
+void
+acquire_asset(const Asset* asset)
+{
+  AssetStreamer* streamer = g_AssetStreamer;
+  Asset*         dst      = const_cast<Asset*>(asset);
+
+  spin_acquire(&streamer->residency.lock);
+  acquire_asset_locked(&streamer->residency, dst);
+  spin_release(&streamer->residency.lock);
+}
+
+void
+release_asset(const Asset* asset)
+{
+  AssetStreamer* streamer = g_AssetStreamer;
+  Asset*         dst      = const_cast<Asset*>(asset);
+
+  spin_acquire(&streamer->residency.lock);
+  bool evictable = release_asset_locked(&streamer->residency, dst, false);
+  spin_release(&streamer->residency.lock);
+
+  if (evictable)
+  {
+    wake_asset_streamer(&streamer->wake);
+  }
+}
+
+void
+set_asset_residency_budget(const AssetResidencyBudget& budget)
+{
+  AssetStreamer* streamer = g_AssetStreamer;
+
+  spin_acquire(&streamer->residency.lock);
+  streamer->residency.budget = budget;
+  spin_release(&streamer->residency.lock);
+
+  wake_asset_streamer(&streamer->wake);
+}
 
 MaterialHandle
-kick_material_load(AssetId asset_id)
+kick_material_load(AssetId asset_id, f32 priority)
 {
   Material* material = nullptr;
-  ACQUIRE(&g_AssetRegistry->material_registry.asset_map, auto* asset_map)
+  ACQUIRE(sharded_hash_table_shard(&g_AssetRegistry->material_registry.asset_map, asset_id), auto* asset_map)
   {
     material = hash_table_find(asset_map, asset_id);
     if (material == nullptr)
@@ -1708,42 +2591,21 @@ kick_material_load(AssetId asset_id)
   ret.m_Id  = asset_id;
   ret.m_Ptr = material;
 
-  if (asset_id != kNullAssetId)
+  // Hold on to it before kicking it so that a release on another thread can't cancel this load
+  acquire_asset(&material->asset);
+  if (request_asset_load(&material->asset))
   {
-    for (u32 itry = 0; /*TODO(bshihabi): Potentially put a max amount here in case of deadlock...*/ ; itry++)
-    {
-      bool ok = ACQUIRE(&g_AssetStreamer->asset_stream_requests, auto* asset_stream_requests)
-      {
-        AssetStreamRequest request;
-        request.asset_type = AssetType::kMaterial;
-        request.asset_id   = asset_id;
-        return try_ring_queue_push(asset_stream_requests, request);
-      };
-
-      if (ok)
-      {
-        break;
-      }
-
-      if (itry == 0)
-      {
-        dbgln("Asset stream request queue is full! This will stall the calling thread requesting asset 0x%x (this should not be the case as it could hold up other work). Consider increasing the size of the ring queue for g_AssetStreamer->asset_streaming_requests.", asset_id);
-      }
-      _mm_pause();
-      _mm_pause();
-      _mm_pause();
-      _mm_pause();
-    }
+    push_asset_stream_request(g_AssetStreamer, &material->asset, kAssetStreamRequestLoad, priority);
   }
 
   return ret;
 }
 
 TextureHandle
-kick_texture_load(AssetId asset_id)
+kick_texture_load(AssetId asset_id, f32 priority)
 {
   Texture* texture = nullptr;
-  ACQUIRE(&g_AssetRegistry->texture_registry.asset_map, auto* asset_map)
+  ACQUIRE(sharded_hash_table_shard(&g_AssetRegistry->texture_registry.asset_map, asset_id), auto* asset_map)
   {
     texture = hash_table_find(asset_map, asset_id);
     if (texture == nullptr)
@@ -1767,32 +2629,11 @@ kick_texture_load(AssetId asset_id)
   ret.m_Id  = asset_id;
   ret.m_Ptr = texture;
 
-  if (asset_id != kNullAssetId)
+  // Hold on to it before kicking it so that a release on another thread can't cancel this load
+  acquire_asset(&texture->asset);
+  if (request_asset_load(&texture->asset))
   {
-    for (u32 itry = 0; /*TODO(bshihabi): Potentially put a max amount here in case of deadlock...*/ ; itry++)
-    {
-      bool ok = ACQUIRE(&g_AssetStreamer->asset_stream_requests, auto* asset_stream_requests)
-      {
-        AssetStreamRequest request;
-        request.asset_type = AssetType::kTexture;
-        request.asset_id   = asset_id;
-        return try_ring_queue_push(asset_stream_requests, request);
-      };
-
-      if (ok)
-      {
-        break;
-      }
-
-      if (itry == 0)
-      {
-        dbgln("Asset stream request queue is full! This will stall the calling thread requesting asset 0x%x (this should not be the case as it could hold up other work). Consider increasing the size of the ring queue for g_AssetStreamer->asset_streaming_requests.", asset_id);
-      }
-      _mm_pause();
-      _mm_pause();
-      _mm_pause();
-      _mm_pause();
-    }
+    push_asset_stream_request(g_AssetStreamer, &texture->asset, kAssetStreamRequestLoad, priority);
   }
 
   return ret;
@@ -1805,49 +2646,49 @@ asset_streaming_thread(void* param)
   while (!atomic_load(streamer->kill))
   {
     // Consume stuff from the asset stream queue to kick off asset loads
-    //
-    while (true)
+    bool progress = false;
+    AssetStreamRequest request;
+    while (try_mpmc_ring_queue_pop(&streamer->asset_stream_requests, &request))
     {
-      AssetStreamRequest request;
-      bool               got_request = false;
-      ACQUIRE(&streamer->asset_stream_requests, auto* asset_streaming_requests)
-      {
-        got_request = try_ring_queue_pop(asset_streaming_requests, &request);
-      };
+      update_asset_load_queue(&streamer->load_queue, request);
+      progress = true;
+    }
 
-      if (got_request)
-      {
-        switch (request.asset_type)
-        {
-          case AssetType::kModel:    kick_model_load   (&g_AssetRegistry->model_registry,    streamer, request.asset_id); break;
-          case AssetType::kMaterial: kick_material_load(&g_AssetRegistry->material_registry, streamer, request.asset_id); break;
-          case AssetType::kTexture:  kick_texture_load (&g_AssetRegistry->texture_registry,  streamer, request.asset_id); break;
-          default: UNREACHABLE;
-        }
+    progress |= process_asset_load_queue(streamer);
+    progress |= process_header_file_io(streamer);
+    progress |= process_content_file_io(streamer);
+    progress |= process_gpu_io(streamer);
+    progress |= process_asset_dependencies(streamer);
+    progress |= process_asset_residency(streamer);
 
-        _mm_pause();
-      }
-      else
-      {
-        break;
-      }
+    // Every read kicked during this pass goes to the kernel in one batch. Whatever it turns down stays queued and goes
+    // out with the next pass, at the latest once the wait below times out.
+    submit_async_io();
+
+    // NOTE(bshihabi): Only sleep after a pass that got nothing done, anything that completed while this pass was
+    // running already signaled the wake event so the wait falls right through.
+    if (progress)
+    {
+      continue;
     }
 
-    // Once there are no more for some period of time, start processing the file I/O
-    process_header_file_io(streamer);
-    process_content_file_io(streamer);
-    process_gpu_io(streamer);
-    process_asset_dependencies(streamer);
+    asset_streamer_sleep(&streamer->wake, kAssetStreamerWakeTimeoutMs, [streamer]()
+    {
+      return !mpmc_ring_queue_is_empty(&streamer->asset_stream_requests) || atomic_load(streamer->kill);
+    });
   }
 
   return 0;
 }
 
 static AssetStreamer*
-init_asset_streamer_impl(void)
+init_asset_streamer_impl(const CpuSet& cpus)
 {
   AssetStreamer* ret            = HEAP_ALLOC(AssetStreamer, g_InitHeap, 1);
-  ret->asset_stream_requests    = init_ring_queue<AssetStreamRequest>(g_InitHeap, kMaxAssetLoadRequests);
+  ret->asset_stream_requests    = init_mpmc_ring_queue<AssetStreamRequest>(g_InitHeap, kMaxAssetLoadRequests);
+  ret->load_queue               = init_asset_load_queue(g_InitHeap, kAssetLoadQueueSize);
+
+  ret->decompress_bounce_buffers = HEAP_ALLOC(u8, g_InitHeap, (u64)(get_job_system()->worker_count + 1) * kCompressionChunkSize);
 
 
   // TODO(bshihabi): These should probably be adjusted
@@ -1856,6 +2697,7 @@ init_asset_streamer_impl(void)
   u64 kGpuStreamQueueSize       = MiB(128);
   u64 kAssetDependencyQueueSize = MiB(8);
   u64 kMainThreadQueueSize      = MiB(1);
+  u64 kResidencyFreeQueueSize   = MiB(4);
   u32 kGpuStagingBufferSize     = MiB(128);
   u32 kGpuScratchBufferSize     = MiB(8);
 
@@ -1870,6 +2712,7 @@ init_asset_streamer_impl(void)
   ret->next_content_file_io_cmd.cmd       = kNullStreamingCmd;
   ret->next_gpu_cmd.cmd                   = kNullStreamingCmd;
   ret->num_asset_waiting_for_dependencies = 0;
+  ret->file_io_budget                     = AssetFileIoBudget();
 
   GpuBufferDesc staging_desc    = {0};
   staging_desc.size             = kGpuStagingBufferSize;
@@ -1880,18 +2723,43 @@ init_asset_streamer_impl(void)
   scratch_desc.flags            = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
   ret->gpu_scratch_buffer       = alloc_gpu_buffer_no_heap(g_GpuDevice, staging_desc, kGpuHeapGpuOnly, "BLAS Scratch Buffer");
 
-  ret->gpu_texture_allocator    = init_gpu_linear_allocator(kGpuTextureHeapSize, kGpuHeapGpuOnly);
+  u32 kMaxGpuTextures           = 0x4000;
+  ret->gpu_texture_allocator    = init_gpu_tlsf_allocator(g_InitHeap, kGpuTextureHeapSize, kMaxGpuTextures, kGpuHeapGpuOnly);
 
   ret->gpu_cmd_buffer_allocator = init_cmd_list_allocator(g_InitHeap, g_GpuDevice, &g_GpuDevice->compute_queue, 64);
   ret->gpu_cmd_buffer           = alloc_cmd_list(&ret->gpu_cmd_buffer_allocator);
 
-  u64 kModelSubsetAllocatorSize = MiB(16);
-  ret->metadata_allocator       = init_linear_allocator(kModelSubsetAllocatorSize, GiB(1));
+  init_asset_residency(&ret->residency);
+  ret->residency_free_queue          = init_push_buffer(KiB(4), kResidencyFreeQueueSize, MiB(16));
+  ret->next_free_cmd.cmd             = kNullStreamingCmd;
+  ret->residency_fence               = init_gpu_fence();
+  ret->residency_wake_fence_value    = 0;
+  ret->residency_fence_value         = 0;
+
+
+  ret->wake                     = init_asset_streamer_wake();
 
+  // The asset pack is optional, without one every asset gets loaded out of its own built asset file
+  ret->asset_pack               = AssetPack();
+  ret->asset_pack_file          = AsyncFileStream();
+  Result<AssetPack, FileError> asset_pack = open_asset_pack(kAssetPackPath);
+  if (asset_pack)
+  {
+    Result<AsyncFileStream, FileError> asset_pack_file = open_file_async(kAssetPackPath, kFileStreamRead);
+    if (asset_pack_file)
+    {
+      ret->asset_pack      = asset_pack.value();
+      ret->asset_pack_file = asset_pack_file.value();
+      dbgln("Streaming %u assets out of %s.", ret->asset_pack.entry_count, kAssetPackPath);
+    }
+    else
+    {
+      close_asset_pack(&asset_pack.value());
+    }
+  }
 
   static constexpr u64 kAssetStreamerStackSize = MiB(4);
-  static constexpr u32 kAssetStreamingCoreIdx  = 7;
-  ret->thread = init_thread(g_InitHeap, kAssetStreamerStackSize, &asset_streaming_thread, (void*)ret, kAssetStreamingCoreIdx);
+  ret->thread = init_thread(g_InitHeap, kAssetStreamerStackSize, &asset_streaming_thread, (void*)ret, cpus);
 
   set_thread_name(&ret->thread, L"Asset Streaming Thread");
 
@@ -1901,21 +2769,33 @@ init_asset_streamer_impl(void)
   g_AssetStreamingStats.gpu_io_elapsed_ms  = 0;
   g_AssetStreamingStats.file_io_bps           = 0.0;
   g_AssetStreamingStats.gpu_io_bps            = 0.0;
+  g_AssetStreamingStats.resident_cpu_bytes    = 0;
+  g_AssetStreamingStats.resident_gpu_bytes    = 0;
+  g_AssetStreamingStats.evicted_assets        = 0;
 
   return ret;
 }
 
 void
-init_asset_streamer(void)
+init_asset_streamer(const CpuSet& cpus)
 {
-  g_AssetStreamer = init_asset_streamer_impl();
+  g_AssetStreamer = init_asset_streamer_impl(cpus);
 }
 
 void
 destroy_asset_streamer(void)
 {
   atomic_store(&g_AssetStreamer->kill, true);
+  os_event_signal(&g_AssetStreamer->wake.event);
   join_threads(&g_AssetStreamer->thread, 1);
+  destroy_asset_streamer_wake(&g_AssetStreamer->wake);
+  destroy_gpu_fence(&g_AssetStreamer->residency_fence);
+
+  if (g_AssetStreamer->asset_pack.entries != nullptr)
+  {
+    close_file(&g_AssetStreamer->asset_pack_file);
+    close_asset_pack(&g_AssetStreamer->asset_pack);
+  }
 }
 
 static void
@@ -1924,13 +2804,24 @@ asset_streamer_flush(AssetStreamer* streamer)
   push_buffer_flush(&streamer->content_file_io_buffer);
   push_buffer_flush(&streamer->gpu_io_buffer);
   push_buffer_flush(&streamer->main_thread_cmd_queue);
+  push_buffer_flush(&streamer->residency_free_queue);
 }
 
 void
 asset_streamer_update(void)
 {
   asset_streamer_flush(g_AssetStreamer);
-  process_main_thread(g_AssetStreamer);
+
+  // Everything that was submitted before this is covered by this signal, which is what unloaded assets wait on
+  FenceValue residency_fence_value = cmd_queue_signal(&g_GpuDevice->graphics_queue, &g_AssetStreamer->residency_fence);
+  atomic_store(&g_AssetStreamer->residency_fence_value, residency_fence_value);
+
+  // Textures become ready here, which might be what something on the streaming thread is waiting on. The streaming
+  // thread only re-checks its request queue before going to sleep, so this can't skip the signal like the kicks do.
+  if (process_main_thread(g_AssetStreamer))
+  {
+    os_event_signal(&g_AssetStreamer->wake.event);
+  }
 
   u64 file_io_bytes       = atomic_exchange(&g_AssetStreamingStats.file_io_bpf,        0);
   u64 file_io_elapsed_ms  = atomic_exchange(&g_AssetStreamingStats.file_io_elapsed_ms, 0);
@@ -1976,11 +2867,11 @@ init_asset_registry(void)
 
 
 ModelHandle
-kick_model_load(AssetId asset_id)
+kick_model_load(AssetId asset_id, f32 priority)
 {
   Model* model = nullptr;
   // NOTE(bshihabi): There is a little contention here as everyone ends up touching the registry at the same time to initialize stuff. The hope is that this code is so quick that it doesn't matter.
-  ACQUIRE(&g_AssetRegistry->model_registry.asset_map, auto* asset_map)
+  ACQUIRE(sharded_hash_table_shard(&g_AssetRegistry->model_registry.asset_map, asset_id), auto* asset_map)
   {
     model = hash_table_find(asset_map, asset_id);
     if (model == nullptr)
@@ -2006,32 +2897,11 @@ kick_model_load(AssetId asset_id)
   ret.m_Id  = asset_id;
   ret.m_Ptr = model;
 
-  if (asset_id != kNullAssetId)
+  // Hold on to it before kicking it so that a release on another thread can't cancel this load
+  acquire_asset(&model->asset);
+  if (request_asset_load(&model->asset))
   {
-    for (u32 itry = 0; /*TODO(bshihabi): Potentially put a max amount here in case of deadlock...*/ ; itry++)
-    {
-      bool ok = ACQUIRE(&g_AssetStreamer->asset_stream_requests, auto* asset_stream_requests)
-      {
-        AssetStreamRequest request;
-        request.asset_type = AssetType::kModel;
-        request.asset_id   = asset_id;
-        return try_ring_queue_push(asset_stream_requests, request);
-      };
-
-      if (ok)
-      {
-        break;
-      }
-
-      if (itry == 0)
-      {
-        dbgln("Asset stream request queue is full! This will stall the calling thread requesting asset 0x%x (this should not be the case as it could hold up other work). Consider increasing the size of the ring queue for g_AssetStreamer->asset_streaming_requests.", asset_id);
-      }
-      _mm_pause();
-      _mm_pause();
-      _mm_pause();
-      _mm_pause();
-    }
+    push_asset_stream_request(g_AssetStreamer, &model->asset, kAssetStreamRequestLoad, priority);
   }
 
   return ret;
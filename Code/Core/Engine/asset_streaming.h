@@ -3,30 +3,12 @@
 #include "Core/Foundation/threading.h"
 
 #include "Core/Engine/constants.h"
+#include "Core/Engine/Streaming/asset.h"
 
 #include "Core/Engine/Render/graphics.h"
 
 static constexpr u32 kMaxAssetLoadRequests = 0x1000;
 
-enum AssetState : u32
-{
-  kAssetUnloaded = 0,
-  kAssetLoadRequested,
-  kAssetStreaming,
-  kAssetUninitialized,
-  kAssetReady,
-  kAssetFailedToLoad,
-  kAssetFailedToInitialize,
-};
-
-struct Asset
-{
-  AssetId    id       = kNullAssetId;
-  AssetType  type     = AssetType::kModel;
-  u32        state    = kAssetUnloaded;
-  u32        __pad0__ = 0;
-};
-
 // The template type needs to have a member "asset" of type "Asset"
 template <typename T>
 struct AssetHandle
@@ -87,6 +69,7 @@ struct Texture
   ColorSpaceName color_space;
 
   GpuTexture     gpu_texture;
+  GpuAllocation  gpu_allocation;
   GpuDescriptor  srv_descriptor;
 };
 typedef AssetHandle<Texture> TextureHandle;
@@ -106,6 +89,10 @@ struct ModelSubsetLod
   u32  index_start  = 0;
   u32  index_count  = 0;
   f32  error        = 0.0f;
+
+  // Where the LOD lives in the uber vertex/index buffers, so that it can be freed once the model is unloaded
+  SubAllocation vertex_allocation;
+  SubAllocation index_allocation;
 };
 
 struct ModelSubset
@@ -126,13 +113,29 @@ struct Model
 };
 typedef AssetHandle<Model> ModelHandle;
 
-            void           init_asset_streamer(void);
+            void           init_asset_streamer(const CpuSet& cpus);
             void           destroy_asset_streamer(void);
             void           asset_streamer_update(void);
             void           init_asset_registry(void);
-THREAD_SAFE ModelHandle    kick_model_load(AssetId asset_id);
-THREAD_SAFE MaterialHandle kick_material_load(AssetId asset_id);
-THREAD_SAFE TextureHandle  kick_texture_load(AssetId asset_id);
+// Kicking an asset that is already waiting in the load queue bumps it up to priority if that is higher. Models pass
+// their priority down to the materials they kick, and materials pass theirs down to their textures.
+//
+// Every kick holds on to the asset, call release_asset once the handle isn't needed anymore.
+THREAD_SAFE ModelHandle    kick_model_load(AssetId asset_id, f32 priority = kAssetStreamPriorityBackground);
+THREAD_SAFE MaterialHandle kick_material_load(AssetId asset_id, f32 priority = kAssetStreamPriorityBackground);
+THREAD_SAFE TextureHandle  kick_texture_load(AssetId asset_id, f32 priority = kAssetStreamPriorityBackground);
+// Moves an asset that is still waiting in the load queue up or down. Returns false if it's too late for that because the
+// asset already started streaming in (or was never kicked).
+THREAD_SAFE bool           set_asset_stream_priority(const Asset* asset, f32 priority);
+// Takes an asset that is still waiting in the load queue back out of it. Returns false if the asset already started
+// streaming in, it'll finish loading either way. release_asset does this once nothing holds on to the asset anymore.
+THREAD_SAFE bool           cancel_asset_load(const Asset* asset);
+// An asset stays loaded for as long as something holds on to it. Once nothing does, its load gets cancelled if it's
+// still waiting in the load queue, and if it's loaded it can get unloaded whenever it's over the residency budget.
+// Handles to an unloaded asset are still valid, kick it again to load it back in.
+THREAD_SAFE void           acquire_asset(const Asset* asset);
+THREAD_SAFE void           release_asset(const Asset* asset);
+THREAD_SAFE void           set_asset_residency_budget(const AssetResidencyBudget& budget);
 
 struct AssetStreamingStatistics
 {
@@ -141,6 +144,11 @@ struct AssetStreamingStatistics
   alignas(kCacheLineSize) Atomic<u64> gpu_io_bpf          = 0;
   alignas(kCacheLineSize) Atomic<u64> gpu_io_elapsed_ms   = 0;
 
+  // What's loaded right now, including assets that were unloaded but are waiting on the GPU before they get freed
+  alignas(kCacheLineSize) Atomic<u64> resident_cpu_bytes  = 0;
+  alignas(kCacheLineSize) Atomic<u64> resident_gpu_bytes  = 0;
+  alignas(kCacheLineSize) Atomic<u64> evicted_assets      = 0;
+
   // EMA-smoothed bandwidth in bytes/sec, updated on the main thread
   f64                                 file_io_bps         = 0.0;
   f64                                 gpu_io_bps          = 0.0;
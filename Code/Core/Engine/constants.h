@@ -5,6 +5,10 @@
 
 static constexpr u32 kMaxAssets    = 0x2000;
 
+// How many jobs can be in flight at once, and how many of those can be running or waiting on other jobs
+static constexpr u32 kMaxJobs       = 0x1000;
+static constexpr u32 kJobFiberCount = 0x100;
+
 static constexpr u32 kMaxDynamicSceneObjs = 0x500;
 static constexpr u32 kMaxStaticSceneObjs = 0x1500;
 static constexpr u32 kMaxSceneObjs = kMaxStaticSceneObjs + kMaxDynamicSceneObjs;
@@ -0,0 +1,285 @@
+#include "Core/Engine/fiber.h"
+
+#if defined(FIBER_USE_UCONTEXT)
+#include <ucontext.h>
+#endif
+
+#if defined(__SANITIZE_THREAD__)
+#define FIBER_TSAN 1
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define FIBER_TSAN 1
+#endif
+#endif
+
+#if defined(FIBER_TSAN)
+extern "C" void* __tsan_get_current_fiber();
+extern "C" void* __tsan_create_fiber(unsigned flags);
+extern "C" void  __tsan_destroy_fiber(void* fiber);
+extern "C" void  __tsan_switch_to_fiber(void* fiber, unsigned flags);
+#endif
+
+#if defined(_WIN32)
+
+Fiber
+init_fiber(size_t stack_size, FiberProc proc, void* param)
+{
+  Fiber ret      = {0};
+  ret.stack_size = stack_size;
+  // The OS reserves the stack (with a guard page) and only commits it as it grows
+  ret.context    = CreateFiberEx(kPageSize, stack_size, FIBER_FLAG_FLOAT_SWITCH, (LPFIBER_START_ROUTINE)proc, param);
+  ASSERT_MSG_FATAL(ret.context != nullptr, "Failed to create fiber with a 0x%llx byte stack.", (u64)stack_size);
+
+  return ret;
+}
+
+void
+destroy_fiber(Fiber* fiber)
+{
+  DeleteFiber(fiber->context);
+  zero_memory(fiber, sizeof(Fiber));
+}
+
+Fiber
+init_thread_fiber()
+{
+  Fiber ret   = {0};
+  ret.context = ConvertThreadToFiberEx(nullptr, FIBER_FLAG_FLOAT_SWITCH);
+  ASSERT_MSG_FATAL(ret.context != nullptr, "Failed to convert thread to a fiber, was it already converted?");
+
+  return ret;
+}
+
+void
+destroy_thread_fiber(Fiber* fiber)
+{
+  ConvertFiberToThread();
+  zero_memory(fiber, sizeof(Fiber));
+}
+
+void
+switch_to_fiber(Fiber* from, const Fiber* to)
+{
+  ASSERT(from->context == GetCurrentFiber());
+  SwitchToFiber(to->context);
+}
+
+#else
+
+// Stacks get one extra page at the bottom that never gets committed, overflowing into it segfaults right away.
+static u8*
+alloc_fiber_stack(size_t stack_size)
+{
+  u8* ret = (u8*)reserve_pages(stack_size + kPageSize);
+  ASSERT_MSG_FATAL(ret != nullptr, "Failed to reserve 0x%llx bytes for a fiber stack.", (u64)stack_size);
+
+  commit_pages(stack_size, ret + kPageSize);
+  return ret;
+}
+
+#if defined(FIBER_USE_UCONTEXT)
+
+struct UcontextFiber
+{
+  ucontext_t context;
+  FiberProc  proc  = nullptr;
+  void*      param = nullptr;
+};
+
+// makecontext only passes ints through, so the pointer gets split in two
+static void
+ucontext_fiber_entry(int lo, int hi)
+{
+  UcontextFiber* fiber = (UcontextFiber*)(((uintptr_t)(u32)hi << 32) | (uintptr_t)(u32)lo);
+  fiber->proc(fiber->param);
+
+  ASSERT_MSG_FATAL(false, "Fiber proc returned, fibers must switch away instead.");
+}
+
+Fiber
+init_fiber(size_t stack_size, FiberProc proc, void* param)
+{
+  ASSERT_MSG_FATAL(stack_size % kPageSize == 0, "Fiber stack size 0x%llx is not page aligned.", (u64)stack_size);
+
+  Fiber ret      = {0};
+  ret.stack      = alloc_fiber_stack(stack_size);
+  ret.stack_size = stack_size;
+
+  // The context lives at the very top of the stack memory, the stack grows down below it
+  size_t         context_size = ALIGN_POW2(sizeof(UcontextFiber), (size_t)16);
+  UcontextFiber* context      = (UcontextFiber*)(ret.stack + kPageSize + stack_size - context_size);
+  zero_memory(context, sizeof(UcontextFiber));
+  context->proc               = proc;
+  context->param              = param;
+
+  getcontext(&context->context);
+  context->context.uc_stack.ss_sp   = ret.stack + kPageSize;
+  context->context.uc_stack.ss_size = stack_size - context_size;
+  context->context.uc_link          = nullptr;
+  makecontext(&context->context, (void (*)())&ucontext_fiber_entry, 2, (int)(u32)(uintptr_t)context, (int)(u32)((uintptr_t)context >> 32));
+
+  ret.context    = context;
+
+#if defined(FIBER_TSAN)
+  ret.tsan_fiber = __tsan_create_fiber(0);
+#endif
+
+  return ret;
+}
+
+Fiber
+init_thread_fiber()
+{
+  Fiber ret   = {0};
+  ret.context = HEAP_ALLOC(UcontextFiber, GLOBAL_HEAP, 1);
+  zero_memory(ret.context, sizeof(UcontextFiber));
+
+#if defined(FIBER_TSAN)
+  ret.tsan_fiber = __tsan_get_current_fiber();
+#endif
+
+  return ret;
+}
+
+void
+destroy_thread_fiber(Fiber* fiber)
+{
+  HEAP_FREE(GLOBAL_HEAP, fiber->context);
+  zero_memory(fiber, sizeof(Fiber));
+}
+
+#else
+
+extern "C" void athena_switch_fiber_context(void** from_sp, void* to_sp);
+extern "C" void athena_fiber_trampoline();
+
+// Pushes the callee-saved registers onto the current stack, saves the stack pointer into from_sp, and pops
+// everything back off of to_sp. xmm registers are all caller-saved in SysV, so only mxcsr and the x87 control
+// word need to come along.
+//
+// A new fiber's stack is set up to look like it switched away right before calling athena_fiber_trampoline,
+// with the proc in r13 and its param in r12.
+asm(R"(
+  .text
+  .globl athena_switch_fiber_context
+  .type  athena_switch_fiber_context, @function
+  .p2align 4
+athena_switch_fiber_context:
+  pushq   %rbp
+  pushq   %rbx
+  pushq   %r12
+  pushq   %r13
+  pushq   %r14
+  pushq   %r15
+  subq    $8, %rsp
+  stmxcsr (%rsp)
+  fnstcw  4(%rsp)
+
+  movq    %rsp, (%rdi)
+  movq    %rsi, %rsp
+
+  ldmxcsr (%rsp)
+  fldcw   4(%rsp)
+  addq    $8, %rsp
+  popq    %r15
+  popq    %r14
+  popq    %r13
+  popq    %r12
+  popq    %rbx
+  popq    %rbp
+  ret
+  .size athena_switch_fiber_context, .-athena_switch_fiber_context
+
+  .globl athena_fiber_trampoline
+  .type  athena_fiber_trampoline, @function
+  .p2align 4
+athena_fiber_trampoline:
+  movq    %r12, %rdi
+  callq   *%r13
+  # Fiber procs can't return, there's nothing to return to
+  ud2
+  .size athena_fiber_trampoline, .-athena_fiber_trampoline
+)");
+
+// What athena_switch_fiber_context pops: mxcsr + x87 control word, r15, r14, r13, r12, rbx, rbp, return address
+static constexpr size_t kFiberSwitchFrameSize = 8 * 8;
+
+static constexpr u32    kDefaultMxcsr         = 0x1F80;
+static constexpr u16    kDefaultFpuControl    = 0x037F;
+
+Fiber
+init_fiber(size_t stack_size, FiberProc proc, void* param)
+{
+  ASSERT_MSG_FATAL(stack_size % kPageSize == 0, "Fiber stack size 0x%llx is not page aligned.", (u64)stack_size);
+
+  Fiber ret      = {0};
+  ret.stack      = alloc_fiber_stack(stack_size);
+  ret.stack_size = stack_size;
+
+  // The trampoline needs rsp to be 16 byte aligned at its call, so leave an empty 16 bytes at the top.
+  // That also leaves a null return address for debuggers to stop unwinding at.
+  uintptr_t stack_top = (uintptr_t)(ret.stack + kPageSize + stack_size) - 16;
+  u64*      frame     = (u64*)(stack_top - kFiberSwitchFrameSize);
+  zero_memory(frame, kFiberSwitchFrameSize + 16);
+
+  *(u32*)&frame[0]       = kDefaultMxcsr;
+  *((u16*)&frame[0] + 2) = kDefaultFpuControl;
+  frame[3]               = (u64)proc;
+  frame[4]               = (u64)param;
+  frame[7]               = (u64)&athena_fiber_trampoline;
+
+  ret.context            = frame;
+
+#if defined(FIBER_TSAN)
+  ret.tsan_fiber         = __tsan_create_fiber(0);
+#endif
+
+  return ret;
+}
+
+Fiber
+init_thread_fiber()
+{
+  Fiber ret = {0};
+
+#if defined(FIBER_TSAN)
+  ret.tsan_fiber = __tsan_get_current_fiber();
+#endif
+
+  return ret;
+}
+
+void
+destroy_thread_fiber(Fiber* fiber)
+{
+  zero_memory(fiber, sizeof(Fiber));
+}
+
+#endif
+
+void
+destroy_fiber(Fiber* fiber)
+{
+#if defined(FIBER_TSAN)
+  __tsan_destroy_fiber(fiber->tsan_fiber);
+#endif
+
+  free_pages(fiber->stack);
+  zero_memory(fiber, sizeof(Fiber));
+}
+
+void
+switch_to_fiber(Fiber* from, const Fiber* to)
+{
+#if defined(FIBER_TSAN)
+  __tsan_switch_to_fiber(to->tsan_fiber, 0);
+#endif
+
+#if defined(FIBER_USE_UCONTEXT)
+  swapcontext(&((UcontextFiber*)from->context)->context, &((UcontextFiber*)to->context)->context);
+#else
+  athena_switch_fiber_context(&from->context, to->context);
+#endif
+}
+
+#endif
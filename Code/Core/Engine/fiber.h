@@ -0,0 +1,45 @@
+#pragma once
+#include "Core/Foundation/types.h"
+#include "Core/Foundation/memory.h"
+
+// Fibers are cooperatively scheduled stacks. Switching between them is just saving the callee-saved registers and
+// swapping the stack pointer, so it's way cheaper than a thread context switch and never goes into the kernel.
+//
+// Backends:
+//  - Windows uses the OS fibers (CreateFiberEx/SwitchToFiber) since those also keep the TIB stack bounds
+//    and exception handling chain up to date for us.
+//  - x64 SysV (Linux) uses a tiny hand written context switch in fiber.cpp.
+//  - Anything else falls back to ucontext, which is a lot slower since swapcontext does a sigprocmask syscall.
+#if !defined(_WIN32) && !(defined(__x86_64__) && defined(__ELF__))
+#define FIBER_USE_UCONTEXT 1
+#endif
+
+// The function a fiber starts in. It must never return, switch to another fiber instead.
+typedef void (*FiberProc)(void* param);
+
+struct Fiber
+{
+  // The OS fiber handle on Windows, the saved stack pointer on SysV, the ucontext_t otherwise.
+  void*  context       = nullptr;
+
+  // Nullptr for thread fibers, the stack belongs to the thread.
+  u8*    stack         = nullptr;
+  size_t stack_size    = 0;
+
+  // Only used when running under ThreadSanitizer, which needs to be told about every switch.
+  void*  tsan_fiber    = nullptr;
+};
+
+// Stacks are reserved with a guard page below them so that stack overflows fault instead of silently trashing memory.
+Fiber init_fiber   (size_t stack_size, FiberProc proc, void* param);
+void  destroy_fiber(Fiber* fiber);
+
+// A thread needs a fiber of its own to switch away from (and back to) before it can run any other fibers.
+Fiber init_thread_fiber   ();
+void  destroy_thread_fiber(Fiber* fiber);
+
+// Saves the current state into from and resumes to. from must be the fiber that's running right now.
+//
+// NOTE(bshihabi): Fibers can get resumed on a different thread than the one they switched away from, so
+// don't hold on to anything thread_local across a switch. Read it again through a function that won't get inlined.
+void  switch_to_fiber(Fiber* from, const Fiber* to);
@@ -1,496 +1,538 @@
-#if 0
-#include "Core/Foundation/profiling.h"
-
 #include "Core/Engine/job_system.h"
 
-static JobSystem* g_job_system = nullptr;
+#include <wchar.h>
 
-thread_local u64 tls_worker_fiber_id = 0;
-thread_local u64 tls_job_fiber_id = 0;
+// How many times an idle worker goes looking for a job before it goes to sleep
+static constexpr u32 kJobWorkerSpinCount = 64;
 
-#if 0
-extern "C" void on_fiber_enter()
-{
-  if (tls_worker_fiber_id == 0)
-    return;
+static JobSystem* g_JobSystem = nullptr;
 
-  profiler::end_switch_to_fiber(tls_worker_fiber_id);
-}
+// The worker running on this thread, nullptr on any thread that isn't a job system worker
+static thread_local JobWorker* g_JobWorker = nullptr;
 
-extern "C" void on_fiber_exit()
+// Job fibers move between threads, so code running on one has to read the worker again after every switch. This can't
+// be inlined, otherwise the compiler is free to reuse the thread local's address from before the switch.
+static NO_INLINE JobWorker*
+get_current_job_worker()
 {
-  if (tls_worker_fiber_id == 0 || tls_job_fiber_id == 0)
-    return;
-
-  profiler::begin_switch_to_fiber(tls_worker_fiber_id, tls_job_fiber_id);
+  return g_JobWorker;
 }
-#endif
 
-Fiber
-init_fiber(void* stack, size_t stack_size, void* proc, void* param)
+static u32
+job_handle_index(JobHandle handle)
 {
-  ASSERT(stack_size >= 1);
-  ASSERT(stack != nullptr);
-  Fiber ret = {0};
-
-  uintptr_t stack_high       = (uintptr_t)stack + stack_size;
-  ASSERT((stack_high & 0xF) == 0x0);
-
-  ret.rip                = proc;
-  ret.rsp                = reinterpret_cast<void*>(stack_high);
-  ret.stack_high         = ret.rsp;
-  ret.stack_low          = stack;
-  ret.deallocation_stack = stack;
-  ret.rcx                = param;
-
-  return ret;
+  return (u32)(handle & 0xFFFFFFFF);
 }
 
-static JobQueue
-init_job_queue(MEMORY_ARENA_PARAM, size_t size)
+static u32
+job_handle_generation(JobHandle handle)
 {
-  JobQueue ret = {0};
-  size *= sizeof(JobDesc);
-  ret.queue = init_ring_buffer(MEMORY_ARENA_FWD, alignof(JobDesc), size);
-
-  return ret;
+  return (u32)(handle >> 32);
 }
 
-static void
-enqueue_jobs(JobQueue* job_queue, const JobDesc* jobs, size_t count)
+static JobCounter*
+get_job_counter(JobSystem* job_system, JobHandle handle)
 {
-  spin_acquire(&job_queue->lock);
-  defer { spin_release(&job_queue->lock); };
-
-  ring_buffer_push(&job_queue->queue, jobs, count * sizeof(JobDesc));
+  u32 index = job_handle_index(handle);
+  ASSERT_MSG_FATAL(index < job_system->counter_count, "Invalid job handle 0x%llx.", handle);
+  return &job_system->counters[index];
 }
 
-static bool
-dequeue_job(JobQueue* job_queue, JobDesc* out)
+static u64
+next_random(u64* state)
 {
-  ASSERT(out != nullptr);
-  spin_acquire(&job_queue->lock);
-  defer { spin_release(&job_queue->lock); };
-
-  return try_ring_buffer_pop(&job_queue->queue, sizeof(JobDesc), out);
+  // xorshift64
+  u64 x  = *state;
+  x     ^= x << 13;
+  x     ^= x >> 7;
+  x     ^= x << 17;
+  *state = x;
+  return x;
 }
 
+// The free lists and injection queues have room for everything that could ever be in them at once, but a pop that's
+// still in flight on another thread keeps its slot busy for a moment, so a push can still (very rarely) come back full.
+template <typename T>
 static void
-enqueue_working_job(WorkingJobQueue* queue, WorkingJob* job)
+job_queue_push(MpmcRingQueue<T>* queue, const T& value)
 {
-  ASSERT(job->next == nullptr);
-
-  if (queue->head == nullptr) 
+  while (!try_mpmc_ring_queue_push(queue, value))
   {
-    queue->head = queue->tail = job;
-    return;
+    _mm_pause();
   }
-
-  ASSERT(queue->tail != nullptr);
-
-  queue->tail = queue->tail->next = job;
 }
 
-static void
-enqueue_working_jobs(WorkingJobQueue* queue, WorkingJobQueue* jobs) 
+static JobDeque
+init_job_deque(AllocHeap heap, u32 size)
 {
-  if (queue->head == nullptr) 
-  {
-    *queue = *jobs;
-    return;
-  }
+  ASSERT_MSG_FATAL(is_pow2(size), "Job deque size %u must be a power of 2.", size);
 
-  ASSERT(queue->tail != nullptr);
+  JobDeque ret;
+  ret.jobs = HEAP_ALLOC(Job*, heap, size);
+  zero_memory(ret.jobs, sizeof(Job*) * size);
+  ret.mask = size - 1;
 
-  queue->tail->next = jobs->head;
-  queue->tail = jobs->tail;
+  return ret;
 }
 
+// Only the owning worker can push. Returns false if the deque is full.
 static bool
-dequeue_working_job(WorkingJobQueue* queue, WorkingJob** out)
+job_deque_push(JobDeque* deque, Job* job)
 {
-  ASSERT(out != nullptr);
-
-  if (queue->head == nullptr)
-    return false;
-
-  *out = queue->head;
-  queue->head = queue->head->next;
-
-  if (queue->head == nullptr)
+  s64 bottom = atomic_ref_load(&deque->bottom, std::memory_order_relaxed);
+  s64 top    = atomic_ref_load(&deque->top,    std::memory_order_acquire);
+  if (bottom - top > deque->mask)
   {
-    queue->tail = nullptr;
+    return false;
   }
 
-  (*out)->next = nullptr;
-
+  atomic_ref_store(&deque->jobs[bottom & deque->mask], job, std::memory_order_relaxed);
+  // Release so that a thief that sees the new bottom also sees the job
+  atomic_ref_store(&deque->bottom, bottom + 1, std::memory_order_release);
   return true;
 }
 
-enum JobType : u8
+// Only the owning worker can take.
+static Job*
+job_deque_take(JobDeque* deque)
 {
-  JOB_TYPE_INVALID,
-  JOB_TYPE_LAUNCH,
-  JOB_TYPE_WORKING,
-
-  JOB_TYPE_COUNT,
-};
+  s64 bottom = atomic_ref_load(&deque->bottom, std::memory_order_relaxed) - 1;
+  atomic_ref_store(&deque->bottom, bottom, std::memory_order_release);
+  // Thieves have to either see the smaller bottom or we have to see their bigger top, this is the one place a full
+  // fence (mfence on x64) is unavoidable.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  s64 top    = atomic_ref_load(&deque->top, std::memory_order_relaxed);
 
-static JobType
-wait_for_next_job(JobSystem* job_system, JobDesc* job_out, WorkingJob** working_job_out)
-{
-  while (!job_system->should_exit)
+  if (top > bottom)
   {
-    if (ACQUIRE(&job_system->working_jobs_queue, auto* q) {
-      return dequeue_working_job(q, working_job_out); 
-    })
-      return JOB_TYPE_WORKING;
-
-    if (dequeue_job(&job_system->high_priority, job_out))
-      return JOB_TYPE_LAUNCH;
-
-    if (dequeue_job(&job_system->medium_priority, job_out))
-      return JOB_TYPE_LAUNCH;
+    // Empty
+    atomic_ref_store(&deque->bottom, bottom + 1, std::memory_order_release);
+    return nullptr;
   }
-  return JOB_TYPE_INVALID;
-}
 
-static JobType
-wait_for_async_job(JobSystem* job_system, JobDesc* job_out)
-{
-  while (!job_system->should_exit)
+  Job* ret = atomic_ref_load(&deque->jobs[bottom & deque->mask], std::memory_order_relaxed);
+  if (top == bottom)
   {
-    if (dequeue_job(&job_system->low_priority, job_out))
-      return JOB_TYPE_LAUNCH;
+    // This is the last job, so we're racing the thieves for it.
+    if (!atomic_ref_compare_exchange_strong(&deque->top, &top, top + 1, std::memory_order_seq_cst))
+    {
+      ret = nullptr;
+    }
+    atomic_ref_store(&deque->bottom, bottom + 1, std::memory_order_release);
   }
 
-  return JOB_TYPE_INVALID;
+  return ret;
 }
 
-JobSystem*
-init_job_system(MEMORY_ARENA_PARAM, size_t job_queue_size)
+// Any worker can steal.
+static Job*
+job_deque_steal(JobDeque* deque)
 {
-  ASSERT(g_job_system == nullptr);
-  JobSystem* ret = push_memory_arena<JobSystem>(MEMORY_ARENA_FWD);
-  zero_memory(ret, sizeof(JobSystem));
+  s64 top    = atomic_ref_load(&deque->top, std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  s64 bottom = atomic_ref_load(&deque->bottom, std::memory_order_acquire);
 
-  ret->high_priority = init_job_queue(MEMORY_ARENA_FWD, job_queue_size);
-  ret->medium_priority = init_job_queue(MEMORY_ARENA_FWD, job_queue_size);
-  ret->low_priority = init_job_queue(MEMORY_ARENA_FWD, job_queue_size);
-
-  ret->job_stack_allocator = init_pool<JobStack>(MEMORY_ARENA_FWD, job_queue_size / 2);
-
-  ret->working_job_allocator = init_pool<WorkingJob>(MEMORY_ARENA_FWD, job_queue_size / 2);
-  ret->job_counters = init_hash_table<JobHandle, JobCounter>(MEMORY_ARENA_FWD, 128);
+  if (top >= bottom)
+  {
+    return nullptr;
+  }
 
-  g_job_system = ret;
+  Job* ret = atomic_ref_load(&deque->jobs[top & deque->mask], std::memory_order_relaxed);
+  if (!atomic_ref_compare_exchange_strong(&deque->top, &top, top + 1, std::memory_order_seq_cst))
+  {
+    // Lost the race to the owner or another thief
+    return nullptr;
+  }
 
   return ret;
 }
 
-thread_local Fiber* tls_fiber = nullptr;
-
-enum YieldParamType : u8
+static void
+wake_job_workers(JobSystem* job_system, u32 job_count)
 {
-  YIELD_PARAM_JOB_COUNTER,
-};
+  // Same deal as MpmcRingQueue, the signal has to be bumped before checking for sleepers.
+  atomic_ref_fetch_add(&job_system->work_signal, 1);
+  if (atomic_ref_load(&job_system->sleepers) == 0)
+  {
+    return;
+  }
 
-struct YieldParam
+  if (job_count > 1)
+  {
+    wake_all_on_address(&job_system->work_signal);
+  }
+  else
+  {
+    wake_one_on_address(&job_system->work_signal);
+  }
+}
+
+// worker is nullptr when this isn't called from a worker thread.
+static void
+push_job(JobSystem* job_system, JobWorker* worker, Job* job)
 {
-  YieldParamType type = YIELD_PARAM_JOB_COUNTER;
-  union
+  if (worker != nullptr && job_deque_push(&worker->deques[job->priority], job))
   {
-    JobHandle job_counter;
-  };
-};
+    return;
+  }
 
-thread_local YieldParam tls_yield_param;
+  job_queue_push(&job_system->injection_queues[job->priority], job);
+}
 
-void
-yield_to_counter(JobHandle counter)
+static Job*
+find_job(JobSystem* job_system, JobWorker* worker)
 {
-  ASSERT(tls_fiber != nullptr);
-  tls_yield_param.job_counter = counter;
-  tls_yield_param.type = YIELD_PARAM_JOB_COUNTER;
+  for (u32 ipriority = 0; ipriority < kJobPriorityCount; ipriority++)
+  {
+    Job* job = job_deque_take(&worker->deques[ipriority]);
+    if (job != nullptr)
+    {
+      return job;
+    }
+
+    if (try_mpmc_ring_queue_pop(&job_system->injection_queues[ipriority], &job))
+    {
+      return job;
+    }
+
+    // Start at a random victim so that every idle worker doesn't pile onto the same one
+    u32 start = (u32)(next_random(&worker->rng) % job_system->worker_count);
+    for (u32 i = 0; i < job_system->worker_count; i++)
+    {
+      u32 victim = (start + i) % job_system->worker_count;
+      if (victim == worker->index)
+      {
+        continue;
+      }
 
-//  save_to_fiber(tls_fiber, tls_fiber->stack_high);
+      job = job_deque_steal(&job_system->workers[victim].deques[ipriority]);
+      if (job != nullptr)
+      {
+        return job;
+      }
+    }
+  }
+
+  return nullptr;
 }
 
-static void
-signal_job_counter(JobSystem* job_system, JobHandle signal)
+// Returns nullptr when the job system is shutting down.
+static Job*
+wait_for_job(JobSystem* job_system, JobWorker* worker)
 {
-  Option<WorkingJobQueue> woken_jobs = ACQUIRE(&job_system->job_counters, auto* counters) -> Option<WorkingJobQueue>
+  for (;;)
   {
-    JobCounter* counter = unwrap(hash_table_find(counters, signal));
-    ASSERT(counter->value > 0);
-    auto value = InterlockedDecrement(&counter->value);
-    if (value == 0)
+    // Spin for a bit first, waking a sleeping thread back up is way more expensive than a couple of failed steals.
+    for (u32 ispin = 0; ispin < kJobWorkerSpinCount; ispin++)
     {
-      WorkingJobQueue waiting = counter->waiting_jobs;
-      if (counter->completion_signal)
+      if (atomic_ref_load(&job_system->should_exit, std::memory_order_relaxed))
+      {
+        return nullptr;
+      }
+
+      Job* job = find_job(job_system, worker);
+      if (job != nullptr)
       {
-        notify_all_thread_signal(unwrap(counter->completion_signal));
+        return job;
       }
-      hash_table_erase(counters, signal);
-      return waiting;
+      _mm_pause();
     }
 
-    return None;
-  };
+    u32  signal = atomic_ref_load(&job_system->work_signal);
+    Job* job    = find_job(job_system, worker);
+    if (job != nullptr)
+    {
+      return job;
+    }
 
-  if (!woken_jobs)
-    return;
+    if (atomic_ref_load(&job_system->should_exit))
+    {
+      return nullptr;
+    }
 
-  ACQUIRE(&job_system->working_jobs_queue, auto* working_jobs_queue)
-  {
-    enqueue_working_jobs(working_jobs_queue, &unwrap(woken_jobs));
-  };
+    // Anyone that queues work after we read the signal either bumps it before we go to sleep (so we don't) or sees us sleeping and wakes us.
+    atomic_ref_fetch_add(&job_system->sleepers, 1);
+    wait_on_address(&job_system->work_signal, &signal, sizeof(signal));
+    atomic_ref_fetch_sub(&job_system->sleepers, 1);
+  }
 }
 
 static void
-working_job_wait_for_counter(JobSystem* job_system,
-                             JobHandle signal,
-                             WorkingJob* working_job)
+finish_job_counter(JobSystem* job_system, JobWorker* worker, JobHandle handle)
 {
-  bool res = ACQUIRE(&job_system->job_counters, auto* job_counters)
+  JobCounter* counter = get_job_counter(job_system, handle);
+  // acq_rel so that whoever takes the counter to 0 sees everything every other job on the counter did
+  if (atomic_ref_fetch_sub(&counter->value, 1, std::memory_order_acq_rel) != 1)
+  {
+    return;
+  }
+
+  spin_acquire(&counter->lock);
+  Job* waiters     = counter->waiters;
+  counter->waiters = nullptr;
+
+  u32 generation   = counter->generation + 1;
+  // A generation of 0 could make a handle of 0, which is reserved
+  if (generation == 0)
   {
-    auto maybe_counter = hash_table_find(job_counters, signal);
-    if (!maybe_counter)
-      return false;
+    generation = 1;
+  }
+  atomic_ref_store(&counter->generation, generation);
+  spin_release(&counter->lock);
 
-    JobCounter* counter = unwrap(maybe_counter);
-    enqueue_working_job(&counter->waiting_jobs, working_job);
-    return true;
-  };
+  if (atomic_ref_load(&counter->thread_waiters) > 0)
+  {
+    wake_all_on_address(&counter->generation);
+  }
 
-  if (res)
-    return;
+  u32 woken_count = 0;
+  while (waiters != nullptr)
+  {
+    Job* next            = waiters->next_waiter;
+    waiters->next_waiter = nullptr;
+    push_job(job_system, worker, waiters);
+
+    waiters = next;
+    woken_count++;
+  }
+
+  // Handles with the old generation read as completed from here on, so the counter can be reused right away.
+  job_queue_push(&job_system->free_counters, job_handle_index(handle));
 
-  ACQUIRE(&job_system->working_jobs_queue, auto* working_jobs_queue)
+  // A worker picks up one of the woken jobs itself, anything else (e.g. the main thread signalling) doesn't run jobs
+  if (worker != nullptr && woken_count > 0)
   {
-    enqueue_working_job(working_jobs_queue, working_job);
-  };
+    woken_count--;
+  }
+
+  if (woken_count > 0)
+  {
+    wake_job_workers(job_system, woken_count);
+  }
 }
 
 static void
-finish_job(JobSystem* job_system, JobStack* job_stack, JobHandle completion_signal)
+wait_on_job_counter(JobSystem* job_system, JobWorker* worker, Job* job, JobHandle handle)
 {
-  ACQUIRE(&job_system->job_stack_allocator, auto* allocator) {
-    pool_free(allocator, job_stack);
-  };
+  JobCounter* counter = get_job_counter(job_system, handle);
 
-  signal_job_counter(job_system, completion_signal);
+  bool waiting = false;
+  spin_acquire(&counter->lock);
+  if (counter->generation == job_handle_generation(handle))
+  {
+    job->next_waiter = counter->waiters;
+    counter->waiters = job;
+    waiting          = true;
+  }
+  spin_release(&counter->lock);
+
+  // The counter finished while the job was switching out, it can keep going right away.
+  if (!waiting)
+  {
+    push_job(job_system, worker, job);
+  }
 }
 
 static void
-yield_working_job(JobSystem* job_system, WorkingJob* working_job)
+job_fiber_proc(void* param)
 {
-  switch (tls_yield_param.type)
+  JobFiber* self = (JobFiber*)param;
+  for (;;)
   {
-    case YIELD_PARAM_JOB_COUNTER: 
-    {
-      working_job_wait_for_counter(job_system, tls_yield_param.job_counter, working_job);
-      break;
-    }
-    default:
-      UNREACHABLE;
+    Job* job = self->job;
+    job->entry.func_ptr(job->entry.params + job->entry.param_offset);
+
+    JobWorker* worker = get_current_job_worker();
+    worker->event     = kJobWorkerEventFinished;
+    switch_to_fiber(&self->fiber, &worker->scheduler_fiber);
   }
 }
 
 static void
-launch_job(JobSystem* job_system, JobDesc job, bool can_yield = true)
+run_job(JobSystem* job_system, JobWorker* worker, Job* job)
 {
-  JobStack* stack = ACQUIRE(&job_system->job_stack_allocator, auto* allocator)
+  if (job->fiber == kJobNoFiber)
   {
-    return pool_alloc(allocator);
-  };
+    u32 fiber = 0;
+    if (!try_mpmc_ring_queue_pop(&job_system->free_fibers, &fiber))
+    {
+      // Every fiber is taken by a job that's either running or waiting. Put this one at the back of the line, eventually
+      // we'll get to something that already has a fiber and can finish.
+      job_queue_push(&job_system->injection_queues[job->priority], job);
+      _mm_pause();
+      return;
+    }
 
-  MemoryArena scratch_arena = {0};
-  scratch_arena.start = reinterpret_cast<uintptr_t>(stack->scratch_buf);
-  scratch_arena.size = DEFAULT_SCRATCH_SIZE;
-  scratch_arena.pos = scratch_arena.start;
+    job->fiber                    = fiber;
+    job_system->fibers[fiber].job = job;
+  }
 
-  Context ctx = init_thread_context();
+  JobFiber* fiber       = &job_system->fibers[job->fiber];
+  worker->current_fiber = job->fiber;
+  worker->event         = kJobWorkerEventNone;
 
-  Fiber fiber = init_fiber(stack->memory, STACK_SIZE, job.entry.func_ptr, job.entry.params + job.entry.param_offset);
-  tls_fiber = &fiber;
+  Context* prev_ctx     = swap_thread_context(&fiber->ctx);
+  switch_to_fiber(&worker->scheduler_fiber, &fiber->fiber);
+  swap_thread_context(prev_ctx);
 
-  auto* stack_high_before = fiber.stack_high;
-  ASSERT(fiber.rip != nullptr);
-  push_context(ctx);
+  worker->current_fiber = kJobNoFiber;
 
-  tls_job_fiber_id = job.completion_signal;
+  switch (worker->event)
+  {
+    case kJobWorkerEventFinished:
+    {
+      JobHandle counter = job->counter;
 
-#if 0
-  profiler::register_fiber(tls_job_fiber_id);
-  profiler::begin_switch_to_fiber(tls_worker_fiber_id, tls_job_fiber_id);
-#endif
+      // Anything the job scratch allocated goes away with it
+      reset_stack(&fiber->ctx.scratch_allocator);
+      fiber->job = nullptr;
+      job_queue_push(&job_system->free_fibers, job->fiber);
+      concurrent_pool_free(&job_system->job_pool, job);
 
-//  launch_fiber(&fiber);
+      finish_job_counter(job_system, worker, counter);
+    } break;
+    case kJobWorkerEventWaiting:
+    {
+      wait_on_job_counter(job_system, worker, job, worker->wait_counter);
+    } break;
+    default: UNREACHABLE;
+  }
+}
 
-#if 0
-  profiler::end_switch_to_fiber(tls_job_fiber_id);
-#endif
+static u32
+job_worker_proc(void* param)
+{
+  JobWorker* worker       = (JobWorker*)param;
+  JobSystem* job_system   = worker->job_system;
 
-  ctx = pop_context();
-  ASSERT(fiber.stack_high == stack_high_before);
+  g_JobWorker             = worker;
+  worker->scheduler_fiber = init_thread_fiber();
 
-  // The job actually finished, means we can recycle everything.
-  if (!fiber.yielded)
+  for (;;)
   {
-#if 0
-    profiler::unregister_fiber(job.completion_signal);
-#endif
-    finish_job(job_system, stack, job.completion_signal);
-    return;
-  }
+    Job* job = wait_for_job(job_system, worker);
+    if (job == nullptr)
+    {
+      break;
+    }
 
-  ASSERT(can_yield);
+    run_job(job_system, worker, job);
+  }
 
-  WorkingJob* working_job = ACQUIRE(&job_system->working_job_allocator, auto* allocator)
-  {
-    return pool_alloc(allocator);
-  };
+  destroy_thread_fiber(&worker->scheduler_fiber);
+  g_JobWorker             = nullptr;
 
-  working_job->job = job;
-  working_job->fiber = fiber;
-  working_job->stack = stack;
-  working_job->next = nullptr;
-  working_job->ctx = ctx;
-  yield_working_job(job_system, working_job);
+  return 0;
 }
 
-static void
-resume_working_job(JobSystem* job_system, WorkingJob* working_job)
+JobSystem*
+init_job_system(AllocHeap heap, u32 max_jobs, u32 fiber_count, u32 worker_count)
 {
-  push_context(working_job->ctx);
-  tls_fiber = &working_job->fiber;
-
-  tls_job_fiber_id = working_job->job.completion_signal;
-#if 0
-  profiler::begin_switch_to_fiber(tls_worker_fiber_id, tls_job_fiber_id);
-#endif
-
-//  resume_fiber(&working_job->fiber, working_job->fiber.stack_high);
+  ASSERT(g_JobSystem == nullptr);
+  ASSERT_MSG_FATAL(max_jobs > 0 && fiber_count > 0, "Job system needs room for at least one job and fiber.");
 
-#if 0
-  profiler::end_switch_to_fiber(tls_job_fiber_id);
-#endif
+  if (worker_count == 0)
+  {
+    worker_count = get_num_physical_cores();
+  }
+  worker_count = CLAMP(worker_count, 1u, kMaxJobWorkers);
 
-  working_job->ctx = pop_context();
+  JobSystem* ret = HEAP_ALLOC(JobSystem, heap, 1);
+  zero_memory(ret, sizeof(JobSystem));
 
-  // The job actually finished, means we can recycle everything.
-  if (!working_job->fiber.yielded)
+  ret->worker_count = worker_count;
+  ret->workers      = HEAP_ALLOC(JobWorker, heap, worker_count);
+  for (u32 iworker = 0; iworker < worker_count; iworker++)
   {
-    finish_job(job_system, working_job->stack, working_job->job.completion_signal);
-    ACQUIRE(&job_system->working_job_allocator, auto* allocator)
+    JobWorker* worker  = &ret->workers[iworker];
+    zero_memory(worker, sizeof(JobWorker));
+    worker->job_system    = ret;
+    worker->index         = iworker;
+    worker->current_fiber = kJobNoFiber;
+    // xorshift can't start at 0
+    worker->rng           = (iworker + 1) * 0x9E3779B97F4A7C15ULL;
+
+    for (u32 ipriority = 0; ipriority < kJobPriorityCount; ipriority++)
     {
-      pool_free(allocator, working_job);
-    };
-    return;
+      worker->deques[ipriority] = init_job_deque(heap, kJobDequeSize);
+    }
   }
 
-  working_job->next = nullptr;
-  yield_working_job(job_system, working_job);
-}
+  ret->fiber_count = fiber_count;
+  ret->fibers      = HEAP_ALLOC(JobFiber, heap, fiber_count);
+  ret->free_fibers = init_mpmc_ring_queue<u32>(heap, fiber_count * 2);
+  for (u32 ifiber = 0; ifiber < fiber_count; ifiber++)
+  {
+    JobFiber* fiber = &ret->fibers[ifiber];
+    zero_memory(fiber, sizeof(JobFiber));
+    fiber->fiber    = init_fiber(kJobStackSize, &job_fiber_proc, fiber);
+    fiber->ctx      = init_context(kJobScratchCommitSize, kJobScratchReserveSize);
 
-struct JobWorkerThreadParams
-{
-  JobSystem* job_system = nullptr;
-};
+    job_queue_push(&ret->free_fibers, ifiber);
+  }
 
-static u32
-job_worker(void* param)
-{
-  tls_worker_fiber_id = (u64)param;
-#if 0
-  profiler::register_fiber(tls_worker_fiber_id);
-#endif
+  // Every thread can be sitting on up to 2 magazines worth of free blocks in the pool, so give it some headroom
+  // to make sure max_jobs can actually be in flight at once.
+  u32 job_capacity = max_jobs + (worker_count + 1) * 2 * kPoolMagazineSize;
+  ret->job_pool    = init_concurrent_pool<Job>(heap, job_capacity);
+  for (u32 ipriority = 0; ipriority < kJobPriorityCount; ipriority++)
+  {
+    ret->injection_queues[ipriority] = init_mpmc_ring_queue<Job*>(heap, job_capacity * 2);
+  }
 
-  while (!g_job_system->should_exit)
+  ret->counter_count = max_jobs;
+  ret->counters      = HEAP_ALLOC(JobCounter, heap, max_jobs);
+  ret->free_counters = init_mpmc_ring_queue<u32>(heap, max_jobs * 2);
+  for (u32 icounter = 0; icounter < max_jobs; icounter++)
   {
-    JobDesc job = {0};
-    WorkingJob* working_job = nullptr;
-    JobType type = wait_for_next_job(g_job_system, &job, &working_job);
-    switch(type)
-    {
-      case JOB_TYPE_LAUNCH:
-      {
-        launch_job(g_job_system, job);
-      } break;
-      case JOB_TYPE_WORKING:
-      {
-        resume_working_job(g_job_system, working_job);
-      } break;
-      case JOB_TYPE_INVALID:
-      {
-        return 0;
-      } break;
-      default:
-        UNREACHABLE;
-    }
+    JobCounter* counter = &ret->counters[icounter];
+    zero_memory(counter, sizeof(JobCounter));
+    counter->generation = 1;
+    counter->lock       = init_spin_lock();
+
+    job_queue_push(&ret->free_counters, icounter);
   }
-  return 0;
+
+  g_JobSystem = ret;
+
+  return ret;
 }
 
-static u32
-async_worker(void* param)
+void
+destroy_job_system(JobSystem* job_system)
 {
-  tls_worker_fiber_id = (u64)param;
-#if 0
-  profiler::register_fiber(tls_worker_fiber_id);
-#endif
-  while(!g_job_system->should_exit)
-  {
-    JobDesc job = {0};
-    JobType type = wait_for_async_job(g_job_system, &job);
-    if (type == JOB_TYPE_INVALID)
-      return 0;
-
-    // The async worker shouldn't really have any yields.
-    ASSERT(type == JOB_TYPE_LAUNCH);
+  ASSERT(job_system == g_JobSystem);
 
-    launch_job(g_job_system, job, false);
+  for (u32 ifiber = 0; ifiber < job_system->fiber_count; ifiber++)
+  {
+    JobFiber* fiber = &job_system->fibers[ifiber];
+    destroy_fiber(&fiber->fiber);
+    destroy_context(&fiber->ctx);
   }
 
-  return 0;
+  destroy_concurrent_pool(&job_system->job_pool);
+
+  // Everything else came out of an AllocHeap
+  zero_memory(job_system, sizeof(JobSystem));
+  g_JobSystem = nullptr;
 }
 
 Array<Thread>
-spawn_job_system_workers(MEMORY_ARENA_PARAM, JobSystem* job_system)
+spawn_job_system_workers(AllocHeap heap, JobSystem* job_system, const ThreadPlacement& placement)
 {
-  wchar_t name[128];
-  s32 num_physical_cores = get_num_physical_cores();
-  // TODO(Brandon): Scale these appropriately. This entails making the async workers
-  // not spin and also programmatically fetching the number of _physical_ cores without
-  // hyperthreading
-  u32 worker_threads = 1; // max(1, num_physical_cores - 6);
-  // These are for the async threads... they will be locked to a single core shared with the OS
-  u32 async_threads = 1;
+  ASSERT_MSG_FATAL(placement.job_workers.size > 0, "Thread placement has no cores for the job workers!");
 
-  Array<Thread> ret = init_array<Thread>(MEMORY_ARENA_FWD, worker_threads);
-
-  u64 fiber_id = -1;
+  wchar_t name[128];
 
-  for (u32 i = 0; i < worker_threads; i++)
+  Array<Thread> ret = init_array<Thread>(heap, job_system->worker_count);
+  for (u32 iworker = 0; iworker < job_system->worker_count; iworker++)
   {
-    MemoryArena thread_scratch_arena = sub_alloc_memory_arena(MEMORY_ARENA_FWD, DEFAULT_SCRATCH_SIZE);
-    Thread thread = init_thread(thread_scratch_arena, KiB(16), &job_worker, (void*)fiber_id, i);
-    swprintf_s(name, 128, L"JobSystem Worker %d", i);
+    // Jobs run on the fiber stacks, the thread's own stack only needs to fit the scheduler.
+    Thread thread = init_thread(heap, KiB(64), &job_worker_proc, &job_system->workers[iworker], placement.job_workers[iworker % placement.job_workers.size]);
+    swprintf(name, ARRAY_LENGTH(name), L"JobSystem Worker %u", iworker);
     set_thread_name(&thread, name);
 
     *array_add(&ret) = thread;
-    fiber_id--;
-  }
-
-  u8 async_core_index = worker_threads;
-  for (u32 i = 0; i < async_threads; i++)
-  {
-    MemoryArena thread_scratch_arena = sub_alloc_memory_arena(MEMORY_ARENA_FWD, KiB(4));
-    Thread thread = init_thread(thread_scratch_arena, KiB(16), &async_worker, (void*)fiber_id, async_core_index);
-    swprintf_s(name, 128, L"JobSystem Async Worker %d", i);
-    set_thread_name(&thread, name);
-    fiber_id--;
   }
 
   return ret;
@@ -501,68 +543,162 @@ job_has_completed(JobHandle handle, JobSystem* job_system)
 {
   if (job_system == nullptr)
   {
-    job_system = g_job_system;
+    job_system = g_JobSystem;
   }
 
   ASSERT(job_system != nullptr);
 
-  return ACQUIRE(&job_system->job_counters, auto* counters) -> bool
+  if (handle == 0)
   {
-    return !hash_table_find(counters, handle);
-  };
+    return true;
+  }
+
+  JobCounter* counter = get_job_counter(job_system, handle);
+  return atomic_ref_load(&counter->generation, std::memory_order_acquire) != job_handle_generation(handle);
 }
 
-static JobQueue*
-get_queue(JobSystem* job_system, JobPriority priority)
+void
+yield_to_counter(JobHandle handle)
 {
-  JobQueue* ret = nullptr;
-  switch(priority)
+  JobSystem* job_system = g_JobSystem;
+  ASSERT(job_system != nullptr);
+
+  if (job_has_completed(handle, job_system))
   {
-    case kJobPriorityHigh:   ret = &job_system->high_priority; break;
-    case kJobPriorityMedium: ret = &job_system->medium_priority; break;
-    case kJobPriorityLow:    ret = &job_system->low_priority; break;
+    return;
   }
-  ASSERT(ret != nullptr);
 
-  return ret;
+  JobWorker* worker = get_current_job_worker();
+  if (worker == nullptr || worker->current_fiber == kJobNoFiber)
+  {
+    // Not inside of a job, so there's nothing to switch to. Just sleep until the last job finishes.
+    JobCounter* counter    = get_job_counter(job_system, handle);
+    u32         generation = job_handle_generation(handle);
+
+    atomic_ref_fetch_add(&counter->thread_waiters, 1);
+    while (atomic_ref_load(&counter->generation) == generation)
+    {
+      wait_on_address(&counter->generation, &generation, sizeof(generation));
+    }
+    atomic_ref_fetch_sub(&counter->thread_waiters, 1);
+    return;
+  }
+
+  // The scheduler takes it from here, see run_job
+  JobFiber* fiber      = &job_system->fibers[worker->current_fiber];
+  worker->event        = kJobWorkerEventWaiting;
+  worker->wait_counter = handle;
+  switch_to_fiber(&fiber->fiber, &worker->scheduler_fiber);
+
+  // NOTE(bshihabi): This could be running on a completely different worker now.
 }
 
-static JobHandle
-get_next_job_counter_id(JobSystem* job_system)
+JobHandle
+init_job_counter(u32 count)
 {
-  return InterlockedIncrement(&job_system->current_job_counter_id);
+  JobSystem* job_system = g_JobSystem;
+  ASSERT(job_system != nullptr);
+  ASSERT_MSG_FATAL(count > 0, "A job counter with a count of 0 would never complete.");
+
+  u32  index  = 0;
+  bool popped = try_mpmc_ring_queue_pop(&job_system->free_counters, &index);
+  ASSERT_MSG_FATAL(popped, "Job system ran out of job counters! Bump max_jobs in init_job_system.");
+
+  JobCounter* counter = &job_system->counters[index];
+  // Nobody can see the counter until jobs get pushed onto it, which publishes this
+  atomic_ref_store(&counter->value, count, std::memory_order_relaxed);
+
+  return ((u64)counter->generation << 32) | (u64)index;
 }
 
-JobHandle
-_kick_jobs(JobPriority priority,
-          JobDesc* jobs,
-          size_t count,
-          JobDebugInfo debug_info,
-          Option<ThreadSignal*> thread_signal)
+void
+add_to_job_counter(JobHandle handle, u32 count)
 {
-  ASSERT(g_job_system != nullptr);
+  JobSystem* job_system = g_JobSystem;
+  ASSERT(job_system != nullptr);
+  ASSERT_MSG_FATAL(!job_has_completed(handle, job_system), "Attempted to add to a job counter that already completed.");
 
-  JobHandle ret = ACQUIRE(&g_job_system->job_counters, auto* job_counters)
+  // Relaxed is fine, the push of whatever job this is for orders it before that job can decrement it
+  atomic_ref_fetch_add(&get_job_counter(job_system, handle)->value, count, std::memory_order_relaxed);
+}
+
+void
+release_job_counter(JobHandle handle)
+{
+  JobSystem* job_system = g_JobSystem;
+  ASSERT(job_system != nullptr);
+
+  finish_job_counter(job_system, get_current_job_worker(), handle);
+}
+
+bool
+job_system_wants_work(JobPriority priority)
+{
+  JobSystem* job_system = g_JobSystem;
+  ASSERT(job_system != nullptr);
+
+  // Everything we queued up already got stolen, so whatever we split off next will probably get stolen too
+  JobWorker* worker = get_current_job_worker();
+  if (worker != nullptr)
   {
-    JobHandle counter_id = get_next_job_counter_id(g_job_system);
-    JobCounter* counter = hash_table_insert(job_counters, counter_id);
-    counter->id = counter_id;
-    counter->value = count;
-    counter->waiting_jobs = { 0 };
-    counter->completion_signal = thread_signal;
-    return counter->id;
-  };
+    JobDeque* deque  = &worker->deques[priority];
+    s64       top    = atomic_ref_load(&deque->top,    std::memory_order_relaxed);
+    s64       bottom = atomic_ref_load(&deque->bottom, std::memory_order_relaxed);
+    if (bottom <= top)
+    {
+      return true;
+    }
+  }
 
+  return atomic_ref_load(&job_system->sleepers, std::memory_order_relaxed) > 0;
+}
+
+void
+_kick_jobs_on_counter(JobHandle counter,
+                      JobPriority priority,
+                      JobDesc* jobs,
+                      size_t count,
+                      JobDebugInfo debug_info)
+{
+  JobSystem* job_system = g_JobSystem;
+  ASSERT(job_system != nullptr);
+  ASSERT(priority < kJobPriorityCount);
+
+  JobWorker* worker = get_current_job_worker();
   for (size_t i = 0; i < count; i++)
   {
     ASSERT(jobs[i].entry.func_ptr != nullptr);
-    jobs[i].completion_signal = ret;
-    jobs[i].debug_info = debug_info;
+    jobs[i].completion_signal = counter;
+    jobs[i].debug_info        = debug_info;
+
+    Job* job = concurrent_pool_alloc(&job_system->job_pool);
+    ASSERT_MSG_FATAL(job != nullptr, "Job system ran out of jobs! Bump max_jobs in init_job_system.");
+    job->entry       = jobs[i].entry;
+    job->counter     = counter;
+    job->debug_info  = debug_info;
+    job->fiber       = kJobNoFiber;
+    job->priority    = priority;
+    job->next_waiter = nullptr;
+
+    push_job(job_system, worker, job);
   }
 
-  JobQueue* queue = get_queue(g_job_system, priority);
+  wake_job_workers(job_system, (u32)count);
+}
+
+JobHandle
+_kick_jobs(JobPriority priority,
+           JobDesc* jobs,
+           size_t count,
+           JobDebugInfo debug_info)
+{
+  if (count == 0)
+  {
+    return 0;
+  }
 
-  enqueue_jobs(queue, jobs, count);
+  JobHandle ret = init_job_counter((u32)count);
+  _kick_jobs_on_counter(ret, priority, jobs, count, debug_info);
 
   return ret;
 }
@@ -570,14 +706,52 @@ _kick_jobs(JobPriority priority,
 JobSystem*
 get_job_system()
 {
-  ASSERT(g_job_system != nullptr);
-  return g_job_system;
+  ASSERT(g_JobSystem != nullptr);
+  return g_JobSystem;
+}
+
+u32
+get_job_worker_index()
+{
+  ASSERT(g_JobSystem != nullptr);
+  JobWorker* worker = get_current_job_worker();
+  return worker != nullptr ? worker->index : g_JobSystem->worker_count;
 }
 
 void
 kill_job_system(JobSystem* job_system)
 {
-  job_system->should_exit = true;
+  atomic_ref_store(&job_system->should_exit, 1u);
+  atomic_ref_fetch_add(&job_system->work_signal, 1);
+  wake_all_on_address(&job_system->work_signal);
 }
 
-#endif
\ No newline at end of file
+static void
+job_system_parallel_dispatch(void* user, u32 block_count, void (*fn)(void* ctx, u32 block), void* ctx)
+{
+  UNREFERENCED_PARAMETER(user);
+
+  parallel_for(0, block_count, 1, [=](u64 begin, u64 end)
+  {
+    for (u64 block = begin; block < end; block++)
+    {
+      fn(ctx, (u32)block);
+    }
+  });
+}
+
+ParallelDispatch
+get_job_system_parallel_dispatch(JobSystem* job_system)
+{
+  if (job_system == nullptr)
+  {
+    job_system = get_job_system();
+  }
+
+  ParallelDispatch ret;
+  ret.run          = &job_system_parallel_dispatch;
+  ret.user         = job_system;
+  // The thread calling parallel_for works on the blocks too
+  ret.thread_count = job_system->worker_count + 1;
+  return ret;
+}
@@ -1,76 +1,46 @@
 #pragma once
-#if 0
 #include "Core/Foundation/types.h"
 #include "Core/Foundation/context.h"
 #include "Core/Foundation/threading.h"
+#include "Core/Foundation/topology.h"
 #include "Core/Foundation/pool_allocator.h"
+#include "Core/Foundation/sort.h"
 
-#include "Core/Foundation/Containers/ring_buffer.h"
-#include "Core/Foundation/Containers/hash_table.h"
 #include "Core/Foundation/Containers/array.h"
+#include "Core/Foundation/Containers/mpmc_ring_queue.h"
 
-struct Fiber
-{
-  void* rip = 0;
-  void* rsp = 0;
-  void* rbx = 0;
-  void* rbp = 0;
-  void* r12 = 0;
-  void* r13 = 0;
-  void* r14 = 0;
-  void* r15 = 0;
-  void* rdi = 0;
-  void* rsi = 0;
-
-  void* rcx = 0;
-
-  u8 yielded = false;
-
-  __m128i xmm6;
-  __m128i xmm7;
-  __m128i xmm8;
-  __m128i xmm9;
-  __m128i xmm10;
-  __m128i xmm11;
-  __m128i xmm12;
-  __m128i xmm13;
-  __m128i xmm14;
-  __m128i xmm15;
-
-  // This stuff is the TIB content
-  // https://en.wikipedia.org/wiki/Win32_Thread_Information_Block
-  void* stack_low = 0;
-  void* stack_high = 0;
-  void* fiber_local = 0;
-  void* deallocation_stack = 0; // ???? I have no fucking clue what this does
-};
-
-Fiber init_fiber(void* stack, size_t stack_size, void* proc, void* param);
-extern "C" void launch_fiber(Fiber* fiber);
-extern "C" void resume_fiber(Fiber* fiber, void* stack_high);
-extern "C" void save_to_fiber(Fiber* out, void* stack_high);
-extern "C" void* get_rsp();
-
-//typedef void (*JobEntry)(uintptr_t);
+#include "Core/Engine/fiber.h"
 
 // TODO(Brandon): I have no idea why, but dx12 calls eat massive
 // amounts of stack space, so this is a temporary solution.
 // What I actually want is to be able to specify whether a job needs
 // _more_ stack space than a typical maybe 16 KiB, not have the default
 // be a worst case -_-
-#define STACK_SIZE KiB(128)
-// Literally just a hunk of memory lol.
-struct JobStack
+static constexpr size_t kJobStackSize          = KiB(128);
+// Every fiber gets its own scratch arena so that scratch allocations survive a job yielding and getting resumed on another thread.
+static constexpr size_t kJobScratchCommitSize  = KiB(64);
+static constexpr size_t kJobScratchReserveSize = MiB(64);
+
+// How many jobs each worker can have queued per priority before kicks overflow into the shared injection queues
+static constexpr u32    kJobDequeSize          = 1024;
+static constexpr u32    kMaxJobWorkers         = 64;
+static constexpr u32    kJobNoFiber            = U32_MAX;
+
+enum JobPriority : u8
 {
-  alignas(16) byte memory[STACK_SIZE];
-  byte scratch_buf[DEFAULT_SCRATCH_SIZE];
+  kJobPriorityHigh,
+  kJobPriorityMedium,
+  kJobPriorityLow,
+
+  kJobPriorityCount,
 };
 
+// The generation of the counter in the top 32 bits and the index of the counter in the bottom 32 bits.
+// Counters get recycled as soon as they hit 0, the generation is what tells a stale handle apart.
+// 0 is never a valid handle and counts as already completed.
 typedef u64 JobHandle;
 
-void yield_to_counter(JobHandle counter);
-
-struct JobDebugInfo 
+struct JobDebugInfo
 {
   const char* file = nullptr;
   int line = 0;
@@ -93,90 +63,165 @@ struct JobDesc
   JobDebugInfo debug_info = {0};
 };
 
-struct WorkingJob
+struct Job
 {
-  JobDesc job;
-  Fiber fiber;
+  JobEntry     entry;
+  JobHandle    counter     = 0;
+  JobDebugInfo debug_info;
 
-  JobStack* stack = nullptr;
-  Context ctx;
+  // kJobNoFiber until the job gets picked up for the first time, after that it keeps the fiber until it finishes.
+  u32          fiber       = kJobNoFiber;
+  JobPriority  priority    = kJobPriorityHigh;
 
-  WorkingJob* next = nullptr;
+  // Link in the waiter list of the counter this job is waiting on
+  Job*         next_waiter = nullptr;
 };
 
-struct WorkingJobQueue
+// Chase-Lev work-stealing deque (the C11 version from Lê et al. "Correct and Efficient Work-Stealing for Weak Memory Models").
+//
+// The owning worker pushes and takes from the bottom like a stack, which keeps whatever it just kicked hot in cache, and
+// every other worker steals from the top. Only the last remaining job can cause the owner and a thief to contend.
+// Fixed size, when it's full the job goes to the shared injection queue instead.
+struct JobDeque
 {
-  WorkingJob* head = nullptr;
-  WorkingJob* tail = nullptr;
+  Job** jobs = nullptr;
+  s64   mask = 0;
+
+  alignas(kCacheLineSize) s64 top    = 0;
+  alignas(kCacheLineSize) s64 bottom = 0;
 };
 
 struct JobCounter
 {
-  volatile u64 value = 0;
-  JobHandle id = 0;
-  WorkingJobQueue waiting_jobs = {0};
-  Option<ThreadSignal*> completion_signal = None;
+  // How many jobs are left. Accessed atomically.
+  u32      value          = 0;
+  // Bumped when value hits 0, threads that aren't jobs sleep on this. Accessed atomically.
+  u32      generation     = 1;
+  // How many threads are sleeping on the generation. Accessed atomically.
+  u32      thread_waiters = 0;
+
+  // Protects waiters and bumping the generation
+  SpinLock lock;
+  // Jobs that yielded to this counter, they get requeued when it hits 0
+  Job*     waiters        = nullptr;
 };
 
-struct JobQueue
+struct JobFiber
 {
-  RingBuffer queue;
-  SpinLock lock;
+  Fiber   fiber;
+  Context ctx;
+  // The job running on this fiber
+  Job*    job = nullptr;
 };
 
-struct JobSystem
+enum JobWorkerEvent : u8
 {
-  JobQueue high_priority;
-  JobQueue medium_priority;
-  JobQueue low_priority;
-
-  // TODO(Brandon): Ideally, these pools would just be atomic
-  // and not SpinLocked.
+  kJobWorkerEventNone,
+  // The job on the fiber returned
+  kJobWorkerEventFinished,
+  // The job on the fiber called yield_to_counter
+  kJobWorkerEventWaiting,
+};
 
-  SpinLocked<Pool<JobStack>> job_stack_allocator;
+struct JobSystem;
+struct alignas(kCacheLineSize) JobWorker
+{
+  JobSystem*     job_system      = nullptr;
+  u32            index           = 0;
 
-  SpinLocked<Pool<WorkingJob>> working_job_allocator;
+  // The worker thread's own fiber. The scheduler loop runs on it and every job fiber switches back to it.
+  Fiber          scheduler_fiber;
+  // The fiber that's running right now, kJobNoFiber when the scheduler is
+  u32            current_fiber   = kJobNoFiber;
 
-  SpinLocked<HashTable<JobHandle, JobCounter>> job_counters;
-  SpinLocked<WorkingJobQueue> working_jobs_queue;
+  // Set by a job fiber right before it switches back to the scheduler so the scheduler knows what to do with it.
+  // NOTE(bshihabi): The scheduler has to do all of this after the switch. If the job registered itself as a waiter
+  // before switching, another worker could try to resume the fiber before it was done switching away.
+  JobWorkerEvent event           = kJobWorkerEventNone;
+  JobHandle      wait_counter    = 0;
 
-  volatile JobHandle current_job_counter_id = 1;
+  u64            rng             = 0;
 
-  bool should_exit = 0;
+  JobDeque       deques[kJobPriorityCount];
 };
 
-enum JobPriority : u8
+struct JobSystem
 {
-  kJobPriorityHigh,
-  kJobPriorityMedium,
-  kJobPriorityLow,
+  JobWorker*          workers       = nullptr;
+  u32                 worker_count  = 0;
 
-  kJobPriorityCount,
+  JobFiber*           fibers        = nullptr;
+  u32                 fiber_count   = 0;
+  MpmcRingQueue<u32>  free_fibers;
+
+  ConcurrentPool<Job> job_pool;
+
+  JobCounter*         counters      = nullptr;
+  u32                 counter_count = 0;
+  MpmcRingQueue<u32>  free_counters;
+
+  // Jobs kicked from threads that aren't workers (and jobs that didn't fit in a worker's deque) go here
+  MpmcRingQueue<Job*> injection_queues[kJobPriorityCount];
+
+  // Bumped every time work gets queued so that idle workers have something to sleep on. Accessed atomically.
+  alignas(kCacheLineSize) u32 work_signal = 0;
+  u32                         sleepers    = 0;
+  u32                         should_exit = 0;
 };
 
-JobSystem* init_job_system(MEMORY_ARENA_PARAM, size_t job_queue_size);
+// max_jobs is how many jobs (and job counters) can be in flight at once. Every job that's running or waiting holds on
+// to one of the fiber_count fibers, so jobs that wait on other jobs need enough fibers for their children to run on.
+// A worker_count of 0 means one worker per core.
+JobSystem* init_job_system(AllocHeap heap, u32 max_jobs, u32 fiber_count, u32 worker_count = 0);
+// The worker threads need to have exited (kill_job_system + join_threads) before this.
+void destroy_job_system(JobSystem* job_system);
 
-// These must be called _inside_ of a job.
 JobSystem* get_job_system();
+// Index of the worker running on this thread, or worker_count on any thread that isn't one (parallel_for runs a piece
+// on the calling thread), so per-worker data needs worker_count + 1 slots. A job that yields can come back on another
+// worker, so read it again after every wait.
+u32        get_job_worker_index();
+// Wakes every worker up and makes them exit once they're done with whatever job they're running.
 void kill_job_system(JobSystem* job_system);
 
-Array<Thread> spawn_job_system_workers(MEMORY_ARENA_PARAM, JobSystem* job_system);
+// Worker i runs on placement.job_workers[i], wrapping around if there are more workers than that.
+Array<Thread> spawn_job_system_workers(AllocHeap heap, JobSystem* job_system, const ThreadPlacement& placement);
+
+// Blocks until every job kicked with counter is done. Inside of a job this switches to another job instead of
+// blocking the worker, from any other thread it goes to sleep.
+void yield_to_counter(JobHandle counter);
 
 bool job_has_completed(JobHandle handle, JobSystem* job_system = nullptr);
 
 JobHandle _kick_jobs(JobPriority priority,
-                        JobDesc* jobs,
-                        size_t count,
-                        JobDebugInfo debug_info,
-                        Option<ThreadSignal*> thread_signal = None);
+                     JobDesc* jobs,
+                     size_t count,
+                     JobDebugInfo debug_info);
+
+// Counters can also be managed by hand for work that kicks more jobs onto the same counter as it goes (parallel_for,
+// task graphs). The counter completes once count jobs on it have finished, release_job_counter counts as one finishing.
+JobHandle init_job_counter(u32 count);
+// Only safe while the counter can't complete, e.g. from a job that's on the counter itself.
+void      add_to_job_counter(JobHandle counter, u32 count);
+void      release_job_counter(JobHandle counter);
+
+// Kicks jobs onto an existing counter without changing its count, they need to already be accounted for.
+void      _kick_jobs_on_counter(JobHandle counter,
+                                JobPriority priority,
+                                JobDesc* jobs,
+                                size_t count,
+                                JobDebugInfo debug_info);
+
+// True when work that gets split off right now would probably get picked up by another worker: either everything the
+// calling worker queued already got stolen, or some workers are asleep.
+bool      job_system_wants_work(JobPriority priority);
 
 inline JobHandle
 _kick_single_job(JobPriority priority,
                  JobDesc desc,
-                 JobDebugInfo debug_info,
-                 Option<ThreadSignal*> thread_signal = None)
+                 JobDebugInfo debug_info)
 {
-  return _kick_jobs(priority, &desc, 1, debug_info, thread_signal);
+  return _kick_jobs(priority, &desc, 1, debug_info);
 }
 
 inline void
@@ -185,9 +230,8 @@ blocking_kick_job_descs(JobPriority priority,
                         size_t count,
                         JobDebugInfo debug_info)
 {
-  ThreadSignal signal = init_thread_signal();
-  _kick_jobs(priority, jobs, count, debug_info, &signal);
-  wait_for_thread_signal(&signal);
+  JobHandle counter = _kick_jobs(priority, jobs, count, debug_info);
+  yield_to_counter(counter);
 }
 
 inline void
@@ -210,7 +254,7 @@ inline JobDesc
 init_job_desc_from_closure(F func)
 {
   JobDesc ret = {0};
-  static_assert(sizeof(F) <= sizeof(ret.entry.params));
+  static_assert(sizeof(F) + alignof(F) <= sizeof(ret.entry.params));
 
   u8* aligned = align_ptr(ret.entry.params, alignof(F));
   memcpy(aligned, &func, sizeof(func));
@@ -220,7 +264,7 @@ init_job_desc_from_closure(F func)
   return ret;
 }
 
-#define kick_job_descs(priority, job_descs, count, ...) _kick_jobs(priority, job_descs, count, JOB_DEBUG_INFO_STRUCT, __VA_ARGS__)
+#define kick_job_descs(priority, job_descs, count) _kick_jobs(priority, job_descs, count, JOB_DEBUG_INFO_STRUCT)
 #define kick_closure_job(priority, closure) _kick_single_job(priority, init_job_desc_from_closure(closure), JOB_DEBUG_INFO_STRUCT)
 #define kick_job(priority, function_call) kick_closure_job(priority, [=]() { function_call; })
 #define blocking_kick_closure_job(priority, closure) _blocking_kick_single_job(priority, init_job_desc_from_closure(closure), JOB_DEBUG_INFO_STRUCT)
@@ -232,4 +276,97 @@ void yield_async(F func)
   JobHandle counter = kick_closure_job(kJobPriorityLow, func);
   yield_to_counter(counter);
 }
-#endif
+
+template <typename F>
+struct ParallelForParams
+{
+  const F*     fn         = nullptr;
+  u64          grain      = 0;
+  JobHandle    counter    = 0;
+  JobPriority  priority   = kJobPriorityHigh;
+  JobDebugInfo debug_info;
+};
+
+// Lazy binary splitting: work through the range a grain at a time, and only split the rest in half when another
+// worker would actually take it. Splitting up front into tiny jobs is a lot of overhead when every worker is busy
+// anyways, and splitting up front into big jobs leaves workers idle when the work per element isn't uniform.
+template <typename F>
+void
+parallel_for_range(const ParallelForParams<F>* params, u64 begin, u64 end)
+{
+  while (end - begin > params->grain)
+  {
+    if (job_system_wants_work(params->priority))
+    {
+      // Keep the split on a grain boundary, callers can rely on every range but the last being a multiple of grain
+      u64 mid     = begin + MAX((end - begin) / 2 / params->grain, 1ULL) * params->grain;
+      JobDesc job = init_job_desc_from_closure([params, mid, end]() { parallel_for_range(params, mid, end); });
+
+      add_to_job_counter(params->counter, 1);
+      _kick_jobs_on_counter(params->counter, params->priority, &job, 1, params->debug_info);
+
+      end = mid;
+      continue;
+    }
+
+    (*params->fn)(begin, begin + params->grain);
+    begin += params->grain;
+  }
+
+  if (begin < end)
+  {
+    (*params->fn)(begin, end);
+  }
+}
+
+// Calls fn(range_begin, range_end) over [begin, end) in ranges of roughly grain elements, spread across the job system
+// workers. The calling thread works on the first piece itself and returns once every range is done.
+//
+// Every range is a multiple of grain elements except the one at the very end.
+template <typename F>
+void
+_parallel_for(u64 begin, u64 end, u64 grain, F fn, JobPriority priority, JobDebugInfo debug_info)
+{
+  if (begin >= end)
+  {
+    return;
+  }
+
+  grain     = MAX(grain, 1ULL);
+  u64 count = end - begin;
+  if (count <= grain)
+  {
+    fn(begin, end);
+    return;
+  }
+
+  ParallelForParams<F> params;
+  params.fn         = &fn;
+  params.grain      = grain;
+  params.priority   = priority;
+  params.debug_info = debug_info;
+
+  // Hand every worker a piece up front so they don't all have to start by stealing from one job
+  u64 grain_count   = UCEIL_DIV(count, grain);
+  u32 piece_count   = (u32)MIN(grain_count, (u64)get_job_system()->worker_count + 1);
+  params.counter    = init_job_counter(piece_count);
+
+  for (u32 ipiece = 1; ipiece < piece_count; ipiece++)
+  {
+    u64     piece_begin = begin + grain_count * ipiece / piece_count * grain;
+    u64     piece_end   = MIN(begin + grain_count * (ipiece + 1) / piece_count * grain, end);
+    JobDesc job         = init_job_desc_from_closure([&params, piece_begin, piece_end]() { parallel_for_range(&params, piece_begin, piece_end); });
+    _kick_jobs_on_counter(params.counter, priority, &job, 1, debug_info);
+  }
+
+  parallel_for_range(&params, begin, MIN(begin + grain_count / piece_count * grain, end));
+  release_job_counter(params.counter);
+
+  yield_to_counter(params.counter);
+}
+
+#define parallel_for(begin, end, grain, fn) _parallel_for(begin, end, grain, fn, kJobPriorityHigh, JOB_DEBUG_INFO_STRUCT)
+#define parallel_for_priority(priority, begin, end, grain, fn) _parallel_for(begin, end, grain, fn, priority, JOB_DEBUG_INFO_STRUCT)
+
+// Runs the blocks of Foundation code that takes a ParallelDispatch (radix_sort) through parallel_for on this job system.
+ParallelDispatch get_job_system_parallel_dispatch(JobSystem* job_system = nullptr);
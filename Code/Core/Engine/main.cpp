@@ -4,6 +4,7 @@
 #include "Core/Foundation/context.h"
 #include "Core/Foundation/profiling.h"
 #include "Core/Foundation/filesystem.h"
+#include "Core/Foundation/topology.h"
 
 #include "Core/Engine/memory.h"
 #include "Core/Engine/scene.h"
@@ -39,6 +40,8 @@ static bool g_EnableGpuValidation          = false;
 static bool g_EnableRtValidation           = false;
 static bool g_EnableDevelopmentStablePower = false;
 
+static ThreadPlacement g_ThreadPlacement;
+
 LRESULT CALLBACK
 window_proc(HWND window, UINT msg, WPARAM wparam, LPARAM lparam) 
 {
@@ -200,7 +203,7 @@ application_entry(HINSTANCE instance, int show_code)
   defer { destroy_renderer(); };
 
   init_asset_registry();
-  init_asset_streamer();
+  init_asset_streamer(g_ThreadPlacement.streaming_thread);
   defer { destroy_asset_streamer(); };
 
   init_unified_geometry_buffer(g_GpuDevice);
@@ -446,6 +449,30 @@ WinMain(HINSTANCE instance, HINSTANCE prev_instance, PSTR cmdline, int show_code
 
   init_thread_context();
 
+  CpuTopology         topology       = query_cpu_topology(g_InitHeap);
+  ThreadPlacementDesc placement_desc;
+  placement_desc.max_job_workers     = kMaxJobWorkers;
+  g_ThreadPlacement                  = plan_thread_placement(g_InitHeap, topology, placement_desc);
+  set_current_thread_affinity(g_ThreadPlacement.main_thread);
+
+  AsyncIoDesc async_io_desc;
+  async_io_desc.cpus = g_ThreadPlacement.streaming_thread;
+  init_async_io(g_InitHeap, async_io_desc);
+  defer { destroy_async_io(); };
+
+  JobSystem*    job_system  = init_job_system(g_InitHeap, kMaxJobs, kJobFiberCount, (u32)g_ThreadPlacement.job_workers.size);
+  Array<Thread> job_workers = spawn_job_system_workers(g_InitHeap, job_system, g_ThreadPlacement);
+  defer
+  {
+    kill_job_system(job_system);
+    join_threads(job_workers.memory, (u32)job_workers.size);
+    for (Thread& thread : job_workers)
+    {
+      destroy_thread(&thread);
+    }
+    destroy_job_system(job_system);
+  };
+
   application_entry(instance, show_code);
 
   return 0;
@@ -1,14 +1,27 @@
 #include "Core/Engine/memory.h"
 
+#include "Core/Foundation/pool_allocator.h"
+#include "Core/Foundation/slab_allocator.h"
+#include "Core/Foundation/tracking_heap.h"
+
+// Flip on to route the engine heaps through tracking heaps, then call write_engine_heap_reports to see who is using what.
+#define TRACK_ENGINE_HEAPS 0
+
 struct MemoryLayout
 {
   u8* memory = nullptr;
 
-  LinearAllocator init_allocator;
-  LinearAllocator debug_allocator;
-  LinearAllocator frame_allocator;
-  PoolAllocator   overflow_allocator;
-//  PoolAllocator   overflow_allocator;
+  LinearAllocator         init_allocator;
+  LinearAllocator         debug_allocator;
+  FrameAllocator          frame_allocator;
+  ConcurrentPoolAllocator overflow_allocator;
+  SlabAllocator           resource_allocator;
+
+#if TRACK_ENGINE_HEAPS
+  TrackingHeap            init_tracking;
+  TrackingHeap            frame_tracking;
+  TrackingHeap            resource_tracking;
+#endif
 };
 
 static MemoryLayout g_MemoryLayout;
@@ -35,22 +48,42 @@ init_engine_memory()
   g_MemoryLayout.debug_allocator    = init_linear_allocator(memory, kDebugHeapSize);
   memory += kDebugHeapSize;
 
-  g_MemoryLayout.frame_allocator    = init_linear_allocator(memory, kFrameHeapSize);
+  g_MemoryLayout.frame_allocator    = init_frame_allocator(memory, kFrameHeapSize, kFrameHeapBufferCount);
   memory += kFrameHeapSize;
 
-  g_MemoryLayout.overflow_allocator = init_pool_allocator(memory, kOverflowHeapSize, kOverflowPageSize, 8); 
-  memory += kOverflowHeapSize;
+  g_MemoryLayout.overflow_allocator = init_concurrent_pool_allocator(g_MemoryLayout.init_allocator, kOverflowHeapSize / kOverflowPageSize, kOverflowPageSize, kOverflowPageSize);
+
+  // Slab allocator reserves its own address space, just needs somewhere to put its bookkeeping
+  g_MemoryLayout.resource_allocator = init_slab_allocator(g_MemoryLayout.init_allocator, kResourceHeapSize);
 
   g_InitHeap     = g_MemoryLayout.init_allocator;
   g_DebugHeap    = g_MemoryLayout.debug_allocator;
   g_FrameHeap    = g_MemoryLayout.frame_allocator;
   g_OverflowHeap = g_MemoryLayout.overflow_allocator;
-//  g_ResourceHeap = g_MemoryLayout.resour;
+  g_ResourceHeap = g_MemoryLayout.resource_allocator;
+
+#if TRACK_ENGINE_HEAPS
+  g_MemoryLayout.init_tracking     = init_tracking_heap(g_InitHeap,     GLOBAL_HEAP);
+  g_MemoryLayout.frame_tracking    = init_tracking_heap(g_FrameHeap,    GLOBAL_HEAP);
+  g_MemoryLayout.resource_tracking = init_tracking_heap(g_ResourceHeap, GLOBAL_HEAP);
+
+  g_InitHeap     = g_MemoryLayout.init_tracking;
+  g_FrameHeap    = g_MemoryLayout.frame_tracking;
+  g_ResourceHeap = g_MemoryLayout.resource_tracking;
+#endif
 }
 
 void
 destroy_engine_memory()
 {
+#if TRACK_ENGINE_HEAPS
+  destroy_tracking_heap(&g_MemoryLayout.init_tracking);
+  destroy_tracking_heap(&g_MemoryLayout.frame_tracking);
+  destroy_tracking_heap(&g_MemoryLayout.resource_tracking);
+#endif
+
+  destroy_concurrent_pool_allocator(&g_MemoryLayout.overflow_allocator);
+  destroy_slab_allocator(&g_MemoryLayout.resource_allocator);
   free_pages(g_MemoryLayout.memory);
   zero_memory(&g_MemoryLayout, sizeof(g_MemoryLayout));
 }
@@ -58,6 +91,33 @@ destroy_engine_memory()
 void
 reset_frame_heap()
 {
-  reset_linear_allocator(&g_MemoryLayout.frame_allocator);
+  reset_frame_allocator(&g_MemoryLayout.frame_allocator);
+
+#if TRACK_ENGINE_HEAPS
+  tracking_heap_reset(&g_MemoryLayout.frame_tracking);
+
+  tracking_heap_advance_epoch(&g_MemoryLayout.init_tracking);
+  tracking_heap_advance_epoch(&g_MemoryLayout.frame_tracking);
+  tracking_heap_advance_epoch(&g_MemoryLayout.resource_tracking);
+#endif
+}
+
+void
+write_engine_heap_reports()
+{
+#if TRACK_ENGINE_HEAPS
+  static const char* kReportPaths[] = { "init_heap.json", "frame_heap.json", "resource_heap.json" };
+  TrackingHeap*      heaps[]        = { &g_MemoryLayout.init_tracking, &g_MemoryLayout.frame_tracking, &g_MemoryLayout.resource_tracking };
+
+  for (u32 iheap = 0; iheap < ARRAY_LENGTH(heaps); iheap++)
+  {
+    if (!tracking_heap_write_report(heaps[iheap], kReportPaths[iheap], kTrackingReportJson))
+    {
+      dbgln("Failed to write heap report %s", kReportPaths[iheap]);
+    }
+  }
+#else
+  dbgln("Heap tracking is disabled, flip TRACK_ENGINE_HEAPS on in memory.cpp to get heap reports.");
+#endif
 }
 
@@ -8,30 +8,40 @@ void destroy_engine_memory();
 
 // Used for anything that will last the lifetime of the engine.
 extern AllocHeap       g_InitHeap;
-// Lifetime of a frame.
+// Lifetime of a frame (well, kFrameHeapBufferCount frames). Safe to allocate from any thread.
 extern AllocHeap       g_FrameHeap;
-// Used to allocate overflow backing memory for linear allocators.
+// Used to allocate overflow backing memory for linear allocators. Every allocation is a kOverflowPageSize block. Safe to use from any thread.
 extern FreeHeap        g_OverflowHeap;
 
+// General purpose heap for anything with an unknown lifetime. Safe to use from any thread.
 extern ReallocFreeHeap g_ResourceHeap;
 
 extern AllocHeap       g_DebugHeap;
 
 enum
 {
-  kOverflowPageSize = KiB(4),
+  kOverflowPageSize     = KiB(4),
+  // Frame heap memory stays valid for this many frames, so the GPU can still read last frame's data while we record the next one.
+  kFrameHeapBufferCount = 2,
 };
 
 enum HeapSize : u64
 {
-  kInitHeapSize     = GiB(1),
-  kDebugHeapSize    = MiB(16),
-  kFrameHeapSize    = MiB(512),
-  kOverflowHeapSize = MiB(1),
-  kResourceHeapSize = MiB(1),
-
-  kTotalHeapSize    = kInitHeapSize + kDebugHeapSize + kFrameHeapSize + kOverflowHeapSize + kResourceHeapSize,
+  kInitHeapSize        = GiB(1),
+  kDebugHeapSize       = MiB(16),
+  // What a single frame gets to allocate. The frame heap is buffered, so the total reserved is this times kFrameHeapBufferCount.
+  kFrameHeapBufferSize = MiB(512),
+  kFrameHeapSize       = kFrameHeapBufferSize * kFrameHeapBufferCount,
+  // Comes out of the init heap along with the pool's bookkeeping, so this isn't part of the total.
+  kOverflowHeapSize    = MiB(1),
+  // Only reserved, pages get committed as slabs are used, so this isn't part of the total.
+  kResourceHeapSize    = GiB(4),
+
+  kTotalHeapSize       = kInitHeapSize + kDebugHeapSize + kFrameHeapSize,
 };
 
 void reset_frame_heap();
 
+// Writes a JSON report per engine heap to the working directory, only does anything if TRACK_ENGINE_HEAPS is on.
+void write_engine_heap_reports();
+
@@ -5,10 +5,13 @@
 #include "Core/Engine/asset_streaming.h"
 #include "Core/Engine/memory.h"
 #include "Core/Engine/constants.h"
+#include "Core/Engine/job_system.h"
 #include "Core/Engine/Render/renderer.h"
 
 #include "Core/Engine/Shaders/Include/rt_tlas_common.hlsli"
 
+static constexpr u64 kStaticLodPickGrain = 256;
+
 struct Scene
 {
   SceneObj*          scene_objs         = nullptr;
@@ -134,6 +137,9 @@ init_render_scene_obj(ModelHandle model, u32 subset, u32 flags)
   flags |= kSceneObjRender;
   SceneObjHandle ret = alloc_scene_obj(flags);
 
+  // The model can't get unloaded for as long as the scene object is using it
+  acquire_asset(model);
+
   SceneObj*      obj = get_scene_obj_common(ret);
   obj->model         = model;
   obj->subset_id     = subset;
@@ -195,6 +201,12 @@ dynamic_scene_obj_attach_render_model(SceneObjHandle handle, ModelHandle model,
   }
   
   SceneObj* obj = unwrap(res);
+  acquire_asset(model);
+  if (obj->model)
+  {
+    release_asset(obj->model);
+  }
+
   obj->model       = model;
   obj->subset_id   = subset;
   obj->needs_instance_data_gpu_upload = true;
@@ -356,6 +368,28 @@ render_handler_scene_upload(const RenderEntry* entries, u32 count)
     }
   }
 
+  // Picking LODs for every static object is the bulk of the CPU time here and each object is independent, so that part
+  // gets spread across the job workers. The staging allocations and copies go through the one command list so they stay serial.
+  parallel_for(0, kMaxStaticSceneObjs, kStaticLodPickGrain, [](u64 begin, u64 end)
+  {
+    const ViewCtx* view = &g_RenderHandlerState.main_view;
+    for (u32 iscene_obj = (u32)begin; iscene_obj < (u32)end; iscene_obj++)
+    {
+      if (!bit_is_allocated(g_Scene->static_scene_obj_allocator, iscene_obj))
+      {
+        continue;
+      }
+
+      SceneObj* obj = g_Scene->static_scene_objs + iscene_obj;
+
+      u32 best_lod_idx = pick_subset_lod(view->camera.world_pos, view->proj, &obj->model->subsets[obj->subset_id]);
+      if (best_lod_idx != obj->lod_idx)
+      {
+        obj->needs_gpu_upload     = true;
+      }
+    }
+  });
+
   for (u32 iscene_obj = 0; iscene_obj < kMaxStaticSceneObjs; iscene_obj++)
   {
     if (!bit_is_allocated(g_Scene->static_scene_obj_allocator, iscene_obj))
@@ -366,13 +400,6 @@ render_handler_scene_upload(const RenderEntry* entries, u32 count)
 
     SceneObj* obj = g_Scene->static_scene_objs + iscene_obj;
 
-    const ViewCtx* view = &g_RenderHandlerState.main_view;
-    u32 best_lod_idx = pick_subset_lod(view->camera.world_pos, view->proj, &obj->model->subsets[obj->subset_id]);
-    if (best_lod_idx != obj->lod_idx)
-    {
-      obj->needs_gpu_upload     = true;
-    }
-
     if (obj->needs_gpu_upload || obj->needs_instance_data_gpu_upload)
     {
       SceneObjGpu obj_gpu;
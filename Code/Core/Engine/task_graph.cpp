@@ -0,0 +1,208 @@
+#include "Core/Engine/task_graph.h"
+
+#include "Core/Foundation/context.h"
+
+TaskGraphBuilder
+init_task_graph_builder(AllocHeap heap, u32 max_tasks, u32 max_dependencies)
+{
+  TaskGraphBuilder ret = {0};
+  ret.nodes            = init_array<TaskGraphNode>(heap, max_tasks);
+  ret.dependencies     = init_array<TaskGraphDependency>(heap, max_dependencies);
+
+  return ret;
+}
+
+TaskId
+_task_graph_add(TaskGraphBuilder* builder, JobPriority priority, JobDesc desc, JobDebugInfo debug_info)
+{
+  ASSERT(priority < kJobPriorityCount);
+  ASSERT(desc.entry.func_ptr != nullptr);
+
+  TaskId         ret  = (TaskId)builder->nodes.size;
+  TaskGraphNode* node = array_add(&builder->nodes);
+  node->entry         = desc.entry;
+  node->debug_info    = debug_info;
+  node->priority      = priority;
+
+  return ret;
+}
+
+void
+task_graph_add_dependency(TaskGraphBuilder* builder, TaskId task, TaskId depends_on)
+{
+  ASSERT_MSG_FATAL(task < builder->nodes.size && depends_on < builder->nodes.size, "Task graph dependency on a task that doesn't exist.");
+  ASSERT_MSG_FATAL(task != depends_on, "Task %u can't depend on itself.", task);
+
+  TaskGraphDependency* dependency = array_add(&builder->dependencies);
+  dependency->task                = task;
+  dependency->depends_on          = depends_on;
+}
+
+TaskGraph
+compile_task_graph(AllocHeap heap, const TaskGraphBuilder* builder)
+{
+  TaskGraph ret       = {0};
+  ret.node_count      = (u32)builder->nodes.size;
+  ret.successor_count = (u32)builder->dependencies.size;
+  if (ret.node_count == 0)
+  {
+    return ret;
+  }
+
+  ret.nodes      = HEAP_ALLOC(TaskGraphNode, heap, ret.node_count);
+  ret.successors = HEAP_ALLOC(TaskId,        heap, MAX(ret.successor_count, 1U));
+  ret.remaining  = HEAP_ALLOC(u32,           heap, ret.node_count);
+  memcpy(ret.nodes, builder->nodes.memory, sizeof(TaskGraphNode) * ret.node_count);
+
+  for (u32 inode = 0; inode < ret.node_count; inode++)
+  {
+    ret.nodes[inode].dependency_count = 0;
+    ret.nodes[inode].successor_start  = 0;
+    ret.nodes[inode].successor_count  = 0;
+  }
+
+  // Flatten the successors of every task next to each other so kicking them is a linear walk
+  for (const TaskGraphDependency& dependency : builder->dependencies)
+  {
+    ret.nodes[dependency.task].dependency_count++;
+    ret.nodes[dependency.depends_on].successor_count++;
+  }
+
+  u32 successor_start = 0;
+  for (u32 inode = 0; inode < ret.node_count; inode++)
+  {
+    ret.nodes[inode].successor_start  = successor_start;
+    successor_start                  += ret.nodes[inode].successor_count;
+    ret.nodes[inode].successor_count  = 0;
+  }
+
+  for (const TaskGraphDependency& dependency : builder->dependencies)
+  {
+    TaskGraphNode* node = &ret.nodes[dependency.depends_on];
+    ret.successors[node->successor_start + node->successor_count++] = dependency.task;
+  }
+
+  ScratchAllocator scratch_arena = alloc_scratch_arena();
+  defer { free_scratch_arena(&scratch_arena); };
+
+  // Kahn's algorithm. The graph never gets run in this order, it's just to catch cycles now instead of deadlocking on the first launch.
+  u32*    remaining   = HEAP_ALLOC(u32,    scratch_arena, ret.node_count);
+  TaskId* ready       = HEAP_ALLOC(TaskId, scratch_arena, ret.node_count);
+  u32     ready_count = 0;
+  for (u32 inode = 0; inode < ret.node_count; inode++)
+  {
+    remaining[inode] = ret.nodes[inode].dependency_count;
+    if (remaining[inode] == 0)
+    {
+      ready[ready_count++] = inode;
+    }
+  }
+
+  ret.root_count = ready_count;
+  ret.roots      = HEAP_ALLOC(TaskId, heap, ret.root_count);
+  memcpy(ret.roots, ready, sizeof(TaskId) * ret.root_count);
+
+  for (u32 iready = 0; iready < ready_count; iready++)
+  {
+    const TaskGraphNode* node = &ret.nodes[ready[iready]];
+    for (u32 isuccessor = 0; isuccessor < node->successor_count; isuccessor++)
+    {
+      TaskId successor = ret.successors[node->successor_start + isuccessor];
+      if (--remaining[successor] == 0)
+      {
+        ready[ready_count++] = successor;
+      }
+    }
+  }
+
+  ASSERT_MSG_FATAL(ready_count == ret.node_count, "Task graph has a dependency cycle, only %u of its %u tasks can ever run.", ready_count, ret.node_count);
+
+  return ret;
+}
+
+static void run_task_graph_node(TaskGraph* graph, JobHandle counter, TaskId task);
+
+static void
+kick_task_graph_node(TaskGraph* graph, JobHandle counter, TaskId task)
+{
+  const TaskGraphNode* node = &graph->nodes[task];
+  JobDesc              job  = init_job_desc_from_closure([graph, counter, task]() { run_task_graph_node(graph, counter, task); });
+  _kick_jobs_on_counter(counter, node->priority, &job, 1, node->debug_info);
+}
+
+static void
+run_task_graph_node(TaskGraph* graph, JobHandle counter, TaskId task)
+{
+  JobPriority priority = graph->nodes[task].priority;
+
+  // The first successor that becomes ready (at the same priority) runs right here instead of getting kicked, which
+  // makes a chain of tasks cost about as much as calling them in a row. The job itself still counts as one task
+  // finishing when it returns, so every task after the first one has to release the counter by hand.
+  bool continuation = false;
+  for (;;)
+  {
+    const TaskGraphNode* node = &graph->nodes[task];
+    node->entry.func_ptr((void*)(node->entry.params + node->entry.param_offset));
+
+    TaskId next = kNoTask;
+    for (u32 isuccessor = 0; isuccessor < node->successor_count; isuccessor++)
+    {
+      TaskId successor = graph->successors[node->successor_start + isuccessor];
+      // acq_rel so that the successor sees everything every one of its dependencies did
+      if (atomic_ref_fetch_sub(&graph->remaining[successor], 1U, std::memory_order_acq_rel) != 1)
+      {
+        continue;
+      }
+
+      if (next == kNoTask && graph->nodes[successor].priority == priority)
+      {
+        next = successor;
+      }
+      else
+      {
+        kick_task_graph_node(graph, counter, successor);
+      }
+    }
+
+    // NOTE(bshihabi): This has to come after the successors are dealt with. The counter completing lets the graph
+    // get launched again, so nothing can touch the graph after the last task releases it.
+    if (continuation)
+    {
+      release_job_counter(counter);
+    }
+
+    if (next == kNoTask)
+    {
+      return;
+    }
+
+    task         = next;
+    continuation = true;
+  }
+}
+
+JobHandle
+launch_task_graph(TaskGraph* graph)
+{
+  ASSERT_MSG_FATAL(job_has_completed(graph->counter), "Task graph was launched again before its previous launch completed.");
+  if (graph->node_count == 0)
+  {
+    return 0;
+  }
+
+  // Nothing else is touching the graph between launches, kicking the roots publishes these
+  for (u32 inode = 0; inode < graph->node_count; inode++)
+  {
+    graph->remaining[inode] = graph->nodes[inode].dependency_count;
+  }
+
+  JobHandle counter = init_job_counter(graph->node_count);
+  graph->counter    = counter;
+
+  for (u32 iroot = 0; iroot < graph->root_count; iroot++)
+  {
+    kick_task_graph_node(graph, counter, graph->roots[iroot]);
+  }
+
+  return counter;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "Core/Foundation/types.h"
+
+#include "Core/Foundation/Containers/array.h"
+
+#include "Core/Engine/job_system.h"
+
+// Task graphs are for work that has the same shape every frame. The dependencies get resolved once in
+// compile_task_graph, after which a launch is just resetting a few counters and kicking the root tasks.
+// Every task kicks its own successors once they're ready, so nothing ever has to block waiting on a whole
+// level of the graph to finish.
+
+typedef u32 TaskId;
+static constexpr TaskId kNoTask = U32_MAX;
+
+struct TaskGraphNode
+{
+  JobEntry     entry;
+  JobDebugInfo debug_info;
+  JobPriority  priority         = kJobPriorityHigh;
+
+  // How many tasks need to finish before this one can start
+  u32          dependency_count = 0;
+  // Range in TaskGraph::successors of the tasks that depend on this one
+  u32          successor_start  = 0;
+  u32          successor_count  = 0;
+};
+
+struct TaskGraphDependency
+{
+  TaskId task       = kNoTask;
+  TaskId depends_on = kNoTask;
+};
+
+struct TaskGraphBuilder
+{
+  Array<TaskGraphNode>       nodes;
+  Array<TaskGraphDependency> dependencies;
+};
+
+struct TaskGraph
+{
+  TaskGraphNode* nodes           = nullptr;
+  u32            node_count      = 0;
+
+  TaskId*        successors      = nullptr;
+  u32            successor_count = 0;
+
+  // Tasks without any dependencies, these get kicked by launch_task_graph
+  TaskId*        roots           = nullptr;
+  u32            root_count      = 0;
+
+  // Dependencies left before each task can start. Reset from dependency_count on every launch, accessed atomically.
+  u32*           remaining       = nullptr;
+  // Every task of the launch in flight is on this counter
+  JobHandle      counter         = 0;
+};
+
+TaskGraphBuilder init_task_graph_builder(AllocHeap heap, u32 max_tasks, u32 max_dependencies);
+
+TaskId _task_graph_add(TaskGraphBuilder* builder, JobPriority priority, JobDesc desc, JobDebugInfo debug_info);
+// task won't start until depends_on has finished
+void   task_graph_add_dependency(TaskGraphBuilder* builder, TaskId task, TaskId depends_on);
+
+// The builder can be thrown away once it's compiled. Fatal if the dependencies have a cycle.
+TaskGraph compile_task_graph(AllocHeap heap, const TaskGraphBuilder* builder);
+
+// Kicks every task in the graph and returns the counter they're all on, yield_to_counter on it to wait for the whole graph.
+// A graph can be launched any number of times, but only once the previous launch has completed.
+JobHandle launch_task_graph(TaskGraph* graph);
+
+#define task_graph_add_closure(builder, priority, closure) _task_graph_add(builder, priority, init_job_desc_from_closure(closure), JOB_DEBUG_INFO_STRUCT)
+#define task_graph_add(builder, priority, function_call) task_graph_add_closure(builder, priority, [=]() { function_call; })
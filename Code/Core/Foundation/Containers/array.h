@@ -95,7 +95,7 @@ struct Array
 };
 
 template <typename T>
-struct Array<typename T, 0>
+struct Array<T, 0>
 {
   T* memory = nullptr;
   size_t size = 0;
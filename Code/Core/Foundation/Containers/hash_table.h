@@ -3,6 +3,7 @@
 
 #include "Core/Foundation/Containers/option.h"
 #include "Core/Foundation/Containers/iterator.h"
+#include "Core/Foundation/Containers/array.h"
 
 #include "Core/Foundation/Vendor/xxhash/xxhash.h"
 
@@ -19,11 +20,111 @@ enum HashTableCtrl : u8
   kHashTableCtrlFullMask = 0x7F,
 };
 
+// Number of old groups that get moved into the new arrays on every insert/erase while a growable table is rehashing.
+// The new arrays are 2x the size, so this just needs to be > 0 to always finish before the new arrays fill up.
+static constexpr u64 kHashTableMigrateGroupsPerOp = 2;
+
+// Number of control bytes scanned at once. 32 wide groups are matched with a single AVX2 compare when the
+// CPU supports it, and two SSE2 compares when it doesn't. Define HASH_TABLE_GROUP_WIDTH to 16 to get the old layout.
+#ifndef HASH_TABLE_GROUP_WIDTH
+#define HASH_TABLE_GROUP_WIDTH 32
+#endif
+static constexpr u32 kHashTableGroupWidth = HASH_TABLE_GROUP_WIDTH;
+static_assert(kHashTableGroupWidth == 16 || kHashTableGroupWidth == 32, "Hash table groups must be 16 or 32 wide.");
+
+inline const bool g_HashTableUseAvx2 = kHashTableGroupWidth == 32 && cpu_supports_avx2();
+
+TARGET_AVX2 inline u32
+hash_table_match_byte_avx2(const u8* ctrls, u8 byte)
+{
+  u8x32 group = _mm256_loadu_si256((const u8x32*)ctrls);
+  return (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_set1_epi8((char)byte), group));
+}
+
+TARGET_AVX2 inline u32
+hash_table_match_top_bit_avx2(const u8* ctrls)
+{
+  return (u32)_mm256_movemask_epi8(_mm256_loadu_si256((const u8x32*)ctrls));
+}
+
+// Returns a bitmask of every control byte in the group that is equal to `byte`
+inline u32
+hash_table_match_byte(const u8* ctrls, u8 byte)
+{
+  if constexpr (kHashTableGroupWidth == 32)
+  {
+    if (g_HashTableUseAvx2)
+    {
+      return hash_table_match_byte_avx2(ctrls, byte);
+    }
+  }
+
+  u32 ret = 0;
+  for (u32 i = 0; i < kHashTableGroupWidth; i += 16)
+  {
+    u8x16 group = _mm_loadu_si128((const u8x16*)(ctrls + i));
+    ret        |= (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8((char)byte), group)) << i;
+  }
+  return ret;
+}
+
+// Returns a bitmask of every control byte in the group that has the top bit set, which is both empty and deleted slots.
+inline u32
+hash_table_match_empty_or_deleted(const u8* ctrls)
+{
+  if constexpr (kHashTableGroupWidth == 32)
+  {
+    if (g_HashTableUseAvx2)
+    {
+      return hash_table_match_top_bit_avx2(ctrls);
+    }
+  }
+
+  u32 ret = 0;
+  for (u32 i = 0; i < kHashTableGroupWidth; i += 16)
+  {
+    ret |= (u32)_mm_movemask_epi8(_mm_loadu_si128((const u8x16*)(ctrls + i))) << i;
+  }
+  return ret;
+}
+
 template <typename T>
 concept Hashable = __has_unique_object_representations(T);
 
+// The hasher and equality functor for a table. Tables can be given custom traits, in which case the key doesn't
+// need to be Hashable. Traits can also overload hash/equal for other query types (heterogeneous lookup), in which
+// case hash(query) _must_ give the same value as hash(key) for keys that compare equal to the query.
+template <typename K>
+struct DefaultHashTraits
+{
+  static_assert(Hashable<K>, "Keys without unique object representations need custom hash traits.");
+
+  static u64  hash (const K& key)               { return hash_u64(&key, sizeof(key)); }
+  static bool equal(const K& lhs, const K& rhs) { return memcmp(&lhs, &rhs, sizeof(K)) == 0; }
+};
+
+// Keys are C strings that are hashed/compared by their contents instead of the pointer.
+// Lookups can also be done with a Span<char> so you can look up substrings without copying them into a temporary.
+struct CStrHashTraits
+{
+  static u64  hash (const char* key)                      { return hash_u64(key, strlen(key)); }
+  static u64  hash (Span<char> key)                       { return hash_u64(key.memory, key.size); }
+  static bool equal(const char* lhs, const char* rhs)     { return strcmp(lhs, rhs) == 0; }
+  static bool equal(const char* lhs, Span<char> rhs)      { return strncmp(lhs, rhs.memory, rhs.size) == 0 && lhs[rhs.size] == 0; }
+};
+
 // Swiss-table implementation. Really simple to implement and really well optimized.
-template <Hashable K, typename V>
+//
+// Tables created with init_hash_table are fixed size, values never move so pointers returned
+// from insert/find are stable until that key is erased.
+//
+// Tables created with init_growable_hash_table grow by 2x when they get past 75% load. The rehash is incremental:
+// the old arrays are kept around and a few groups are migrated on every insert/erase, so there is no big spike.
+// This means that _any_ insert or erase can move values, so don't hold onto pointers into a growable table.
+//
+// Tombstones count towards the load. When an insert pushes the table over 75% and a good chunk of that is tombstones,
+// they get cleaned up instead: growable tables rehash in place, fixed tables drop the tombstones nothing probes through.
+template <typename K, typename V, typename Traits = DefaultHashTraits<K>>
 struct HashTable
 {
   union Hash
@@ -41,12 +142,8 @@ struct HashTable
 
   struct Group
   {
-    union
-    {
-      u8x16 ctrls_sse;
-      u8 ctrls[16];
-    };
-    K keys[16];
+    u8 ctrls[kHashTableGroupWidth];
+    K keys[kHashTableGroupWidth];
   };
 
   struct MutableKeyValue
@@ -61,39 +158,134 @@ struct HashTable
     const V& value;
   };
 
-  typedef u64 (*HashFunc)(const void* data, size_t size);
-
   Group* groups = nullptr;
   V* values = nullptr;
-  HashFunc hash_func = &hash_u64;
 
   u64 groups_size = 0;
   u64 capacity = 0;
 
+  // Number of live entries (including ones that haven't been migrated out of the old arrays yet)
   u64 used = 0;
+  // Number of kHashTableCtrlDeleted slots in groups. Cleaned up by inserts once they push the table over its max load.
+  u64 tombstones = 0;
+  // Fixed tables can't get rid of tombstones that keys probe through, this is how many were left after the last purge
+  // so that we don't go purging again until enough new ones show up.
+  u64 purged_tombstones = 0;
+
+  // Only valid for growable tables, otherwise alloc_fn is nullptr.
+  FreeHeap heap = {0};
+
+  // The arrays we are currently migrating out of while growing, nullptr when not growing.
+  Group* old_groups = nullptr;
+  V* old_values = nullptr;
+  u64 old_groups_size = 0;
+  u64 migrate_group = 0;
 
   Iterator<HashTable, MutableKeyValue> begin() { return Iterator<HashTable, MutableKeyValue>::begin(this);  }
   Iterator<HashTable, MutableKeyValue> end() { return Iterator<HashTable, MutableKeyValue>::end(this);  }
   Iterator<const HashTable, ConstKeyValue> begin() const { return Iterator<const HashTable, ConstKeyValue>::begin(this);  }
   Iterator<const HashTable, ConstKeyValue> end() const { return Iterator<const HashTable, ConstKeyValue>::end(this);  }
+
+  static constexpr u32 kGroupMask = kHashTableGroupWidth == 32 ? U32_MAX : U16_MAX;
+
+  static u32 match_meta(const Group* group, u8 meta) { return hash_table_match_byte(group->ctrls, meta); }
+  static u32 match_empty(const Group* group) { return hash_table_match_byte(group->ctrls, kHashTableCtrlEmpty); }
+  static u32 match_empty_or_deleted(const Group* group) { return hash_table_match_empty_or_deleted(group->ctrls); }
+  static u32 match_full(const Group* group) { return ~match_empty_or_deleted(group) & kGroupMask; }
+
+  // Returns the slot index of the key in the given groups, or U64_MAX if it isn't in there
+  template <typename Q, typename Equal>
+  static u64 find_slot(const Group* groups, u64 groups_size, Hash h, const Q& query, Equal equal)
+  {
+    u64 start_index = h.position % groups_size;
+    u64 group_index = start_index;
+    do
+    {
+      auto* group = groups + group_index;
+      u32 mask = match_meta(group, (u8)h.meta);
+      while (mask != 0)
+      {
+        u32 i = count_trailing_zeroes(mask);
+        mask &= mask - 1;
+        if (!equal(group->keys[i], query)) [[unlikely]]
+          continue;
+        return group_index * kHashTableGroupWidth + i;
+      }
+
+      // If there is at least one empty element, then that means that the hash _had_
+      // a place to go, but there obviously isn't one.
+      if (match_empty(group) != 0)
+        return U64_MAX;
+
+      group_index = (group_index + 1) % groups_size;
+    } while (group_index != start_index);
+
+    return U64_MAX;
+  }
+
+  // Returns the first empty or deleted slot in the probe sequence of the hash, or U64_MAX if the groups are completely full.
+  // Doesn't check whether the key already exists.
+  static u64 find_insert_slot(const Group* groups, u64 groups_size, Hash h)
+  {
+    u64 start_index = h.position % groups_size;
+    u64 group_index = start_index;
+    do
+    {
+      u32 mask = match_empty_or_deleted(groups + group_index);
+      if (mask != 0)
+      {
+        return group_index * kHashTableGroupWidth + count_trailing_zeroes(mask);
+      }
+
+      group_index = (group_index + 1) % groups_size;
+    } while (group_index != start_index);
+
+    return U64_MAX;
+  }
+
 private:
   friend Iterator<HashTable, MutableKeyValue>;
   friend Iterator<const HashTable, ConstKeyValue>;
 
+  // Iteration goes over the current groups and then the old groups (if we're in the middle of growing),
+  // as if they were one big array.
   MutableKeyValue operator[](size_t idx)
   {
-    return {groups[idx / 16].keys[idx % 16], values[idx]};
-  }
+    if (idx < groups_size * kHashTableGroupWidth)
+    {
+      return {groups[idx / kHashTableGroupWidth].keys[idx % kHashTableGroupWidth], values[idx]};
+    }
 
+    idx -= groups_size * kHashTableGroupWidth;
+    return {old_groups[idx / kHashTableGroupWidth].keys[idx % kHashTableGroupWidth], old_values[idx]};
+  }
 
   const ConstKeyValue operator[](size_t idx) const
   {
-    return {groups[idx / 16].keys[idx % 16], values[idx]};
+    if (idx < groups_size * kHashTableGroupWidth)
+    {
+      return {groups[idx / kHashTableGroupWidth].keys[idx % kHashTableGroupWidth], values[idx]};
+    }
+
+    idx -= groups_size * kHashTableGroupWidth;
+    return {old_groups[idx / kHashTableGroupWidth].keys[idx % kHashTableGroupWidth], old_values[idx]};
   }
 
+  const Group* m_group(u64 group_index) const
+  {
+    if (group_index < groups_size)
+    {
+      return groups + group_index;
+    }
+
+    return old_groups + (group_index - groups_size);
+  }
+
+  u64 m_total_groups() const { return groups_size + old_groups_size; }
+
   size_t m_increment_idx(size_t idx) const
   {
-    ASSERT(idx < groups_size * 16);
+    ASSERT(idx < m_end_idx());
     idx++;
 
     return m_increment_to_valid_idx(idx);
@@ -101,248 +293,545 @@ private:
 
   size_t m_increment_to_valid_idx(size_t idx) const
   {
-    u64 start_index = idx / 16;
-    u64 group_index = start_index;
-    ASSERT(group_index < groups_size);
-
-    u8  offset      = idx % 16;
+    u64 group_index = idx / kHashTableGroupWidth;
+    u32 offset      = idx % kHashTableGroupWidth;
 
-    do
+    while (group_index < m_total_groups())
     {
-      auto* group = groups + group_index;
-      // We AND with the ctrl_empty mask because we also want to include
-      // tombstones here.
-      u16 mask = (u16)_mm_movemask_epi8(_mm_and_si128(_mm_set1_epi8(kHashTableCtrlEmpty), group->ctrls_sse));
+      u32 mask = match_full(m_group(group_index)) & (U32_MAX << offset);
 
       // Find the first non-empty/deleted element in the hashmap
-      for (u8 i = offset; i < 16; i++)
+      if (mask != 0)
       {
-        if ((mask & (1 << i)) == 0)
-        {
-          return idx;
-        }
- 
-        idx++;
+        return group_index * kHashTableGroupWidth + count_trailing_zeroes(mask);
       }
 
-      offset      = 0;
+      offset = 0;
       group_index++;
-    } while (group_index < groups_size);
+    }
 
     return m_end_idx();
   }
 
   size_t m_decrement_idx(size_t idx) const
-  { 
+  {
     ASSERT(idx > 0);
     size_t orig_idx = idx;
     idx--;
 
-    u64 start_index = idx / 16;
-    u64 group_index = start_index;
+    s64 group_index = (s64)(idx / kHashTableGroupWidth);
+    u32 offset      = idx % kHashTableGroupWidth;
 
-    u8  offset      = idx % 16;
-    do
+    while (group_index >= 0)
     {
-      auto* group = groups + group_index;
-      // We AND with the ctrl_empty mask because we also want to include
-      // tombstones here.
-      u16 mask = _mm_movemask_epi8(_mm_and_si128(_mm_set1_epi8(kHashTableCtrlEmpty), group->ctrls_sse));
+      u32 mask = match_full(m_group((u64)group_index)) & (U32_MAX >> (31 - offset));
 
-      // Find the first non-empty/deleted element in the hashmap
-      for (s16 i = offset; i >= 0; i--)
-      {
-        if ((mask & (1 << i)) == 0)
-        {
-          return idx;
-        }
- 
-        idx--;
-      }
-
-      if (group_index == 0)
+      // Find the last non-empty/deleted element in the hashmap
+      if (mask != 0)
       {
-        return orig_idx;
+        return (size_t)group_index * kHashTableGroupWidth + 31 - count_leading_zeroes(mask);
       }
 
-      offset      = 15;
-      group_index = (group_index - 1) % groups_size;
-    } while (group_index != start_index);
+      offset = kHashTableGroupWidth - 1;
+      group_index--;
+    }
 
     return orig_idx;
-
   }
 
-  size_t m_begin_idx() const 
+  size_t m_begin_idx() const
   {
     return m_increment_to_valid_idx(0);
   }
-  size_t m_end_idx() const { return groups_size * 16; }
+  size_t m_end_idx() const { return m_total_groups() * kHashTableGroupWidth; }
 };
 
-template <typename K, typename V>
-inline HashTable<K, V>
-init_hash_table(AllocHeap heap, u64 capacity)
+#define HASH_TABLE_TEMPLATE template <typename K, typename V, typename Traits>
+#define HASH_TABLE_TYPE HashTable<K, V, Traits>
+
+// Number of slots needed to hold `count` entries without going over the 75% max load
+inline u64
+hash_table_slots_for_entries(u64 count)
+{
+  return count * 4 / 3;
+}
+
+// slot_count gets rounded up to a whole number of groups, the max load is not applied here.
+HASH_TABLE_TEMPLATE
+inline void
+hash_table_alloc_arrays(HASH_TABLE_TYPE* table, AllocHeap heap, u64 slot_count)
 {
-  HashTable<K, V> ret = {};
+  using GroupType = typename HASH_TABLE_TYPE::Group;
 
-  capacity        = ALIGN_POW2(capacity * 4 / 3 + 15, 16);
-  ret.groups_size = (capacity + 15) / 16;
+  u64 capacity       = ALIGN_POW2(MAX(slot_count, 1ULL), kHashTableGroupWidth);
+  table->groups_size = capacity / kHashTableGroupWidth;
 
-  using GroupType = typename HashTable<K, V>::Group;
-  ret.groups      = HEAP_ALLOC(GroupType, heap, ret.groups_size);
-  zero_memory(ret.groups, ret.groups_size * sizeof(typename HashTable<K, V>::Group));
-  ret.values      = HEAP_ALLOC(V, heap, capacity);
-  zero_memory(ret.values, capacity * sizeof(V));
-  ret.capacity    = capacity;
-  ret.used        = 0;
+  table->groups      = HEAP_ALLOC(GroupType, heap, table->groups_size);
+  zero_memory(table->groups, table->groups_size * sizeof(GroupType));
+  table->values      = HEAP_ALLOC(V, heap, capacity);
+  zero_memory(table->values, capacity * sizeof(V));
+  table->capacity          = capacity;
+  table->tombstones        = 0;
+  table->purged_tombstones = 0;
 
-  for (u64 i = 0; i < ret.groups_size; i++)
+  for (u64 i = 0; i < table->groups_size; i++)
   {
-    ret.groups[i].ctrls_sse = _mm_set1_epi8(kHashTableCtrlEmpty);
+    memset(table->groups[i].ctrls, kHashTableCtrlEmpty, sizeof(table->groups[i].ctrls));
   }
+}
+
+template <typename K, typename V, typename Traits = DefaultHashTraits<K>>
+inline HASH_TABLE_TYPE
+init_hash_table(AllocHeap heap, u64 capacity)
+{
+  HASH_TABLE_TYPE ret = {};
+  hash_table_alloc_arrays(&ret, heap, hash_table_slots_for_entries(capacity));
+  ret.used = 0;
 
   return ret;
 }
 
-template <typename K, typename V>
-inline V*
-hash_table_insert(HashTable<K, V>* table, const K& key)
+template <typename K, typename V, typename Traits = DefaultHashTraits<K>>
+inline HASH_TABLE_TYPE
+init_growable_hash_table(FreeHeap heap, u64 initial_capacity = 16)
 {
-  using Hash = typename HashTable<K, V>::Hash;
+  HASH_TABLE_TYPE ret = {};
+  hash_table_alloc_arrays(&ret, (AllocHeap)heap, hash_table_slots_for_entries(MAX(initial_capacity, 1ULL)));
+  ret.used = 0;
+  ret.heap = heap;
 
-  Hash h = {0};
-  h.raw = table->hash_func(&key, sizeof(key));
+  return ret;
+}
 
-  u64 start_index = h.position % table->groups_size;
-  u64 group_index = start_index;
-  do
+HASH_TABLE_TEMPLATE
+inline void
+destroy_hash_table(HASH_TABLE_TYPE* table)
+{
+  ASSERT_MSG_FATAL(table->heap.free_fn != nullptr, "Only growable hash tables own their memory and can be destroyed.");
+
+  HEAP_FREE(table->heap, table->groups);
+  HEAP_FREE(table->heap, table->values);
+  if (table->old_groups != nullptr)
+  {
+    HEAP_FREE(table->heap, table->old_groups);
+    HEAP_FREE(table->heap, table->old_values);
+  }
+
+  zero_memory(table, sizeof(HASH_TABLE_TYPE));
+}
+
+HASH_TABLE_TEMPLATE
+inline bool
+hash_table_is_growable(const HASH_TABLE_TYPE* table)
+{
+  return table->heap.alloc_fn != nullptr;
+}
+
+template <typename K, typename V, typename Traits, typename Q>
+inline typename HASH_TABLE_TYPE::Hash
+hash_table_hash(const HASH_TABLE_TYPE* table, const Q& query)
+{
+  UNREFERENCED_PARAMETER(table);
+  typename HASH_TABLE_TYPE::Hash h = {0};
+  h.raw = Traits::hash(query);
+  return h;
+}
+
+// Tombstones make probe sequences longer and are only ever reused by inserts that land in the same group,
+// so they pile up in registries with a lot of churn. A tombstone only needs to exist if some key _probed through_
+// its group to get to where it is stored. This finds every group that no key probed through and turns its
+// tombstones back into empty slots. Nothing is moved, so this is safe to do on fixed tables with stable pointers.
+HASH_TABLE_TEMPLATE
+inline void
+hash_table_purge_tombstones(HASH_TABLE_TYPE* table)
+{
+  using Hash = typename HASH_TABLE_TYPE::Hash;
+
+  if (table->tombstones == 0)
+    return;
+
+  u64 groups_size = table->groups_size;
+
+  // Walk the groups backwards, tracking how many more groups (going backwards) some key stored at or after
+  // the current group had to probe through. We need to go around twice since probing wraps around,
+  // the first lap is just to get `remaining` right at the start of the second lap.
+  u64 remaining = 0;
+  for (u64 step = 0; step < groups_size * 2; step++)
+  {
+    u64   group_index = groups_size - 1 - (step % groups_size);
+    auto* group       = table->groups + group_index;
+
+    bool probed_through = remaining > 0;
+    if (remaining > 0)
+    {
+      remaining--;
+    }
+
+    u32 mask = HASH_TABLE_TYPE::match_full(group);
+    while (mask != 0)
+    {
+      u32 i = count_trailing_zeroes(mask);
+      mask &= mask - 1;
+
+      Hash h        = hash_table_hash(table, group->keys[i]);
+      u64  home     = h.position % groups_size;
+      u64  distance = (group_index + groups_size - home) % groups_size;
+      remaining     = MAX(remaining, distance);
+    }
+
+    if (step < groups_size || probed_through)
+      continue;
+
+    for (u32 i = 0; i < kHashTableGroupWidth; i++)
+    {
+      if (group->ctrls[i] != kHashTableCtrlDeleted)
+        continue;
+
+      group->ctrls[i] = kHashTableCtrlEmpty;
+      table->tombstones--;
+    }
+  }
+
+  table->purged_tombstones = table->tombstones;
+}
+
+// Puts every entry back as close to its home group as it can get without reallocating, which gets rid of every tombstone.
+// Values move around, so this is only for growable tables. Same idea as absl's DropDeletesWithoutResize.
+HASH_TABLE_TEMPLATE
+inline void
+hash_table_rehash_in_place(HASH_TABLE_TYPE* table)
+{
+  using Hash = typename HASH_TABLE_TYPE::Hash;
+
+  ASSERT_MSG_FATAL(hash_table_is_growable(table), "Rehashing in place moves values, fixed size hash tables need stable pointers.");
+  ASSERT_MSG_FATAL(table->old_groups == nullptr, "Can't rehash in place while migrating out of the old arrays.");
+
+  u64 groups_size = table->groups_size;
+
+  // Full slots become deleted, meaning "still needs to be placed", and tombstones become empty.
+  for (u64 group_index = 0; group_index < groups_size; group_index++)
   {
     auto* group = table->groups + group_index;
+    for (u32 i = 0; i < kHashTableGroupWidth; i++)
     {
-      // Look for already existing key.
-      u16 mask = (u16)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h.meta), group->ctrls_sse));
-      if (mask != 0)
+      group->ctrls[i] = group->ctrls[i] & kHashTableCtrlEmpty ? kHashTableCtrlEmpty : kHashTableCtrlDeleted;
+    }
+  }
+
+  alignas(K) u8 tmp_key  [sizeof(K)];
+  alignas(V) u8 tmp_value[sizeof(V)];
+
+  for (u64 slot = 0; slot < table->capacity; slot++)
+  {
+    auto* group = table->groups + slot / kHashTableGroupWidth;
+    u32   idx   = slot % kHashTableGroupWidth;
+
+    // Every iteration places one entry, so this runs at most capacity times over the whole rehash
+    while (group->ctrls[idx] == kHashTableCtrlDeleted)
+    {
+      Hash h      = hash_table_hash(table, group->keys[idx]);
+      u64  home   = h.position % groups_size;
+      u64  target = HASH_TABLE_TYPE::find_insert_slot(table->groups, groups_size, h);
+
+      // find_insert_slot always comes across this slot (it's marked deleted) so the target is never further down the probe sequence.
+      // If it's in the same group we're already where a fresh insert would put us.
+      u64 target_group = target / kHashTableGroupWidth;
+      u64 slot_group   = slot   / kHashTableGroupWidth;
+      if ((target_group + groups_size - home) % groups_size == (slot_group + groups_size - home) % groups_size)
+      {
+        group->ctrls[idx] = (u8)h.meta & kHashTableCtrlFullMask;
+        break;
+      }
+
+      auto* dst     = table->groups + target_group;
+      u32   dst_idx = target % kHashTableGroupWidth;
+      if (dst->ctrls[dst_idx] == kHashTableCtrlEmpty)
       {
-        for (u8 i = 0; i < 16; i++)
-        {
-          if ((mask & (1 << i)) == 0)
-            continue;
-          if (group->keys[i] != key) [[unlikely]]
-            continue;
-
-          return &table->values[group_index * 16 + i];
-        }
+        memcpy(&dst->keys[dst_idx],   &group->keys[idx],   sizeof(K));
+        memcpy(table->values + target, table->values + slot, sizeof(V));
+        dst->ctrls[dst_idx] = (u8)h.meta & kHashTableCtrlFullMask;
+        group->ctrls[idx]   = kHashTableCtrlEmpty;
+        break;
       }
+
+      // The target holds an entry that hasn't been placed yet. Swap it in here and go around again to place it.
+      memcpy(tmp_key,                &dst->keys[dst_idx],   sizeof(K));
+      memcpy(&dst->keys[dst_idx],    &group->keys[idx],     sizeof(K));
+      memcpy(&group->keys[idx],      tmp_key,               sizeof(K));
+      memcpy(tmp_value,              table->values + target, sizeof(V));
+      memcpy(table->values + target, table->values + slot,  sizeof(V));
+      memcpy(table->values + slot,   tmp_value,             sizeof(V));
+      dst->ctrls[dst_idx] = (u8)h.meta & kHashTableCtrlFullMask;
     }
+  }
+
+  table->tombstones        = 0;
+  table->purged_tombstones = 0;
+}
+
+HASH_TABLE_TEMPLATE
+inline void
+hash_table_migrate_groups(HASH_TABLE_TYPE* table, u64 count)
+{
+  using Hash = typename HASH_TABLE_TYPE::Hash;
+
+  if (table->old_groups == nullptr)
+    return;
+
+  // count is U64_MAX when everything needs to go right now, so it can't just get added on to migrate_group
+  u64 end = count >= table->old_groups_size - table->migrate_group ? table->old_groups_size : table->migrate_group + count;
+  for (; table->migrate_group < end; table->migrate_group++)
+  {
+    auto* group = table->old_groups + table->migrate_group;
+
+    u32 mask = HASH_TABLE_TYPE::match_full(group);
+    while (mask != 0)
     {
-      // We AND with the ctrl_empty mask because we also want to include
-      // tombstones here.
-      u16 mask = (u16)_mm_movemask_epi8(_mm_and_si128(_mm_set1_epi8(kHashTableCtrlEmpty), group->ctrls_sse));
+      u32 i = count_trailing_zeroes(mask);
+      mask &= mask - 1;
 
-      // Find the first empty/deleted element in the hashmap
-      for (u8 i = 0; i < 16; i++)
+      Hash h    = hash_table_hash(table, group->keys[i]);
+      u64  slot = HASH_TABLE_TYPE::find_insert_slot(table->groups, table->groups_size, h);
+      ASSERT_MSG_FATAL(slot != U64_MAX, "Ran out of space in the hash table while growing. This is a bug.");
+
+      auto* dst = table->groups + slot / kHashTableGroupWidth;
+      u32   idx = slot % kHashTableGroupWidth;
+      if (dst->ctrls[idx] == kHashTableCtrlDeleted)
       {
-        if ((mask & (1 << i)) == 0)
-          continue;
-  
-        group->ctrls[i] = (u8)h.meta & kHashTableCtrlFullMask;
-        group->keys[i] = key;
-
-        table->used++;
-  
-        V* ret = &table->values[group_index * 16 + i];
-        zero_memory(ret, sizeof(V));
-        return ret;
+        table->tombstones--;
       }
+      dst->ctrls[idx] = (u8)h.meta & kHashTableCtrlFullMask;
+      dst->keys[idx]  = group->keys[i];
+      memcpy(table->values + slot, table->old_values + table->migrate_group * kHashTableGroupWidth + i, sizeof(V));
+
+      // Leave a tombstone so that lookups in the old arrays can still probe through this group
+      group->ctrls[i] = kHashTableCtrlDeleted;
     }
+  }
+
+  if (table->migrate_group == table->old_groups_size)
+  {
+    HEAP_FREE(table->heap, table->old_groups);
+    HEAP_FREE(table->heap, table->old_values);
+
+    table->old_groups      = nullptr;
+    table->old_values      = nullptr;
+    table->old_groups_size = 0;
+    table->migrate_group   = 0;
+  }
+}
+
+HASH_TABLE_TEMPLATE
+inline void
+hash_table_begin_grow(HASH_TABLE_TYPE* table, u64 slot_count)
+{
+  ASSERT_MSG_FATAL(hash_table_is_growable(table), "Attempted to grow a fixed size hash table. Use init_growable_hash_table if you need this.");
+
+  // Can't have two migrations going on at once
+  hash_table_migrate_groups(table, U64_MAX);
 
-    group_index = (group_index + 1) % table->groups_size;
-  } while (group_index != start_index);
+  table->old_groups      = table->groups;
+  table->old_values      = table->values;
+  table->old_groups_size = table->groups_size;
+  table->migrate_group   = 0;
+
+  hash_table_alloc_arrays(table, (AllocHeap)table->heap, slot_count);
+}
+
+// Called by inserts before they look for a slot. Once live entries plus tombstones would go over the 75% max load, either clean the
+// tombstones up or grow. Cleaning up is O(capacity), so it only happens when there are enough tombstones to pay for it, which keeps
+// erase O(1) and insert amortized O(1).
+HASH_TABLE_TEMPLATE
+inline void
+hash_table_make_room(HASH_TABLE_TYPE* table)
+{
+  if ((table->used + table->tombstones + 1) * 4 <= table->capacity * 3)
+    return;
 
-  if (table->used < table->capacity)
+  if (!hash_table_is_growable(table))
   {
-    // This should never be possible, if this is true then something went wrong in the hash table
-    UNREACHABLE;
+    if (table->tombstones >= table->purged_tombstones + table->capacity / 8)
+    {
+      hash_table_purge_tombstones(table);
+    }
+    return;
   }
 
-  ASSERT_MSG_FATAL(table->used < table->capacity, "Attempted to insert into hash table which is full. No matching slots with given key were found.");
-  return nullptr;
+  // Rehashing in place only makes sense if it leaves room for a good number of inserts, otherwise we'd be right back here.
+  if ((table->used + 1) * 8 <= table->capacity * 5)
+  {
+    hash_table_migrate_groups(table, U64_MAX);
+    hash_table_rehash_in_place(table);
+  }
+  else
+  {
+    hash_table_begin_grow(table, table->capacity * 2);
+  }
+}
+
+// Makes sure that the table can hold at least `capacity` entries without growing.
+// Fixed size tables can't grow, so this just asserts that they're already big enough.
+HASH_TABLE_TEMPLATE
+inline void
+hash_table_reserve(HASH_TABLE_TYPE* table, u64 capacity)
+{
+  if (capacity * 4 <= table->capacity * 3)
+    return;
+
+  ASSERT_MSG_FATAL(hash_table_is_growable(table), "Attempted to reserve %llu entries in a fixed size hash table with capacity %llu.", capacity, table->capacity);
+
+  // Since the caller asked for it, just do the whole rehash now instead of spreading it out
+  hash_table_begin_grow(table, hash_table_slots_for_entries(capacity));
+  hash_table_migrate_groups(table, U64_MAX);
 }
 
-template <typename K, typename V>
+HASH_TABLE_TEMPLATE
 inline V*
-hash_table_find(const HashTable<K, V>* table, const K& key)
+hash_table_insert(HASH_TABLE_TYPE* table, const K& key)
 {
-  using Hash = typename HashTable<K, V>::Hash;
+  using Hash = typename HASH_TABLE_TYPE::Hash;
 
-  Hash h = {0};
-  h.raw = table->hash_func(&key, sizeof(key));
+  hash_table_migrate_groups(table, kHashTableMigrateGroupsPerOp);
+
+  Hash h     = hash_table_hash(table, key);
+  auto equal = [](const K& lhs, const K& rhs) { return Traits::equal(lhs, rhs); };
 
-  u64 start_index = h.position % table->groups_size;
-  u64 group_index = start_index;
-  do
+  u64 slot = HASH_TABLE_TYPE::find_slot(table->groups, table->groups_size, h, key, equal);
+  if (slot != U64_MAX)
   {
-    auto* group = table->groups + group_index;
-    u16 mask = (u16)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h.meta), group->ctrls_sse));
-    for (u8 i = 0; i < 16; i++)
+    return &table->values[slot];
+  }
+
+  // If the key hasn't been migrated yet, pull it over now so that it only ever lives in one place
+  Option<V> old_value = None;
+  if (table->old_groups != nullptr)
+  {
+    u64 old_slot = HASH_TABLE_TYPE::find_slot(table->old_groups, table->old_groups_size, h, key, equal);
+    if (old_slot != U64_MAX)
     {
-      if ((mask & (1 << i)) == 0)
-        continue;
-      if (group->keys[i] != key) [[unlikely]]
-        continue;
-      return &table->values[group_index * 16 + i];
+      old_value = table->old_values[old_slot];
+      table->old_groups[old_slot / kHashTableGroupWidth].ctrls[old_slot % kHashTableGroupWidth] = kHashTableCtrlDeleted;
+      table->used--;
     }
+  }
+
+  hash_table_make_room(table);
+
+  slot = HASH_TABLE_TYPE::find_insert_slot(table->groups, table->groups_size, h);
+  ASSERT_MSG_FATAL(slot != U64_MAX && table->used < table->capacity, "Attempted to insert into hash table which is full. No matching slots with given key were found.");
+
+  auto* group = table->groups + slot / kHashTableGroupWidth;
+  u32   idx   = slot % kHashTableGroupWidth;
+  if (group->ctrls[idx] == kHashTableCtrlDeleted)
+  {
+    table->tombstones--;
+  }
+  group->ctrls[idx] = (u8)h.meta & kHashTableCtrlFullMask;
+  group->keys[idx]  = key;
+
+  table->used++;
+
+  V* ret = &table->values[slot];
+  if (old_value)
+  {
+    memcpy(ret, &old_value.value, sizeof(V));
+  }
+  else
+  {
+    zero_memory(ret, sizeof(V));
+  }
+  return ret;
+}
+
+// Looks up with a hasher and equality functor supplied by the caller. `hasher(query)` must give the same hash as
+// the table's traits give for the key that `key_equal(key, query)` matches, otherwise the lookup will just miss.
+template <typename K, typename V, typename Traits, typename Q, typename Hasher, typename KeyEqual>
+inline V*
+hash_table_find(const HASH_TABLE_TYPE* table, const Q& query, Hasher hasher, KeyEqual key_equal)
+{
+  using Hash = typename HASH_TABLE_TYPE::Hash;
 
-    u16 empty_mask = (u16)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(kHashTableCtrlEmpty), group->ctrls_sse));
+  Hash h = {0};
+  h.raw  = hasher(query);
 
-    // If there is at least one non-empty element, then that means that the hash _had_
-    // a place to go, but there obviously isn't one.
-    if (empty_mask != 0)
-      return nullptr;
+  u64 slot = HASH_TABLE_TYPE::find_slot(table->groups, table->groups_size, h, query, key_equal);
+  if (slot != U64_MAX)
+  {
+    return &table->values[slot];
+  }
 
-    group_index = (group_index + 1) % table->groups_size;
-  } while (group_index != start_index);
+  if (table->old_groups != nullptr)
+  {
+    slot = HASH_TABLE_TYPE::find_slot(table->old_groups, table->old_groups_size, h, query, key_equal);
+    if (slot != U64_MAX)
+    {
+      return &table->old_values[slot];
+    }
+  }
 
   return nullptr;
 }
 
-template <typename K, typename V>
+// The query can be any type that the table's traits can hash and compare against a key (i.e. a Span<char>
+// for CStrHashTraits tables), so you don't need to build a temporary key just to look something up.
+template <typename K, typename V, typename Traits, typename Q>
+inline V*
+hash_table_find(const HASH_TABLE_TYPE* table, const Q& query)
+{
+  return hash_table_find(
+    table,
+    query,
+    [](const Q& q) { return Traits::hash(q); },
+    [](const K& key, const Q& q) { return Traits::equal(key, q); }
+  );
+}
+
+template <typename K, typename V, typename Traits, typename Q>
 inline bool
-hash_table_erase(HashTable<K, V>* table, const K& key)
+hash_table_erase(HASH_TABLE_TYPE* table, const Q& query)
 {
-  using Hash = typename HashTable<K, V>::Hash;
+  using Hash = typename HASH_TABLE_TYPE::Hash;
 
-  Hash h = {0};
-  h.raw = table->hash_func(&key, sizeof(key));
+  hash_table_migrate_groups(table, kHashTableMigrateGroupsPerOp);
 
-  u64 start_index = h.position % table->groups_size;
-  u64 group_index = start_index;
-  do
+  Hash h     = hash_table_hash(table, query);
+  auto equal = [](const K& key, const Q& q) { return Traits::equal(key, q); };
+
+  u64 slot = HASH_TABLE_TYPE::find_slot(table->groups, table->groups_size, h, query, equal);
+  if (slot != U64_MAX)
   {
-    auto* group      = table->groups + group_index;
-    u16   mask       = (u16)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h.meta), group->ctrls_sse));
-    u16   empty_mask = (u16)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(kHashTableCtrlEmpty), group->ctrls_sse));
-    for (u8 i = 0; i < 16; i++)
+    auto* group = table->groups + slot / kHashTableGroupWidth;
+    u32   idx   = slot % kHashTableGroupWidth;
+
+    // If the group has an empty slot then no probe sequence goes past it, so we don't need a tombstone.
+    if (HASH_TABLE_TYPE::match_empty(group) != 0)
     {
-      if ((mask & (1 << i)) == 0)
-        continue;
-      if (group->keys[i] != key) [[unlikely]]
-        continue;
+      group->ctrls[idx] = kHashTableCtrlEmpty;
+    }
+    else
+    {
+      group->ctrls[idx] = kHashTableCtrlDeleted;
+      table->tombstones++;
+    }
+
+    table->used--;
+    return true;
+  }
 
+  if (table->old_groups != nullptr)
+  {
+    slot = HASH_TABLE_TYPE::find_slot(table->old_groups, table->old_groups_size, h, query, equal);
+    if (slot != U64_MAX)
+    {
+      // The old arrays are going away anyway, don't bother tracking tombstones in there
+      table->old_groups[slot / kHashTableGroupWidth].ctrls[slot % kHashTableGroupWidth] = kHashTableCtrlDeleted;
       table->used--;
-      group->ctrls[i] = empty_mask == 0 ? kHashTableCtrlDeleted : kHashTableCtrlEmpty;
       return true;
     }
-
-    // If there is at least one non-empty element, then that means that the hash _had_
-    // a place to go, but there obviously isn't one.
-    if (empty_mask != 0)
-      return false;
-
-    group_index = (group_index + 1) % table->groups_size;
-  } while (group_index != start_index);
+  }
 
   return false;
 }
 
+#undef HASH_TABLE_TEMPLATE
+#undef HASH_TABLE_TYPE
@@ -0,0 +1,353 @@
+#pragma once
+#include "Core/Foundation/memory.h"
+#include "Core/Foundation/threading.h"
+
+// Bounded lock-free multi-producer multi-consumer queue (Dmitry Vyukov's design). Unlike RingQueue this doesn't need an external lock.
+//
+// Every slot has a sequence number that says whose turn it is: a producer with ticket `pos` can write the slot once its sequence == pos,
+// and a consumer with ticket `pos` can read it once its sequence == pos + 1. Producers and consumers only ever contend on their own
+// position counter, and a full/empty queue is detected without touching the other side's counter.
+//
+// Consumers can optionally block with mpmc_ring_queue_pop_wait instead of polling. Producers only pay for a wake-up syscall when someone is actually waiting.
+template <typename T>
+struct MpmcRingQueue
+{
+  struct Slot
+  {
+    u64 sequence = 0;
+    T   data;
+  };
+
+  Slot* slots    = nullptr;
+  u64   mask     = 0;
+
+  alignas(kCacheLineSize) u64 enqueue_pos = 0;
+  alignas(kCacheLineSize) u64 dequeue_pos = 0;
+
+  // Bumped every time something is pushed so that waiting consumers have an address to sleep on.
+  alignas(kCacheLineSize) u32 push_signal = 0;
+  u32                         waiters     = 0;
+  // Set for good by mpmc_ring_queue_wake_all, after that consumers stop going to sleep.
+  u32                         woken       = 0;
+};
+
+// Capacity gets rounded up to the next power of 2
+template <typename T>
+inline MpmcRingQueue<T>
+init_mpmc_ring_queue(AllocHeap heap, u64 capacity)
+{
+  ASSERT_MSG_FATAL(capacity > 0, "Cannot initialize MpmcRingQueue with a capacity of 0.");
+
+  u64 size = 1;
+  while (size < capacity)
+  {
+    size <<= 1;
+  }
+
+  MpmcRingQueue<T> ret;
+  ret.slots = (typename MpmcRingQueue<T>::Slot*)HEAP_ALLOC_ALIGNED(heap, sizeof(typename MpmcRingQueue<T>::Slot) * size, alignof(typename MpmcRingQueue<T>::Slot));
+  ret.mask  = size - 1;
+
+  for (u64 i = 0; i < size; i++)
+  {
+    ret.slots[i].sequence = i;
+  }
+
+  return ret;
+}
+
+template <typename T>
+inline void
+mpmc_ring_queue_signal_push(MpmcRingQueue<T>* queue, bool wake_all)
+{
+  // The signal has to be bumped before checking for waiters: a consumer registers itself as a waiter before comparing against the signal,
+  // so either we see it waiting or it sees the new signal value and doesn't go to sleep.
+  atomic_ref_fetch_add(&queue->push_signal, 1);
+  if (atomic_ref_load(&queue->waiters) == 0)
+  {
+    return;
+  }
+
+  if (wake_all)
+  {
+    wake_all_on_address(&queue->push_signal);
+  }
+  else
+  {
+    wake_one_on_address(&queue->push_signal);
+  }
+}
+
+template <typename T>
+DONT_IGNORE_RETURN inline bool
+try_mpmc_ring_queue_push(MpmcRingQueue<T>* queue, const T& data)
+{
+  using Slot = typename MpmcRingQueue<T>::Slot;
+
+  Slot* slot = nullptr;
+  u64   pos  = atomic_ref_load(&queue->enqueue_pos, std::memory_order_relaxed);
+  for (;;)
+  {
+    slot     = &queue->slots[pos & queue->mask];
+    u64 seq  = atomic_ref_load(&slot->sequence, std::memory_order_acquire);
+    s64 diff = (s64)seq - (s64)pos;
+    if (diff == 0)
+    {
+      if (atomic_ref_compare_exchange(&queue->enqueue_pos, &pos, pos + 1, std::memory_order_relaxed))
+      {
+        break;
+      }
+    }
+    else if (diff < 0)
+    {
+      // The consumer that had this slot a lap ago hasn't finished with it, we're full.
+      return false;
+    }
+    else
+    {
+      pos = atomic_ref_load(&queue->enqueue_pos, std::memory_order_relaxed);
+    }
+  }
+
+  slot->data = data;
+  atomic_ref_store(&slot->sequence, pos + 1, std::memory_order_release);
+
+  mpmc_ring_queue_signal_push(queue, false);
+  return true;
+}
+
+template <typename T>
+DONT_IGNORE_RETURN inline bool
+try_mpmc_ring_queue_pop(MpmcRingQueue<T>* queue, T* out = nullptr)
+{
+  using Slot = typename MpmcRingQueue<T>::Slot;
+
+  Slot* slot = nullptr;
+  u64   pos  = atomic_ref_load(&queue->dequeue_pos, std::memory_order_relaxed);
+  for (;;)
+  {
+    slot     = &queue->slots[pos & queue->mask];
+    u64 seq  = atomic_ref_load(&slot->sequence, std::memory_order_acquire);
+    s64 diff = (s64)seq - (s64)(pos + 1);
+    if (diff == 0)
+    {
+      if (atomic_ref_compare_exchange(&queue->dequeue_pos, &pos, pos + 1, std::memory_order_relaxed))
+      {
+        break;
+      }
+    }
+    else if (diff < 0)
+    {
+      // Nobody has published into this slot yet, we're empty.
+      return false;
+    }
+    else
+    {
+      pos = atomic_ref_load(&queue->dequeue_pos, std::memory_order_relaxed);
+    }
+  }
+
+  if (out != nullptr)
+  {
+    *out = slot->data;
+  }
+  atomic_ref_store(&slot->sequence, pos + queue->mask + 1, std::memory_order_release);
+
+  return true;
+}
+
+// Pushes as many of the count elements as there is room for in one go, returns the number pushed.
+// This only touches the enqueue position once, so it's a lot cheaper than pushing one at a time when there's contention.
+template <typename T>
+inline u64
+mpmc_ring_queue_push_batch(MpmcRingQueue<T>* queue, const T* src, u64 count)
+{
+  using Slot = typename MpmcRingQueue<T>::Slot;
+
+  u64 pos   = atomic_ref_load(&queue->enqueue_pos, std::memory_order_relaxed);
+  u64 claim = 0;
+  for (;;)
+  {
+    // Count how many slots in a row are ready for us. Consumers can finish out of order, so every slot needs checking.
+    claim = 0;
+    while (claim < count && claim <= queue->mask)
+    {
+      u64 seq = atomic_ref_load(&queue->slots[(pos + claim) & queue->mask].sequence, std::memory_order_acquire);
+      if (seq != pos + claim)
+      {
+        break;
+      }
+      claim++;
+    }
+
+    if (claim == 0)
+    {
+      u64 seq = atomic_ref_load(&queue->slots[pos & queue->mask].sequence, std::memory_order_acquire);
+      if ((s64)seq - (s64)pos < 0)
+      {
+        return 0;
+      }
+
+      // Another producer took this ticket, try again from wherever they left off.
+      pos = atomic_ref_load(&queue->enqueue_pos, std::memory_order_relaxed);
+      continue;
+    }
+
+    if (atomic_ref_compare_exchange(&queue->enqueue_pos, &pos, pos + claim, std::memory_order_relaxed))
+    {
+      break;
+    }
+  }
+
+  for (u64 i = 0; i < claim; i++)
+  {
+    Slot* slot = &queue->slots[(pos + i) & queue->mask];
+    slot->data = src[i];
+    atomic_ref_store(&slot->sequence, pos + i + 1, std::memory_order_release);
+  }
+
+  mpmc_ring_queue_signal_push(queue, true);
+  return claim;
+}
+
+// Pops up to count elements in one go, returns the number popped.
+template <typename T>
+inline u64
+mpmc_ring_queue_pop_batch(MpmcRingQueue<T>* queue, T* dst, u64 count)
+{
+  using Slot = typename MpmcRingQueue<T>::Slot;
+
+  u64 pos   = atomic_ref_load(&queue->dequeue_pos, std::memory_order_relaxed);
+  u64 claim = 0;
+  for (;;)
+  {
+    claim = 0;
+    while (claim < count && claim <= queue->mask)
+    {
+      u64 seq = atomic_ref_load(&queue->slots[(pos + claim) & queue->mask].sequence, std::memory_order_acquire);
+      if (seq != pos + claim + 1)
+      {
+        break;
+      }
+      claim++;
+    }
+
+    if (claim == 0)
+    {
+      u64 seq = atomic_ref_load(&queue->slots[pos & queue->mask].sequence, std::memory_order_acquire);
+      if ((s64)seq - (s64)(pos + 1) < 0)
+      {
+        return 0;
+      }
+
+      pos = atomic_ref_load(&queue->dequeue_pos, std::memory_order_relaxed);
+      continue;
+    }
+
+    if (atomic_ref_compare_exchange(&queue->dequeue_pos, &pos, pos + claim, std::memory_order_relaxed))
+    {
+      break;
+    }
+  }
+
+  for (u64 i = 0; i < claim; i++)
+  {
+    Slot* slot = &queue->slots[(pos + i) & queue->mask];
+    if (dst != nullptr)
+    {
+      dst[i] = slot->data;
+    }
+    atomic_ref_store(&slot->sequence, pos + i + queue->mask + 1, std::memory_order_release);
+  }
+
+  return claim;
+}
+
+// Pops if it can, otherwise sleeps until something gets pushed, the timeout elapses, or mpmc_ring_queue_wake_all gets called.
+// Returns whether it popped, the caller decides whether to go around again.
+template <typename T>
+inline bool
+mpmc_ring_queue_pop_or_sleep(MpmcRingQueue<T>* queue, T* out, u32 timeout_ms)
+{
+  // Spin a tiny bit first, sleeping in the kernel is way more expensive than a couple of pauses if a producer is about to push.
+  for (u32 ispin = 0; ispin < 64; ispin++)
+  {
+    if (try_mpmc_ring_queue_pop(queue, out))
+    {
+      return true;
+    }
+    _mm_pause();
+  }
+
+  u32 signal = atomic_ref_load(&queue->push_signal);
+  if (try_mpmc_ring_queue_pop(queue, out))
+  {
+    return true;
+  }
+
+  // wake_all sets woken before bumping the signal, so if the signal we read is from before the wake we either see woken here
+  // or the signal changes out from under the wait.
+  if (atomic_ref_load(&queue->woken))
+  {
+    return false;
+  }
+
+  atomic_ref_fetch_add(&queue->waiters, 1);
+  wait_on_address(&queue->push_signal, &signal, sizeof(signal), timeout_ms);
+  atomic_ref_fetch_sub(&queue->waiters, 1);
+
+  return false;
+}
+
+// Blocks until an element can be popped or the timeout elapses. Returns false on timeout or if mpmc_ring_queue_wake_all was called while the queue was empty.
+template <typename T>
+DONT_IGNORE_RETURN inline bool
+try_mpmc_ring_queue_pop_wait(MpmcRingQueue<T>* queue, T* out, u32 timeout_ms)
+{
+  if (mpmc_ring_queue_pop_or_sleep(queue, out, timeout_ms))
+  {
+    return true;
+  }
+
+  return try_mpmc_ring_queue_pop(queue, out);
+}
+
+// Blocks until an element can be popped and returns true, or returns false once mpmc_ring_queue_wake_all has been called and the queue is empty.
+// Spurious wake-ups (another consumer beat us to the element) just go back to sleep.
+template <typename T>
+DONT_IGNORE_RETURN inline bool
+mpmc_ring_queue_pop_wait(MpmcRingQueue<T>* queue, T* out)
+{
+  for (;;)
+  {
+    if (mpmc_ring_queue_pop_or_sleep(queue, out, U32_MAX))
+    {
+      return true;
+    }
+
+    if (atomic_ref_load(&queue->woken))
+    {
+      return try_mpmc_ring_queue_pop(queue, out);
+    }
+  }
+}
+
+// Wakes up every consumer blocked in the queue, whether or not there's anything to pop, and keeps consumers from blocking on it ever again:
+// the waiting pops return false whenever the queue is empty from here on. This is for shutting down the threads consuming the queue, and it's
+// sticky so that a consumer that was just about to block when this got called doesn't miss it.
+template <typename T>
+inline void
+mpmc_ring_queue_wake_all(MpmcRingQueue<T>* queue)
+{
+  atomic_ref_store(&queue->woken, 1U);
+  mpmc_ring_queue_signal_push(queue, true);
+}
+
+template <typename T>
+inline bool
+mpmc_ring_queue_is_empty(MpmcRingQueue<T>* queue)
+{
+  u64 pos = atomic_ref_load(&queue->dequeue_pos, std::memory_order_relaxed);
+  u64 seq = atomic_ref_load(&queue->slots[pos & queue->mask].sequence, std::memory_order_acquire);
+  return (s64)seq - (s64)(pos + 1) < 0;
+}
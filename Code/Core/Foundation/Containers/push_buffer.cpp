@@ -1,161 +1,134 @@
 #include "push_buffer.h"
 
-using Segment = PushBuffer::Segment;
+using Segment       = PushBuffer::Segment;
+using ElementHeader = PushBuffer::ElementHeader;
+using ReadCursor    = PushBuffer::ReadCursor;
+
+static constexpr u64 kElementAlignment = PushBuffer::kElementAlignment;
+static_assert((kElementAlignment & (kElementAlignment - 1)) == 0 && kElementAlignment >= alignof(ElementHeader), "Elements need to be aligned for their header.");
+
+static u64
+published_bits_size(u64 segment_size)
+{
+  return UCEIL_DIV(segment_size / kElementAlignment, 64) * sizeof(u64);
+}
 
 PushBuffer
 init_push_buffer(u64 segment_size, u64 commit_size, u64 reserve_size)
 {
   ASSERT_MSG_FATAL(commit_size > 0, "Cannot initialize PushBuffer with commit size 0. Needs at least one segment committed.");
+  segment_size                 = ALIGN_POW2(segment_size, kElementAlignment);
   commit_size                  = ALIGN_UP(commit_size,  segment_size);
   reserve_size                 = ALIGN_UP(reserve_size, segment_size);
   u64 commit_segment_count     = commit_size  / segment_size;
   u64 reserve_segment_count    = reserve_size / segment_size;
 
-  u64 meta_commit_size         = commit_segment_count  * sizeof(Segment);
-  u64 meta_reserve_size        = reserve_segment_count * sizeof(Segment);
+  u64 meta_commit_size         = commit_segment_count  * (sizeof(Segment) + published_bits_size(segment_size));
+  u64 meta_reserve_size        = reserve_segment_count * (sizeof(Segment) + published_bits_size(segment_size));
 
   PushBuffer ret;
-  ret.allocator                = init_stack_allocator(meta_commit_size + commit_size, meta_reserve_size + reserve_size);
+  ret.allocator                = init_stack_allocator(meta_commit_size + commit_size + kElementAlignment, meta_reserve_size + reserve_size + kElementAlignment);
 
   ret.segment_size             = segment_size;
   ret.commit_size              = commit_size;
-  ret.commit_segments_start    = (Segment*)push_stack(&ret.allocator, meta_commit_size, alignof(Segment));
-  ret.commit_segments_memory   = (uintptr_t)push_stack(&ret.allocator, commit_size, 1);
+  ret.commit_segments_start    = (Segment*)push_stack(&ret.allocator, commit_segment_count * sizeof(Segment), alignof(Segment));
+  u64* published_bits          = (u64*)push_stack(&ret.allocator, commit_segment_count * published_bits_size(segment_size), alignof(u64));
+  ret.commit_segments_memory   = (uintptr_t)push_stack(&ret.allocator, commit_size, kElementAlignment);
   ret.overflow_write_semaphore = 0;
+  zero_memory(published_bits, commit_segment_count * published_bits_size(segment_size));
 
   Segment* dst                 = ret.commit_segments_start;
-  ret.write_head               = dst;
-  ret.write_tail               = dst + commit_segment_count - 1;
-
   for (u32 isegment = 0; isegment < commit_segment_count; isegment++, dst++)
   {
+    *dst              = Segment();
     dst->base         = ret.commit_segments_memory + isegment * segment_size;
-    dst->write        = dst->base;
-    dst->read         = dst->base;
-    dst->next         = dst == ret.write_tail ? nullptr : (dst + 1);
     dst->segment_size = ret.segment_size;
+    dst->published    = published_bits + isegment * (published_bits_size(segment_size) / sizeof(u64));
+    dst->next_free    = isegment + 1 < commit_segment_count ? (dst + 1) : nullptr;
   }
 
+  // The first segment is handed out right away so producers and the consumer always have a segment to look at
+  ret.write_segment            = ret.commit_segments_start;
+  ret.free_segments            = ret.commit_segments_start->next_free;
+  ret.write_segment->next_free = nullptr;
+
+  ret.read_cursor              = ReadCursor();
+  ret.read_cursor.segment      = ret.write_segment;
 
   return ret;
 }
 
-// It is expected that the PushBuffer is locked here. This will push the segment into the read FIFO linked list.
-static void
-locked_push_buffer_flush_segment(PushBuffer* pb, Segment* segment)
+static bool
+is_overflow_pointer(const PushBuffer* pb, const void* ptr)
 {
-  segment->next  = nullptr;
-
-  if (pb->read_tail != nullptr)
-  {
-    ASSERT_MSG_FATAL(pb->read_tail->next == nullptr, "PushBuffer is in a bad state! read_tail->next is not nullptr! read_tail->next = 0x%llx", pb->read_tail->next);
-    pb->read_tail->next = segment;
-  }
-
-  if (pb->read_head == nullptr)
-  {
-    ASSERT_MSG_FATAL(pb->read_tail == nullptr, "PushBuffer is in a bad state! read_head is nullptr but read_tail is 0x%llx. Something went wrong internally.", pb->read_tail);
-    pb->read_head = pb->read_tail = segment;
-  }
-  else
-  {
-    pb->read_tail = segment;
-  }
+  return (uintptr_t)ptr - pb->commit_segments_memory >= pb->commit_size;
 }
 
-// It is expected that the PushBuffer is locked here. This will push the segment into the write FIFO linked list.
-static void
-locked_push_buffer_free_segment(PushBuffer* pb, Segment* segment)
+// Hands out a segment that can fit at least min_size bytes, either from the free list or by overflowing, with the first min_size bytes already reserved
+// for the caller. This is the only part of the write end that takes a lock.
+static Segment*
+push_buffer_acquire_segment(PushBuffer* pb, u64 min_size)
 {
-  segment->next  = nullptr;
-  segment->read  = segment->base;
-  segment->write = segment->base;
+  spin_acquire(&pb->segment_lock);
+  defer { spin_release(&pb->segment_lock); };
 
-  if (pb->allocator.commit_size > pb->allocator.initial_commit_size)
-  {
-    // TODO(bshihabi): We should handle decreasing the size of the push buffer once all of the relevant segments have been freed
-  }
-
-  if (pb->write_tail != nullptr)
-  {
-    ASSERT_MSG_FATAL(pb->write_tail->next == nullptr, "PushBuffer is in a bad state! write_tail->next is not nullptr! write_tail->next = 0x%llx", pb->write_tail->next);
-    pb->write_tail->next = segment;
-  }
-
-  if (pb->write_head == nullptr)
-  {
-    ASSERT_MSG_FATAL(pb->write_tail == nullptr, "PushBuffer is in a bad state! write_head is nullptr but write_tail is 0x%llx. Something went wrong internally.", pb->write_tail);
-    pb->write_head = pb->write_tail = segment;
-  }
-  else
+  Segment* ret = nullptr;
+  for (Segment** link = &pb->free_segments; *link != nullptr; link = &(*link)->next_free)
   {
-    pb->write_tail = segment;
+    if ((*link)->segment_size >= min_size)
+    {
+      ret   = *link;
+      *link = ret->next_free;
+      break;
+    }
   }
-}
-
-static void
-locked_push_buffer_free_head(PushBuffer* pb)
-{
-  Segment* free_segment = pb->read_head;
 
-  pb->read_head = pb->read_head->next;
-  if (pb->read_head == nullptr)
+  if (ret == nullptr)
   {
-    ASSERT_MSG_FATAL(pb->read_tail == free_segment, "PushBuffer is in a bad state! The read_head had no following node but the read_tail does not match the read_head.");
-    pb->read_tail = nullptr;
-  }
-
-  locked_push_buffer_free_segment(pb, free_segment);
-}
-
-u64
-locked_push_buffer_flush_head(PushBuffer* pb)
-{
-  // Load the segment that we want to flush
-  Segment* flush_segment = pb->write_head;
+    u64 size = MAX(min_size, pb->segment_size);
+    ASSERT_MSG(false, "Overflowed push buffer! Allocated %llu bytes. This incurs a memory allocation which could be slow. Consider bumping this push buffer.", size);
 
-  // Don't flush empty segment
-  if (flush_segment == nullptr)
-  {
-    return 0;
+    ret               = (Segment*)push_stack(&pb->allocator, sizeof(Segment), alignof(Segment));
+    *ret              = Segment();
+    ret->published    = (u64*)push_stack(&pb->allocator, published_bits_size(size), alignof(u64));
+    ret->base         = (uintptr_t)push_stack(&pb->allocator, size, kElementAlignment);
+    ret->segment_size = size;
+    zero_memory(ret->published, published_bits_size(size));
   }
-
-  u64      size          = (u64)(flush_segment->write - flush_segment->base);
-
-  // Don't flush an empty segment
-  if (size == 0)
+  else if (ret->sealed_size != PushBuffer::kSegmentNotSealed)
   {
-    return 0;
+    // Only the part of the segment that had elements in it can have published bits set
+    zero_memory(ret->published, UCEIL_DIV(ret->sealed_size / kElementAlignment, 64) * sizeof(u64));
   }
 
-  pb->write_head = pb->write_head->next;
-  if (pb->write_head == nullptr)
+  if (pb->allocator.commit_size > pb->allocator.initial_commit_size)
   {
-    ASSERT_MSG_FATAL(pb->write_tail == flush_segment, "PushBuffer is in a bad state! The write_head had no following node but the write_tail does not match the write_head.");
-    pb->write_tail = nullptr;
+    // TODO(bshihabi): We should handle decreasing the size of the push buffer once all of the relevant segments have been freed
   }
-  locked_push_buffer_flush_segment(pb, flush_segment);
 
-  return size;
-}
+  ret->sealed_size = PushBuffer::kSegmentNotSealed;
+  ret->next        = nullptr;
+  ret->next_free   = nullptr;
 
-u64
-push_buffer_flush(PushBuffer* pb)
-{
-  spin_acquire(&pb->lock);
-  defer { spin_release(&pb->lock); };
+  // Producers that loaded this segment back when it was the write segment can still be about to fetch-add on reserved. Everything else has to be reset
+  // before they can get an offset that fits, and the caller's space has to be claimed in the same store so that none of them can take it first.
+  atomic_ref_store(&ret->reserved, min_size, std::memory_order_release);
 
-  return locked_push_buffer_flush_head(pb);
+  return ret;
 }
 
 static void*
-alloc_from_segment(Segment* segment, u64 size)
+init_element(PushBuffer* pb, Segment* segment, u64 offset, u64 size)
 {
-  u64   available = segment->segment_size - (u64)(segment->write - segment->base);
-  ASSERT_MSG_FATAL(available >= size, "Not enough space in segment to allocate %llu bytes from! Only %llu bytes available. This is a bug in the PushBuffer and this should've been handled further up the call stack.", size, available);
+  ElementHeader* header = (ElementHeader*)(segment->base + offset);
+  header->size          = size;
+  header->segment       = segment;
 
-  void* ret       = (void*)segment->write;
-  segment->write += size;
+  void* ret = (void*)(header + 1);
+  if (is_overflow_pointer(pb, ret))
+  {
+    atomic_ref_fetch_add(&pb->overflow_write_semaphore, 1);
+  }
 
   return ret;
 }
@@ -163,204 +136,193 @@ alloc_from_segment(Segment* segment, u64 size)
 void*
 push_buffer_begin_edit(PushBuffer* pb, u64 size)
 {
-  spin_acquire(&pb->lock);
-  defer { spin_release(&pb->lock); };
+  u64 element_size = sizeof(ElementHeader) + ALIGN_POW2(size, kElementAlignment);
 
-  auto allocate_segment = [pb](u64 size) -> Segment*
+  for (;;)
   {
-    ASSERT_MSG(false, "Overflowed push buffer! Allocated %llu bytes. This incurs a memory allocation which could be slow. Consider bumping this push buffer.", size);
-    Segment* ret         = (Segment*)push_stack(&pb->allocator, sizeof(Segment), alignof(Segment));
-    ret->base            = (uintptr_t)push_stack(&pb->allocator, size, 1);
-    ret->write           = ret->base;
-    ret->read            = ret->base;
-    ret->next            = nullptr;
-    ret->segment_size    = size;
-    ret->write_semaphore = 0;
-
-    return ret;
-  };
-
-  // If we overflow the entire segment size, then we need to allocate a bespoke segment
-  if (size > pb->segment_size)
-  {
-    // This segment won't go into the regular queue because it's just specifically for this one fat allocation
-    Segment* bespoke_segment = allocate_segment(size);
+    Segment* segment = atomic_ref_load(&pb->write_segment);
+    u64      offset  = atomic_ref_fetch_add(&segment->reserved, element_size);
 
-    void* dst = alloc_from_segment(bespoke_segment, size);
-    locked_push_buffer_flush_segment(pb, bespoke_segment);
-
-    uintptr_t segment_offset = (uintptr_t)dst - pb->commit_segments_memory;
-    // Put a lock on writing until we're done writing from it
-    if (segment_offset >= pb->commit_size)
+    // Fast path, we got space in the current segment
+    if (offset + element_size <= segment->segment_size)
     {
-      pb->overflow_write_semaphore++;
-    }
-    else
-    {
-      bespoke_segment->write_semaphore++;
+      return init_element(pb, segment, offset, size);
     }
 
-    return dst;
-  }
-  else
-  {
-    Segment* segment = pb->write_head;
-
-    u64 remaining_space = segment ? (segment->segment_size - (u64)(segment->write - segment->base)) : 0;
-    if (size > remaining_space)
-    {
-      // Flush the latest segment
-      locked_push_buffer_flush_head(pb);
-    }
-
-    // Allocate a new segment if we need to
-    if (pb->write_head == nullptr)
+    // Reservations are handed out contiguously, so exactly one producer's reservation straddles the end of the segment. That producer is responsible for
+    // sealing the segment and linking in the next one. This is also how allocations bigger than the segment size get their own bespoke segment.
+    if (offset <= segment->segment_size)
     {
-      pb->write_head = pb->write_tail = allocate_segment(pb->segment_size);
-    }
+      // NOTE(bshihabi): We might have loaded the segment back when it was the write segment the last time around, and it just got handed out again
+      // but the producer that got it hasn't made it the write segment yet. Sealing it now would let that producer's store land after ours and leave
+      // everybody stuck on a sealed write segment. Only that producer can make it the write segment and only we can move it on again, so just wait.
+      while (atomic_ref_load(&pb->write_segment) != segment)
+      {
+        _mm_pause();
+      }
 
-    // The previous operations modifying the head mean we need to get the write head again
-    segment = pb->write_head;
+      // The front of the new segment is ours, so we're guaranteed to fit
+      Segment* next = push_buffer_acquire_segment(pb, element_size);
+      void*    ret  = init_element(pb, next, 0, size);
 
+      atomic_ref_store(&segment->sealed_size, offset, std::memory_order_release);
 
-    void* dst = alloc_from_segment(segment, size);
+      // The write segment has to move on before the segment is linked, otherwise the consumer could recycle the segment while it's still the write segment.
+      Segment* prev = atomic_ref_exchange(&pb->write_segment, next);
+      ASSERT_MSG_FATAL(prev == segment, "PushBuffer is in a bad state! The write segment moved on from 0x%llx without it being sealed.", segment);
+      atomic_ref_store(&segment->next, next, std::memory_order_release);
 
-    uintptr_t segment_offset = (uintptr_t)dst - pb->commit_segments_memory;
-    // Put a lock on writing until we're done writing from it
-    if (segment_offset >= pb->commit_size)
-    {
-      pb->overflow_write_semaphore++;
+      return ret;
     }
-    else
+
+    // Somebody else straddled the end and is busy linking in the next segment, wait for them and try again.
+    while (atomic_ref_load(&pb->write_segment) == segment)
     {
-      segment->write_semaphore++;
+      _mm_pause();
     }
-
-    return dst;
   }
 }
 
 void
 push_buffer_end_edit(PushBuffer* pb, void* ptr)
 {
-  spin_acquire(&pb->lock);
-  defer { spin_release(&pb->lock); };
-
-  bool      is_pointer_in_range = (uintptr_t)ptr >= pb->commit_segments_memory && (uintptr_t)ptr < pb->allocator.pos;
-  ASSERT_MSG_FATAL(is_pointer_in_range, "push_buffer_end_edit received pointer 0x%llx, but the memory range is only within 0x%llx - 0x%llx, are you passing the correct address? It should match with what push_buffer_begin_edit returns.", ptr, pb->commit_segments_memory, pb->allocator.pos);
-
-  if (!is_pointer_in_range)
-  {
-    return;
-  }
+  ASSERT_MSG_FATAL(ptr != nullptr && ((uintptr_t)ptr & (kElementAlignment - 1)) == 0, "push_buffer_end_edit received pointer 0x%llx, are you passing the correct address? It should match with what push_buffer_begin_edit returns.", ptr);
 
-  uintptr_t segment_offset = (uintptr_t)ptr - pb->commit_segments_memory;
-  // If it's not within the commit size, then it is in some overflow segment.
-  if (segment_offset >= pb->commit_size)
-  {
-    ASSERT_MSG_FATAL(pb->overflow_write_semaphore > 0, "During push_buffer_end_edit on pointer 0x%llx, overflow_write_semaphore expected to be > 0 but is 0 in PushBuffer. This indicates that there is a mismatch push_buffer_begin_edit and push_buffer_end_edit somewhere.", ptr);
-    if (pb->overflow_write_semaphore > 0)
-    {
-      pb->overflow_write_semaphore--;
-    }
-    return;
-  }
+  ElementHeader* header  = (ElementHeader*)ptr - 1;
+  Segment*       segment = header->segment;
+  u64            element = ((uintptr_t)header - segment->base) / kElementAlignment;
+  u64            bit     = 1ULL << (element % 64);
 
-  Segment* segment = pb->commit_segments_start + (u64)segment_offset / pb->segment_size;
+  // Publish before dropping the semaphore so that the consumer never sees the semaphore drop without the element being ready
+  u64 prev = atomic_ref_fetch_or(&segment->published[element / 64], bit, std::memory_order_release);
+  ASSERT_MSG_FATAL(!(prev & bit), "During push_buffer_end_edit on pointer 0x%llx, the element is already published. This indicates that there is a mismatch push_buffer_begin_edit and push_buffer_end_edit somewhere.", ptr);
 
-  ASSERT_MSG_FATAL(segment->write_semaphore > 0, "During push_buffer_end_edit on pointer 0x%llx, attempting to decrease write semaphore on segment 0x%llx but write_semaphore = 0. This means there's a mismatch in the push/pop for the segment which indicates that there is an extra push_buffer_end_edit on a pointer in the range 0x%llx - 0x%llx", ptr, segment, segment->base, segment->base + segment->segment_size);
-  if (segment->write_semaphore > 0)
+  if (is_overflow_pointer(pb, ptr))
   {
-    segment->write_semaphore--;
+    ASSERT_MSG_FATAL(atomic_ref_load(&pb->overflow_write_semaphore, std::memory_order_acquire) > 0, "During push_buffer_end_edit on pointer 0x%llx, overflow_write_semaphore expected to be > 0 but is 0 in PushBuffer. This indicates that there is a mismatch push_buffer_begin_edit and push_buffer_end_edit somewhere.", ptr);
+    atomic_ref_fetch_sub(&pb->overflow_write_semaphore, 1);
   }
 }
 
-bool
-try_push_buffer_pop(PushBuffer* pb, void* dst_base, u64 size)
+// Walks the cursor forward size bytes, copying into dst if there is one. Returns false if not enough bytes have been published yet, in which case
+// the cursor is left somewhere in the middle and should be thrown away.
+static bool
+advance_read_cursor(PushBuffer* pb, ReadCursor* cursor, u8* dst, u64 size)
 {
-  spin_acquire(&pb->lock);
-  defer { spin_release(&pb->lock); };
-
-  uintptr_t dst = (uintptr_t)dst_base;
-
-  u32  segments_to_free     = 0;
-  bool blocked_on_semaphore = false;
-  auto read_segments = [&]()
+  while (size > 0)
   {
-    for (Segment* isegment = pb->read_head; size > 0 && isegment != nullptr; isegment = isegment->next)
-    {
-      ASSERT_MSG_FATAL(isegment->read <= isegment->write, "PushBuffer is in a bad state! The read should never advance further than the write pointer for segment 0x%llx.", isegment);
+    Segment* segment = cursor->segment;
 
-      // This means that someone is actively writing into the segment. It's not ready to consume so we can't actually use it yet.
-      if (isegment->write_semaphore != 0)
+    // Starting a new element, look at its header
+    if (cursor->element_remaining == 0)
+    {
+      if (cursor->offset >= atomic_ref_load(&segment->sealed_size, std::memory_order_acquire))
       {
-        blocked_on_semaphore = true;
-        break;
+        // Sealed size is set before next, so it's possible to briefly see a sealed segment with no next yet
+        Segment* next = atomic_ref_load(&segment->next, std::memory_order_acquire);
+        if (next == nullptr)
+        {
+          return false;
+        }
+
+        cursor->segment = next;
+        cursor->offset  = 0;
+        continue;
       }
 
-      // This means that someone is actively writing into an overflow segment which could possibly be isegment since it is an overflow segment. This segment is possibly not ready to consume.
-      if (isegment->base > pb->commit_segments_memory + pb->commit_size && pb->overflow_write_semaphore > 0)
+      if (cursor->offset + sizeof(ElementHeader) > segment->segment_size)
       {
-        blocked_on_semaphore = true;
-        break;
+        // Exactly filled the segment, the next producer will seal it.
+        return false;
       }
 
-      u64 unread_bytes = (u64)(isegment->write - isegment->read);
-      u64 read_bytes   = MIN(unread_bytes, size);
-
-      // It is permitted to not specify any buffer to pop from, in which case we will just skip the memcpy
-      if (dst_base != nullptr)
+      bool is_overflow = is_overflow_pointer(pb, (void*)segment->base);
+      if (is_overflow && atomic_ref_load(&pb->overflow_write_semaphore, std::memory_order_acquire) > 0)
       {
-        memcpy((void*)dst, (const void*)isegment->read, read_bytes);
+        return false;
       }
 
-      size            -= read_bytes;
-      isegment->read  += read_bytes;
-
-      ASSERT_MSG_FATAL(isegment->read <= isegment->write, "PushBuffer is in a bad state! The read should never advance further than the write pointer for segment 0x%llx.", isegment);
-      if (isegment->read < isegment->write)
+      u64 element = cursor->offset / kElementAlignment;
+      if (!(atomic_ref_load(&segment->published[element / 64], std::memory_order_acquire) & (1ULL << (element % 64))))
       {
-        ASSERT_MSG_FATAL(size == 0, "There are still %llu bytes to read in segment 0x%llx, but size was not filled. This is a bug in the PushBuffer.", (u64)(isegment->write - isegment->read), isegment);
-      }
-      else
-      {
-        segments_to_free++;
+        // Either the element isn't done being written, or this is where the segment got sealed and the straddling element went to the next segment.
+        if (atomic_ref_load(&segment->sealed_size, std::memory_order_acquire) == cursor->offset)
+        {
+          continue;
+        }
+
+        return false;
       }
-    }
-  };
 
+      ElementHeader* header = (ElementHeader*)(segment->base + cursor->offset);
+      ASSERT_MSG_FATAL(header->segment == segment, "PushBuffer is in a bad state! Element header at 0x%llx points to segment 0x%llx but it lives in segment 0x%llx.", header, header->segment, segment);
 
-  // Not enough bytes have been flushed!
-  while (size > 0)
-  {
-    read_segments();
+      cursor->element_remaining = header->size;
+      cursor->element_padding   = ALIGN_POW2(header->size, kElementAlignment) - header->size;
+      cursor->offset           += sizeof(ElementHeader);
+      continue;
+    }
 
-    // If we're blocked on a semaphore, flushing more segments isn't going to do anything, so we should just return
-    if (blocked_on_semaphore)
+    u64 read_bytes = MIN(cursor->element_remaining, size);
+
+    // It is permitted to not specify any buffer to pop from, in which case we will just skip the memcpy
+    if (dst != nullptr)
     {
-      return false;
+      memcpy(dst, (const void*)(segment->base + cursor->offset), read_bytes);
+      dst += read_bytes;
     }
 
-    // Do a flush now and try again, just in case 
-
-    // NOTE(bshihabi): We flush here in the case that the consumer isn't flushing often enough. We don't do it earlier because then the consumer could be too eager and that would
-    // defeat the purpose of having segments in the first place. So we flush only once we know there is not enough contiguous data.
-    u64 bytes_flushed = locked_push_buffer_flush_head(pb);
+    size                      -= read_bytes;
+    cursor->offset            += read_bytes;
+    cursor->element_remaining -= read_bytes;
 
-    // If not enough bytes were flushed still, then we can bail completely. That makes the flush somewhat of a waste, but that is okay, it means we still need to feed the consumer anyway.
-    if (bytes_flushed < size)
+    if (cursor->element_remaining == 0)
     {
-      return false;
+      cursor->offset += cursor->element_padding;
     }
   }
 
-  while (segments_to_free > 0)
+  return true;
+}
+
+u64
+push_buffer_flush(PushBuffer* pb)
+{
+  UNREFERENCED_PARAMETER(pb);
+  return 0;
+}
+
+bool
+try_push_buffer_pop(PushBuffer* pb, void* dst, u64 size)
+{
+  spin_acquire(&pb->read_lock);
+  defer { spin_release(&pb->read_lock); };
+
+  // Walk a copy of the cursor so that nothing gets consumed if there aren't enough bytes published
+  ReadCursor cursor = pb->read_cursor;
+  if (!advance_read_cursor(pb, &cursor, (u8*)dst, size))
   {
-    // Keep freeing the head
-    locked_push_buffer_free_head(pb);
-    segments_to_free--;
+    return false;
   }
 
+  // Everything we walked past is fully consumed and can be handed out again
+  if (pb->read_cursor.segment != cursor.segment)
+  {
+    spin_acquire(&pb->segment_lock);
+    defer { spin_release(&pb->segment_lock); };
+
+    Segment* segment = pb->read_cursor.segment;
+    while (segment != cursor.segment)
+    {
+      Segment* next      = segment->next;
+      segment->next_free = pb->free_segments;
+      pb->free_segments  = segment;
+      segment            = next;
+    }
+  }
+
+  pb->read_cursor = cursor;
+
   return true;
 }
 
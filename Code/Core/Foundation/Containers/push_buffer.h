@@ -6,38 +6,82 @@
 // This is sorta like a ring buffer but it's specifically designed to handle overflows, batch submission, and work with multi-threading
 // This is best for command memory/scratch memory that is allowed to overflow and shouldn't block. It is intentionally designed similarly to how a driver or library would allocate
 // command buffers, as that pattern is pretty common.
+//
+// Producers never take a lock unless the segment they're writing into fills up: space is claimed with an atomic fetch-add on the segment's reserved offset,
+// and every element is published individually by push_buffer_end_edit. Full segments are sealed and linked into a FIFO by whichever producer's
+// reservation straddled the end of the segment. The read end is meant for a single consumer, it's guarded by its own lock so multiple consumers are
+// still correct but they'll serialize.
+//
+// Consumed segments go straight back into the free list. A producer can still be holding on to one of them from back when it was the write segment,
+// which is fine: its fetch-add either lands past the end of the sealed segment and it retries, or lands after the segment got handed out again, in
+// which case the space is legitimately its. If that reservation straddles the end it waits for the segment to be the write segment again before
+// sealing it, since the producer it got handed out to hasn't necessarily published it yet.
 struct PushBuffer
 {
-  
+  static constexpr u64 kSegmentNotSealed = U64_MAX;
+
   struct Segment
   {
-    uintptr_t base            = 0;
-    uintptr_t write           = 0;
-    uintptr_t read            = 0;
-    Segment*  next            = nullptr;
-    u64       segment_size    = 0;
-    u64       write_semaphore = 0;
+    uintptr_t base         = 0;
+    u64       segment_size = 0;
+
+    // Producers claim space by doing an atomic fetch-add on this, which means it can go past segment_size once the segment is full.
+    // Only ever reset by the single store that hands the segment out again, see push_buffer_acquire_segment.
+    u64       reserved     = 0;
+
+    // kSegmentNotSealed while producers can still reserve from the segment, afterwards the number of bytes that actually belong to elements.
+    u64       sealed_size  = kSegmentNotSealed;
+
+    // Next segment in the read FIFO, set once by the producer that sealed this segment.
+    Segment*  next         = nullptr;
+
+    // Link for the free/retired lists
+    Segment*  next_free    = nullptr;
+
+    // One bit per kElementAlignment bytes, set when the element starting there is published. This lives outside of the segment memory
+    // because stale payload bytes from a previous use of the segment could look like anything.
+    u64*      published    = nullptr;
+  };
+
+  // Every element is prefixed by one of these. Elements always start on a kElementAlignment boundary.
+  struct ElementHeader
+  {
+    u64      size    = 0;
+    Segment* segment = nullptr;
   };
+  static constexpr u64 kElementAlignment = sizeof(ElementHeader);
 
-  // Global lock because I haven't written anything to be more fine grained. I suspect that there might be contention wayyy down the line
-  // so it feels like it's possible to write this data structure to be lock-free which would be nice.
-  SpinLock        lock;
+  // Consumer position in the FIFO. Consumers can pop any number of bytes at a time, so this can be in the middle of an element.
+  struct ReadCursor
+  {
+    Segment* segment           = nullptr;
+    u64      offset            = 0;
+    u64      element_remaining = 0;
+    u64      element_padding   = 0;
+  };
+
+  // Only taken on the slow path when a segment fills up and we need to hand out a new one (or overflow).
+  SpinLock        segment_lock;
+
+  // Guards the read end so that multiple consumers don't trample each other.
+  SpinLock        read_lock;
 
   // Backing allocator for the push buffer (also supports overflows)
   StackAllocator  allocator;
 
-  // Size of individual segments that are batch flushed
+  // Size of individual segments
   u64             segment_size             = 0;
 
-  // FIFO queue feeding segments for the write end of the ring buffer
-  Segment*        write_head               = nullptr;
-  Segment*        write_tail               = nullptr;
+  // Segment that producers are currently reserving from
+  Segment*        write_segment            = nullptr;
+
+  // Consumer state
+  ReadCursor      read_cursor;
 
-  // FIFO queue feeding segments for the read end of the ring buffer
-  Segment*        read_head                = nullptr;
-  Segment*        read_tail                = nullptr;
+  // Segments ready to be handed out to producers, guarded by segment_lock
+  Segment*        free_segments            = nullptr;
 
-  // Pointers to segment metadata to find segment given pointer. Commit segments are pointers to segments that are always resident in memory
+  // Commit segments are the segments that are always resident in memory
   Segment*        commit_segments_start    = nullptr;
 
   // Pointer to the actual memory for committed segments
@@ -45,15 +89,16 @@ struct PushBuffer
   u64             commit_size              = 0;
 
   // When overflow segments are being written to, overflow_write_semaphore > 0 which means that you're not allowed to consume any segments that are marked as overflow.
-  // This is to work around the fact that there is no nice way for me to currently go from pointer -> overflow segment, so a global write semaphore is fastest.
+  // There is no nice way to go from pointer -> overflow segment, so a global write semaphore is fastest. Overflowing is the slow path anyway.
   u64             overflow_write_semaphore = 0;
 };
 
 
-// Internal segments get flushed automatically when they fill up. You can also manually initiate a flush which is a good idea. Reads will only happen from flushed segments 
+// Elements are visible to the consumer as soon as push_buffer_end_edit is called on them, and segments get recycled as soon as they're consumed, so there's
+// nothing left to flush. push_buffer_flush is kept around so that callers can still mark where they batch submission, it always returns 0.
 FOUNDATION_API                                PushBuffer init_push_buffer   (u64 segment_size, u64 commit_size, u64 reserve_size);
 FOUNDATION_API THREAD_SAFE                    u64        push_buffer_flush  (PushBuffer* pb);  // Returns the number of bytes that were flushed
-// Returns a pointer to contiguous buffer of size specified. This must be closed with the push_buffer_end_edit to ensure that the segment is allowed to flush.
+// Returns a pointer to contiguous buffer of size specified (aligned to PushBuffer::kElementAlignment). This must be closed with the push_buffer_end_edit before the consumer can read it.
 FOUNDATION_API THREAD_SAFE                    void*      push_buffer_begin_edit(PushBuffer* pb, u64 size);
 FOUNDATION_API THREAD_SAFE                    void       push_buffer_end_edit  (PushBuffer* pb, void* ptr);
 inline THREAD_SAFE void
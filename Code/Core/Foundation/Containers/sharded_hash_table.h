@@ -0,0 +1,117 @@
+#pragma once
+#include "Core/Foundation/memory.h"
+#include "Core/Foundation/threading.h"
+
+#include "Core/Foundation/Containers/hash_table.h"
+
+// Thread-safe hash table that splits keys across kNumShards independently locked HashTables, so threads
+// touching different keys (almost always) don't fight over the same lock or cache line.
+//
+// The shards are fixed size tables, so just like HashTable, pointers to values are stable until the key is erased.
+// For anything compound (find-or-insert, etc.) grab the shard for the key and use the regular hash table API on it:
+//
+//   ACQUIRE(sharded_hash_table_shard(&table, key), auto* shard)
+//   {
+//     V* value = hash_table_find(shard, key);
+//     ...
+//   };
+template <typename K, typename V, typename Traits = DefaultHashTraits<K>, u32 kNumShards = 16>
+struct ShardedHashTable
+{
+  static_assert(kNumShards > 0 && (kNumShards & (kNumShards - 1)) == 0, "Number of shards must be a power of 2.");
+  static constexpr u32 kShardBits = []() { u32 bits = 0; while ((1U << bits) < kNumShards) bits++; return bits; }();
+
+  // Each shard gets its own cache line(s) so that the locks don't false share
+  struct alignas(kCacheLineSize) Shard
+  {
+    SpinLocked<HashTable<K, V, Traits>> table;
+  };
+
+  Shard shards[kNumShards];
+};
+
+#define SHARDED_HASH_TABLE_TEMPLATE template <typename K, typename V, typename Traits, u32 kNumShards>
+#define SHARDED_HASH_TABLE_TYPE ShardedHashTable<K, V, Traits, kNumShards>
+
+template <typename K, typename V, typename Traits = DefaultHashTraits<K>, u32 kNumShards = 16>
+inline SHARDED_HASH_TABLE_TYPE
+init_sharded_hash_table(AllocHeap heap, u64 capacity)
+{
+  // Keys won't be perfectly evenly distributed across the shards, so give each one some headroom
+  // so that we can still actually fit `capacity` elements.
+  u64 shard_capacity = UCEIL_DIV(capacity, kNumShards);
+  shard_capacity     = shard_capacity + shard_capacity / 4 + 16;
+
+  SHARDED_HASH_TABLE_TYPE ret;
+  for (u32 i = 0; i < kNumShards; i++)
+  {
+    ret.shards[i].table = init_hash_table<K, V, Traits>(heap, shard_capacity);
+  }
+
+  return ret;
+}
+
+// The table inside the shard uses the low bits of the hash to pick a group, so pick the shard with the top bits.
+template <typename K, typename V, typename Traits, u32 kNumShards, typename Q>
+inline SpinLocked<HashTable<K, V, Traits>>*
+sharded_hash_table_shard(SHARDED_HASH_TABLE_TYPE* table, const Q& query)
+{
+  static constexpr u32 kShardBits = SHARDED_HASH_TABLE_TYPE::kShardBits;
+
+  if constexpr (kShardBits == 0)
+  {
+    return &table->shards[0].table;
+  }
+  else
+  {
+    u64 shard = Traits::hash(query) >> (64 - kShardBits);
+    return &table->shards[shard].table;
+  }
+}
+
+template <typename K, typename V, typename Traits, u32 kNumShards, typename Q>
+inline V*
+sharded_hash_table_find(SHARDED_HASH_TABLE_TYPE* table, const Q& query)
+{
+  return ACQUIRE(sharded_hash_table_shard(table, query), auto* shard)
+  {
+    return hash_table_find(shard, query);
+  };
+}
+
+template <typename K, typename V, typename Traits, u32 kNumShards>
+inline V*
+sharded_hash_table_insert(SHARDED_HASH_TABLE_TYPE* table, const K& key)
+{
+  return ACQUIRE(sharded_hash_table_shard(table, key), auto* shard)
+  {
+    return hash_table_insert(shard, key);
+  };
+}
+
+template <typename K, typename V, typename Traits, u32 kNumShards, typename Q>
+inline bool
+sharded_hash_table_erase(SHARDED_HASH_TABLE_TYPE* table, const Q& query)
+{
+  return ACQUIRE(sharded_hash_table_shard(table, query), auto* shard)
+  {
+    return hash_table_erase(shard, query);
+  };
+}
+
+// Not a snapshot, other threads can be inserting/erasing while this is counting.
+SHARDED_HASH_TABLE_TEMPLATE
+inline u64
+sharded_hash_table_size(SHARDED_HASH_TABLE_TYPE* table)
+{
+  u64 ret = 0;
+  for (u32 i = 0; i < kNumShards; i++)
+  {
+    ret += ACQUIRE(&table->shards[i].table, auto* shard) { return shard->used; };
+  }
+
+  return ret;
+}
+
+#undef SHARDED_HASH_TABLE_TEMPLATE
+#undef SHARDED_HASH_TABLE_TYPE
@@ -0,0 +1,177 @@
+#pragma once
+#include "Core/Foundation/memory.h"
+
+#include "Core/Foundation/Containers/array.h"
+
+// Pages are committed at least this many bytes at a time so that pushing one element at a time isn't a syscall every page
+static constexpr size_t kVirtualArrayMinCommitSize = KiB(64);
+
+// Growable array that reserves address space for its max capacity up front and only commits pages as it grows.
+//
+// Unlike a heap allocated array that reallocs, the elements never move. Pointers to elements stay valid for as
+// long as the element is in the array and growing never copies anything, it's just an mprotect/VirtualAlloc on
+// the next couple of pages. Reserving address space is basically free on x64, so it's fine to be very generous
+// with the max capacity.
+//
+// Not thread-safe, same as Array.
+template <typename T>
+struct VirtualArray
+{
+  T*     memory          = nullptr;
+  size_t size            = 0;
+  // How many elements fit in the pages that are committed right now
+  size_t commit_capacity = 0;
+  // How many elements fit in the reserved address space, the array can never grow past this
+  size_t capacity        = 0;
+
+  size_t commit_size     = 0;
+  size_t reserve_size    = 0;
+
+  const T& operator[](size_t index) const
+  {
+    ASSERT(memory != nullptr && index < size);
+    return memory[index];
+  }
+
+  T& operator[](size_t index)
+  {
+    ASSERT_MSG_FATAL(memory != nullptr, "VirtualArray has a nullptr memory, did you initialize it?");
+    ASSERT_MSG_FATAL(index < size, "VirtualArray access out of bounds. Attempting to access index %llu but array only has size of %llu", index, size);
+    return memory[index];
+  }
+
+  operator Span<T>()
+  {
+    return Span<T>(memory, size);
+  }
+
+  USE_ITERATOR(VirtualArray, T)
+};
+
+template <typename T>
+inline VirtualArray<T>
+init_virtual_array(size_t max_capacity, size_t initial_capacity = 0)
+{
+  ASSERT_MSG_FATAL(max_capacity > 0, "Cannot initialize VirtualArray with a max capacity of 0.");
+  ASSERT_MSG_FATAL(initial_capacity <= max_capacity, "VirtualArray initial capacity (%llu) cannot be larger than its max capacity (%llu).", initial_capacity, max_capacity);
+
+  VirtualArray<T> ret;
+  ret.reserve_size    = ALIGN_POW2(sizeof(T) * max_capacity, (size_t)kPageSize);
+  ret.memory          = (T*)reserve_pages(ret.reserve_size);
+  ASSERT_MSG_FATAL(ret.memory != nullptr, "Failed to reserve 0x%llx bytes for VirtualArray.", ret.reserve_size);
+
+  ret.capacity        = max_capacity;
+  ret.size            = 0;
+
+  if (initial_capacity > 0)
+  {
+    ret.commit_size   = ALIGN_POW2(sizeof(T) * initial_capacity, (size_t)kPageSize);
+    commit_pages(ret.commit_size, ret.memory);
+  }
+  ret.commit_capacity = MIN(ret.commit_size / sizeof(T), ret.capacity);
+
+  return ret;
+}
+
+template <typename T>
+inline void
+destroy_virtual_array(VirtualArray<T>* arr)
+{
+  free_pages(arr->memory);
+  zero_memory(arr, sizeof(VirtualArray<T>));
+}
+
+// Makes sure there are committed pages for at least capacity elements.
+template <typename T>
+inline void
+virtual_array_reserve(VirtualArray<T>* arr, size_t capacity)
+{
+  if (capacity <= arr->commit_capacity)
+  {
+    return;
+  }
+
+  ASSERT_MSG_FATAL(capacity <= arr->capacity, "VirtualArray is out of room! Attempted to grow to %llu elements but the max capacity is %llu.", capacity, arr->capacity);
+
+  // Grow the committed region geometrically, committing is a syscall
+  size_t new_commit_size = MAX(sizeof(T) * capacity, MAX(arr->commit_size * 2, kVirtualArrayMinCommitSize));
+  new_commit_size        = MIN(ALIGN_POW2(new_commit_size, (size_t)kPageSize), arr->reserve_size);
+
+  commit_pages(new_commit_size - arr->commit_size, (u8*)arr->memory + arr->commit_size);
+
+  arr->commit_size       = new_commit_size;
+  arr->commit_capacity   = MIN(arr->commit_size / sizeof(T), arr->capacity);
+}
+
+template <typename T>
+inline T*
+virtual_array_add(VirtualArray<T>* arr)
+{
+  if (arr->size == arr->commit_capacity)
+  {
+    virtual_array_reserve(arr, arr->size + 1);
+  }
+
+  T* ret = &arr->memory[arr->size++];
+  zero_memory(ret, sizeof(T));
+  return ret;
+}
+
+// Adds count zeroed elements and returns a pointer to the first one
+template <typename T>
+inline T*
+virtual_array_add(VirtualArray<T>* arr, size_t count)
+{
+  virtual_array_reserve(arr, arr->size + count);
+
+  T* ret     = &arr->memory[arr->size];
+  arr->size += count;
+  zero_memory(ret, sizeof(T) * count);
+  return ret;
+}
+
+template <typename T>
+inline void
+virtual_array_remove_last(VirtualArray<T>* arr)
+{
+  ASSERT(arr->memory != nullptr && arr->size > 0);
+
+  arr->size--;
+}
+
+// NOTE(bshihabi): This is an unordered remove, same as array_remove. It's the only way to remove from
+// the middle without moving every element after it, which would defeat the point of stable pointers anyways.
+template <typename T>
+inline void
+virtual_array_remove(VirtualArray<T>* arr, size_t index)
+{
+  ASSERT(arr->memory != nullptr && index < arr->size);
+
+  arr->size--;
+  arr->memory[index] = arr->memory[arr->size];
+}
+
+// Keeps the pages committed so that refilling the array is free. Use virtual_array_trim to give them back.
+template <typename T>
+inline void
+clear_virtual_array(VirtualArray<T>* arr)
+{
+  arr->size = 0;
+}
+
+// Decommits every page that isn't holding an element anymore.
+template <typename T>
+inline void
+virtual_array_trim(VirtualArray<T>* arr)
+{
+  size_t new_commit_size = ALIGN_POW2(sizeof(T) * arr->size, (size_t)kPageSize);
+  if (new_commit_size >= arr->commit_size)
+  {
+    return;
+  }
+
+  decommit_pages(arr->commit_size - new_commit_size, (u8*)arr->memory + new_commit_size);
+
+  arr->commit_size     = new_commit_size;
+  arr->commit_capacity = MIN(arr->commit_size / sizeof(T), arr->capacity);
+}
@@ -1,10 +1,14 @@
-#include "windows.h"
-#include "dbghelp.h"
-#pragma comment(lib, "DbgHelp.lib")
-
 #include "Core/Foundation/types.h"
 #include "Core/Foundation/assert.h"
 
+#if defined(_WIN32)
+#include "dbghelp.h"
+#pragma comment(lib, "DbgHelp.lib")
+#elif defined(__linux__)
+#include <execinfo.h>
+#include <unistd.h>
+#endif
+
 void
 print_backtrace(const char* fmt, ...)
 {
@@ -16,6 +20,7 @@ print_backtrace(const char* fmt, ...)
   static constexpr u32 kMaxStackCount = 128;
   void* stack[kMaxStackCount];
 
+#if defined(_WIN32)
   HANDLE process = GetCurrentProcess();
 
   SymSetOptions(SYMOPT_LOAD_LINES);
@@ -47,4 +52,13 @@ print_backtrace(const char* fmt, ...)
     dbgln("  [%u] %s (0x%0llX)\n    %s(%u)", frame_count - i - 1, symbol.info.Name, symbol.info.Address, symbol.line.FileName, symbol.line.LineNumber);
   }
   dbgln("=======================");
+#elif defined(__linux__)
+  // NOTE(bshihabi): Symbol names only show up for exported functions unless you link with -rdynamic,
+  // addr2line on the printed offsets gets you the rest.
+  s32 frame_count = backtrace(stack, kMaxStackCount);
+
+  dbgln("=======CALLSTACK=======");
+  backtrace_symbols_fd(stack + 1, frame_count - 1, STDERR_FILENO);
+  dbgln("=======================");
+#endif
 }
@@ -95,3 +95,93 @@ get_asset_type(const void* buffer, size_t size)
   return metadata->asset_type;
 }
 
+
+u64
+get_asset_header_size(AssetType asset_type)
+{
+  switch (asset_type)
+  {
+    case AssetType::kModel:    return sizeof(ModelAsset);
+    case AssetType::kTexture:  return sizeof(TextureAsset);
+    case AssetType::kShader:   return sizeof(ShaderAsset);
+    case AssetType::kMaterial: return sizeof(MaterialAsset);
+    default:                   return 0;
+  }
+}
+
+Result<AssetPack, FileError>
+open_asset_pack(const char* path)
+{
+  Result<FileStream, FileError> file = open_file(path, kFileStreamRead);
+  if (!file)
+  {
+    return Err(file.error());
+  }
+  defer { close_file(&file.value()); };
+
+  AssetPackHeader header;
+  if (!read_file(file.value(), &header, sizeof(header), 0))
+  {
+    return Err(kFileFailedToRead);
+  }
+
+  if (header.magic_number != kAssetPackMagicNumber || header.version != kAssetPackVersion)
+  {
+    dbgln("Asset pack %s has magic number 0x%x version %u, expected 0x%x version %u. Please rebuild the asset pack.", path, header.magic_number, header.version, kAssetPackMagicNumber, kAssetPackVersion);
+    return Err(kFileFailedToRead);
+  }
+
+  u64 toc_end = header.toc_offset + (u64)header.entry_count * sizeof(AssetPackEntry);
+  if (header.toc_offset < sizeof(header) || toc_end > header.payload_offset || toc_end > get_file_size(file.value()))
+  {
+    dbgln("Asset pack %s has a corrupted TOC.", path);
+    return Err(kFileFailedToRead);
+  }
+
+  Result<MappedFile, FileError> toc = map_file(file.value(), toc_end);
+  if (!toc)
+  {
+    return Err(toc.error());
+  }
+
+  AssetPack ret;
+  ret.toc         = toc.value();
+  ret.entries     = (const AssetPackEntry*)(ret.toc.data + header.toc_offset);
+  ret.entry_count = header.entry_count;
+
+  return Ok(ret);
+}
+
+void
+close_asset_pack(AssetPack* pack)
+{
+  unmap_file(&pack->toc);
+  pack->entries     = nullptr;
+  pack->entry_count = 0;
+}
+
+const AssetPackEntry*
+find_asset_pack_entry(const AssetPack& pack, AssetId asset_id)
+{
+  u32 lo = 0;
+  u32 hi = pack.entry_count;
+  while (lo < hi)
+  {
+    u32 mid = lo + (hi - lo) / 2;
+    if (pack.entries[mid].asset_id < asset_id)
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+
+  if (lo < pack.entry_count && pack.entries[lo].asset_id == asset_id)
+  {
+    return pack.entries + lo;
+  }
+
+  return nullptr;
+}
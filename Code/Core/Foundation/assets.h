@@ -3,6 +3,7 @@
 #include "Core/Foundation/math.h"
 #include "Core/Foundation/hash.h"
 #include "Core/Foundation/filesystem.h"
+#include "Core/Foundation/compression.h"
 #include "Core/Foundation/colors.h"
 
 #include "Core/Foundation/Containers/array.h"
@@ -33,8 +34,8 @@ using AssetRef = AssetId;
 
 static constexpr u32 kAssetMagicNumber = CRC32_STR("ATHENA_ASSET");
 
-static constexpr u32 kModelAssetVersion    = 6;
-static constexpr u32 kTextureAssetVersion  = 4;
+static constexpr u32 kModelAssetVersion    = 7;
+static constexpr u32 kTextureAssetVersion  = 6;
 static constexpr u32 kMaterialAssetVersion = 4;
 
 struct U8Color4
@@ -130,6 +131,9 @@ enum struct TextureCompression : u32
   kUncompressed,
 };
 
+// Enough for a full mip chain of a 32768x32768 texture
+static constexpr u32 kMaxTextureMips = 16;
+
 inline const char*
 texture_format_to_str(TextureFormat format)
 {
@@ -175,12 +179,18 @@ struct TextureAsset
   AssetMetadata      metadata;
   TextureCompression texture_compression;
   GpuFormat          gpu_format;
-  u8                 __pad0__[7];
+  // data is a compressed blob (see compression.h) of compressed_size bytes, uncompressed_size once decompressed
+  CompressionCodec   codec;
+  u8                 mip_count;
+  u8                 __pad0__[5];
   ColorSpaceName     color_space;
   u32                width;
   u32                height;
   u32                compressed_size;
   u32                uncompressed_size;
+  // Where each mip's copyable footprint is in the uncompressed data, and how many bytes it is. Mip 0 is width x height.
+  u32                mip_offsets[kMaxTextureMips];
+  u32                mip_sizes[kMaxTextureMips];
   OffsetPtr<u8>      data;
 };
 ASSERT_SERIALIZABLE(TextureAsset);
@@ -253,9 +263,66 @@ struct ModelAsset
   u32                    __pad0__;
 
   // Offset pointers for the entire model asset to stream directly to GPU memory
+  //
+  // The vertices and then the indices are stored as one compressed blob (see compression.h) of geometry_compressed_size
+  // bytes starting at vertices. These and the LODs' vertices/indices point to where everything ends up once that blob
+  // is decompressed in place.
   OffsetPtr<VertexAsset> vertices;
   OffsetPtr<u16>         indices;
   u64                    vertices_size;
   u64                    indices_size;
+  u64                    geometry_compressed_size;
 };
 ASSERT_SERIALIZABLE(ModelAsset);
+
+// Every built asset packed into one file, so loading an asset is a single read out of an already open file instead of
+// opening Assets/Built/0x%08x.built and reading its header and content separately. The file looks like:
+//
+//   AssetPackHeader | AssetPackEntry * entry_count (sorted by asset_id) | padding | payload | padding | payload ...
+//
+// The TOC is right after the header so that it can be mapped on its own. Every payload is a built asset file copied in
+// as is (header and then content, OffsetPtrs are still relative to the start of it), starting on a kAssetPackAlignment
+// boundary so it can be read with unbuffered/direct IO.
+static constexpr char kAssetPackPath[]       = "Assets/Built/assets.pack";
+
+static constexpr u32  kAssetPackMagicNumber  = CRC32_STR("ATHENA_ASSET_PACK");
+static constexpr u32  kAssetPackVersion      = 1;
+static constexpr u32  kAssetPackAlignment    = 4096;
+
+struct AssetPackHeader
+{
+  u32 magic_number;
+  u32 version;
+  u32 entry_count;
+  u32 alignment;
+  u64 toc_offset;
+  u64 payload_offset;
+};
+ASSERT_SERIALIZABLE(AssetPackHeader);
+
+struct AssetPackEntry
+{
+  AssetId   asset_id;
+  AssetType asset_type;
+  // Absolute offsets into the pack. The content always directly follows the header, which is what lets one read get both.
+  u64       header_offset;
+  u64       content_offset;
+  u64       header_size;
+  u64       content_size;
+};
+ASSERT_SERIALIZABLE(AssetPackEntry);
+
+struct AssetPack
+{
+  MappedFile            toc;
+  const AssetPackEntry* entries     = nullptr;
+  u32                   entry_count = 0;
+};
+
+// Size of the header struct at the start of a built asset of this type, 0 if it isn't one that can be packed
+FOUNDATION_API u64                   get_asset_header_size(AssetType asset_type);
+
+// Only maps the header and TOC, reads of the payloads go through whatever stream the caller opens on path.
+FOUNDATION_API Result<AssetPack, FileError> open_asset_pack(const char* path);
+FOUNDATION_API void                  close_asset_pack(AssetPack* pack);
+FOUNDATION_API const AssetPackEntry* find_asset_pack_entry(const AssetPack& pack, AssetId asset_id);
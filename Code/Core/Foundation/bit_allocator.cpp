@@ -1,62 +1,235 @@
 #include "Core/Foundation/bit_allocator.h"
 
+// Level 0 is the bits themselves, level 1 onwards are the summaries
+static u64*
+get_level(BitAllocator* allocator, u32 level)
+{
+  return level == 0 ? allocator->bits : allocator->summary[level - 1];
+}
+
+static u32
+get_level_bit_count(const BitAllocator* allocator, u32 level)
+{
+  u32 ret = allocator->capacity;
+  for (u32 i = 0; i < level; i++)
+  {
+    ret = UCEIL_DIV(ret, 64);
+  }
+
+  return ret;
+}
+
 BitAllocator
 init_bit_allocator(AllocHeap heap, u32 capacity)
 {
-  BitAllocator ret;
+  ASSERT_MSG_FATAL(capacity > 0, "Cannot initialize a BitAllocator with a capacity of 0.");
 
-  u32 qwords          = ALIGN_POW2(capacity, 64) / 64;
-  ret.bits            = HEAP_ALLOC(u64, heap, qwords);
-  zero_memory(ret.bits, qwords * sizeof(u64));
-  ret.capacity         = capacity;
+  BitAllocator ret;
+  ret.capacity        = capacity;
   ret.allocated_count = 0;
 
+  // Keep adding summary levels until the top one fits in a single qword
+  u32 level_bits = capacity;
+  for (u32 level = 0; ; level++)
+  {
+    u32  qwords = UCEIL_DIV(level_bits, 64);
+    u64* memory = HEAP_ALLOC(u64, heap, qwords);
+    zero_memory(memory, qwords * sizeof(u64));
+
+    // Anything past the end of the level is marked as allocated so that it never looks free
+    if (level_bits % 64 != 0)
+    {
+      memory[qwords - 1] = U64_MAX << (level_bits % 64);
+    }
+
+    if (level == 0)
+    {
+      ret.bits = memory;
+    }
+    else
+    {
+      ASSERT_MSG_FATAL(level <= kBitAllocatorMaxSummaryLevels, "BitAllocator capacity %u is too large! Maximum is 64^%u.", capacity, kBitAllocatorMaxSummaryLevels + 1);
+      ret.summary[level - 1] = memory;
+      ret.summary_levels     = level;
+    }
+
+    if (qwords == 1)
+    {
+      break;
+    }
+
+    level_bits = qwords;
+  }
+
   return ret;
 }
 
-Option<u32>
-bit_alloc(BitAllocator* allocator)
+// Sets a bit and marks it in the summary above if that filled the qword up
+static void
+set_bit(BitAllocator* allocator, u32 level, u32 idx)
 {
-  u32 max_qword = ALIGN_POW2(allocator->capacity, 64) / 64;
-  for (u32 i = 0; i < max_qword; i++)
+  for (; level <= allocator->summary_levels; level++)
   {
-    u64* qword = allocator->bits + i;
-    // Means completely allocated
-    if (*qword == U64_MAX)
+    u64* qword = get_level(allocator, level) + idx / 64;
+    *qword    |= 1ULL << (idx % 64);
+    if (*qword != U64_MAX)
     {
-      continue;
+      break;
     }
 
-    u32 idx = (u32)count_trailing_zeroes(~(*qword));
-    u64 bit = 1ULL << idx;
-    *qword |= bit;
+    idx /= 64;
+  }
+}
 
-    allocator->allocated_count++;
+// Clears a bit and if the qword used to be full, clear it in the summary above too
+static void
+clear_bit(BitAllocator* allocator, u32 level, u32 idx)
+{
+  for (; level <= allocator->summary_levels; level++)
+  {
+    u64* qword    = get_level(allocator, level) + idx / 64;
+    bool was_full = *qword == U64_MAX;
+    *qword       &= ~(1ULL << (idx % 64));
+    if (!was_full)
+    {
+      break;
+    }
 
-    return i * 64 + idx;
+    idx /= 64;
   }
+}
 
-  ASSERT_MSG_FATAL(false, "Bit allocator with max value of %u ran out of bits!", allocator->capacity);
-  return None;
+// Returns the first clear bit >= from at the given level. A clear bit in a summary means that the qword below it has a free bit,
+// so when this level runs out we find the next non-full qword one level up and take its first free bit.
+static Option<u32>
+find_next_clear_bit(BitAllocator* allocator, u32 level, u32 from)
+{
+  if (from >= get_level_bit_count(allocator, level))
+  {
+    return None;
+  }
+
+  u64* bits  = get_level(allocator, level);
+  u32  qword = from / 64;
+  u64  free  = ~bits[qword] & (U64_MAX << (from % 64));
+  if (free != 0)
+  {
+    return qword * 64 + (u32)count_trailing_zeroes(free);
+  }
+
+  if (level == allocator->summary_levels)
+  {
+    return None;
+  }
+
+  Option<u32> next_qword = find_next_clear_bit(allocator, level + 1, qword + 1);
+  if (!next_qword)
+  {
+    return None;
+  }
+
+  u32 ret = unwrap(next_qword);
+  return ret * 64 + (u32)count_trailing_zeroes(~bits[ret]);
+}
+
+// Returns the first set bit in [from, end) or end if there isn't one
+static u32
+find_next_set_bit(const BitAllocator* allocator, u32 from, u32 end)
+{
+  while (from < end)
+  {
+    u64 set = allocator->bits[from / 64] & (U64_MAX << (from % 64));
+    if (set != 0)
+    {
+      return MIN(end, (from & ~63U) + (u32)count_trailing_zeroes(set));
+    }
+
+    from = (from & ~63U) + 64;
+  }
+
+  return end;
+}
+
+Option<u32>
+bit_alloc(BitAllocator* allocator)
+{
+  // Walk down from the top summary, every level is just a tzcnt on the qword picked by the level above
+  u32 idx = 0;
+  for (s32 level = (s32)allocator->summary_levels; level >= 0; level--)
+  {
+    u64 qword = get_level(allocator, (u32)level)[idx];
+    if (qword == U64_MAX)
+    {
+      ASSERT_MSG_FATAL(false, "Bit allocator with max value of %u ran out of bits!", allocator->capacity);
+      return None;
+    }
+
+    idx = idx * 64 + (u32)count_trailing_zeroes(~qword);
+  }
+
+  set_bit(allocator, 0, idx);
+  allocator->allocated_count++;
+
+  return idx;
 }
 
 bool
 bit_is_allocated(const BitAllocator& allocator, u32 idx)
 {
+  ASSERT_MSG_FATAL(idx < allocator.capacity, "Bit %u is out of range of bit allocator with capacity %u.", idx, allocator.capacity);
+
   u64* qword = allocator.bits + (idx / 64);
-  u64  bit   = 1ULL << idx;
+  u64  bit   = 1ULL << (idx % 64);
   return (*qword) & bit;
 }
 
 void
 bit_free(BitAllocator* allocator, u32 idx)
 {
-  u64* qword = allocator->bits + (idx / 64);
-  u32  bit   = 1ULL << idx;
-  ASSERT_MSG_FATAL(((*qword) & bit), "Freed bit %u was not allocated! Double bit_free detected", idx);
+  ASSERT_MSG_FATAL(idx < allocator->capacity, "Freed bit %u is out of range of bit allocator with capacity %u.", idx, allocator->capacity);
+  ASSERT_MSG_FATAL(bit_is_allocated(*allocator, idx), "Freed bit %u was not allocated! Double bit_free detected", idx);
 
   ASSERT_MSG_FATAL(allocator->allocated_count > 0, "For some reason, bit allocator says there are no bits allocated, but there is a bit set implying some sort of mismatch, something went wrong internally...");
   allocator->allocated_count--;
 
-  *qword &= bit;
+  clear_bit(allocator, 0, idx);
+}
+
+Option<u32>
+bit_alloc_range(BitAllocator* allocator, u32 count)
+{
+  ASSERT_MSG_FATAL(count > 0, "Cannot allocate a range of 0 bits.");
+
+  Option<u32> start = find_next_clear_bit(allocator, 0, 0);
+  while (start && unwrap(start) + count <= allocator->capacity)
+  {
+    u32 begin = unwrap(start);
+    u32 end   = find_next_set_bit(allocator, begin, begin + count);
+    if (end == begin + count)
+    {
+      for (u32 idx = begin; idx < end; idx++)
+      {
+        set_bit(allocator, 0, idx);
+      }
+      allocator->allocated_count += count;
+
+      return begin;
+    }
+
+    // Not enough room before the next allocated bit, skip past it
+    start = find_next_clear_bit(allocator, 0, end + 1);
+  }
+
+  return None;
+}
+
+void
+bit_free_range(BitAllocator* allocator, u32 idx, u32 count)
+{
+  ASSERT_MSG_FATAL(idx + count <= allocator->capacity, "Freed range %u - %u is out of range of bit allocator with capacity %u.", idx, idx + count, allocator->capacity);
+
+  for (u32 i = idx; i < idx + count; i++)
+  {
+    bit_free(allocator, i);
+  }
 }
@@ -2,9 +2,19 @@
 #include "Core/Foundation/memory.h"
 #include "Core/Foundation/Containers/option.h"
 
+// Every summary level has one bit per qword in the level below, so 3 summary levels cover 64^4 bits.
+static constexpr u32 kBitAllocatorMaxSummaryLevels = 3;
+
 struct BitAllocator
 {
+  // One bit per id, set when the id is allocated
   u64* bits            = nullptr;
+
+  // summary[0] has a bit set for every full qword in bits, summary[1] has a bit set for every full qword in summary[0], and so on.
+  // The top level always fits in a single qword so finding a free bit is just a tzcnt per level.
+  u64* summary[kBitAllocatorMaxSummaryLevels] = {};
+  u32  summary_levels  = 0;
+
   u32  capacity        = 0;
   u32  allocated_count = 0;
 };
@@ -14,3 +24,6 @@ FOUNDATION_API Option<u32> bit_alloc(BitAllocator* allocator);
 FOUNDATION_API bool bit_is_allocated(const BitAllocator& allocator, u32 idx);
 FOUNDATION_API void bit_free(BitAllocator* allocator, u32 idx);
 
+// Allocates count contiguous bits and returns the first one. Unlike bit_alloc this can fail because of fragmentation, so it returns None instead of asserting.
+FOUNDATION_API Option<u32> bit_alloc_range(BitAllocator* allocator, u32 count);
+FOUNDATION_API void bit_free_range(BitAllocator* allocator, u32 idx, u32 count);
@@ -0,0 +1,574 @@
+#include "Core/Foundation/compression.h"
+#include "Core/Foundation/context.h"
+
+// LZ4 block format limits. The last 5 bytes of a block are always literals, and the last match has to start at least
+// 12 bytes before the end of the block. Decoders (ours included) rely on both to copy in 8 byte pieces.
+static constexpr u32 kLz4MinMatch          = 4;
+static constexpr u32 kLz4LastLiterals      = 5;
+static constexpr u32 kLz4MatchFindLimit    = 12;
+static constexpr u32 kLz4MaxOffset         = 0xFFFF;
+
+static constexpr u32 kLz4FastHashBits      = 12;
+static constexpr u32 kLz4HighHashBits      = 15;
+// How many positions kCompressionLevelHigh looks at per hash chain before taking the longest match it found
+static constexpr u32 kLz4HighSearchDepth   = 64;
+// Every 2^kLz4SkipStrength positions in a row without a match, the fast compressor skips ahead one more byte
+static constexpr u32 kLz4SkipStrength      = 6;
+
+static_assert(kCompressionChunkSize - 1 <= kLz4MaxOffset, "Every position in a chunk needs to be reachable with a 16-bit offset.");
+
+static u32
+read_u32(const u8* src)
+{
+  u32 ret;
+  memcpy(&ret, src, sizeof(ret));
+  return ret;
+}
+
+static u64
+read_u64(const u8* src)
+{
+  u64 ret;
+  memcpy(&ret, src, sizeof(ret));
+  return ret;
+}
+
+static u32
+lz4_hash(u32 sequence, u32 hash_bits)
+{
+  return (sequence * 2654435761U) >> (32 - hash_bits);
+}
+
+// How many bytes past src and ref are the same, not going past src_limit
+static u32
+lz4_count_matching(const u8* src, const u8* ref, const u8* src_limit)
+{
+  const u8* start = src;
+  while (src + sizeof(u64) <= src_limit)
+  {
+    u64 diff = read_u64(src) ^ read_u64(ref);
+    if (diff != 0)
+    {
+      return (u32)(src - start) + (u32)(count_trailing_zeroes(diff) / 8);
+    }
+
+    src += sizeof(u64);
+    ref += sizeof(u64);
+  }
+
+  while (src < src_limit && *src == *ref)
+  {
+    src++;
+    ref++;
+  }
+
+  return (u32)(src - start);
+}
+
+struct Lz4Writer
+{
+  u8* dst     = nullptr;
+  u8* dst_end = nullptr;
+};
+
+static bool
+lz4_write_length(Lz4Writer* writer, u32 length)
+{
+  while (length >= 0xFF)
+  {
+    if (writer->dst >= writer->dst_end)
+    {
+      return false;
+    }
+
+    *writer->dst++ = 0xFF;
+    length        -= 0xFF;
+  }
+
+  if (writer->dst >= writer->dst_end)
+  {
+    return false;
+  }
+
+  *writer->dst++ = (u8)length;
+  return true;
+}
+
+// A match_length of 0 is the last sequence of the block, which is only literals
+static bool
+lz4_write_sequence(Lz4Writer* writer, const u8* literals, u32 literal_count, u32 offset, u32 match_length)
+{
+  if (writer->dst >= writer->dst_end)
+  {
+    return false;
+  }
+
+  u32 match_code = match_length != 0 ? match_length - kLz4MinMatch : 0;
+
+  u8* token      = writer->dst++;
+  *token         = (u8)((MIN(literal_count, 15U) << 4) | MIN(match_code, 15U));
+
+  if (literal_count >= 15 && !lz4_write_length(writer, literal_count - 15))
+  {
+    return false;
+  }
+
+  if ((u64)(writer->dst_end - writer->dst) < literal_count)
+  {
+    return false;
+  }
+
+  memcpy(writer->dst, literals, literal_count);
+  writer->dst += literal_count;
+
+  if (match_length == 0)
+  {
+    return true;
+  }
+
+  if (writer->dst_end - writer->dst < 2)
+  {
+    return false;
+  }
+
+  *writer->dst++ = (u8)(offset >> 0);
+  *writer->dst++ = (u8)(offset >> 8);
+
+  if (match_code >= 15 && !lz4_write_length(writer, match_code - 15))
+  {
+    return false;
+  }
+
+  return true;
+}
+
+// Returns 0 if the block doesn't fit in dst_capacity, the chunk is better off stored as is then anyways.
+static u32
+lz4_compress_block(u8* dst, u32 dst_capacity, const u8* src, u32 size, CompressionLevel level, u16* hash_table, u16* chain)
+{
+  Lz4Writer writer = {dst, dst + dst_capacity};
+
+  const u8* anchor = src;
+  if (size >= kLz4MatchFindLimit + 1)
+  {
+    const u8* src_end     = src + size;
+    const u8* match_limit = src_end - kLz4LastLiterals;
+    const u8* find_limit  = src_end - kLz4MatchFindLimit;
+
+    u32 hash_bits         = level == kCompressionLevelHigh ? kLz4HighHashBits : kLz4FastHashBits;
+    // Every table entry starts out at position 0, which is just a bad guess for a match instead of a broken one since
+    // candidates get checked anyways.
+    memset(hash_table, 0, sizeof(u16) << hash_bits);
+
+    // Next position that still needs to go into the hash chains
+    const u8* next_insert = src;
+    u32       miss_count  = 0;
+
+    const u8* cur         = src + 1;
+    while (cur <= find_limit)
+    {
+      u32       sequence   = read_u32(cur);
+      const u8* best_match = nullptr;
+      u32       best_len   = 0;
+
+      if (level == kCompressionLevelHigh)
+      {
+        for (; next_insert < cur; next_insert++)
+        {
+          u32 pos          = (u32)(next_insert - src);
+          u32 hash         = lz4_hash(read_u32(next_insert), kLz4HighHashBits);
+          chain[pos]       = (u16)(pos - hash_table[hash]);
+          hash_table[hash] = (u16)pos;
+        }
+
+        u32 pos       = (u32)(cur - src);
+        u32 candidate = hash_table[lz4_hash(sequence, kLz4HighHashBits)];
+        for (u32 idepth = 0; idepth < kLz4HighSearchDepth && candidate < pos; idepth++)
+        {
+          const u8* ref = src + candidate;
+          if (read_u32(ref) == sequence)
+          {
+            u32 len = kLz4MinMatch + lz4_count_matching(cur + kLz4MinMatch, ref + kLz4MinMatch, match_limit);
+            if (len > best_len)
+            {
+              best_len   = len;
+              best_match = ref;
+            }
+          }
+
+          u16 delta = chain[candidate];
+          if (delta == 0 || delta > candidate)
+          {
+            break;
+          }
+          candidate -= delta;
+        }
+      }
+      else
+      {
+        u32       hash     = lz4_hash(sequence, kLz4FastHashBits);
+        const u8* ref      = src + hash_table[hash];
+        hash_table[hash]   = (u16)(cur - src);
+
+        if (ref < cur && read_u32(ref) == sequence)
+        {
+          best_len   = kLz4MinMatch + lz4_count_matching(cur + kLz4MinMatch, ref + kLz4MinMatch, match_limit);
+          best_match = ref;
+        }
+      }
+
+      if (best_match == nullptr)
+      {
+        cur += 1 + (miss_count++ >> kLz4SkipStrength);
+        continue;
+      }
+
+      // Whatever matched before the hash hit is free ratio
+      while (cur > anchor && best_match > src && cur[-1] == best_match[-1])
+      {
+        cur--;
+        best_match--;
+        best_len++;
+      }
+
+      if (!lz4_write_sequence(&writer, anchor, (u32)(cur - anchor), (u32)(cur - best_match), best_len))
+      {
+        return 0;
+      }
+
+      cur       += best_len;
+      anchor     = cur;
+      miss_count = 0;
+
+      // Positions inside of the match are good candidates for what comes after it
+      if (level != kCompressionLevelHigh && cur <= find_limit)
+      {
+        hash_table[lz4_hash(read_u32(cur - 2), kLz4FastHashBits)] = (u16)(cur - 2 - src);
+      }
+    }
+  }
+
+  if (!lz4_write_sequence(&writer, anchor, (u32)(src + size - anchor), 0, 0))
+  {
+    return 0;
+  }
+
+  return (u32)(writer.dst - dst);
+}
+
+static bool
+lz4_read_length(const u8** src, const u8* src_end, u32* length)
+{
+  u8 byte;
+  do
+  {
+    if (*src >= src_end)
+    {
+      return false;
+    }
+
+    byte     = *(*src)++;
+    *length += byte;
+  } while (byte == 0xFF && *length < kCompressionChunkSize);
+
+  return true;
+}
+
+// Never reads or writes out of bounds no matter what src is, corrupted data just returns false.
+static bool
+lz4_decompress_block(u8* dst, u32 dst_size, const u8* src, u32 src_size)
+{
+  const u8* src_end = src + src_size;
+  u8*       out     = dst;
+  u8*       out_end = dst + dst_size;
+
+  while (true)
+  {
+    if (src >= src_end)
+    {
+      return false;
+    }
+
+    u8  token         = *src++;
+    u32 literal_count = token >> 4;
+    if (literal_count == 15 && !lz4_read_length(&src, src_end, &literal_count))
+    {
+      return false;
+    }
+
+    // Most literal runs are short, copying a fixed 16 bytes is a lot faster than a memcpy of the exact size. Whatever
+    // gets copied past the literals is overwritten by the rest of the block.
+    if (literal_count < 16 && src_end - src >= 16 && out_end - out >= 16)
+    {
+      memcpy(out, src, 16);
+    }
+    else if ((u64)(src_end - src) >= literal_count && (u64)(out_end - out) >= literal_count)
+    {
+      memcpy(out, src, literal_count);
+    }
+    else
+    {
+      return false;
+    }
+    src += literal_count;
+    out += literal_count;
+
+    // The last sequence is only literals
+    if (src == src_end)
+    {
+      return out == out_end;
+    }
+
+    if (src_end - src < 2)
+    {
+      return false;
+    }
+
+    u32 offset = (u32)src[0] | ((u32)src[1] << 8);
+    src       += 2;
+    if (offset == 0 || offset > (u64)(out - dst))
+    {
+      return false;
+    }
+
+    u32 match_length = token & 0xF;
+    if (match_length == 15 && !lz4_read_length(&src, src_end, &match_length))
+    {
+      return false;
+    }
+    match_length += kLz4MinMatch;
+
+    if ((u64)(out_end - out) < match_length)
+    {
+      return false;
+    }
+
+    const u8* match     = out - offset;
+    u8*       match_end = out + match_length;
+    if ((u64)(out_end - out) < match_length + sizeof(u64))
+    {
+      // Too close to the end to copy in 8 byte pieces
+      while (out < match_end)
+      {
+        *out++ = *match++;
+      }
+      continue;
+    }
+
+    if (offset < sizeof(u64))
+    {
+      // The match overlaps what it's copying (a repeating pattern). Once the first few repeats are written out byte by
+      // byte, a multiple of offset that's at least 8 back has the same bytes and can be copied from 8 at a time.
+      u32 period = offset;
+      while (period < sizeof(u64))
+      {
+        period += offset;
+      }
+
+      u8* pattern_end = out + MIN(period, match_length);
+      while (out < pattern_end)
+      {
+        *out++ = *match++;
+      }
+      match = out - period;
+    }
+
+    // Copying 8 bytes at a time can write up to 7 bytes past the match, there's room for that and the rest of the block
+    // overwrites them.
+    while (out < match_end)
+    {
+      memcpy(out, match, sizeof(u64));
+      out   += sizeof(u64);
+      match += sizeof(u64);
+    }
+    out = match_end;
+  }
+}
+
+static const CompressedBlobHeader*
+get_blob_header(const void* blob)
+{
+  return (const CompressedBlobHeader*)blob;
+}
+
+static const u32*
+get_blob_chunk_ends(const void* blob)
+{
+  return (const u32*)((const u8*)blob + sizeof(CompressedBlobHeader));
+}
+
+static const u8*
+get_blob_chunk_data(const void* blob)
+{
+  return (const u8*)(get_blob_chunk_ends(blob) + get_blob_header(blob)->chunk_count);
+}
+
+const char*
+compression_codec_to_str(CompressionCodec codec)
+{
+  switch (codec)
+  {
+    case kCompressionCodecNone: return "None";
+    case kCompressionCodecLz4:  return "LZ4";
+    default:                    return "Unknown";
+  }
+}
+
+u64
+get_compressed_blob_bound(u64 size)
+{
+  // Chunks that don't compress get stored as is, so nothing is ever bigger than the header + chunk table
+  return sizeof(CompressedBlobHeader) + sizeof(u32) * UCEIL_DIV(size, (u64)kCompressionChunkSize) + size;
+}
+
+u64
+compress_blob(void* dst, const void* src, u64 size, CompressionCodec codec, CompressionLevel level)
+{
+  ASSERT_MSG_FATAL(codec < kCompressionCodecCount, "Invalid compression codec %u.", codec);
+
+  u32 chunk_count = (u32)UCEIL_DIV(size, (u64)kCompressionChunkSize);
+
+  auto* header              = (CompressedBlobHeader*)dst;
+  zero_memory(header, sizeof(CompressedBlobHeader));
+  header->magic_number      = kCompressedBlobMagicNumber;
+  header->codec             = codec;
+  header->chunk_count       = chunk_count;
+  header->uncompressed_size = size;
+
+  u32* chunk_ends = (u32*)get_blob_chunk_ends(dst);
+  u8*  chunk_data = (u8*)get_blob_chunk_data(dst);
+
+  ScratchAllocator scratch_arena = alloc_scratch_arena();
+  defer { free_scratch_arena(&scratch_arena); };
+
+  u16* hash_table = nullptr;
+  u16* chain      = nullptr;
+  if (codec == kCompressionCodecLz4)
+  {
+    hash_table = HEAP_ALLOC(u16, scratch_arena, 1U << MAX(kLz4FastHashBits, kLz4HighHashBits));
+    chain      = level == kCompressionLevelHigh ? HEAP_ALLOC(u16, scratch_arena, kCompressionChunkSize) : nullptr;
+  }
+
+  u64 chunk_end = 0;
+  for (u32 ichunk = 0; ichunk < chunk_count; ichunk++)
+  {
+    const u8* chunk_src  = (const u8*)src + (u64)ichunk * kCompressionChunkSize;
+    u32       chunk_size = (u32)MIN(size - (u64)ichunk * kCompressionChunkSize, (u64)kCompressionChunkSize);
+    u8*       chunk_dst  = chunk_data + chunk_end;
+
+    // Has to come out strictly smaller than the chunk, otherwise it would look like a stored chunk
+    u32 compressed_size = 0;
+    if (codec == kCompressionCodecLz4)
+    {
+      compressed_size = lz4_compress_block(chunk_dst, chunk_size - 1, chunk_src, chunk_size, level, hash_table, chain);
+    }
+
+    if (compressed_size == 0)
+    {
+      memcpy(chunk_dst, chunk_src, chunk_size);
+      compressed_size = chunk_size;
+    }
+
+    chunk_end += compressed_size;
+    ASSERT_MSG_FATAL(chunk_end <= U32_MAX, "Compressed blobs need to be smaller than 4 GiB, got one that's at least %llu bytes.", chunk_end);
+    chunk_ends[ichunk] = (u32)chunk_end;
+  }
+
+  return (u64)(chunk_data - (u8*)dst) + chunk_end;
+}
+
+bool
+validate_compressed_blob(const void* blob, u64 blob_size, u64 uncompressed_size)
+{
+  if (blob_size < sizeof(CompressedBlobHeader))
+  {
+    return false;
+  }
+
+  const CompressedBlobHeader* header = get_blob_header(blob);
+  if (header->magic_number      != kCompressedBlobMagicNumber ||
+      header->codec             >= kCompressionCodecCount     ||
+      header->uncompressed_size != uncompressed_size          ||
+      header->chunk_count       != UCEIL_DIV(uncompressed_size, (u64)kCompressionChunkSize))
+  {
+    return false;
+  }
+
+  u64 table_size = sizeof(CompressedBlobHeader) + sizeof(u32) * (u64)header->chunk_count;
+  if (table_size > blob_size)
+  {
+    return false;
+  }
+
+  const u32* chunk_ends  = get_blob_chunk_ends(blob);
+  u64        chunk_start = 0;
+  for (u32 ichunk = 0; ichunk < header->chunk_count; ichunk++)
+  {
+    u64 compressed_size = (u64)chunk_ends[ichunk] - chunk_start;
+    u64 chunk_size      = get_compressed_blob_chunk_size(blob, ichunk);
+    bool valid_chunk    = chunk_ends[ichunk] > chunk_start &&
+                          compressed_size   <= chunk_size  &&
+                          (header->codec != kCompressionCodecNone || compressed_size == chunk_size);
+    if (!valid_chunk)
+    {
+      return false;
+    }
+
+    chunk_start = chunk_ends[ichunk];
+  }
+
+  return table_size + chunk_start <= blob_size;
+}
+
+u32
+get_compressed_blob_chunk_count(const void* blob)
+{
+  return get_blob_header(blob)->chunk_count;
+}
+
+u32
+get_compressed_blob_chunk_size(const void* blob, u32 ichunk)
+{
+  u64 chunk_start = (u64)ichunk * kCompressionChunkSize;
+  return (u32)MIN(get_blob_header(blob)->uncompressed_size - chunk_start, (u64)kCompressionChunkSize);
+}
+
+bool
+decompress_blob_chunk(const void* blob, u32 ichunk, void* dst)
+{
+  const CompressedBlobHeader* header = get_blob_header(blob);
+  ASSERT_MSG_FATAL(ichunk < header->chunk_count, "Chunk %u is out of bounds, the blob only has %u chunks.", ichunk, header->chunk_count);
+
+  const u32* chunk_ends      = get_blob_chunk_ends(blob);
+  u32        chunk_start     = ichunk > 0 ? chunk_ends[ichunk - 1] : 0;
+  u32        compressed_size = chunk_ends[ichunk] - chunk_start;
+  u32        chunk_size      = get_compressed_blob_chunk_size(blob, ichunk);
+  const u8*  src             = get_blob_chunk_data(blob) + chunk_start;
+
+  if (compressed_size == chunk_size)
+  {
+    memcpy(dst, src, chunk_size);
+    return true;
+  }
+
+  switch (header->codec)
+  {
+    case kCompressionCodecLz4: return lz4_decompress_block((u8*)dst, chunk_size, src, compressed_size);
+    default:                   return false;
+  }
+}
+
+bool
+decompress_blob(const void* blob, void* dst)
+{
+  u32 chunk_count = get_compressed_blob_chunk_count(blob);
+  for (u32 ichunk = 0; ichunk < chunk_count; ichunk++)
+  {
+    if (!decompress_blob_chunk(blob, ichunk, (u8*)dst + (u64)ichunk * kCompressionChunkSize))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "Core/Foundation/types.h"
+#include "Core/Foundation/hash.h"
+
+// Chunked compression for built asset payloads. The data is split into kCompressionChunkSize chunks that get compressed
+// independently of each other, so they can be decompressed in any order and on as many threads as there are chunks.
+// A compressed blob looks like:
+//
+//   CompressedBlobHeader | u32 chunk_ends[chunk_count] | chunk 0 | chunk 1 | ...
+//
+// chunk_ends are relative to the start of chunk 0. Chunk i decompresses to bytes [i * kCompressionChunkSize, (i + 1) *
+// kCompressionChunkSize) of the output, the last one can be shorter. A chunk whose compressed size is the same as its
+// uncompressed size is stored as is, which is every chunk with kCompressionCodecNone and any chunk that doesn't
+// compress with the other codecs.
+//
+// 64 KiB is also the tile size GDeflate uses, a GPU (DirectStorage) codec can go in here later without changing the
+// layout of the asset files.
+static constexpr u32 kCompressionChunkSize       = KiB(64);
+static constexpr u32 kCompressedBlobMagicNumber  = CRC32_STR("ATHENA_COMPRESSED_BLOB");
+
+enum CompressionCodec : u8
+{
+  kCompressionCodecNone,
+  // LZ4 block format (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md), one block per chunk
+  kCompressionCodecLz4,
+
+  kCompressionCodecCount,
+};
+
+enum CompressionLevel : u8
+{
+  // A single hash table probe per position, compresses at a few hundred MB/s
+  kCompressionLevelFast,
+  // Searches hash chains for the longest match. A lot slower to compress but a better ratio, and it doesn't cost
+  // anything extra to decompress.
+  kCompressionLevelHigh,
+};
+
+struct CompressedBlobHeader
+{
+  u32              magic_number;
+  CompressionCodec codec;
+  u8               __pad0__[3];
+  u32              chunk_count;
+  u32              __pad1__;
+  u64              uncompressed_size;
+};
+ASSERT_SERIALIZABLE(CompressedBlobHeader);
+
+FOUNDATION_API const char* compression_codec_to_str(CompressionCodec codec);
+
+// Worst case size of the blob compress_blob writes for size bytes
+FOUNDATION_API u64  get_compressed_blob_bound(u64 size);
+// dst needs to be at least get_compressed_blob_bound(size) bytes, returns how many bytes of it were written.
+FOUNDATION_API u64  compress_blob(void* dst, const void* src, u64 size, CompressionCodec codec, CompressionLevel level = kCompressionLevelFast);
+
+// Checks the header and chunk table of a blob that came from a file. The other blob functions trust both of those,
+// so this needs to pass before they get called on it. Corrupted chunk data gets caught by decompress_blob_chunk.
+FOUNDATION_API bool validate_compressed_blob(const void* blob, u64 blob_size, u64 uncompressed_size);
+
+FOUNDATION_API u32  get_compressed_blob_chunk_count(const void* blob);
+// How many bytes chunk ichunk decompresses to
+FOUNDATION_API u32  get_compressed_blob_chunk_size(const void* blob, u32 ichunk);
+
+// Decompresses chunk ichunk to dst, which is where that chunk goes and not the start of the whole output. Returns false
+// if the chunk is corrupted. Safe to call from multiple threads at once on different chunks of the same blob.
+//
+// LZ4 reads back what it already decompressed, so dst shouldn't be write-combined memory (like an upload heap).
+// Decompress into something cached and copy it over instead.
+FOUNDATION_API bool decompress_blob_chunk(const void* blob, u32 ichunk, void* dst);
+// Every chunk one after the other on the calling thread
+FOUNDATION_API bool decompress_blob(const void* blob, void* dst);
@@ -1,27 +1,64 @@
 #include "Core/Foundation/context.h"
 
-thread_local Context g_Ctx = {0};
+thread_local Context  g_ThreadCtx = {0};
+// The context that is active on this thread right now, nullptr means g_ThreadCtx
+thread_local Context* g_Ctx       = nullptr;
 
-#define CTX_IS_INITIALIZED (g_Ctx.scratch_allocator.memory != 0x0)
+static Context*
+get_current_context()
+{
+  return g_Ctx != nullptr ? g_Ctx : &g_ThreadCtx;
+}
+
+#define CTX_IS_INITIALIZED (get_current_context()->scratch_allocator.memory != 0x0)
 #define ASSERT_CTX_INIT() ASSERT_MSG_FATAL(CTX_IS_INITIALIZED, "Attempting to use scratch arena when context not initialized!")
 
+Context
+init_context(size_t scratch_commit_size, size_t scratch_reserve_size)
+{
+  Context ret = {0};
+  ret.scratch_allocator = init_stack_allocator(scratch_commit_size, scratch_reserve_size);
+
+  return ret;
+}
+
+void
+destroy_context(Context* ctx)
+{
+  destroy_stack_allocator(&ctx->scratch_allocator);
+  zero_memory(ctx, sizeof(Context));
+}
+
 Context
 init_thread_context()
 {
-  ASSERT(!CTX_IS_INITIALIZED);
+  ASSERT(g_ThreadCtx.scratch_allocator.memory == 0x0);
 
   static constexpr u64 kDefaultScratchCommit  = MiB(1);
   // Lots of room to overflow, since address space is pretty free
   static constexpr u64 kDefaultScratchReserve = GiB(1);
 
-  Context ret = {0};
-  ret.scratch_allocator = init_stack_allocator(kDefaultScratchCommit, kDefaultScratchReserve);
+  g_ThreadCtx = init_context(kDefaultScratchCommit, kDefaultScratchReserve);
 
-  if (!CTX_IS_INITIALIZED)
-  {
-    g_Ctx = ret;
-  }
+  return g_ThreadCtx;
+}
 
+// Threads that exit need to give back their scratch arena, otherwise short lived threads leak a GiB of address space each.
+void
+destroy_thread_context()
+{
+  ASSERT(g_ThreadCtx.scratch_allocator.memory != 0x0);
+  ASSERT_MSG_FATAL(g_Ctx == nullptr, "Thread is exiting while a swapped in context is still active.");
+
+  destroy_context(&g_ThreadCtx);
+  release_allocator_thread_slot();
+}
+
+Context*
+swap_thread_context(Context* ctx)
+{
+  Context* ret = g_Ctx;
+  g_Ctx        = ctx;
   return ret;
 }
 
@@ -32,7 +69,7 @@ alloc_scratch_arena()
 
   ScratchAllocator ret = {0};
   ret.allocated         = 0;
-  ret.backing_allocator = &g_Ctx.scratch_allocator;
+  ret.backing_allocator = &get_current_context()->scratch_allocator;
   ret.expected_start    = ret.backing_allocator->pos;
 
   return ret;
@@ -80,5 +117,5 @@ scratch_alloc(size_t size, size_t alignment)
 void
 reset_scratch_allocator()
 {
-  reset_stack(&g_Ctx.scratch_allocator);
+  reset_stack(&get_current_context()->scratch_allocator);
 }
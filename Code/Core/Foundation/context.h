@@ -27,6 +27,16 @@ struct ScratchAllocator
 };
 
 FOUNDATION_API Context init_thread_context();
+FOUNDATION_API void    destroy_thread_context();
+
+// Contexts that aren't owned by a thread, e.g. one per job fiber so that a job's scratch memory
+// follows it around when it gets resumed on a different thread.
+FOUNDATION_API Context  init_context(size_t scratch_commit_size, size_t scratch_reserve_size);
+FOUNDATION_API void     destroy_context(Context* ctx);
+
+// Makes ctx the calling thread's context until it gets swapped back, returns the previous one.
+// Passing nullptr goes back to the thread's own context from init_thread_context.
+FOUNDATION_API Context* swap_thread_context(Context* ctx);
 
 FOUNDATION_API ScratchAllocator alloc_scratch_arena();
 FOUNDATION_API void  free_scratch_arena(ScratchAllocator* allocator);
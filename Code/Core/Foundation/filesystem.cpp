@@ -1,6 +1,125 @@
 #include "Core/Foundation/memory.h"
 #include "Core/Foundation/filesystem.h"
+#include "Core/Foundation/pool_allocator.h"
+
+#include "Core/Foundation/Containers/array.h"
+#include "Core/Foundation/Containers/mpmc_ring_queue.h"
+
+#if defined(_WIN32)
 #include <windows.h>
+#elif defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#error "filesystem.cpp has no backend for this platform"
+#endif
+
+// Bigger reads get split up into chunks of this size. ReadFile only takes a 32 bit size and Linux never reads more
+// than 2 GiB (minus a page) at once.
+static constexpr u64 kMaxIoChunkSize = GiB(1);
+
+enum AsyncIoStatus : u32
+{
+  kAsyncIoInFlight,
+  kAsyncIoCompleted,
+  kAsyncIoFailed,
+};
+
+struct AsyncIoOp
+{
+#if defined(_WIN32)
+  // Completions only hand back the OVERLAPPED, so it has to be first for the op to be found again
+  OVERLAPPED overlapped;
+  HANDLE     file_handle      = nullptr;
+#else
+  s32        fd               = -1;
+  // Which registered buffer dst is in, if any
+  u32        buffer_index     = 0;
+  bool       fixed_buffer     = false;
+#endif
+
+  // Where the next chunk goes, these move along as chunks complete
+  u8*        dst              = nullptr;
+  u64        offset           = 0;
+  u64        remaining        = 0;
+
+  OsEvent*   completion_event = nullptr;
+  // AsyncIoStatus. Only ever written by the IO threads while in flight, await_io sleeps on it.
+  u32        status           = kAsyncIoInFlight;
+};
+
+#if defined(_WIN32)
+static_assert(offsetof(AsyncIoOp, overlapped) == 0);
+#else
+static constexpr u32 kMaxAsyncIoBuffers = 16;
+
+enum AsyncIoBackend : u8
+{
+  kAsyncIoBackendIoUring,
+  kAsyncIoBackendPread,
+};
+
+// The io_uring rings are shared with the kernel, these all point into the mmapped ring memory.
+struct IoUring
+{
+  s32           fd              = -1;
+
+  u32*          sq_head         = nullptr;
+  u32*          sq_tail         = nullptr;
+  u32*          sq_array        = nullptr;
+  u32           sq_mask         = 0;
+  u32           sq_entries      = 0;
+  io_uring_sqe* sqes            = nullptr;
+  // Entries up to here are filled in, the kernel only gets to see them once sq_tail catches up in submit_io_uring
+  u32           sq_pending_tail = 0;
+
+  u32*          cq_head         = nullptr;
+  u32*          cq_tail         = nullptr;
+  u32           cq_mask         = 0;
+  io_uring_cqe* cqes            = nullptr;
+
+  void*         ring_memory     = nullptr;
+  size_t        ring_size       = 0;
+  size_t        sqes_size       = 0;
+};
+
+// Never a valid AsyncIoOp*, tells the completion thread to exit
+static constexpr u64 kIoUringShutdownUserData = 1;
+#endif
+
+struct AsyncIo
+{
+  // Guarded by op_lock
+  Pool<AsyncIoOp>           ops;
+  SpinLock                  op_lock;
+
+  // The completion thread, or the pread workers for the fallback
+  Array<Thread>             threads;
+
+#if defined(_WIN32)
+  HANDLE                    io_completion_port = nullptr;
+#else
+  AsyncIoBackend            backend            = kAsyncIoBackendIoUring;
+
+  // Guarded by submit_lock, anybody can be submitting (including the completion thread when it reissues a read)
+  IoUring                   ring;
+  SpinLock                  submit_lock;
+
+  struct iovec              buffers[kMaxAsyncIoBuffers];
+  u32                       buffer_count       = 0;
+
+  MpmcRingQueue<AsyncIoOp*> pread_queue;
+  u32                       kill               = 0;
+#endif
+};
+
+static AsyncIo* g_AsyncIo = nullptr;
 
 const char*
 file_error_to_str(FileError err)
@@ -10,10 +129,274 @@ file_error_to_str(FileError err)
     case kFileOk:             return "Ok";
     case kFileFailedToCreate: return "Failed to create file";
     case kFileDoesNotExist:   return "File does not exist";
+    case kFileFailedToRead:   return "Failed to read file";
     default: UNREACHABLE;
   }
 }
 
+static AsyncIoOp*
+alloc_async_io_op(OsEvent* completion_event, void* dst, u64 size, u64 offset)
+{
+  ASSERT_MSG_FATAL(g_AsyncIo != nullptr, "init_async_io needs to be called before any async file IO.");
+
+  spin_acquire(&g_AsyncIo->op_lock);
+  ASSERT_MSG_FATAL(g_AsyncIo->ops.free_count > 0, "Ran out of async IO ops! Bump AsyncIoDesc::max_reads_in_flight.");
+  AsyncIoOp* ret = pool_alloc(&g_AsyncIo->ops);
+  spin_release(&g_AsyncIo->op_lock);
+
+  ret->dst              = (u8*)dst;
+  ret->offset           = offset;
+  ret->remaining        = size;
+  ret->completion_event = completion_event;
+  ret->status           = size > 0 ? kAsyncIoInFlight : kAsyncIoCompleted;
+
+  return ret;
+}
+
+static void
+free_async_io_op(AsyncIoOp* op)
+{
+  spin_acquire(&g_AsyncIo->op_lock);
+  pool_free(&g_AsyncIo->ops, op);
+  spin_release(&g_AsyncIo->op_lock);
+}
+
+// The op can get freed by await_io the moment its status changes, so nothing can touch it after that.
+static void
+finish_async_io_op(AsyncIoOp* op, AsyncIoStatus status)
+{
+  OsEvent* completion_event = op->completion_event;
+
+  atomic_ref_store(&op->status, (u32)status, std::memory_order_release);
+  wake_all_on_address(&op->status);
+
+  if (completion_event != nullptr)
+  {
+    os_event_signal(completion_event);
+  }
+}
+
+// Returns true once every byte has been read, otherwise the next chunk needs to be issued.
+static bool
+advance_async_io_op(AsyncIoOp* op, u64 bytes_read)
+{
+  ASSERT(bytes_read <= op->remaining);
+  op->dst       += bytes_read;
+  op->offset    += bytes_read;
+  op->remaining -= bytes_read;
+
+  return op->remaining == 0;
+}
+
+static u32
+async_io_chunk_size(const AsyncIoOp* op)
+{
+  return (u32)MIN(op->remaining, kMaxIoChunkSize);
+}
+
+static void
+spawn_async_io_threads(AllocHeap heap, const AsyncIoDesc& desc, ThreadProc proc, u32 count, const wchar_t* name_fmt)
+{
+  CpuSet cpus = desc.cpus;
+  if (cpu_set_count(cpus) == 0)
+  {
+    for (u32 cpu = 0; cpu < MIN(get_num_physical_cores(), kMaxCpuCount); cpu++)
+    {
+      cpu_set_add(&cpus, cpu);
+    }
+  }
+
+  wchar_t name[128];
+
+  g_AsyncIo->threads = init_array<Thread>(heap, count);
+  for (u32 ithread = 0; ithread < count; ithread++)
+  {
+    Thread thread = init_thread(heap, KiB(64), proc, g_AsyncIo, cpus);
+    swprintf(name, ARRAY_LENGTH(name), name_fmt, ithread);
+    set_thread_name(&thread, name);
+
+    *array_add(&g_AsyncIo->threads) = thread;
+  }
+}
+
+AwaitError
+await_io(AsyncFilePromise* promise, Option<u32> timeout_ms)
+{
+  // Either the struct wasn't filled correctly or it is a straight up error (kAsyncFileError)
+  AsyncIoOp* op = promise->op;
+  if (op == nullptr)
+  {
+    return kAwaitFailed;
+  }
+
+  u32 status = atomic_ref_load(&op->status, std::memory_order_acquire);
+  if (status == kAsyncIoInFlight)
+  {
+    // Polling a read that's still sitting in the submission queue would never see it finish otherwise. If the kernel
+    // won't take it right now then sleeping on it would never wake up, so that's still in flight as far as the caller
+    // is concerned.
+    if (!submit_async_io() || (timeout_ms && unwrap(timeout_ms) == 0))
+    {
+      return kAwaitInFlight;
+    }
+
+    u32 in_flight = kAsyncIoInFlight;
+    while (status == kAsyncIoInFlight)
+    {
+      bool woken = wait_on_address(&op->status, &in_flight, sizeof(in_flight), unwrap_or(timeout_ms, U32_MAX));
+      status     = atomic_ref_load(&op->status, std::memory_order_acquire);
+      if (!woken)
+      {
+        break;
+      }
+    }
+
+    if (status == kAsyncIoInFlight)
+    {
+      return kAwaitInFlight;
+    }
+  }
+
+  free_async_io_op(op);
+  promise->op = nullptr;
+
+  return status == kAsyncIoCompleted ? kAwaitCompleted : kAwaitFailed;
+}
+
+#if defined(_WIN32)
+
+// Completion key that isn't any file's, tells the completion thread to exit
+static constexpr ULONG_PTR kAsyncIoShutdownKey = 1;
+
+static void
+log_win32_error(const char* what, DWORD err)
+{
+  char err_msg[512];
+  FormatMessageA(
+    FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
+    nullptr,
+    err,
+    MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
+    err_msg,
+    sizeof(err_msg),
+    nullptr
+  );
+
+  dbgln("%s: %s", what, err_msg);
+}
+
+// Issues the next chunk, its completion shows up on the shared completion port
+static bool
+issue_async_io_op(AsyncIoOp* op)
+{
+  zero_memory(&op->overlapped, sizeof(op->overlapped));
+  op->overlapped.Offset     = (DWORD)(op->offset & 0xFFFFFFFF);
+  op->overlapped.OffsetHigh = (DWORD)(op->offset >> 32);
+
+  BOOL  ok  = ReadFile(op->file_handle, op->dst, async_io_chunk_size(op), nullptr, &op->overlapped);
+  DWORD err = GetLastError();
+  if (!ok && err != ERROR_IO_PENDING)
+  {
+    log_win32_error("Failed to read file", err);
+    return false;
+  }
+
+  return true;
+}
+
+static u32
+async_io_completion_thread(void* param)
+{
+  AsyncIo* async_io = (AsyncIo*)param;
+  while (true)
+  {
+    DWORD       bytes_read = 0;
+    ULONG_PTR   key        = 0;
+    OVERLAPPED* overlapped = nullptr;
+    BOOL        ok         = GetQueuedCompletionStatus(async_io->io_completion_port, &bytes_read, &key, &overlapped, INFINITE);
+
+    if (overlapped == nullptr)
+    {
+      if (key == kAsyncIoShutdownKey)
+      {
+        break;
+      }
+      continue;
+    }
+
+    // Reading past the end of the file fails with ERROR_HANDLE_EOF, a read that comes up short just gets continued.
+    AsyncIoOp* op = (AsyncIoOp*)overlapped;
+    if (!ok || bytes_read == 0)
+    {
+      finish_async_io_op(op, kAsyncIoFailed);
+    }
+    else if (advance_async_io_op(op, bytes_read))
+    {
+      finish_async_io_op(op, kAsyncIoCompleted);
+    }
+    else if (!issue_async_io_op(op))
+    {
+      finish_async_io_op(op, kAsyncIoFailed);
+    }
+  }
+
+  return 0;
+}
+
+void
+init_async_io(AllocHeap heap, const AsyncIoDesc& desc)
+{
+  ASSERT(g_AsyncIo == nullptr);
+  ASSERT_MSG_FATAL(desc.max_reads_in_flight > 0, "Async IO needs room for at least one read.");
+
+  g_AsyncIo = HEAP_ALLOC(AsyncIo, heap, 1);
+  zero_memory(g_AsyncIo, sizeof(AsyncIo));
+
+  g_AsyncIo->ops                = init_pool<AsyncIoOp>(heap, desc.max_reads_in_flight);
+  g_AsyncIo->op_lock            = init_spin_lock();
+  g_AsyncIo->io_completion_port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+  ASSERT_MSG_FATAL(g_AsyncIo->io_completion_port != nullptr, "Failed to create IO completion port with error 0x%x", GetLastError());
+
+  spawn_async_io_threads(heap, desc, &async_io_completion_thread, 1, L"Async IO Completion %u");
+}
+
+void
+destroy_async_io()
+{
+  PostQueuedCompletionStatus(g_AsyncIo->io_completion_port, 0, kAsyncIoShutdownKey, nullptr);
+  join_threads(g_AsyncIo->threads.memory, (u32)g_AsyncIo->threads.size);
+  for (Thread& thread : g_AsyncIo->threads)
+  {
+    destroy_thread(&thread);
+  }
+
+  CloseHandle(g_AsyncIo->io_completion_port);
+  // Everything else came out of an AllocHeap
+  zero_memory(g_AsyncIo, sizeof(AsyncIo));
+  g_AsyncIo = nullptr;
+}
+
+const char*
+get_async_io_backend_name()
+{
+  return "iocp";
+}
+
+bool
+register_async_io_buffer(void* memory, u64 size)
+{
+  UNREFERENCED_PARAMETER(memory);
+  UNREFERENCED_PARAMETER(size);
+  return false;
+}
+
+bool
+submit_async_io()
+{
+  // ReadFile hands every read to the kernel right away
+  return true;
+}
+
 Result<FileStream, FileError>
 create_file(const char* path, FileCreateFlags flags)
 {
@@ -95,6 +478,8 @@ open_file(const char* path, FileStreamFlags flags)
 Result<AsyncFileStream, FileError>
 open_file_async(const char* path, FileStreamFlags flags)
 {
+  ASSERT_MSG_FATAL(g_AsyncIo != nullptr, "init_async_io needs to be called before any async file IO.");
+
   AsyncFileStream ret = {0};
 
   DWORD access_flags = to_win32_file_access_flags(flags);
@@ -114,8 +499,16 @@ open_file_async(const char* path, FileStreamFlags flags)
     return Err(kFileDoesNotExist);
   }
 
-  ret.file_handle        = handle;
-  ret.io_completion_port = CreateIoCompletionPort(ret.file_handle, nullptr, 0, 0);
+  // Every file completes on the one shared port, nobody ever waits on the file handle itself
+  if (CreateIoCompletionPort(handle, g_AsyncIo->io_completion_port, 0, 0) == nullptr)
+  {
+    log_win32_error("Failed to associate file with the IO completion port", GetLastError());
+    CloseHandle(handle);
+    return Err(kFileDoesNotExist);
+  }
+  SetFileCompletionNotificationModes(handle, FILE_SKIP_SET_EVENT_ON_HANDLE);
+
+  ret.file_handle = handle;
 
   return Ok(ret);
 }
@@ -130,99 +523,115 @@ close_file(FileStream* file_stream)
 void
 close_file(AsyncFileStream* file_stream)
 {
-  CloseHandle(file_stream->io_completion_port);
   CloseHandle(file_stream->file_handle);
-  zero_memory(file_stream, sizeof(FileStream));
+  zero_memory(file_stream, sizeof(AsyncFileStream));
 }
 
-// TODO(bshihabi): If you need to read more than 4 gigs this is not gonna work, need to support paging since apparently I can't write/read more than that from a file at a time on win32...
 bool
 write_file(FileStream file_stream, const void* src, u64 size)
 {
-  ASSERT_MSG_FATAL(size <= U32_MAX, "Writing to file with size %lu not supported currently due to 32-bit limit.", size);
-  return WriteFile(file_stream.handle, src, (u32)size, NULL, NULL);
+  const u8* src_bytes = (const u8*)src;
+  while (size > 0)
+  {
+    DWORD chunk_size    = (DWORD)MIN(size, kMaxIoChunkSize);
+    DWORD bytes_written = 0;
+    if (!WriteFile(file_stream.handle, src_bytes, chunk_size, &bytes_written, NULL) || bytes_written == 0)
+    {
+      return false;
+    }
+
+    src_bytes += bytes_written;
+    size      -= bytes_written;
+  }
+
+  return true;
 }
 
 bool
 read_file(FileStream file_stream, void* dst, u64 size, u64 offset)
 {
-  ASSERT_MSG_FATAL(size <= U32_MAX,   "Reading from file with size %lu not supported currently due to 32-bit limit.", size);
-  ASSERT_MSG_FATAL(offset <= U32_MAX, "Seeking in files larger than U32_MAX (requested %lu) not implemented", offset);
-  if (SetFilePointer(file_stream.handle, (LONG)offset, NULL, FILE_BEGIN) == INVALID_SET_FILE_POINTER)
+  LARGE_INTEGER distance = {0};
+  distance.QuadPart      = (LONGLONG)offset;
+  if (!SetFilePointerEx(file_stream.handle, distance, NULL, FILE_BEGIN))
   {
     return false;
   }
 
-  return ReadFile(file_stream.handle, dst, (u32)size, NULL, NULL);
+  u8* dst_bytes = (u8*)dst;
+  while (size > 0)
+  {
+    DWORD chunk_size = (DWORD)MIN(size, kMaxIoChunkSize);
+    DWORD bytes_read = 0;
+    if (!ReadFile(file_stream.handle, dst_bytes, chunk_size, &bytes_read, NULL) || bytes_read == 0)
+    {
+      return false;
+    }
+
+    dst_bytes += bytes_read;
+    size      -= bytes_read;
+  }
+
+  return true;
 }
 
 Result<void, FileError>
-read_file(AsyncFileStream file_stream, AsyncFilePromise* out_promise, void* dst, u64 size, u64 offset)
+read_file(AsyncFileStream file_stream, AsyncFilePromise* out_promise, void* dst, u64 size, u64 offset, OsEvent* completion_event)
 {
-  ASSERT_MSG_FATAL(size <= U32_MAX,   "Reading from file with size %lu not supported currently due to 32-bit limit.", size);
-
-  out_promise->overlapped.Offset     = (DWORD)(offset & 0xFFFFFFFF);
-  out_promise->overlapped.OffsetHigh = (DWORD)(offset >> 32);
+  AsyncIoOp* op   = alloc_async_io_op(completion_event, dst, size, offset);
+  op->file_handle = file_stream.file_handle;
 
-  BOOL ok = ReadFile(file_stream.file_handle, dst, (u32)size, NULL, &out_promise->overlapped);
-
-  DWORD err = GetLastError();
-  if (!ok && err != ERROR_IO_PENDING)
+  if (size > 0 && !issue_async_io_op(op))
   {
-    char err_msg[512];
-    FormatMessageA(
-      FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
-      nullptr,
-      err,
-      MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
-      err_msg,
-      sizeof(err_msg),
-      nullptr
-    );
-
-    dbgln("Failed to read file: %s", err_msg);
-    out_promise->io_completion_port = nullptr;
+    free_async_io_op(op);
+    out_promise->op = nullptr;
     return Err(kFileFailedToRead);
   }
 
-  out_promise->io_completion_port = file_stream.io_completion_port;
+  out_promise->op = op;
 
   return Ok();
 }
 
-AwaitError
-await_io(const AsyncFilePromise& promise, Option<u32> timeout_ms)
+void
+prefetch_file_range(AsyncFileStream file_stream, u64 offset, u64 size)
 {
-  // Either the struct wasn't filled correctly or it is a straight up error (kAsyncFileError)
-  if (promise.io_completion_port == nullptr)
+  UNREFERENCED_PARAMETER(file_stream);
+  UNREFERENCED_PARAMETER(offset);
+  UNREFERENCED_PARAMETER(size);
+}
+
+Result<MappedFile, FileError>
+map_file(FileStream file_stream, u64 size)
+{
+  MappedFile ret;
+  if (size == 0 || get_file_size(file_stream) < size)
   {
-    return kAwaitFailed;
+    return Err(kFileFailedToRead);
   }
 
-  DWORD       bytes_streamed = 0;
-  ULONG_PTR   key            = 0;
-  OVERLAPPED* overlapped     = nullptr;
-
-  BOOL ok = GetQueuedCompletionStatus(promise.io_completion_port, &bytes_streamed, &key, &overlapped, unwrap_or(timeout_ms, INFINITE));
-
-  if (!ok)
+  ret.mapping = CreateFileMappingA(file_stream.handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (ret.mapping == nullptr)
   {
-    if (overlapped == nullptr && timeout_ms)
-    {
-      return kAwaitInFlight;
-    }
-    else
-    {
-      return kAwaitFailed;
-    }
+    return Err(kFileFailedToRead);
   }
 
-  if (bytes_streamed == 0)
+  ret.data = (const u8*)MapViewOfFile(ret.mapping, FILE_MAP_READ, 0, 0, size);
+  if (ret.data == nullptr)
   {
-    return kAwaitFailed;
+    CloseHandle(ret.mapping);
+    return Err(kFileFailedToRead);
   }
+  ret.size = size;
+
+  return Ok(ret);
+}
 
-  return kAwaitCompleted;
+void
+unmap_file(MappedFile* mapped_file)
+{
+  UnmapViewOfFile(mapped_file->data);
+  CloseHandle(mapped_file->mapping);
+  zero_memory(mapped_file, sizeof(MappedFile));
 }
 
 bool
@@ -243,6 +652,626 @@ get_file_size(FileStream file_stream)
   return ret.QuadPart;
 }
 
+#else
+
+static bool
+init_io_uring(IoUring* ring, u32 max_reads_in_flight)
+{
+  // The submission queue can be smaller than the number of reads in flight, a full one just gets submitted early.
+  // Every read only ever has one completion waiting though, so the completion queue fits all of them and can't overflow.
+  io_uring_params params;
+  zero_memory(&params, sizeof(params));
+  params.flags      = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+  params.cq_entries = MAX(max_reads_in_flight + 1, 2 * MIN(max_reads_in_flight, 256U));
+
+  s32 fd = (s32)syscall(__NR_io_uring_setup, MIN(max_reads_in_flight, 256U), &params);
+  if (fd < 0)
+  {
+    dbgln("io_uring isn't available (errno %d), falling back to pread.", errno);
+    return false;
+  }
+
+  // Both rings sharing one mapping has been around since 5.4, don't bother with anything older
+  if (!(params.features & IORING_FEAT_SINGLE_MMAP) || params.cq_entries < max_reads_in_flight + 1)
+  {
+    close(fd);
+    return false;
+  }
+
+  size_t sq_size   = params.sq_off.array + params.sq_entries * sizeof(u32);
+  size_t cq_size   = params.cq_off.cqes  + params.cq_entries * sizeof(io_uring_cqe);
+  size_t ring_size = MAX(sq_size, cq_size);
+  size_t sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+  u8* ring_memory = (u8*)mmap(nullptr, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (ring_memory == MAP_FAILED)
+  {
+    close(fd);
+    return false;
+  }
+
+  void* sqes = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED)
+  {
+    munmap(ring_memory, ring_size);
+    close(fd);
+    return false;
+  }
+
+  ring->fd              = fd;
+  ring->sq_head         = (u32*)(ring_memory + params.sq_off.head);
+  ring->sq_tail         = (u32*)(ring_memory + params.sq_off.tail);
+  ring->sq_array        = (u32*)(ring_memory + params.sq_off.array);
+  ring->sq_mask         = *(u32*)(ring_memory + params.sq_off.ring_mask);
+  ring->sq_entries      = params.sq_entries;
+  ring->sqes            = (io_uring_sqe*)sqes;
+  ring->sq_pending_tail = *ring->sq_tail;
+
+  ring->cq_head         = (u32*)(ring_memory + params.cq_off.head);
+  ring->cq_tail         = (u32*)(ring_memory + params.cq_off.tail);
+  ring->cq_mask         = *(u32*)(ring_memory + params.cq_off.ring_mask);
+  ring->cqes            = (io_uring_cqe*)(ring_memory + params.cq_off.cqes);
+
+  ring->ring_memory     = ring_memory;
+  ring->ring_size       = ring_size;
+  ring->sqes_size       = sqes_size;
+
+  return true;
+}
+
+static void
+destroy_io_uring(IoUring* ring)
+{
+  munmap(ring->sqes, ring->sqes_size);
+  munmap(ring->ring_memory, ring->ring_size);
+  close(ring->fd);
+  zero_memory(ring, sizeof(IoUring));
+}
+
+static s32
+io_uring_enter(s32 fd, u32 to_submit, u32 min_complete, u32 flags)
+{
+  return (s32)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+// How many times in a row the kernel gets to turn down a submit (EBUSY/EAGAIN) before giving up on it
+static constexpr u32 kIoUringSubmitRetries = 64;
+
+// Hands every pending entry to the kernel. Caller holds submit_lock. Returns false if the kernel kept turning them down
+// or the ring is broken, anything it didn't take stays in the ring and goes out with the next submit.
+static bool
+submit_io_uring(IoUring* ring)
+{
+  atomic_ref_store(ring->sq_tail, ring->sq_pending_tail, std::memory_order_release);
+
+  u32 retries = 0;
+  while (true)
+  {
+    // The kernel moves sq_head past whatever it consumed, so that's the source of truth for what's left
+    u32 to_submit = ring->sq_pending_tail - atomic_ref_load(ring->sq_head, std::memory_order_acquire);
+    if (to_submit == 0)
+    {
+      return true;
+    }
+
+    s32 submitted = io_uring_enter(ring->fd, to_submit, 0, 0);
+    if (submitted > 0)
+    {
+      retries = 0;
+      continue;
+    }
+
+    if (submitted < 0 && errno == EINTR)
+    {
+      continue;
+    }
+
+    if (submitted < 0 && errno != EAGAIN && errno != EBUSY)
+    {
+      dbgln("io_uring_enter failed with errno %d.", errno);
+      return false;
+    }
+
+    // EBUSY/EAGAIN means the kernel is out of room for more requests right now, give it a moment to finish some
+    if (++retries == kIoUringSubmitRetries)
+    {
+      dbgln("io_uring_enter kept turning down %u entries.", to_submit);
+      return false;
+    }
+    yield_current_thread();
+  }
+}
+
+// Fills in a submission entry for the op's next chunk. Caller holds submit_lock.
+// Returns false if the ring is full and the kernel wouldn't take anything to make room.
+static bool
+push_io_uring_sqe(IoUring* ring, u8 opcode, u64 user_data, const AsyncIoOp* op)
+{
+  // Full, the kernel consumes everything that's been submitted right away so this makes room
+  if (ring->sq_pending_tail - atomic_ref_load(ring->sq_head, std::memory_order_acquire) == ring->sq_entries && !submit_io_uring(ring))
+  {
+    return false;
+  }
+
+  u32           index = ring->sq_pending_tail & ring->sq_mask;
+  io_uring_sqe* sqe   = &ring->sqes[index];
+  zero_memory(sqe, sizeof(io_uring_sqe));
+  sqe->opcode    = opcode;
+  sqe->user_data = user_data;
+  if (op != nullptr)
+  {
+    sqe->fd        = op->fd;
+    sqe->off       = op->offset;
+    sqe->addr      = (u64)op->dst;
+    sqe->len       = async_io_chunk_size(op);
+    sqe->buf_index = (u16)op->buffer_index;
+  }
+
+  ring->sq_array[index] = index;
+  ring->sq_pending_tail++;
+
+  return true;
+}
+
+static bool
+push_io_uring_read(IoUring* ring, const AsyncIoOp* op)
+{
+  return push_io_uring_sqe(ring, op->fixed_buffer ? IORING_OP_READ_FIXED : IORING_OP_READ, (u64)op, op);
+}
+
+static u32
+io_uring_completion_thread(void* param)
+{
+  AsyncIo* async_io = (AsyncIo*)param;
+  IoUring* ring     = &async_io->ring;
+
+  bool exit = false;
+  while (!exit)
+  {
+    u32 head = atomic_ref_load(ring->cq_head, std::memory_order_relaxed);
+    u32 tail = atomic_ref_load(ring->cq_tail, std::memory_order_acquire);
+    if (head == tail)
+    {
+      // Sleeps in the kernel until something completes. EINTR just goes around again.
+      io_uring_enter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS);
+      continue;
+    }
+
+    bool reissued = false;
+    for (; head != tail; head++)
+    {
+      const io_uring_cqe* cqe = &ring->cqes[head & ring->cq_mask];
+      if (cqe->user_data == kIoUringShutdownUserData)
+      {
+        exit = true;
+        continue;
+      }
+
+      AsyncIoOp* op  = (AsyncIoOp*)cqe->user_data;
+      s32        res = cqe->res;
+
+      // A read that comes up short (or got interrupted) just gets continued, zero bytes means we hit the end of the file.
+      bool retry = res == -EINTR || res == -EAGAIN;
+      if (!retry && res <= 0)
+      {
+        finish_async_io_op(op, kAsyncIoFailed);
+      }
+      else if (!retry && advance_async_io_op(op, (u64)res))
+      {
+        finish_async_io_op(op, kAsyncIoCompleted);
+      }
+      else
+      {
+        spin_acquire(&async_io->submit_lock);
+        bool pushed = push_io_uring_read(ring, op);
+        spin_release(&async_io->submit_lock);
+
+        if (pushed)
+        {
+          reissued = true;
+        }
+        else
+        {
+          finish_async_io_op(op, kAsyncIoFailed);
+        }
+      }
+    }
+    atomic_ref_store(ring->cq_head, head, std::memory_order_release);
+
+    // Anything the kernel doesn't take here goes out with whoever submits or awaits next
+    if (reissued)
+    {
+      submit_async_io();
+    }
+  }
+
+  return 0;
+}
+
+static u32
+pread_worker_thread(void* param)
+{
+  AsyncIo* async_io = (AsyncIo*)param;
+  while (!atomic_ref_load(&async_io->kill))
+  {
+    AsyncIoOp* op = nullptr;
+    if (!try_mpmc_ring_queue_pop_wait(&async_io->pread_queue, &op, U32_MAX))
+    {
+      continue;
+    }
+
+    AsyncIoStatus status = kAsyncIoCompleted;
+    while (op->remaining > 0)
+    {
+      ssize_t res = pread(op->fd, op->dst, async_io_chunk_size(op), (off_t)op->offset);
+      if (res < 0 && errno == EINTR)
+      {
+        continue;
+      }
+
+      if (res <= 0)
+      {
+        status = kAsyncIoFailed;
+        break;
+      }
+
+      advance_async_io_op(op, (u64)res);
+    }
+
+    finish_async_io_op(op, status);
+  }
+
+  return 0;
+}
+
+void
+init_async_io(AllocHeap heap, const AsyncIoDesc& desc)
+{
+  ASSERT(g_AsyncIo == nullptr);
+  ASSERT_MSG_FATAL(desc.max_reads_in_flight > 0, "Async IO needs room for at least one read.");
+
+  g_AsyncIo = HEAP_ALLOC(AsyncIo, heap, 1);
+  zero_memory(g_AsyncIo, sizeof(AsyncIo));
+
+  g_AsyncIo->ops         = init_pool<AsyncIoOp>(heap, desc.max_reads_in_flight);
+  g_AsyncIo->op_lock     = init_spin_lock();
+  g_AsyncIo->submit_lock = init_spin_lock();
+
+  if (!desc.force_fallback && init_io_uring(&g_AsyncIo->ring, desc.max_reads_in_flight))
+  {
+    g_AsyncIo->backend = kAsyncIoBackendIoUring;
+    spawn_async_io_threads(heap, desc, &io_uring_completion_thread, 1, L"Async IO Completion %u");
+  }
+  else
+  {
+    ASSERT_MSG_FATAL(desc.fallback_thread_count > 0, "The pread fallback needs at least one thread.");
+    g_AsyncIo->backend     = kAsyncIoBackendPread;
+    g_AsyncIo->pread_queue = init_mpmc_ring_queue<AsyncIoOp*>(heap, desc.max_reads_in_flight);
+    spawn_async_io_threads(heap, desc, &pread_worker_thread, desc.fallback_thread_count, L"Async IO Worker %u");
+  }
+}
+
+void
+destroy_async_io()
+{
+  if (g_AsyncIo->backend == kAsyncIoBackendIoUring)
+  {
+    // Every read has been awaited by now, so the ring being stuck means the completion thread could never exit
+    spin_acquire(&g_AsyncIo->submit_lock);
+    bool pushed    = push_io_uring_sqe(&g_AsyncIo->ring, IORING_OP_NOP, kIoUringShutdownUserData, nullptr);
+    bool submitted = pushed && submit_io_uring(&g_AsyncIo->ring);
+    spin_release(&g_AsyncIo->submit_lock);
+    ASSERT_MSG_FATAL(submitted, "Failed to submit the async IO shutdown to io_uring.");
+  }
+  else
+  {
+    atomic_ref_store(&g_AsyncIo->kill, 1U);
+    mpmc_ring_queue_wake_all(&g_AsyncIo->pread_queue);
+  }
+
+  join_threads(g_AsyncIo->threads.memory, (u32)g_AsyncIo->threads.size);
+  for (Thread& thread : g_AsyncIo->threads)
+  {
+    destroy_thread(&thread);
+  }
+
+  if (g_AsyncIo->backend == kAsyncIoBackendIoUring)
+  {
+    destroy_io_uring(&g_AsyncIo->ring);
+  }
+
+  // Everything else came out of an AllocHeap
+  zero_memory(g_AsyncIo, sizeof(AsyncIo));
+  g_AsyncIo = nullptr;
+}
+
+const char*
+get_async_io_backend_name()
+{
+  ASSERT_MSG_FATAL(g_AsyncIo != nullptr, "init_async_io needs to be called before any async file IO.");
+  return g_AsyncIo->backend == kAsyncIoBackendIoUring ? "io_uring" : "pread";
+}
+
+bool
+register_async_io_buffer(void* memory, u64 size)
+{
+  ASSERT_MSG_FATAL(g_AsyncIo != nullptr, "init_async_io needs to be called before any async file IO.");
+
+  // The kernel doesn't take fixed buffers over 1 GiB
+  if (g_AsyncIo->backend != kAsyncIoBackendIoUring || g_AsyncIo->buffer_count == kMaxAsyncIoBuffers || size == 0 || size > GiB(1))
+  {
+    return false;
+  }
+
+  spin_acquire(&g_AsyncIo->submit_lock);
+  defer { spin_release(&g_AsyncIo->submit_lock); };
+
+  // Registering replaces the whole table, so the old one has to go first
+  s32 fd = g_AsyncIo->ring.fd;
+  if (g_AsyncIo->buffer_count > 0)
+  {
+    syscall(__NR_io_uring_register, fd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+  }
+
+  g_AsyncIo->buffers[g_AsyncIo->buffer_count] = {memory, (size_t)size};
+  if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, g_AsyncIo->buffers, g_AsyncIo->buffer_count + 1) == 0)
+  {
+    g_AsyncIo->buffer_count++;
+    return true;
+  }
+
+  // Usually RLIMIT_MEMLOCK, put back whatever was registered before
+  dbgln("Failed to register async IO buffer (errno %d).", errno);
+  if (g_AsyncIo->buffer_count > 0)
+  {
+    syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, g_AsyncIo->buffers, g_AsyncIo->buffer_count);
+  }
+  return false;
+}
+
+bool
+submit_async_io()
+{
+  ASSERT_MSG_FATAL(g_AsyncIo != nullptr, "init_async_io needs to be called before any async file IO.");
+
+  // The pread workers pick reads up as soon as they're queued
+  if (g_AsyncIo->backend != kAsyncIoBackendIoUring)
+  {
+    return true;
+  }
+
+  spin_acquire(&g_AsyncIo->submit_lock);
+  bool submitted = submit_io_uring(&g_AsyncIo->ring);
+  spin_release(&g_AsyncIo->submit_lock);
+
+  return submitted;
+}
+
+static s32
+to_posix_open_flags(FileStreamFlags flags)
+{
+  // Sanity check to make sure we don't open the file in a silly state
+  ASSERT_MSG_FATAL((flags & kFileStreamReadWrite) != 0, "Specified neither read nor write access to file when opening! This is likely a programmer mistake.");
+
+  if ((flags & kFileStreamReadWrite) == kFileStreamReadWrite)
+  {
+    return O_RDWR;
+  }
+
+  return (flags & kFileStreamWrite) ? O_WRONLY : O_RDONLY;
+}
+
+Result<FileStream, FileError>
+create_file(const char* path, FileCreateFlags flags)
+{
+  FileStream ret;
+
+  s32 open_flags = O_RDWR | O_CREAT | O_CLOEXEC;
+  open_flags    |= (flags & kCreateTruncateExisting) ? O_TRUNC : O_EXCL;
+
+  ret.fd = open(path, open_flags, 0644);
+  if (ret.fd < 0)
+  {
+    return Err(kFileFailedToCreate);
+  }
+
+  return Ok(ret);
+}
+
+Result<FileStream, FileError>
+open_file(const char* path, FileStreamFlags flags)
+{
+  FileStream ret;
+
+  ret.fd = open(path, to_posix_open_flags(flags) | O_CLOEXEC);
+  if (ret.fd < 0)
+  {
+    return Err(kFileDoesNotExist);
+  }
+
+  return Ok(ret);
+}
+
+Result<AsyncFileStream, FileError>
+open_file_async(const char* path, FileStreamFlags flags)
+{
+  ASSERT_MSG_FATAL(g_AsyncIo != nullptr, "init_async_io needs to be called before any async file IO.");
+
+  AsyncFileStream ret;
+
+  ret.fd = open(path, to_posix_open_flags(flags) | O_CLOEXEC);
+  if (ret.fd < 0)
+  {
+    return Err(kFileDoesNotExist);
+  }
+
+  return Ok(ret);
+}
+
+void
+close_file(FileStream* file_stream)
+{
+  close(file_stream->fd);
+  file_stream->fd = -1;
+}
+
+void
+close_file(AsyncFileStream* file_stream)
+{
+  close(file_stream->fd);
+  file_stream->fd = -1;
+}
+
+bool
+write_file(FileStream file_stream, const void* src, u64 size)
+{
+  const u8* src_bytes = (const u8*)src;
+  while (size > 0)
+  {
+    ssize_t bytes_written = write(file_stream.fd, src_bytes, MIN(size, kMaxIoChunkSize));
+    if (bytes_written < 0 && errno == EINTR)
+    {
+      continue;
+    }
+
+    if (bytes_written <= 0)
+    {
+      return false;
+    }
+
+    src_bytes += bytes_written;
+    size      -= (u64)bytes_written;
+  }
+
+  return true;
+}
+
+bool
+read_file(FileStream file_stream, void* dst, u64 size, u64 offset)
+{
+  u8* dst_bytes = (u8*)dst;
+  while (size > 0)
+  {
+    ssize_t bytes_read = pread(file_stream.fd, dst_bytes, MIN(size, kMaxIoChunkSize), (off_t)offset);
+    if (bytes_read < 0 && errno == EINTR)
+    {
+      continue;
+    }
+
+    if (bytes_read <= 0)
+    {
+      return false;
+    }
+
+    dst_bytes += bytes_read;
+    offset    += (u64)bytes_read;
+    size      -= (u64)bytes_read;
+  }
+
+  return true;
+}
+
+Result<void, FileError>
+read_file(AsyncFileStream file_stream, AsyncFilePromise* out_promise, void* dst, u64 size, u64 offset, OsEvent* completion_event)
+{
+  AsyncIoOp* op = alloc_async_io_op(completion_event, dst, size, offset);
+  op->fd        = file_stream.fd;
+  if (size == 0)
+  {
+    out_promise->op = op;
+    return Ok();
+  }
+
+  if (g_AsyncIo->backend == kAsyncIoBackendPread)
+  {
+    bool pushed = try_mpmc_ring_queue_push(&g_AsyncIo->pread_queue, op);
+    ASSERT_MSG_FATAL(pushed, "The pread queue has room for every op, something went wrong with async IO.");
+
+    out_promise->op = op;
+    return Ok();
+  }
+
+  // The whole read has to fit inside of the buffer for the kernel to take it as a fixed buffer read
+  uintptr_t start = (uintptr_t)dst;
+  for (u32 ibuffer = 0; ibuffer < g_AsyncIo->buffer_count; ibuffer++)
+  {
+    const struct iovec& buffer = g_AsyncIo->buffers[ibuffer];
+    uintptr_t           base   = (uintptr_t)buffer.iov_base;
+    if (start >= base && start - base <= buffer.iov_len && size <= buffer.iov_len - (start - base))
+    {
+      op->fixed_buffer = true;
+      op->buffer_index = ibuffer;
+      break;
+    }
+  }
+
+  spin_acquire(&g_AsyncIo->submit_lock);
+  bool pushed = push_io_uring_read(&g_AsyncIo->ring, op);
+  spin_release(&g_AsyncIo->submit_lock);
+
+  if (!pushed)
+  {
+    free_async_io_op(op);
+    out_promise->op = nullptr;
+    return Err(kFileFailedToRead);
+  }
+
+  out_promise->op = op;
+
+  return Ok();
+}
+
+void
+prefetch_file_range(AsyncFileStream file_stream, u64 offset, u64 size)
+{
+  posix_fadvise(file_stream.fd, (off_t)offset, (off_t)size, POSIX_FADV_WILLNEED);
+}
+
+Result<MappedFile, FileError>
+map_file(FileStream file_stream, u64 size)
+{
+  MappedFile ret;
+  if (size == 0 || get_file_size(file_stream) < size)
+  {
+    return Err(kFileFailedToRead);
+  }
+
+  void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, file_stream.fd, 0);
+  if (data == MAP_FAILED)
+  {
+    return Err(kFileFailedToRead);
+  }
+  ret.data = (const u8*)data;
+  ret.size = size;
+
+  return Ok(ret);
+}
+
+void
+unmap_file(MappedFile* mapped_file)
+{
+  munmap((void*)mapped_file->data, mapped_file->size);
+  zero_memory(mapped_file, sizeof(MappedFile));
+}
+
+bool
+file_exists(const char* path)
+{
+  struct stat attributes;
+  return stat(path, &attributes) == 0 && S_ISREG(attributes.st_mode);
+}
+
+u64
+get_file_size(FileStream file_stream)
+{
+  struct stat attributes;
+  ASSERT(fstat(file_stream.fd, &attributes) == 0);
+
+  return (u64)attributes.st_size;
+}
+
+#endif
+
 u32
 get_parent_dir(const char* path, u32 len)
 {
@@ -271,4 +1300,4 @@ get_file_extension(const char* path, u32 len)
   }
 
   return len;
-}
\ No newline at end of file
+}
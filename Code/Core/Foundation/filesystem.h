@@ -1,32 +1,61 @@
 #pragma once
 #include "Core/Foundation/types.h"
+#include "Core/Foundation/threading.h"
 #include "Core/Foundation/Containers/option.h"
 #include "Core/Foundation/Containers/error_or.h"
 
 struct FileStream
 {
+#if defined(_WIN32)
   HANDLE handle = nullptr;
+#else
+  s32    fd     = -1;
+#endif
 };
 
 struct AsyncFileStream
 {
-  HANDLE     file_handle        = nullptr;
-  HANDLE     io_completion_port = nullptr;
-  OVERLAPPED overlapped;
+#if defined(_WIN32)
+  HANDLE file_handle = nullptr;
+#else
+  s32    fd          = -1;
+#endif
+};
 
+// A read-only view of the start of a file. The view stays valid after the file it came from gets closed.
+struct MappedFile
+{
+  const u8* data    = nullptr;
+  u64       size    = 0;
+#if defined(_WIN32)
+  HANDLE    mapping = nullptr;
+#endif
 };
 
+// Reads from every AsyncFileStream complete on the same queue (one IOCP on Windows, one io_uring or a pool of pread
+// threads on Linux), which a single IO thread drains. Each read in flight gets an AsyncIoOp out of a pool that lives
+// until whoever is waiting on it sees it finish, so promises can be copied around freely while the read is running.
+struct AsyncIoOp;
+
 struct AsyncFilePromise
 {
-  // This pointer is not _owned_ by the promise, so it does not need to be freed.
-  // This could technically lead to a dangling pointer bug, but I haven't found a better way to structure these
-  HANDLE     io_completion_port = nullptr;
-
-  OVERLAPPED overlapped;
+  AsyncIoOp* op = nullptr;
 };
 
 static constexpr AsyncFilePromise kAsyncFileError{};
 
+struct AsyncIoDesc
+{
+  // Reads that can be in flight at once across every file, running out is fatal
+  u32    max_reads_in_flight   = 1024;
+  // Where the IO threads run, empty means anywhere. They spend nearly all of their time asleep in the kernel.
+  CpuSet cpus;
+  // Linux only. How many threads do blocking preads when io_uring isn't available.
+  u32    fallback_thread_count = 4;
+  // Linux only. Skips io_uring even if the kernel has it, mostly for comparing the two.
+  bool   force_fallback        = false;
+};
+
 enum FileCreateFlags : u32
 {
   kFileCreateFlagsNone = 0,
@@ -51,25 +80,52 @@ enum FileError
 enum AwaitError
 {
   kAwaitCompleted,
-  kAwaitInFlight,  // This is only returned if you await non-blocking
+  kAwaitInFlight,  // This is only returned if you await non-blocking, or if submit_async_io couldn't hand the read off
   kAwaitFailed,
 };
 
 FOUNDATION_API const char* file_error_to_str(FileError err);
 
+// Needs to be called before any async file IO, destroy_async_io only after every read has been awaited.
+FOUNDATION_API void        init_async_io(AllocHeap heap, const AsyncIoDesc& desc = {});
+FOUNDATION_API void        destroy_async_io();
+FOUNDATION_API const char* get_async_io_backend_name();
+
+// Reads that land entirely inside [memory, memory + size) skip pinning and mapping their pages on every read (io_uring
+// fixed buffers). Meant for long-lived staging memory, register it up front before any reads are in flight. Returns
+// false if the backend can't do that, reads into the memory still work as usual either way.
+FOUNDATION_API bool        register_async_io_buffer(void* memory, u64 size);
+
+// Async reads get batched up and only handed off to the kernel here or once somebody awaits one of them, so kick a
+// bunch of reads and then submit them all at once. Before sleeping on a completion_event, always submit first. Returns
+// false if the kernel wouldn't take all of them (it's out of room and stayed that way), the rest stay queued for the
+// next submit.
+FOUNDATION_API bool        submit_async_io();
 
 FOUNDATION_API Result<FileStream,      FileError> create_file(const char* path, FileCreateFlags create_flags);
 FOUNDATION_API Result<FileStream,      FileError> open_file(const char* path, FileStreamFlags flags);
 FOUNDATION_API Result<AsyncFileStream, FileError> open_file_async(const char* path, FileStreamFlags flags);
 FOUNDATION_API void close_file(FileStream*      file_stream);
+// Reads on the file that are still in flight have to be awaited first.
 FOUNDATION_API void close_file(AsyncFileStream* file_stream);
 
-FOUNDATION_API DONT_IGNORE_RETURN bool write_file(FileStream file_stream, const void* src, u64 size);
 FOUNDATION_API DONT_IGNORE_RETURN bool write_file(FileStream file_stream, const void* src, u64 size);
 FOUNDATION_API DONT_IGNORE_RETURN bool read_file(FileStream file_stream, void* dst, u64 size, u64 offset);
-FOUNDATION_API DONT_IGNORE_RETURN Result<void, FileError> read_file(AsyncFileStream file_stream, AsyncFilePromise* out_promise, void* dst, u64 size, u64 offset);
+// Fails if the file ends before size bytes could be read. completion_event (optional) gets signaled once the read
+// finishes, so the caller can sleep on it instead of polling await_io.
+FOUNDATION_API DONT_IGNORE_RETURN Result<void, FileError> read_file(AsyncFileStream file_stream, AsyncFilePromise* out_promise, void* dst, u64 size, u64 offset, OsEvent* completion_event = nullptr);
+
+// Only a hint, starts pulling the range into the OS's file cache without waiting on it so that a read of it later on is
+// quicker. Does nothing where the OS doesn't have a way to do that for a file.
+FOUNDATION_API void prefetch_file_range(AsyncFileStream file_stream, u64 offset, u64 size);
+
+// Once this returns kAwaitCompleted or kAwaitFailed the read is done with and the promise gets reset, awaiting it (or
+// any copy of it) again after that is not allowed.
+FOUNDATION_API DONT_IGNORE_RETURN AwaitError await_io(AsyncFilePromise* promise, Option<u32> timeout_ms = None);
 
-FOUNDATION_API DONT_IGNORE_RETURN AwaitError await_io(const AsyncFilePromise& promise, Option<u32> timeout_ms = None);
+// Maps the first size bytes of the file, which has to be at least that big. Pages only get read in once they're touched.
+FOUNDATION_API Result<MappedFile, FileError> map_file(FileStream file_stream, u64 size);
+FOUNDATION_API void unmap_file(MappedFile* mapped_file);
 
 FOUNDATION_API DONT_IGNORE_RETURN bool file_exists(const char* path);
 FOUNDATION_API u64 get_file_size(FileStream file_stream);
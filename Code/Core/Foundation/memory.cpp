@@ -1,6 +1,8 @@
 #include "Core/Foundation/memory.h"
 #include "Core/Foundation/context.h"
+#include "Core/Foundation/threading.h"
 
+#if defined(_WIN32)
 #include <windows.h>
 
 void*
@@ -21,6 +23,12 @@ commit_pages(size_t size, void* addr)
   VirtualAlloc(addr, size, MEM_COMMIT, PAGE_READWRITE);
 }
 
+void
+commit_pages_on_numa_node(size_t size, void* addr, u32 numa_node)
+{
+  VirtualAllocExNuma(GetCurrentProcess(), addr, size, MEM_COMMIT, PAGE_READWRITE, numa_node);
+}
+
 void
 decommit_pages(size_t size, void* addr)
 {
@@ -32,6 +40,115 @@ free_pages(void* ptr)
 {
   VirtualFree(ptr, 0, MEM_RELEASE);
 }
+#else
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+
+// Node masks passed to mbind are this many bits
+static constexpr u32 kMaxNumaNodeCount = 1024;
+
+// munmap needs the size of the mapping but VirtualFree doesn't, so every mapping gets an extra committed page
+// in front of it that remembers how big it is. Everything after the header is still page aligned.
+struct PageMappingHeader
+{
+  size_t size = 0;
+};
+
+static void*
+map_pages(size_t size, void* addr, int protection)
+{
+  size_t mapping_size = ALIGN_POW2(size, (size_t)kPageSize) + kPageSize;
+  void*  mapping_addr = addr != nullptr ? (u8*)addr - kPageSize : nullptr;
+  int    flags        = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+  if (addr != nullptr)
+  {
+    // VirtualAlloc fails if the address is already in use instead of clobbering whatever is there
+    flags |= MAP_FIXED_NOREPLACE;
+  }
+
+  u8* mapping = (u8*)mmap(mapping_addr, mapping_size, protection, flags, -1, 0);
+  if (mapping == MAP_FAILED)
+  {
+    return nullptr;
+  }
+
+  if (protection == PROT_NONE && mprotect(mapping, kPageSize, PROT_READ | PROT_WRITE) != 0)
+  {
+    munmap(mapping, mapping_size);
+    return nullptr;
+  }
+
+  PageMappingHeader* header = (PageMappingHeader*)mapping;
+  header->size              = mapping_size;
+
+  return mapping + kPageSize;
+}
+
+void*
+reserve_commit_pages(size_t size, void* addr)
+{
+  return map_pages(size, addr, PROT_READ | PROT_WRITE);
+}
+
+void*
+reserve_pages(size_t size, void* addr)
+{
+  return map_pages(size, addr, PROT_NONE);
+}
+
+void
+commit_pages(size_t size, void* addr)
+{
+  // Anonymous pages are zero filled and only get backed by physical memory once they're touched, same as MEM_COMMIT.
+  uintptr_t start = (uintptr_t)addr & ~((uintptr_t)kPageSize - 1);
+  uintptr_t end   = ALIGN_POW2((uintptr_t)addr + size, (uintptr_t)kPageSize);
+  int       res   = mprotect((void*)start, end - start, PROT_READ | PROT_WRITE);
+  ASSERT_MSG_FATAL(res == 0, "Failed to commit 0x%llx bytes of pages at 0x%llx.", (u64)size, (u64)addr);
+}
+
+void
+commit_pages_on_numa_node(size_t size, void* addr, u32 numa_node)
+{
+  ASSERT_MSG_FATAL(numa_node < kMaxNumaNodeCount, "NUMA node %u is invalid, must be < %u", numa_node, kMaxNumaNodeCount);
+  commit_pages(size, addr);
+
+  // MPOL_PREFERRED falls back to other nodes instead of failing when this one runs out, like VirtualAllocExNuma.
+  // Nothing is backed yet, so the policy applies to every page as it gets touched.
+  uintptr_t start = (uintptr_t)addr & ~((uintptr_t)kPageSize - 1);
+  uintptr_t end   = ALIGN_POW2((uintptr_t)addr + size, (uintptr_t)kPageSize);
+  u64       nodes[kMaxNumaNodeCount / 64] = {0};
+  nodes[numa_node / 64] |= 1ULL << (numa_node % 64);
+  // maxnode is off by one in the kernel, it ignores the last bit
+  syscall(SYS_mbind, (void*)start, end - start, MPOL_PREFERRED, nodes, kMaxNumaNodeCount + 1, 0);
+}
+
+void
+decommit_pages(size_t size, void* addr)
+{
+  // MADV_DONTNEED gives the physical pages back right away and the next touch sees zeroes, which is what MEM_DECOMMIT does.
+  // Also take away access so that using decommitted memory faults like it would on Windows.
+  uintptr_t start = (uintptr_t)addr & ~((uintptr_t)kPageSize - 1);
+  uintptr_t end   = ALIGN_POW2((uintptr_t)addr + size, (uintptr_t)kPageSize);
+  madvise((void*)start, end - start, MADV_DONTNEED);
+  mprotect((void*)start, end - start, PROT_NONE);
+}
+
+void 
+free_pages(void* ptr)
+{
+  if (ptr == nullptr)
+  {
+    return;
+  }
+
+  u8*                mapping = (u8*)ptr - kPageSize;
+  PageMappingHeader* header  = (PageMappingHeader*)mapping;
+  munmap(mapping, header->size);
+}
+#endif
 
 void*
 linear_alloc(void* linear_allocator, size_t size, size_t alignment)
@@ -320,7 +437,7 @@ pop_stack(StackAllocator* self, size_t size)
   {
     size_t    new_commit_size = ALIGN_POW2(memory_usage, kPageSize);
     uintptr_t decommit_start  = self->memory + new_commit_size;
-    ASSERT_MSG_FATAL(new_commit_size > self->commit_size, "Something went wrong when calculating how much to decommit from stack allocator.");
+    ASSERT_MSG_FATAL(new_commit_size < self->commit_size, "Something went wrong when calculating how much to decommit from stack allocator.");
     size_t    decommit_size   = self->commit_size - new_commit_size;
     ASSERT_MSG_FATAL((decommit_size % kPageSize) == 0, "Decommit size is not a power of kPageSize, so something went wrong in stack allocator.");
     decommit_pages(decommit_size, (void*)decommit_start);
@@ -337,18 +454,176 @@ reset_stack(StackAllocator* self)
   pop_stack(self, usage);
 }
 
+static_assert(kAllocatorMaxThreads <= 64, "Released thread slots are tracked in a u64 bit mask.");
+
+static u32              g_AllocatorThreadCount = 0;
+// A bit for every slot below kAllocatorMaxThreads whose thread gave it back. Accessed atomically.
+static u64              g_AllocatorFreeSlots   = 0;
+static thread_local u32 g_AllocatorThreadSlot  = U32_MAX;
+
+u32
+get_allocator_thread_slot()
+{
+  if (g_AllocatorThreadSlot != U32_MAX)
+  {
+    return g_AllocatorThreadSlot;
+  }
+
+  // Slots that got given back go first, otherwise enough short lived threads would use up every slot
+  u64 free_slots = atomic_ref_load(&g_AllocatorFreeSlots, std::memory_order_relaxed);
+  while (free_slots != 0)
+  {
+    u32 slot = (u32)count_trailing_zeroes(free_slots);
+    // Acquire pairs with the release in release_allocator_thread_slot, so whatever the last thread left in the slot's per-thread state is visible
+    if (atomic_ref_compare_exchange(&g_AllocatorFreeSlots, &free_slots, free_slots & ~(1ULL << slot), std::memory_order_acquire))
+    {
+      g_AllocatorThreadSlot = slot;
+      return slot;
+    }
+  }
+
+  g_AllocatorThreadSlot = atomic_ref_fetch_add(&g_AllocatorThreadCount, 1, std::memory_order_relaxed);
+  return g_AllocatorThreadSlot;
+}
+
+void
+release_allocator_thread_slot()
+{
+  u32 slot              = g_AllocatorThreadSlot;
+  g_AllocatorThreadSlot = U32_MAX;
+
+  // Threads past kAllocatorMaxThreads all share the fall back paths, there's nothing to give back
+  if (slot >= kAllocatorMaxThreads)
+  {
+    return;
+  }
+
+  atomic_ref_fetch_or(&g_AllocatorFreeSlots, 1ULL << slot, std::memory_order_release);
+}
+
+static uintptr_t
+frame_allocator_bump(FrameAllocator* self, size_t size, size_t alignment)
+{
+  // Reserve enough to align whatever offset we get, that way it's only one atomic op no matter what
+  u64       offset       = atomic_ref_fetch_add(&self->offset, size + alignment - 1, std::memory_order_relaxed);
+  uintptr_t buffer_start = self->start + self->buffer_index * self->buffer_size;
+  uintptr_t memory_start = align_address(buffer_start + offset, alignment);
+
+  ASSERT_MSG_FATAL(
+    memory_start + size <= buffer_start + self->buffer_size,
+    "Frame allocator ran out of memory! Attempted to allocate 0x%llx "
+    "bytes from a frame allocator buffer of size 0x%llx that had 0x%llx "
+    "bytes used. Every frame only gets 1/%u of the allocator's memory, "
+    "either bump this allocator's memory size or figure out why it overflowed.",
+    size, self->buffer_size, offset, self->buffer_count
+  );
+
+  return memory_start;
+}
+
+void*
+frame_alloc(void* frame_allocator, size_t size, size_t alignment)
+{
+  FrameAllocator* self = (FrameAllocator*)frame_allocator;
+
+  alignment = MAX(alignment, 1);
+
+  // Big allocations would waste most of a chunk, so they go straight to the shared block
+  u32 slot = get_allocator_thread_slot();
+  if (slot >= kAllocatorMaxThreads || size + alignment > self->chunk_size / 4)
+  {
+    return (void*)frame_allocator_bump(self, size, alignment);
+  }
+
+  FrameAllocator::ThreadChunk* chunk = &self->chunks[slot];
+
+  u64 frame_id = atomic_ref_load(&self->frame_id, std::memory_order_relaxed);
+  if (chunk->frame_id == frame_id)
+  {
+    uintptr_t memory_start = align_address(chunk->pos, alignment);
+    if (memory_start + size <= chunk->end)
+    {
+      chunk->pos = memory_start + size;
+      return (void*)memory_start;
+    }
+  }
+
+  // Whatever is left at the end of the old chunk is just wasted until the buffer is reset
+  uintptr_t chunk_start  = frame_allocator_bump(self, self->chunk_size, kCacheLineSize);
+  uintptr_t memory_start = align_address(chunk_start, alignment);
+
+  chunk->pos      = memory_start + size;
+  chunk->end      = chunk_start + self->chunk_size;
+  chunk->frame_id = frame_id;
+
+  return (void*)memory_start;
+}
+
+FrameAllocator
+init_frame_allocator(void* memory, size_t size, u32 buffer_count, size_t chunk_size)
+{
+  ASSERT_MSG_FATAL(buffer_count > 0 && buffer_count <= kFrameAllocatorMaxBuffers, "Frame allocator buffer count %u is invalid, must be in [1, %u].", buffer_count, kFrameAllocatorMaxBuffers);
+  ASSERT_MSG_FATAL((chunk_size & (kCacheLineSize - 1)) == 0, "Frame allocator chunk size 0x%llx must be a multiple of the cache line size.", chunk_size);
+
+  FrameAllocator ret = {};
+  ret.start          = (uintptr_t)memory;
+  ret.buffer_size    = (size / buffer_count) & ~(size_t)(kCacheLineSize - 1);
+  ret.chunk_size     = chunk_size;
+  ret.buffer_count   = buffer_count;
+  ret.buffer_index   = 0;
+  ret.frame_id       = 0;
+  ret.offset         = 0;
+
+  ASSERT_MSG_FATAL(ret.buffer_size >= chunk_size, "Frame allocator buffers (0x%llx bytes) are smaller than a single thread chunk (0x%llx bytes).", ret.buffer_size, chunk_size);
+
+  return ret;
+}
+
+void
+reset_frame_allocator(FrameAllocator* self)
+{
+  u64 used = MIN(atomic_ref_load(&self->offset), (u64)self->buffer_size);
+
+  self->last_frame_used = used;
+  self->high_water_mark = MAX(self->high_water_mark, used);
+
+  // Bumping the frame ID invalidates every thread's chunk without having to touch them
+  self->buffer_index    = (self->buffer_index + 1) % self->buffer_count;
+  atomic_ref_store(&self->offset,   0);
+  atomic_ref_store(&self->frame_id, self->frame_id + 1);
+}
+
+u64
+frame_allocator_used(FrameAllocator* self)
+{
+  return MIN(atomic_ref_load(&self->offset, std::memory_order_relaxed), (u64)self->buffer_size);
+}
+
 void*
 os_alloc(void* os_allocator, size_t size, size_t alignment)
 {
   (void)os_allocator;
+#if defined(_WIN32)
   return _aligned_malloc(size, alignment);
+#else
+  void* ret = nullptr;
+  if (posix_memalign(&ret, MAX(alignment, sizeof(void*)), size) != 0)
+  {
+    return nullptr;
+  }
+  return ret;
+#endif
 }
 
 void 
 os_free(void* os_allocator, void* ptr)
 {
   (void)os_allocator;
+#if defined(_WIN32)
   _aligned_free(ptr);
+#else
+  free(ptr);
+#endif
 }
 
 OSAllocator
@@ -361,12 +636,3 @@ void destroy_os_allocator(OSAllocator* self)
 {
   UNREFERENCED_PARAMETER(self);
 }
-
-// TODO(bshihabi): Finish this method
-#if 0
-TlsfAllocator
-init_tlsf_allocator(AllocHeap heap, void* memory, u64 size)
-{
-  TlsfAllocator ret = {0};
-}
-#endif
\ No newline at end of file
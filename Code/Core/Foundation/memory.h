@@ -39,7 +39,7 @@ align_ptr(T* ptr, size_t alignment)
 inline void
 zero_memory(void* memory, size_t size)
 {
-  ZeroMemory(memory, size);
+  memset(memory, 0, size);
 }
 
 template <typename T>
@@ -53,6 +53,8 @@ zero_struct(T* data)
 FOUNDATION_API void* reserve_commit_pages(size_t size, void* addr = 0);
 FOUNDATION_API void* reserve_pages(size_t size, void* addr = 0);
 FOUNDATION_API void  commit_pages(size_t size, void* addr);
+// Same as commit_pages, but the physical pages come from numa_node (the OS's node number) whenever it has any left.
+FOUNDATION_API void  commit_pages_on_numa_node(size_t size, void* addr, u32 numa_node);
 FOUNDATION_API void  decommit_pages(size_t size, void* addr);
 FOUNDATION_API void  free_pages(void* ptr);
 
@@ -127,6 +129,14 @@ struct ReallocFreeHeap
     ret.allocator = allocator;
     return ret;
   }
+
+  explicit operator AllocHeap() const
+  { 
+    AllocHeap ret = {0};
+    ret.alloc_fn  = alloc_fn;
+    ret.allocator = allocator;
+    return ret;
+  }
 };
 
 #define HEAP_ALLOC(T, heap, count)( (T*)((AllocHeap)(heap)).alloc_fn(((AllocHeap)(heap)).allocator, (count) * sizeof(T), alignof(T)) )
@@ -208,6 +218,68 @@ FOUNDATION_API void* push_stack (StackAllocator* allocator, size_t size, size_t
 FOUNDATION_API void  pop_stack  (StackAllocator* allocator, size_t size);
 FOUNDATION_API void  reset_stack(StackAllocator* allocator);
 
+// Every thread that touches a thread-aware allocator gets a small unique index (in order of first use) so that allocators can keep
+// per-thread state in flat arrays. Threads past kAllocatorMaxThreads get fall back paths.
+static constexpr u32 kAllocatorMaxThreads = 64;
+FOUNDATION_API u32  get_allocator_thread_slot();
+// Gives the calling thread's slot back so the next thread to show up gets it, along with whatever per-thread state the allocators
+// kept in it. destroy_thread_context calls this, nothing that's thread-aware can get touched by the thread afterwards (unless it
+// wants a new slot).
+FOUNDATION_API void release_allocator_thread_slot();
+
+static constexpr u32 kFrameAllocatorMaxBuffers = 3;
+
+FOUNDATION_API void* frame_alloc(void* frame_allocator, size_t size, size_t alignment);
+// Thread-safe linear allocator for memory that only needs to live for a frame (or a couple).
+//
+// Every thread carves out its own chunk from the shared block with a single atomic bump and then allocates out of that
+// without touching any shared state, so threads don't contend with each other for small allocations.
+//
+// The block is split into buffer_count buffers, and every reset moves on to the next one. So memory allocated during
+// frame N is left untouched until frame N + buffer_count, which is what you want for anything the GPU reads while
+// the CPU records the next frame. It's up to the caller to have waited on the fence for that frame before resetting.
+struct FrameAllocator
+{
+  struct alignas(kCacheLineSize) ThreadChunk
+  {
+    uintptr_t pos      = 0x0;
+    uintptr_t end      = 0x0;
+    // The chunk is only valid if it was carved out during the current frame
+    u64       frame_id = U64_MAX;
+  };
+
+  uintptr_t   start           = 0x0;
+  size_t      buffer_size     = 0;
+  size_t      chunk_size      = 0;
+  u32         buffer_count    = 0;
+  u32         buffer_index    = 0;
+  u64         frame_id        = 0;
+
+  // Stats for sizing the allocator. Used includes the unused tails of thread chunks.
+  u64         last_frame_used = 0;
+  u64         high_water_mark = 0;
+
+  // Offset into the current buffer, the only thing threads actually contend on
+  alignas(kCacheLineSize) u64 offset = 0;
+
+  // Threads past kAllocatorMaxThreads just allocate straight out of the shared block, which is still thread-safe, just more contended
+  ThreadChunk chunks[kAllocatorMaxThreads];
+
+  operator AllocHeap()
+  {
+    AllocHeap ret = {0};
+    ret.alloc_fn  = &frame_alloc;
+    ret.allocator = this;
+    return ret;
+  }
+};
+// size is split evenly between the buffers, so a frame only gets to allocate size / buffer_count bytes.
+FOUNDATION_API FrameAllocator init_frame_allocator (void* memory, size_t size, u32 buffer_count = 1, size_t chunk_size = KiB(64));
+// Moves on to the next buffer. Must not be called while other threads are allocating from the allocator.
+FOUNDATION_API void           reset_frame_allocator(FrameAllocator* frame_allocator);
+// How much of the current buffer has been used so far this frame.
+FOUNDATION_API u64            frame_allocator_used (FrameAllocator* frame_allocator);
+
 
 FOUNDATION_API void* os_alloc(void* os_allocator, size_t size, size_t alignment);
 FOUNDATION_API void  os_free (void* os_allocator, void* ptr);
@@ -228,40 +300,10 @@ struct OSAllocator
 FOUNDATION_API OSAllocator init_os_allocator   ();
 FOUNDATION_API void        destroy_os_allocator(OSAllocator* allocator);
 
-struct TlsfAllocator
-{
-  struct BinNode
-  {
-    u64 offset         = 0;
-    u64 size           = 0;
-
-    u32 bin_prev       = 0;
-    u32 bin_next       = 0;
-    u32 neighbor_next  = 0;
-    u32 neighbor_prev  = 0;
-  };
-
-  u64      size        = 0;
-  void*    memory      = 0;
-
-  u32      max_allocs  = 0;
-  BinNode* nodes       = nullptr;
-  u32*     free_stack  = nullptr;
-  u32      free_offset = 0;
-};
-
-FOUNDATION_API TlsfAllocator init_tlsf_allocator(AllocHeap heap, void* memory, u64 size);
-FOUNDATION_API void* tlsf_alloc(void* tlsf_allocator, u64 size, u32 alignment);
-FOUNDATION_API void* tlsf_free (void* tlsf_allocator, void* ptr);
-
 #if 0
 struct MultiLevelPoolAllocator
 {
 };
-
-struct TlsfAllocator
-{
-};
 #endif
 
 
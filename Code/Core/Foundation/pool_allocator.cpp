@@ -0,0 +1,270 @@
+#include "Core/Foundation/pool_allocator.h"
+
+static constexpr u64 kPoolDepotIndexMask = 0xFFFFFFFF;
+
+static u64
+pool_depot_pack(u32 magazine, u64 tag)
+{
+  return (tag << 32) | (u64)magazine;
+}
+
+static void
+pool_depot_push(ConcurrentPoolAllocator* self, u64* depot, u32 magazine)
+{
+  u64 head = atomic_ref_load(depot, std::memory_order_relaxed);
+  for (;;)
+  {
+    atomic_ref_store(&self->magazines[magazine].next, (u32)(head & kPoolDepotIndexMask), std::memory_order_relaxed);
+    // Release so that whoever pops the magazine sees its contents
+    if (atomic_ref_compare_exchange(depot, &head, pool_depot_pack(magazine, (head >> 32) + 1), std::memory_order_release))
+    {
+      return;
+    }
+  }
+}
+
+static u32
+pool_depot_pop(ConcurrentPoolAllocator* self, u64* depot)
+{
+  u64 head = atomic_ref_load(depot, std::memory_order_acquire);
+  for (;;)
+  {
+    u32 magazine = (u32)(head & kPoolDepotIndexMask);
+    if (magazine == kPoolNullIndex)
+    {
+      return kPoolNullIndex;
+    }
+
+    // If someone else pops this magazine and pushes it back before we get to the compare exchange, next could be
+    // stale. The tag will have changed in that case so the compare exchange fails and we try again.
+    u32 next = atomic_ref_load(&self->magazines[magazine].next, std::memory_order_relaxed);
+    if (atomic_ref_compare_exchange(depot, &head, pool_depot_pack(next, (head >> 32) + 1), std::memory_order_acquire))
+    {
+      return magazine;
+    }
+  }
+}
+
+static u32
+pool_block_index(ConcurrentPoolAllocator* self, void* ptr)
+{
+  uintptr_t offset = (uintptr_t)ptr - (uintptr_t)self->memory;
+  ASSERT_MSG_FATAL((uintptr_t)ptr >= (uintptr_t)self->memory && offset < self->block_count * self->block_size, "Attempted to free 0x%llx which was not allocated from this pool.", (u64)ptr);
+  ASSERT_MSG_FATAL(offset % self->block_size == 0, "Attempted to free 0x%llx which is not the start of a pool block.", (u64)ptr);
+
+  return (u32)(offset / self->block_size);
+}
+
+static void*
+pool_take_block(ConcurrentPoolAllocator* self, ConcurrentPoolAllocator::Magazine* magazine)
+{
+  u32 block = magazine->blocks[--magazine->count];
+  u8* ret   = self->memory + block * self->block_size;
+
+#ifdef DEBUG
+  PoolBlockState prev_state = (PoolBlockState)atomic_ref_exchange(&self->block_states[block], (u8)kPoolBlockAllocated);
+  ASSERT_MSG_FATAL(prev_state == kPoolBlockFree, "Pool block 0x%llx was handed out while still allocated, the pool is corrupt.", (u64)ret);
+
+  for (size_t i = 0; i < self->block_size; i++)
+  {
+    ASSERT_MSG_FATAL(ret[i] == kPoolFreePoison, "Pool block 0x%llx was written to at offset %llu after it was freed.", (u64)ret, (u64)i);
+  }
+  memset(ret, kPoolAllocPoison, self->block_size);
+#endif
+
+  return ret;
+}
+
+static void*
+pool_alloc_from_cache(ConcurrentPoolAllocator* self, ConcurrentPoolAllocator::ThreadCache* cache)
+{
+  using Magazine = ConcurrentPoolAllocator::Magazine;
+
+  if (cache->loaded != kPoolNullIndex && self->magazines[cache->loaded].count > 0)
+  {
+    return pool_take_block(self, &self->magazines[cache->loaded]);
+  }
+
+  if (cache->previous != kPoolNullIndex && self->magazines[cache->previous].count > 0)
+  {
+    u32 tmp         = cache->loaded;
+    cache->loaded   = cache->previous;
+    cache->previous = tmp;
+    return pool_take_block(self, &self->magazines[cache->loaded]);
+  }
+
+  // Both of our magazines are empty, trade one in for a full one
+  u32 full = pool_depot_pop(self, &self->full_magazines);
+  if (full == kPoolNullIndex)
+  {
+    return nullptr;
+  }
+
+  if (cache->loaded != kPoolNullIndex)
+  {
+    pool_depot_push(self, &self->empty_magazines, cache->loaded);
+  }
+  cache->loaded = full;
+
+  Magazine* magazine = &self->magazines[full];
+  ASSERT(magazine->count > 0);
+  return pool_take_block(self, magazine);
+}
+
+static void
+pool_free_to_cache(ConcurrentPoolAllocator* self, ConcurrentPoolAllocator::ThreadCache* cache, u32 block)
+{
+  if (cache->loaded == kPoolNullIndex || self->magazines[cache->loaded].count == kPoolMagazineSize)
+  {
+    if (cache->previous != kPoolNullIndex && self->magazines[cache->previous].count < kPoolMagazineSize)
+    {
+      u32 tmp         = cache->loaded;
+      cache->loaded   = cache->previous;
+      cache->previous = tmp;
+    }
+    else
+    {
+      // Both of our magazines are full, trade one in for an empty one
+      // NOTE(bshihabi): There are always enough magazines for this to succeed, see init_concurrent_pool_allocator
+      u32 empty = pool_depot_pop(self, &self->empty_magazines);
+      ASSERT_MSG_FATAL(empty != kPoolNullIndex, "Concurrent pool ran out of empty magazines, this is a bug in the pool.");
+
+      if (cache->loaded != kPoolNullIndex)
+      {
+        if (cache->previous == kPoolNullIndex)
+        {
+          cache->previous = cache->loaded;
+        }
+        else
+        {
+          pool_depot_push(self, &self->full_magazines, cache->loaded);
+        }
+      }
+      cache->loaded = empty;
+    }
+  }
+
+  ConcurrentPoolAllocator::Magazine* magazine = &self->magazines[cache->loaded];
+  magazine->blocks[magazine->count++]         = block;
+}
+
+void*
+concurrent_pool_alloc(void* concurrent_pool_allocator, size_t size, size_t alignment)
+{
+  ConcurrentPoolAllocator* self = (ConcurrentPoolAllocator*)concurrent_pool_allocator;
+  ASSERT_MSG_FATAL(size <= self->block_size, "Attempted to allocate %llu bytes from a pool with a block size of %llu.", (u64)size, (u64)self->block_size);
+  ASSERT_MSG_FATAL(((uintptr_t)self->memory | self->block_size) % alignment == 0, "Pool blocks are not aligned to %llu.", (u64)alignment);
+
+  u32 slot = get_allocator_thread_slot();
+  if (slot < kAllocatorMaxThreads)
+  {
+    return pool_alloc_from_cache(self, &self->thread_caches[slot]);
+  }
+
+  spin_acquire(&self->shared_cache_lock);
+  defer { spin_release(&self->shared_cache_lock); };
+  return pool_alloc_from_cache(self, &self->thread_caches[kAllocatorMaxThreads]);
+}
+
+void
+concurrent_pool_free(void* concurrent_pool_allocator, void* ptr)
+{
+  ConcurrentPoolAllocator* self = (ConcurrentPoolAllocator*)concurrent_pool_allocator;
+
+  if (ptr == nullptr)
+  {
+    return;
+  }
+
+  u32 block = pool_block_index(self, ptr);
+
+#ifdef DEBUG
+  PoolBlockState prev_state = (PoolBlockState)atomic_ref_exchange(&self->block_states[block], (u8)kPoolBlockFree);
+  ASSERT_MSG_FATAL(prev_state == kPoolBlockAllocated, "Double free of pool block 0x%llx.", (u64)ptr);
+  memset(ptr, kPoolFreePoison, self->block_size);
+#endif
+
+  u32 slot = get_allocator_thread_slot();
+  if (slot < kAllocatorMaxThreads)
+  {
+    pool_free_to_cache(self, &self->thread_caches[slot], block);
+    return;
+  }
+
+  spin_acquire(&self->shared_cache_lock);
+  defer { spin_release(&self->shared_cache_lock); };
+  pool_free_to_cache(self, &self->thread_caches[kAllocatorMaxThreads], block);
+}
+
+ConcurrentPoolAllocator
+init_concurrent_pool_allocator(AllocHeap heap, u32 block_count, size_t block_size, size_t alignment)
+{
+  ASSERT_MSG_FATAL(block_count > 0 && block_count < kPoolNullIndex, "Invalid concurrent pool block count %u.", block_count);
+  ASSERT_MSG_FATAL(is_pow2(alignment), "Concurrent pool alignment %llu is not a power of 2.", (u64)alignment);
+
+  ConcurrentPoolAllocator ret;
+  ret.block_size        = ALIGN_POW2(MAX(block_size, (size_t)1), alignment);
+  ret.block_count       = block_count;
+  ret.memory            = HEAP_ALLOC_ALIGNED(heap, ret.block_size * block_count, alignment);
+  ret.shared_cache_lock = init_spin_lock();
+
+  // Every thread holds at most 2 magazines, plus 1 more while trading one in at the depot. The full stack only ever
+  // gets full magazines pushed onto it (other than the one partial magazine from here), so this is always enough
+  // for there to be an empty magazine whenever a thread needs one.
+  u32 full_magazine_count = (block_count + kPoolMagazineSize - 1) / kPoolMagazineSize;
+  ret.magazine_count      = full_magazine_count + 3 * (kAllocatorMaxThreads + 1);
+  ret.magazines           = HEAP_ALLOC(ConcurrentPoolAllocator::Magazine, heap, ret.magazine_count);
+
+  ret.thread_caches       = HEAP_ALLOC(ConcurrentPoolAllocator::ThreadCache, heap, kAllocatorMaxThreads + 1);
+  for (u32 i = 0; i < kAllocatorMaxThreads + 1; i++)
+  {
+    ret.thread_caches[i] = ConcurrentPoolAllocator::ThreadCache{};
+  }
+
+  ret.full_magazines      = pool_depot_pack(kPoolNullIndex, 0);
+  ret.empty_magazines     = pool_depot_pack(kPoolNullIndex, 0);
+
+  // Fill the magazines back to front so that the first blocks handed out are at the start of the pool
+  u32 next_block = 0;
+  for (u32 imagazine = full_magazine_count; imagazine-- > 0;)
+  {
+    ConcurrentPoolAllocator::Magazine* magazine = &ret.magazines[imagazine];
+    u32 first_block = imagazine * kPoolMagazineSize;
+    magazine->count = MIN(kPoolMagazineSize, block_count - first_block);
+    for (u32 i = 0; i < magazine->count; i++)
+    {
+      // Blocks get taken off the end of a magazine
+      magazine->blocks[i] = first_block + magazine->count - 1 - i;
+    }
+    next_block += magazine->count;
+  }
+  ASSERT(next_block == block_count);
+
+  for (u32 imagazine = full_magazine_count; imagazine-- > 0;)
+  {
+    ret.magazines[imagazine].next = (u32)(ret.full_magazines & kPoolDepotIndexMask);
+    ret.full_magazines            = pool_depot_pack(imagazine, 0);
+  }
+
+  for (u32 imagazine = full_magazine_count; imagazine < ret.magazine_count; imagazine++)
+  {
+    ret.magazines[imagazine].count = 0;
+    ret.magazines[imagazine].next  = (u32)(ret.empty_magazines & kPoolDepotIndexMask);
+    ret.empty_magazines            = pool_depot_pack(imagazine, 0);
+  }
+
+#ifdef DEBUG
+  ret.block_states = HEAP_ALLOC(u8, heap, block_count);
+  memset(ret.block_states, kPoolBlockFree, block_count);
+  memset(ret.memory, kPoolFreePoison, ret.block_size * block_count);
+#endif
+
+  return ret;
+}
+
+void
+destroy_concurrent_pool_allocator(ConcurrentPoolAllocator* self)
+{
+  // Everything came out of an AllocHeap, nothing to give back
+  zero_memory(self, sizeof(ConcurrentPoolAllocator));
+}
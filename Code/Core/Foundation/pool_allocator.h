@@ -1,8 +1,10 @@
 #pragma once
 #include "Core/Foundation/types.h"
 #include "Core/Foundation/memory.h"
+#include "Core/Foundation/threading.h"
 
 
+// NOTE(bshihabi): Pool is not thread-safe, use ConcurrentPool if more than one thread needs it.
 template <typename T>
 struct Pool
 {
@@ -16,6 +18,7 @@ struct Pool
   PoolItem* memory       = nullptr;
   u32       size       = 0;
   u32       first_free = 0;
+  u32       free_count = 0;
 
 };
 
@@ -52,6 +55,7 @@ init_pool(AllocHeap heap, u32 size)
 
   ret.size       = size;
   ret.first_free = 0;
+  ret.free_count = size;
 
   return ret;
 }
@@ -59,12 +63,13 @@ init_pool(AllocHeap heap, u32 size)
 template <typename T>
 T* pool_alloc(Pool<T>* pool)
 {
-  ASSERT(pool->first_free < pool->size);
+  ASSERT(pool->first_free < pool->size && pool->free_count > 0);
 
   auto* ret        = pool->memory + pool->first_free;
 
   pool->first_free = ret->next_free;
 
+  pool->free_count--;
   zero_memory(ret, sizeof(*ret));
 
   return &ret->value;
@@ -73,16 +78,145 @@ T* pool_alloc(Pool<T>* pool)
 template <typename T>
 void pool_free(Pool<T>* pool, T* memory)
 {
-  ASSERT(pool->memory <= memory && pool->memory + pool->size > memory);
   using PoolItem = typename Pool<T>::PoolItem;
 
   auto* item       = (PoolItem*)memory;
+  ASSERT(pool->memory <= item && pool->memory + pool->size > item);
+  // More frees than there are items means something got freed twice
+  ASSERT_MSG_FATAL(pool->free_count < pool->size, "Pool item 0x%llx was freed but every item in the pool is already free, this is a double free.", (u64)memory);
+
   u32   idx        = (u32)(item - pool->memory);
 
+  zero_memory(memory, sizeof(T));
+
   item->next_free = pool->first_free;
   pool->first_free = idx;
 
 
   pool->free_count++;
-  zero_memory(memory, sizeof(T));
+}
+
+// How many block indices a magazine holds. Threads only go to the depot once every kPoolMagazineSize allocs/frees.
+static constexpr u32 kPoolMagazineSize = 32;
+static constexpr u32 kPoolNullIndex    = U32_MAX;
+
+// Debug builds fill freed blocks with kPoolFreePoison and check it's still intact when the block gets handed out
+// again, which catches writes after free. Freshly allocated blocks are filled with kPoolAllocPoison.
+static constexpr u8  kPoolFreePoison   = 0xDD;
+static constexpr u8  kPoolAllocPoison  = 0xCD;
+
+enum PoolBlockState : u8
+{
+  kPoolBlockFree,
+  kPoolBlockAllocated,
+};
+
+FOUNDATION_API void* concurrent_pool_alloc(void* concurrent_pool_allocator, size_t size, size_t alignment);
+FOUNDATION_API void  concurrent_pool_free (void* concurrent_pool_allocator, void* ptr);
+
+// Thread-safe pool of fixed size blocks.
+//
+// Free blocks live in magazines, small LIFO stacks of block indices. Every thread keeps two magazines of its own and
+// allocs/frees out of them without touching any shared state. Only when both are empty (alloc) or full (free) does
+// it go to the depot, two lock-free stacks of full and empty magazines, to trade one in. Keeping two magazines around
+// means a thread alternating between alloc and free right at a magazine boundary doesn't bounce off the depot.
+//
+// Blocks aren't intrusively linked, so debug builds can poison the entire block and track per-block state to catch
+// double frees and writes after free.
+//
+// NOTE(bshihabi): Blocks sitting in a thread's magazines are only usable by that thread. So the pool can run dry
+// while other threads are still holding up to 2 * kPoolMagazineSize free blocks each, leave some headroom.
+struct ConcurrentPoolAllocator
+{
+  struct Magazine
+  {
+    u32 count = 0;
+    // Link in the depot stacks. Accessed atomically, a thread that lost the race to pop this magazine can still read it.
+    u32 next  = kPoolNullIndex;
+    u32 blocks[kPoolMagazineSize];
+  };
+
+  struct alignas(kCacheLineSize) ThreadCache
+  {
+    // The magazine we alloc from and free into
+    u32 loaded   = kPoolNullIndex;
+    u32 previous = kPoolNullIndex;
+  };
+
+  u8*          memory            = nullptr;
+  size_t       block_size        = 0;
+  u32          block_count       = 0;
+
+  Magazine*    magazines         = nullptr;
+  u32          magazine_count    = 0;
+
+  // One per thread slot, plus one shared by every thread past kAllocatorMaxThreads which is protected by shared_cache_lock
+  ThreadCache* thread_caches     = nullptr;
+  SpinLock     shared_cache_lock;
+
+  // PoolBlockState per block, only tracked in debug builds
+  u8*          block_states      = nullptr;
+
+  // The depot. Both are lock-free stacks of magazine indices, the top 32 bits are a tag that gets bumped on every
+  // push and pop so that a magazine being popped and pushed back in between doesn't confuse a compare exchange (ABA).
+  alignas(kCacheLineSize) u64 full_magazines  = 0;
+  alignas(kCacheLineSize) u64 empty_magazines = 0;
+
+  operator FreeHeap()
+  {
+    FreeHeap ret  = {0};
+    ret.alloc_fn  = &concurrent_pool_alloc;
+    ret.free_fn   = &concurrent_pool_free;
+    ret.allocator = this;
+    return ret;
+  }
+};
+
+// Bookkeeping and the blocks themselves all come out of heap.
+FOUNDATION_API ConcurrentPoolAllocator init_concurrent_pool_allocator   (AllocHeap heap, u32 block_count, size_t block_size, size_t alignment);
+FOUNDATION_API void                    destroy_concurrent_pool_allocator(ConcurrentPoolAllocator* allocator);
+
+// Typed version, like Pool but safe to alloc and free from any thread.
+template <typename T>
+struct ConcurrentPool
+{
+  ConcurrentPoolAllocator allocator;
+};
+
+template <typename T>
+inline ConcurrentPool<T>
+init_concurrent_pool(AllocHeap heap, u32 size)
+{
+  ASSERT(size > 0);
+
+  ConcurrentPool<T> ret;
+  ret.allocator = init_concurrent_pool_allocator(heap, size, sizeof(T), alignof(T));
+  return ret;
+}
+
+template <typename T>
+inline void
+destroy_concurrent_pool(ConcurrentPool<T>* pool)
+{
+  destroy_concurrent_pool_allocator(&pool->allocator);
+}
+
+// Returns nullptr if the pool is out of blocks. Zeroed, same as pool_alloc.
+template <typename T>
+inline T*
+concurrent_pool_alloc(ConcurrentPool<T>* pool)
+{
+  T* ret = (T*)concurrent_pool_alloc(&pool->allocator, sizeof(T), alignof(T));
+  if (ret != nullptr)
+  {
+    zero_memory(ret, sizeof(T));
+  }
+  return ret;
+}
+
+template <typename T>
+inline void
+concurrent_pool_free(ConcurrentPool<T>* pool, T* memory)
+{
+  concurrent_pool_free(&pool->allocator, (void*)memory);
 }
@@ -0,0 +1,260 @@
+#include "Core/Foundation/reclamation.h"
+
+// Hazards get copied into this before collecting so that every retired pointer doesn't re-scan every thread
+static constexpr u32 kReclaimMaxHazards = kAllocatorMaxThreads * kReclaimHazardCount;
+
+ReclaimDomain
+init_reclaim_domain(FreeHeap metadata_heap, bool hazard_pointers)
+{
+  ReclaimDomain ret   = {};
+  ret.metadata_heap   = metadata_heap;
+  ret.hazard_pointers = hazard_pointers;
+  ret.threads         = HEAP_ALLOC(ReclaimThread, (AllocHeap)metadata_heap, kAllocatorMaxThreads);
+  for (u32 ithread = 0; ithread < kAllocatorMaxThreads; ithread++)
+  {
+    ret.threads[ithread] = ReclaimThread{};
+  }
+
+  return ret;
+}
+
+void
+destroy_reclaim_domain(ReclaimDomain* domain)
+{
+  for (u32 ithread = 0; ithread < domain->thread_count; ithread++)
+  {
+    ReclaimThread* thread = &domain->threads[ithread];
+    ASSERT_MSG_FATAL(thread->nesting == 0, "Reclaim domain was destroyed while thread slot %u was still inside of a critical section.", ithread);
+
+    for (u32 iretired = 0; iretired < thread->limbo_count; iretired++)
+    {
+      HEAP_FREE(thread->limbo[iretired].heap, thread->limbo[iretired].ptr);
+    }
+
+    if (thread->limbo != nullptr)
+    {
+      HEAP_FREE(domain->metadata_heap, thread->limbo);
+    }
+  }
+
+  HEAP_FREE(domain->metadata_heap, domain->threads);
+  zero_memory(domain, sizeof(ReclaimDomain));
+}
+
+static ReclaimThread*
+get_reclaim_thread(ReclaimDomain* domain)
+{
+  u32 slot = get_allocator_thread_slot();
+  ASSERT_MSG_FATAL(slot < kAllocatorMaxThreads, "Thread slot %u can't use a reclaim domain, only %u threads at once get one.", slot, kAllocatorMaxThreads);
+
+  // Scans only look at threads below thread_count, this has to be bumped before the thread ever publishes an epoch or hazard
+  u32 thread_count = atomic_ref_load(&domain->thread_count, std::memory_order_relaxed);
+  while (slot >= thread_count && !atomic_ref_compare_exchange(&domain->thread_count, &thread_count, slot + 1))
+  {
+  }
+
+  return &domain->threads[slot];
+}
+
+void
+reclaim_enter(ReclaimDomain* domain)
+{
+  ReclaimThread* thread = get_reclaim_thread(domain);
+  if (thread->nesting++ != 0)
+  {
+    return;
+  }
+
+  // The exchange is a full barrier, nothing we read in the critical section can get reordered before the epoch is published
+  u64 epoch = atomic_ref_load(&domain->global_epoch);
+  atomic_ref_exchange(&thread->epoch, epoch);
+}
+
+void
+reclaim_exit(ReclaimDomain* domain)
+{
+  ReclaimThread* thread = get_reclaim_thread(domain);
+  ASSERT_MSG_FATAL(thread->nesting > 0, "reclaim_exit without a matching reclaim_enter.");
+  if (--thread->nesting != 0)
+  {
+    return;
+  }
+
+  // Release so that everything we read happens before whoever sees us leave frees it
+  atomic_ref_store(&thread->epoch, kReclaimEpochInactive, std::memory_order_release);
+}
+
+// The epoch can only move forward once every thread in a critical section has seen the current one.
+static void
+try_advance_epoch(ReclaimDomain* domain)
+{
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  u64 epoch        = atomic_ref_load(&domain->global_epoch, std::memory_order_relaxed);
+  u32 thread_count = atomic_ref_load(&domain->thread_count, std::memory_order_relaxed);
+  for (u32 ithread = 0; ithread < thread_count; ithread++)
+  {
+    u64 thread_epoch = atomic_ref_load(&domain->threads[ithread].epoch, std::memory_order_acquire);
+    if (thread_epoch != kReclaimEpochInactive && thread_epoch != epoch)
+    {
+      return;
+    }
+  }
+
+  // Somebody else moving it first is just as good
+  atomic_ref_compare_exchange_strong(&domain->global_epoch, &epoch, epoch + 1);
+}
+
+static u32
+gather_hazards(ReclaimDomain* domain, void** hazards)
+{
+  // Pairs with the exchange in _reclaim_protect. Either we see the hazard, or the protecting thread sees that
+  // the pointer got unlinked and tries again.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  u32 ret          = 0;
+  u32 thread_count = atomic_ref_load(&domain->thread_count, std::memory_order_relaxed);
+  for (u32 ithread = 0; ithread < thread_count; ithread++)
+  {
+    for (u32 ihazard = 0; ihazard < kReclaimHazardCount; ihazard++)
+    {
+      void* hazard = atomic_ref_load(&domain->threads[ithread].hazards[ihazard], std::memory_order_acquire);
+      if (hazard != nullptr)
+      {
+        hazards[ret++] = hazard;
+      }
+    }
+  }
+
+  return ret;
+}
+
+static bool
+is_hazard(void* const* hazards, u32 hazard_count, void* ptr)
+{
+  for (u32 ihazard = 0; ihazard < hazard_count; ihazard++)
+  {
+    if (hazards[ihazard] == ptr)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static u32
+collect_limbo(ReclaimDomain* domain, ReclaimThread* thread)
+{
+  try_advance_epoch(domain);
+
+  u64 epoch = atomic_ref_load(&domain->global_epoch, std::memory_order_acquire);
+
+  void* hazards[kReclaimMaxHazards];
+  u32   hazard_count = domain->hazard_pointers ? gather_hazards(domain, hazards) : 0;
+
+  u32 freed = 0;
+  u32 kept  = 0;
+  for (u32 iretired = 0; iretired < thread->limbo_count; iretired++)
+  {
+    RetiredPtr retired = thread->limbo[iretired];
+    if (retired.epoch + 2 <= epoch && !is_hazard(hazards, hazard_count, retired.ptr))
+    {
+      HEAP_FREE(retired.heap, retired.ptr);
+      freed++;
+    }
+    else
+    {
+      thread->limbo[kept++] = retired;
+    }
+  }
+  thread->limbo_count = kept;
+
+  return freed;
+}
+
+void
+reclaim_retire(ReclaimDomain* domain, void* ptr, FreeHeap heap)
+{
+  ASSERT(ptr != nullptr);
+
+  ReclaimThread* thread = get_reclaim_thread(domain);
+  if (thread->limbo_count == thread->limbo_capacity)
+  {
+    u32         capacity = MAX(thread->limbo_capacity * 2, kReclaimCollectInterval * 2);
+    RetiredPtr* limbo    = HEAP_ALLOC(RetiredPtr, (AllocHeap)domain->metadata_heap, capacity);
+    if (thread->limbo != nullptr)
+    {
+      memcpy(limbo, thread->limbo, sizeof(RetiredPtr) * thread->limbo_count);
+      HEAP_FREE(domain->metadata_heap, thread->limbo);
+    }
+
+    thread->limbo          = limbo;
+    thread->limbo_capacity = capacity;
+  }
+
+  RetiredPtr* retired = &thread->limbo[thread->limbo_count++];
+  retired->ptr        = ptr;
+  retired->heap       = heap;
+  // Has to be read after ptr got unlinked, which the caller did before calling this
+  retired->epoch      = atomic_ref_load(&domain->global_epoch);
+
+  if (++thread->retire_count >= kReclaimCollectInterval)
+  {
+    thread->retire_count = 0;
+    collect_limbo(domain, thread);
+  }
+}
+
+u32
+reclaim_collect(ReclaimDomain* domain)
+{
+  return collect_limbo(domain, get_reclaim_thread(domain));
+}
+
+void
+reclaim_flush(ReclaimDomain* domain)
+{
+  ReclaimThread* thread = get_reclaim_thread(domain);
+  ASSERT_MSG_FATAL(thread->nesting == 0, "reclaim_flush from inside of a critical section would wait on itself forever.");
+
+  while (thread->limbo_count > 0)
+  {
+    collect_limbo(domain, thread);
+    if (thread->limbo_count > 0)
+    {
+      yield_current_thread();
+    }
+  }
+}
+
+void*
+_reclaim_protect(ReclaimDomain* domain, u32 index, void* const* src)
+{
+  ASSERT_MSG_FATAL(domain->hazard_pointers, "reclaim_protect needs a domain that was initialized with hazard pointers.");
+  ASSERT(index < kReclaimHazardCount);
+
+  ReclaimThread* thread = get_reclaim_thread(domain);
+  void*          ptr    = atomic_ref_load((void**)src, std::memory_order_acquire);
+  for (;;)
+  {
+    // If it's still there after publishing the hazard it hasn't been retired yet, and every collect from here on sees the hazard
+    atomic_ref_exchange(&thread->hazards[index], ptr);
+
+    void* current = atomic_ref_load((void**)src);
+    if (current == ptr)
+    {
+      return ptr;
+    }
+    ptr = current;
+  }
+}
+
+void
+reclaim_clear_hazard(ReclaimDomain* domain, u32 index)
+{
+  ASSERT(index < kReclaimHazardCount);
+
+  ReclaimThread* thread = get_reclaim_thread(domain);
+  atomic_ref_store(&thread->hazards[index], (void*)nullptr, std::memory_order_release);
+}
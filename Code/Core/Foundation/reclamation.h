@@ -0,0 +1,106 @@
+#pragma once
+#include "Core/Foundation/types.h"
+#include "Core/Foundation/memory.h"
+#include "Core/Foundation/threading.h"
+
+// Safe memory reclamation for lock-free data structures: something that got unlinked can't be freed right away
+// since other threads might still be reading it, so it gets retired instead and freed once nobody can be.
+//
+// Epoch-based reclamation (Fraser, "Practical lock-freedom") is the default. Readers wrap their accesses in
+// reclaim_enter/reclaim_exit, which just publishes the global epoch they saw. The global epoch only moves forward
+// once every thread inside of a critical section has seen the current one, so anything retired at epoch e is
+// unreachable by everyone once the global epoch hits e + 2. Reads are about as cheap as it gets, but a reader that
+// stays inside of a critical section for a long time holds up every free in the domain.
+//
+// That's what the hazard pointer mode (Michael, "Hazard Pointers") is for. A thread can protect a handful of
+// individual pointers with reclaim_protect and hold on to them for as long as it wants without being inside of a
+// critical section. Retired memory that's still protected just stays in limbo until it isn't anymore.
+//
+//   reclaim_enter(&domain);
+//   defer { reclaim_exit(&domain); };
+//   Node* node = atomic_ref_load(&list->head);
+//   ...
+//
+//   // After unlinking node
+//   reclaim_retire(&domain, node, node_heap);
+//
+// NOTE(bshihabi): Threads are tracked by get_allocator_thread_slot, so only kAllocatorMaxThreads threads can use a domain
+// at once. A thread that exits gives its slot to the next one, which inherits its limbo list, so it has to be outside of
+// every critical section and should clear its hazard pointers before it goes.
+
+static constexpr u64 kReclaimEpochInactive   = 0;
+// Hazard pointers each thread gets per domain
+static constexpr u32 kReclaimHazardCount     = 4;
+// Every this many retires, the retiring thread tries to move the epoch forward and free whatever it can
+static constexpr u32 kReclaimCollectInterval = 64;
+
+struct RetiredPtr
+{
+  void*    ptr   = nullptr;
+  FreeHeap heap;
+  // The global epoch when this was retired
+  u64      epoch = 0;
+};
+
+struct alignas(kCacheLineSize) ReclaimThread
+{
+  // The global epoch the thread saw when it entered its critical section, kReclaimEpochInactive outside of one. Accessed atomically.
+  u64         epoch          = kReclaimEpochInactive;
+  // Accessed atomically
+  void*       hazards[kReclaimHazardCount] = {0};
+
+  // Everything past here is only ever touched by the owning thread
+  u32         nesting        = 0;
+  u32         retire_count   = 0;
+
+  // Limbo list, everything this thread retired that can't be freed yet. Always sorted by epoch since the global epoch never goes backwards.
+  RetiredPtr* limbo          = nullptr;
+  u32         limbo_count    = 0;
+  u32         limbo_capacity = 0;
+};
+
+struct ReclaimDomain
+{
+  // Starts at 1 so that it's never kReclaimEpochInactive. Accessed atomically.
+  alignas(kCacheLineSize) u64 global_epoch = 1;
+
+  // One past the highest thread slot that has used this domain, scans stop here. Accessed atomically.
+  u32            thread_count    = 0;
+  bool           hazard_pointers = false;
+
+  // Where the thread records and limbo lists come from
+  FreeHeap       metadata_heap;
+  ReclaimThread* threads         = nullptr;
+};
+
+// hazard_pointers turns on reclaim_protect, which makes every collect also scan every thread's hazard pointers.
+FOUNDATION_API ReclaimDomain init_reclaim_domain   (FreeHeap metadata_heap, bool hazard_pointers = false);
+// Frees everything that's still retired, nobody can be reading anything from the domain anymore.
+FOUNDATION_API void          destroy_reclaim_domain(ReclaimDomain* domain);
+
+// Critical sections can nest, only the outermost ones do anything.
+FOUNDATION_API THREAD_SAFE void reclaim_enter(ReclaimDomain* domain);
+FOUNDATION_API THREAD_SAFE void reclaim_exit (ReclaimDomain* domain);
+
+// ptr gets freed back to heap once no critical section or hazard pointer can still be referencing it. It has to
+// already be unreachable for any thread that enters a critical section from here on.
+FOUNDATION_API THREAD_SAFE void reclaim_retire(ReclaimDomain* domain, void* ptr, FreeHeap heap);
+
+// Tries to move the epoch forward and frees whatever the calling thread retired that's safe now. Returns how many
+// pointers got freed.
+FOUNDATION_API THREAD_SAFE u32  reclaim_collect(ReclaimDomain* domain);
+// Blocks until everything the calling thread retired has been freed, e.g. before the thread exits.
+// Can't be called from inside of a critical section.
+FOUNDATION_API THREAD_SAFE void reclaim_flush  (ReclaimDomain* domain);
+
+// Loads *src and protects it with the hazard pointer at index until it gets cleared (or reused for something else).
+// The pointer stays valid even if it gets retired in the meantime, no critical section needed.
+FOUNDATION_API THREAD_SAFE void* _reclaim_protect     (ReclaimDomain* domain, u32 index, void* const* src);
+FOUNDATION_API THREAD_SAFE void  reclaim_clear_hazard(ReclaimDomain* domain, u32 index);
+
+template <typename T>
+inline THREAD_SAFE T*
+reclaim_protect(ReclaimDomain* domain, u32 index, T* const* src)
+{
+  return (T*)_reclaim_protect(domain, index, (void* const*)src);
+}
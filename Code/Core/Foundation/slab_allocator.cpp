@@ -0,0 +1,503 @@
+#include "Core/Foundation/slab_allocator.h"
+
+using Slab       = SlabAllocator::Slab;
+using ThreadHeap = SlabAllocator::ThreadHeap;
+
+// Stored right before every large allocation
+struct SlabLargeHeader
+{
+  void*  pages       = nullptr;
+  size_t usable_size = 0;
+};
+
+static u32
+slab_size_class(size_t size)
+{
+  if (size <= 128)
+  {
+    return size == 0 ? 0 : (u32)((size - 1) / kSlabMinBlockSize);
+  }
+
+  // size is in (2^log, 2^(log + 1)], split that range into 4 classes
+  u32 log = 63 - (u32)count_leading_zeroes((u64)(size - 1));
+  u32 sub = (u32)((size - 1) >> (log - 2));
+  return 8 + (log - 7) * 4 + (sub - 4);
+}
+
+static constexpr u32
+slab_class_block_size(u32 size_class)
+{
+  if (size_class < 8)
+  {
+    return (size_class + 1) * kSlabMinBlockSize;
+  }
+
+  u32 log = 7 + (size_class - 8) / 4;
+  u32 sub = 4 + (size_class - 8) % 4;
+  return (sub + 1) << (log - 2);
+}
+
+static_assert(slab_class_block_size(kSlabSizeClassCount - 1) == kSlabMaxBlockSize, "Size classes don't line up with kSlabMaxBlockSize.");
+
+static bool
+slab_owns(SlabAllocator* self, void* ptr)
+{
+  return (uintptr_t)ptr >= self->slab_memory && (uintptr_t)ptr < self->slab_memory + self->reserve_size;
+}
+
+static Slab*
+slab_from_ptr(SlabAllocator* self, void* ptr)
+{
+  return &self->slabs[((uintptr_t)ptr - self->slab_memory) / kSlabSize];
+}
+
+static uintptr_t
+slab_memory(SlabAllocator* self, Slab* slab)
+{
+  return self->slab_memory + (uintptr_t)(slab - self->slabs) * kSlabSize;
+}
+
+static Slab*
+slab_acquire_new(SlabAllocator* self, u32 owner, u32 size_class)
+{
+  u32 index = kSlabNullIndex;
+
+  spin_acquire(&self->slab_lock);
+  if (self->slab_free_head != kSlabNullIndex)
+  {
+    index                = self->slab_free_head;
+    self->slab_free_head = self->slabs[index].next_free;
+  }
+  else if (self->slab_bump < self->slab_count)
+  {
+    index = self->slab_bump++;
+  }
+  spin_release(&self->slab_lock);
+
+  ASSERT_MSG_FATAL(index != kSlabNullIndex, "Slab allocator ran out of address space (0x%llx bytes reserved)! Bump the reserve size or figure out what's leaking.", self->reserve_size);
+
+  Slab* slab = &self->slabs[index];
+  commit_pages(kSlabSize, (void*)slab_memory(self, slab));
+
+  slab->free_list     = nullptr;
+  slab->bump          = 0;
+  slab->used_count    = 0;
+  slab->block_size    = slab_class_block_size(size_class);
+  slab->capacity      = kSlabSize / slab->block_size;
+  slab->size_class    = (u16)size_class;
+  slab->prev          = nullptr;
+  slab->next          = nullptr;
+  slab->next_returned = nullptr;
+  slab->next_free     = kSlabNullIndex;
+  atomic_ref_store(&slab->owner,       (u16)owner);
+  atomic_ref_store(&slab->remote_free, (void*)nullptr);
+  atomic_ref_store(&slab->state,       (u32)kSlabLinked);
+
+  return slab;
+}
+
+static void
+slab_release(SlabAllocator* self, Slab* slab)
+{
+  decommit_pages(kSlabSize, (void*)slab_memory(self, slab));
+
+  spin_acquire(&self->slab_lock);
+  slab->next_free      = self->slab_free_head;
+  self->slab_free_head = (u32)(slab - self->slabs);
+  spin_release(&self->slab_lock);
+}
+
+static void
+slab_link(ThreadHeap* heap, Slab* slab)
+{
+  Slab** head = &heap->slabs[slab->size_class];
+
+  slab->prev  = nullptr;
+  slab->next  = *head;
+  if (*head != nullptr)
+  {
+    (*head)->prev = slab;
+  }
+  *head = slab;
+}
+
+static void
+slab_unlink(ThreadHeap* heap, Slab* slab)
+{
+  if (slab->prev != nullptr)
+  {
+    slab->prev->next = slab->next;
+  }
+  else
+  {
+    heap->slabs[slab->size_class] = slab->next;
+  }
+
+  if (slab->next != nullptr)
+  {
+    slab->next->prev = slab->prev;
+  }
+
+  if (heap->current[slab->size_class] == slab)
+  {
+    heap->current[slab->size_class] = nullptr;
+  }
+
+  slab->prev = nullptr;
+  slab->next = nullptr;
+}
+
+static void
+slab_collect_remote_frees(Slab* slab)
+{
+  if (atomic_ref_load(&slab->remote_free, std::memory_order_relaxed) == nullptr)
+  {
+    return;
+  }
+
+  void* list  = atomic_ref_exchange(&slab->remote_free, (void*)nullptr, std::memory_order_acquire);
+  void* tail  = list;
+  u32   count = 1;
+  while (*(void**)tail != nullptr)
+  {
+    tail = *(void**)tail;
+    count++;
+  }
+
+  ASSERT_MSG_FATAL(count <= slab->used_count, "More blocks were freed into a slab than were allocated from it. Something is getting double freed.");
+
+  *(void**)tail    = slab->free_list;
+  slab->free_list  = list;
+  slab->used_count -= count;
+}
+
+static void*
+slab_pop(SlabAllocator* self, Slab* slab)
+{
+  void* ret = slab->free_list;
+  if (ret != nullptr)
+  {
+    slab->free_list = *(void**)ret;
+  }
+  else if (slab->bump < slab->capacity)
+  {
+    ret = (void*)(slab_memory(self, slab) + (uintptr_t)slab->bump * slab->block_size);
+    slab->bump++;
+  }
+  else
+  {
+    return nullptr;
+  }
+
+  slab->used_count++;
+  return ret;
+}
+
+// Takes back full slabs that other threads have freed blocks into
+static void
+slab_drain_returned(ThreadHeap* heap)
+{
+  if (atomic_ref_load(&heap->returned, std::memory_order_relaxed) == nullptr)
+  {
+    return;
+  }
+
+  Slab* slab = atomic_ref_exchange(&heap->returned, (Slab*)nullptr, std::memory_order_acquire);
+  while (slab != nullptr)
+  {
+    Slab* next = slab->next_returned;
+    atomic_ref_store(&slab->state, (u32)kSlabLinked, std::memory_order_relaxed);
+    slab_link(heap, slab);
+    slab = next;
+  }
+}
+
+static bool
+slab_try_transition(Slab* slab, u32* expected, SlabState desired)
+{
+  while (!atomic_ref_compare_exchange(&slab->state, expected, (u32)desired))
+  {
+    // Weak compare exchange can fail spuriously
+    if (*expected != kSlabFull)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void*
+slab_try_alloc_from(SlabAllocator* self, ThreadHeap* heap, Slab* slab)
+{
+  slab_collect_remote_frees(slab);
+  if (void* ret = slab_pop(self, slab))
+  {
+    heap->current[slab->size_class] = slab;
+    return ret;
+  }
+
+  // The slab is full, take it out of the list so we don't keep looking at it. Whoever frees into it first is responsible
+  // for putting it back. Remote frees push their block _then_ check the state, and we set the state _then_ check for remote
+  // blocks, so at least one of us is guaranteed to notice and the compare exchange makes sure only one of us acts on it.
+  slab_unlink(heap, slab);
+  atomic_ref_store(&slab->state, (u32)kSlabFull);
+
+  u32 state = kSlabFull;
+  if (atomic_ref_load(&slab->remote_free) == nullptr || !slab_try_transition(slab, &state, kSlabLinked))
+  {
+    return nullptr;
+  }
+
+  slab_link(heap, slab);
+  slab_collect_remote_frees(slab);
+
+  void* ret = slab_pop(self, slab);
+  ASSERT(ret != nullptr);
+  heap->current[slab->size_class] = slab;
+  return ret;
+}
+
+static void*
+slab_alloc_from_heap(SlabAllocator* self, ThreadHeap* heap, u32 owner, u32 size_class)
+{
+  if (Slab* current = heap->current[size_class])
+  {
+    if (void* ret = slab_pop(self, current))
+    {
+      return ret;
+    }
+  }
+
+  slab_drain_returned(heap);
+
+  if (Slab* current = heap->current[size_class])
+  {
+    if (void* ret = slab_try_alloc_from(self, heap, current))
+    {
+      return ret;
+    }
+  }
+
+  for (Slab* slab = heap->slabs[size_class], *next = nullptr; slab != nullptr; slab = next)
+  {
+    next = slab->next;
+    if (void* ret = slab_try_alloc_from(self, heap, slab))
+    {
+      return ret;
+    }
+  }
+
+  Slab* slab = slab_acquire_new(self, owner, size_class);
+  slab_link(heap, slab);
+  heap->current[size_class] = slab;
+
+  return slab_pop(self, slab);
+}
+
+static void
+slab_free_local(SlabAllocator* self, ThreadHeap* heap, Slab* slab, void* ptr)
+{
+  ASSERT_MSG_FATAL(slab->used_count > 0, "Freeing a block into a slab that has nothing allocated. Something is getting double freed.");
+
+  *(void**)ptr    = slab->free_list;
+  slab->free_list = ptr;
+  slab->used_count--;
+
+  u32 state = atomic_ref_load(&slab->state);
+  if (state == kSlabFull && !slab_try_transition(slab, &state, kSlabLinked))
+  {
+    // Some other thread beat us to it and it's already sitting in our returned list
+    return;
+  }
+  else if (state == kSlabFull)
+  {
+    slab_link(heap, slab);
+  }
+  else if (state == kSlabReturned)
+  {
+    // Not in any list until we drain the returned list, so leave it alone
+    return;
+  }
+
+  // Give completely empty slabs back so other size classes/threads can use them, but hold on to the one we're
+  // allocating out of so that alloc/free pairs don't keep committing and decommitting the same pages.
+  if (slab->used_count == 0 && heap->current[slab->size_class] != slab)
+  {
+    slab_unlink(heap, slab);
+    slab_release(self, slab);
+  }
+}
+
+static void
+slab_free_remote(SlabAllocator* self, Slab* slab, void* ptr)
+{
+  void* head = atomic_ref_load(&slab->remote_free, std::memory_order_relaxed);
+  do
+  {
+    *(void**)ptr = head;
+  } while (!atomic_ref_compare_exchange(&slab->remote_free, &head, ptr));
+
+  u32 state = atomic_ref_load(&slab->state);
+  if (state != kSlabFull || !slab_try_transition(slab, &state, kSlabReturned))
+  {
+    return;
+  }
+
+  ThreadHeap* owner    = &self->thread_heaps[atomic_ref_load(&slab->owner, std::memory_order_relaxed)];
+  Slab*       returned = atomic_ref_load(&owner->returned, std::memory_order_relaxed);
+  do
+  {
+    slab->next_returned = returned;
+  } while (!atomic_ref_compare_exchange(&owner->returned, &returned, slab, std::memory_order_release));
+}
+
+static void*
+slab_alloc_large(size_t size, size_t alignment)
+{
+  ASSERT_MSG_FATAL(alignment <= kPageSize, "Slab allocator doesn't support alignments (%llu) bigger than a page.", alignment);
+
+  size_t offset     = ALIGN_POW2(sizeof(SlabLargeHeader), MAX(alignment, alignof(SlabLargeHeader)));
+  size_t pages_size = ALIGN_POW2(offset + size, kPageSize);
+  u8*    pages      = (u8*)reserve_commit_pages(pages_size);
+  ASSERT_MSG_FATAL(pages != nullptr, "Failed to allocate 0x%llx bytes of pages for a large allocation.", pages_size);
+
+  SlabLargeHeader* header = (SlabLargeHeader*)(pages + offset) - 1;
+  header->pages           = pages;
+  header->usable_size     = pages_size - offset;
+
+  return pages + offset;
+}
+
+void*
+slab_alloc(void* slab_allocator, size_t size, size_t alignment)
+{
+  SlabAllocator* self = (SlabAllocator*)slab_allocator;
+
+  // Power of 2 size classes are always aligned to their size since slabs are aligned to kSlabSize,
+  // so bigger alignments just get bumped up to the nearest one of those.
+  if (alignment > kSlabMinBlockSize)
+  {
+    size = MAX(size, alignment);
+    size = size <= 1 ? 1 : 1ULL << (64 - count_leading_zeroes((u64)(size - 1)));
+  }
+
+  if (size > kSlabMaxBlockSize)
+  {
+    return slab_alloc_large(size, alignment);
+  }
+
+  u32 size_class = slab_size_class(size);
+  u32 slot       = get_allocator_thread_slot();
+  if (slot < kAllocatorMaxThreads)
+  {
+    return slab_alloc_from_heap(self, &self->thread_heaps[slot], slot, size_class);
+  }
+
+  spin_acquire(&self->shared_heap_lock);
+  defer { spin_release(&self->shared_heap_lock); };
+  return slab_alloc_from_heap(self, &self->thread_heaps[kAllocatorMaxThreads], kAllocatorMaxThreads, size_class);
+}
+
+void
+slab_free(void* slab_allocator, void* ptr)
+{
+  SlabAllocator* self = (SlabAllocator*)slab_allocator;
+
+  if (ptr == nullptr)
+  {
+    return;
+  }
+
+  if (!slab_owns(self, ptr))
+  {
+    SlabLargeHeader* header = (SlabLargeHeader*)ptr - 1;
+    free_pages(header->pages);
+    return;
+  }
+
+  Slab* slab  = slab_from_ptr(self, ptr);
+  u32   owner = atomic_ref_load(&slab->owner, std::memory_order_relaxed);
+  u32   slot  = MIN(get_allocator_thread_slot(), kAllocatorMaxThreads);
+  if (owner != slot)
+  {
+    slab_free_remote(self, slab, ptr);
+  }
+  else if (slot < kAllocatorMaxThreads)
+  {
+    slab_free_local(self, &self->thread_heaps[slot], slab, ptr);
+  }
+  else
+  {
+    spin_acquire(&self->shared_heap_lock);
+    defer { spin_release(&self->shared_heap_lock); };
+    slab_free_local(self, &self->thread_heaps[kAllocatorMaxThreads], slab, ptr);
+  }
+}
+
+void*
+slab_realloc(void* slab_allocator, void* ptr, size_t size, size_t alignment)
+{
+  SlabAllocator* self = (SlabAllocator*)slab_allocator;
+
+  if (ptr == nullptr)
+  {
+    return slab_alloc(self, size, alignment);
+  }
+
+  size_t usable_size = slab_usable_size(self, ptr);
+  if (size <= usable_size && ((uintptr_t)ptr & (MAX(alignment, 1) - 1)) == 0)
+  {
+    return ptr;
+  }
+
+  void* ret = slab_alloc(self, size, alignment);
+  memcpy(ret, ptr, MIN(size, usable_size));
+  slab_free(self, ptr);
+
+  return ret;
+}
+
+size_t
+slab_usable_size(SlabAllocator* self, void* ptr)
+{
+  if (!slab_owns(self, ptr))
+  {
+    return ((SlabLargeHeader*)ptr - 1)->usable_size;
+  }
+
+  return slab_from_ptr(self, ptr)->block_size;
+}
+
+SlabAllocator
+init_slab_allocator(AllocHeap heap, size_t reserve_size)
+{
+  reserve_size = ALIGN_POW2(reserve_size, (size_t)kSlabSize);
+  ASSERT_MSG_FATAL(reserve_size / kSlabSize < kSlabNullIndex, "Slab allocator reserve size 0x%llx is too large.", reserve_size);
+
+  SlabAllocator ret;
+  // Reserve an extra slab worth so that the slabs themselves can be aligned to kSlabSize
+  ret.memory           = (uintptr_t)reserve_pages(reserve_size + kSlabSize);
+  ret.slab_memory      = ALIGN_POW2(ret.memory, (uintptr_t)kSlabSize);
+  ret.reserve_size     = reserve_size;
+  ret.slab_count       = (u32)(reserve_size / kSlabSize);
+  ret.slab_lock        = init_spin_lock();
+  ret.slab_free_head   = kSlabNullIndex;
+  ret.slab_bump        = 0;
+  ret.shared_heap_lock = init_spin_lock();
+
+  ret.slabs            = HEAP_ALLOC(Slab, heap, ret.slab_count);
+  zero_memory(ret.slabs, sizeof(Slab) * ret.slab_count);
+
+  ret.thread_heaps     = HEAP_ALLOC(ThreadHeap, heap, kAllocatorMaxThreads + 1);
+  zero_memory(ret.thread_heaps, sizeof(ThreadHeap) * (kAllocatorMaxThreads + 1));
+
+  return ret;
+}
+
+void
+destroy_slab_allocator(SlabAllocator* self)
+{
+  free_pages((void*)self->memory);
+  zero_memory(self, sizeof(SlabAllocator));
+}
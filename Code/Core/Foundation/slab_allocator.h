@@ -0,0 +1,106 @@
+#pragma once
+#include "Core/Foundation/types.h"
+#include "Core/Foundation/memory.h"
+#include "Core/Foundation/threading.h"
+
+static constexpr u32 kSlabSize             = KiB(256);
+static constexpr u32 kSlabMinBlockSize     = 16;
+// Anything bigger than this goes straight to the OS as its own set of pages
+static constexpr u32 kSlabMaxBlockSize     = KiB(32);
+// 8 linearly spaced classes up to 128 bytes, then 4 classes per power of 2 up to kSlabMaxBlockSize
+static constexpr u32 kSlabSizeClassCount   = 40;
+static constexpr u32 kSlabNullIndex        = U32_MAX;
+
+enum SlabState : u32
+{
+  // In the owner's list for its size class
+  kSlabLinked,
+  // Full, so the owner took it out of its lists. Whoever frees into it first puts it back.
+  kSlabFull,
+  // Was full and another thread freed into it, sitting in the owner's returned list
+  kSlabReturned,
+};
+
+FOUNDATION_API void* slab_alloc  (void* slab_allocator, size_t size, size_t alignment);
+FOUNDATION_API void  slab_free   (void* slab_allocator, void* ptr);
+FOUNDATION_API void* slab_realloc(void* slab_allocator, void* ptr, size_t size, size_t alignment);
+
+// General purpose thread-aware allocator. Small allocations are rounded up to one of kSlabSizeClassCount size classes
+// and carved out of kSlabSize slabs that each hold blocks of a single size class.
+//
+// Every slab is owned by the thread that created it. The owner allocates and frees blocks in it without any atomics,
+// and other threads freeing into it push onto a lock-free remote free list that the owner picks up the next time it
+// runs out of blocks, so threads never wait on each other unless they need a brand new slab.
+//
+// NOTE(bshihabi): Slabs aren't handed off when their owner thread exits, so blocks freed into a dead thread's slabs
+// are never reused. That's fine for the fixed set of long lived threads the engine has, just don't use this from
+// threads that come and go.
+struct SlabAllocator
+{
+  struct Slab
+  {
+    // Only touched by the owner
+    void* free_list  = nullptr;
+    u32   bump       = 0;
+    u32   used_count = 0;
+    u32   capacity   = 0;
+    u32   block_size = 0;
+    u16   size_class = 0;
+    u16   owner      = 0;
+    Slab* prev       = nullptr;
+    Slab* next       = nullptr;
+
+    // Touched by everyone, accessed atomically
+    alignas(kCacheLineSize)
+    void* remote_free   = nullptr;
+    // SlabState, says which list (if any) the slab is in
+    u32   state         = 0;
+    Slab* next_returned = nullptr;
+
+    // Free slab list, protected by SlabAllocator::slab_lock
+    u32   next_free   = kSlabNullIndex;
+  };
+
+  struct alignas(kCacheLineSize) ThreadHeap
+  {
+    // The slab we're currently allocating out of, always a member of `slabs`
+    Slab* current[kSlabSizeClassCount];
+    // Every non-full slab of the size class owned by this heap
+    Slab* slabs  [kSlabSizeClassCount];
+
+    // Full slabs that had blocks freed into them by other threads, pushed atomically
+    Slab* returned;
+  };
+
+  uintptr_t   memory          = 0x0;
+  uintptr_t   slab_memory     = 0x0;
+  size_t      reserve_size    = 0;
+
+  Slab*       slabs           = nullptr;
+  u32         slab_count      = 0;
+
+  SpinLock    slab_lock;
+  u32         slab_free_head  = kSlabNullIndex;
+  u32         slab_bump       = 0;
+
+  // One per thread slot, plus one shared by every thread past kAllocatorMaxThreads which is protected by shared_heap_lock
+  ThreadHeap* thread_heaps    = nullptr;
+  SpinLock    shared_heap_lock;
+
+  operator ReallocFreeHeap()
+  {
+    ReallocFreeHeap ret = {0};
+    ret.alloc_fn        = &slab_alloc;
+    ret.free_fn         = &slab_free;
+    ret.realloc_fn      = &slab_realloc;
+    ret.allocator       = this;
+    return ret;
+  }
+};
+
+// Reserves reserve_size bytes of address space for slabs, pages are only committed once a slab is actually used.
+FOUNDATION_API SlabAllocator init_slab_allocator   (AllocHeap heap, size_t reserve_size);
+FOUNDATION_API void          destroy_slab_allocator(SlabAllocator* allocator);
+
+// How many bytes are actually usable at ptr, which can be more than what was asked for
+FOUNDATION_API size_t        slab_usable_size      (SlabAllocator* allocator, void* ptr);
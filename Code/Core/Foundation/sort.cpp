@@ -1,63 +1,349 @@
 #include "Core/Foundation/sort.h"
 #include "Core/Foundation/context.h"
 
-void
-radix_sort(void* data, u32 count, u32 stride, u32 key_offset, SortOp op)
+// Below this many elements 11-bit digits cost more in clearing and prefix summing histograms than they save in passes
+static constexpr u32 kRadixSortWideDigitThreshold = 0x10000;
+
+// Below this many elements per block it's not worth splitting the work up
+static constexpr u32 kRadixSortBlockSize          = 0x40000;
+static constexpr u32 kRadixSortMaxBlocks          = 8;
+
+// Element and its index in the original array, used when the element is big enough that moving it around every pass would be slower than
+// moving these and doing a single gather at the end.
+template <typename K>
+struct RadixSortPair
 {
-  if (count <= 1)
+  K   key;
+  u32 index;
+};
+static_assert(sizeof(RadixSortPair<u32>) == 8, "Key+index pairs of 32-bit keys should be 8 bytes.");
+
+// Every phase of the sort is a function run once per block, and every phase has to completely finish before the next
+// one starts. Blocks are fixed ranges of the input, so it doesn't matter which thread ends up running which block.
+template <typename K, u32 kDigitBits>
+struct RadixSortCtx
+{
+  static constexpr u32 kBuckets = 1u << kDigitBits;
+  static constexpr u32 kDigits  = (sizeof(K) * 8 + kDigitBits - 1) / kDigitBits;
+  static constexpr K   kMask    = (K)(kBuckets - 1);
+
+  u8*                     data            = nullptr;
+  u32                     count           = 0;
+  u32                     stride          = 0;
+  u32                     key_offset      = 0;
+  SortOp                  op              = kSortIncreasing;
+
+  // Whether we're sorting (key, index) pairs instead of the elements themselves
+  bool                    use_pairs       = false;
+  u8*                     buffers[2]      = {};
+  u32                     sort_stride     = 0;
+  u32                     sort_key_offset = 0;
+  u8*                     gather          = nullptr;
+
+  const ParallelDispatch* dispatch        = nullptr;
+  u32                     block_count     = 1;
+  // [block][digit][bucket]
+  u32*                    histograms      = nullptr;
+  bool                    skip_digit[kDigits] = {};
+
+  // The digit pass that's running and which of the buffers it reads from
+  u32                     digit           = 0;
+  u32                     src_buffer      = 0;
+};
+
+template <typename K>
+static K
+load_key(const u8* element)
+{
+  K ret;
+  memcpy(&ret, element, sizeof(K));
+  return ret;
+}
+
+template <typename K, u32 kDigitBits>
+static void
+get_radix_sort_block_range(const RadixSortCtx<K, kDigitBits>* ctx, u32 block, u32* begin, u32* end)
+{
+  *begin = (u32)((u64)ctx->count *  block      / ctx->block_count);
+  *end   = (u32)((u64)ctx->count * (block + 1) / ctx->block_count);
+}
+
+template <typename K, u32 kDigitBits>
+static void
+run_radix_sort_phase(RadixSortCtx<K, kDigitBits>* ctx, void (*fn)(void* ctx, u32 block))
+{
+  if (ctx->block_count == 1)
   {
+    fn(ctx, 0);
     return;
   }
 
-  static constexpr u32 kBits    = 8;
-  static constexpr u32 kBuckets = 1u << kBits;
-  static constexpr u32 kMask    = kBuckets - 1;
-  static constexpr u32 kPasses  = sizeof(u32) * 8 / kBits;
+  ctx->dispatch->run(ctx->dispatch->user, ctx->block_count, fn, ctx);
+}
 
-  u8* src = (u8*)data;
-  ScratchAllocator scratch_arena = alloc_scratch_arena();
-  defer { free_scratch_arena(&scratch_arena); };
+// Builds the pairs for the block and histograms every digit in one read over the data
+template <typename K, u32 kDigitBits>
+static void
+radix_sort_histogram_block(void* param, u32 block)
+{
+  using Ctx = RadixSortCtx<K, kDigitBits>;
+  auto* ctx = (Ctx*)param;
 
-  u8* dst = HEAP_ALLOC(u8, scratch_arena, count * stride);
+  u32 begin, end;
+  get_radix_sort_block_range(ctx, block, &begin, &end);
 
-  for (u32 pass = 0; pass < kPasses; pass++)
+  if (ctx->use_pairs)
   {
-    u32 shift = pass * kBits;
+    auto* pairs = (RadixSortPair<K>*)ctx->buffers[0];
+    for (u32 i = begin; i < end; i++)
+    {
+      pairs[i].key   = load_key<K>(ctx->data + (u64)i * ctx->stride + ctx->key_offset);
+      pairs[i].index = i;
+    }
+  }
 
-    u32 counts[kBuckets] = {};
-    for (u32 i = 0; i < count; i++)
+  u32* histograms = ctx->histograms + (u64)block * Ctx::kDigits * Ctx::kBuckets;
+  zero_memory(histograms, sizeof(u32) * Ctx::kDigits * Ctx::kBuckets);
+
+  const u8* src = ctx->buffers[0] + ctx->sort_key_offset;
+  for (u32 i = begin; i < end; i++)
+  {
+    K key = load_key<K>(src + (u64)i * ctx->sort_stride);
+    for (u32 digit = 0; digit < Ctx::kDigits; digit++)
     {
-      u32 key = *(u32*)(src + i * stride + key_offset);
-      counts[(key >> shift) & kMask]++;
+      histograms[digit * Ctx::kBuckets + ((key >> (digit * kDigitBits)) & Ctx::kMask)]++;
     }
+  }
+}
+
+// Elements have moved around since the first histogram, so with more than one block the per block counts need redoing.
+// The total counts per bucket never change, so a single block can keep using them.
+template <typename K, u32 kDigitBits>
+static void
+radix_sort_count_block(void* param, u32 block)
+{
+  using Ctx = RadixSortCtx<K, kDigitBits>;
+  auto* ctx = (Ctx*)param;
+
+  u32 begin, end;
+  get_radix_sort_block_range(ctx, block, &begin, &end);
+
+  const u8* src    = ctx->buffers[ctx->src_buffer] + ctx->sort_key_offset;
+  u32       shift  = ctx->digit * kDigitBits;
+  u32*      counts = ctx->histograms + ((u64)block * Ctx::kDigits + ctx->digit) * Ctx::kBuckets;
+  zero_memory(counts, sizeof(u32) * Ctx::kBuckets);
+  for (u32 i = begin; i < end; i++)
+  {
+    K key = load_key<K>(src + (u64)i * ctx->sort_stride);
+    counts[(key >> shift) & Ctx::kMask]++;
+  }
+}
+
+template <typename K, u32 kDigitBits>
+static void
+radix_sort_scatter_block(void* param, u32 block)
+{
+  using Ctx = RadixSortCtx<K, kDigitBits>;
+  auto* ctx = (Ctx*)param;
 
-    u32 offsets[kBuckets];
-    if (op == kSortIncreasing)
+  u32 begin, end;
+  get_radix_sort_block_range(ctx, block, &begin, &end);
+
+  const u8* src    = ctx->buffers[ctx->src_buffer];
+  u8*       dst    = ctx->buffers[ctx->src_buffer ^ 1];
+  u32       digit  = ctx->digit;
+  u32       shift  = digit * kDigitBits;
+  u32       stride = ctx->sort_stride;
+
+  // Our offset into a bucket is everything in the buckets before it plus whatever the blocks before us put in the same bucket.
+  u32 offsets[Ctx::kBuckets];
+  u32 running = 0;
+  for (u32 i = 0; i < Ctx::kBuckets; i++)
+  {
+    u32 bucket = ctx->op == kSortIncreasing ? i : Ctx::kBuckets - 1 - i;
+
+    u32 before = 0;
+    u32 total  = 0;
+    for (u32 iblock = 0; iblock < ctx->block_count; iblock++)
     {
-      offsets[0] = 0;
-      for (u32 i = 1; i < kBuckets; i++)
-      {
-        offsets[i] = offsets[i - 1] + counts[i - 1];
-      }
+      u32 c = ctx->histograms[((u64)iblock * Ctx::kDigits + digit) * Ctx::kBuckets + bucket];
+      before += iblock < block ? c : 0;
+      total  += c;
     }
-    else
+
+    offsets[bucket] = running + before;
+    running        += total;
+  }
+
+  for (u32 i = begin; i < end; i++)
+  {
+    const u8* element = src + (u64)i * stride;
+    K         key     = load_key<K>(element + ctx->sort_key_offset);
+    u32       bucket  = (u32)((key >> shift) & Ctx::kMask);
+    memcpy(dst + (u64)offsets[bucket]++ * stride, element, stride);
+  }
+}
+
+// Permutes the payloads exactly once
+template <typename K, u32 kDigitBits>
+static void
+radix_sort_gather_block(void* param, u32 block)
+{
+  auto* ctx = (RadixSortCtx<K, kDigitBits>*)param;
+
+  u32 begin, end;
+  get_radix_sort_block_range(ctx, block, &begin, &end);
+
+  auto* pairs = (const RadixSortPair<K>*)ctx->buffers[ctx->src_buffer];
+  for (u32 i = begin; i < end; i++)
+  {
+    memcpy(ctx->gather + (u64)i * ctx->stride, ctx->data + (u64)pairs[i].index * ctx->stride, ctx->stride);
+  }
+}
+
+template <typename K, u32 kDigitBits>
+static void
+radix_sort_copy_back_block(void* param, u32 block)
+{
+  auto* ctx = (RadixSortCtx<K, kDigitBits>*)param;
+
+  u32 begin, end;
+  get_radix_sort_block_range(ctx, block, &begin, &end);
+
+  const u8* src = ctx->use_pairs ? ctx->gather : ctx->buffers[1];
+  memcpy(ctx->data + (u64)begin * ctx->stride, src + (u64)begin * ctx->stride, (u64)(end - begin) * ctx->stride);
+}
+
+template <typename K, u32 kDigitBits>
+static void
+radix_sort_impl(void* data, u32 count, u32 stride, u32 key_offset, SortOp op, const ParallelDispatch* dispatch)
+{
+  using Ctx = RadixSortCtx<K, kDigitBits>;
+
+  ScratchAllocator scratch_arena = alloc_scratch_arena();
+  defer { free_scratch_arena(&scratch_arena); };
+
+  Ctx ctx;
+  ctx.data       = (u8*)data;
+  ctx.count      = count;
+  ctx.stride     = stride;
+  ctx.key_offset = key_offset;
+  ctx.op         = op;
+  ctx.use_pairs  = stride > 2 * sizeof(RadixSortPair<K>);
+
+  if (ctx.use_pairs)
+  {
+    ctx.sort_stride     = sizeof(RadixSortPair<K>);
+    ctx.sort_key_offset = offsetof(RadixSortPair<K>, key);
+    ctx.buffers[0]      = HEAP_ALLOC_ALIGNED((AllocHeap)scratch_arena, (u64)count * ctx.sort_stride, alignof(RadixSortPair<K>));
+    ctx.buffers[1]      = HEAP_ALLOC_ALIGNED((AllocHeap)scratch_arena, (u64)count * ctx.sort_stride, alignof(RadixSortPair<K>));
+    ctx.gather          = HEAP_ALLOC_ALIGNED((AllocHeap)scratch_arena, (u64)count * stride, 16);
+  }
+  else
+  {
+    ctx.sort_stride     = stride;
+    ctx.sort_key_offset = key_offset;
+    ctx.buffers[0]      = (u8*)data;
+    ctx.buffers[1]      = HEAP_ALLOC_ALIGNED((AllocHeap)scratch_arena, (u64)count * stride, 16);
+  }
+
+  // Splitting into blocks costs an extra counting pass per digit, so only do it when there's somewhere for them to run
+  ctx.dispatch    = dispatch;
+  ctx.block_count = 1;
+  if (dispatch != nullptr && dispatch->thread_count > 1 && count >= kRadixSortBlockSize * 2)
+  {
+    ctx.block_count = MIN(MIN(dispatch->thread_count, kRadixSortMaxBlocks), count / kRadixSortBlockSize);
+  }
+  ctx.histograms  = HEAP_ALLOC(u32, (AllocHeap)scratch_arena, (u64)ctx.block_count * Ctx::kDigits * Ctx::kBuckets);
+
+  run_radix_sort_phase(&ctx, &radix_sort_histogram_block<K, kDigitBits>);
+
+  // A digit where every element lands in the same bucket doesn't change the order, skip the pass
+  for (u32 digit = 0; digit < Ctx::kDigits; digit++)
+  {
+    ctx.skip_digit[digit] = false;
+    for (u32 bucket = 0; bucket < Ctx::kBuckets; bucket++)
     {
-      offsets[kBuckets - 1] = 0;
-      for (u32 i = kBuckets - 1; i > 0; i--)
+      u32 total = 0;
+      for (u32 iblock = 0; iblock < ctx.block_count; iblock++)
       {
-        offsets[i - 1] = offsets[i] + counts[i];
+        total += ctx.histograms[((u64)iblock * Ctx::kDigits + digit) * Ctx::kBuckets + bucket];
+      }
+
+      if (total == count)
+      {
+        ctx.skip_digit[digit] = true;
+        break;
+      }
+      else if (total != 0)
+      {
+        break;
       }
     }
+  }
 
-    for (u32 i = 0; i < count; i++)
+  bool first_pass = true;
+  for (u32 digit = 0; digit < Ctx::kDigits; digit++)
+  {
+    if (ctx.skip_digit[digit])
     {
-      u32 key    = *(u32*)(src + i * stride + key_offset);
-      u32 bucket = (key >> shift) & kMask;
-      memcpy(dst + offsets[bucket]++ * stride, src + i * stride, stride);
+      continue;
     }
 
-    u8* tmp = src;
-    src     = dst;
-    dst     = tmp;
+    ctx.digit = digit;
+    if (!first_pass && ctx.block_count > 1)
+    {
+      run_radix_sort_phase(&ctx, &radix_sort_count_block<K, kDigitBits>);
+    }
+    run_radix_sort_phase(&ctx, &radix_sort_scatter_block<K, kDigitBits>);
+
+    ctx.src_buffer ^= 1;
+    first_pass      = false;
+  }
+
+  if (ctx.use_pairs)
+  {
+    run_radix_sort_phase(&ctx, &radix_sort_gather_block<K, kDigitBits>);
+    run_radix_sort_phase(&ctx, &radix_sort_copy_back_block<K, kDigitBits>);
+  }
+  else if (ctx.src_buffer != 0)
+  {
+    run_radix_sort_phase(&ctx, &radix_sort_copy_back_block<K, kDigitBits>);
+  }
+}
+
+void
+radix_sort(void* data, u32 count, u32 stride, u32 key_offset, SortOp op, const ParallelDispatch* dispatch)
+{
+  if (count <= 1)
+  {
+    return;
+  }
+
+  if (count >= kRadixSortWideDigitThreshold)
+  {
+    radix_sort_impl<u32, 11>(data, count, stride, key_offset, op, dispatch);
+  }
+  else
+  {
+    radix_sort_impl<u32, 8>(data, count, stride, key_offset, op, dispatch);
+  }
+}
+
+void
+radix_sort_u64(void* data, u32 count, u32 stride, u32 key_offset, SortOp op, const ParallelDispatch* dispatch)
+{
+  if (count <= 1)
+  {
+    return;
+  }
+
+  if (count >= kRadixSortWideDigitThreshold)
+  {
+    radix_sort_impl<u64, 11>(data, count, stride, key_offset, op, dispatch);
+  }
+  else
+  {
+    radix_sort_impl<u64, 8>(data, count, stride, key_offset, op, dispatch);
   }
 }
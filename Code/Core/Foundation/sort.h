@@ -6,4 +6,22 @@ enum SortOp : u32
   kSortIncreasing,
   kSortDecreasing,
 };
-FOUNDATION_API void radix_sort(void* data, u32 count, u32 stride, u32 key_offset, SortOp op = kSortIncreasing);
+
+// Foundation doesn't know about the job system, so anything that wants to spread work across threads gets handed one of these.
+// run has to call fn(ctx, block) for every block in [0, block_count) and only return once every call has finished. The
+// calls can happen in any order on any thread.
+struct ParallelDispatch
+{
+  void (*run)(void* user, u32 block_count, void (*fn)(void* ctx, u32 block), void* ctx) = nullptr;
+  void* user         = nullptr;
+  // How many threads run can actually spread the blocks across, work doesn't get split up into more blocks than this
+  u32   thread_count = 1;
+};
+
+// Stable LSD radix sorts on `count` elements of size `stride`, keyed by the unsigned integer at key_offset.
+//
+// Digits that are the same for every element are skipped entirely, small inputs use 8-bit digits and large ones use 11-bit digits (fewer passes).
+// Elements bigger than a (key, index) pair are sorted as pairs and the payloads are permuted once at the end instead of being copied on every pass.
+// Really large inputs split the histogram and scatter work into blocks that get run through dispatch, without one everything runs on the calling thread.
+FOUNDATION_API void radix_sort    (void* data, u32 count, u32 stride, u32 key_offset, SortOp op = kSortIncreasing, const ParallelDispatch* dispatch = nullptr);
+FOUNDATION_API void radix_sort_u64(void* data, u32 count, u32 stride, u32 key_offset, SortOp op = kSortIncreasing, const ParallelDispatch* dispatch = nullptr);
@@ -3,6 +3,22 @@
 
 #include "Core/Foundation/Containers/array.h"
 
+#if defined(_WIN32)
+#pragma comment(lib, "Synchronization.lib")
+#elif defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+#else
+#error "threading.cpp has no backend for this platform"
+#endif
+
 struct ThreadEntryProcParams
 {
   ThreadProc proc          = nullptr;
@@ -10,8 +26,8 @@ struct ThreadEntryProcParams
 };
 
 // Sets up a memory arena and other things before actually entering
-static DWORD
-thread_entry_proc(LPVOID void_param)
+static u32
+run_thread_entry_proc(void* void_param)
 {
   ThreadEntryProcParams params = *reinterpret_cast<ThreadEntryProcParams*>(void_param);
 
@@ -20,25 +36,39 @@ thread_entry_proc(LPVOID void_param)
 
   u32 res = params.proc(params.user_param);
 
+  destroy_thread_context();
+
   return res;
 }
 
+#if defined(_WIN32)
+
+static DWORD
+thread_entry_proc(LPVOID void_param)
+{
+  return run_thread_entry_proc(void_param);
+}
+
 Thread
 init_thread(
   AllocHeap heap,
   u64 stack_size,
   ThreadProc proc,
   void* param,
-  u8 core_index
+  const CpuSet& cpus
 ) {
   ThreadEntryProcParams* params = HEAP_ALLOC(ThreadEntryProcParams, heap, 1);
   params->proc          = proc;
   params->user_param    = param;
 
-  ASSERT_MSG_FATAL(core_index < 32, "Core index %u is invalid. Core index must be < 32", core_index);
   Thread ret = {0};
-  ret.handle = CreateThread(0, stack_size, &thread_entry_proc, params, 0, &ret.id);
-  SetThreadAffinityMask(ret.handle, (1ULL << core_index));
+  // Start it suspended so that it never runs on the wrong core
+  ret.handle = CreateThread(0, stack_size, &thread_entry_proc, params, CREATE_SUSPENDED, &ret.id);
+  ASSERT_MSG_FATAL(ret.handle != nullptr, "Failed to create thread: 0x%x", GetLastError());
+
+  set_thread_affinity(&ret, cpus);
+
+  ResumeThread(ret.handle);
 
   return ret;
 }
@@ -54,9 +84,8 @@ destroy_thread(Thread* thread)
 u32
 get_num_physical_cores()
 {
-  SYSTEM_INFO info = {0};
-  GetSystemInfo(&info);
-  return info.dwNumberOfProcessors;
+  // GetSystemInfo only counts the processor group the calling thread is in, which caps out at 64
+  return GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
 }
 
 void
@@ -74,8 +103,6 @@ set_current_thread_name(const wchar_t* name)
 void
 join_threads(const Thread* threads, u32 count)
 {
-  ASSERT(count <= MAXIMUM_WAIT_OBJECTS);
-
   ScratchAllocator scratch_allocator = alloc_scratch_arena();
   defer { free_scratch_arena(&scratch_allocator); };
 
@@ -85,7 +112,89 @@ join_threads(const Thread* threads, u32 count)
     *array_add(&handles) = threads[i].handle;
   }
 
-  WaitForMultipleObjects(count, handles.memory, true, INFINITE);
+  // WaitForMultipleObjects can only wait on MAXIMUM_WAIT_OBJECTS at a time
+  for (u32 ihandle = 0; ihandle < count; ihandle += MAXIMUM_WAIT_OBJECTS)
+  {
+    WaitForMultipleObjects(MIN(count - ihandle, (u32)MAXIMUM_WAIT_OBJECTS), handles.memory + ihandle, true, INFINITE);
+  }
+}
+
+bool
+set_thread_affinity(const Thread* thread, const CpuSet& cpus)
+{
+  u32 group       = 0;
+  u32 group_count = 0;
+  for (u32 igroup = 0; igroup < ARRAY_LENGTH(cpus.masks); igroup++)
+  {
+    if (cpus.masks[igroup] != 0)
+    {
+      group = igroup;
+      group_count++;
+    }
+  }
+  ASSERT_MSG_FATAL(group_count > 0, "Can't restrict a thread to an empty CpuSet.");
+
+  if (group_count == 1)
+  {
+    GROUP_AFFINITY affinity = {0};
+    affinity.Mask           = (KAFFINITY)cpus.masks[group];
+    affinity.Group          = (WORD)group;
+    return SetThreadGroupAffinity(thread->handle, &affinity, nullptr);
+  }
+
+  // A group affinity can't span more than one processor group, CPU Sets can. CPU Sets are identified by opaque
+  // IDs though, so go find the ones that map to the logical processors we want.
+  ULONG size = 0;
+  GetSystemCpuSetInformation(nullptr, 0, &size, GetCurrentProcess(), 0);
+
+  ScratchAllocator scratch_allocator = alloc_scratch_arena();
+  defer { free_scratch_arena(&scratch_allocator); };
+
+  u8* buffer = HEAP_ALLOC(u8, scratch_allocator, size);
+  if (!GetSystemCpuSetInformation((PSYSTEM_CPU_SET_INFORMATION)buffer, size, &size, GetCurrentProcess(), 0))
+  {
+    return false;
+  }
+
+  Array<ULONG> ids = init_array<ULONG>(scratch_allocator, kMaxCpuCount);
+  for (ULONG offset = 0; offset < size;)
+  {
+    const SYSTEM_CPU_SET_INFORMATION* info = (const SYSTEM_CPU_SET_INFORMATION*)(buffer + offset);
+    offset += info->Size;
+
+    if (info->Type != CpuSetInformation)
+    {
+      continue;
+    }
+
+    u32 cpu = (u32)info->CpuSet.Group * 64 + info->CpuSet.LogicalProcessorIndex;
+    if (cpu_set_contains(cpus, cpu) && ids.size < ids.capacity)
+    {
+      *array_add(&ids) = info->CpuSet.Id;
+    }
+  }
+
+  return SetThreadSelectedCpuSets(thread->handle, ids.memory, (ULONG)ids.size);
+}
+
+bool
+set_current_thread_affinity(const CpuSet& cpus)
+{
+  Thread self = {0};
+  self.handle = GetCurrentThread();
+  return set_thread_affinity(&self, cpus);
+}
+
+void
+yield_current_thread()
+{
+  SwitchToThread();
+}
+
+static u64
+get_monotonic_ms()
+{
+  return GetTickCount64();
 }
 
 void
@@ -118,38 +227,822 @@ mutex_acquire(Mutex* mutex)
   AcquireSRWLockExclusive(&mutex->lock);
 }
 
+bool
+try_mutex_acquire(Mutex* mutex)
+{
+  return TryAcquireSRWLockExclusive(&mutex->lock);
+}
+
 void
 mutex_release(Mutex* mutex)
 {
   ReleaseSRWLockExclusive(&mutex->lock);
 }
 
+bool
+cond_var_wait(CondVar* cond_var, Mutex* mutex, u32 timeout_ms)
+{
+  if (!SleepConditionVariableSRW(&cond_var->cond_var, &mutex->lock, timeout_ms == U32_MAX ? INFINITE : timeout_ms, 0))
+  {
+    ASSERT_MSG(GetLastError() == ERROR_TIMEOUT, "SleepConditionVariableSRW failed with error 0x%x", GetLastError());
+    return false;
+  }
+
+  return true;
+}
+
+void
+cond_var_notify_one(CondVar* cond_var)
+{
+  WakeConditionVariable(&cond_var->cond_var);
+}
+
+void
+cond_var_notify_all(CondVar* cond_var)
+{
+  WakeAllConditionVariable(&cond_var->cond_var);
+}
+
+bool
+wait_on_address(const void* address, const void* compare, size_t size, u32 timeout_ms)
+{
+  ASSERT_MSG_FATAL(size == 1 || size == 2 || size == 4 || size == 8, "wait_on_address only supports values of 1, 2, 4, or 8 bytes, got %llu.", size);
+  BOOL ret = WaitOnAddress((volatile void*)address, (void*)compare, size, timeout_ms == U32_MAX ? INFINITE : timeout_ms);
+  if (!ret)
+  {
+    ASSERT_MSG(GetLastError() == ERROR_TIMEOUT, "WaitOnAddress failed with error 0x%x", GetLastError());
+    return false;
+  }
+
+  return true;
+}
+
+void
+wake_one_on_address(const void* address)
+{
+  WakeByAddressSingle((void*)address);
+}
+
+void
+wake_all_on_address(const void* address)
+{
+  WakeByAddressAll((void*)address);
+}
+
+OsEvent
+init_os_event()
+{
+  OsEvent ret = {0};
+  ret.handle  = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+  ASSERT_MSG_FATAL(ret.handle != nullptr, "Failed to create event: 0x%x", GetLastError());
+
+  return ret;
+}
+
+void
+destroy_os_event(OsEvent* event)
+{
+  CloseHandle(event->handle);
+  zero_memory(event, sizeof(OsEvent));
+}
+
+void
+os_event_signal(OsEvent* event)
+{
+  SetEvent(event->handle);
+}
+
+bool
+os_event_wait(OsEvent* event, u32 timeout_ms)
+{
+  DWORD ret = WaitForSingleObject(event->handle, timeout_ms == U32_MAX ? INFINITE : timeout_ms);
+  ASSERT_MSG(ret == WAIT_OBJECT_0 || ret == WAIT_TIMEOUT, "WaitForSingleObject failed with error 0x%x", GetLastError());
+
+  return ret == WAIT_OBJECT_0;
+}
+
+#else
+
+// cpu_set_t is fixed at 1024 cpus, the dynamically sized version is the one that goes past that
+static void
+to_cpu_set_t(const CpuSet& cpus, cpu_set_t* dst, size_t size)
+{
+  ASSERT_MSG_FATAL(cpu_set_count(cpus) > 0, "Can't restrict a thread to an empty CpuSet.");
+
+  CPU_ZERO_S(size, dst);
+  for (u32 cpu = 0; cpu < kMaxCpuCount; cpu++)
+  {
+    if (cpu_set_contains(cpus, cpu))
+    {
+      CPU_SET_S(cpu, size, dst);
+    }
+  }
+}
+
+static void*
+thread_entry_proc(void* void_param)
+{
+  return (void*)(uintptr_t)run_thread_entry_proc(void_param);
+}
+
+Thread
+init_thread(
+  AllocHeap heap,
+  u64 stack_size,
+  ThreadProc proc,
+  void* param,
+  const CpuSet& cpus
+) {
+  ThreadEntryProcParams* params = HEAP_ALLOC(ThreadEntryProcParams, heap, 1);
+  params->proc          = proc;
+  params->user_param    = param;
+
+  // The affinity goes on the attributes so the thread never gets a chance to run anywhere else
+  cpu_set_t* set  = CPU_ALLOC(kMaxCpuCount);
+  size_t     size = CPU_ALLOC_SIZE(kMaxCpuCount);
+  defer { CPU_FREE(set); };
+  to_cpu_set_t(cpus, set, size);
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  defer { pthread_attr_destroy(&attr); };
+  if (stack_size != 0)
+  {
+    pthread_attr_setstacksize(&attr, MAX(ALIGN_POW2(stack_size, (u64)kPageSize), (u64)PTHREAD_STACK_MIN));
+  }
+
+  pthread_attr_setaffinity_np(&attr, size, set);
+
+  Thread ret = {0};
+  int    res = pthread_create(&ret.handle, &attr, &thread_entry_proc, params);
+  ASSERT_MSG_FATAL(res == 0, "Failed to create thread: %d", res);
+
+  return ret;
+}
+
+// NOTE(bshihabi): Unlike CloseHandle this can't let go of a thread that's still running, join it first.
+void
+destroy_thread(Thread* thread)
+{
+  zero_memory(thread, sizeof(Thread));
+}
+
+u32
+get_num_physical_cores()
+{
+  return (u32)sysconf(_SC_NPROCESSORS_ONLN);
+}
+
+// Linux thread names are at most 15 chars and there's no wide version
+static void
+set_pthread_name(pthread_t thread, const wchar_t* name)
+{
+  char   buf[16];
+  size_t len = 0;
+  for (; len < sizeof(buf) - 1 && name[len] != 0; len++)
+  {
+    buf[len] = name[len] < 0x80 ? (char)name[len] : '?';
+  }
+  buf[len] = 0;
+
+  pthread_setname_np(thread, buf);
+}
+
+void
+set_thread_name(const Thread* thread, const wchar_t* name)
+{
+  set_pthread_name(thread->handle, name);
+}
+
+void
+set_current_thread_name(const wchar_t* name)
+{
+  set_pthread_name(pthread_self(), name);
+}
+
+void
+join_threads(const Thread* threads, u32 count)
+{
+  for (u32 ithread = 0; ithread < count; ithread++)
+  {
+    pthread_join(threads[ithread].handle, nullptr);
+  }
+}
+
+bool
+set_thread_affinity(const Thread* thread, const CpuSet& cpus)
+{
+  ASSERT_MSG_FATAL(cpu_set_count(cpus) > 0, "Can't restrict a thread to an empty CpuSet.");
+
+  cpu_set_t* set  = CPU_ALLOC(kMaxCpuCount);
+  size_t     size = CPU_ALLOC_SIZE(kMaxCpuCount);
+  defer { CPU_FREE(set); };
+  to_cpu_set_t(cpus, set, size);
+
+  return pthread_setaffinity_np(thread->handle, size, set) == 0;
+}
+
+bool
+set_current_thread_affinity(const CpuSet& cpus)
+{
+  Thread self = {0};
+  self.handle = pthread_self();
+  return set_thread_affinity(&self, cpus);
+}
+
+void
+yield_current_thread()
+{
+  sched_yield();
+}
+
+static u64
+get_monotonic_ns()
+{
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (u64)now.tv_sec * 1000000000ULL + (u64)now.tv_nsec;
+}
+
+static u64
+get_monotonic_ms()
+{
+  return get_monotonic_ns() / 1000000ULL;
+}
+
+// Parking lot, the same idea as WebKit's WTF::ParkingLot (and what WaitOnAddress does under the hood on Windows).
+//
+// A thread that waits on an address gets queued in a bucket picked by hashing the address and goes to sleep on a
+// futex of its own, so any address of any size can be waited on. Wakes check the bucket's parked count first, so
+// waking an address nobody is waiting on never goes into the kernel, which the futex syscall always does.
+struct ParkedThread
+{
+  const void*   address  = nullptr;
+  ParkedThread* next     = nullptr;
+  // Set to 1 when the thread gets unparked, the thread sleeps on this. Accessed atomically.
+  u32           unparked = 0;
+  // Protected by the bucket lock
+  bool          queued   = false;
+};
+
+struct alignas(kCacheLineSize) ParkingLotBucket
+{
+  SpinLock      lock;
+  // How many threads are queued (or about to be) in this bucket. Accessed atomically.
+  u32           parked_count = 0;
+  ParkedThread* head         = nullptr;
+  ParkedThread* tail         = nullptr;
+};
+
+static constexpr u32    kParkingLotBucketCount = 256;
+static ParkingLotBucket g_ParkingLot[kParkingLotBucketCount];
+
+static ParkingLotBucket*
+get_parking_lot_bucket(const void* address)
+{
+  // Addresses that get waited on are usually aligned, so mix the bits before picking a bucket
+  u64 key  = (u64)(uintptr_t)address;
+  key     ^= key >> 33;
+  key     *= 0xFF51AFD7ED558CCDULL;
+  key     ^= key >> 33;
+  return &g_ParkingLot[key % kParkingLotBucketCount];
+}
+
+static void
+futex_wait(u32* address, u32 expected, const timespec* timeout)
+{
+  syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, expected, timeout, nullptr, 0);
+}
+
+static void
+futex_wake(u32* address, s32 count)
+{
+  syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+
+// Sleeps until unparked gets set. Returns false if the timeout elapsed first.
+static bool
+park_thread(u32* unparked, u32 timeout_ms)
+{
+  u64 deadline = timeout_ms == U32_MAX ? U64_MAX : get_monotonic_ns() + (u64)timeout_ms * 1000000ULL;
+  while (atomic_ref_load(unparked, std::memory_order_acquire) == 0)
+  {
+    timespec  timeout;
+    timespec* timeout_ptr = nullptr;
+    if (deadline != U64_MAX)
+    {
+      u64 now = get_monotonic_ns();
+      if (now >= deadline)
+      {
+        return false;
+      }
+
+      u64 remaining   = deadline - now;
+      timeout.tv_sec  = (time_t)(remaining / 1000000000ULL);
+      timeout.tv_nsec = (long)(remaining % 1000000000ULL);
+      timeout_ptr     = &timeout;
+    }
+
+    futex_wait(unparked, 0, timeout_ptr);
+  }
+
+  return true;
+}
+
+static void
+unpark_threads(const void* address, u32 max_count)
+{
+  ParkingLotBucket* bucket = get_parking_lot_bucket(address);
+
+  // Pairs with the fence in wait_on_address. Whatever the caller stored to address before this is either seen by
+  // the waiter when it checks the value, or the waiter shows up in parked_count here.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (atomic_ref_load(&bucket->parked_count, std::memory_order_relaxed) == 0)
+  {
+    return;
+  }
+
+  ParkedThread* unparked = nullptr;
+  u32           count    = 0;
+
+  spin_acquire(&bucket->lock);
+  ParkedThread*  prev = nullptr;
+  ParkedThread** link = &bucket->head;
+  while (*link != nullptr && count < max_count)
+  {
+    ParkedThread* thread = *link;
+    if (thread->address != address)
+    {
+      prev = thread;
+      link = &thread->next;
+      continue;
+    }
+
+    *link = thread->next;
+    if (bucket->tail == thread)
+    {
+      bucket->tail = prev;
+    }
+
+    thread->queued = false;
+    thread->next   = unparked;
+    unparked       = thread;
+    count++;
+  }
+  atomic_ref_fetch_sub(&bucket->parked_count, count, std::memory_order_relaxed);
+  spin_release(&bucket->lock);
+
+  while (unparked != nullptr)
+  {
+    // NOTE(bshihabi): The parked thread lives on its own stack and can return as soon as unparked is set, so
+    // nothing can be read from it after that. Waking a futex on memory that got reused is harmless though.
+    ParkedThread* next = unparked->next;
+    u32*          word = &unparked->unparked;
+    atomic_ref_store(word, 1U, std::memory_order_release);
+    futex_wake(word, 1);
+
+    unparked = next;
+  }
+}
+
+static bool
+address_has_value(const void* address, const void* compare, size_t size)
+{
+  switch (size)
+  {
+    case 1: return atomic_ref_load((u8*) address, std::memory_order_relaxed) == *(const u8*) compare;
+    case 2: return atomic_ref_load((u16*)address, std::memory_order_relaxed) == *(const u16*)compare;
+    case 4: return atomic_ref_load((u32*)address, std::memory_order_relaxed) == *(const u32*)compare;
+    case 8: return atomic_ref_load((u64*)address, std::memory_order_relaxed) == *(const u64*)compare;
+    default: UNREACHABLE;
+  }
+}
+
+bool
+wait_on_address(const void* address, const void* compare, size_t size, u32 timeout_ms)
+{
+  ASSERT_MSG_FATAL(size == 1 || size == 2 || size == 4 || size == 8, "wait_on_address only supports values of 1, 2, 4, or 8 bytes, got %llu.", size);
+
+  ParkingLotBucket* bucket = get_parking_lot_bucket(address);
+
+  ParkedThread self;
+  self.address = address;
+
+  atomic_ref_fetch_add(&bucket->parked_count, 1U, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  spin_acquire(&bucket->lock);
+  if (!address_has_value(address, compare, size))
+  {
+    spin_release(&bucket->lock);
+    atomic_ref_fetch_sub(&bucket->parked_count, 1U, std::memory_order_relaxed);
+    return true;
+  }
+
+  self.queued = true;
+  if (bucket->tail != nullptr)
+  {
+    bucket->tail->next = &self;
+  }
+  else
+  {
+    bucket->head = &self;
+  }
+  bucket->tail = &self;
+  spin_release(&bucket->lock);
+
+  if (park_thread(&self.unparked, timeout_ms))
+  {
+    return true;
+  }
+
+  spin_acquire(&bucket->lock);
+  bool timed_out = self.queued;
+  if (timed_out)
+  {
+    ParkedThread*  prev = nullptr;
+    ParkedThread** link = &bucket->head;
+    while (*link != &self)
+    {
+      prev = *link;
+      link = &(*link)->next;
+    }
+
+    *link = self.next;
+    if (bucket->tail == &self)
+    {
+      bucket->tail = prev;
+    }
+    atomic_ref_fetch_sub(&bucket->parked_count, 1U, std::memory_order_relaxed);
+  }
+  spin_release(&bucket->lock);
+
+  if (!timed_out)
+  {
+    // Got unparked right as the timeout hit. self can't go out of scope until the unparker is done with it.
+    park_thread(&self.unparked, U32_MAX);
+  }
+
+  return !timed_out;
+}
+
+void
+wake_one_on_address(const void* address)
+{
+  unpark_threads(address, 1);
+}
+
+void
+wake_all_on_address(const void* address)
+{
+  unpark_threads(address, U32_MAX);
+}
+
+// How many times to retry a contended lock before going to sleep. Most critical sections are short enough that
+// the holder is done well before a trip through the parking lot would be.
+static constexpr u32 kLockSpinCount = 128;
+
+static constexpr u32 kMutexUnlocked  = 0;
+static constexpr u32 kMutexLocked    = 1;
+static constexpr u32 kMutexContended = 2;
+
+void
+mutex_acquire(Mutex* mutex)
+{
+  for (u32 ispin = 0; ispin < kLockSpinCount; ispin++)
+  {
+    u32 state = atomic_ref_load(&mutex->state, std::memory_order_relaxed);
+    if (state == kMutexUnlocked && atomic_ref_compare_exchange_strong(&mutex->state, &state, kMutexLocked, std::memory_order_acquire))
+    {
+      return;
+    }
+    _mm_pause();
+  }
+
+  // From here on we have to assume somebody else is asleep too, so the mutex gets marked contended for whoever
+  // releases it to wake the next one up.
+  while (atomic_ref_exchange(&mutex->state, kMutexContended, std::memory_order_acquire) != kMutexUnlocked)
+  {
+    u32 contended = kMutexContended;
+    wait_on_address(&mutex->state, &contended, sizeof(contended));
+  }
+}
+
+bool
+try_mutex_acquire(Mutex* mutex)
+{
+  u32 state = kMutexUnlocked;
+  return atomic_ref_compare_exchange_strong(&mutex->state, &state, kMutexLocked, std::memory_order_acquire);
+}
+
+void
+mutex_release(Mutex* mutex)
+{
+  if (atomic_ref_exchange(&mutex->state, kMutexUnlocked, std::memory_order_release) == kMutexContended)
+  {
+    wake_one_on_address(&mutex->state);
+  }
+}
+
+static constexpr u32 kRWLockWriter = 1U << 31;
+static constexpr u32 kRWLockParked = 1U << 30;
+
+// Marks that someone is asleep on the lock and sleeps until the state changes. Doesn't sleep at all if the state
+// already changed from what the caller saw.
+static void
+park_on_rw_lock(RWLock* lock, u32 state)
+{
+  if ((state & kRWLockParked) == 0)
+  {
+    if (!atomic_ref_compare_exchange_strong(&lock->state, &state, state | kRWLockParked, std::memory_order_relaxed))
+    {
+      return;
+    }
+    state |= kRWLockParked;
+  }
+
+  wait_on_address(&lock->state, &state, sizeof(state));
+}
+
+void
+rw_acquire_read(RWLock* lock)
+{
+  for (u32 ispin = 0;; ispin++)
+  {
+    u32 state = atomic_ref_load(&lock->state, std::memory_order_relaxed);
+    if ((state & kRWLockWriter) == 0 && atomic_ref_load(&lock->writers_waiting, std::memory_order_relaxed) == 0)
+    {
+      if (atomic_ref_compare_exchange_strong(&lock->state, &state, state + 1, std::memory_order_acquire))
+      {
+        return;
+      }
+      continue;
+    }
+
+    if (ispin < kLockSpinCount)
+    {
+      _mm_pause();
+      continue;
+    }
+
+    park_on_rw_lock(lock, state);
+  }
+}
+
+void
+rw_release_read(RWLock* lock)
+{
+  u32 state = atomic_ref_fetch_sub(&lock->state, 1U, std::memory_order_release) - 1;
+  // Last reader out wakes up whoever is waiting, which is usually a writer
+  if (state == kRWLockParked && atomic_ref_compare_exchange_strong(&lock->state, &state, 0U, std::memory_order_relaxed))
+  {
+    wake_all_on_address(&lock->state);
+  }
+}
+
+void
+rw_acquire_write(RWLock* lock)
+{
+  atomic_ref_fetch_add(&lock->writers_waiting, 1U, std::memory_order_relaxed);
+  for (u32 ispin = 0;; ispin++)
+  {
+    u32 state = atomic_ref_load(&lock->state, std::memory_order_relaxed);
+    if ((state & ~kRWLockParked) == 0)
+    {
+      if (atomic_ref_compare_exchange_strong(&lock->state, &state, state | kRWLockWriter, std::memory_order_acquire))
+      {
+        break;
+      }
+      continue;
+    }
+
+    if (ispin < kLockSpinCount)
+    {
+      _mm_pause();
+      continue;
+    }
+
+    park_on_rw_lock(lock, state);
+  }
+  atomic_ref_fetch_sub(&lock->writers_waiting, 1U, std::memory_order_relaxed);
+}
+
+void
+rw_release_write(RWLock* lock)
+{
+  // Nobody else can change the state while we hold it except to set the parked bit
+  if (atomic_ref_exchange(&lock->state, 0U, std::memory_order_release) & kRWLockParked)
+  {
+    wake_all_on_address(&lock->state);
+  }
+}
+
+bool
+cond_var_wait(CondVar* cond_var, Mutex* mutex, u32 timeout_ms)
+{
+  // Anyone that notifies after we let go of the mutex has to bump the sequence first, so the wait can't miss it
+  u32 sequence = atomic_ref_load(&cond_var->sequence, std::memory_order_relaxed);
+  mutex_release(mutex);
+
+  bool ret = wait_on_address(&cond_var->sequence, &sequence, sizeof(sequence), timeout_ms);
+
+  mutex_acquire(mutex);
+  return ret;
+}
+
+void
+cond_var_notify_one(CondVar* cond_var)
+{
+  atomic_ref_fetch_add(&cond_var->sequence, 1U);
+  wake_one_on_address(&cond_var->sequence);
+}
+
+void
+cond_var_notify_all(CondVar* cond_var)
+{
+  atomic_ref_fetch_add(&cond_var->sequence, 1U);
+  wake_all_on_address(&cond_var->sequence);
+}
+
+OsEvent
+init_os_event()
+{
+  OsEvent ret = {0};
+  ret.fd      = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  ASSERT_MSG_FATAL(ret.fd >= 0, "Failed to create eventfd: %d", errno);
+
+  return ret;
+}
+
+void
+destroy_os_event(OsEvent* event)
+{
+  close(event->fd);
+  event->fd = -1;
+}
+
+void
+os_event_signal(OsEvent* event)
+{
+  // Adds to the counter, which is what makes signals coalesce until the next read
+  u64 one = 1;
+  ssize_t written = write(event->fd, &one, sizeof(one));
+  ASSERT_MSG(written == sizeof(one) || errno == EAGAIN, "Failed to signal eventfd: %d", errno);
+}
+
+bool
+os_event_wait(OsEvent* event, u32 timeout_ms)
+{
+  u64 deadline = timeout_ms == U32_MAX ? U64_MAX : get_monotonic_ms() + timeout_ms;
+  for (;;)
+  {
+    // Reading takes the whole count and resets it, which is the auto reset part
+    u64 count = 0;
+    if (read(event->fd, &count, sizeof(count)) == sizeof(count))
+    {
+      return true;
+    }
+    ASSERT_MSG(errno == EAGAIN, "Failed to read eventfd: %d", errno);
+
+    s32 timeout = -1;
+    if (deadline != U64_MAX)
+    {
+      u64 now = get_monotonic_ms();
+      if (now >= deadline)
+      {
+        return false;
+      }
+      timeout = (s32)MIN(deadline - now, (u64)S32_MAX);
+    }
+
+    pollfd poll_fd = {0};
+    poll_fd.fd     = event->fd;
+    poll_fd.events = POLLIN;
+    poll(&poll_fd, 1, timeout);
+  }
+}
+
+#endif
+
+Thread
+init_thread(
+  AllocHeap heap,
+  u64 stack_size,
+  ThreadProc proc,
+  void* param,
+  u32 core_index
+) {
+  CpuSet cpus;
+  cpu_set_add(&cpus, core_index);
+
+  return init_thread(heap, stack_size, proc, param, cpus);
+}
+
+Event
+init_event(bool manual_reset, bool initially_signaled)
+{
+  Event ret        = {0};
+  ret.signaled     = initially_signaled ? 1 : 0;
+  ret.manual_reset = manual_reset ? 1 : 0;
+
+  return ret;
+}
+
+void
+event_signal(Event* event)
+{
+  atomic_ref_store(&event->signaled, 1U, std::memory_order_release);
+  if (event->manual_reset)
+  {
+    wake_all_on_address(&event->signaled);
+  }
+  else
+  {
+    wake_one_on_address(&event->signaled);
+  }
+}
+
+void
+event_reset(Event* event)
+{
+  atomic_ref_store(&event->signaled, 0U, std::memory_order_relaxed);
+}
+
+bool
+event_wait(Event* event, u32 timeout_ms)
+{
+  u64 deadline = timeout_ms == U32_MAX ? U64_MAX : get_monotonic_ms() + timeout_ms;
+  for (;;)
+  {
+    if (event->manual_reset)
+    {
+      if (atomic_ref_load(&event->signaled, std::memory_order_acquire) != 0)
+      {
+        return true;
+      }
+    }
+    else
+    {
+      // Auto reset events let exactly one waiter through per signal
+      u32 signaled = 1;
+      if (atomic_ref_compare_exchange_strong(&event->signaled, &signaled, 0U, std::memory_order_acquire))
+      {
+        return true;
+      }
+    }
+
+    u32 timeout = U32_MAX;
+    if (deadline != U64_MAX)
+    {
+      u64 now = get_monotonic_ms();
+      if (now >= deadline)
+      {
+        return false;
+      }
+      timeout = (u32)(deadline - now);
+    }
+
+    u32 unsignaled = 0;
+    wait_on_address(&event->signaled, &unsignaled, sizeof(unsignaled), timeout);
+  }
+}
+
 ThreadSignal
 init_thread_signal()
 {
   ThreadSignal ret = {0};
-  InitializeConditionVariable(&ret.cond_var);
   return ret;
 }
 
 void
 wait_for_thread_signal(ThreadSignal* signal)
 {
-  AcquireSRWLockExclusive(&signal->lock);
-  SleepConditionVariableSRW(&signal->cond_var, &signal->lock, INFINITE, 0);
-  ReleaseSRWLockExclusive(&signal->lock);
+  mutex_acquire(&signal->lock);
+  cond_var_wait(&signal->cond_var, &signal->lock);
+  mutex_release(&signal->lock);
 }
 
 void
 notify_one_thread_signal(ThreadSignal* signal)
 {
-  WakeConditionVariable(&signal->cond_var);
+  cond_var_notify_one(&signal->cond_var);
 }
 
 void
 notify_all_thread_signal(ThreadSignal* signal)
 {
-  WakeAllConditionVariable(&signal->cond_var);
+  cond_var_notify_all(&signal->cond_var);
+}
+
+// The backoff doubles up to this many pauses, after that every retry yields the thread too
+static constexpr u32 kSpinLockMaxBackoff = 64;
+
+static bool
+try_take_spin_lock(SpinLock* spin_lock)
+{
+  // Only try the exchange when it looks free so waiters spin on a shared cache line instead of bouncing it around
+  return atomic_ref_load(&spin_lock->value, std::memory_order_relaxed) == 0 &&
+         atomic_ref_exchange(&spin_lock->value, 1ULL, std::memory_order_acquire) == 0;
 }
 
 SpinLock
@@ -164,29 +1057,52 @@ init_spin_lock()
 void
 spin_acquire(SpinLock* spin_lock)
 {
-  for (;;)
+  u32 backoff = 1;
+  while (!try_take_spin_lock(spin_lock))
   {
-    if (InterlockedCompareExchange(&spin_lock->value, 1, 0) == 0)
-      break;
-    _mm_pause();
+    for (u32 ipause = 0; ipause < backoff; ipause++)
+    {
+      _mm_pause();
+    }
+
+    if (backoff < kSpinLockMaxBackoff)
+    {
+      backoff <<= 1;
+    }
+    else
+    {
+      // Whoever holds it might not even be running, especially with more threads than cores
+      yield_current_thread();
+    }
   }
 }
 
 bool
 try_spin_acquire(SpinLock* spin_lock, u64 max_cycles)
 {
-  while (max_cycles-- != 0)
+  u64 backoff = 1;
+  while (!try_take_spin_lock(spin_lock))
   {
-    if (InterlockedCompareExchange(&spin_lock->value, 1, 0) == 0)
-      return true;
-    _mm_pause();
+    if (max_cycles == 0)
+    {
+      return false;
+    }
+
+    u64 pauses = MIN(backoff, max_cycles);
+    for (u64 ipause = 0; ipause < pauses; ipause++)
+    {
+      _mm_pause();
+    }
+
+    max_cycles -= pauses;
+    backoff     = MIN(backoff << 1, (u64)kSpinLockMaxBackoff);
   }
 
-  return false;
+  return true;
 }
 
 void
 spin_release(SpinLock* spin_lock)
 {
-  spin_lock->value = 0;
+  atomic_ref_store(&spin_lock->value, 0ULL, std::memory_order_release);
 }
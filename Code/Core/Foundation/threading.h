@@ -4,6 +4,13 @@
 
 #include <atomic>
 
+#if !defined(_WIN32)
+#include <pthread.h>
+#endif
+
+// Windows uses the OS primitives (SRWLOCK, CONDITION_VARIABLE, WaitOnAddress) directly. On Linux the locks are
+// built on wait_on_address, which is implemented with a parking lot on top of futexes (see threading.cpp).
+
 typedef u32 (*ThreadProc)(void*);
 
 // NOTE(bshihabi): I would've really preferred to use the intrinsics here, but it's just too complicated for me to reasonably do
@@ -12,27 +19,95 @@ using Atomic = std::atomic<T>;
 
 struct Thread
 {
-  HANDLE handle = nullptr;
-  DWORD id = 0;
+#if defined(_WIN32)
+  HANDLE    handle = nullptr;
+  DWORD     id     = 0;
+#else
+  pthread_t handle = 0;
+#endif
 };
 
+// Logical processor indices. On Windows these count across every processor group, so group 1 starts at 64.
+static constexpr u32 kMaxCpuCount = 1024;
+
+struct CpuSet
+{
+  u64 masks[kMaxCpuCount / 64] = {0};
+};
+
+inline void
+cpu_set_add(CpuSet* cpus, u32 cpu)
+{
+  ASSERT_MSG_FATAL(cpu < kMaxCpuCount, "CPU index %u is invalid, must be < %u", cpu, kMaxCpuCount);
+  cpus->masks[cpu / 64] |= 1ULL << (cpu % 64);
+}
+
+inline void
+cpu_set_remove(CpuSet* cpus, u32 cpu)
+{
+  ASSERT_MSG_FATAL(cpu < kMaxCpuCount, "CPU index %u is invalid, must be < %u", cpu, kMaxCpuCount);
+  cpus->masks[cpu / 64] &= ~(1ULL << (cpu % 64));
+}
+
+inline bool
+cpu_set_contains(const CpuSet& cpus, u32 cpu)
+{
+  return cpu < kMaxCpuCount && (cpus.masks[cpu / 64] & (1ULL << (cpu % 64))) != 0;
+}
+
+inline u32
+cpu_set_count(const CpuSet& cpus)
+{
+  u32 ret = 0;
+  for (u64 mask : cpus.masks)
+  {
+    ret += (u32)count_num_bits(mask);
+  }
+  return ret;
+}
+
+// The thread only ever runs on cpus, it gets restricted before it starts running.
 FOUNDATION_API Thread init_thread(
   AllocHeap heap,
   u64 stack_size,
   ThreadProc proc,
   void* param,
-  u8 core_index
+  const CpuSet& cpus
+);
+
+// The thread gets pinned to core_index, which is a logical processor index like in CpuSet.
+FOUNDATION_API Thread init_thread(
+  AllocHeap heap,
+  u64 stack_size,
+  ThreadProc proc,
+  void* param,
+  u32 core_index
 );
 
 FOUNDATION_API void destroy_thread(Thread* thread);
+// NOTE(bshihabi): This is actually the number of logical processors, across every processor group on Windows.
 FOUNDATION_API u32 get_num_physical_cores();
 FOUNDATION_API void set_thread_name(const Thread* thread, const wchar_t* name);
 FOUNDATION_API void set_current_thread_name(const wchar_t* name);
 FOUNDATION_API void join_threads(const Thread* threads, u32 count);
 
+// Restricts the thread to the cpus in the set. On Windows a set that fits in one processor group is a hard affinity,
+// anything that spans groups goes through CPU Sets which the scheduler treats as a (strong) preference instead.
+FOUNDATION_API bool set_thread_affinity(const Thread* thread, const CpuSet& cpus);
+FOUNDATION_API bool set_current_thread_affinity(const CpuSet& cpus);
+// Gives up the rest of the calling thread's time slice.
+FOUNDATION_API void yield_current_thread();
+
 struct RWLock
 {
-  SRWLOCK lock = {0};
+#if defined(_WIN32)
+  SRWLOCK lock            = {0};
+#else
+  // Reader count, kRWLockWriter while a writer holds it, kRWLockParked when someone is sleeping on it. Accessed atomically.
+  u32     state           = 0;
+  // New readers back off while this is non-zero so writers can't get starved. Accessed atomically.
+  u32     writers_waiting = 0;
+#endif
 };
 
 FOUNDATION_API void rw_acquire_read(RWLock* lock);
@@ -42,16 +117,73 @@ FOUNDATION_API void rw_release_write(RWLock* lock);
 
 struct Mutex
 {
-  SRWLOCK lock = {0};
+#if defined(_WIN32)
+  SRWLOCK lock  = {0};
+#else
+  // 0 when unlocked, 1 when locked, 2 when locked and someone might be sleeping on it. Accessed atomically.
+  u32     state = 0;
+#endif
 };
 
-FOUNDATION_API void mutex_acquire(Mutex* mutex);
-FOUNDATION_API void mutex_release(Mutex* mutex);
+FOUNDATION_API                    void mutex_acquire(Mutex* mutex);
+FOUNDATION_API DONT_IGNORE_RETURN bool try_mutex_acquire(Mutex* mutex);
+FOUNDATION_API                    void mutex_release(Mutex* mutex);
+
+struct CondVar
+{
+#if defined(_WIN32)
+  CONDITION_VARIABLE cond_var = {0};
+#else
+  // Bumped by every notify, waiters sleep on it. Accessed atomically.
+  u32                sequence = 0;
+#endif
+};
+
+// The mutex has to be held by the caller, it gets released while sleeping and is held again when this returns.
+// Can wake up spuriously, so always wait in a loop on whatever condition you're waiting for.
+// Returns false if the timeout elapsed.
+FOUNDATION_API bool cond_var_wait(CondVar* cond_var, Mutex* mutex, u32 timeout_ms = U32_MAX);
+FOUNDATION_API void cond_var_notify_one(CondVar* cond_var);
+FOUNDATION_API void cond_var_notify_all(CondVar* cond_var);
+
+// Like a Win32 event. An auto reset event lets one waiter through per signal and resets itself, a manual reset
+// event lets every waiter through until it gets reset.
+struct Event
+{
+  // 1 when signaled. Accessed atomically.
+  u32 signaled     = 0;
+  u32 manual_reset = 0;
+};
+
+FOUNDATION_API Event init_event(bool manual_reset, bool initially_signaled = false);
+FOUNDATION_API void  event_signal(Event* event);
+FOUNDATION_API void  event_reset(Event* event);
+// Returns false if the timeout elapsed before the event was signaled.
+FOUNDATION_API bool  event_wait(Event* event, u32 timeout_ms = U32_MAX);
+
+// An auto reset event backed by a kernel object (a Win32 event, an eventfd on Linux) instead of an address, so the
+// kernel can signal it too. Overlapped reads and GPU fences can be pointed at one of these, which is how a thread
+// sleeps on its own queues, IO completions and fences all at once.
+struct OsEvent
+{
+#if defined(_WIN32)
+  HANDLE handle = nullptr;
+#else
+  s32    fd     = -1;
+#endif
+};
+
+FOUNDATION_API OsEvent init_os_event();
+FOUNDATION_API void    destroy_os_event(OsEvent* event);
+// Signals coalesce, a bunch of them before the next wait only let one wait through.
+FOUNDATION_API void    os_event_signal(OsEvent* event);
+// Returns false if the timeout elapsed before the event was signaled.
+FOUNDATION_API bool    os_event_wait(OsEvent* event, u32 timeout_ms = U32_MAX);
 
 struct ThreadSignal
 {
-  CONDITION_VARIABLE cond_var;
-  SRWLOCK lock = {0};
+  CondVar cond_var;
+  Mutex   lock;
 };
 
 FOUNDATION_API ThreadSignal init_thread_signal();
@@ -64,8 +196,11 @@ struct SpinLock
   u64 value = 0;
 };
 
+// Contended acquires back off exponentially (in pauses) so that waiters aren't all hammering the cache line,
+// and start yielding the thread once the backoff maxes out so a preempted holder gets a chance to run.
 FOUNDATION_API                    SpinLock init_spin_lock();
 FOUNDATION_API                    void spin_acquire(SpinLock* spin_lock);
+// max_cycles is how many pauses to spend waiting before giving up.
 FOUNDATION_API DONT_IGNORE_RETURN bool try_spin_acquire(SpinLock* spin_lock, u64 max_cycles);
 FOUNDATION_API                    void spin_release(SpinLock* spin_lock);
 
@@ -149,12 +284,74 @@ atomic_add(Atomic<T>* lhs, T rhs)
   lhs->fetch_add(rhs, std::memory_order_relaxed);
 }
 
+template <typename T>
+inline bool
+atomic_compare_exchange(Atomic<T>* lhs, T rhs, T* expected)
+{
+  return lhs->compare_exchange_weak(*expected, rhs);
+}
+
+// Structs that get returned by value from init_* functions can't hold std::atomic members since those aren't copyable,
+// so shared fields in those are plain integers/pointers that get accessed through these.
+template <typename T>
+inline T
+atomic_ref_load(T* src, std::memory_order order = std::memory_order_seq_cst)
+{
+  return std::atomic_ref<T>(*src).load(order);
+}
+
+template <typename T>
+inline void
+atomic_ref_store(T* dst, std::type_identity_t<T> value, std::memory_order order = std::memory_order_seq_cst)
+{
+  std::atomic_ref<T>(*dst).store(value, order);
+}
+
+template <typename T>
+inline T
+atomic_ref_fetch_add(T* dst, std::type_identity_t<T> value, std::memory_order order = std::memory_order_seq_cst)
+{
+  return std::atomic_ref<T>(*dst).fetch_add(value, order);
+}
+
+template <typename T>
+inline T
+atomic_ref_fetch_sub(T* dst, std::type_identity_t<T> value, std::memory_order order = std::memory_order_seq_cst)
+{
+  return std::atomic_ref<T>(*dst).fetch_sub(value, order);
+}
 
+template <typename T>
+inline T
+atomic_ref_fetch_or(T* dst, std::type_identity_t<T> value, std::memory_order order = std::memory_order_seq_cst)
+{
+  return std::atomic_ref<T>(*dst).fetch_or(value, order);
+}
+
+template <typename T>
+inline T
+atomic_ref_exchange(T* dst, std::type_identity_t<T> value, std::memory_order order = std::memory_order_seq_cst)
+{
+  return std::atomic_ref<T>(*dst).exchange(value, order);
+}
 
 template <typename T>
 inline bool
-atomic_compare_exchange(Atomic<T>* lhs, T rhs, T* expected)
+atomic_ref_compare_exchange(T* dst, T* expected, std::type_identity_t<T> desired, std::memory_order order = std::memory_order_seq_cst)
+{
+  return std::atomic_ref<T>(*dst).compare_exchange_weak(*expected, desired, order, std::memory_order_relaxed);
+}
+
+// Only use this over atomic_ref_compare_exchange when a spurious failure can't just be retried.
+template <typename T>
+inline bool
+atomic_ref_compare_exchange_strong(T* dst, T* expected, std::type_identity_t<T> desired, std::memory_order order = std::memory_order_seq_cst)
 {
-  lhs->compare_exchange_weak(*expected, rhs);
+  return std::atomic_ref<T>(*dst).compare_exchange_strong(*expected, desired, order, std::memory_order_relaxed);
 }
 
+// Blocks the calling thread while the value at address still matches compare (size must be 1, 2, 4, or 8 bytes). This can wake up
+// spuriously, so always re-check whatever condition you were waiting on. Returns false if the timeout elapsed.
+FOUNDATION_API bool wait_on_address(const void* address, const void* compare, size_t size, u32 timeout_ms = U32_MAX);
+FOUNDATION_API void wake_one_on_address(const void* address);
+FOUNDATION_API void wake_all_on_address(const void* address);
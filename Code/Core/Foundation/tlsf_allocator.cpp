@@ -68,80 +68,416 @@ ufloat8_to_u32(UFloat8 val)
   return (val.as_float.mantissa | UFloat8::kMantissaValue) << (val.as_float.exponent - 1);
 }
 
-static constexpr u32 kNumTopBins     = 1ULL << UFloat8::kExponentBits;
-static constexpr u32 kNumBinsPerLeaf = 1ULL << UFloat8::kMantissaBits;
-static constexpr u32 kNumLeafBins    = kNumTopBins * kNumBinsPerLeaf;
+static constexpr u32 kNumTopBins     = TlsfSubAllocator::kNumTopBins;
+static constexpr u32 kNumBinsPerLeaf = TlsfSubAllocator::kNumBinsPerLeaf;
+static constexpr u32 kNumLeafBins    = TlsfSubAllocator::kNumLeafBins;
+static constexpr u32 kNullIndex      = TlsfSubAllocator::kNullIndex;
 
 static u32
-insert_node_into_bin(TlsfSubAllocator* self, u32 size, u32 offset)
+pop_node(TlsfSubAllocator* self)
 {
-  UFloat8 bin_index = u32_to_ufloat8_round_down(size);
+  ASSERT_MSG_FATAL(self->free_offset > 0, "TLSF sub allocator ran out of nodes! Bump max_allocs (currently %u).", self->max_allocs);
+  return self->free_stack[--self->free_offset];
+}
+
+static void
+push_node(TlsfSubAllocator* self, u32 node_index)
+{
+  ASSERT(self->free_offset < self->max_allocs);
+  self->free_stack[self->free_offset++] = node_index;
+}
+
+static void
+insert_node_into_bin(TlsfSubAllocator* self, u32 node_index)
+{
+  auto* node = self->nodes + node_index;
+
+  // Free blocks go into the bin that is guaranteed to be _smaller_ than them, that way anything
+  // we pull out of a bin is always big enough.
+  UFloat8 bin_index = u32_to_ufloat8_round_down(node->size);
 
   u32 top_bin_index  = bin_index.as_float.exponent;
   u32 leaf_bin_index = bin_index.as_float.mantissa;
 
-  if (self->bin_indices[bin_index.as_uint] == TlsfSubAllocator::kNullIndex)
+  u32 next_node = self->bin_indices[bin_index.as_uint];
+  if (next_node == kNullIndex)
+  {
+    self->used_top                 |= 1U << top_bin_index;
+    self->used_leaf[top_bin_index] |= (u8)(1U << leaf_bin_index);
+  }
+  else
   {
-    self->used_top                 |= 1ULL << top_bin_index;
-    self->used_leaf[top_bin_index] |= 1ULL << leaf_bin_index;
+    self->nodes[next_node].bin_prev = node_index;
   }
 
-  u32 next_node = self->bin_indices[bin_index.as_uint];
-  u32 new_idx   = self->free_stack[self->free_offset--];
+  node->bin_prev = kNullIndex;
+  node->bin_next = next_node;
+  node->used     = false;
 
-  auto* dst = self->nodes + new_idx;
-  dst->offset   = offset;
-  dst->size     = size;
-  dst->bin_next = next_node;
+  self->bin_indices[bin_index.as_uint] = node_index;
+}
+
+static void
+remove_node_from_bin(TlsfSubAllocator* self, u32 node_index)
+{
+  auto* node = self->nodes + node_index;
 
-  if (next_node != TlsfSubAllocator::kNullIndex)
+  if (node->bin_prev != kNullIndex)
   {
-    self->nodes[next_node].bin_prev = new_idx;
+    self->nodes[node->bin_prev].bin_next = node->bin_next;
   }
 
-  self->bin_indices[bin_index.as_uint] = new_idx;
+  if (node->bin_next != kNullIndex)
+  {
+    self->nodes[node->bin_next].bin_prev = node->bin_prev;
+  }
+
+  UFloat8 bin_index = u32_to_ufloat8_round_down(node->size);
+  if (self->bin_indices[bin_index.as_uint] == node_index)
+  {
+    self->bin_indices[bin_index.as_uint] = node->bin_next;
 
-  return new_idx;
+    // That was the last block in the bin, so clear the bitfields
+    if (node->bin_next == kNullIndex)
+    {
+      u32 top_bin_index  = bin_index.as_float.exponent;
+      u32 leaf_bin_index = bin_index.as_float.mantissa;
+
+      self->used_leaf[top_bin_index] &= (u8)~(1U << leaf_bin_index);
+      if (self->used_leaf[top_bin_index] == 0)
+      {
+        self->used_top &= ~(1U << top_bin_index);
+      }
+    }
+  }
+
+  node->bin_prev = kNullIndex;
+  node->bin_next = kNullIndex;
+}
+
+// Finds the first non-empty bin with an index >= min_bin_index
+static u32
+find_free_bin(const TlsfSubAllocator* self, u32 min_bin_index)
+{
+  u32 top_bin_index  = min_bin_index >> UFloat8::kMantissaBits;
+  u32 leaf_bin_index = min_bin_index &  UFloat8::kMantissaMask;
+
+  // First try to find something in the same top level bin
+  u32 leaf_mask = (u32)self->used_leaf[top_bin_index] & (0xFFU << leaf_bin_index);
+  if (leaf_mask != 0)
+  {
+    return (top_bin_index << UFloat8::kMantissaBits) | count_trailing_zeroes(leaf_mask);
+  }
+
+  // Otherwise any block in the next non-empty top level bin is big enough, just take the smallest leaf
+  if (top_bin_index + 1 >= kNumTopBins)
+  {
+    return kNullIndex;
+  }
+
+  u32 top_mask = self->used_top & (~0U << (top_bin_index + 1));
+  if (top_mask == 0)
+  {
+    return kNullIndex;
+  }
+
+  top_bin_index  = count_trailing_zeroes(top_mask);
+  leaf_bin_index = count_trailing_zeroes((u32)self->used_leaf[top_bin_index]);
+
+  return (top_bin_index << UFloat8::kMantissaBits) | leaf_bin_index;
+}
+
+// Splits off the first `size` bytes of the node into their own block, returns the index of the new block
+// that was split off. The new block is inserted right before the node in the neighbor list.
+static u32
+split_node_front(TlsfSubAllocator* self, u32 node_index, u32 size)
+{
+  u32   front_index = pop_node(self);
+  auto* node        = self->nodes + node_index;
+  auto* front       = self->nodes + front_index;
+
+  ASSERT(size < node->size);
+
+  front->offset        = node->offset;
+  front->size          = size;
+  front->neighbor_prev = node->neighbor_prev;
+  front->neighbor_next = node_index;
+  if (front->neighbor_prev != kNullIndex)
+  {
+    self->nodes[front->neighbor_prev].neighbor_next = front_index;
+  }
+
+  node->offset        += size;
+  node->size          -= size;
+  node->neighbor_prev  = front_index;
+
+  return front_index;
 }
 
 TlsfSubAllocator
 init_tlsf_sub_allocator(AllocHeap heap, u32 size, u32 max_allocs)
 {
+  ASSERT_MSG_FATAL(size > 0 && max_allocs > 0, "Invalid TLSF sub allocator size 0x%x with max_allocs %u", size, max_allocs);
+
   TlsfSubAllocator ret = {0};
   ret.size       = size;
+  ret.used_size  = 0;
   ret.max_allocs = max_allocs;
+  ret.used_top   = 0;
 
+  zero_memory(ret.used_leaf, sizeof(ret.used_leaf));
   for (u32 i = 0; i < ARRAY_LENGTH(ret.bin_indices); i++)
   {
-    ret.bin_indices[i] = TlsfSubAllocator::kNullIndex;
+    ret.bin_indices[i] = kNullIndex;
   }
 
   ret.nodes      = HEAP_ALLOC(TlsfSubAllocator::BinNode, heap, ret.max_allocs);
   ret.free_stack = HEAP_ALLOC(u32, heap, ret.max_allocs);
 
-  zero_memory(ret.nodes, sizeof(TlsfSubAllocator::BinNode) * ret.max_allocs);
   for (u32 i = 0; i < ret.max_allocs; i++)
   {
+    ret.nodes[i]      = TlsfSubAllocator::BinNode();
     ret.free_stack[i] = ret.max_allocs - i - 1;
   }
+  ret.free_offset = ret.max_allocs;
+
+  u32 root_index = pop_node(&ret);
+  ret.nodes[root_index].offset = 0;
+  ret.nodes[root_index].size   = size;
+  insert_node_into_bin(&ret, root_index);
 
-  insert_node_into_bin(&ret, size, 0);
   return ret;
 }
 
-SubAllocation
-tlsf_sub_alloc(void* tlsf, u32 size, u32 alignment)
+Option<SubAllocation>
+try_tlsf_sub_alloc(TlsfSubAllocator* self, u32 size, u32 alignment)
 {
-  UNREFERENCED_PARAMETER(tlsf);
-  UNREFERENCED_PARAMETER(size);
-  UNREFERENCED_PARAMETER(alignment);
-  SubAllocation ret;
+  ASSERT_MSG_FATAL(size > 0, "Attempted to allocate 0 bytes from TLSF sub allocator");
+  alignment = MAX(alignment, 1);
+  ASSERT_MSG_FATAL(is_pow2(alignment), "TLSF sub allocator alignment 0x%x must be a power of 2", alignment);
+
+  // In the worst case we need alignment - 1 bytes of padding in front of the allocation
+  u64 search_size = (u64)size + alignment - 1;
+  if (search_size > U32_MAX)
+  {
+    return None;
+  }
+
+  // Splitting can require up to 2 new nodes (front padding + tail remainder)
+  if (self->free_offset < 2)
+  {
+    return None;
+  }
+
+  // Round up so that _any_ block in the bins we search is guaranteed to fit
+  UFloat8 min_bin = u32_to_ufloat8_round_up((u32)search_size);
+  if (min_bin.as_uint >= kNumLeafBins)
+  {
+    return None;
+  }
+
+  u32 bin_index = find_free_bin(self, min_bin.as_uint);
+  if (bin_index == kNullIndex)
+  {
+    return None;
+  }
+
+  u32   node_index = self->bin_indices[bin_index];
+  auto* node       = self->nodes + node_index;
+  ASSERT(node_index != kNullIndex && node->size >= search_size);
+
+  remove_node_from_bin(self, node_index);
+
+  u32 padding = (u32)(align_address(node->offset, alignment) - node->offset);
+  if (padding > 0)
+  {
+    // The block before us is always allocated (or doesn't exist) since we coalesce on free, so the
+    // padding just becomes its own free block.
+    u32 front_index = split_node_front(self, node_index, padding);
+    insert_node_into_bin(self, front_index);
+  }
+
+  if (node->size > size)
+  {
+    // Split the tail remainder back into the free lists: the allocation keeps the front of the
+    // node and the new front node becomes the allocation.
+    u32 alloc_index = split_node_front(self, node_index, size);
+    insert_node_into_bin(self, node_index);
+
+    node_index = alloc_index;
+    node       = self->nodes + node_index;
+  }
+
+  node->used       = true;
+  self->used_size += node->size;
+
+  SubAllocation ret = {0};
+  ret.offset   = node->offset;
+  ret.metadata = node_index;
   return ret;
 }
 
+SubAllocation
+tlsf_sub_alloc(void* tlsf, size_t size, size_t alignment)
+{
+  TlsfSubAllocator* self = (TlsfSubAllocator*)tlsf;
+  ASSERT_MSG_FATAL(size <= U32_MAX && alignment <= U32_MAX, "TLSF sub allocator only supports 32-bit sizes, attempted to allocate 0x%llx bytes", (u64)size);
+
+  Option<SubAllocation> ret = try_tlsf_sub_alloc(self, (u32)size, (u32)alignment);
+  ASSERT_MSG_FATAL(
+    ret,
+    "TLSF sub allocator ran out of memory! Attempted to allocate 0x%llx bytes with alignment 0x%llx, "
+    "0x%x/0x%x bytes used, largest free block is 0x%x bytes.",
+    (u64)size, (u64)alignment, self->used_size, self->size, tlsf_sub_allocator_largest_free_block(*self)
+  );
+
+  return unwrap(ret);
+}
+
 void
 tlsf_sub_free(void* tlsf, SubAllocation allocation)
 {
-  UNREFERENCED_PARAMETER(tlsf);
-  UNREFERENCED_PARAMETER(allocation);
+  TlsfSubAllocator* self       = (TlsfSubAllocator*)tlsf;
+  u32               node_index = allocation.metadata;
+
+  ASSERT_MSG_FATAL(node_index < self->max_allocs, "Invalid TLSF sub allocation metadata %u", node_index);
+
+  auto* node = self->nodes + node_index;
+  ASSERT_MSG_FATAL(node->used, "Double free of TLSF sub allocation at offset 0x%x", node->offset);
+  ASSERT_MSG_FATAL(node->offset == allocation.offset, "TLSF sub allocation offset 0x%x doesn't match the node offset 0x%x, the allocation is probably stale.", allocation.offset, node->offset);
+
+  node->used       = false;
+  self->used_size -= node->size;
+
+  // Merge with the block physically before us
+  u32 prev_index = node->neighbor_prev;
+  if (prev_index != kNullIndex && !self->nodes[prev_index].used)
+  {
+    auto* prev = self->nodes + prev_index;
+    remove_node_from_bin(self, prev_index);
+
+    node->offset        = prev->offset;
+    node->size         += prev->size;
+    node->neighbor_prev = prev->neighbor_prev;
+    if (node->neighbor_prev != kNullIndex)
+    {
+      self->nodes[node->neighbor_prev].neighbor_next = node_index;
+    }
+
+    *prev = TlsfSubAllocator::BinNode();
+    push_node(self, prev_index);
+  }
+
+  // And with the block physically after us
+  u32 next_index = node->neighbor_next;
+  if (next_index != kNullIndex && !self->nodes[next_index].used)
+  {
+    auto* next = self->nodes + next_index;
+    remove_node_from_bin(self, next_index);
+
+    node->size         += next->size;
+    node->neighbor_next = next->neighbor_next;
+    if (node->neighbor_next != kNullIndex)
+    {
+      self->nodes[node->neighbor_next].neighbor_prev = node_index;
+    }
+
+    *next = TlsfSubAllocator::BinNode();
+    push_node(self, next_index);
+  }
+
+  insert_node_into_bin(self, node_index);
+}
+
+u32
+tlsf_sub_allocator_largest_free_block(const TlsfSubAllocator& self)
+{
+  if (self.used_top == 0)
+  {
+    return 0;
+  }
+
+  // The highest non-empty bin has the largest blocks, but blocks within a bin aren't sorted so we
+  // have to walk it. This is only meant for stats so that's fine.
+  u32 top_bin_index  = 31 - count_leading_zeroes(self.used_top);
+  u32 leaf_bin_index = 31 - count_leading_zeroes((u32)self.used_leaf[top_bin_index]);
+  u32 bin_index      = (top_bin_index << UFloat8::kMantissaBits) | leaf_bin_index;
+
+  u32 ret = 0;
+  for (u32 node_index = self.bin_indices[bin_index]; node_index != kNullIndex; node_index = self.nodes[node_index].bin_next)
+  {
+    ret = MAX(ret, self.nodes[node_index].size);
+  }
+
+  return ret;
+}
+
+TlsfAllocator
+init_tlsf_allocator(AllocHeap heap, void* memory, u32 size, u32 max_allocs)
+{
+  TlsfAllocator ret = {0};
+  ret.sub_allocator = init_tlsf_sub_allocator(heap, size, max_allocs);
+  ret.memory        = (uintptr_t)memory;
+  ret.reserve_size  = 0;
+  return ret;
+}
+
+TlsfAllocator
+init_tlsf_allocator(AllocHeap heap, u32 size, u32 max_allocs)
+{
+  size_t reserve_size = ALIGN_POW2((size_t)size, kPageSize);
+  void*  memory       = reserve_commit_pages(reserve_size);
+
+  TlsfAllocator ret = init_tlsf_allocator(heap, memory, size, max_allocs);
+  ret.reserve_size  = reserve_size;
+  return ret;
+}
+
+void
+destroy_tlsf_allocator(TlsfAllocator* self)
+{
+  if (self->reserve_size != 0)
+  {
+    free_pages((void*)self->memory);
+  }
+
+  zero_memory(self, sizeof(TlsfAllocator));
+}
+
+void*
+tlsf_alloc(void* tlsf_allocator, size_t size, size_t alignment)
+{
+  TlsfAllocator* self = (TlsfAllocator*)tlsf_allocator;
+
+  // The node index is stashed right before the pointer we hand back, so pad the front by
+  // a full alignment (which is at least big enough to fit the u32).
+  alignment          = MAX(alignment, alignof(u32));
+  size_t header_size = ALIGN_POW2(sizeof(u32), alignment);
+
+  SubAllocation allocation = tlsf_sub_alloc(&self->sub_allocator, size + header_size, alignment);
+
+  uintptr_t ret = self->memory + allocation.offset + header_size;
+  ((u32*)ret)[-1] = allocation.metadata;
+
+  return (void*)ret;
+}
+
+void
+tlsf_free(void* tlsf_allocator, void* ptr)
+{
+  if (ptr == nullptr)
+  {
+    return;
+  }
+
+  TlsfAllocator* self       = (TlsfAllocator*)tlsf_allocator;
+  u32            node_index = ((u32*)ptr)[-1];
+
+  ASSERT_MSG_FATAL(node_index < self->sub_allocator.max_allocs, "Pointer 0x%llx was not allocated from this TLSF allocator", (u64)ptr);
+
+  SubAllocation allocation = {0};
+  allocation.offset        = self->sub_allocator.nodes[node_index].offset;
+  allocation.metadata      = node_index;
+
+  tlsf_sub_free(&self->sub_allocator, allocation);
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include "Core/Foundation/types.h"
 #include "Core/Foundation/memory.h"
+#include "Core/Foundation/Containers/option.h"
 
 // Software implementation of an unsigned 8 bit float
 struct UFloat8
@@ -22,10 +23,17 @@ struct UFloat8
     u32 as_uint;
   };
 };
-UFloat8 u32_to_ufloat8_round_up(u32 size);
-UFloat8 u32_to_ufloat8_round_down(u32 size);
-u32     ufloat8_to_u32(UFloat8 val);
+FOUNDATION_API UFloat8 u32_to_ufloat8_round_up(u32 size);
+FOUNDATION_API UFloat8 u32_to_ufloat8_round_down(u32 size);
+FOUNDATION_API u32     ufloat8_to_u32(UFloat8 val);
 
+FOUNDATION_API SubAllocation tlsf_sub_alloc(void* tlsf, size_t size, size_t alignment);
+FOUNDATION_API void          tlsf_sub_free (void* tlsf, SubAllocation allocation);
+
+// Two-level segregated fit allocator that only hands out offsets. The actual memory is never touched,
+// so this can be used to sub-allocate GPU heaps/buffers just as well as CPU memory.
+// Both alloc and free are O(1): finding a bin is two bit scans and coalescing only ever looks at the
+// physical neighbors of a block.
 struct TlsfSubAllocator
 {
   static constexpr u32 kNumTopBins     = 1ULL << UFloat8::kExponentBits;
@@ -35,33 +43,89 @@ struct TlsfSubAllocator
 
   struct BinNode
   {
-    u32 offset         = 0;
-    u32 size           = 0;
+    u32  offset        = 0;
+    u32  size          = 0;
+
+    // Free list of the bin this node is in (only valid when the node is free)
+    u32  bin_prev      = kNullIndex;
+    u32  bin_next      = kNullIndex;
 
-    u32 bin_prev       = 0;
-    u32 bin_next       = 0;
-    u32 neighbor_next  = 0;
-    u32 neighbor_prev  = 0;
+    // Physically adjacent blocks, used for coalescing on free
+    u32  neighbor_next = kNullIndex;
+    u32  neighbor_prev = kNullIndex;
+
+    bool used          = false;
   };
 
   u32      size        = 0;
+  // Total number of bytes currently handed out (including alignment padding that couldn't be split off)
+  u32      used_size   = 0;
 
   u32      max_allocs  = 0;
   BinNode* nodes       = nullptr;
   u32*     free_stack  = nullptr;
   u32      free_offset = 0;
 
-  // Each bit signifies whether the that top level bin is completely full
+  // Each bit signifies whether that top level bin has any free blocks in it
   u32      used_top    = 0;
   static_assert(kNumTopBins == 32, "The used_top bitfield no longer makes sense");
-  // Each bit signifies whether the bottom level leaf bin is completely full
+  // Each bit signifies whether the bottom level leaf bin has any free blocks in it
   u8       used_leaf[kNumTopBins];
   static_assert(kNumLeafBins == 8 * kNumTopBins, "The used_leaf bitfield no longer makes sense");
 
   u32      bin_indices[kNumLeafBins];
+
+  operator SubAllocHeap()
+  {
+    SubAllocHeap ret = {0};
+    ret.alloc_fn     = &tlsf_sub_alloc;
+    ret.allocator    = this;
+    return ret;
+  }
+
+  operator SubFreeHeap()
+  {
+    SubFreeHeap ret = {0};
+    ret.alloc_fn    = &tlsf_sub_alloc;
+    ret.free_fn     = &tlsf_sub_free;
+    ret.allocator   = this;
+    return ret;
+  }
 };
 
-TlsfSubAllocator init_tlsf_sub_allocator(AllocHeap heap, u32 size, u32 max_allocs);
+// max_allocs is the maximum number of blocks (allocated + free) that can exist at once. Every allocation
+// can create at most two extra free blocks (front alignment padding + the tail remainder).
+FOUNDATION_API TlsfSubAllocator init_tlsf_sub_allocator(AllocHeap heap, u32 size, u32 max_allocs);
+
+// Returns None if there is no free block large enough (or we ran out of nodes), instead of asserting
+FOUNDATION_API Option<SubAllocation> try_tlsf_sub_alloc(TlsfSubAllocator* allocator, u32 size, u32 alignment);
 
-SubAllocation tlsf_sub_alloc(void* tlsf, u32 size, u32 alignment);
-void          tlsf_sub_free (void* tlsf, SubAllocation allocation);
+// Size of the largest allocation (with alignment 1) that would currently succeed. Useful for tracking fragmentation.
+FOUNDATION_API u32 tlsf_sub_allocator_largest_free_block(const TlsfSubAllocator& allocator);
+
+
+FOUNDATION_API void* tlsf_alloc(void* tlsf_allocator, size_t size, size_t alignment);
+FOUNDATION_API void  tlsf_free (void* tlsf_allocator, void* ptr);
+
+// General purpose CPU heap built on top of the TlsfSubAllocator. Each allocation stores the index of its
+// node right before the returned pointer so that we can free without any lookups.
+struct TlsfAllocator
+{
+  TlsfSubAllocator sub_allocator;
+  uintptr_t        memory       = 0x0;
+
+  // Non-zero if the allocator owns its pages and needs to free them on destroy
+  size_t           reserve_size = 0;
+
+  operator FreeHeap()
+  {
+    FreeHeap ret  = {0};
+    ret.alloc_fn  = &tlsf_alloc;
+    ret.free_fn   = &tlsf_free;
+    ret.allocator = this;
+    return ret;
+  }
+};
+FOUNDATION_API TlsfAllocator init_tlsf_allocator   (AllocHeap heap, void* memory, u32 size, u32 max_allocs);
+FOUNDATION_API TlsfAllocator init_tlsf_allocator   (AllocHeap heap, u32 size, u32 max_allocs);
+FOUNDATION_API void          destroy_tlsf_allocator(TlsfAllocator* allocator);
@@ -0,0 +1,620 @@
+#include "Core/Foundation/topology.h"
+#include "Core/Foundation/context.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#else
+#error "topology.cpp has no backend for this platform"
+#endif
+
+static constexpr u32 kNoCpuCore = U32_MAX;
+
+static void
+cpu_set_and(CpuSet* dst, const CpuSet& src)
+{
+  for (u32 imask = 0; imask < ARRAY_LENGTH(dst->masks); imask++)
+  {
+    dst->masks[imask] &= src.masks[imask];
+  }
+}
+
+static void
+cpu_set_or(CpuSet* dst, const CpuSet& src)
+{
+  for (u32 imask = 0; imask < ARRAY_LENGTH(dst->masks); imask++)
+  {
+    dst->masks[imask] |= src.masks[imask];
+  }
+}
+
+static u32
+cpu_set_first(const CpuSet& cpus)
+{
+  for (u32 imask = 0; imask < ARRAY_LENGTH(cpus.masks); imask++)
+  {
+    if (cpus.masks[imask] != 0)
+    {
+      return imask * 64 + (u32)count_trailing_zeroes(cpus.masks[imask]);
+    }
+  }
+
+  return kMaxCpuCount;
+}
+
+// Raw per-core speeds (whatever the OS reports) get squashed down to 0, 1, 2, ... so that classes mean the same
+// thing everywhere. Returns how many classes there are.
+static u32
+rank_efficiency_classes(CpuTopology* topology, const u64* raw_speeds)
+{
+  u64 speeds[256];
+  u32 speed_count = 0;
+  for (u32 icore = 0; icore < topology->cores.size; icore++)
+  {
+    u32 insert = 0;
+    while (insert < speed_count && speeds[insert] < raw_speeds[icore])
+    {
+      insert++;
+    }
+
+    if ((insert < speed_count && speeds[insert] == raw_speeds[icore]) || speed_count == ARRAY_LENGTH(speeds))
+    {
+      continue;
+    }
+
+    memmove(speeds + insert + 1, speeds + insert, sizeof(u64) * (speed_count - insert));
+    speeds[insert] = raw_speeds[icore];
+    speed_count++;
+  }
+
+  for (u32 icore = 0; icore < topology->cores.size; icore++)
+  {
+    u32 rank = 0;
+    while (rank + 1 < speed_count && speeds[rank] < raw_speeds[icore])
+    {
+      rank++;
+    }
+    topology->cores[icore].efficiency_class = (u8)rank;
+  }
+
+  return MAX(speed_count, 1U);
+}
+
+#if defined(_WIN32)
+
+static CpuSet
+group_affinity_to_cpu_set(const GROUP_AFFINITY& affinity)
+{
+  CpuSet ret;
+  if (affinity.Group < ARRAY_LENGTH(ret.masks))
+  {
+    ret.masks[affinity.Group] = (u64)affinity.Mask;
+  }
+
+  return ret;
+}
+
+CpuTopology
+query_cpu_topology(AllocHeap heap)
+{
+  ScratchAllocator scratch_arena = alloc_scratch_arena();
+  defer { free_scratch_arena(&scratch_arena); };
+
+  DWORD size = 0;
+  GetLogicalProcessorInformationEx(RelationAll, nullptr, &size);
+
+  u8* buffer = HEAP_ALLOC(u8, scratch_arena, size);
+  BOOL ok    = GetLogicalProcessorInformationEx(RelationAll, (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)buffer, &size);
+  ASSERT_MSG_FATAL(ok, "GetLogicalProcessorInformationEx failed with error 0x%x", GetLastError());
+
+  u32 core_count      = 0;
+  u32 numa_node_count = 0;
+  for (DWORD offset = 0; offset < size;)
+  {
+    const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX* info = (const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*)(buffer + offset);
+    offset += info->Size;
+
+    core_count      += info->Relationship == RelationProcessorCore ? 1 : 0;
+    numa_node_count += info->Relationship == RelationNumaNode      ? 1 : 0;
+  }
+
+  CpuTopology ret = {};
+  ret.cores       = init_array<CpuCore >(heap, core_count);
+  ret.numa_nodes  = init_array<NumaNode>(heap, MAX(numa_node_count, 1U));
+
+  u64* raw_speeds = HEAP_ALLOC(u64, scratch_arena, MAX(core_count, 1U));
+  for (DWORD offset = 0; offset < size;)
+  {
+    const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX* info = (const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*)(buffer + offset);
+    offset += info->Size;
+
+    if (info->Relationship == RelationProcessorCore)
+    {
+      raw_speeds[ret.cores.size] = info->Processor.EfficiencyClass;
+
+      CpuCore* core = array_add(&ret.cores);
+      core->cpus    = group_affinity_to_cpu_set(info->Processor.GroupMask[0]);
+      cpu_set_or(&ret.available, core->cpus);
+    }
+    else if (info->Relationship == RelationNumaNode)
+    {
+      NumaNode* node = array_add(&ret.numa_nodes);
+      node->cpus     = group_affinity_to_cpu_set(info->NumaNode.GroupMask);
+      node->os_index = info->NumaNode.NodeNumber;
+    }
+  }
+
+  // Packages come last so every core already exists to get tagged with one
+  for (DWORD offset = 0; offset < size;)
+  {
+    const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX* info = (const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*)(buffer + offset);
+    offset += info->Size;
+
+    if (info->Relationship != RelationProcessorPackage)
+    {
+      continue;
+    }
+
+    for (WORD igroup = 0; igroup < info->Processor.GroupCount; igroup++)
+    {
+      CpuSet package_cpus = group_affinity_to_cpu_set(info->Processor.GroupMask[igroup]);
+      for (CpuCore& core : ret.cores)
+      {
+        if (cpu_set_contains(package_cpus, cpu_set_first(core.cpus)))
+        {
+          core.package = ret.package_count;
+        }
+      }
+    }
+    ret.package_count++;
+  }
+
+  if (ret.numa_nodes.size == 0)
+  {
+    NumaNode* node = array_add(&ret.numa_nodes);
+    node->cpus     = ret.available;
+    node->os_index = 0;
+  }
+
+  for (CpuCore& core : ret.cores)
+  {
+    u32 first = cpu_set_first(core.cpus);
+    for (u32 inode = 0; inode < ret.numa_nodes.size; inode++)
+    {
+      if (cpu_set_contains(ret.numa_nodes[inode].cpus, first))
+      {
+        core.numa_node = inode;
+        break;
+      }
+    }
+  }
+
+  ret.cpu_count              = cpu_set_count(ret.available);
+  ret.package_count          = MAX(ret.package_count, 1U);
+  ret.efficiency_class_count = rank_efficiency_classes(&ret, raw_speeds);
+
+  return ret;
+}
+
+#else
+
+// Formats the path relative to root and reads the whole (small) file into dst
+static bool
+read_sysfs_file(char* dst, size_t dst_size, const char* root, const char* fmt, ...)
+{
+  char relative[256];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(relative, sizeof(relative), fmt, args);
+  va_end(args);
+
+  char path[512];
+  snprintf(path, sizeof(path), "%s/%s", root, relative);
+
+  FILE* file = fopen(path, "r");
+  if (file == nullptr)
+  {
+    return false;
+  }
+  defer { fclose(file); };
+
+  size_t size = fread(dst, 1, dst_size - 1, file);
+  dst[size]   = 0;
+
+  return size > 0;
+}
+
+// sysfs cpu lists look like "0-3,8,10-11"
+static bool
+parse_cpu_list(const char* str, CpuSet* out)
+{
+  *out = CpuSet{};
+  bool ret = false;
+  while (*str != 0 && *str != '\n')
+  {
+    char* end   = nullptr;
+    u64   first = strtoull(str, &end, 10);
+    if (end == str)
+    {
+      return false;
+    }
+
+    u64 last = first;
+    if (*end == '-')
+    {
+      str  = end + 1;
+      last = strtoull(str, &end, 10);
+      if (end == str)
+      {
+        return false;
+      }
+    }
+
+    for (u64 cpu = first; cpu <= last && cpu < kMaxCpuCount; cpu++)
+    {
+      cpu_set_add(out, (u32)cpu);
+      ret = true;
+    }
+
+    str = *end == ',' ? end + 1 : end;
+  }
+
+  return ret;
+}
+
+static bool
+read_sysfs_cpu_list(CpuSet* out, const char* root, const char* fmt, u32 index)
+{
+  char buf[4096];
+  return read_sysfs_file(buf, sizeof(buf), root, fmt, index) && parse_cpu_list(buf, out);
+}
+
+static bool
+read_sysfs_u64(u64* out, const char* root, const char* fmt, u32 index)
+{
+  char buf[64];
+  if (!read_sysfs_file(buf, sizeof(buf), root, fmt, index))
+  {
+    return false;
+  }
+
+  char* end = nullptr;
+  *out      = strtoull(buf, &end, 10);
+
+  return end != buf;
+}
+
+CpuTopology
+parse_sysfs_cpu_topology(AllocHeap heap, const char* root, const CpuSet& available)
+{
+  ScratchAllocator scratch_arena = alloc_scratch_arena();
+  defer { free_scratch_arena(&scratch_arena); };
+
+  CpuTopology ret = {};
+  if (!read_sysfs_cpu_list(&ret.available, root, "system/cpu/online", 0))
+  {
+    ret.available = available;
+  }
+  cpu_set_and(&ret.available, available);
+  ret.cpu_count = cpu_set_count(ret.available);
+  ASSERT_MSG_FATAL(ret.cpu_count > 0, "The process isn't allowed to run on any online cpus.");
+
+  ret.cores   = init_array<CpuCore>(heap, ret.cpu_count);
+  u32* cores  = HEAP_ALLOC(u32, scratch_arena, kMaxCpuCount);
+  u64* ids    = HEAP_ALLOC(u64, scratch_arena, ret.cpu_count);
+  for (u32 cpu = 0; cpu < kMaxCpuCount; cpu++)
+  {
+    cores[cpu] = kNoCpuCore;
+  }
+
+  for (u32 cpu = 0; cpu < kMaxCpuCount; cpu++)
+  {
+    if (!cpu_set_contains(ret.available, cpu) || cores[cpu] != kNoCpuCore)
+    {
+      continue;
+    }
+
+    // core_cpus_list is the newer name for the same thing
+    CpuSet siblings;
+    if (!read_sysfs_cpu_list(&siblings, root, "system/cpu/cpu%u/topology/core_cpus_list", cpu) &&
+        !read_sysfs_cpu_list(&siblings, root, "system/cpu/cpu%u/topology/thread_siblings_list", cpu))
+    {
+      cpu_set_add(&siblings, cpu);
+    }
+    cpu_set_and(&siblings, ret.available);
+    cpu_set_add(&siblings, cpu);
+
+    // Some VMs report -1 for the package
+    u64 package = 0;
+    if (!read_sysfs_u64(&package, root, "system/cpu/cpu%u/topology/physical_package_id", cpu) || package > U32_MAX)
+    {
+      package = 0;
+    }
+
+    u32 icore = (u32)ret.cores.size;
+    for (u32 sibling = 0; sibling < kMaxCpuCount; sibling++)
+    {
+      if (cpu_set_contains(siblings, sibling) && cores[sibling] == kNoCpuCore)
+      {
+        cores[sibling] = icore;
+      }
+    }
+
+    CpuCore* core = array_add(&ret.cores);
+    core->cpus    = siblings;
+    core->package = (u32)package;
+  }
+
+  // Package ids don't have to be contiguous, just count the distinct ones
+  for (const CpuCore& core : ret.cores)
+  {
+    bool seen = false;
+    for (u32 ipackage = 0; ipackage < ret.package_count && !seen; ipackage++)
+    {
+      seen = ids[ipackage] == core.package;
+    }
+
+    if (!seen)
+    {
+      ids[ret.package_count++] = core.package;
+    }
+  }
+
+  // Nodes without any cpus (memory-only, or none we're allowed on) don't get an entry
+  CpuSet online_nodes;
+  if (!read_sysfs_cpu_list(&online_nodes, root, "system/node/online", 0))
+  {
+    cpu_set_add(&online_nodes, 0);
+  }
+
+  ret.numa_nodes = init_array<NumaNode>(heap, cpu_set_count(online_nodes));
+  for (u32 inode = 0; inode < kMaxCpuCount; inode++)
+  {
+    CpuSet node_cpus;
+    if (!cpu_set_contains(online_nodes, inode) || !read_sysfs_cpu_list(&node_cpus, root, "system/node/node%u/cpulist", inode))
+    {
+      continue;
+    }
+
+    cpu_set_and(&node_cpus, ret.available);
+    if (cpu_set_count(node_cpus) == 0)
+    {
+      continue;
+    }
+
+    NumaNode* node = array_add(&ret.numa_nodes);
+    node->cpus     = node_cpus;
+    node->os_index = inode;
+  }
+
+  if (ret.numa_nodes.size == 0)
+  {
+    NumaNode* node = array_add(&ret.numa_nodes);
+    node->cpus     = ret.available;
+    node->os_index = 0;
+  }
+
+  for (CpuCore& core : ret.cores)
+  {
+    u32 first = cpu_set_first(core.cpus);
+    for (u32 inode = 0; inode < ret.numa_nodes.size; inode++)
+    {
+      if (cpu_set_contains(ret.numa_nodes[inode].cpus, first))
+      {
+        core.numa_node = inode;
+        break;
+      }
+    }
+  }
+
+  // Intel hybrid CPUs split the P-cores and E-cores into two PMUs. Everything else with mixed cores (ARM big.LITTLE)
+  // reports a relative cpu_capacity per cpu instead.
+  // NOTE(bshihabi): cpufreq's max frequency is deliberately not used, favored cores (Turbo Boost Max 3.0) would
+  // show up as a separate class on machines where every core is actually the same.
+  u64*   raw_speeds = HEAP_ALLOC(u64, scratch_arena, ret.cores.size);
+  CpuSet p_cores;
+  CpuSet e_cores;
+  bool   intel_hybrid = read_sysfs_cpu_list(&p_cores, root, "cpu_core/cpus", 0) && read_sysfs_cpu_list(&e_cores, root, "cpu_atom/cpus", 0);
+  for (u32 icore = 0; icore < ret.cores.size; icore++)
+  {
+    u32 first = cpu_set_first(ret.cores[icore].cpus);
+    if (intel_hybrid)
+    {
+      raw_speeds[icore] = cpu_set_contains(p_cores, first) ? 1 : 0;
+    }
+    else if (!read_sysfs_u64(&raw_speeds[icore], root, "system/cpu/cpu%u/cpu_capacity", first))
+    {
+      raw_speeds[icore] = 0;
+    }
+  }
+
+  ret.package_count          = MAX(ret.package_count, 1U);
+  ret.efficiency_class_count = rank_efficiency_classes(&ret, raw_speeds);
+
+  return ret;
+}
+
+CpuTopology
+query_cpu_topology(AllocHeap heap)
+{
+  CpuSet available;
+
+  cpu_set_t* set  = CPU_ALLOC(kMaxCpuCount);
+  size_t     size = CPU_ALLOC_SIZE(kMaxCpuCount);
+  defer { CPU_FREE(set); };
+
+  if (sched_getaffinity(0, size, set) == 0)
+  {
+    for (u32 cpu = 0; cpu < kMaxCpuCount; cpu++)
+    {
+      if (CPU_ISSET_S(cpu, size, set))
+      {
+        cpu_set_add(&available, cpu);
+      }
+    }
+  }
+  else
+  {
+    for (u32 cpu = 0; cpu < MIN(get_num_physical_cores(), kMaxCpuCount); cpu++)
+    {
+      cpu_set_add(&available, cpu);
+    }
+  }
+
+  return parse_sysfs_cpu_topology(heap, "/sys/devices", available);
+}
+
+#endif
+
+// Fastest first. Cores on prefer_node go before the ones that aren't, then it's just the order the OS numbers them in.
+static bool
+core_goes_before(const CpuTopology& topology, u32 a, u32 b, u32 prefer_node)
+{
+  const CpuCore& core_a = topology.cores[a];
+  const CpuCore& core_b = topology.cores[b];
+  if (core_a.efficiency_class != core_b.efficiency_class)
+  {
+    return core_a.efficiency_class > core_b.efficiency_class;
+  }
+
+  bool a_preferred = core_a.numa_node == prefer_node;
+  bool b_preferred = core_b.numa_node == prefer_node;
+  if (a_preferred != b_preferred)
+  {
+    return a_preferred;
+  }
+
+  if (core_a.numa_node != core_b.numa_node)
+  {
+    return core_a.numa_node < core_b.numa_node;
+  }
+
+  return cpu_set_first(core_a.cpus) < cpu_set_first(core_b.cpus);
+}
+
+static void
+sort_cores(const CpuTopology& topology, u32* order, u32 count, u32 prefer_node)
+{
+  // Only ever runs once at startup on at most a few hundred cores
+  for (u32 i = 1; i < count; i++)
+  {
+    u32 core = order[i];
+    u32 j    = i;
+    for (; j > 0 && core_goes_before(topology, core, order[j - 1], prefer_node); j--)
+    {
+      order[j] = order[j - 1];
+    }
+    order[j] = core;
+  }
+}
+
+ThreadPlacement
+plan_thread_placement(AllocHeap heap, const CpuTopology& topology, const ThreadPlacementDesc& desc)
+{
+  ASSERT_MSG_FATAL(topology.cores.size > 0, "Can't place threads on a topology without any cores.");
+
+  ScratchAllocator scratch_arena = alloc_scratch_arena();
+  defer { free_scratch_arena(&scratch_arena); };
+
+  u32  core_count = (u32)topology.cores.size;
+  u32* order      = HEAP_ALLOC(u32, scratch_arena, core_count);
+  for (u32 icore = 0; icore < core_count; icore++)
+  {
+    order[icore] = icore;
+  }
+  sort_cores(topology, order, core_count, 0);
+
+  ThreadPlacement ret = {};
+
+  const CpuCore& main_core  = topology.cores[order[0]];
+  u32            main_node  = main_core.numa_node;
+  ret.main_thread           = main_core.cpus;
+  ret.main_thread_numa_node = topology.numa_nodes[main_node].os_index;
+
+  // Everything else prefers the main thread's node
+  sort_cores(topology, order, core_count, main_node);
+
+  u8 slowest_class = 0xFF;
+  for (u32 iorder = 1; iorder < core_count; iorder++)
+  {
+    const CpuCore& core = topology.cores[order[iorder]];
+    if (core.numa_node == main_node)
+    {
+      slowest_class = MIN(slowest_class, core.efficiency_class);
+    }
+  }
+
+  for (u32 iorder = 1; iorder < core_count; iorder++)
+  {
+    const CpuCore& core = topology.cores[order[iorder]];
+    if (core.numa_node == main_node && core.efficiency_class == slowest_class)
+    {
+      cpu_set_or(&ret.streaming_thread, core.cpus);
+    }
+  }
+
+  if (cpu_set_count(ret.streaming_thread) == 0)
+  {
+    ret.streaming_thread = core_count > 1 ? topology.cores[order[core_count - 1]].cpus : main_core.cpus;
+  }
+  ret.streaming_thread_numa_node = ret.main_thread_numa_node;
+  for (const NumaNode& node : topology.numa_nodes)
+  {
+    if (cpu_set_contains(node.cpus, cpu_set_first(ret.streaming_thread)))
+    {
+      ret.streaming_thread_numa_node = node.os_index;
+      break;
+    }
+  }
+
+  u32 worker_count = 0;
+  for (u32 iorder = 1; iorder < core_count; iorder++)
+  {
+    worker_count += desc.job_workers_use_smt ? cpu_set_count(topology.cores[order[iorder]].cpus) : 1;
+  }
+
+  // A single core has to share with the main thread
+  bool share_main_core = worker_count == 0;
+  if (share_main_core)
+  {
+    worker_count = 1;
+  }
+
+  if (desc.max_job_workers != 0)
+  {
+    worker_count = MIN(worker_count, desc.max_job_workers);
+  }
+
+  ret.job_workers           = init_array<CpuSet>(heap, worker_count);
+  ret.job_worker_numa_nodes = init_array<u32   >(heap, worker_count);
+  for (u32 iorder = share_main_core ? 0 : 1; iorder < core_count && ret.job_workers.size < worker_count; iorder++)
+  {
+    const CpuCore& core = topology.cores[order[iorder]];
+    u32            node = topology.numa_nodes[core.numa_node].os_index;
+    if (!desc.job_workers_use_smt)
+    {
+      *array_add(&ret.job_workers)           = core.cpus;
+      *array_add(&ret.job_worker_numa_nodes) = node;
+      continue;
+    }
+
+    for (u32 cpu = 0; cpu < kMaxCpuCount && ret.job_workers.size < worker_count; cpu++)
+    {
+      if (!cpu_set_contains(core.cpus, cpu))
+      {
+        continue;
+      }
+
+      CpuSet* worker = array_add(&ret.job_workers);
+      *worker        = CpuSet{};
+      cpu_set_add(worker, cpu);
+      *array_add(&ret.job_worker_numa_nodes) = node;
+    }
+  }
+
+  return ret;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "Core/Foundation/types.h"
+#include "Core/Foundation/threading.h"
+
+#include "Core/Foundation/Containers/array.h"
+
+// What the processors in the machine look like: which logical processors are SMT siblings on the same core, which
+// package and NUMA node every core is on, and on hybrid CPUs (P-cores and E-cores) which cores are the fast ones.
+// Threads should get their cores from plan_thread_placement instead of hard-coding core indices, which falls apart
+// on anything that isn't the machine the indices were picked on.
+
+struct CpuCore
+{
+  // Every logical processor on the core that the process is allowed to run on, more than one with SMT
+  CpuSet cpus;
+  u32    package          = 0;
+  // Index into CpuTopology::numa_nodes
+  u32    numa_node        = 0;
+  // Higher is faster, lower is more power efficient. 0 on every core if they're all the same, like EfficiencyClass on Windows.
+  u8     efficiency_class = 0;
+};
+
+struct NumaNode
+{
+  CpuSet cpus;
+  // The OS's number for the node, which is what commit_pages_on_numa_node wants
+  u32    os_index = 0;
+};
+
+struct CpuTopology
+{
+  // Every logical processor the process is allowed to run on
+  CpuSet          available;
+  u32             cpu_count              = 0;
+  u32             package_count          = 0;
+  u32             efficiency_class_count = 1;
+
+  Array<CpuCore>  cores;
+  Array<NumaNode> numa_nodes;
+};
+
+FOUNDATION_API CpuTopology query_cpu_topology(AllocHeap heap);
+
+#if !defined(_WIN32)
+// root is normally /sys/devices, tests can point it at a fake sysfs tree instead. Only the logical processors in
+// available (usually the process's affinity) are part of the topology.
+FOUNDATION_API CpuTopology parse_sysfs_cpu_topology(AllocHeap heap, const char* root, const CpuSet& available);
+#endif
+
+struct ThreadPlacementDesc
+{
+  // 0 means no limit
+  u32  max_job_workers     = 0;
+  // One job worker per logical processor instead of one per core
+  bool job_workers_use_smt = false;
+};
+
+// NUMA nodes in here are the OS's numbers for them.
+struct ThreadPlacement
+{
+  CpuSet        main_thread;
+  u32           main_thread_numa_node      = 0;
+
+  CpuSet        streaming_thread;
+  u32           streaming_thread_numa_node = 0;
+
+  Array<CpuSet> job_workers;
+  Array<u32>    job_worker_numa_nodes;
+};
+
+// The main thread gets the fastest core to itself. Job workers get one core each out of the rest, fastest first and
+// the main thread's NUMA node before any others. The streaming thread spends most of its time asleep waiting on IO,
+// so instead of taking a core away from the workers it shares the slowest cores on the main thread's node with them.
+// Machines with too few cores for all of that end up sharing, nothing ever gets an empty set.
+FOUNDATION_API ThreadPlacement plan_thread_placement(AllocHeap heap, const CpuTopology& topology, const ThreadPlacementDesc& desc = {});
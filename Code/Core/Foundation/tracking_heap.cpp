@@ -0,0 +1,506 @@
+#include "Core/Foundation/tracking_heap.h"
+#include "Core/Foundation/context.h"
+#include "Core/Foundation/filesystem.h"
+#include "Core/Foundation/sort.h"
+
+#include <stdarg.h>
+
+#if defined(_MSC_VER)
+#define TRACKING_CALL_SITE() ((uintptr_t)_ReturnAddress())
+#else
+#define TRACKING_CALL_SITE() ((uintptr_t)__builtin_return_address(0))
+#endif
+
+static TrackingHeap::ThreadBuffer*
+tracking_acquire_thread_buffer(TrackingHeap* self)
+{
+  u32                         slot   = MIN(get_allocator_thread_slot(), kAllocatorMaxThreads);
+  TrackingHeap::ThreadBuffer* buffer = &self->thread_buffers[slot];
+  spin_acquire(&buffer->lock);
+
+  return buffer;
+}
+
+static u32
+tracking_lifetime_bucket(u64 lifetime)
+{
+  if (lifetime == 0)
+  {
+    return 0;
+  }
+
+  u32 bucket = 64 - (u32)count_leading_zeroes(lifetime);
+  return MIN(bucket, kTrackingLifetimeBucketCount - 1);
+}
+
+static void
+tracking_apply_free(TrackingHeap* self, uintptr_t ptr, u64 epoch)
+{
+  TrackingLiveAllocation* live = hash_table_find(&self->live_allocations, ptr);
+  if (live == nullptr)
+  {
+    self->stats.unknown_frees++;
+    return;
+  }
+
+  TrackingCallSite* call_site = hash_table_find(&self->call_sites, live->call_site);
+  ASSERT(call_site != nullptr);
+  call_site->free_count++;
+  call_site->live_count--;
+  call_site->live_bytes -= live->size;
+
+  self->stats.free_count++;
+  self->stats.live_count--;
+  self->stats.live_bytes -= live->size;
+  self->stats.lifetime_histogram[tracking_lifetime_bucket(epoch - live->epoch)]++;
+
+  hash_table_erase(&self->live_allocations, ptr);
+}
+
+static void
+tracking_apply_alloc(TrackingHeap* self, const TrackingEvent& event)
+{
+  // If the pointer is still live then whatever allocated it got freed without us knowing (usually a reset)
+  if (hash_table_find(&self->live_allocations, event.ptr) != nullptr)
+  {
+    tracking_apply_free(self, event.ptr, event.epoch);
+  }
+
+  TrackingLiveAllocation* live = hash_table_insert(&self->live_allocations, event.ptr);
+  live->size                   = event.size;
+  live->call_site              = event.call_site;
+  live->epoch                  = event.epoch;
+
+  TrackingCallSite* call_site  = hash_table_insert(&self->call_sites, event.call_site);
+  call_site->alloc_count++;
+  call_site->live_count++;
+  call_site->total_bytes      += event.size;
+  call_site->live_bytes       += event.size;
+  call_site->peak_live_bytes   = MAX(call_site->peak_live_bytes, call_site->live_bytes);
+
+  self->stats.alloc_count++;
+  self->stats.live_count++;
+  self->stats.total_bytes     += event.size;
+  self->stats.live_bytes      += event.size;
+  self->stats.peak_live_bytes  = MAX(self->stats.peak_live_bytes, self->stats.live_bytes);
+}
+
+// Must be called with self->lock held. Threads can't record anything while we hold every buffer's lock, so what we
+// collect is a consistent snapshot: if an address was freed and handed out again, we have both events.
+static void
+tracking_flush_locked(TrackingHeap* self)
+{
+  u32 event_count = 0;
+  for (u32 ibuffer = 0; ibuffer <= kAllocatorMaxThreads; ibuffer++)
+  {
+    spin_acquire(&self->thread_buffers[ibuffer].lock);
+    event_count += self->thread_buffers[ibuffer].count;
+  }
+
+  if (event_count > 0)
+  {
+    ScratchAllocator scratch_arena = alloc_scratch_arena();
+    defer { free_scratch_arena(&scratch_arena); };
+
+    TrackingEvent* events = HEAP_ALLOC(TrackingEvent, scratch_arena, event_count);
+    u32            dst    = 0;
+    for (u32 ibuffer = 0; ibuffer <= kAllocatorMaxThreads; ibuffer++)
+    {
+      TrackingHeap::ThreadBuffer* buffer = &self->thread_buffers[ibuffer];
+      memcpy(events + dst, buffer->events, sizeof(TrackingEvent) * buffer->count);
+      dst          += buffer->count;
+      buffer->count = 0;
+    }
+
+    radix_sort_u64(events, event_count, sizeof(TrackingEvent), offsetof(TrackingEvent, sequence));
+
+    for (u32 ievent = 0; ievent < event_count; ievent++)
+    {
+      const TrackingEvent& event = events[ievent];
+      if (event.type == kTrackingEventAlloc)
+      {
+        tracking_apply_alloc(self, event);
+      }
+      else
+      {
+        tracking_apply_free(self, event.ptr, event.epoch);
+      }
+    }
+  }
+
+  for (u32 ibuffer = 0; ibuffer <= kAllocatorMaxThreads; ibuffer++)
+  {
+    spin_release(&self->thread_buffers[ibuffer].lock);
+  }
+}
+
+static void
+tracking_flush(TrackingHeap* self)
+{
+  spin_acquire(&self->lock);
+  defer { spin_release(&self->lock); };
+
+  tracking_flush_locked(self);
+}
+
+static void
+tracking_record(TrackingHeap* self, TrackingEventType type, void* ptr, u64 size, uintptr_t call_site)
+{
+  TrackingHeap::ThreadBuffer* buffer = tracking_acquire_thread_buffer(self);
+  while (buffer->count == kTrackingThreadBufferSize)
+  {
+    spin_release(&buffer->lock);
+    tracking_flush(self);
+    buffer = tracking_acquire_thread_buffer(self);
+  }
+
+  // The sequence is taken while holding our buffer's lock so that a flush either sees the whole event or none of it
+  TrackingEvent* event = &buffer->events[buffer->count++];
+  event->sequence      = atomic_ref_fetch_add(&self->sequence, 1, std::memory_order_relaxed);
+  event->ptr           = (uintptr_t)ptr;
+  event->size          = size;
+  event->call_site     = call_site;
+  event->epoch         = atomic_ref_load(&self->epoch, std::memory_order_relaxed);
+  event->type          = type;
+
+  spin_release(&buffer->lock);
+}
+
+void*
+tracking_alloc(void* tracking_heap, size_t size, size_t alignment)
+{
+  TrackingHeap* self = (TrackingHeap*)tracking_heap;
+
+  void* ret = self->backing.alloc_fn(self->backing.allocator, size, alignment);
+  tracking_record(self, kTrackingEventAlloc, ret, size, TRACKING_CALL_SITE());
+
+  return ret;
+}
+
+void
+tracking_free(void* tracking_heap, void* ptr)
+{
+  TrackingHeap* self = (TrackingHeap*)tracking_heap;
+  ASSERT_MSG_FATAL(self->backing.free_fn != nullptr, "Attempted to free from a tracking heap whose backing heap can't free.");
+
+  if (ptr == nullptr)
+  {
+    return;
+  }
+
+  // Record before actually freeing, once it's freed another thread can get the same address back and its
+  // alloc event needs to come after ours.
+  tracking_record(self, kTrackingEventFree, ptr, 0, 0x0);
+  self->backing.free_fn(self->backing.allocator, ptr);
+}
+
+void*
+tracking_realloc(void* tracking_heap, void* ptr, size_t size, size_t alignment)
+{
+  TrackingHeap* self = (TrackingHeap*)tracking_heap;
+  ASSERT_MSG_FATAL(self->backing.realloc_fn != nullptr, "Attempted to realloc from a tracking heap whose backing heap can't realloc.");
+
+  if (ptr != nullptr)
+  {
+    tracking_record(self, kTrackingEventFree, ptr, 0, 0x0);
+  }
+
+  void* ret = self->backing.realloc_fn(self->backing.allocator, ptr, size, alignment);
+  tracking_record(self, kTrackingEventAlloc, ret, size, TRACKING_CALL_SITE());
+
+  return ret;
+}
+
+TrackingHeap
+init_tracking_heap(ReallocFreeHeap backing, FreeHeap metadata_heap)
+{
+  ASSERT_MSG_FATAL(backing.alloc_fn != nullptr, "Tracking heap needs a backing heap that can at least allocate.");
+
+  TrackingHeap ret;
+  ret.backing          = backing;
+  ret.lock             = init_spin_lock();
+  ret.call_sites       = init_growable_hash_table<uintptr_t, TrackingCallSite>(metadata_heap, 256);
+  ret.live_allocations = init_growable_hash_table<uintptr_t, TrackingLiveAllocation>(metadata_heap, 4096);
+  ret.metadata_heap    = metadata_heap;
+
+  ret.thread_buffers   = HEAP_ALLOC(TrackingHeap::ThreadBuffer, (AllocHeap)metadata_heap, kAllocatorMaxThreads + 1);
+  for (u32 ibuffer = 0; ibuffer <= kAllocatorMaxThreads; ibuffer++)
+  {
+    TrackingHeap::ThreadBuffer* buffer = &ret.thread_buffers[ibuffer];
+    buffer->lock   = init_spin_lock();
+    buffer->count  = 0;
+    buffer->events = HEAP_ALLOC(TrackingEvent, (AllocHeap)metadata_heap, kTrackingThreadBufferSize);
+  }
+
+  return ret;
+}
+
+TrackingHeap
+init_tracking_heap(FreeHeap backing, FreeHeap metadata_heap)
+{
+  ReallocFreeHeap heap = {0};
+  heap.alloc_fn        = backing.alloc_fn;
+  heap.free_fn         = backing.free_fn;
+  heap.allocator       = backing.allocator;
+
+  return init_tracking_heap(heap, metadata_heap);
+}
+
+TrackingHeap
+init_tracking_heap(AllocHeap backing, FreeHeap metadata_heap)
+{
+  ReallocFreeHeap heap = {0};
+  heap.alloc_fn        = backing.alloc_fn;
+  heap.allocator       = backing.allocator;
+
+  return init_tracking_heap(heap, metadata_heap);
+}
+
+void
+destroy_tracking_heap(TrackingHeap* self)
+{
+  for (u32 ibuffer = 0; ibuffer <= kAllocatorMaxThreads; ibuffer++)
+  {
+    HEAP_FREE(self->metadata_heap, self->thread_buffers[ibuffer].events);
+  }
+  HEAP_FREE(self->metadata_heap, self->thread_buffers);
+
+  destroy_hash_table(&self->call_sites);
+  destroy_hash_table(&self->live_allocations);
+
+  zero_memory(self, sizeof(TrackingHeap));
+}
+
+void
+tracking_heap_advance_epoch(TrackingHeap* self)
+{
+  atomic_ref_fetch_add(&self->epoch, 1, std::memory_order_relaxed);
+}
+
+void
+tracking_heap_reset(TrackingHeap* self)
+{
+  spin_acquire(&self->lock);
+  defer { spin_release(&self->lock); };
+
+  tracking_flush_locked(self);
+
+  u64 epoch = atomic_ref_load(&self->epoch, std::memory_order_relaxed);
+  for (auto [call_site_address, call_site] : self->call_sites)
+  {
+    call_site.free_count += call_site.live_count;
+    call_site.live_count  = 0;
+    call_site.live_bytes  = 0;
+  }
+
+  for (auto [ptr, live] : self->live_allocations)
+  {
+    self->stats.lifetime_histogram[tracking_lifetime_bucket(epoch - live.epoch)]++;
+  }
+
+  self->stats.free_count += self->stats.live_count;
+  self->stats.live_count  = 0;
+  self->stats.live_bytes  = 0;
+
+  // Don't need the old arrays, just start over
+  destroy_hash_table(&self->live_allocations);
+  self->live_allocations = init_growable_hash_table<uintptr_t, TrackingLiveAllocation>(self->metadata_heap, 4096);
+}
+
+TrackingStats
+tracking_heap_get_stats(TrackingHeap* self)
+{
+  spin_acquire(&self->lock);
+  defer { spin_release(&self->lock); };
+
+  tracking_flush_locked(self);
+  return self->stats;
+}
+
+Option<TrackingCallSite>
+tracking_heap_get_call_site(TrackingHeap* self, uintptr_t call_site)
+{
+  spin_acquire(&self->lock);
+  defer { spin_release(&self->lock); };
+
+  tracking_flush_locked(self);
+
+  TrackingCallSite* ret = hash_table_find(&self->call_sites, call_site);
+  if (ret == nullptr)
+  {
+    return None;
+  }
+
+  return *ret;
+}
+
+Option<TrackingLiveAllocation>
+tracking_heap_get_live_allocation(TrackingHeap* self, const void* ptr)
+{
+  spin_acquire(&self->lock);
+  defer { spin_release(&self->lock); };
+
+  tracking_flush_locked(self);
+
+  TrackingLiveAllocation* ret = hash_table_find(&self->live_allocations, (uintptr_t)ptr);
+  if (ret == nullptr)
+  {
+    return None;
+  }
+
+  return *ret;
+}
+
+// Report gets written in two passes, the first with no buffer just to figure out how big it is.
+struct TrackingReportWriter
+{
+  char* buffer   = nullptr;
+  u64   size     = 0;
+  // Including the null terminator
+  u64   capacity = 0;
+};
+
+static void
+report_printf(TrackingReportWriter* writer, const char* fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+
+  char* dst     = writer->buffer != nullptr ? writer->buffer + writer->size : nullptr;
+  u64   dst_len = writer->buffer != nullptr ? writer->capacity - writer->size : 0;
+  s32   written = vsnprintf(dst, dst_len, fmt, args);
+  ASSERT(written >= 0);
+  writer->size += (u64)written;
+
+  va_end(args);
+}
+
+static void
+tracking_write_report(TrackingHeap* self, TrackingReportWriter* writer, TrackingReportFormat format)
+{
+  switch (format)
+  {
+    case kTrackingReportJson:
+    {
+      const TrackingStats& stats = self->stats;
+      report_printf(writer, "{\n");
+      report_printf(writer, "  \"alloc_count\": %llu,\n",     stats.alloc_count);
+      report_printf(writer, "  \"free_count\": %llu,\n",      stats.free_count);
+      report_printf(writer, "  \"total_bytes\": %llu,\n",     stats.total_bytes);
+      report_printf(writer, "  \"live_count\": %llu,\n",      stats.live_count);
+      report_printf(writer, "  \"live_bytes\": %llu,\n",      stats.live_bytes);
+      report_printf(writer, "  \"peak_live_bytes\": %llu,\n", stats.peak_live_bytes);
+      report_printf(writer, "  \"unknown_frees\": %llu,\n",   stats.unknown_frees);
+
+      report_printf(writer, "  \"lifetime_histogram\": [");
+      for (u32 ibucket = 0; ibucket < kTrackingLifetimeBucketCount; ibucket++)
+      {
+        report_printf(writer, ibucket == 0 ? "%llu" : ", %llu", stats.lifetime_histogram[ibucket]);
+      }
+      report_printf(writer, "],\n");
+
+      report_printf(writer, "  \"call_sites\": [");
+      bool first = true;
+      for (auto [address, call_site] : self->call_sites)
+      {
+        report_printf(
+          writer,
+          "%s\n    {\"address\": \"0x%llx\", \"alloc_count\": %llu, \"free_count\": %llu, \"total_bytes\": %llu, "
+          "\"live_count\": %llu, \"live_bytes\": %llu, \"peak_live_bytes\": %llu}",
+          first ? "" : ",",
+          (u64)address,
+          call_site.alloc_count,
+          call_site.free_count,
+          call_site.total_bytes,
+          call_site.live_count,
+          call_site.live_bytes,
+          call_site.peak_live_bytes
+        );
+        first = false;
+      }
+      report_printf(writer, "\n  ],\n");
+
+      report_printf(writer, "  \"live_allocations\": [");
+      first = true;
+      for (auto [ptr, live] : self->live_allocations)
+      {
+        report_printf(
+          writer,
+          "%s\n    {\"address\": \"0x%llx\", \"size\": %llu, \"call_site\": \"0x%llx\", \"epoch\": %llu}",
+          first ? "" : ",",
+          (u64)ptr,
+          live.size,
+          (u64)live.call_site,
+          live.epoch
+        );
+        first = false;
+      }
+      report_printf(writer, "\n  ]\n}\n");
+    } break;
+    case kTrackingReportCsvCallSites:
+    {
+      report_printf(writer, "call_site,alloc_count,free_count,total_bytes,live_count,live_bytes,peak_live_bytes\n");
+      for (auto [address, call_site] : self->call_sites)
+      {
+        report_printf(
+          writer,
+          "0x%llx,%llu,%llu,%llu,%llu,%llu,%llu\n",
+          (u64)address,
+          call_site.alloc_count,
+          call_site.free_count,
+          call_site.total_bytes,
+          call_site.live_count,
+          call_site.live_bytes,
+          call_site.peak_live_bytes
+        );
+      }
+    } break;
+    case kTrackingReportCsvLiveAllocations:
+    {
+      report_printf(writer, "address,size,call_site,epoch\n");
+      for (auto [ptr, live] : self->live_allocations)
+      {
+        report_printf(writer, "0x%llx,%llu,0x%llx,%llu\n", (u64)ptr, live.size, (u64)live.call_site, live.epoch);
+      }
+    } break;
+    default: UNREACHABLE;
+  }
+}
+
+Span<char>
+tracking_heap_build_report(TrackingHeap* self, AllocHeap report_heap, TrackingReportFormat format)
+{
+  spin_acquire(&self->lock);
+  defer { spin_release(&self->lock); };
+
+  tracking_flush_locked(self);
+
+  TrackingReportWriter size_writer;
+  tracking_write_report(self, &size_writer, format);
+
+  TrackingReportWriter writer;
+  writer.capacity = size_writer.size + 1;
+  writer.buffer   = HEAP_ALLOC(char, report_heap, writer.capacity);
+  tracking_write_report(self, &writer, format);
+  ASSERT_MSG_FATAL(writer.size == size_writer.size, "Tracking report changed size between passes (%llu vs %llu).", writer.size, size_writer.size);
+
+  return Span<char>(writer.buffer, writer.size);
+}
+
+bool
+tracking_heap_write_report(TrackingHeap* self, const char* path, TrackingReportFormat format)
+{
+  ScratchAllocator scratch_arena = alloc_scratch_arena();
+  defer { free_scratch_arena(&scratch_arena); };
+
+  Span<char> report = tracking_heap_build_report(self, scratch_arena, format);
+
+  auto file = create_file(path, kCreateTruncateExisting);
+  if (!file)
+  {
+    return false;
+  }
+  defer { close_file(&file.value()); };
+
+  return write_file(file.value(), report.memory, report.size);
+}
@@ -0,0 +1,155 @@
+#pragma once
+#include "Core/Foundation/types.h"
+#include "Core/Foundation/memory.h"
+#include "Core/Foundation/threading.h"
+
+#include "Core/Foundation/Containers/array.h"
+#include "Core/Foundation/Containers/hash_table.h"
+
+// Events are buffered per thread and only folded into the tables when a buffer fills up or someone asks for stats
+static constexpr u32 kTrackingThreadBufferSize    = 512;
+// Bucket i counts allocations that lived for [2^(i - 1), 2^i) epochs, bucket 0 is allocations freed in the epoch they were made in.
+static constexpr u32 kTrackingLifetimeBucketCount = 16;
+
+enum TrackingEventType : u32
+{
+  kTrackingEventAlloc,
+  kTrackingEventFree,
+};
+
+struct TrackingEvent
+{
+  u64               sequence  = 0;
+  uintptr_t         ptr       = 0x0;
+  u64               size      = 0;
+  uintptr_t         call_site = 0x0;
+  u64               epoch     = 0;
+  TrackingEventType type      = kTrackingEventAlloc;
+};
+
+struct TrackingCallSite
+{
+  u64 alloc_count     = 0;
+  u64 free_count      = 0;
+  u64 total_bytes     = 0;
+  u64 live_count      = 0;
+  u64 live_bytes      = 0;
+  u64 peak_live_bytes = 0;
+};
+
+struct TrackingLiveAllocation
+{
+  u64       size      = 0;
+  uintptr_t call_site = 0x0;
+  u64       epoch     = 0;
+};
+
+struct TrackingStats
+{
+  u64 alloc_count     = 0;
+  u64 free_count      = 0;
+  u64 total_bytes     = 0;
+  u64 live_count      = 0;
+  u64 live_bytes      = 0;
+  u64 peak_live_bytes = 0;
+  // Frees of pointers we never saw get allocated (they were allocated before tracking started or through another heap)
+  u64 unknown_frees   = 0;
+
+  u64 lifetime_histogram[kTrackingLifetimeBucketCount] = {};
+};
+
+FOUNDATION_API void* tracking_alloc  (void* tracking_heap, size_t size, size_t alignment);
+FOUNDATION_API void  tracking_free   (void* tracking_heap, void* ptr);
+FOUNDATION_API void* tracking_realloc(void* tracking_heap, void* ptr, size_t size, size_t alignment);
+
+// Opt-in wrapper around another heap that records who allocates how much. Call sites are the return address of
+// the alloc call, so they can be resolved against the PDB/symbols of the binary.
+//
+// Every thread appends to its own event buffer (an uncontended lock and a relaxed fetch_add for ordering), and the
+// buffers get folded into the shared tables in sequence order when one of them fills up or stats are requested.
+// The backing heap only needs the functions you're going to call on the tracking heap.
+struct TrackingHeap
+{
+  struct alignas(kCacheLineSize) ThreadBuffer
+  {
+    SpinLock       lock;
+    u32            count  = 0;
+    TrackingEvent* events = nullptr;
+  };
+
+  ReallocFreeHeap                                 backing;
+
+  // Everything below is protected by lock
+  SpinLock                                        lock;
+  HashTable<uintptr_t, TrackingCallSite>          call_sites;
+  HashTable<uintptr_t, TrackingLiveAllocation>    live_allocations;
+  TrackingStats                                   stats;
+
+  // One per thread slot, plus one shared by every thread past kAllocatorMaxThreads
+  ThreadBuffer*                                   thread_buffers = nullptr;
+  FreeHeap                                        metadata_heap;
+
+  // Accessed atomically
+  alignas(kCacheLineSize) u64                     sequence       = 0;
+  u64                                             epoch          = 0;
+
+  operator AllocHeap()
+  {
+    AllocHeap ret = {0};
+    ret.alloc_fn  = &tracking_alloc;
+    ret.allocator = this;
+    return ret;
+  }
+
+  operator FreeHeap()
+  {
+    FreeHeap ret  = {0};
+    ret.alloc_fn  = &tracking_alloc;
+    ret.free_fn   = &tracking_free;
+    ret.allocator = this;
+    return ret;
+  }
+
+  operator ReallocFreeHeap()
+  {
+    ReallocFreeHeap ret = {0};
+    ret.alloc_fn        = &tracking_alloc;
+    ret.free_fn         = &tracking_free;
+    ret.realloc_fn      = &tracking_realloc;
+    ret.allocator       = this;
+    return ret;
+  }
+};
+
+// metadata_heap is where the tracking tables live, it can't be the heap being tracked.
+FOUNDATION_API TrackingHeap  init_tracking_heap   (AllocHeap backing, FreeHeap metadata_heap);
+FOUNDATION_API TrackingHeap  init_tracking_heap   (FreeHeap backing, FreeHeap metadata_heap);
+FOUNDATION_API TrackingHeap  init_tracking_heap   (ReallocFreeHeap backing, FreeHeap metadata_heap);
+FOUNDATION_API void          destroy_tracking_heap(TrackingHeap* heap);
+
+// Lifetimes are measured in epochs, which are whatever you want them to be (usually frames).
+FOUNDATION_API void          tracking_heap_advance_epoch(TrackingHeap* heap);
+
+// For heaps that get reset wholesale instead of freeing individual allocations (linear/frame allocators).
+// Everything that is still live counts as freed.
+FOUNDATION_API void          tracking_heap_reset        (TrackingHeap* heap);
+
+// Folds every thread's buffered events into the tables and returns a snapshot of the totals.
+FOUNDATION_API TrackingStats tracking_heap_get_stats    (TrackingHeap* heap);
+
+FOUNDATION_API Option<TrackingCallSite>       tracking_heap_get_call_site       (TrackingHeap* heap, uintptr_t call_site);
+FOUNDATION_API Option<TrackingLiveAllocation> tracking_heap_get_live_allocation (TrackingHeap* heap, const void* ptr);
+
+enum TrackingReportFormat : u32
+{
+  // Totals, lifetime histogram, per call site stats, and every live allocation
+  kTrackingReportJson,
+  // One row per call site
+  kTrackingReportCsvCallSites,
+  // One row per live allocation
+  kTrackingReportCsvLiveAllocations,
+};
+
+// Builds the report as a null terminated string allocated out of heap (size doesn't include the terminator).
+FOUNDATION_API Span<char> tracking_heap_build_report(TrackingHeap* heap, AllocHeap report_heap, TrackingReportFormat format);
+FOUNDATION_API DONT_IGNORE_RETURN bool tracking_heap_write_report(TrackingHeap* heap, const char* path, TrackingReportFormat format);
@@ -1,10 +1,14 @@
 #pragma once
 #include <stdint.h>
 #include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#if defined(_WIN32)
 #define NOMINMAX
 #include <windows.h>
-#include <immintrin.h>
 #include <intrin.h>
+#endif
+#include <immintrin.h>
 #include <initializer_list>
 #include <utility>
 
@@ -41,6 +45,8 @@ typedef __m128i u16x8;
 typedef __m128i u32x4;
 typedef __m128i u64x2;
 
+typedef __m256i u8x32;
+
 template <typename T>
 using InitializerList = std::initializer_list<T>;
 
@@ -83,7 +89,11 @@ v_dbg(const char* fmt, bool newline, va_list args)
   }
   buf[written + 1] = 0;
 
+#if defined(_WIN32)
   OutputDebugStringA(buf);
+#else
+  fputs(buf, stderr);
+#endif
 
   return written;
 }
@@ -114,6 +124,7 @@ dbg(const char* fmt, ...)
   return res;
 }
 
+#if defined(_MSC_VER)
 inline u16 
 count_num_bits(u16 val)
 {
@@ -163,6 +174,96 @@ count_trailing_zeroes(u64 val)
   unsigned long ret;
   return _BitScanForward64(&ret, val) ? ret : 64;
 }
+#else
+inline u16 
+count_num_bits(u16 val)
+{
+  return (u16)__builtin_popcount(val);
+}
+
+inline u32 
+count_num_bits(u32 val)
+{
+  return (u32)__builtin_popcount(val);
+}
+
+inline u64 
+count_num_bits(u64 val)
+{
+  return (u64)__builtin_popcountll(val);
+}
+
+// Same as the MSVC version, a val of 0 is undefined
+inline u32
+count_leading_zeroes(u32 val)
+{
+  return (u32)__builtin_clz(val);
+}
+
+inline u64
+count_leading_zeroes(u64 val)
+{
+  return (u64)__builtin_clzll(val);
+}
+
+inline u32
+count_trailing_zeroes(u32 val)
+{
+  return val != 0 ? (u32)__builtin_ctz(val) : 32;
+}
+
+inline u64
+count_trailing_zeroes(u64 val)
+{
+  return val != 0 ? (u64)__builtin_ctzll(val) : 64;
+}
+#endif
+
+// AVX2 is _not_ required, so anything that uses it needs to check this at runtime and fall back to SSE2.
+inline bool
+cpu_supports_avx2()
+{
+#if defined(_MSC_VER)
+  int regs[4];
+  __cpuid(regs, 0);
+  if (regs[0] < 7)
+  {
+    return false;
+  }
+
+  __cpuid(regs, 1);
+  bool os_xsave = (regs[2] & (1 << 27)) != 0;
+  bool avx      = (regs[2] & (1 << 28)) != 0;
+  // The OS also needs to be saving the YMM registers on context switches.
+  if (!os_xsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+  {
+    return false;
+  }
+
+  __cpuidex(regs, 7, 0);
+  return (regs[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+// Functions that use AVX2 intrinsics behind a cpu_supports_avx2() check need this on GCC/Clang.
+// MSVC lets you use any intrinsic anywhere.
+#if defined(_MSC_VER)
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#if defined(_MSC_VER)
+#define NO_INLINE __declspec(noinline)
+#else
+#define NO_INLINE __attribute__((noinline))
+#endif
+
+#if !defined(_WIN32)
+#define UNREFERENCED_PARAMETER(x) (void)(x)
+#endif
 
 #if 0
 template <typename T>
@@ -202,7 +303,11 @@ bytes_to_readable_str(char* dst, u32 buf_size, f64 bytes)
 
 #define ARRAY_LENGTH(arr) (sizeof(arr) / sizeof((arr)[0]))
 
+#if defined(_MSC_VER)
 #define pass_by_register __vectorcall
+#else
+#define pass_by_register
+#endif
 
 #define DONT_IGNORE_RETURN [[nodiscard]]
 
@@ -211,10 +316,17 @@ bytes_to_readable_str(char* dst, u32 buf_size, f64 bytes)
 
 #define ASSERT_SERIALIZABLE(T) static_assert(__has_unique_object_representations(T))
 
+#if defined(_MSC_VER)
 #define PACK_STRUCT_BEGIN() __pragma(pack(push, 1))
 #define PACK_STRUCT_END()   __pragma(pack(pop))
+#else
+#define PACK_STRUCT_BEGIN() _Pragma("pack(push, 1)")
+#define PACK_STRUCT_END()   _Pragma("pack(pop)")
+#endif
 
-#ifdef FOUNDATION_EXPORT
+#if !defined(_WIN32)
+#define FOUNDATION_API __attribute__((visibility("default")))
+#elif defined(FOUNDATION_EXPORT)
 #define FOUNDATION_API __declspec(dllexport)
 #else
 #define FOUNDATION_API __declspec(dllimport)
@@ -246,7 +358,11 @@ template <class F> __Deferrer__<F> operator*(__DeferDummy__, F f) { return {f};
 FOUNDATION_API void print_backtrace(const char* fmt, ...);
 
 #ifdef DEBUG
+#if defined(_MSC_VER)
 #define DEBUG_BREAK() __debugbreak()
+#else
+#define DEBUG_BREAK() __builtin_trap()
+#endif
 
 #define ASSERT(expr) \
   do \
@@ -280,6 +396,7 @@ FOUNDATION_API void print_backtrace(const char* fmt, ...);
     } \
   } while(0)
 
+#if defined(_WIN32)
 #include <comdef.h>
 #define HASSERT(hres) \
   do \
@@ -293,6 +410,7 @@ FOUNDATION_API void print_backtrace(const char* fmt, ...);
       DEBUG_BREAK();  \
     } \
   } while(0)
+#endif
 #else
 #define DEBUG_BREAK() do { } while(0)
 #define ASSERT(expr) do { if (expr) { } } while(0)
@@ -301,7 +419,13 @@ FOUNDATION_API void print_backtrace(const char* fmt, ...);
 #define HASSERT(hres) hres
 #endif
 
-#define UNREACHABLE ASSERT_MSG_FATAL(false, "Something that should never happen did! Check the code to see why this bug occurred."); __assume(false)
+#if defined(_MSC_VER)
+#define ASSUME_UNREACHABLE() __assume(false)
+#else
+#define ASSUME_UNREACHABLE() __builtin_unreachable()
+#endif
+
+#define UNREACHABLE ASSERT_MSG_FATAL(false, "Something that should never happen did! Check the code to see why this bug occurred."); ASSUME_UNREACHABLE()
 
 #define STRING_LITERAL 
 
@@ -0,0 +1,189 @@
+#include "Core/Foundation/types.h"
+#include "Core/Foundation/memory.h"
+#include "Core/Foundation/filesystem.h"
+#include "Core/Foundation/sort.h"
+
+#include "Core/Tools/AssetBuilder/asset_packer.h"
+
+namespace asset_builder
+{
+  static bool
+  write_zeroes(FileStream file, u64 size)
+  {
+    static const u8 kZeroes[kAssetPackAlignment] = {0};
+    while (size > 0)
+    {
+      u64 write_size = MIN(size, sizeof(kZeroes));
+      if (!write_file(file, kZeroes, write_size))
+      {
+        return false;
+      }
+      size -= write_size;
+    }
+
+    return true;
+  }
+
+  bool
+  write_asset_pack(const char* project_root, const AssetId* asset_ids, u32 asset_count)
+  {
+    static constexpr u64 kCopyBufferSize = MiB(4);
+
+    AssetPackEntry* entries     = HEAP_ALLOC(AssetPackEntry, GLOBAL_HEAP, MAX(asset_count, 1U));
+    defer { HEAP_FREE(GLOBAL_HEAP, entries); };
+    u32             entry_count = 0;
+
+    char built_path[kMaxPathLength]{0};
+    for (u32 iasset = 0; iasset < asset_count; iasset++)
+    {
+      AssetId asset_id = asset_ids[iasset];
+      snprintf(built_path, sizeof(built_path), "%s/Assets/Built/0x%08x.built", project_root, asset_id);
+
+      auto built_file = open_file(built_path, kFileStreamRead);
+      if (!built_file)
+      {
+        printf("Failed to open %s! Skipping...\n", built_path);
+        continue;
+      }
+      defer { close_file(&built_file.value()); };
+
+      u64           size = get_file_size(built_file.value());
+      AssetMetadata metadata;
+      if (size < sizeof(metadata) || !read_file(built_file.value(), &metadata, sizeof(metadata), 0))
+      {
+        printf("Failed to read %s! Skipping...\n", built_path);
+        continue;
+      }
+
+      u64 header_size = get_asset_header_size(metadata.asset_type);
+      if (metadata.magic_number != kAssetMagicNumber || metadata.asset_hash != asset_id || header_size == 0 || size < header_size)
+      {
+        printf("%s is not a valid built asset! Skipping...\n", built_path);
+        continue;
+      }
+
+      AssetPackEntry* entry = entries + entry_count++;
+      entry->asset_id       = asset_id;
+      entry->asset_type     = metadata.asset_type;
+      entry->header_size    = header_size;
+      entry->content_size   = size - header_size;
+    }
+
+    // The streamer binary searches the TOC
+    radix_sort(entries, entry_count, sizeof(AssetPackEntry), offsetof(AssetPackEntry, asset_id));
+
+    u32 unique_count = 0;
+    for (u32 ientry = 0; ientry < entry_count; ientry++)
+    {
+      if (unique_count > 0 && entries[unique_count - 1].asset_id == entries[ientry].asset_id)
+      {
+        continue;
+      }
+      entries[unique_count++] = entries[ientry];
+    }
+    entry_count = unique_count;
+
+    AssetPackHeader header;
+    header.magic_number   = kAssetPackMagicNumber;
+    header.version        = kAssetPackVersion;
+    header.entry_count    = entry_count;
+    header.alignment      = kAssetPackAlignment;
+    header.toc_offset     = sizeof(AssetPackHeader);
+    header.payload_offset = ALIGN_POW2(header.toc_offset + entry_count * sizeof(AssetPackEntry), (u64)kAssetPackAlignment);
+
+    u64 offset = header.payload_offset;
+    for (u32 ientry = 0; ientry < entry_count; ientry++)
+    {
+      AssetPackEntry* entry = entries + ientry;
+      entry->header_offset  = offset;
+      entry->content_offset = offset + entry->header_size;
+      offset                = ALIGN_POW2(entry->content_offset + entry->content_size, (u64)kAssetPackAlignment);
+    }
+
+    char pack_path[kMaxPathLength]{0};
+    snprintf(pack_path, sizeof(pack_path), "%s/%s", project_root, kAssetPackPath);
+    printf("Writing %u assets to asset pack %s...\n", entry_count, pack_path);
+
+    auto pack_file = create_file(pack_path, FileCreateFlags::kCreateTruncateExisting);
+    if (!pack_file)
+    {
+      printf("Failed to create output file!\n");
+      return false;
+    }
+    defer { close_file(&pack_file.value()); };
+
+    if (!write_file(pack_file.value(), &header, sizeof(header)) ||
+        !write_file(pack_file.value(), entries, entry_count * sizeof(AssetPackEntry)))
+    {
+      printf("Failed to write output file!\n");
+      return false;
+    }
+
+    u8* copy_buffer = HEAP_ALLOC(u8, GLOBAL_HEAP, kCopyBufferSize);
+    defer { HEAP_FREE(GLOBAL_HEAP, copy_buffer); };
+
+    u64 pack_size = header.toc_offset + entry_count * sizeof(AssetPackEntry);
+    for (u32 ientry = 0; ientry < entry_count; ientry++)
+    {
+      const AssetPackEntry* entry = entries + ientry;
+      if (!write_zeroes(pack_file.value(), entry->header_offset - pack_size))
+      {
+        printf("Failed to write output file!\n");
+        return false;
+      }
+
+      snprintf(built_path, sizeof(built_path), "%s/Assets/Built/0x%08x.built", project_root, entry->asset_id);
+      auto built_file = open_file(built_path, kFileStreamRead);
+      if (!built_file)
+      {
+        printf("Failed to open %s!\n", built_path);
+        return false;
+      }
+      defer { close_file(&built_file.value()); };
+
+      u64 size = entry->header_size + entry->content_size;
+      for (u64 copied = 0; copied < size; copied += kCopyBufferSize)
+      {
+        u64 copy_size = MIN(size - copied, kCopyBufferSize);
+        if (!read_file(built_file.value(), copy_buffer, copy_size, copied) || !write_file(pack_file.value(), copy_buffer, copy_size))
+        {
+          printf("Failed to copy %s into the asset pack!\n", built_path);
+          return false;
+        }
+      }
+
+      pack_size = entry->header_offset + size;
+    }
+
+    // Pad out the last payload too so that rounding any read up to the alignment stays inside of the file
+    if (!write_zeroes(pack_file.value(), offset - pack_size))
+    {
+      printf("Failed to write output file!\n");
+      return false;
+    }
+
+    return true;
+  }
+
+  bool
+  delete_asset_pack(const char* project_root)
+  {
+    char pack_path[kMaxPathLength]{0};
+    snprintf(pack_path, sizeof(pack_path), "%s/%s", project_root, kAssetPackPath);
+
+    if (DeleteFileA(pack_path))
+    {
+      printf("Deleted asset pack %s, run AssetBuilder.exe --pack again to rebuild it.\n", pack_path);
+      return true;
+    }
+
+    DWORD err = GetLastError();
+    if (err == ERROR_FILE_NOT_FOUND || err == ERROR_PATH_NOT_FOUND)
+    {
+      return true;
+    }
+
+    printf("Failed to delete stale asset pack %s (error %lu)!\n", pack_path, err);
+    return false;
+  }
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "Core/Foundation/types.h"
+#include "Core/Foundation/assets.h"
+
+namespace asset_builder
+{
+  // Packs the already built Assets/Built/0x%08x.built file of every asset in asset_ids into Assets/Built/assets.pack
+  // (see AssetPackHeader). Assets that are missing or don't look like built assets get skipped, the streamer falls back
+  // to the loose file for anything that isn't in the pack.
+  DONT_IGNORE_RETURN bool write_asset_pack(
+    const char*    project_root,
+    const AssetId* asset_ids,
+    u32            asset_count
+  );
+
+  // Deletes Assets/Built/assets.pack if there is one. Needs to happen before any asset gets rebuilt, the streamer
+  // loads whatever's in the pack over the loose file so an old copy in there would shadow the new one. Returns false if
+  // the pack is there but couldn't be deleted (e.g. the engine has it open).
+  DONT_IGNORE_RETURN bool delete_asset_pack(const char* project_root);
+}
@@ -3,6 +3,7 @@
 
 #include "Core/Tools/AssetBuilder/model_importer.h"
 #include "Core/Tools/AssetBuilder/texture_importer.h"
+#include "Core/Tools/AssetBuilder/asset_packer.h"
 
 #include "Core/Vendor/D3D12/d3d12.h"
 #include <dxgidebug.h>
@@ -11,14 +12,82 @@
 
 static AllocHeap g_InitHeap;
 
+struct AssetCompressionDesc
+{
+  CompressionCodec codec = kCompressionCodecLz4;
+  CompressionLevel level = kCompressionLevelHigh;
+};
+
+// What the texture in each material slot holds, in the order model_importer fills them in
+static TextureUsage
+get_material_texture_usage(u32 slot)
+{
+  switch (slot)
+  {
+    case 0:  return kTextureUsageColor;  // Diffuse
+    case 1:  return kTextureUsageNormal; // Normal
+    default: return kTextureUsageLinear; // Roughness, metalness, AO
+  }
+}
+
+static DONT_IGNORE_RETURN bool
+parse_compression_desc(const char* str, AssetCompressionDesc* out_desc)
+{
+  if (strcmp(str, "none") == 0)
+  {
+    out_desc->codec = kCompressionCodecNone;
+  }
+  else if (strcmp(str, "lz4") == 0)
+  {
+    out_desc->codec = kCompressionCodecLz4;
+    out_desc->level = kCompressionLevelHigh;
+  }
+  else if (strcmp(str, "lz4-fast") == 0)
+  {
+    out_desc->codec = kCompressionCodecLz4;
+    out_desc->level = kCompressionLevelFast;
+  }
+  else
+  {
+    return false;
+  }
+
+  return true;
+}
+
+static DONT_IGNORE_RETURN bool
+parse_mip_filter(const char* str, MipFilter* out_filter)
+{
+  if (strcmp(str, "box") == 0)
+  {
+    *out_filter = kMipFilterBox;
+  }
+  else if (strcmp(str, "kaiser") == 0)
+  {
+    *out_filter = kMipFilterKaiser;
+  }
+  else
+  {
+    return false;
+  }
+
+  return true;
+}
+
 static DONT_IGNORE_RETURN bool
-build_asset(const char* model_path, const char* project_root)
+build_asset(const char* model_path, const char* project_root, const AssetCompressionDesc& compression, MipFilter mip_filter)
 {
   asset_builder::ImportedModel     imported_model;
 
   asset_builder::ImportedMaterial* imported_materials      = nullptr;
   u32                              imported_material_count = 0;
 
+  // The pack would take priority over everything that gets rebuilt here
+  if (!asset_builder::delete_asset_pack(project_root))
+  {
+    return false;
+  }
+
   bool res = asset_builder::import_model(
     g_InitHeap,
     model_path,
@@ -34,7 +103,7 @@ build_asset(const char* model_path, const char* project_root)
     return false;
   }
 
-  res = asset_builder::write_model_to_asset(project_root, imported_model);
+  res = asset_builder::write_model_to_asset(project_root, imported_model, compression.codec, compression.level);
   if (!res)
   {
     printf("Failed to write model to asset!\n");
@@ -85,7 +154,11 @@ build_asset(const char* model_path, const char* project_root)
         continue;
       }
 
-      res = write_texture_to_asset(device, project_root, imported_texture);
+      MipChainParams mip_params;
+      mip_params.usage  = get_material_texture_usage(itexture);
+      mip_params.filter = mip_filter;
+
+      res = write_texture_to_asset(device, project_root, imported_texture, mip_params, compression.codec, compression.level);
       if (!res)
       {
         printf("Failed to write texture to asset!\n");
@@ -97,16 +170,55 @@ build_asset(const char* model_path, const char* project_root)
   return true;
 }
 
+static DONT_IGNORE_RETURN bool
+pack_built_assets(const char* project_root)
+{
+  static constexpr u32 kMaxPackedAssets = 1 << 20;
+
+  char search_path[kMaxPathLength]{0};
+  snprintf(search_path, sizeof(search_path), "%s/Assets/Built/0x*.built", project_root);
 
-// AssetBuilder.exe <input_path> <project_root_dir>
+  Array<AssetId>   asset_ids = init_array<AssetId>(g_InitHeap, kMaxPackedAssets);
+
+  WIN32_FIND_DATAA find_data;
+  HANDLE           find      = FindFirstFileA(search_path, &find_data);
+  if (find == INVALID_HANDLE_VALUE)
+  {
+    printf("No built assets found in %s!\n", search_path);
+    return false;
+  }
+  defer { FindClose(find); };
+
+  do
+  {
+    char*   end      = nullptr;
+    AssetId asset_id = (AssetId)strtoul(find_data.cFileName, &end, 16);
+    if (end == nullptr || strcmp(end, ".built") != 0)
+    {
+      continue;
+    }
+
+    ASSERT_MSG_FATAL(asset_ids.size < kMaxPackedAssets, "Too many built assets to pack, bump kMaxPackedAssets.");
+    *array_add(&asset_ids) = asset_id;
+  } while (FindNextFileA(find, &find_data));
+
+  return asset_builder::write_asset_pack(project_root, asset_ids.memory, (u32)asset_ids.size);
+}
+
+
+// AssetBuilder.exe <input_path> <project_root_dir> [none|lz4|lz4-fast] [box|kaiser]
+// AssetBuilder.exe --pack <project_root_dir>
 int main(int argc, const char** argv)
 {
   static constexpr size_t kInitHeapSize = MiB(128);
 
-  if (argc != 3)
+  AssetCompressionDesc compression;
+  MipFilter            mip_filter = kMipFilterBox;
+  if ((argc < 3 || argc > 5) || (argc >= 4 && !parse_compression_desc(argv[3], &compression)) || (argc == 5 && !parse_mip_filter(argv[4], &mip_filter)))
   {
     printf("Invalid arguments!\n");
-    printf("AssetBuilder.exe <input_path> <project_root>\n");
+    printf("AssetBuilder.exe <input_path> <project_root> [none|lz4|lz4-fast] [box|kaiser]\n");
+    printf("AssetBuilder.exe --pack <project_root>\n");
     return 1;
   }
 
@@ -123,7 +235,19 @@ int main(int argc, const char** argv)
 
   init_thread_context();
 
-  bool res = build_asset(input_path, project_root);
+  if (strcmp(input_path, "--pack") == 0)
+  {
+    if (!pack_built_assets(project_root))
+    {
+      printf("Asset packing failed!\n");
+      return 1;
+    }
+
+    printf("\n\n=======================\nSuccessfully packed assets!\n\n");
+    return 0;
+  }
+
+  bool res = build_asset(input_path, project_root, compression, mip_filter);
   if (!res)
   {
     printf("Asset builder failed!\n");
@@ -317,7 +317,7 @@ asset_builder::import_model(
 }
 
 DONT_IGNORE_RETURN bool 
-asset_builder::write_model_to_asset(const char* project_root, const ImportedModel& model)
+asset_builder::write_model_to_asset(const char* project_root, const ImportedModel& model, CompressionCodec codec, CompressionLevel level)
 {
   u64 total_vertex_count = 0;
   u64 total_index_count  = 0;
@@ -336,13 +336,16 @@ asset_builder::write_model_to_asset(const char* project_root, const ImportedMode
 
   u64    vertices_size      = sizeof(VertexAsset) * total_vertex_count ;
   u64    indices_size       = sizeof(u16)         * total_index_count;
-  size_t output_size        = sizeof(ModelAsset)  +
+  u64    geometry_size      = vertices_size       + indices_size;
+  size_t max_output_size    = sizeof(ModelAsset)  +
                               model_subsets_size  +
-                              vertices_size       +
-                              indices_size;
+                              get_compressed_blob_bound(geometry_size);
 
+  // The vertices and indices get laid out here first, and then compressed into the output buffer after the subsets
+  u8* geometry = HEAP_ALLOC(u8, GLOBAL_HEAP, geometry_size);
+  defer { HEAP_FREE(GLOBAL_HEAP, geometry); };
 
-  u8* buffer = HEAP_ALLOC(u8, GLOBAL_HEAP, output_size);
+  u8* buffer = HEAP_ALLOC(u8, GLOBAL_HEAP, max_output_size);
   defer { HEAP_FREE(GLOBAL_HEAP, buffer); };
 
   u8* dst    = buffer;
@@ -359,12 +362,15 @@ asset_builder::write_model_to_asset(const char* project_root, const ImportedMode
 
   auto* dst_subsets  = ALLOC_OFF(dst, sizeof(ModelAsset::ModelSubset   ) * model.num_model_subsets);
   auto* dst_lods     = ALLOC_OFF(dst, sizeof(ModelAsset::ModelSubsetLod) * model.num_model_subsets * model.lod_count);
-  auto* dst_vertices = ALLOC_OFF(dst, sizeof(VertexAsset) * total_vertex_count);
-  auto* dst_indices  = ALLOC_OFF(dst, sizeof(u16)         * total_index_count);
+
+  // The offset pointers into the geometry point to where it ends up once it's decompressed in place
+  u64   geometry_offset = dst - buffer;
+  u8*   dst_vertices    = geometry;
+  u8*   dst_indices     = geometry + vertices_size;
 
   model_asset->model_subsets = dst_subsets - buffer;
-  model_asset->vertices      = dst_vertices - buffer;
-  model_asset->indices       = dst_indices  - buffer;
+  model_asset->vertices      = geometry_offset;
+  model_asset->indices       = geometry_offset + vertices_size;
   for (u32 imodel_subset = 0; imodel_subset < model.num_model_subsets; imodel_subset++)
   {
     const ImportedModelSubset* imported_model_subset = model.model_subsets + imodel_subset;
@@ -385,17 +391,22 @@ asset_builder::write_model_to_asset(const char* project_root, const ImportedMode
       auto* vertices    = ALLOC_OFF(dst_vertices, sizeof(VertexAsset) * lod->num_vertices);
       auto* indices     = ALLOC_OFF(dst_indices,  sizeof(u16)         * lod->num_indices );
 
-      lod->vertices     = vertices - buffer;
-      lod->indices      = indices  - buffer;
+      lod->vertices     = geometry_offset + (vertices - geometry);
+      lod->indices      = geometry_offset + (indices  - geometry);
 
       memcpy(vertices, imported_lod->vertices, sizeof(VertexAsset) * lod->num_vertices);
       memcpy(indices,  imported_lod->indices,  sizeof(u16)         * lod->num_indices );
     }
   }
 
+  model_asset->geometry_compressed_size = compress_blob(dst, geometry, geometry_size, codec, level);
+  dst                                  += model_asset->geometry_compressed_size;
+
+  size_t output_size = dst - buffer;
+
   char built_path[512]{0};
   snprintf(built_path, sizeof(built_path), "%s/Assets/Built/0x%08x.built", project_root, model.hash);
-  printf("Writing model asset file to %s...\n", built_path);
+  printf("Writing model asset file to %s (%s, %.2fx)...\n", built_path, compression_codec_to_str(codec), (f64)geometry_size / (f64)model_asset->geometry_compressed_size);
 
   auto new_file = create_file(built_path, FileCreateFlags::kCreateTruncateExisting);
   if (!new_file)
@@ -406,7 +417,7 @@ asset_builder::write_model_to_asset(const char* project_root, const ImportedMode
 
   defer { close_file(&new_file.value()); };
 
-  ASSERT_MSG_FATAL((u64)(dst - buffer) == output_size, "Mismatched output size and written size! Expected %llu bytes but got %llu bytes", output_size, dst - buffer);
+  ASSERT_MSG_FATAL(output_size <= max_output_size, "Compressed model is bigger than the bound! Expected at most %llu bytes but got %llu bytes", max_output_size, output_size);
   if (!write_file(new_file.value(), buffer, output_size))
   {
     printf("Failed to write output file!\n");
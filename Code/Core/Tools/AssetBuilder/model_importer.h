@@ -55,7 +55,9 @@ namespace asset_builder
 
   DONT_IGNORE_RETURN bool write_model_to_asset(
     const char* project_root,
-    const ImportedModel& model
+    const ImportedModel& model,
+    CompressionCodec codec = kCompressionCodecLz4,
+    CompressionLevel level = kCompressionLevelHigh
   );
 }
 
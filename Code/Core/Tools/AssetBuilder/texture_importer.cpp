@@ -175,11 +175,11 @@ struct BCCompressionStats
 };
 
 static BCCompressionStats
-get_bc7_compression_stats(const ImportedTexture& texture)
+get_bc7_compression_stats(u32 width, u32 height)
 {
   BCCompressionStats ret = {0};
-  ret.blocks_x           = UCEIL_DIV(texture.width,  4);
-  ret.blocks_y           = UCEIL_DIV(texture.height, 4);
+  ret.blocks_x           = UCEIL_DIV(width,  4);
+  ret.blocks_y           = UCEIL_DIV(height, 4);
   ret.uncompressed_size  = ret.blocks_x * ret.blocks_y * BC7ENC_BLOCK_SIZE;
   return ret;
 }
@@ -204,47 +204,56 @@ static DXGI_FORMAT gpu_format_to_d3d12(GpuFormat format)
 
 // TODO(bshihabi): How will this work with other graphics API backends in the future? I'm guessing
 // we'll have to have a platform independent and platform dependent built asset files in the future.
-static GpuTextureCopyableFootprint
-get_d3d12_texture_copyable_footprint(ID3D12Device* device, const ImportedTexture& texture, GpuFormat dst_format)
-{
+static u64
+get_d3d12_texture_copyable_footprints(
+  ID3D12Device* device,
+  const ImportedTexture& texture,
+  u32 mip_count,
+  GpuFormat dst_format,
+  GpuTextureCopyableFootprint* out_footprints
+) {
   D3D12_RESOURCE_DESC desc = {0};
   desc.Dimension           = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
   desc.Alignment           = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
   desc.DepthOrArraySize    = 1;
   desc.Width               = texture.width;
   desc.Height              = texture.height;
-  desc.MipLevels           = 1;
+  desc.MipLevels           = (u16)mip_count;
   desc.Format              = gpu_format_to_d3d12(dst_format);
   desc.SampleDesc.Count    = 1;
   desc.SampleDesc.Quality  = 0;
   desc.Layout              = D3D12_TEXTURE_LAYOUT_UNKNOWN;
   desc.Flags               = D3D12_RESOURCE_FLAG_NONE;
 
-  D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
-  u32 row_count;
-  u64 row_byte_count;
-  u64 total_size;
-  device->GetCopyableFootprints(&desc, 0, 1, 0, &footprint, &row_count, &row_byte_count, &total_size);
-
-  GpuTextureCopyableFootprint ret;
-  ret.offset                = footprint.Offset;
-  ret.row_count             = row_count;
-  ret.row_byte_count        = row_byte_count;
-  ret.row_padded_byte_count = footprint.Footprint.RowPitch;
-  ret.total_size            = total_size;
-  return ret;
+  D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprints[kMaxTextureMips];
+  u32                                row_counts[kMaxTextureMips];
+  u64                                row_byte_counts[kMaxTextureMips];
+  u64                                total_size;
+  device->GetCopyableFootprints(&desc, 0, mip_count, 0, footprints, row_counts, row_byte_counts, &total_size);
+
+  for (u32 imip = 0; imip < mip_count; imip++)
+  {
+    GpuTextureCopyableFootprint* dst = out_footprints + imip;
+    dst->offset                      = footprints[imip].Offset;
+    dst->row_count                   = row_counts[imip];
+    dst->row_byte_count              = row_byte_counts[imip];
+    dst->row_padded_byte_count       = footprints[imip].Footprint.RowPitch;
+    // NOTE(bshihabi): This is what GetCopyableFootprints gives back for just this one subresource, the last row
+    // doesn't get padded. gpu_copy_texture checks the size it gets against exactly this.
+    dst->total_size                  = dst->row_padded_byte_count * (dst->row_count - 1) + dst->row_byte_count;
+  }
+
+  return total_size;
 }
 
-static u64
-compress_bc7_write_to_buffer(u8* dst_base, const ImportedTexture& texture, const BCCompressionStats& stats, const GpuTextureCopyableFootprint& footprint)
+static void
+compress_bc7_write_to_buffer(u8* dst_base, const MipLevel& mip, const GpuTextureCopyableFootprint& footprint)
 {
-  bc7enc_compress_block_init();
-
   bc7enc_compress_block_params params;
   bc7enc_compress_block_params_init(&params);
 
-  u32 bpp = get_uncompressed_bytes_per_pixel(texture);
-  u8* dst = dst_base + footprint.offset;
+  BCCompressionStats stats = get_bc7_compression_stats(mip.width, mip.height);
+  u8*                dst   = dst_base + footprint.offset;
 
   for (u32 by = 0; by < stats.blocks_y; by++)
   {
@@ -257,9 +266,9 @@ compress_bc7_write_to_buffer(u8* dst_base, const ImportedTexture& texture, const
       {
         for (u32 px = 0; px < 4; px++)
         {
-                u32 src_x = MIN(bx * 4 + px, texture.width  - 1);
-                u32 src_y = MIN(by * 4 + py, texture.height - 1);
-          const u8* src   = texture.buf + (src_y * texture.width + src_x) * bpp;
+                u32 src_x = MIN(bx * 4 + px, mip.width  - 1);
+                u32 src_y = MIN(by * 4 + py, mip.height - 1);
+          const u8* src   = mip.buf + (src_y * mip.width + src_x) * 4;
           uncompressed_block[py * 4 + px] = { src[0], src[1], src[2], src[3] };
         }
       }
@@ -267,8 +276,6 @@ compress_bc7_write_to_buffer(u8* dst_base, const ImportedTexture& texture, const
       bc7enc_compress_block(row_dst + bx * BC7ENC_BLOCK_SIZE, uncompressed_block, &params);
     }
   }
-
-  return footprint.total_size;
 }
 
 
@@ -300,19 +307,42 @@ bool
 write_texture_to_asset(
   ID3D12Device* device,
   const char* project_root,
-  const ImportedTexture& texture
+  const ImportedTexture& texture,
+  const MipChainParams& mip_params,
+  CompressionCodec codec,
+  CompressionLevel level
 ) {
-  TextureCompression          compression = TextureCompression::kBc7; // TextureCompression::kUncompressed;
-  GpuFormat                   format      = kGpuFormatBC7Unorm; // kGpuFormatRGBA8Unorm;
-  BCCompressionStats          stats       = get_bc7_compression_stats(texture);
-  GpuTextureCopyableFootprint footprint   = get_d3d12_texture_copyable_footprint(device, texture, format);
+  ASSERT_MSG_FATAL(texture.format == TextureFormat::kRGBA8Unorm, "Mips can only be generated for RGBA8 textures!");
+
+  TextureCompression compression = TextureCompression::kBc7; // TextureCompression::kUncompressed;
+  GpuFormat          format      = kGpuFormatBC7Unorm; // kGpuFormatRGBA8Unorm;
+
+  MipChain mips = generate_mip_chain(GLOBAL_HEAP, texture.buf, texture.width, texture.height, mip_params);
+  defer { free_mip_chain(GLOBAL_HEAP, &mips); };
+
+  GpuTextureCopyableFootprint footprints[kMaxTextureMips];
+  u64                         bc_size = get_d3d12_texture_copyable_footprints(device, texture, mips.mip_count, format, footprints);
+
+  // The BC compressed texture gets written here first, and then compressed into the output buffer after the header
+  u8* bc_buffer = HEAP_ALLOC(u8, GLOBAL_HEAP, bc_size);
+  defer { HEAP_FREE(GLOBAL_HEAP, bc_buffer); };
+
+  // Row padding never gets written, leaving garbage in it would just make it compress worse
+  zero_memory(bc_buffer, bc_size);
 
-  u32 output_size = (u32)(sizeof(TextureAsset) + footprint.total_size);
+  bc7enc_compress_block_init();
+  for (u32 imip = 0; imip < mips.mip_count; imip++)
+  {
+    compress_bc7_write_to_buffer(bc_buffer, mips.mips[imip], footprints[imip]);
+  }
 
-  u8* buffer = HEAP_ALLOC(u8, GLOBAL_HEAP, output_size);
+  u64 max_output_size = sizeof(TextureAsset) + get_compressed_blob_bound(bc_size);
+
+  u8* buffer = HEAP_ALLOC(u8, GLOBAL_HEAP, max_output_size);
   defer { HEAP_FREE(GLOBAL_HEAP, buffer); };
 
-  u8* dst    = buffer;
+  u64 compressed_size = compress_blob(buffer + sizeof(TextureAsset), bc_buffer, bc_size, codec, level);
+  u32 output_size     = (u32)(sizeof(TextureAsset) + compressed_size);
 
   TextureAsset texture_asset = {0};
   texture_asset.metadata.magic_number    = kAssetMagicNumber;
@@ -321,23 +351,28 @@ write_texture_to_asset(
   texture_asset.metadata.asset_hash      = texture.hash;
   texture_asset.texture_compression      = compression;
   texture_asset.gpu_format               = format;
+  texture_asset.codec                    = codec;
+  texture_asset.mip_count                = (u8)mips.mip_count;
   texture_asset.color_space              = texture.color_space;
   texture_asset.width                    = texture.width;
   texture_asset.height                   = texture.height;
   // NOTE(bshihabi): I intentionally use the BC compressed size as the "uncompressed size". This is because
   // "uncompressed size" means what is consumed after LZ compression. It is used as a "check" of sorts in the runtime.
   // I never block decompress the raw texture so there is no point in storing that information in the texture anywhere.
-  texture_asset.compressed_size          = (u32)footprint.total_size;
-  texture_asset.uncompressed_size        = (u32)footprint.total_size;
+  texture_asset.compressed_size          = (u32)compressed_size;
+  texture_asset.uncompressed_size        = (u32)bc_size;
+  for (u32 imip = 0; imip < mips.mip_count; imip++)
+  {
+    texture_asset.mip_offsets[imip]      = (u32)footprints[imip].offset;
+    texture_asset.mip_sizes  [imip]      = (u32)footprints[imip].total_size;
+  }
   texture_asset.data                     = sizeof(TextureAsset);
 
-  memcpy(dst, &texture_asset, sizeof(TextureAsset)); dst += sizeof(TextureAsset);
-  dst += compress_bc7_write_to_buffer(dst, texture, stats, footprint);
-  // ASSERT_MSG_FATAL(dst - buffer == sizeof(TextureAsset) + texture_asset.uncompressed_size, "Wrote out incorrect number of bytes to final texture! Expected 0x%llx but got 0x%llx", texture_asset.uncompressed_size, dst - buffer - sizeof(TextureAsset));
+  memcpy(buffer, &texture_asset, sizeof(TextureAsset));
 
   char built_path[kMaxPathLength]{0};
   snprintf(built_path, sizeof(built_path), "%s/Assets/Built/0x%08x.built", project_root, texture.hash);
-  printf("Writing texture asset file %s to %s...\n", texture.path, built_path);
+  printf("Writing texture asset file %s to %s (%s, %u mips, %s, %.2fx)...\n", texture.path, built_path, texture_usage_to_str(mip_params.usage), mips.mip_count, compression_codec_to_str(codec), (f64)bc_size / (f64)compressed_size);
 
   auto new_file = create_file(built_path, FileCreateFlags::kCreateTruncateExisting);
   if (!new_file)
@@ -6,6 +6,8 @@
 #include "Core/Foundation/assets.h"
 #include "Core/Foundation/colors.h"
 
+#include "Core/Tools/AssetBuilder/texture_mips.h"
+
 struct ID3D12Device;
 
 struct ImportedTexture
@@ -34,5 +36,8 @@ void dump_imported_texture(ImportedTexture texture);
 DONT_IGNORE_RETURN bool write_texture_to_asset(
   ID3D12Device* device,
   const char* project_root,
-  const ImportedTexture& texture
+  const ImportedTexture& texture,
+  const MipChainParams& mip_params,
+  CompressionCodec codec = kCompressionCodecLz4,
+  CompressionLevel level = kCompressionLevelHigh
 );
@@ -0,0 +1,618 @@
+#include "Core/Foundation/math.h"
+
+#include "Core/Tools/AssetBuilder/texture_mips.h"
+
+#include <math.h>
+#include <float.h>
+
+// Mips get filtered as RGBA f32 texels, so one texel is exactly one SSE register and two are one AVX register.
+static constexpr u32 kTexelFloats        = 4;
+static constexpr u32 kTexelSize          = kTexelFloats * sizeof(f32);
+
+// Kaiser filter radius in destination texels and the window's shape parameter. These are the usual values, a radius
+// of 3 keeps most of the sinc's first two lobes.
+static constexpr f32 kKaiserRadius       = 3.0f;
+static constexpr f32 kKaiserBeta         = 4.0f;
+
+// The alpha coverage search works on a histogram of the filtered alpha values instead of searching over the texels
+static constexpr u32 kAlphaHistogramSize = 0x10000;
+
+static const bool g_MipUseAvx2           = cpu_supports_avx2();
+
+const char*
+texture_usage_to_str(TextureUsage usage)
+{
+  switch (usage)
+  {
+    case kTextureUsageColor:  return "Color";
+    case kTextureUsageLinear: return "Linear";
+    case kTextureUsageNormal: return "Normal";
+    default: UNREACHABLE;
+  }
+  return "Unknown";
+}
+
+u32
+get_mip_count(u32 width, u32 height)
+{
+  u32 size = MAX(MAX(width, height), 1);
+  return 32 - count_leading_zeroes(size);
+}
+
+//
+// sRGB
+//
+
+// Encoding to sRGB is a 16 bit table lookup followed by a single compare against the decoded midpoint between that
+// byte and the next one. The midpoints are at least 3e-4 apart while a table entry is 1.5e-5 wide, so there's never
+// more than one midpoint inside of an entry and the result is exactly what rounding the sRGB curve would give.
+static constexpr u32 kLinearToSrgbTableSize = 0x10000;
+
+struct SrgbTables
+{
+  f32 to_linear[256];
+  // thresholds[i] is the linear value halfway between sRGB bytes i - 1 and i
+  f32 thresholds[257];
+  u8  from_linear[kLinearToSrgbTableSize];
+};
+
+static f32
+srgb_to_linear(f32 srgb)
+{
+  return srgb <= 0.04045f ? srgb / 12.92f : powf((srgb + 0.055f) / 1.055f, 2.4f);
+}
+
+static void
+init_srgb_tables(SrgbTables* tables)
+{
+  for (u32 i = 0; i < 256; i++)
+  {
+    tables->to_linear[i] = srgb_to_linear((f32)i / 255.0f);
+  }
+
+  tables->thresholds[0]   = -FLT_MAX;
+  for (u32 i = 1; i < 256; i++)
+  {
+    tables->thresholds[i] = srgb_to_linear(((f32)i - 0.5f) / 255.0f);
+  }
+  tables->thresholds[256] = FLT_MAX;
+
+  u32 srgb = 0;
+  for (u32 i = 0; i < kLinearToSrgbTableSize; i++)
+  {
+    f32 linear = (f32)i / (f32)(kLinearToSrgbTableSize - 1);
+    while (tables->thresholds[srgb + 1] <= linear)
+    {
+      srgb++;
+    }
+    tables->from_linear[i] = (u8)srgb;
+  }
+}
+
+static SrgbTables g_SrgbTables;
+static const bool g_SrgbTablesInitialized = (init_srgb_tables(&g_SrgbTables), true);
+
+static u8
+linear_to_srgb_u8(f32 linear)
+{
+  linear  = CLAMP(linear, 0.0f, 1.0f);
+  u32 ret = g_SrgbTables.from_linear[(u32)(linear * (f32)(kLinearToSrgbTableSize - 1))];
+  return (u8)(ret + (linear >= g_SrgbTables.thresholds[ret + 1]));
+}
+
+//
+// Texel conversion
+//
+
+static void
+decode_texels(f32* dst, const u8* src, u64 texel_count, TextureUsage usage)
+{
+  if (usage == kTextureUsageColor)
+  {
+    for (u64 i = 0; i < texel_count; i++)
+    {
+      const u8* texel = src + i * 4;
+      _mm_store_ps(dst + i * kTexelFloats, _mm_setr_ps(g_SrgbTables.to_linear[texel[0]], g_SrgbTables.to_linear[texel[1]], g_SrgbTables.to_linear[texel[2]], (f32)texel[3] / 255.0f));
+    }
+    return;
+  }
+
+  f32x4 scale = usage == kTextureUsageNormal ? _mm_setr_ps(2.0f / 255.0f, 2.0f / 255.0f, 2.0f / 255.0f, 1.0f / 255.0f) : _mm_set1_ps(1.0f / 255.0f);
+  f32x4 bias  = usage == kTextureUsageNormal ? _mm_setr_ps(-1.0f, -1.0f, -1.0f, 0.0f)                                 : _mm_setzero_ps();
+  u8x16 zero  = _mm_setzero_si128();
+  for (u64 i = 0; i < texel_count; i++)
+  {
+    s32 packed;
+    memcpy(&packed, src + i * 4, sizeof(packed));
+
+    s32x4 texel = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+    _mm_store_ps(dst + i * kTexelFloats, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(texel), scale), bias));
+  }
+}
+
+static void
+encode_texels(u8* dst, const f32* src, u64 texel_count, TextureUsage usage, f32 alpha_scale)
+{
+  if (usage == kTextureUsageColor)
+  {
+    for (u64 i = 0; i < texel_count; i++)
+    {
+      const f32* texel = src + i * kTexelFloats;
+            u8*  out   = dst + i * 4;
+      out[0] = linear_to_srgb_u8(texel[0]);
+      out[1] = linear_to_srgb_u8(texel[1]);
+      out[2] = linear_to_srgb_u8(texel[2]);
+      out[3] = (u8)(CLAMP(texel[3] * alpha_scale, 0.0f, 1.0f) * 255.0f + 0.5f);
+    }
+    return;
+  }
+
+  f32x4 scale = usage == kTextureUsageNormal ? _mm_setr_ps(127.5f, 127.5f, 127.5f, 255.0f) : _mm_set1_ps(255.0f);
+  f32x4 bias  = usage == kTextureUsageNormal ? _mm_setr_ps(127.5f, 127.5f, 127.5f, 0.0f)   : _mm_setzero_ps();
+  f32x4 zero  = _mm_setzero_ps();
+  f32x4 top   = _mm_set1_ps(255.0f);
+  for (u64 i = 0; i < texel_count; i++)
+  {
+    f32x4 texel = _mm_add_ps(_mm_mul_ps(_mm_load_ps(src + i * kTexelFloats), scale), bias);
+    // Adding 0.5 and truncating instead of _mm_cvtps_epi32 so that this rounds the same way as the sRGB path
+    texel       = _mm_add_ps(_mm_min_ps(_mm_max_ps(texel, zero), top), _mm_set1_ps(0.5f));
+    s32x4 ints  = _mm_cvttps_epi32(texel);
+    s32   packed = _mm_cvtsi128_si32(_mm_packus_epi16(_mm_packs_epi32(ints, ints), ints));
+    memcpy(dst + i * 4, &packed, sizeof(packed));
+  }
+}
+
+// Filters can overshoot (Kaiser's negative lobes) and averaged normals get shorter, this puts every texel back in
+// range before the next mip gets filtered from it.
+static void
+finish_texels(f32* texels, u64 texel_count, TextureUsage usage)
+{
+  f32x4 zero = _mm_setzero_ps();
+  f32x4 one  = _mm_set1_ps(1.0f);
+  if (usage != kTextureUsageNormal)
+  {
+    for (u64 i = 0; i < texel_count; i++)
+    {
+      f32* texel = texels + i * kTexelFloats;
+      _mm_store_ps(texel, _mm_min_ps(_mm_max_ps(_mm_load_ps(texel), zero), one));
+    }
+    return;
+  }
+
+  f32x4 xyz_mask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+  f32x4 up       = _mm_setr_ps(0.0f, 0.0f, 1.0f, 0.0f);
+  for (u64 i = 0; i < texel_count; i++)
+  {
+    f32*  texel  = texels + i * kTexelFloats;
+    f32x4 v      = _mm_load_ps(texel);
+    f32x4 xyz    = _mm_and_ps(v, xyz_mask);
+    f32x4 w      = _mm_andnot_ps(xyz_mask, _mm_min_ps(_mm_max_ps(v, zero), one));
+
+    f32x4 len_sq = _mm_mul_ps(xyz, xyz);
+    len_sq       = _mm_add_ps(len_sq, _mm_shuffle_ps(len_sq, len_sq, _MM_SHUFFLE(2, 3, 0, 1)));
+    len_sq       = _mm_add_ps(len_sq, _mm_shuffle_ps(len_sq, len_sq, _MM_SHUFFLE(1, 0, 3, 2)));
+
+    // Normals pointing in opposite directions can cancel out completely, there's nothing to renormalize then
+    if (_mm_cvtss_f32(len_sq) < 1e-12f)
+    {
+      xyz = up;
+    }
+    else
+    {
+      xyz = _mm_and_ps(_mm_div_ps(xyz, _mm_sqrt_ps(len_sq)), xyz_mask);
+    }
+
+    _mm_store_ps(texel, _mm_or_ps(xyz, w));
+  }
+}
+
+//
+// Box 2x2
+//
+
+// Both versions add the rows first and the columns second so they round exactly the same way, mips shouldn't depend
+// on which CPU built them.
+static void
+downsample_box_2x2_sse(f32* dst, const f32* src, u32 src_width, u32 dst_width, u32 dst_height, u32 first_x = 0)
+{
+  f32x4 quarter = _mm_set1_ps(0.25f);
+  for (u32 y = 0; y < dst_height; y++)
+  {
+    const f32* row0 = src  + (u64)(2 * y) * src_width * kTexelFloats;
+    const f32* row1 = row0 + (u64)src_width * kTexelFloats;
+          f32* out  = dst  + (u64)y * dst_width * kTexelFloats;
+
+    for (u32 x = first_x; x < dst_width; x++)
+    {
+      f32x4 left  = _mm_add_ps(_mm_load_ps(row0 + (2 * x + 0) * kTexelFloats), _mm_load_ps(row1 + (2 * x + 0) * kTexelFloats));
+      f32x4 right = _mm_add_ps(_mm_load_ps(row0 + (2 * x + 1) * kTexelFloats), _mm_load_ps(row1 + (2 * x + 1) * kTexelFloats));
+      _mm_store_ps(out + x * kTexelFloats, _mm_mul_ps(_mm_add_ps(left, right), quarter));
+    }
+  }
+}
+
+TARGET_AVX2 static void
+downsample_box_2x2_avx2(f32* dst, const f32* src, u32 src_width, u32 dst_width, u32 dst_height)
+{
+  f32x8 quarter = _mm256_set1_ps(0.25f);
+  u32   width2  = dst_width & ~1U;
+  for (u32 y = 0; y < dst_height; y++)
+  {
+    const f32* row0 = src  + (u64)(2 * y) * src_width * kTexelFloats;
+    const f32* row1 = row0 + (u64)src_width * kTexelFloats;
+          f32* out  = dst  + (u64)y * dst_width * kTexelFloats;
+
+    // Two output texels from four input columns at a time
+    for (u32 x = 0; x < width2; x += 2)
+    {
+      f32x8 a     = _mm256_add_ps(_mm256_loadu_ps(row0 + (2 * x + 0) * kTexelFloats), _mm256_loadu_ps(row1 + (2 * x + 0) * kTexelFloats));
+      f32x8 b     = _mm256_add_ps(_mm256_loadu_ps(row0 + (2 * x + 2) * kTexelFloats), _mm256_loadu_ps(row1 + (2 * x + 2) * kTexelFloats));
+      f32x8 left  = _mm256_permute2f128_ps(a, b, 0x20);
+      f32x8 right = _mm256_permute2f128_ps(a, b, 0x31);
+      _mm256_storeu_ps(out + x * kTexelFloats, _mm256_mul_ps(_mm256_add_ps(left, right), quarter));
+    }
+  }
+
+  if (width2 != dst_width)
+  {
+    downsample_box_2x2_sse(dst, src, src_width, dst_width, dst_height, width2);
+  }
+}
+
+//
+// Separable filters
+//
+// Used by Kaiser and by box when a dimension is odd. Every destination texel along an axis gets a list of
+// (source index, weight) taps, and the image gets filtered horizontally and then vertically.
+//
+
+struct MipFilterTaps
+{
+  // Taps of destination texel i are [offsets[i], offsets[i + 1])
+  u32* offsets = nullptr;
+  u32* indices = nullptr;
+  f32* weights = nullptr;
+};
+
+static f32
+bessel_i0(f32 x)
+{
+  f32 ret  = 1.0f;
+  f32 term = 1.0f;
+  for (u32 k = 1; k < 32; k++)
+  {
+    f32 half_x_over_k = x / (2.0f * (f32)k);
+    term *= half_x_over_k * half_x_over_k;
+    ret  += term;
+    if (term < ret * 1e-8f)
+    {
+      break;
+    }
+  }
+  return ret;
+}
+
+static f32
+kaiser_sinc(f32 x)
+{
+  f32 t = x / kKaiserRadius;
+  if (t <= -1.0f || t >= 1.0f)
+  {
+    return 0.0f;
+  }
+
+  f32 sinc   = x == 0.0f ? 1.0f : sinf(kPI * x) / (kPI * x);
+  f32 window = bessel_i0(kKaiserBeta * sqrtf(1.0f - t * t)) / bessel_i0(kKaiserBeta);
+  return sinc * window;
+}
+
+static MipFilterTaps
+init_mip_filter_taps(FreeHeap heap, u32 src_count, u32 dst_count, MipFilter filter)
+{
+  f32 scale    = (f32)src_count / (f32)dst_count;
+  f32 support  = filter == kMipFilterKaiser ? kKaiserRadius * scale : scale;
+  u32 max_taps = (u32)ceilf(2.0f * support) + 2;
+
+  MipFilterTaps ret;
+  ret.offsets = HEAP_ALLOC(u32, heap, dst_count + 1);
+  ret.indices = HEAP_ALLOC(u32, heap, (u64)dst_count * max_taps);
+  ret.weights = HEAP_ALLOC(f32, heap, (u64)dst_count * max_taps);
+
+  u32 count = 0;
+  for (u32 i = 0; i < dst_count; i++)
+  {
+    ret.offsets[i] = count;
+
+    f32 total = 0.0f;
+    if (filter == kMipFilterKaiser)
+    {
+      // Wraps around the edges the same way the sampler does
+      f32 center = ((f32)i + 0.5f) * scale;
+      s32 first  = (s32)floorf(center - support);
+      s32 last   = (s32)ceilf (center + support);
+      for (s32 j = first; j <= last; j++)
+      {
+        f32 weight = kaiser_sinc(((f32)j + 0.5f - center) / scale);
+        if (weight == 0.0f)
+        {
+          continue;
+        }
+
+        ret.indices[count] = (u32)(((j % (s32)src_count) + (s32)src_count) % (s32)src_count);
+        ret.weights[count] = weight;
+        total             += weight;
+        count++;
+      }
+    }
+    else
+    {
+      // Every source texel is weighted by how much of it the destination texel covers
+      f32 begin = (f32)i * scale;
+      f32 end   = (f32)(i + 1) * scale;
+      for (u32 j = (u32)floorf(begin); j < MIN((u32)ceilf(end), src_count); j++)
+      {
+        f32 weight = MIN(end, (f32)(j + 1)) - MAX(begin, (f32)j);
+        if (weight <= 0.0f)
+        {
+          continue;
+        }
+
+        ret.indices[count] = j;
+        ret.weights[count] = weight;
+        total             += weight;
+        count++;
+      }
+    }
+
+    ASSERT_MSG_FATAL(count - ret.offsets[i] <= max_taps, "Mip filter has more taps than it was allocated for!");
+    for (u32 itap = ret.offsets[i]; itap < count; itap++)
+    {
+      ret.weights[itap] /= total;
+    }
+  }
+  ret.offsets[dst_count] = count;
+
+  return ret;
+}
+
+static void
+free_mip_filter_taps(FreeHeap heap, MipFilterTaps* taps)
+{
+  HEAP_FREE(heap, taps->offsets);
+  HEAP_FREE(heap, taps->indices);
+  HEAP_FREE(heap, taps->weights);
+  zero_memory(taps, sizeof(MipFilterTaps));
+}
+
+// dst += weight * src over float_count floats
+static void
+accumulate_row_sse(f32* dst, const f32* src, f32 weight, u64 float_count, u64 first = 0)
+{
+  f32x4 w = _mm_set1_ps(weight);
+  for (u64 i = first; i < float_count; i += 4)
+  {
+    _mm_store_ps(dst + i, _mm_add_ps(_mm_load_ps(dst + i), _mm_mul_ps(w, _mm_load_ps(src + i))));
+  }
+}
+
+TARGET_AVX2 static void
+accumulate_row_avx2(f32* dst, const f32* src, f32 weight, u64 float_count)
+{
+  f32x8 w      = _mm256_set1_ps(weight);
+  u64   count8 = float_count & ~7ULL;
+  for (u64 i = 0; i < count8; i += 8)
+  {
+    _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(w, _mm256_loadu_ps(src + i))));
+  }
+
+  if (count8 != float_count)
+  {
+    accumulate_row_sse(dst, src, weight, float_count, count8);
+  }
+}
+
+static void
+downsample_separable(FreeHeap heap, f32* dst, const f32* src, u32 src_width, u32 src_height, u32 dst_width, u32 dst_height, MipFilter filter, bool use_avx2)
+{
+  MipFilterTaps x_taps = init_mip_filter_taps(heap, src_width,  dst_width,  filter);
+  MipFilterTaps y_taps = init_mip_filter_taps(heap, src_height, dst_height, filter);
+  defer
+  {
+    free_mip_filter_taps(heap, &x_taps);
+    free_mip_filter_taps(heap, &y_taps);
+  };
+
+  // Horizontally filtered, dst_width x src_height
+  f32* tmp = (f32*)HEAP_ALLOC_ALIGNED(heap, (u64)dst_width * src_height * kTexelSize, 32);
+  defer { HEAP_FREE(heap, tmp); };
+
+  for (u32 y = 0; y < src_height; y++)
+  {
+    const f32* in  = src + (u64)y * src_width * kTexelFloats;
+          f32* out = tmp + (u64)y * dst_width * kTexelFloats;
+    for (u32 x = 0; x < dst_width; x++)
+    {
+      f32x4 acc = _mm_setzero_ps();
+      for (u32 itap = x_taps.offsets[x]; itap < x_taps.offsets[x + 1]; itap++)
+      {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(x_taps.weights[itap]), _mm_load_ps(in + x_taps.indices[itap] * kTexelFloats)));
+      }
+      _mm_store_ps(out + x * kTexelFloats, acc);
+    }
+  }
+
+  // Vertically a whole row gets accumulated per tap, which keeps the reads sequential
+  u64 row_floats = (u64)dst_width * kTexelFloats;
+  for (u32 y = 0; y < dst_height; y++)
+  {
+    f32* out = dst + y * row_floats;
+    zero_memory(out, row_floats * sizeof(f32));
+    for (u32 itap = y_taps.offsets[y]; itap < y_taps.offsets[y + 1]; itap++)
+    {
+      const f32* in = tmp + y_taps.indices[itap] * row_floats;
+      if (use_avx2)
+      {
+        accumulate_row_avx2(out, in, y_taps.weights[itap], row_floats);
+      }
+      else
+      {
+        accumulate_row_sse(out, in, y_taps.weights[itap], row_floats);
+      }
+    }
+  }
+}
+
+//
+// Alpha coverage
+//
+// Averaging alpha changes how much of the texture passes the alpha test, with a low cutoff like ours foliage and
+// fences get thicker and thicker in the distance. Every mip gets its alpha scaled so that the same fraction of its
+// texels pass the test as in mip 0 (Castano, "Computing Alpha Mipmaps").
+//
+
+// Smallest 8 bit alpha that passes the test in the shader
+static u32
+get_alpha_cutoff_u8(f32 cutoff)
+{
+  u32 ret = 0;
+  while (ret < 255 && (f32)ret / 255.0f < cutoff)
+  {
+    ret++;
+  }
+  return ret;
+}
+
+f32
+get_alpha_coverage(const u8* rgba8, u32 width, u32 height, f32 cutoff)
+{
+  u32 cutoff_u8   = get_alpha_cutoff_u8(cutoff);
+  u64 texel_count = (u64)width * height;
+  u64 passing     = 0;
+  for (u64 i = 0; i < texel_count; i++)
+  {
+    passing += rgba8[i * 4 + 3] >= cutoff_u8;
+  }
+  return texel_count > 0 ? (f32)((f64)passing / (f64)texel_count) : 0.0f;
+}
+
+static f32
+get_alpha_coverage_scale(FreeHeap heap, const f32* texels, u64 texel_count, f32 cutoff, f32 target_coverage)
+{
+  u32* histogram = HEAP_ALLOC(u32, heap, kAlphaHistogramSize);
+  defer { HEAP_FREE(heap, histogram); };
+  zero_memory(histogram, kAlphaHistogramSize * sizeof(u32));
+
+  for (u64 i = 0; i < texel_count; i++)
+  {
+    f32 alpha = CLAMP(texels[i * kTexelFloats + 3], 0.0f, 1.0f);
+    histogram[(u32)(alpha * (f32)(kAlphaHistogramSize - 1) + 0.5f)]++;
+  }
+
+  // Find the alpha threshold that the closest number of texels to the target is above
+  u64 target    = (u64)((f64)target_coverage * (f64)texel_count + 0.5);
+  u64 passing   = 0;
+  u32 threshold = 1;
+  for (u32 i = kAlphaHistogramSize - 1; i > 0; i--)
+  {
+    u64 next = passing + histogram[i];
+    if (next >= target)
+    {
+      threshold = next - target <= target - passing ? i : i + 1;
+      break;
+    }
+    passing = next;
+  }
+
+  // The alpha that gets written is rounded to 8 bits, it passes once it's at least halfway to the first byte that does
+  f32 quantized_cutoff = ((f32)get_alpha_cutoff_u8(cutoff) - 0.5f) / 255.0f;
+  return quantized_cutoff / ((f32)threshold / (f32)(kAlphaHistogramSize - 1));
+}
+
+//
+// Mip chain
+//
+
+MipChain
+generate_mip_chain(FreeHeap heap, const u8* rgba8, u32 width, u32 height, const MipChainParams& params)
+{
+  ASSERT_MSG_FATAL(width > 0 && height > 0, "Can't generate mips for an empty texture!");
+
+  MipChain ret;
+  ret.mip_count = MIN(get_mip_count(width, height), kMaxTextureMips);
+  ret.mips[0]   = { width, height, (u8*)rgba8 };
+  if (ret.mip_count == 1)
+  {
+    return ret;
+  }
+
+  // Ping pongs between the two, mip 2 can go back into mip 0's buffer and so on
+  u64  texel_count = (u64)width * height;
+  f32* src = (f32*)HEAP_ALLOC_ALIGNED(heap, texel_count * kTexelSize, 32);
+  f32* dst = (f32*)HEAP_ALLOC_ALIGNED(heap, (u64)MAX(width >> 1, 1) * MAX(height >> 1, 1) * kTexelSize, 32);
+  defer
+  {
+    HEAP_FREE(heap, src);
+    HEAP_FREE(heap, dst);
+  };
+
+  decode_texels(src, rgba8, texel_count, params.usage);
+
+  bool use_avx2        = g_MipUseAvx2 && !params.force_sse;
+  f32  target_coverage = params.usage == kTextureUsageColor ? get_alpha_coverage(rgba8, width, height, params.alpha_cutoff) : 1.0f;
+  bool preserve_alpha  = target_coverage > 0.0f && target_coverage < 1.0f;
+
+  u32 src_width  = width;
+  u32 src_height = height;
+  for (u32 imip = 1; imip < ret.mip_count; imip++)
+  {
+    u32 dst_width  = MAX(src_width  >> 1, 1);
+    u32 dst_height = MAX(src_height >> 1, 1);
+    u64 dst_count  = (u64)dst_width * dst_height;
+
+    if (params.filter == kMipFilterBox && src_width == dst_width * 2 && src_height == dst_height * 2)
+    {
+      if (use_avx2)
+      {
+        downsample_box_2x2_avx2(dst, src, src_width, dst_width, dst_height);
+      }
+      else
+      {
+        downsample_box_2x2_sse (dst, src, src_width, dst_width, dst_height);
+      }
+    }
+    else
+    {
+      downsample_separable(heap, dst, src, src_width, src_height, dst_width, dst_height, params.filter, use_avx2);
+    }
+
+    finish_texels(dst, dst_count, params.usage);
+
+    // The scale only goes into the 8 bit mip, the next mip still gets filtered from the unscaled alpha
+    f32 alpha_scale = preserve_alpha ? get_alpha_coverage_scale(heap, dst, dst_count, params.alpha_cutoff, target_coverage) : 1.0f;
+
+    MipLevel* mip = ret.mips + imip;
+    mip->width    = dst_width;
+    mip->height   = dst_height;
+    mip->buf      = HEAP_ALLOC(u8, heap, dst_count * 4);
+    encode_texels(mip->buf, dst, dst_count, params.usage, alpha_scale);
+
+    f32* tmp   = src;
+    src        = dst;
+    dst        = tmp;
+    src_width  = dst_width;
+    src_height = dst_height;
+  }
+
+  return ret;
+}
+
+void
+free_mip_chain(FreeHeap heap, MipChain* chain)
+{
+  // Mip 0 belongs to whoever imported the texture
+  for (u32 imip = 1; imip < chain->mip_count; imip++)
+  {
+    HEAP_FREE(heap, chain->mips[imip].buf);
+  }
+  zero_memory(chain, sizeof(MipChain));
+}
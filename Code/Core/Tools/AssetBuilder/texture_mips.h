@@ -0,0 +1,68 @@
+#pragma once
+#include "Core/Foundation/types.h"
+#include "Core/Foundation/memory.h"
+#include "Core/Foundation/assets.h"
+
+// How the texels of a texture get interpreted while filtering its mips. Averaging needs to happen on values that are
+// linear in whatever the shader ends up doing with them, which isn't what's stored in the texture for colors or normals.
+enum TextureUsage : u8
+{
+  // RGB is sRGB encoded and gets filtered in linear space. A is linear and used for alpha testing, so its coverage
+  // gets preserved down the mip chain.
+  kTextureUsageColor,
+  // Every channel is already linear (roughness, metalness, AO, masks)
+  kTextureUsageLinear,
+  // RGB is a unit vector packed into [0, 1], the filtered normals get renormalized.
+  kTextureUsageNormal,
+
+  kTextureUsageCount,
+};
+
+enum MipFilter : u8
+{
+  // 2x2 average, or the exact area average for odd sized mips
+  kMipFilterBox,
+  // Kaiser windowed sinc, keeps the lower mips sharper than box at the cost of a bit of ringing
+  kMipFilterKaiser,
+};
+
+// The alpha test in Materials/basic_normal_gloss.psh
+static constexpr f32 kTextureAlphaTestCutoff = 0.01f;
+
+struct MipChainParams
+{
+  TextureUsage usage        = kTextureUsageLinear;
+  MipFilter    filter       = kMipFilterBox;
+  // Only used by kTextureUsageColor textures
+  f32          alpha_cutoff = kTextureAlphaTestCutoff;
+  // Filters with SSE even when the CPU has AVX2, for testing that both come up with the same mips
+  bool         force_sse    = false;
+};
+
+struct MipLevel
+{
+  u32 width  = 0;
+  u32 height = 0;
+  // RGBA8, width * height * 4 bytes
+  u8* buf    = nullptr;
+};
+
+struct MipChain
+{
+  u32      mip_count = 0;
+  // mips[0] is the source texture, the rest are allocated by generate_mip_chain.
+  MipLevel mips[kMaxTextureMips];
+};
+
+const char* texture_usage_to_str(TextureUsage usage);
+
+// Mip count of a full chain down to 1x1
+u32 get_mip_count(u32 width, u32 height);
+
+// Every mip gets filtered from the previous one at full float precision, they're only quantized back down to 8 bits
+// once they're done. The filtering uses AVX2 when the CPU has it and SSE otherwise.
+MipChain generate_mip_chain(FreeHeap heap, const u8* rgba8, u32 width, u32 height, const MipChainParams& params);
+void     free_mip_chain(FreeHeap heap, MipChain* chain);
+
+// Fraction of the texels that pass an alpha test against cutoff
+f32      get_alpha_coverage(const u8* rgba8, u32 width, u32 height, f32 cutoff);
@@ -0,0 +1,23 @@
+#pragma once
+#include "Core/Foundation/types.h"
+
+// Stands in for Core/Foundation/assets.h in tests of code that only needs its limits and asset ids, the real one pulls
+// in math.h and the GPU headers.
+// NOTE(bshihabi): Keep in sync with Core/Foundation/assets.h!
+typedef u32 AssetId;
+
+static constexpr u32 kNullAssetId = 0x00000000;
+
+static constexpr u32 kMaxTextureMips = 16;
+
+enum struct AssetType : u32
+{
+  kModel,
+  kTexture,
+  kShader,
+  kMaterial,
+
+  kCount,
+
+  kUnknown,
+};
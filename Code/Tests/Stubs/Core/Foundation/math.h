@@ -0,0 +1,6 @@
+#pragma once
+#include "Core/Foundation/types.h"
+
+// Stands in for Core/Foundation/math.h in tests of code that only needs its constants, the real one leans on
+// MSVC's __m128 operator overloads and doesn't build with GCC or Clang.
+static constexpr f32 kPI = 3.1415926535897932f;
@@ -0,0 +1,324 @@
+#include "Tests/test.h"
+
+#include "Core/Engine/Streaming/asset_load_queue.h"
+
+// The load queue on its own, with the streaming thread's side of the file I/O budget played back by hand.
+
+static constexpr u32 kTestAssetCount = 512;
+
+static Asset g_Assets[kTestAssetCount];
+
+static void
+reset_test_assets()
+{
+  for (u32 i = 0; i < kTestAssetCount; i++)
+  {
+    g_Assets[i]    = Asset();
+    g_Assets[i].id = i + 1;
+  }
+}
+
+// What the public kicks and the streaming thread do between them
+static void
+kick_test_asset(AssetLoadQueue* queue, Asset* asset, f32 priority, AssetStreamRequestType type = kAssetStreamRequestLoad)
+{
+  if (type == kAssetStreamRequestLoad && !request_asset_load(asset))
+  {
+    return;
+  }
+
+  AssetStreamRequest request;
+  request.asset    = asset;
+  request.type     = type;
+  request.priority = priority;
+  update_asset_load_queue(queue, request);
+}
+
+static void
+check_load_queue(AssetLoadQueue* queue)
+{
+  for (u32 i = 0; i < queue->count; i++)
+  {
+    const AssetLoadQueueEntry& entry = queue->entries[i];
+    CHECK_MSG(entry.asset->stream_queue_index == i + 1, "asset 0x%x thinks it's in slot %u, it's in %u", entry.asset->id, entry.asset->stream_queue_index, i + 1);
+    CHECK(entry.asset->stream_priority == entry.priority);
+    if (i > 0)
+    {
+      const AssetLoadQueueEntry& parent = queue->entries[(i - 1) / 2];
+      CHECK(parent.priority >= entry.priority);
+    }
+  }
+}
+
+// Everything comes out highest priority first, ties in the order they were kicked
+static void
+test_priority_ordering()
+{
+  reset_test_assets();
+  AssetLoadQueue queue = init_asset_load_queue((AllocHeap)GLOBAL_HEAP, kTestAssetCount);
+
+  TestRng rng;
+  for (u32 i = 0; i < kTestAssetCount; i++)
+  {
+    // Only a handful of distinct priorities so that there are plenty of ties
+    f32 priority = (f32)test_rng_range(&rng, 5) * 0.25f;
+    kick_test_asset(&queue, &g_Assets[i], priority);
+  }
+  // Kicking something that's already waiting at the same priority doesn't move it
+  kick_test_asset(&queue, &g_Assets[0], g_Assets[0].stream_priority);
+  CHECK(queue.count == kTestAssetCount);
+  check_load_queue(&queue);
+
+  AssetFileIoBudget budget;
+  Asset*            prev = nullptr;
+  u32               popped = 0;
+  while (Asset* asset = try_pop_asset_load_queue(&queue, budget))
+  {
+    CHECK(asset->stream_queue_index == 0);
+    if (prev != nullptr)
+    {
+      CHECK_MSG(prev->stream_priority > asset->stream_priority || (prev->stream_priority == asset->stream_priority && prev->id < asset->id),
+                "0x%x (%f) came out after 0x%x (%f)", asset->id, asset->stream_priority, prev->id, prev->stream_priority);
+    }
+    prev = asset;
+    popped++;
+  }
+  CHECK(popped == kTestAssetCount);
+  CHECK(queue.count == 0);
+
+  HEAP_FREE(GLOBAL_HEAP, queue.entries);
+}
+
+// Random kicks and re-prioritisations checked against a brute force search for what should come out next
+static void
+test_reprioritize()
+{
+  reset_test_assets();
+  AssetLoadQueue queue = init_asset_load_queue((AllocHeap)GLOBAL_HEAP, kTestAssetCount);
+
+  // Kicks bump up but never down, re-prioritising goes either way, and the asset keeps its place among equal priorities
+  kick_test_asset(&queue, &g_Assets[0], 0.5f);
+  kick_test_asset(&queue, &g_Assets[1], 0.5f);
+  kick_test_asset(&queue, &g_Assets[2], 0.5f);
+  kick_test_asset(&queue, &g_Assets[2], 0.25f);
+  CHECK(g_Assets[2].stream_priority == 0.5f);
+  kick_test_asset(&queue, &g_Assets[2], kAssetStreamPriorityCritical);
+  kick_test_asset(&queue, &g_Assets[0], 0.25f, kAssetStreamRequestReprioritize);
+  kick_test_asset(&queue, &g_Assets[0], 0.5f,  kAssetStreamRequestReprioritize);
+  check_load_queue(&queue);
+
+  AssetFileIoBudget budget;
+  CHECK(try_pop_asset_load_queue(&queue, budget) == &g_Assets[2]);
+  CHECK(try_pop_asset_load_queue(&queue, budget) == &g_Assets[0]);
+  CHECK(try_pop_asset_load_queue(&queue, budget) == &g_Assets[1]);
+  CHECK(try_pop_asset_load_queue(&queue, budget) == nullptr);
+
+  // Re-prioritising something that isn't waiting anymore doesn't put it back in
+  atomic_ref_store(&g_Assets[3].state, (u32)kAssetStreaming);
+  kick_test_asset(&queue, &g_Assets[3], 1.0f, kAssetStreamRequestReprioritize);
+  CHECK(queue.count == 0);
+
+  reset_test_assets();
+  u32 kick_order[kTestAssetCount] = {};
+  u32 kicks = 0;
+
+  TestRng rng;
+  for (u32 iop = 0; iop < 20000; iop++)
+  {
+    u32    op       = test_rng_range(&rng, 4);
+    Asset* asset    = &g_Assets[test_rng_range(&rng, kTestAssetCount)];
+    f32    priority = (f32)test_rng_range(&rng, 9) * 0.25f;
+    if (op == 0)
+    {
+      bool waiting = asset->stream_queue_index != 0;
+      kick_test_asset(&queue, asset, priority);
+      if (!waiting)
+      {
+        kick_order[asset->id - 1] = kicks++;
+      }
+    }
+    else if (op == 1)
+    {
+      kick_test_asset(&queue, asset, priority, kAssetStreamRequestReprioritize);
+    }
+    else
+    {
+      Asset* expected = nullptr;
+      for (u32 i = 0; i < queue.count; i++)
+      {
+        Asset* candidate = queue.entries[i].asset;
+        if (expected == nullptr                                   ||
+            candidate->stream_priority >  expected->stream_priority ||
+            (candidate->stream_priority == expected->stream_priority && kick_order[candidate->id - 1] < kick_order[expected->id - 1]))
+        {
+          expected = candidate;
+        }
+      }
+
+      Asset* popped = try_pop_asset_load_queue(&queue, AssetFileIoBudget());
+      CHECK(popped == expected);
+      if (popped != nullptr)
+      {
+        // Loaded and unloaded again, so it can get kicked back in
+        atomic_ref_store(&popped->state, (u32)kAssetUnloaded);
+      }
+    }
+  }
+  check_load_queue(&queue);
+
+  HEAP_FREE(GLOBAL_HEAP, queue.entries);
+}
+
+static void
+test_cancel()
+{
+  reset_test_assets();
+  AssetLoadQueue queue = init_asset_load_queue((AllocHeap)GLOBAL_HEAP, kTestAssetCount);
+
+  Asset* a = &g_Assets[0];
+  Asset* b = &g_Assets[1];
+  Asset* c = &g_Assets[2];
+  Asset* d = &g_Assets[3];
+  kick_test_asset(&queue, a, 0.5f);
+  kick_test_asset(&queue, b, 0.5f);
+  kick_test_asset(&queue, c, 0.5f);
+  kick_test_asset(&queue, d, 0.5f);
+
+  // Cancelled and kicked again before it came out, it goes back to waiting where it was instead of going to the back
+  CHECK(cancel_asset_load_request(b));
+  CHECK(!cancel_asset_load_request(b));
+  CHECK(atomic_ref_load(&b->state) == kAssetUnloaded);
+  CHECK(request_asset_load(b));
+  kick_test_asset(&queue, b, 0.5f);
+  CHECK(queue.count == 4);
+
+  // Cancelled for good, it still comes out but whatever kicks the load skips it. A load request that was already on its
+  // way in when it got cancelled doesn't put it back in either.
+  CHECK(cancel_asset_load_request(c));
+  kick_test_asset(&queue, c, kAssetStreamPriorityCritical, kAssetStreamRequestReprioritize);
+  AssetStreamRequest stale;
+  stale.asset    = c;
+  stale.priority = kAssetStreamPriorityCritical;
+  update_asset_load_queue(&queue, stale);
+  CHECK(queue.count == 4);
+
+  AssetFileIoBudget budget;
+  CHECK(try_pop_asset_load_queue(&queue, budget) == a);
+  CHECK(try_pop_asset_load_queue(&queue, budget) == b);
+  CHECK(atomic_ref_load(&b->state) == kAssetLoadRequested);
+  CHECK(try_pop_asset_load_queue(&queue, budget) == c);
+  CHECK(atomic_ref_load(&c->state) == kAssetUnloaded);
+
+  // Kicked again after it came out, so it's a brand new load behind everything else at its priority
+  kick_test_asset(&queue, c, 0.5f);
+  CHECK(try_pop_asset_load_queue(&queue, budget) == d);
+  CHECK(try_pop_asset_load_queue(&queue, budget) == c);
+  CHECK(try_pop_asset_load_queue(&queue, budget) == nullptr);
+
+  // Too late once it's streaming in
+  atomic_ref_store(&a->state, (u32)kAssetStreaming);
+  CHECK(!cancel_asset_load_request(a));
+  CHECK(!request_asset_load(a));
+  CHECK(atomic_ref_load(&a->state) == kAssetStreaming);
+
+  HEAP_FREE(GLOBAL_HEAP, queue.entries);
+}
+
+// The header stage and the content reads of a bunch of packed assets, played back the way the streaming thread does it
+static void
+test_file_io_budget()
+{
+  reset_test_assets();
+  AssetLoadQueue queue = init_asset_load_queue((AllocHeap)GLOBAL_HEAP, kTestAssetCount);
+
+  // Nothing comes out while either limit is used up, and everything does once there's any room at all
+  AssetFileIoBudget budget;
+  kick_test_asset(&queue, &g_Assets[0], 0.0f);
+  budget.assets_queued = kMaxQueuedFileIoAssets;
+  CHECK(try_pop_asset_load_queue(&queue, budget) == nullptr);
+  budget.assets_queued   = kMaxQueuedFileIoAssets - 1;
+  budget.bytes_queued    = kMaxFileIoBytesInFlight / 2;
+  budget.bytes_in_flight = kMaxFileIoBytesInFlight / 2;
+  CHECK(try_pop_asset_load_queue(&queue, budget) == nullptr);
+  budget.bytes_in_flight--;
+  CHECK(try_pop_asset_load_queue(&queue, budget) == &g_Assets[0]);
+
+  static constexpr u32 kAssets = 200;
+
+  u64 sizes[kAssets];
+  u64 max_size = 0;
+  TestRng rng;
+  for (u32 i = 0; i < kAssets; i++)
+  {
+    // Mostly small, with a few that are bigger than the whole budget on their own
+    sizes[i] = test_rng_range(&rng, 16) == 0 ? MiB(40) + test_rng_range(&rng, (u32)MiB(8)) : KiB(4) + test_rng_range(&rng, (u32)MiB(4));
+    max_size = MAX(max_size, sizes[i]);
+    kick_test_asset(&queue, &g_Assets[i + 1], (f32)test_rng_range(&rng, 3));
+  }
+
+  Asset* header_stage [kAssets];
+  Asset* content_reads[kAssets];
+  u32    header_count  = 0;
+  u32    content_count = 0;
+  u32    loaded        = 0;
+  u64    max_used      = 0;
+  budget = AssetFileIoBudget();
+  for (u32 iter = 0; loaded < kAssets; iter++)
+  {
+    REQUIRE(iter < kAssets * 16);
+
+    // process_asset_load_queue
+    while (Asset* asset = try_pop_asset_load_queue(&queue, budget))
+    {
+      header_stage[header_count++] = asset;
+      budget.assets_queued++;
+      budget.bytes_queued += sizes[asset->id - 2];
+      max_used = MAX(max_used, budget.bytes_queued + budget.bytes_in_flight);
+    }
+    CHECK(budget.assets_queued <= kMaxQueuedFileIoAssets);
+
+    // process_header_file_io: packed assets go straight through and kick their one read
+    for (u32 i = 0; i < header_count; i++)
+    {
+      u64 size = sizes[header_stage[i]->id - 2];
+      budget.bytes_queued    -= size;
+      budget.bytes_in_flight += size;
+      budget.assets_queued--;
+      content_reads[content_count++] = header_stage[i];
+    }
+    header_count = 0;
+
+    // process_content_file_io: reads finish a couple at a time
+    u32 finished = test_rng_range(&rng, 3) + 1;
+    finished     = MIN(finished, content_count);
+    for (u32 i = 0; i < finished; i++)
+    {
+      budget.bytes_in_flight -= sizes[content_reads[i]->id - 2];
+      loaded++;
+    }
+    for (u32 i = finished; i < content_count; i++)
+    {
+      content_reads[i - finished] = content_reads[i];
+    }
+    content_count -= finished;
+  }
+
+  // Nothing ever stalled for good (otherwise the REQUIRE above would have gone off), and the budget only ever went over
+  // by whatever got through last
+  CHECK(queue.count == 0);
+  CHECK(budget.assets_queued == 0 && budget.bytes_queued == 0 && budget.bytes_in_flight == 0);
+  CHECK_MSG(max_used < kMaxFileIoBytesInFlight + max_size, "had %llu bytes going at once", (unsigned long long)max_used);
+
+  HEAP_FREE(GLOBAL_HEAP, queue.entries);
+}
+
+int
+main()
+{
+  test_priority_ordering();
+  test_reprioritize();
+  test_cancel();
+  test_file_io_budget();
+
+  return finish_test("asset_load_queue_test");
+}
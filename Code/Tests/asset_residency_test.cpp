@@ -0,0 +1,366 @@
+#include "Tests/test.h"
+
+#include "Core/Engine/Streaming/asset_residency.h"
+
+// The residency bookkeeping on its own, with the streaming thread's side of loading and evicting played back by hand.
+
+static constexpr u32 kTestAssetCount = 32;
+
+static Asset g_Assets[kTestAssetCount];
+
+static void
+reset_test_assets(AssetResidency* residency)
+{
+  init_asset_residency(residency);
+  for (u32 i = 0; i < kTestAssetCount; i++)
+  {
+    g_Assets[i]    = Asset();
+    g_Assets[i].id = i + 1;
+  }
+}
+
+static void
+acquire_test_asset(AssetResidency* residency, Asset* asset)
+{
+  spin_acquire(&residency->lock);
+  acquire_asset_locked(residency, asset);
+  spin_release(&residency->lock);
+}
+
+static bool
+release_test_asset(AssetResidency* residency, Asset* asset)
+{
+  spin_acquire(&residency->lock);
+  bool ret = release_asset_locked(residency, asset, false);
+  spin_release(&residency->lock);
+
+  return ret;
+}
+
+// Kicked (which holds on to it) and streamed in
+static void
+load_test_asset(AssetResidency* residency, Asset* asset, u64 cpu_bytes, u64 gpu_bytes)
+{
+  acquire_test_asset(residency, asset);
+  atomic_ref_store(&asset->state, (u32)kAssetStreaming);
+  add_asset_cpu_bytes(residency, asset, cpu_bytes);
+  add_asset_gpu_bytes(residency, asset, gpu_bytes);
+  mark_asset_ready(residency, asset);
+}
+
+static bool
+in_eviction_list(AssetResidency* residency, Asset* asset)
+{
+  for (Asset* it = residency->lru.lru_next; it != &residency->lru; it = it->lru_next)
+  {
+    if (it == asset)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// What process_asset_residency and evict_asset do, minus the GPU. Dependencies of whatever gets evicted are released
+// the way evict_asset releases them, and the memory gets freed right away unless free_later is set.
+struct TestEviction
+{
+  Asset* order[kTestAssetCount];
+  u32    count = 0;
+};
+
+static Asset* g_Dependencies[kTestAssetCount][2];
+
+static TestEviction
+enforce_test_budget(AssetResidency* residency, const AssetResidencyBudget& budget, bool free_later = false)
+{
+  TestEviction ret;
+  while (Asset* asset = take_asset_to_evict(residency, budget))
+  {
+    CHECK(atomic_ref_load(&asset->state) == kAssetUnloaded);
+    CHECK(asset->ref_count == 0);
+
+    u64 cpu_bytes = asset->cpu_bytes;
+    u64 gpu_bytes = asset->gpu_bytes;
+    retire_asset_bytes(residency, asset);
+
+    spin_acquire(&residency->lock);
+    for (Asset* dependency : g_Dependencies[asset->id - 1])
+    {
+      if (dependency != nullptr)
+      {
+        release_asset_locked(residency, dependency, true);
+      }
+    }
+    spin_release(&residency->lock);
+
+    if (!free_later)
+    {
+      free_retired_bytes(residency, cpu_bytes, gpu_bytes);
+    }
+
+    REQUIRE(ret.count < kTestAssetCount);
+    ret.order[ret.count++] = asset;
+  }
+
+  return ret;
+}
+
+static void
+test_ref_counting()
+{
+  static AssetResidency residency;
+  reset_test_assets(&residency);
+
+  Asset* asset = &g_Assets[0];
+  load_test_asset(&residency, asset, 10, 10);
+  CHECK(asset->use_count == 1);
+  CHECK(!in_eviction_list(&residency, asset));
+
+  // Only goes in the eviction list once the last handle lets go
+  acquire_test_asset(&residency, asset);
+  CHECK(asset->use_count == 1);
+  CHECK(!release_test_asset(&residency, asset));
+  CHECK(!in_eviction_list(&residency, asset));
+  CHECK(release_test_asset(&residency, asset));
+  CHECK(in_eviction_list(&residency, asset));
+  CHECK(pick_asset_to_evict(&residency, kAssetEvictionLru) == asset);
+
+  // Picking it back up takes it out again and counts as another use
+  acquire_test_asset(&residency, asset);
+  CHECK(asset->use_count == 2);
+  CHECK(!in_eviction_list(&residency, asset));
+  CHECK(pick_asset_to_evict(&residency, kAssetEvictionLru) == nullptr);
+
+  // Let go of while it's still waiting in the load queue, so its load gets cancelled instead
+  Asset* waiting = &g_Assets[1];
+  acquire_test_asset(&residency, waiting);
+  atomic_ref_store(&waiting->state, (u32)kAssetLoadRequested);
+  CHECK(!release_test_asset(&residency, waiting));
+  CHECK(atomic_ref_load(&waiting->state) == kAssetUnloaded);
+  CHECK(!in_eviction_list(&residency, waiting));
+
+  // Broken assets never go in there
+  Asset* broken = &g_Assets[2];
+  acquire_test_asset(&residency, broken);
+  atomic_ref_store(&broken->state, (u32)kAssetFailedToLoad);
+  CHECK(!release_test_asset(&residency, broken));
+  CHECK(!in_eviction_list(&residency, broken));
+}
+
+static void
+test_eviction_policy()
+{
+  static AssetResidency residency;
+  reset_test_assets(&residency);
+
+  // Released in order, with asset 2 used three times, asset 0 twice and everything else once. The last one is the
+  // least used of all but starts out too far back in the eviction list to get looked at.
+  static constexpr u32 kAssets = kAssetEvictionCandidates + 4;
+  for (u32 i = 0; i < kAssets; i++)
+  {
+    load_test_asset(&residency, &g_Assets[i], 1, 1);
+  }
+  for (u32 i = 0; i < kAssets; i++)
+  {
+    release_test_asset(&residency, &g_Assets[i]);
+  }
+  for (u32 i : {0, 2, 2})
+  {
+    acquire_test_asset(&residency, &g_Assets[i]);
+    release_test_asset(&residency, &g_Assets[i]);
+  }
+  g_Assets[kAssets - 1].use_count = 0;
+
+  // Least recently released goes first
+  CHECK(pick_asset_to_evict(&residency, kAssetEvictionLru) == &g_Assets[1]);
+
+  // Least used out of the first few, ties go to whatever's been unused the longest
+  AssetResidencyBudget budget;
+  budget.cpu_bytes = 0;
+  budget.gpu_bytes = 0;
+  budget.policy    = kAssetEvictionFrequencyWeighted;
+  CHECK(pick_asset_to_evict(&residency, budget.policy) == &g_Assets[1]);
+
+  TestEviction evicted = enforce_test_budget(&residency, budget);
+  CHECK(evicted.count == kAssets);
+  // Asset 11 only gets looked at once there are few enough left in front of it, and then it goes right away. The use
+  // counts keep assets 0 and 2 around till last.
+  static constexpr u32 kExpected[kAssets] = {1, 3, 11, 4, 5, 6, 7, 8, 9, 10, 0, 2};
+  for (u32 i = 0; i < evicted.count; i++)
+  {
+    CHECK_MSG(evicted.order[i] == &g_Assets[kExpected[i]], "eviction %u was asset %u, expected %u", i, evicted.order[i]->id - 1, kExpected[i]);
+  }
+}
+
+// A model holding on to two materials which hold on to a texture each. Evicting the model lets go of the materials,
+// and those go in front of everything that was already waiting to be evicted.
+static void
+test_dependencies_evicted_first()
+{
+  static AssetResidency residency;
+  reset_test_assets(&residency);
+  zero_memory(g_Dependencies, sizeof(g_Dependencies));
+
+  Asset* model       = &g_Assets[0];
+  Asset* materials[] = {&g_Assets[1], &g_Assets[2]};
+  Asset* textures [] = {&g_Assets[3], &g_Assets[4]};
+  Asset* unrelated[] = {&g_Assets[5], &g_Assets[6]};
+
+  for (u32 i = 0; i < 2; i++)
+  {
+    load_test_asset(&residency, textures[i], 1, 1);
+    load_test_asset(&residency, materials[i], 1, 1);
+    g_Dependencies[materials[i]->id - 1][0] = textures[i];
+    g_Dependencies[model->id - 1][i]        = materials[i];
+  }
+  load_test_asset(&residency, model, 1, 1);
+
+  // Only the model's handle goes away, the kicks that loaded its dependencies are what it's holding on to. The
+  // unrelated assets go unused after it did.
+  release_test_asset(&residency, model);
+  for (Asset* asset : unrelated)
+  {
+    load_test_asset(&residency, asset, 1, 1);
+    release_test_asset(&residency, asset);
+  }
+
+  // The budget only has room for the unrelated assets. Everything the model brought in goes in front of them as soon
+  // as whatever was holding on to it is gone, so none of it outlives them.
+  AssetResidencyBudget budget;
+  budget.cpu_bytes = 2;
+  budget.gpu_bytes = 2;
+  budget.policy    = kAssetEvictionLru;
+  TestEviction evicted = enforce_test_budget(&residency, budget);
+
+  Asset* expected[] = {model, materials[1], textures[1], materials[0], textures[0]};
+  CHECK(evicted.count == ARRAY_LENGTH(expected));
+  for (u32 i = 0; i < evicted.count && i < ARRAY_LENGTH(expected); i++)
+  {
+    CHECK_MSG(evicted.order[i] == expected[i], "eviction %u was asset %u, expected %u", i, evicted.order[i]->id - 1, expected[i]->id - 1);
+  }
+  CHECK(residency.resident_cpu_bytes == 2 && residency.resident_gpu_bytes == 2);
+  CHECK(pick_asset_to_evict(&residency, kAssetEvictionLru) == unrelated[0]);
+
+  zero_memory(g_Dependencies, sizeof(g_Dependencies));
+}
+
+static void
+test_budget()
+{
+  static AssetResidency residency;
+  reset_test_assets(&residency);
+  zero_memory(g_Dependencies, sizeof(g_Dependencies));
+
+  // 20 assets of 10 CPU bytes each and 100 GPU bytes each, the first 5 are still being held on to
+  static constexpr u32 kAssets = 20;
+  static constexpr u32 kHeld   = 5;
+  for (u32 i = 0; i < kAssets; i++)
+  {
+    load_test_asset(&residency, &g_Assets[i], 10, 100);
+  }
+  for (u32 i = kHeld; i < kAssets; i++)
+  {
+    release_test_asset(&residency, &g_Assets[i]);
+  }
+  CHECK(residency.resident_cpu_bytes == 200 && residency.resident_gpu_bytes == 2000);
+
+  // Under budget, nothing happens
+  AssetResidencyBudget budget;
+  budget.cpu_bytes = 200;
+  budget.gpu_bytes = 2000;
+  CHECK(enforce_test_budget(&residency, budget).count == 0);
+
+  // Either limit going over is enough, and it stops as soon as it fits. Memory that's still waiting to get freed
+  // doesn't count.
+  budget.cpu_bytes = 1000;
+  budget.gpu_bytes = 1500;
+  TestEviction evicted = enforce_test_budget(&residency, budget, true);
+  CHECK(evicted.count == 5);
+  CHECK(residency.resident_gpu_bytes - residency.retiring_gpu_bytes == 1500);
+  CHECK(residency.resident_gpu_bytes == 2000);
+  for (u32 i = 0; i < evicted.count; i++)
+  {
+    CHECK(evicted.order[i] == &g_Assets[kHeld + i]);
+    CHECK(evicted.order[i]->cpu_bytes == 0 && evicted.order[i]->gpu_bytes == 0);
+  }
+  CHECK(enforce_test_budget(&residency, budget).count == 0);
+  free_retired_bytes(&residency, 50, 500);
+  CHECK(residency.resident_gpu_bytes == 1500 && residency.retiring_gpu_bytes == 0);
+
+  // Way over, but the held assets can't go
+  budget.cpu_bytes = 0;
+  budget.gpu_bytes = 0;
+  evicted = enforce_test_budget(&residency, budget);
+  CHECK(evicted.count == kAssets - kHeld - 5);
+  CHECK(residency.resident_cpu_bytes == kHeld * 10 && residency.resident_gpu_bytes == kHeld * 100);
+  for (u32 i = 0; i < kHeld; i++)
+  {
+    CHECK(atomic_ref_load(&g_Assets[i].state) == kAssetReady);
+  }
+
+  // Kicked again after getting evicted, and it's evictable again once it's back
+  Asset* reloaded = evicted.order[0];
+  load_test_asset(&residency, reloaded, 10, 100);
+  release_test_asset(&residency, reloaded);
+  evicted = enforce_test_budget(&residency, budget);
+  CHECK(evicted.count == 1 && evicted.order[0] == reloaded);
+}
+
+// Let go of while it's still streaming in, so it's only the load finishing that can put it in the eviction list
+static void
+test_release_before_ready()
+{
+  static AssetResidency residency;
+  reset_test_assets(&residency);
+  zero_memory(g_Dependencies, sizeof(g_Dependencies));
+
+  static constexpr AssetState kStates[] = {kAssetStreaming, kAssetUninitialized};
+  for (u32 i = 0; i < ARRAY_LENGTH(kStates); i++)
+  {
+    Asset* asset = &g_Assets[i];
+    acquire_test_asset(&residency, asset);
+    atomic_ref_store(&asset->state, (u32)kStates[i]);
+    add_asset_cpu_bytes(&residency, asset, 10);
+
+    CHECK(!release_test_asset(&residency, asset));
+    CHECK(atomic_ref_load(&asset->state) == kStates[i]);
+    CHECK(!in_eviction_list(&residency, asset));
+
+    add_asset_gpu_bytes(&residency, asset, 100);
+    mark_asset_ready(&residency, asset);
+    CHECK(in_eviction_list(&residency, asset));
+  }
+
+  // Let go of, picked back up and let go of again while it was streaming in: same thing
+  Asset* bounced = &g_Assets[2];
+  acquire_test_asset(&residency, bounced);
+  atomic_ref_store(&bounced->state, (u32)kAssetStreaming);
+  release_test_asset(&residency, bounced);
+  acquire_test_asset(&residency, bounced);
+  add_asset_gpu_bytes(&residency, bounced, 100);
+  mark_asset_ready(&residency, bounced);
+  CHECK(!in_eviction_list(&residency, bounced));
+  CHECK(release_test_asset(&residency, bounced));
+
+  // The budget squeeze gets every one of them
+  AssetResidencyBudget budget;
+  budget.cpu_bytes = 0;
+  budget.gpu_bytes = 0;
+  TestEviction evicted = enforce_test_budget(&residency, budget);
+  CHECK(evicted.count == 3 && evicted.order[0] == &g_Assets[0] && evicted.order[1] == &g_Assets[1] && evicted.order[2] == bounced);
+  CHECK(residency.resident_cpu_bytes == 0 && residency.resident_gpu_bytes == 0);
+}
+
+int
+main()
+{
+  test_ref_counting();
+  test_eviction_policy();
+  test_dependencies_evicted_first();
+  test_budget();
+  test_release_before_ready();
+
+  return finish_test("asset_residency_test");
+}
@@ -0,0 +1,407 @@
+#include "Tests/test.h"
+
+#include "Core/Foundation/Containers/mpmc_ring_queue.h"
+
+#include "Core/Engine/Streaming/asset_streamer_wake.h"
+
+// The streaming thread going to sleep has to race three kinds of work showing up: kicks (which only signal while it's
+// sleeping), file IO completions and GPU fences (which always signal). The first half steps through every interleaving of
+// the sleep with those one step at a time on one thread, the second half runs them all for real and checks that the
+// streaming thread never sleeps through its whole timeout while there's work.
+
+enum WakeStep : u8
+{
+  // Kick: push the request, then wake_asset_streamer
+  kWakeStepPush,
+  kWakeStepWake,
+  // File IO completions and GPU fences just signal the event
+  kWakeStepSignal,
+};
+
+enum SleepStep : u8
+{
+  kSleepStepBegin,
+  kSleepStepCheck,
+  kSleepStepWait,
+  kSleepStepEnd,
+};
+
+static constexpr u32 kMaxWakeProducers = 3;
+static constexpr u32 kMaxWakeSteps     = 2;
+static constexpr u32 kMaxSleepSteps    = 4;
+
+struct WakeProducer
+{
+  WakeStep steps[kMaxWakeSteps];
+  u32      step_count = 0;
+};
+
+struct WakeInterleaving
+{
+  AssetStreamerWake wake;
+  WakeProducer      producers[kMaxWakeProducers];
+  u32               producer_count = 0;
+
+  SleepStep         sleep_steps[kMaxSleepSteps];
+  u32               sleep_step_count = 0;
+
+  // One entry per step, kMaxWakeProducers is the streaming thread
+  u8                order[kMaxWakeProducers * kMaxWakeSteps + kMaxSleepSteps];
+  u32               order_count = 0;
+
+  u32               interleavings = 0;
+  u32               lost_wakeups  = 0;
+};
+
+static constexpr WakeProducer kKick   = {{kWakeStepPush, kWakeStepWake}, 2};
+static constexpr WakeProducer kSignal = {{kWakeStepSignal},              1};
+
+static void
+run_wake_step(WakeInterleaving* test, u32* requests, WakeStep step)
+{
+  switch (step)
+  {
+    case kWakeStepPush:   (*requests)++;                          break;
+    case kWakeStepWake:   wake_asset_streamer(&test->wake);       break;
+    case kWakeStepSignal: os_event_signal(&test->wake.event);     break;
+  }
+}
+
+// Plays back test->order. A wait that would block lets every producer step that hasn't run yet go through "while it's
+// asleep" and then checks whether any of them got it back out.
+static void
+run_wake_interleaving(WakeInterleaving* test)
+{
+  test->wake = init_asset_streamer_wake();
+
+  u32 requests = 0;
+  u32 next_step[kMaxWakeProducers + 1] = {};
+
+  bool saw_requests = false;
+  bool woke         = false;
+  bool blocked      = false;
+  for (u32 i = 0; i < test->order_count; i++)
+  {
+    u32 who = test->order[i];
+    if (who < test->producer_count)
+    {
+      run_wake_step(test, &requests, test->producers[who].steps[next_step[who]++]);
+      continue;
+    }
+
+    switch (test->sleep_steps[next_step[kMaxWakeProducers]++])
+    {
+      case kSleepStepBegin: begin_asset_streamer_sleep(&test->wake); break;
+      case kSleepStepCheck: saw_requests = requests != 0;            break;
+      case kSleepStepEnd:   end_asset_streamer_sleep(&test->wake);   break;
+      case kSleepStepWait:
+      {
+        if (saw_requests)
+        {
+          break;
+        }
+
+        woke = os_event_wait(&test->wake.event, 0);
+        if (woke)
+        {
+          break;
+        }
+
+        blocked = true;
+        for (u32 j = i + 1; j < test->order_count; j++)
+        {
+          u32 producer = test->order[j];
+          if (producer < test->producer_count)
+          {
+            run_wake_step(test, &requests, test->producers[producer].steps[next_step[producer]++]);
+          }
+        }
+        woke = os_event_wait(&test->wake.event, 0);
+      } break;
+    }
+
+    // Everything after the wait already ran while it was blocked
+    if (blocked)
+    {
+      break;
+    }
+  }
+
+  // Every producer finishes no later than the wait, so anything short of seeing the requests or getting signaled is the
+  // streaming thread sleeping through work.
+  if (!saw_requests && !woke)
+  {
+    test->lost_wakeups++;
+  }
+  test->interleavings++;
+
+  destroy_asset_streamer_wake(&test->wake);
+}
+
+static void
+enumerate_wake_interleavings(WakeInterleaving* test, u32* remaining)
+{
+  bool done = true;
+  for (u32 who = 0; who <= test->producer_count; who++)
+  {
+    u32 slot = who == test->producer_count ? kMaxWakeProducers : who;
+    if (remaining[slot] == 0)
+    {
+      continue;
+    }
+
+    done = false;
+    remaining[slot]--;
+    test->order[test->order_count++] = (u8)slot;
+    enumerate_wake_interleavings(test, remaining);
+    test->order_count--;
+    remaining[slot]++;
+  }
+
+  if (done)
+  {
+    run_wake_interleaving(test);
+  }
+}
+
+static WakeInterleaving
+run_wake_interleavings(const WakeProducer* producers, u32 producer_count, const SleepStep* sleep_steps, u32 sleep_step_count)
+{
+  WakeInterleaving test;
+  test.producer_count   = producer_count;
+  test.sleep_step_count = sleep_step_count;
+
+  u32 remaining[kMaxWakeProducers + 1] = {};
+  for (u32 i = 0; i < producer_count; i++)
+  {
+    test.producers[i] = producers[i];
+    remaining[i]      = producers[i].step_count;
+  }
+  for (u32 i = 0; i < sleep_step_count; i++)
+  {
+    test.sleep_steps[i] = sleep_steps[i];
+  }
+  remaining[kMaxWakeProducers] = sleep_step_count;
+
+  enumerate_wake_interleavings(&test, remaining);
+  return test;
+}
+
+static void
+test_every_interleaving()
+{
+  // The same order asset_streamer_sleep does it in
+  static constexpr SleepStep kSleep[] = {kSleepStepBegin, kSleepStepCheck, kSleepStepWait, kSleepStepEnd};
+
+  struct
+  {
+    const char*  name;
+    WakeProducer producers[kMaxWakeProducers];
+    u32          producer_count;
+    u32          interleavings;
+  } cases[] =
+  {
+    {"kick",              {kKick},                   1, 15},
+    {"io",                {kSignal},                 1, 5},
+    {"kick kick",         {kKick, kKick},            2, 420},
+    {"kick io",           {kKick, kSignal},          2, 105},
+    {"kick io fence",     {kKick, kSignal, kSignal}, 3, 840},
+  };
+
+  for (u32 i = 0; i < ARRAY_LENGTH(cases); i++)
+  {
+    WakeInterleaving test = run_wake_interleavings(cases[i].producers, cases[i].producer_count, kSleep, ARRAY_LENGTH(kSleep));
+    CHECK_MSG(test.interleavings == cases[i].interleavings, "%s: stepped through %u interleavings", cases[i].name, test.interleavings);
+    CHECK_MSG(test.lost_wakeups == 0, "%s: slept through work in %u of %u interleavings", cases[i].name, test.lost_wakeups, test.interleavings);
+  }
+
+  // Make sure the harness can actually tell: checking for requests before saying it's about to sleep lets a kick land in
+  // between and see it awake.
+  static constexpr SleepStep kBroken[] = {kSleepStepCheck, kSleepStepBegin, kSleepStepWait, kSleepStepEnd};
+  WakeInterleaving broken = run_wake_interleavings(&kKick, 1, kBroken, ARRAY_LENGTH(kBroken));
+  CHECK_MSG(broken.lost_wakeups != 0, "checking before sleeping wasn't caught in %u interleavings", broken.interleavings);
+}
+
+// Long enough that nothing short of a lost wakeup sleeps through it
+static constexpr u32 kStressWakeTimeoutMs  = 2000;
+static constexpr u32 kStressKickThreads    = 2;
+static constexpr u32 kStressItemsPerThread = 20000;
+
+struct WakeStress
+{
+  AssetStreamerWake  wake;
+  MpmcRingQueue<u32> requests;
+
+  // Accessed atomically
+  u32                io_completed = 0;
+  u32                fence_value  = 0;
+  u32                kill         = 0;
+};
+
+struct WakeStressParams
+{
+  WakeStress* test  = nullptr;
+  u32         index = 0;
+};
+
+// Little bursts with gaps in between so that the streaming thread runs out of work (and goes to sleep) all the time
+static void
+wake_stress_pause(TestRng* rng)
+{
+  if (test_rng_range(rng, 8) == 0)
+  {
+    yield_current_thread();
+  }
+}
+
+static u32
+wake_stress_kick_proc(void* param)
+{
+  auto*       params = (WakeStressParams*)param;
+  WakeStress* test   = params->test;
+
+  TestRng rng;
+  rng.state += params->index;
+  for (u32 i = 0; i < kStressItemsPerThread;)
+  {
+    if (!try_mpmc_ring_queue_push(&test->requests, i))
+    {
+      yield_current_thread();
+      continue;
+    }
+    wake_asset_streamer(&test->wake);
+    wake_stress_pause(&rng);
+    i++;
+  }
+
+  return 0;
+}
+
+static u32
+wake_stress_io_proc(void* param)
+{
+  WakeStress* test = (WakeStress*)param;
+
+  TestRng rng;
+  rng.state += 17;
+  for (u32 i = 0; i < kStressItemsPerThread; i++)
+  {
+    atomic_ref_fetch_add(&test->io_completed, 1U);
+    os_event_signal(&test->wake.event);
+    wake_stress_pause(&rng);
+  }
+
+  return 0;
+}
+
+static u32
+wake_stress_fence_proc(void* param)
+{
+  WakeStress* test = (WakeStress*)param;
+
+  TestRng rng;
+  rng.state += 31;
+  for (u32 i = 1; i <= kStressItemsPerThread; i++)
+  {
+    atomic_ref_store(&test->fence_value, i);
+    os_event_signal(&test->wake.event);
+    wake_stress_pause(&rng);
+  }
+
+  return 0;
+}
+
+static void
+test_stress()
+{
+  static WakeStress test;
+  test          = WakeStress();
+  test.wake     = init_asset_streamer_wake();
+  test.requests = init_mpmc_ring_queue<u32>((AllocHeap)GLOBAL_HEAP, 64);
+
+  Thread           threads[kStressKickThreads + 2];
+  WakeStressParams params [kStressKickThreads];
+  for (u32 i = 0; i < kStressKickThreads; i++)
+  {
+    params[i]  = WakeStressParams{&test, i};
+    threads[i] = init_test_thread(&wake_stress_kick_proc, &params[i]);
+  }
+  threads[kStressKickThreads + 0] = init_test_thread(&wake_stress_io_proc,    &test);
+  threads[kStressKickThreads + 1] = init_test_thread(&wake_stress_fence_proc, &test);
+
+  // The streaming thread, same shape as asset_streaming_thread
+  u32 requests_seen = 0;
+  u32 io_seen       = 0;
+  u32 fence_seen    = 0;
+  u32 sleeps        = 0;
+  u32 timeouts      = 0;
+  while (requests_seen < kStressKickThreads * kStressItemsPerThread || io_seen < kStressItemsPerThread || fence_seen < kStressItemsPerThread)
+  {
+    bool progress = false;
+
+    u32 request = 0;
+    while (try_mpmc_ring_queue_pop(&test.requests, &request))
+    {
+      requests_seen++;
+      progress = true;
+    }
+
+    u32 io_completed = atomic_ref_load(&test.io_completed);
+    if (io_completed != io_seen)
+    {
+      io_seen  = io_completed;
+      progress = true;
+    }
+
+    u32 fence_value = atomic_ref_load(&test.fence_value);
+    if (fence_value != fence_seen)
+    {
+      fence_seen = fence_value;
+      progress   = true;
+    }
+
+    if (progress)
+    {
+      continue;
+    }
+
+    sleeps++;
+    bool woke = asset_streamer_sleep(&test.wake, kStressWakeTimeoutMs, []()
+    {
+      return !mpmc_ring_queue_is_empty(&test.requests) || atomic_ref_load(&test.kill);
+    });
+    if (!woke)
+    {
+      timeouts++;
+    }
+  }
+
+  join_threads(threads, ARRAY_LENGTH(threads));
+  for (u32 i = 0; i < ARRAY_LENGTH(threads); i++)
+  {
+    destroy_thread(&threads[i]);
+  }
+
+  // Shutting down: kill plus a signal has to get it out of a sleep that's already started, or stop one that hasn't
+  atomic_ref_store(&test.kill, 1U);
+  os_event_signal(&test.wake.event);
+  CHECK(asset_streamer_sleep(&test.wake, kStressWakeTimeoutMs, []() { return atomic_ref_load(&test.kill) != 0; }));
+
+  CHECK_MSG(timeouts == 0, "slept through work %u times out of %u sleeps", timeouts, sleeps);
+  CHECK(requests_seen == kStressKickThreads * kStressItemsPerThread);
+  CHECK(io_seen == kStressItemsPerThread && fence_seen == kStressItemsPerThread);
+  // Otherwise this didn't test anything
+  CHECK_MSG(sleeps > 100, "only went to sleep %u times", sleeps);
+
+  HEAP_FREE(GLOBAL_HEAP, test.requests.slots);
+  destroy_asset_streamer_wake(&test.wake);
+}
+
+int
+main()
+{
+  test_every_interleaving();
+  test_stress();
+
+  return finish_test("asset_streamer_wake_test");
+}
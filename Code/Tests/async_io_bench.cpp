@@ -0,0 +1,228 @@
+#include "Tests/bench.h"
+
+#include "Core/Foundation/context.h"
+#include "Core/Foundation/filesystem.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+// Replays the kinds of reads the asset streamer does against a scratch file, on io_uring and on the pread fallback,
+// at a few queue depths. Reads are kept in flight with a sliding window: whenever one finishes the next one gets kicked
+// into its slot, and latency is from kicking a read to seeing it finish.
+//
+//   small      4-64 KiB reads at random offsets, like materials, shaders and model metadata
+//   mips       64 KiB - 4 MiB reads at random offsets, like texture mips
+//   packed     1 MiB reads one after the other, like a streaming pack file read front to back
+//
+// The file's pages get dropped from the OS cache before every run where the filesystem allows it (not on tmpfs), so
+// point it at a real disk to see real disk numbers.
+//
+//   async_io_bench [file MiB] [directory]
+
+static constexpr u32 kMaxQueueDepth = 64;
+static constexpr u64 kMaxReadSize   = MiB(4);
+static constexpr u32 kReadsPerRun   = 2000;
+
+enum IoPattern : u8
+{
+  kIoPatternSmall,
+  kIoPatternMips,
+  kIoPatternPacked,
+
+  kIoPatternCount,
+};
+
+static const char* kIoPatternNames[] = {"small", "mips", "packed"};
+
+struct IoSlot
+{
+  AsyncFilePromise promise;
+  u64              kicked_ns = 0;
+  bool             in_flight = false;
+};
+
+static void
+pick_read(IoPattern pattern, TestRng* rng, u64 file_size, u64* packed_offset, u64* out_offset, u64* out_size)
+{
+  u64 size = 0;
+  switch (pattern)
+  {
+    case kIoPatternSmall:  size = KiB(4) + test_rng_range(rng, KiB(60)); break;
+    case kIoPatternMips:   size = KiB(64) << test_rng_range(rng, 7); break;
+    case kIoPatternPacked: size = MiB(1); break;
+    default: UNREACHABLE;
+  }
+  size = MIN(size, file_size);
+
+  if (pattern == kIoPatternPacked)
+  {
+    if (*packed_offset + size > file_size)
+    {
+      *packed_offset = 0;
+    }
+    *out_offset     = *packed_offset;
+    *packed_offset += size;
+  }
+  else
+  {
+    // 4 KiB aligned like the asset packs
+    *out_offset = (test_rng_next(rng) % (file_size - size + 1)) & ~(KiB(4) - 1);
+  }
+  *out_size = size;
+}
+
+static void
+drop_file_cache(const char* path)
+{
+  s32 fd = open(path, O_RDONLY);
+  if (fd >= 0)
+  {
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+  }
+}
+
+static void
+bench_async_io(const char* path, u64 file_size, bool force_fallback, IoPattern pattern, u32 queue_depth, u8* buffer)
+{
+  AsyncIoDesc desc;
+  desc.max_reads_in_flight = kMaxQueueDepth;
+  desc.force_fallback      = force_fallback;
+  init_async_io((AllocHeap)GLOBAL_HEAP, desc);
+  register_async_io_buffer(buffer, kMaxQueueDepth * kMaxReadSize);
+
+  drop_file_cache(path);
+  Result<AsyncFileStream, FileError> file = open_file_async(path, kFileStreamRead);
+  ASSERT_MSG_FATAL(file, "Failed to open %s!", path);
+
+  TestRng rng;
+  rng.state += pattern;
+
+  IoSlot slots[kMaxQueueDepth];
+  u64    latency[kReadsPerRun];
+  u64    kicked        = 0;
+  u64    completed     = 0;
+  u64    bytes         = 0;
+  u64    packed_offset = 0;
+
+  u64 start = get_bench_time_ns();
+  while (completed < kReadsPerRun)
+  {
+    bool progress = false;
+    for (u32 islot = 0; islot < queue_depth; islot++)
+    {
+      IoSlot* slot = &slots[islot];
+      if (slot->in_flight)
+      {
+        AwaitError status = await_io(&slot->promise, 0);
+        if (status == kAwaitInFlight)
+        {
+          continue;
+        }
+        ASSERT_MSG_FATAL(status == kAwaitCompleted, "Read failed!");
+        latency[completed++] = get_bench_time_ns() - slot->kicked_ns;
+        slot->in_flight      = false;
+        progress             = true;
+      }
+
+      if (kicked < kReadsPerRun)
+      {
+        u64 offset = 0;
+        u64 size   = 0;
+        pick_read(pattern, &rng, file_size, &packed_offset, &offset, &size);
+
+        slot->kicked_ns = get_bench_time_ns();
+        Result<void, FileError> read = read_file(file.value(), &slot->promise, buffer + islot * kMaxReadSize, size, offset);
+        ASSERT_MSG_FATAL(read, "Failed to kick a read!");
+        slot->in_flight = true;
+        kicked++;
+        bytes          += size;
+        progress        = true;
+      }
+    }
+
+    submit_async_io();
+    if (!progress)
+    {
+      yield_current_thread();
+    }
+  }
+  u64 elapsed = get_bench_time_ns() - start;
+
+  close_file(&file.value());
+  const char* backend = get_async_io_backend_name();
+
+  // The percentiles sort the latencies, so the max is at the back after them
+  u64 p50 = get_bench_percentile(latency, kReadsPerRun, 50.0);
+  u64 p99 = get_bench_percentile(latency, kReadsPerRun, 99.0);
+  u64 max = latency[kReadsPerRun - 1];
+  printf("%-8s %-8s %6u %10.0f %10.1f %10.1f %10.1f %10.1f\n",
+         backend,
+         kIoPatternNames[pattern],
+         queue_depth,
+         (f64)kReadsPerRun * 1e9 / (f64)elapsed,
+         (f64)bytes * 1e9 / (f64)elapsed / (f64)MiB(1),
+         (f64)p50 / 1000.0,
+         (f64)p99 / 1000.0,
+         (f64)max / 1000.0);
+
+  destroy_async_io();
+}
+
+int
+main(int argc, char** argv)
+{
+  init_thread_context();
+
+  u64         file_size = get_bench_arg(argc, argv, 1, 64) * MiB(1);
+  const char* dir       = argc > 2 ? argv[2] : "/tmp";
+
+  char path[512];
+  snprintf(path, sizeof(path), "%s/athena_async_io_bench_XXXXXX", dir);
+  s32 fd = mkstemp(path);
+  ASSERT_MSG_FATAL(fd >= 0, "Failed to create a scratch file in %s!", dir);
+  close(fd);
+
+  // Random contents, so nothing along the way can get clever about it
+  {
+    Result<FileStream, FileError> file = create_file(path, kCreateTruncateExisting);
+    ASSERT_MSG_FATAL(file, "Failed to create %s!", path);
+
+    u64*    chunk = (u64*)malloc(MiB(1));
+    TestRng rng;
+    for (u64 written = 0; written < file_size; written += MiB(1))
+    {
+      for (u64 i = 0; i < MiB(1) / sizeof(u64); i++)
+      {
+        chunk[i] = test_rng_next(&rng);
+      }
+      bool ok = write_file(file.value(), chunk, MIN((u64)MiB(1), file_size - written));
+      ASSERT_MSG_FATAL(ok, "Failed to write %s!", path);
+    }
+    free(chunk);
+    close_file(&file.value());
+  }
+
+  u8* buffer = (u8*)malloc(kMaxQueueDepth * kMaxReadSize);
+
+  static constexpr u32 kQueueDepths[] = {1, 8, 32, 64};
+
+  printf("%llu MiB file in %s, %u reads per run, latencies in us\n\n", (unsigned long long)(file_size / MiB(1)), dir, kReadsPerRun);
+  printf("%-8s %-8s %6s %10s %10s %10s %10s %10s\n", "backend", "pattern", "depth", "IOPS", "MiB/s", "p50", "p99", "max");
+  for (u32 fallback = 0; fallback < 2; fallback++)
+  {
+    for (u32 pattern = 0; pattern < kIoPatternCount; pattern++)
+    {
+      for (u32 queue_depth : kQueueDepths)
+      {
+        bench_async_io(path, file_size, fallback != 0, (IoPattern)pattern, queue_depth, buffer);
+      }
+    }
+  }
+
+  free(buffer);
+  unlink(path);
+
+  return 0;
+}
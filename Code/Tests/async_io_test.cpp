@@ -0,0 +1,168 @@
+#include "Tests/test.h"
+
+#include "Core/Foundation/context.h"
+#include "Core/Foundation/filesystem.h"
+
+#include <string.h>
+#include <unistd.h>
+
+static constexpr u64 kFileSize     = MiB(4) + 123;
+static constexpr u32 kMaxInFlight  = 64;
+// More reads than fit in flight, so batches fill the whole ring before they get awaited
+static constexpr u32 kReadCount    = 2000;
+static constexpr u64 kMaxReadSize  = KiB(96);
+
+struct TestRead
+{
+  AsyncFilePromise promise;
+  u64              offset = 0;
+  u64              size   = 0;
+  u8*              dst    = nullptr;
+  // Anything that runs past the end of the file has to fail
+  bool             past_end = false;
+};
+
+static u8* g_FileData = nullptr;
+
+// Both backends see the same file and the same reads, and both have to come up with exactly what's in the file
+static void
+test_backend(const char* path, bool force_fallback, u32 seed)
+{
+  AsyncIoDesc desc;
+  desc.max_reads_in_flight = kMaxInFlight;
+  desc.force_fallback      = force_fallback;
+  init_async_io((AllocHeap)GLOBAL_HEAP, desc);
+
+  const char* backend = get_async_io_backend_name();
+  CHECK(!force_fallback || strcmp(backend, "pread") == 0);
+
+  // Half of the reads go into a registered buffer, where io_uring does fixed buffer reads. Registering can fail
+  // (RLIMIT_MEMLOCK), the reads have to come out the same either way.
+  u8*  fixed_buffer = (u8*)malloc(kMaxInFlight * kMaxReadSize);
+  bool registered   = register_async_io_buffer(fixed_buffer, kMaxInFlight * kMaxReadSize);
+  u8*  loose_buffer = (u8*)malloc(kMaxInFlight * kMaxReadSize);
+  printf("async_io_test: %s backend%s\n", backend, registered ? " with a fixed buffer" : "");
+
+  Result<AsyncFileStream, FileError> file = open_file_async(path, kFileStreamRead);
+  REQUIRE(file);
+
+  TestRng rng;
+  rng.state += seed;
+
+  TestRead reads[kMaxInFlight];
+  u32      completed = 0;
+  u32      failed    = 0;
+  for (u32 iread = 0; iread < kReadCount; iread += kMaxInFlight)
+  {
+    u32 batch = MIN(kMaxInFlight, kReadCount - iread);
+    for (u32 i = 0; i < batch; i++)
+    {
+      TestRead* read = &reads[i];
+      u32       kind = test_rng_range(&rng, 16);
+
+      read->size   = kind == 0 ? 0 : 1 + test_rng_range(&rng, (u32)kMaxReadSize);
+      read->offset = test_rng_range(&rng, (u32)kFileSize);
+      if (kind == 1)
+      {
+        read->offset = kFileSize - test_rng_range(&rng, (u32)read->size);
+      }
+      read->past_end = read->offset + read->size > kFileSize;
+
+      read->dst = ((i & 1) ? fixed_buffer : loose_buffer) + i * kMaxReadSize;
+      memset(read->dst, 0xCD, kMaxReadSize);
+
+      Result<void, FileError> kicked = read_file(file.value(), &read->promise, read->dst, read->size, read->offset);
+      REQUIRE(kicked);
+    }
+    CHECK(submit_async_io());
+
+    // Poll the first half without blocking, then block on whatever's left
+    for (u32 i = 0; i < batch; i++)
+    {
+      TestRead*  read   = &reads[i];
+      AwaitError status = kAwaitInFlight;
+      if (i < batch / 2)
+      {
+        u64 start = get_test_time_ms();
+        while ((status = await_io(&read->promise, 0)) == kAwaitInFlight)
+        {
+          REQUIRE(get_test_time_ms() - start < 10000);
+          yield_current_thread();
+        }
+      }
+      else
+      {
+        status = await_io(&read->promise);
+      }
+
+      CHECK(read->promise.op == nullptr);
+      if (read->past_end)
+      {
+        CHECK_MSG(status == kAwaitFailed, "%s: read of %u bytes at %u past the end didn't fail", backend, (u32)read->size, (u32)read->offset);
+        failed++;
+        continue;
+      }
+
+      CHECK_MSG(status == kAwaitCompleted, "%s: read of %u bytes at %u failed", backend, (u32)read->size, (u32)read->offset);
+      CHECK_MSG(memcmp(read->dst, g_FileData + read->offset, read->size) == 0, "%s: read of %u bytes at %u got the wrong data", backend, (u32)read->size, (u32)read->offset);
+      // Nothing past the end of the read got touched
+      CHECK(read->size == kMaxReadSize || read->dst[read->size] == 0xCD);
+      completed++;
+    }
+  }
+  CHECK(completed + failed == kReadCount);
+  CHECK(failed > 0);
+
+  // The whole file in one go, into the fixed buffer when it fits and woken up by a completion event
+  OsEvent          event = init_os_event();
+  AsyncFilePromise whole;
+  u8*              dst   = (u8*)malloc(kFileSize);
+  REQUIRE(read_file(file.value(), &whole, dst, kFileSize, 0, &event));
+  CHECK(submit_async_io());
+  CHECK(os_event_wait(&event, 10000));
+  CHECK(await_io(&whole) == kAwaitCompleted);
+  CHECK(memcmp(dst, g_FileData, kFileSize) == 0);
+  destroy_os_event(&event);
+  free(dst);
+
+  close_file(&file.value());
+  destroy_async_io();
+
+  free(loose_buffer);
+  free(fixed_buffer);
+}
+
+int
+main()
+{
+  init_thread_context();
+
+  char path[] = "/tmp/athena_async_io_XXXXXX";
+  s32  fd     = mkstemp(path);
+  REQUIRE(fd >= 0);
+  close(fd);
+
+  g_FileData = (u8*)malloc(kFileSize);
+  TestRng rng;
+  for (u64 i = 0; i < kFileSize; i++)
+  {
+    g_FileData[i] = (u8)test_rng_next(&rng);
+  }
+
+  Result<FileStream, FileError> file = create_file(path, kCreateTruncateExisting);
+  REQUIRE(file);
+  REQUIRE(write_file(file.value(), g_FileData, kFileSize));
+  close_file(&file.value());
+
+  // io_uring (when the kernel has it) and the pread fallback, twice each so that init and destroy get run back to back
+  for (u32 run = 0; run < 2; run++)
+  {
+    test_backend(path, false, run);
+    test_backend(path, true,  run);
+  }
+
+  unlink(path);
+  free(g_FileData);
+
+  return finish_test("async_io_test");
+}
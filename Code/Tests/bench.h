@@ -0,0 +1,54 @@
+#pragma once
+#include "Tests/test.h"
+
+// Benchmarks are plain executables that print a table of numbers, ctest doesn't run them since they take a while and
+// only mean something on an otherwise idle machine. Most of them take an optional size on the command line, the
+// defaults are small enough to finish in a few seconds.
+
+inline u64
+get_bench_time_ns()
+{
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (u64)now.tv_sec * 1000000000ULL + (u64)now.tv_nsec;
+}
+
+inline f64
+get_bench_ns_per_op(u64 start_ns, u64 ops)
+{
+  return ops != 0 ? (f64)(get_bench_time_ns() - start_ns) / (f64)ops : 0.0;
+}
+
+// Keeps the compiler from throwing away work whose result nothing looks at
+template <typename T>
+inline void
+bench_keep(const T& value)
+{
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+inline u64
+get_bench_arg(int argc, char** argv, int index, u64 fallback)
+{
+  return argc > index ? strtoull(argv[index], nullptr, 0) : fallback;
+}
+
+// Sorts the samples in place, p is in [0, 100]
+inline u64
+get_bench_percentile(u64* samples, u64 count, f64 p)
+{
+  if (count == 0)
+  {
+    return 0;
+  }
+
+  qsort(samples, count, sizeof(u64), [](const void* lhs, const void* rhs) -> int
+  {
+    u64 a = *(const u64*)lhs;
+    u64 b = *(const u64*)rhs;
+    return a < b ? -1 : a > b ? 1 : 0;
+  });
+
+  u64 index = (u64)(p / 100.0 * (f64)(count - 1) + 0.5);
+  return samples[MIN(index, count - 1)];
+}
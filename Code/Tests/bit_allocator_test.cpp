@@ -0,0 +1,149 @@
+#include "Tests/test.h"
+
+#include "Core/Foundation/bit_allocator.h"
+
+struct LiveRange
+{
+  u32 start;
+  u32 count;
+};
+
+// First fit over a plain bool per bit, which is what the summary levels should be an accelerated version of.
+static s64
+find_first_free_run(const bool* model, u32 capacity, u32 count)
+{
+  u32 run = 0;
+  for (u32 i = 0; i < capacity; i++)
+  {
+    run = model[i] ? 0 : run + 1;
+    if (run == count)
+    {
+      return (s64)(i + 1 - count);
+    }
+  }
+
+  return -1;
+}
+
+// Random single and range allocs/frees checked against the model. The capacities straddle the qword and summary
+// level boundaries (64, 64^2, 64^3) so that partial last words and every summary level count get hit.
+static void
+test_bit_allocator_fuzz(u32 capacity, u32 iterations)
+{
+  BitAllocator allocator = init_bit_allocator((AllocHeap)GLOBAL_HEAP, capacity);
+
+  bool*      model      = (bool*)calloc(capacity, sizeof(bool));
+  LiveRange* live       = (LiveRange*)malloc(sizeof(LiveRange) * capacity);
+  u32        live_count = 0;
+  u32        used       = 0;
+
+  TestRng rng;
+  rng.state += capacity;
+  for (u32 iteration = 0; iteration < iterations; iteration++)
+  {
+    u32 op = test_rng_range(&rng, 4);
+    if (op == 0 && used < capacity)
+    {
+      u32 idx      = unwrap(bit_alloc(&allocator));
+      s64 expected = find_first_free_run(model, capacity, 1);
+      CHECK_MSG(idx == expected, "capacity %u: bit_alloc returned %u, expected %lld", capacity, idx, (long long)expected);
+
+      model[idx]         = true;
+      live[live_count++] = LiveRange{idx, 1};
+      used++;
+    }
+    else if (op == 1)
+    {
+      u32         count    = 1 + test_rng_range(&rng, MIN(capacity, 200U));
+      Option<u32> start    = bit_alloc_range(&allocator, count);
+      s64         expected = find_first_free_run(model, capacity, count);
+      if (expected < 0)
+      {
+        CHECK_MSG(!start, "capacity %u: bit_alloc_range(%u) returned %u, expected none", capacity, count, start.value);
+        continue;
+      }
+
+      REQUIRE(start);
+      CHECK_MSG(start.value == expected, "capacity %u: bit_alloc_range(%u) returned %u, expected %lld",
+                capacity, count, start.value, (long long)expected);
+
+      for (u32 i = 0; i < count; i++)
+      {
+        model[start.value + i] = true;
+      }
+      live[live_count++] = LiveRange{start.value, count};
+      used += count;
+    }
+    else if (live_count > 0)
+    {
+      u32       index = test_rng_range(&rng, live_count);
+      LiveRange range = live[index];
+      live[index]     = live[--live_count];
+
+      if (range.count == 1)
+      {
+        bit_free(&allocator, range.start);
+      }
+      else
+      {
+        bit_free_range(&allocator, range.start, range.count);
+      }
+
+      for (u32 i = 0; i < range.count; i++)
+      {
+        model[range.start + i] = false;
+      }
+      used -= range.count;
+    }
+
+    REQUIRE(allocator.allocated_count == used);
+  }
+
+  for (u32 i = 0; i < capacity; i++)
+  {
+    CHECK_MSG(bit_is_allocated(allocator, i) == model[i], "capacity %u: bit %u", capacity, i);
+  }
+
+  free(live);
+  free(model);
+}
+
+// Filling up completely has to hand out every id exactly once, and a range that's one too big for the biggest hole
+// has to fail instead of walking off the end.
+static void
+test_bit_allocator_full(u32 capacity)
+{
+  BitAllocator allocator = init_bit_allocator((AllocHeap)GLOBAL_HEAP, capacity);
+
+  for (u32 i = 0; i < capacity; i++)
+  {
+    Option<u32> idx = bit_alloc(&allocator);
+    REQUIRE(idx);
+    CHECK(idx.value == i);
+  }
+  CHECK(allocator.allocated_count == capacity);
+  CHECK(!bit_alloc_range(&allocator, 1));
+
+  if (capacity >= 130)
+  {
+    bit_free_range(&allocator, 63, 65);
+    CHECK(!bit_alloc_range(&allocator, 66));
+
+    Option<u32> start = bit_alloc_range(&allocator, 65);
+    REQUIRE(start);
+    CHECK(start.value == 63);
+  }
+}
+
+int
+main()
+{
+  static constexpr u32 kCapacities[] = {1, 63, 64, 65, 1000, 4096, 4097, 70000, 262145};
+  for (u32 capacity : kCapacities)
+  {
+    test_bit_allocator_fuzz(capacity, 200000);
+    test_bit_allocator_full(capacity);
+  }
+
+  return finish_test("bit_allocator_test");
+}
@@ -0,0 +1,175 @@
+#include "Tests/bench.h"
+
+#include "Core/Foundation/context.h"
+#include "Core/Foundation/compression.h"
+
+#include <math.h>
+#include <string.h>
+
+// Ratio, compression speed and decompression speed of every codec and level on a few kinds of asset-like data, all
+// on one thread.
+//
+//   random     stands in for block compressed textures, which barely compress at all
+//   words      text-ish data like shader source and material definitions
+//   vertices   interleaved position/normal/uv floats of a smooth mesh
+//   mixed      stretches of each of the above
+//
+//   compression_bench [MiB]
+
+enum BenchData : u8
+{
+  kBenchDataRandom,
+  kBenchDataWords,
+  kBenchDataVertices,
+  kBenchDataMixed,
+
+  kBenchDataCount,
+};
+
+static const char* kBenchDataNames[] = {"random", "words", "vertices", "mixed"};
+
+static constexpr CompressionCodec kCodecs[] = {kCompressionCodecNone, kCompressionCodecLz4};
+static constexpr CompressionLevel kLevels[] = {kCompressionLevelFast, kCompressionLevelHigh};
+static const char*                kLevelNames[] = {"fast", "high"};
+
+struct BenchVertex
+{
+  f32 position[3];
+  f32 normal  [3];
+  f32 uv      [2];
+};
+
+static void
+fill_bench_data(u8* dst, u64 size, BenchData kind, TestRng* rng)
+{
+  static const char* kWords[] = {"float4 ", "albedo ", "texture ", "sample(", "normal ", "= ", "return ", ";\n", "0.5f ", "roughness "};
+
+  u64 i = 0;
+  while (i < size)
+  {
+    BenchData run_kind = kind == kBenchDataMixed ? (BenchData)test_rng_range(rng, kBenchDataMixed) : kind;
+    u64       run_end  = kind == kBenchDataMixed ? MIN(size, i + KiB(16) + test_rng_range(rng, KiB(240))) : size;
+    switch (run_kind)
+    {
+      case kBenchDataRandom:
+      {
+        for (; i < run_end; i++)
+        {
+          dst[i] = (u8)test_rng_next(rng);
+        }
+      } break;
+      case kBenchDataWords:
+      {
+        while (i < run_end)
+        {
+          const char* word = kWords[test_rng_range(rng, ARRAY_LENGTH(kWords))];
+          for (; *word != 0 && i < run_end; word++, i++)
+          {
+            dst[i] = (u8)*word;
+          }
+        }
+      } break;
+      case kBenchDataVertices:
+      {
+        // A wavy grid, neighbouring vertices only differ in their low bits
+        for (u32 ivertex = 0; i < run_end; ivertex++)
+        {
+          f32         x = (f32)(ivertex % 256) * 0.1f;
+          f32         z = (f32)(ivertex / 256) * 0.1f;
+          BenchVertex vertex;
+          vertex.position[0] = x;
+          vertex.position[1] = sinf(x) * cosf(z);
+          vertex.position[2] = z;
+          vertex.normal  [0] = 0.0f;
+          vertex.normal  [1] = 1.0f;
+          vertex.normal  [2] = 0.0f;
+          vertex.uv      [0] = x / 25.6f;
+          vertex.uv      [1] = z / 25.6f;
+
+          u64 count = MIN((u64)sizeof(vertex), run_end - i);
+          memcpy(dst + i, &vertex, count);
+          i += count;
+        }
+      } break;
+      default: UNREACHABLE;
+    }
+  }
+}
+
+static void
+bench_codec(const char* data_name, const u8* src, u64 size, CompressionCodec codec, CompressionLevel level)
+{
+  static constexpr u64 kMinBytes = MiB(64);
+
+  u8* blob = (u8*)malloc(get_compressed_blob_bound(size));
+  u8* dst  = (u8*)malloc(size);
+
+  // Enough rounds that small inputs still take a measurable amount of time
+  u64 rounds = MAX(kMinBytes / size, 1ULL);
+
+  u64 blob_size = 0;
+  u64 start     = get_bench_time_ns();
+  for (u64 iround = 0; iround < rounds; iround++)
+  {
+    blob_size = compress_blob(blob, src, size, codec, level);
+  }
+  f64 compress_ns = (f64)(get_bench_time_ns() - start);
+
+  ASSERT_MSG_FATAL(validate_compressed_blob(blob, blob_size, size), "compress_blob wrote a blob that doesn't validate!");
+
+  start = get_bench_time_ns();
+  for (u64 iround = 0; iround < rounds; iround++)
+  {
+    bool ok = decompress_blob(blob, dst);
+    ASSERT_MSG_FATAL(ok, "Failed to decompress a blob that was just compressed!");
+  }
+  f64 decompress_ns = (f64)(get_bench_time_ns() - start);
+
+  ASSERT_MSG_FATAL(memcmp(src, dst, size) == 0, "Decompressed data doesn't match!");
+
+  // Bytes per ns is GB/s
+  printf("%-10s %-6s %-6s %8.3f %12.2f %12.2f\n",
+         data_name,
+         compression_codec_to_str(codec),
+         codec == kCompressionCodecNone ? "-" : kLevelNames[level],
+         (f64)size / (f64)blob_size,
+         (f64)(size * rounds) / compress_ns,
+         (f64)(size * rounds) / decompress_ns);
+
+  free(dst);
+  free(blob);
+}
+
+int
+main(int argc, char** argv)
+{
+  init_thread_context();
+
+  u64 size = get_bench_arg(argc, argv, 1, 16) * MiB(1);
+  u8* src  = (u8*)malloc(size);
+
+  printf("%llu MiB of each, %u KiB chunks, speeds in GB/s of uncompressed data\n\n", (unsigned long long)(size / MiB(1)), kCompressionChunkSize / 1024);
+  printf("%-10s %-6s %-6s %8s %12s %12s\n", "data", "codec", "level", "ratio", "compress", "decompress");
+  for (u32 data = 0; data < kBenchDataCount; data++)
+  {
+    TestRng rng;
+    fill_bench_data(src, size, (BenchData)data, &rng);
+
+    for (CompressionCodec codec : kCodecs)
+    {
+      for (CompressionLevel level : kLevels)
+      {
+        bench_codec(kBenchDataNames[data], src, size, codec, level);
+        if (codec == kCompressionCodecNone)
+        {
+          // Levels don't mean anything without a codec
+          break;
+        }
+      }
+    }
+  }
+
+  free(src);
+
+  return 0;
+}
@@ -0,0 +1,346 @@
+#include "Tests/test.h"
+
+#include "Core/Foundation/context.h"
+#include "Core/Foundation/compression.h"
+
+#include <string.h>
+
+static constexpr CompressionCodec kCodecs[] = {kCompressionCodecNone, kCompressionCodecLz4};
+static constexpr CompressionLevel kLevels[] = {kCompressionLevelFast, kCompressionLevelHigh};
+
+// Bytes past the end of every output, decompressing must never touch them
+static constexpr u32 kGuardSize = 64;
+static constexpr u8  kGuardByte = 0xCD;
+
+enum TestData : u8
+{
+  kTestDataRandom,
+  kTestDataZeros,
+  // Short repeating patterns, which come out as matches that overlap what they copy
+  kTestDataPattern,
+  // Words picked out of a small dictionary, lots of matches of all different lengths and offsets
+  kTestDataWords,
+  // Stretches of each of the above, so some chunks compress and some get stored
+  kTestDataMixed,
+
+  kTestDataCount,
+};
+
+static void
+fill_test_data(u8* dst, u64 size, TestData kind, TestRng* rng)
+{
+  static const char* kWords[] = {"athena ", "texture ", "chunk ", "streaming ", "a ", "decompress ", "\n", "model ", "0123456789 "};
+
+  u64 i = 0;
+  while (i < size)
+  {
+    TestData run_kind = kind == kTestDataMixed ? (TestData)test_rng_range(rng, kTestDataMixed) : kind;
+    u64      run_end  = kind == kTestDataMixed ? MIN(size, i + 1 + test_rng_range(rng, KiB(80))) : size;
+    u32      period   = 1 + test_rng_range(rng, 12);
+    for (; i < run_end; i++)
+    {
+      switch (run_kind)
+      {
+        case kTestDataRandom:  dst[i] = (u8)test_rng_next(rng); break;
+        case kTestDataZeros:   dst[i] = 0; break;
+        case kTestDataPattern: dst[i] = i < period ? (u8)test_rng_next(rng) : dst[i - period]; break;
+        case kTestDataWords:
+        {
+          const char* word = kWords[test_rng_range(rng, ARRAY_LENGTH(kWords))];
+          for (; *word != 0 && i < run_end; word++, i++)
+          {
+            dst[i] = (u8)*word;
+          }
+          i--;
+        } break;
+        default: UNREACHABLE;
+      }
+    }
+  }
+}
+
+static u8*
+compress_test_blob(const u8* src, u64 size, CompressionCodec codec, CompressionLevel level, u64* out_blob_size)
+{
+  u64 bound      = get_compressed_blob_bound(size);
+  u8* blob       = (u8*)malloc(bound);
+  *out_blob_size = compress_blob(blob, src, size, codec, level);
+  REQUIRE(*out_blob_size <= bound);
+  return blob;
+}
+
+static void
+check_round_trip(const u8* src, u64 size, const char* what)
+{
+  u8* dst = (u8*)malloc(size + kGuardSize);
+  for (CompressionCodec codec : kCodecs)
+  {
+    for (CompressionLevel level : kLevels)
+    {
+      u64 blob_size = 0;
+      u8* blob      = compress_test_blob(src, size, codec, level, &blob_size);
+      CHECK_MSG(validate_compressed_blob(blob, blob_size, size), "%s, %s: doesn't validate", what, compression_codec_to_str(codec));
+      CHECK(get_compressed_blob_chunk_count(blob) == UCEIL_DIV(size, (u64)kCompressionChunkSize));
+      CHECK(!validate_compressed_blob(blob, blob_size, size + 1));
+      CHECK(size == 0 || !validate_compressed_blob(blob, blob_size - 1, size));
+
+      memset(dst, kGuardByte, size + kGuardSize);
+      CHECK_MSG(decompress_blob(blob, dst), "%s, %s: failed to decompress", what, compression_codec_to_str(codec));
+      CHECK_MSG(memcmp(dst, src, size) == 0, "%s, %s: decompressed to the wrong data", what, compression_codec_to_str(codec));
+
+      // Chunk by chunk in reverse, each one only ever writes its own part of the output
+      memset(dst, kGuardByte, size + kGuardSize);
+      for (u32 ichunk = get_compressed_blob_chunk_count(blob); ichunk-- > 0;)
+      {
+        CHECK(decompress_blob_chunk(blob, ichunk, dst + (u64)ichunk * kCompressionChunkSize));
+      }
+      CHECK(memcmp(dst, src, size) == 0);
+
+      for (u32 i = 0; i < kGuardSize; i++)
+      {
+        CHECK_MSG(dst[size + i] == kGuardByte, "%s, %s: wrote past the end of the output", what, compression_codec_to_str(codec));
+      }
+
+      free(blob);
+    }
+  }
+  free(dst);
+}
+
+static void
+test_round_trip()
+{
+  static constexpr u64 kSizes[] = {0, 1, 15, 16, 17, 100, kCompressionChunkSize - 1, kCompressionChunkSize, kCompressionChunkSize + 1, MiB(1) + 777};
+  static const char*   kTestDataNames[] = {"random", "zeros", "pattern", "words", "mixed"};
+
+  TestRng rng;
+  for (u64 size : kSizes)
+  {
+    u8* src = (u8*)malloc(size + 1);
+    for (u32 kind = 0; kind < kTestDataCount; kind++)
+    {
+      fill_test_data(src, size, (TestData)kind, &rng);
+
+      char what[64];
+      snprintf(what, sizeof(what), "%u bytes of %s", (u32)size, kTestDataNames[kind]);
+      check_round_trip(src, size, what);
+    }
+    free(src);
+  }
+
+  // Anything that compresses at all has to actually come out smaller
+  u8* src = (u8*)malloc(MiB(1));
+  fill_test_data(src, MiB(1), kTestDataWords, &rng);
+  for (CompressionLevel level : kLevels)
+  {
+    u64 blob_size = 0;
+    u8* blob      = compress_test_blob(src, MiB(1), kCompressionCodecLz4, level, &blob_size);
+    CHECK_MSG(blob_size < MiB(1) / 2, "words only compressed to %u bytes", (u32)blob_size);
+    free(blob);
+  }
+  free(src);
+}
+
+// Every single byte of the chunk data flipped, truncated chunks, and random garbage. Decompressing any of it can fail or
+// come out wrong, but it has to stay inside of its chunk of the output.
+static void
+test_corrupt_chunks()
+{
+  static constexpr u64 kSize = kCompressionChunkSize * 3 + 1000;
+
+  TestRng rng;
+  u8*     src = (u8*)malloc(kSize);
+  fill_test_data(src, kSize, kTestDataMixed, &rng);
+
+  u64 blob_size = 0;
+  u8* blob      = compress_test_blob(src, kSize, kCompressionCodecLz4, kCompressionLevelHigh, &blob_size);
+  u8* corrupt   = (u8*)malloc(blob_size);
+  u8* dst       = (u8*)malloc(kCompressionChunkSize + kGuardSize);
+
+  u32        chunk_count = get_compressed_blob_chunk_count(blob);
+  const u32* chunk_ends  = (const u32*)(blob + sizeof(CompressedBlobHeader));
+  u64        data_start  = sizeof(CompressedBlobHeader) + sizeof(u32) * chunk_count;
+
+  u32 rejected = 0;
+  for (u32 ichunk = 0; ichunk < chunk_count; ichunk++)
+  {
+    u32 chunk_start     = ichunk > 0 ? chunk_ends[ichunk - 1] : 0;
+    u32 compressed_size = chunk_ends[ichunk] - chunk_start;
+    u32 chunk_size      = get_compressed_blob_chunk_size(blob, ichunk);
+    if (compressed_size == chunk_size)
+    {
+      continue;
+    }
+
+    for (u32 i = 0; i < compressed_size; i++)
+    {
+      memcpy(corrupt, blob, blob_size);
+      corrupt[data_start + chunk_start + i] ^= (u8)(1 + test_rng_range(&rng, 255));
+
+      memset(dst, kGuardByte, kCompressionChunkSize + kGuardSize);
+      bool ok    = decompress_blob_chunk(corrupt, ichunk, dst);
+      rejected  += ok ? 0 : 1;
+      for (u32 iguard = chunk_size; iguard < kCompressionChunkSize + kGuardSize; iguard++)
+      {
+        if (dst[iguard] != kGuardByte)
+        {
+          CHECK_MSG(false, "chunk %u with byte %u flipped wrote past its output", ichunk, i);
+          break;
+        }
+      }
+    }
+  }
+  CHECK(rejected > 0);
+
+  // Random garbage for chunk data, with the chunk table left alone
+  for (u32 iter = 0; iter < 2000; iter++)
+  {
+    memcpy(corrupt, blob, blob_size);
+    for (u64 i = data_start; i < blob_size; i++)
+    {
+      corrupt[i] = (u8)test_rng_next(&rng);
+    }
+
+    u32 ichunk = test_rng_range(&rng, chunk_count);
+    memset(dst, kGuardByte, kCompressionChunkSize + kGuardSize);
+    (void)decompress_blob_chunk(corrupt, ichunk, dst);
+    for (u32 iguard = get_compressed_blob_chunk_size(blob, ichunk); iguard < kCompressionChunkSize + kGuardSize; iguard++)
+    {
+      if (dst[iguard] != kGuardByte)
+      {
+        CHECK_MSG(false, "garbage in chunk %u wrote past its output", ichunk);
+        break;
+      }
+    }
+  }
+
+  free(dst);
+  free(corrupt);
+  free(blob);
+  free(src);
+}
+
+struct OneChunkBlob
+{
+  CompressedBlobHeader header;
+  u32                  chunk_end;
+  u8                   data[32];
+};
+
+// A blob with a single LZ4 chunk of the given block, which decompresses to size bytes
+static OneChunkBlob
+init_one_chunk_blob(const u8* block, u32 block_size, u32 size)
+{
+  ASSERT(block_size <= sizeof(OneChunkBlob::data) && block_size < size);
+
+  OneChunkBlob ret;
+  zero_memory(&ret, sizeof(ret));
+  ret.header.magic_number      = kCompressedBlobMagicNumber;
+  ret.header.codec             = kCompressionCodecLz4;
+  ret.header.chunk_count       = 1;
+  ret.header.uncompressed_size = size;
+  ret.chunk_end                = block_size;
+  memcpy(ret.data, block, block_size);
+
+  return ret;
+}
+
+static bool
+decompress_block(const u8* block, u32 block_size, u32 size, u8* dst)
+{
+  OneChunkBlob blob = init_one_chunk_blob(block, block_size, size);
+  REQUIRE(validate_compressed_blob(&blob, offsetof(OneChunkBlob, data) + block_size, size));
+  return decompress_blob_chunk(&blob, 0, dst);
+}
+
+// Hand written blocks that break each of the rules of the LZ4 block format
+static void
+test_malformed_blocks()
+{
+  u8 dst[256];
+
+  // 4 literals "abcd", then a match 4 back for 12 more, then the last 5 literals. That's 21 bytes.
+  static constexpr u8 kValid[] = {0x48, 'a', 'b', 'c', 'd', 0x04, 0x00, 0x50, 'e', 'f', 'g', 'h', 'i'};
+  CHECK(decompress_block(kValid, sizeof(kValid), 21, dst));
+  CHECK(memcmp(dst, "abcdabcdabcdabcdefghi", 21) == 0);
+
+  // Decompresses to the wrong size either way
+  CHECK(!decompress_block(kValid, sizeof(kValid), 22, dst));
+  CHECK(!decompress_block(kValid, sizeof(kValid) - 1, 21, dst));
+
+  // Offset 0
+  static constexpr u8 kZeroOffset[] = {0x48, 'a', 'b', 'c', 'd', 0x00, 0x00, 0x50, 'e', 'f', 'g', 'h', 'i'};
+  CHECK(!decompress_block(kZeroOffset, sizeof(kZeroOffset), 21, dst));
+
+  // Offset further back than the start of the output
+  static constexpr u8 kOffsetTooFar[] = {0x48, 'a', 'b', 'c', 'd', 0x05, 0x00, 0x50, 'e', 'f', 'g', 'h', 'i'};
+  CHECK(!decompress_block(kOffsetTooFar, sizeof(kOffsetTooFar), 21, dst));
+
+  // More literals than there are bytes left in the block
+  static constexpr u8 kLiteralsPastEnd[] = {0x90, 'a', 'b', 'c'};
+  CHECK(!decompress_block(kLiteralsPastEnd, sizeof(kLiteralsPastEnd), 9, dst));
+
+  // A match that runs past the end of the output
+  static constexpr u8 kMatchPastEnd[] = {0x4F, 'a', 'b', 'c', 'd', 0x04, 0x00, 0xFF, 0x10, 'e'};
+  CHECK(!decompress_block(kMatchPastEnd, sizeof(kMatchPastEnd), 40, dst));
+
+  // A length that never ends
+  static constexpr u8 kUnterminatedLength[] = {0xF0, 0xFF, 0xFF, 0xFF};
+  CHECK(!decompress_block(kUnterminatedLength, sizeof(kUnterminatedLength), 200, dst));
+
+  // Ends right after a match instead of with literals
+  static constexpr u8 kEndsOnMatch[] = {0x40, 'a', 'b', 'c', 'd', 0x04, 0x00};
+  CHECK(!decompress_block(kEndsOnMatch, sizeof(kEndsOnMatch), 8, dst));
+}
+
+static void
+test_validate()
+{
+  static constexpr u64 kSize = kCompressionChunkSize * 2 + 10;
+
+  TestRng rng;
+  u8*     src = (u8*)malloc(kSize);
+  fill_test_data(src, kSize, kTestDataWords, &rng);
+
+  u64 blob_size = 0;
+  u8* blob      = compress_test_blob(src, kSize, kCompressionCodecLz4, kCompressionLevelFast, &blob_size);
+  u8* corrupt   = (u8*)malloc(blob_size);
+  REQUIRE(validate_compressed_blob(blob, blob_size, kSize));
+
+  CHECK(!validate_compressed_blob(blob, sizeof(CompressedBlobHeader) - 1, kSize));
+  CHECK(!validate_compressed_blob(blob, sizeof(CompressedBlobHeader) + 4, kSize));
+
+  // Every field of the header and the chunk table, one at a time
+  CompressedBlobHeader* header     = (CompressedBlobHeader*)corrupt;
+  u32*                  chunk_ends = (u32*)(corrupt + sizeof(CompressedBlobHeader));
+  auto                  reset      = [&]() { memcpy(corrupt, blob, blob_size); };
+
+  reset(); header->magic_number++;                      CHECK(!validate_compressed_blob(corrupt, blob_size, kSize));
+  reset(); header->codec = kCompressionCodecCount;      CHECK(!validate_compressed_blob(corrupt, blob_size, kSize));
+  reset(); header->chunk_count++;                       CHECK(!validate_compressed_blob(corrupt, blob_size, kSize));
+  reset(); header->chunk_count = 0xFFFFFFFF;            CHECK(!validate_compressed_blob(corrupt, blob_size, kSize));
+  reset(); header->uncompressed_size++;                 CHECK(!validate_compressed_blob(corrupt, blob_size, kSize));
+  reset(); chunk_ends[0] = 0;                           CHECK(!validate_compressed_blob(corrupt, blob_size, kSize));
+  reset(); chunk_ends[1] = chunk_ends[0];               CHECK(!validate_compressed_blob(corrupt, blob_size, kSize));
+  reset(); chunk_ends[2] += 1;                          CHECK(!validate_compressed_blob(corrupt, blob_size, kSize));
+  reset(); chunk_ends[0] = kCompressionChunkSize + 1;   CHECK(!validate_compressed_blob(corrupt, blob_size, kSize));
+  // Stored chunks have to be exactly their size
+  reset(); header->codec = kCompressionCodecNone;       CHECK(!validate_compressed_blob(corrupt, blob_size, kSize));
+
+  free(corrupt);
+  free(blob);
+  free(src);
+}
+
+int
+main()
+{
+  init_thread_context();
+
+  test_round_trip();
+  test_corrupt_chunks();
+  test_malformed_blocks();
+  test_validate();
+
+  return finish_test("compression_test");
+}
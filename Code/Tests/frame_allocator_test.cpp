@@ -0,0 +1,167 @@
+#include "Tests/test.h"
+
+#include "Core/Foundation/context.h"
+#include "Core/Foundation/memory.h"
+
+struct FrameAllocation
+{
+  u8* memory;
+  u32 size;
+};
+
+static constexpr u32 kStressThreads         = 4;
+static constexpr u32 kStressAllocsPerThread = 10000;
+
+struct FrameStressThread
+{
+  FrameAllocator*  allocator;
+  u32              index;
+  u32              frame;
+  FrameAllocation* allocations;
+  u32              misaligned;
+};
+
+static u32
+frame_stress_thread(void* param)
+{
+  auto* thread = (FrameStressThread*)param;
+
+  AllocHeap heap = *thread->allocator;
+  TestRng   rng;
+  rng.state += thread->index * 7 + thread->frame * 131;
+  for (u32 i = 0; i < kStressAllocsPerThread; i++)
+  {
+    // Mostly small stuff out of the thread chunks, the odd big one straight out of the shared block
+    u32 size      = test_rng_range(&rng, 50) == 0 ? 1 + test_rng_range(&rng, 40000) : 1 + test_rng_range(&rng, 200);
+    u32 alignment = 1U << test_rng_range(&rng, 7);
+
+    u8* memory = HEAP_ALLOC_ALIGNED(heap, size, alignment);
+    if (((uintptr_t)memory & (alignment - 1)) != 0)
+    {
+      thread->misaligned++;
+    }
+
+    memset(memory, (u8)(thread->index + 1), size);
+    thread->allocations[i] = FrameAllocation{memory, size};
+  }
+
+  return 0;
+}
+
+// Threads allocate at the same time every frame, then everything gets checked for overlap (every thread's pattern has to
+// have survived) and for staying inside of the frame's buffer.
+static void
+test_frame_allocator_stress()
+{
+  static constexpr size_t kSize        = MiB(256);
+  static constexpr u32    kBufferCount = 3;
+
+  u8*                   memory    = (u8*)aligned_alloc(kCacheLineSize, kSize);
+  static FrameAllocator allocator;
+  allocator = init_frame_allocator(memory, kSize, kBufferCount);
+
+  FrameStressThread threads[kStressThreads];
+  for (u32 ithread = 0; ithread < kStressThreads; ithread++)
+  {
+    threads[ithread].allocations = (FrameAllocation*)malloc(sizeof(FrameAllocation) * kStressAllocsPerThread);
+  }
+
+  for (u32 frame = 0; frame < 20; frame++)
+  {
+    Thread handles[kStressThreads];
+    for (u32 ithread = 0; ithread < kStressThreads; ithread++)
+    {
+      threads[ithread].allocator  = &allocator;
+      threads[ithread].index      = ithread;
+      threads[ithread].frame      = frame;
+      threads[ithread].misaligned = 0;
+      handles[ithread]            = init_test_thread(&frame_stress_thread, &threads[ithread]);
+    }
+
+    join_threads(handles, kStressThreads);
+
+    uintptr_t buffer_start = allocator.start + allocator.buffer_index * allocator.buffer_size;
+    uintptr_t buffer_end   = buffer_start + allocator.buffer_size;
+    for (u32 ithread = 0; ithread < kStressThreads; ithread++)
+    {
+      destroy_thread(&handles[ithread]);
+      CHECK(threads[ithread].misaligned == 0);
+
+      for (u32 i = 0; i < kStressAllocsPerThread; i++)
+      {
+        FrameAllocation allocation = threads[ithread].allocations[i];
+        CHECK((uintptr_t)allocation.memory >= buffer_start && (uintptr_t)allocation.memory + allocation.size <= buffer_end);
+
+        for (u32 j = 0; j < allocation.size; j++)
+        {
+          if (allocation.memory[j] != (u8)(ithread + 1))
+          {
+            CHECK_MSG(false, "frame %u: thread %u allocation %u got stomped at byte %u", frame, ithread, i, j);
+            break;
+          }
+        }
+      }
+    }
+
+    reset_frame_allocator(&allocator);
+    CHECK(allocator.last_frame_used > 0);
+  }
+
+  CHECK(allocator.high_water_mark <= allocator.buffer_size);
+
+  for (u32 ithread = 0; ithread < kStressThreads; ithread++)
+  {
+    free(threads[ithread].allocations);
+  }
+  free(memory);
+}
+
+// Memory from frame N has to be left alone until frame N + buffer_count, and every frame gets size / buffer_count.
+static void
+test_frame_allocator_buffering()
+{
+  static constexpr size_t kSize        = MiB(1);
+  static constexpr u32    kBufferCount = 2;
+
+  u8*            memory    = (u8*)aligned_alloc(kCacheLineSize, kSize);
+  FrameAllocator allocator = init_frame_allocator(memory, kSize, kBufferCount, KiB(4));
+  CHECK(allocator.buffer_size == kSize / kBufferCount);
+
+  AllocHeap heap = allocator;
+
+  // The whole per frame budget has to be usable, in one go
+  u8* frames[kBufferCount + 1];
+  for (u32 frame = 0; frame <= kBufferCount; frame++)
+  {
+    frames[frame] = HEAP_ALLOC_ALIGNED(heap, allocator.buffer_size, 1);
+    memset(frames[frame], (u8)(frame + 1), allocator.buffer_size);
+
+    CHECK(frame_allocator_used(&allocator) == allocator.buffer_size);
+    reset_frame_allocator(&allocator);
+    CHECK(frame_allocator_used(&allocator) == 0);
+  }
+
+  CHECK(frames[0] != frames[1]);
+  CHECK(frames[kBufferCount] == frames[0]);
+  for (u32 i = 0; i < allocator.buffer_size; i++)
+  {
+    if (frames[1][i] != 2)
+    {
+      CHECK_MSG(false, "frame 1's memory got stomped at byte %u", i);
+      break;
+    }
+  }
+
+  free(memory);
+}
+
+int
+main()
+{
+  init_thread_context();
+
+  test_frame_allocator_stress();
+  test_frame_allocator_buffering();
+
+  return finish_test("frame_allocator_test");
+}
@@ -0,0 +1,168 @@
+#include "Tests/bench.h"
+
+#include "Core/Foundation/memory.h"
+#include "Core/Foundation/Containers/hash_table.h"
+
+// Probe lengths and insert/lookup throughput of fixed and growable tables, fresh and after a lot of churn at a steady
+// entry count (the way the asset registries get used), plus what growing costs with and without a reserve.
+//
+//   hash_table_bench [entries]
+
+struct ProbeStats
+{
+  f64 average = 0.0;
+  u64 max     = 0;
+};
+
+// How many groups past its home group every key is stored, 0 for a key that's right where its hash puts it
+template <typename V>
+static ProbeStats
+get_probe_stats(HashTable<u64, V>* table)
+{
+  using Table = HashTable<u64, V>;
+
+  // Anything still in the old arrays would be measured against the wrong group count
+  hash_table_migrate_groups(table, U64_MAX);
+
+  ProbeStats ret;
+  u64        total = 0;
+  for (auto kv : *table)
+  {
+    auto h    = hash_table_hash(table, kv.key);
+    u64  slot = Table::find_slot(table->groups, table->groups_size, h, kv.key, [](u64 lhs, u64 rhs) { return lhs == rhs; });
+    u64  home = h.position % table->groups_size;
+    u64  dist = (slot / kHashTableGroupWidth + table->groups_size - home) % table->groups_size;
+    total    += dist;
+    ret.max   = MAX(ret.max, dist);
+  }
+  ret.average = table->used != 0 ? (f64)total / (f64)table->used : 0.0;
+
+  return ret;
+}
+
+struct LookupStats
+{
+  f64 hit_ns  = 0.0;
+  f64 miss_ns = 0.0;
+};
+
+// Keys are [first, first + count), misses look up keys that were never inserted
+template <typename V>
+static LookupStats
+time_lookups(HashTable<u64, V>* table, u64 first, u64 count)
+{
+  static constexpr u64 kRounds = 4;
+
+  LookupStats ret;
+  TestRng     rng;
+
+  u64 start = get_bench_time_ns();
+  for (u64 i = 0; i < count * kRounds; i++)
+  {
+    bench_keep(hash_table_find(table, first + test_rng_range(&rng, (u32)count)));
+  }
+  ret.hit_ns = get_bench_ns_per_op(start, count * kRounds);
+
+  start = get_bench_time_ns();
+  for (u64 i = 0; i < count * kRounds; i++)
+  {
+    bench_keep(hash_table_find(table, (1ULL << 62) + test_rng_next(&rng)));
+  }
+  ret.miss_ns = get_bench_ns_per_op(start, count * kRounds);
+
+  return ret;
+}
+
+static void
+print_row(const char* name, HashTable<u64, u64>* table, f64 insert_ns, u64 first, u64 count)
+{
+  LookupStats lookups = time_lookups(table, first, count);
+  ProbeStats  probes  = get_probe_stats(table);
+  printf("%-24s %10llu %10llu %10.2f %8llu %10.1f %10.1f %10.1f\n",
+         name,
+         (unsigned long long)table->capacity,
+         (unsigned long long)table->tombstones,
+         probes.average,
+         (unsigned long long)probes.max,
+         insert_ns,
+         lookups.hit_ns,
+         lookups.miss_ns);
+}
+
+static void
+bench_churn(const char* name, bool growable, u64 entries)
+{
+  HashTable<u64, u64> table = growable ? init_growable_hash_table<u64, u64>(GLOBAL_HEAP, entries) : init_hash_table<u64, u64>((AllocHeap)GLOBAL_HEAP, entries);
+
+  u64 start = get_bench_time_ns();
+  for (u64 key = 0; key < entries; key++)
+  {
+    *hash_table_insert(&table, key) = key;
+  }
+  f64 insert_ns = get_bench_ns_per_op(start, entries);
+
+  char row[64];
+  snprintf(row, sizeof(row), "%s fresh", name);
+  print_row(row, &table, insert_ns, 0, entries);
+
+  // Erase the oldest key and insert a brand new one, which leaves tombstones all over the table
+  static constexpr u64 kChurnRounds = 20;
+  start = get_bench_time_ns();
+  for (u64 key = entries; key < entries * kChurnRounds; key++)
+  {
+    hash_table_erase(&table, key - entries);
+    *hash_table_insert(&table, key) = key;
+  }
+  f64 churn_ns = get_bench_ns_per_op(start, entries * (kChurnRounds - 1));
+
+  snprintf(row, sizeof(row), "%s churned", name);
+  print_row(row, &table, churn_ns, entries * (kChurnRounds - 1), entries);
+
+  // Fixed tables don't own their arrays, the process is about to exit anyway
+  if (growable)
+  {
+    destroy_hash_table(&table);
+  }
+}
+
+// Average and worst single insert while filling a table up, the incremental rehash is there to keep the worst one down
+static void
+bench_growth(const char* name, u64 entries, bool reserve)
+{
+  HashTable<u64, u64> table = init_growable_hash_table<u64, u64>(GLOBAL_HEAP);
+  if (reserve)
+  {
+    hash_table_reserve(&table, entries);
+  }
+
+  u64 worst = 0;
+  u64 start = get_bench_time_ns();
+  for (u64 key = 0; key < entries; key++)
+  {
+    u64 insert_start = get_bench_time_ns();
+    *hash_table_insert(&table, key) = key;
+    worst = MAX(worst, get_bench_time_ns() - insert_start);
+  }
+  f64 insert_ns = get_bench_ns_per_op(start, entries);
+
+  printf("%-24s %10llu %10.1f %10.1f\n", name, (unsigned long long)table.capacity, insert_ns, (f64)worst / 1000.0);
+
+  destroy_hash_table(&table);
+}
+
+int
+main(int argc, char** argv)
+{
+  u64 entries = get_bench_arg(argc, argv, 1, 0x10000);
+
+  printf("%llu entries, %u wide groups, probe lengths in groups\n\n", (unsigned long long)entries, kHashTableGroupWidth);
+  printf("%-24s %10s %10s %10s %8s %10s %10s %10s\n", "table", "capacity", "tombstones", "avg probe", "max", "insert ns", "hit ns", "miss ns");
+  bench_churn("fixed",    false, entries);
+  bench_churn("growable", true,  entries);
+
+  printf("\n%-24s %10s %10s %10s\n", "growing", "capacity", "insert ns", "worst us");
+  bench_growth("from 16",  entries * 8, false);
+  bench_growth("reserved", entries * 8, true);
+
+  return 0;
+}
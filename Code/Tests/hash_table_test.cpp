@@ -0,0 +1,315 @@
+#include "Tests/test.h"
+
+#include "Core/Foundation/memory.h"
+#include "Core/Foundation/Containers/hash_table.h"
+
+struct TestValue
+{
+  u64 key;
+  u64 payload;
+};
+
+// Reference of which keys should be in the table. Keys are [0, kKeyRange) so a flat array is enough.
+static constexpr u32 kKeyRange = 1U << 16;
+
+static void
+check_matches_reference(HashTable<u64, TestValue>* table, const u8* present, const u64* payloads)
+{
+  u64 count = 0;
+  for (u32 key = 0; key < kKeyRange; key++)
+  {
+    TestValue* value = hash_table_find(table, (u64)key);
+    if (present[key])
+    {
+      count++;
+      if (value == nullptr)
+      {
+        CHECK_MSG(false, "key %u is missing", key);
+        continue;
+      }
+      CHECK(value->key == key && value->payload == payloads[key]);
+    }
+    else
+    {
+      CHECK_MSG(value == nullptr, "key %u should have been erased", key);
+    }
+  }
+  CHECK(table->used == count);
+
+  u64 iterated = 0;
+  for (auto kv : *table)
+  {
+    CHECK(present[kv.key]);
+    iterated++;
+  }
+  CHECK(iterated == count);
+}
+
+static void
+test_growable_insert_erase()
+{
+  HashTable<u64, TestValue> table = init_growable_hash_table<u64, TestValue>(GLOBAL_HEAP);
+
+  u8*  present  = (u8*) calloc(kKeyRange, sizeof(u8));
+  u64* payloads = (u64*)calloc(kKeyRange, sizeof(u64));
+
+  // Random inserts and erases, biased towards inserts so that the table grows through a bunch of incremental rehashes
+  TestRng rng;
+  for (u32 iteration = 0; iteration < 400000; iteration++)
+  {
+    u64 key = test_rng_range(&rng, kKeyRange);
+    if (test_rng_range(&rng, 3) != 0)
+    {
+      TestValue* value = hash_table_insert(&table, key);
+      if (!present[key])
+      {
+        CHECK(value->key == 0 && value->payload == 0);
+      }
+      value->key    = key;
+      value->payload = payloads[key] = test_rng_next(&rng);
+      present[key]  = 1;
+    }
+    else
+    {
+      CHECK(hash_table_erase(&table, key) == (bool)present[key]);
+      present[key] = 0;
+    }
+
+    if (iteration % 50000 == 0)
+    {
+      check_matches_reference(&table, present, payloads);
+    }
+  }
+  check_matches_reference(&table, present, payloads);
+
+  destroy_hash_table(&table);
+  free(present);
+  free(payloads);
+}
+
+// Growing doubles the slots once, the 75% max load only gets applied when going from an entry count to a slot count.
+static void
+test_growth_factor()
+{
+  static constexpr u64 kEntryCount = 10000;
+
+  HashTable<u64, u64> table = init_growable_hash_table<u64, u64>(GLOBAL_HEAP);
+
+  u64 last_capacity = table.capacity;
+  for (u64 key = 0; key < kEntryCount; key++)
+  {
+    *hash_table_insert(&table, key) = key;
+    if (table.capacity != last_capacity)
+    {
+      CHECK_MSG(table.capacity == last_capacity * 2, "grew from %llu to %llu slots", (unsigned long long)last_capacity, (unsigned long long)table.capacity);
+      last_capacity = table.capacity;
+    }
+  }
+
+  CHECK(table.used * 4 <= table.capacity * 3);
+  CHECK(table.used * 8 >  table.capacity * 3);
+
+  hash_table_reserve(&table, kEntryCount * 4);
+  CHECK(table.capacity >= hash_table_slots_for_entries(kEntryCount * 4));
+  CHECK(table.capacity <  hash_table_slots_for_entries(kEntryCount * 4) + kHashTableGroupWidth);
+
+  destroy_hash_table(&table);
+}
+
+// A table with a steady number of entries and a lot of churn should neither grow forever nor fill up with tombstones.
+static void
+test_churn(bool growable)
+{
+  static constexpr u64 kLiveCount = 3000;
+
+  HashTable<u64, u64> table = growable ? init_growable_hash_table<u64, u64>(GLOBAL_HEAP, kLiveCount) : init_hash_table<u64, u64>((AllocHeap)GLOBAL_HEAP, kLiveCount);
+  u64 capacity = table.capacity;
+
+  for (u64 key = 0; key < kLiveCount; key++)
+  {
+    *hash_table_insert(&table, key) = key;
+  }
+
+  // Erase the oldest key and insert a brand new one, which spreads tombstones all over the table
+  for (u64 key = kLiveCount; key < kLiveCount * 200; key++)
+  {
+    CHECK(hash_table_erase(&table, key - kLiveCount));
+    *hash_table_insert(&table, key) = key;
+
+    CHECK((table.used + table.tombstones) <= table.capacity);
+  }
+
+  CHECK(table.used == kLiveCount);
+  if (growable)
+  {
+    // It starts out right at the max load so it's allowed to grow once, after that tombstones need to get rehashed away instead
+    CHECK(table.capacity <= capacity * 2);
+    CHECK((table.used + table.tombstones) * 4 <= table.capacity * 3);
+  }
+  else
+  {
+    CHECK(table.capacity == capacity);
+  }
+
+  for (u64 key = kLiveCount * 199; key < kLiveCount * 200; key++)
+  {
+    u64* value = hash_table_find(&table, key);
+    CHECK(value != nullptr && *value == key);
+  }
+  CHECK(hash_table_find(&table, kLiveCount * 199 - 1) == nullptr);
+
+  if (growable)
+  {
+    destroy_hash_table(&table);
+  }
+}
+
+// Rehashing in place on a nearly full table of colliding keys still has to put everything back where lookups can find it.
+static void
+test_rehash_in_place()
+{
+  HashTable<u64, TestValue> table = init_growable_hash_table<u64, TestValue>(GLOBAL_HEAP, 500);
+
+  TestRng rng;
+  for (u32 round = 0; round < 50; round++)
+  {
+    for (u64 key = 0; key < 600; key++)
+    {
+      TestValue* value = hash_table_insert(&table, round * 1000 + key);
+      value->key       = round * 1000 + key;
+      value->payload   = test_rng_next(&rng);
+    }
+
+    hash_table_rehash_in_place(&table);
+    CHECK(table.tombstones == 0);
+
+    for (u64 key = 0; key < 600; key++)
+    {
+      TestValue* value = hash_table_find(&table, round * 1000 + key);
+      CHECK(value != nullptr && value->key == round * 1000 + key);
+      CHECK(hash_table_erase(&table, round * 1000 + key));
+    }
+    CHECK(table.used == 0);
+  }
+
+  destroy_hash_table(&table);
+}
+
+// Inserts until the table is partway through an incremental grow, then does whatever grow_again does before that
+// migration is done. Nothing that was still sitting in the old arrays can get lost.
+template <typename F>
+static void
+check_grow_while_migrating(F grow_again)
+{
+  HashTable<u64, TestValue> table = init_growable_hash_table<u64, TestValue>(GLOBAL_HEAP);
+
+  u64 count = 0;
+  while (table.old_groups == nullptr || table.migrate_group == 0 || count < 100)
+  {
+    TestValue* value = hash_table_insert(&table, count);
+    value->key       = count;
+    value->payload   = count * 7;
+    count++;
+  }
+  REQUIRE(table.old_groups != nullptr && table.migrate_group > 0 && table.migrate_group < table.old_groups_size);
+
+  grow_again(&table);
+  CHECK(table.used == count);
+
+  u64 missing = 0;
+  for (u64 key = 0; key < count; key++)
+  {
+    TestValue* value = hash_table_find(&table, key);
+    missing += value == nullptr || value->key != key || value->payload != key * 7 ? 1 : 0;
+  }
+  CHECK_MSG(missing == 0, "lost %llu of %llu keys", (unsigned long long)missing, (unsigned long long)count);
+
+  destroy_hash_table(&table);
+}
+
+static void
+test_grow_while_migrating()
+{
+  check_grow_while_migrating([](HashTable<u64, TestValue>* table) { hash_table_reserve(table, table->capacity * 4); });
+  check_grow_while_migrating([](HashTable<u64, TestValue>* table) { hash_table_begin_grow(table, table->capacity * 2); });
+}
+
+// The AVX2 and SSE paths have to agree with a plain byte compare for every control byte pattern.
+static void
+test_group_matching()
+{
+  alignas(32) u8 ctrls[kHashTableGroupWidth];
+  static const u8 kBytes[] = { kHashTableCtrlEmpty, kHashTableCtrlDeleted, 0x00, 0x13, 0x7F };
+
+  TestRng rng;
+  for (u32 iteration = 0; iteration < 10000; iteration++)
+  {
+    for (u32 i = 0; i < kHashTableGroupWidth; i++)
+    {
+      ctrls[i] = kBytes[test_rng_range(&rng, ARRAY_LENGTH(kBytes))];
+    }
+
+    u8  byte          = kBytes[test_rng_range(&rng, ARRAY_LENGTH(kBytes))];
+    u32 expected      = 0;
+    u32 expected_free = 0;
+    for (u32 i = 0; i < kHashTableGroupWidth; i++)
+    {
+      expected      |= (u32)(ctrls[i] == byte) << i;
+      expected_free |= (u32)((ctrls[i] & 0x80) != 0) << i;
+    }
+
+    CHECK(hash_table_match_byte(ctrls, byte) == expected);
+    CHECK(hash_table_match_empty_or_deleted(ctrls) == expected_free);
+  }
+}
+
+// C string keys looked up by content, both with another C string and with a Span<char> into a bigger buffer.
+static void
+test_heterogeneous_lookup()
+{
+  static const char* kNames[] = { "albedo", "normal", "roughness", "metalness", "ao", "emissive", "height" };
+
+  HashTable<const char*, u32, CStrHashTraits> table = init_growable_hash_table<const char*, u32, CStrHashTraits>(GLOBAL_HEAP);
+  for (u32 i = 0; i < ARRAY_LENGTH(kNames); i++)
+  {
+    *hash_table_insert(&table, kNames[i]) = i;
+  }
+
+  // A different pointer with the same contents has to find the same entry
+  char copy[32];
+  for (u32 i = 0; i < ARRAY_LENGTH(kNames); i++)
+  {
+    strcpy(copy, kNames[i]);
+    u32* value = hash_table_find(&table, (const char*)copy);
+    CHECK(value != nullptr && *value == i);
+  }
+
+  const char* path = "materials/roughness_map";
+  u32* roughness = hash_table_find(&table, Span<char>(path + 10, 9));
+  CHECK(roughness != nullptr && *roughness == 2);
+
+  // Prefixes of a key are different keys
+  CHECK(hash_table_find(&table, Span<char>(path + 10, 5)) == nullptr);
+  CHECK(hash_table_find(&table, Span<char>("albedos", 7)) == nullptr);
+
+  CHECK(hash_table_erase(&table, Span<char>("ao", 2)));
+  CHECK(hash_table_find(&table, "ao") == nullptr);
+  CHECK(table.used == ARRAY_LENGTH(kNames) - 1);
+
+  destroy_hash_table(&table);
+}
+
+int
+main()
+{
+  test_group_matching();
+  test_heterogeneous_lookup();
+  test_growable_insert_erase();
+  test_growth_factor();
+  test_churn(true);
+  test_churn(false);
+  test_rehash_in_place();
+  test_grow_while_migrating();
+
+  return finish_test("hash_table_test");
+}
@@ -0,0 +1,167 @@
+#include "Tests/job_test.h"
+#include "Tests/bench.h"
+
+#include "Core/Foundation/context.h"
+
+#include <unistd.h>
+
+// Jobs per second as the number of workers goes up:
+//
+//   empty      waves of empty jobs kicked from inside a job, so they go through the kicking worker's deque
+//   main       the same waves kicked from the main thread, which go through the injection queue
+//   tree       every job kicks 8 children and waits on them, so fibers get parked and resumed all the time
+//   work       jobs that each do a few hundred ns of math, which is where more workers should actually help
+//
+//   job_system_bench [jobs] [max workers]
+
+static constexpr u32 kWaveSize   = 2048;
+static constexpr u32 kMaxJobs    = kWaveSize * 4;
+static constexpr u32 kTreeFanOut = 8;
+static constexpr u32 kWorkRounds = 256;
+
+enum JobBench : u8
+{
+  kJobBenchEmpty,
+  kJobBenchMain,
+  kJobBenchTree,
+  kJobBenchWork,
+
+  kJobBenchCount,
+};
+
+static const char* kJobBenchNames[] = {"empty", "main", "tree", "work"};
+
+static u64 g_WorkSink = 0;
+
+static void
+do_job_work(u64 seed)
+{
+  u64 x = seed | 1;
+  for (u32 i = 0; i < kWorkRounds; i++)
+  {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+  }
+  atomic_ref_fetch_add(&g_WorkSink, x, std::memory_order_relaxed);
+}
+
+static void
+kick_job_waves(u32 job_count, bool work)
+{
+  JobDesc* jobs = (JobDesc*)malloc(sizeof(JobDesc) * kWaveSize);
+  for (u32 first = 0; first < job_count; first += kWaveSize)
+  {
+    u32 count = MIN(kWaveSize, job_count - first);
+    for (u32 i = 0; i < count; i++)
+    {
+      u64 seed = first + i;
+      jobs[i]  = work ? init_job_desc_from_closure([seed]() { do_job_work(seed); }) : init_job_desc_from_closure([]() {});
+    }
+
+    JobHandle counter = kick_job_descs(kJobPriorityMedium, jobs, count);
+    yield_to_counter(counter);
+  }
+  free(jobs);
+}
+
+static void
+run_tree_job(u32 depth)
+{
+  if (depth == 0)
+  {
+    return;
+  }
+
+  JobDesc children[kTreeFanOut];
+  for (u32 ichild = 0; ichild < kTreeFanOut; ichild++)
+  {
+    children[ichild] = init_job_desc_from_closure([=]() { run_tree_job(depth - 1); });
+  }
+  JobHandle counter = kick_job_descs(kJobPriorityHigh, children, kTreeFanOut);
+  yield_to_counter(counter);
+}
+
+// The deepest tree that has at most job_count jobs below the root
+static u32
+get_tree_depth(u32 job_count)
+{
+  u32 ret  = 1;
+  u32 jobs = kTreeFanOut;
+  while (jobs * kTreeFanOut <= job_count)
+  {
+    jobs *= kTreeFanOut;
+    ret++;
+  }
+  return ret;
+}
+
+// Counting the root
+static u32
+get_tree_job_count(u32 depth)
+{
+  u32 ret   = 1;
+  u32 level = 1;
+  for (u32 i = 0; i < depth; i++)
+  {
+    level *= kTreeFanOut;
+    ret   += level;
+  }
+  return ret;
+}
+
+// Returns millions of jobs per second
+static f64
+run_job_bench(JobBench bench, u32 job_count)
+{
+  u64 start = get_bench_time_ns();
+  u32 ran   = job_count;
+  switch (bench)
+  {
+    case kJobBenchEmpty: blocking_kick_job(kJobPriorityHigh, kick_job_waves(job_count, false)); break;
+    case kJobBenchMain:  kick_job_waves(job_count, false); break;
+    case kJobBenchWork:  blocking_kick_job(kJobPriorityHigh, kick_job_waves(job_count, true)); break;
+    case kJobBenchTree:
+    {
+      u32 depth = get_tree_depth(job_count);
+      ran       = get_tree_job_count(depth);
+      blocking_kick_job(kJobPriorityHigh, run_tree_job(depth));
+    } break;
+    default: UNREACHABLE;
+  }
+
+  return (f64)ran * 1000.0 / (f64)(get_bench_time_ns() - start);
+}
+
+int
+main(int argc, char** argv)
+{
+  init_thread_context();
+
+  u32 job_count   = (u32)get_bench_arg(argc, argv, 1, 200000);
+  u32 max_workers = (u32)get_bench_arg(argc, argv, 2, MAX((u64)sysconf(_SC_NPROCESSORS_ONLN), 4ULL));
+
+  printf("%u jobs, Mjobs/s, work jobs do %u rounds of xorshift each\n\n", job_count, kWorkRounds);
+  printf("%8s", "workers");
+  for (u32 bench = 0; bench < kJobBenchCount; bench++)
+  {
+    printf(" %10s", kJobBenchNames[bench]);
+  }
+  printf("\n");
+
+  for (u32 worker_count = 1; worker_count <= max_workers; worker_count *= 2)
+  {
+    TestJobSystem jobs = init_test_job_system(worker_count, kMaxJobs);
+
+    printf("%8u", worker_count);
+    for (u32 bench = 0; bench < kJobBenchCount; bench++)
+    {
+      printf(" %10.2f", run_job_bench((JobBench)bench, job_count));
+    }
+    printf("\n");
+
+    destroy_test_job_system(&jobs);
+  }
+
+  return 0;
+}
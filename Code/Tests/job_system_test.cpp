@@ -0,0 +1,212 @@
+#include "Tests/job_test.h"
+
+#include "Core/Foundation/context.h"
+
+static constexpr u32 kWorkerCount = 4;
+
+// Spins (politely) until *value == expected, false if that didn't happen within a couple of seconds
+static bool
+wait_for_value(const u32* value, u32 expected)
+{
+  u64 deadline = get_test_time_ms() + 5000;
+  while (atomic_ref_load(value) != expected)
+  {
+    if (get_test_time_ms() > deadline)
+    {
+      return false;
+    }
+    yield_current_thread();
+  }
+  return true;
+}
+
+static constexpr u32 kFanOut = 8;
+
+// How many times every job in the tree ran, indexed by its position in the tree
+static u32 g_TreeRuns[1 + kFanOut + kFanOut * kFanOut + kFanOut * kFanOut * kFanOut];
+static u32 g_TreeFailures = 0;
+
+// Every job below the leaves kicks kFanOut children and waits on them, so there are always plenty of jobs parked on
+// fibers waiting for a counter while their children get stolen around the workers.
+static void
+run_tree_job(u32 index, u32 depth)
+{
+  if (depth < 3)
+  {
+    JobDesc children[kFanOut];
+    for (u32 ichild = 0; ichild < kFanOut; ichild++)
+    {
+      u32 child   = index * kFanOut + 1 + ichild;
+      children[ichild] = init_job_desc_from_closure([=]() { run_tree_job(child, depth + 1); });
+    }
+
+    JobPriority priority = (JobPriority)(index % kJobPriorityCount);
+    JobHandle   counter  = kick_job_descs(priority, children, kFanOut);
+    yield_to_counter(counter);
+
+    // Everything the children did has to be visible once the counter completes
+    for (u32 ichild = 0; ichild < kFanOut; ichild++)
+    {
+      if (atomic_ref_load(&g_TreeRuns[index * kFanOut + 1 + ichild], std::memory_order_relaxed) != 1)
+      {
+        atomic_ref_fetch_add(&g_TreeFailures, 1U);
+      }
+    }
+  }
+
+  atomic_ref_fetch_add(&g_TreeRuns[index], 1U, std::memory_order_relaxed);
+}
+
+static void
+test_nested_jobs()
+{
+  for (u32 round = 0; round < 20; round++)
+  {
+    zero_memory(g_TreeRuns, sizeof(g_TreeRuns));
+    blocking_kick_job(kJobPriorityHigh, run_tree_job(0, 0));
+
+    for (u32 i = 0; i < ARRAY_LENGTH(g_TreeRuns); i++)
+    {
+      CHECK_MSG(g_TreeRuns[i] == 1, "round %u: job %u ran %u times", round, i, g_TreeRuns[i]);
+    }
+  }
+  CHECK(g_TreeFailures == 0);
+}
+
+static constexpr u32 kFloodJobCount = kJobDequeSize * 3;
+
+static u32 g_FloodRuns[kFloodJobCount];
+
+static void
+flood_jobs()
+{
+  JobDesc* jobs = (JobDesc*)malloc(sizeof(JobDesc) * kFloodJobCount);
+  for (u32 i = 0; i < kFloodJobCount; i++)
+  {
+    jobs[i] = init_job_desc_from_closure([i]() { atomic_ref_fetch_add(&g_FloodRuns[i], 1U, std::memory_order_relaxed); });
+  }
+
+  JobHandle counter = kick_job_descs(kJobPriorityMedium, jobs, kFloodJobCount);
+  free(jobs);
+  yield_to_counter(counter);
+}
+
+// More jobs than fit in a worker's deque, so some of them go through the injection queue. From the main thread
+// everything goes through the injection queue.
+static void
+test_deque_overflow()
+{
+  zero_memory(g_FloodRuns, sizeof(g_FloodRuns));
+  blocking_kick_job(kJobPriorityHigh, flood_jobs());
+  for (u32 i = 0; i < kFloodJobCount; i++)
+  {
+    CHECK_MSG(g_FloodRuns[i] == 1, "job %u ran %u times", i, g_FloodRuns[i]);
+  }
+
+  zero_memory(g_FloodRuns, sizeof(g_FloodRuns));
+  flood_jobs();
+  for (u32 i = 0; i < kFloodJobCount; i++)
+  {
+    CHECK_MSG(g_FloodRuns[i] == 1, "job %u ran %u times", i, g_FloodRuns[i]);
+  }
+}
+
+static u32 g_WaitersStarted = 0;
+static u32 g_WaitersResumed = 0;
+
+// The main thread completing a counter that jobs are waiting on has to wake up a worker for every one of them. It
+// doesn't run jobs itself, so there's nobody else to pick them up if the workers are all asleep.
+static void
+test_main_thread_wakes_waiters(JobSystem* job_system)
+{
+  static constexpr u32 kWaiterCounts[] = {1, 2, 3, 1};
+
+  for (u32 round = 0; round < 40; round++)
+  {
+    u32 waiter_count = kWaiterCounts[round % ARRAY_LENGTH(kWaiterCounts)];
+    atomic_ref_store(&g_WaitersStarted, 0U);
+    atomic_ref_store(&g_WaitersResumed, 0U);
+
+    JobHandle gate    = init_job_counter(1);
+    JobHandle waiters = 0;
+    for (u32 iwaiter = 0; iwaiter < waiter_count; iwaiter++)
+    {
+      JobHandle waiter = kick_closure_job(kJobPriorityHigh, [=]()
+      {
+        atomic_ref_fetch_add(&g_WaitersStarted, 1U);
+        yield_to_counter(gate);
+        atomic_ref_fetch_add(&g_WaitersResumed, 1U);
+      });
+
+      // Only ever waiting on the last one so the handles don't get held onto
+      waiters = waiter;
+    }
+
+    // Let every worker go to sleep with the waiters parked on the gate
+    REQUIRE(wait_for_value(&g_WaitersStarted, waiter_count));
+    REQUIRE(wait_for_value(&job_system->sleepers, job_system->worker_count));
+
+    release_job_counter(gate);
+    CHECK_MSG(wait_for_value(&g_WaitersResumed, waiter_count), "round %u: only %u of %u waiters got woken up", round, g_WaitersResumed, waiter_count);
+
+    yield_to_counter(waiters);
+  }
+}
+
+// Whoever's using a per-worker slot right now, 0 if nobody is
+static u32 g_SlotOwners[kWorkerCount + 1];
+static u32 g_SlotCollisions = 0;
+
+// parallel_for ranges keep per-worker data in get_job_worker_index's slot, no two ranges can ever run on one at once
+static void
+test_worker_index()
+{
+  CHECK(get_job_worker_index() == kWorkerCount);
+
+  auto use_slot = [](u64 range_begin, u64)
+  {
+    u32 slot = get_job_worker_index();
+    REQUIRE(slot <= kWorkerCount);
+
+    u32 owner = (u32)range_begin + 1;
+    if (atomic_ref_exchange(&g_SlotOwners[slot], owner) != 0)
+    {
+      atomic_ref_fetch_add(&g_SlotCollisions, 1U);
+    }
+
+    for (u32 i = 0; i < 200; i++)
+    {
+      if (atomic_ref_load(&g_SlotOwners[slot], std::memory_order_relaxed) != owner)
+      {
+        atomic_ref_fetch_add(&g_SlotCollisions, 1U);
+        break;
+      }
+      if ((i & 31) == 0)
+      {
+        yield_current_thread();
+      }
+    }
+
+    atomic_ref_store(&g_SlotOwners[slot], 0U);
+  };
+  parallel_for(0, 20000, 1, use_slot);
+
+  CHECK(g_SlotCollisions == 0);
+}
+
+int
+main()
+{
+  init_thread_context();
+
+  TestJobSystem jobs = init_test_job_system(kWorkerCount);
+
+  test_nested_jobs();
+  test_deque_overflow();
+  test_main_thread_wakes_waiters(jobs.job_system);
+  test_worker_index();
+
+  destroy_test_job_system(&jobs);
+
+  return finish_test("job_system_test");
+}
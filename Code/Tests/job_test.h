@@ -0,0 +1,40 @@
+#pragma once
+#include "Tests/test.h"
+
+#include "Core/Engine/job_system.h"
+
+// A job system with worker_count workers that are all allowed on every cpu the process is.
+
+struct TestJobSystem
+{
+  JobSystem*    job_system = nullptr;
+  Array<Thread> workers;
+};
+
+inline TestJobSystem
+init_test_job_system(u32 worker_count, u32 max_jobs = 4096, u32 fiber_count = 256)
+{
+  ThreadPlacement placement;
+  placement.job_workers = init_array<CpuSet>((AllocHeap)GLOBAL_HEAP, 1);
+  *array_add(&placement.job_workers) = get_test_cpus();
+
+  TestJobSystem ret;
+  ret.job_system = init_job_system((AllocHeap)GLOBAL_HEAP, max_jobs, fiber_count, worker_count);
+  ret.workers    = spawn_job_system_workers((AllocHeap)GLOBAL_HEAP, ret.job_system, placement);
+
+  return ret;
+}
+
+inline void
+destroy_test_job_system(TestJobSystem* test_job_system)
+{
+  kill_job_system(test_job_system->job_system);
+  join_threads(test_job_system->workers.memory, (u32)test_job_system->workers.size);
+  for (Thread& thread : test_job_system->workers)
+  {
+    destroy_thread(&thread);
+  }
+
+  destroy_job_system(test_job_system->job_system);
+  test_job_system->job_system = nullptr;
+}
@@ -0,0 +1,221 @@
+#include "Tests/bench.h"
+
+#include "Core/Foundation/Containers/mpmc_ring_queue.h"
+
+// Throughput and push-to-pop latency of the queue for a few producer/consumer counts, pushing and popping one at a
+// time, in batches, and with the consumers blocking in pop_wait instead of polling.
+//
+//   mpmc_ring_queue_bench [values per producer]
+
+static constexpr u32 kMaxThreads = 8;
+static constexpr u64 kCapacity   = 1024;
+static constexpr u64 kBatchSize  = 16;
+
+enum QueueBenchMode : u8
+{
+  kQueueBenchSingle,
+  kQueueBenchBatch,
+  kQueueBenchWait,
+};
+
+static const char* kQueueBenchModeNames[] = {"single", "batch", "wait"};
+
+struct QueueBenchCounts
+{
+  u32 producers = 0;
+  u32 consumers = 0;
+};
+
+static constexpr QueueBenchCounts kQueueBenchCounts[] = {{1, 1}, {1, 4}, {4, 1}, {2, 2}, {4, 4}, {8, 8}};
+
+struct QueueBench
+{
+  MpmcRingQueue<u64> queue;
+  QueueBenchMode     mode                = kQueueBenchSingle;
+  u64                values_per_producer = 0;
+  // Accessed atomically
+  u32                producers_done      = 0;
+  u32                go                  = 0;
+};
+
+struct QueueBenchThread
+{
+  QueueBench* bench   = nullptr;
+  // Consumers only, how long every value they popped sat in the queue
+  u64*        latency = nullptr;
+  u64         popped  = 0;
+};
+
+static void
+wait_for_go(QueueBench* bench)
+{
+  while (atomic_ref_load(&bench->go) == 0)
+  {
+    yield_current_thread();
+  }
+}
+
+// Values are the time they got pushed at, so the consumer can tell how long they waited
+static u32
+producer_proc(void* param)
+{
+  QueueBench* bench = ((QueueBenchThread*)param)->bench;
+  wait_for_go(bench);
+
+  u64 values[kBatchSize];
+  for (u64 i = 0; i < bench->values_per_producer;)
+  {
+    u64 pushed = 0;
+    if (bench->mode == kQueueBenchBatch)
+    {
+      u64 count = MIN(kBatchSize, bench->values_per_producer - i);
+      u64 now   = get_bench_time_ns();
+      for (u64 k = 0; k < count; k++)
+      {
+        values[k] = now;
+      }
+      pushed = mpmc_ring_queue_push_batch(&bench->queue, values, count);
+    }
+    else
+    {
+      pushed = try_mpmc_ring_queue_push(&bench->queue, get_bench_time_ns()) ? 1 : 0;
+    }
+
+    if (pushed == 0)
+    {
+      yield_current_thread();
+    }
+    i += pushed;
+  }
+
+  return 0;
+}
+
+static u32
+consumer_proc(void* param)
+{
+  auto*       thread = (QueueBenchThread*)param;
+  QueueBench* bench  = thread->bench;
+  wait_for_go(bench);
+
+  u64 values[kBatchSize];
+  for (;;)
+  {
+    u64 popped = 0;
+    if (bench->mode == kQueueBenchWait)
+    {
+      // Only returns false once everything's been pushed and popped
+      if (!mpmc_ring_queue_pop_wait(&bench->queue, values))
+      {
+        break;
+      }
+      popped = 1;
+    }
+    else
+    {
+      // Has to be read before trying to pop, otherwise the last values could get pushed in between
+      bool done = atomic_ref_load(&bench->producers_done) != 0;
+      popped    = bench->mode == kQueueBenchBatch ? mpmc_ring_queue_pop_batch(&bench->queue, values, kBatchSize) : (try_mpmc_ring_queue_pop(&bench->queue, values) ? 1 : 0);
+      if (popped == 0)
+      {
+        if (done)
+        {
+          break;
+        }
+        yield_current_thread();
+      }
+    }
+
+    u64 now = get_bench_time_ns();
+    for (u64 i = 0; i < popped; i++)
+    {
+      thread->latency[thread->popped++] = now - values[i];
+    }
+  }
+
+  return 0;
+}
+
+static void
+bench_queue(QueueBenchMode mode, u32 producer_count, u32 consumer_count, u64 values_per_producer)
+{
+  QueueBench bench;
+  bench.queue               = init_mpmc_ring_queue<u64>((AllocHeap)GLOBAL_HEAP, kCapacity);
+  bench.mode                = mode;
+  bench.values_per_producer = values_per_producer;
+
+  u64 total = values_per_producer * producer_count;
+
+  Thread           producers[kMaxThreads];
+  Thread           consumers[kMaxThreads];
+  QueueBenchThread params   [kMaxThreads * 2];
+  for (u32 i = 0; i < producer_count; i++)
+  {
+    params[i].bench = &bench;
+    producers[i]    = init_test_thread(&producer_proc, &params[i]);
+  }
+  for (u32 i = 0; i < consumer_count; i++)
+  {
+    QueueBenchThread* consumer = &params[kMaxThreads + i];
+    consumer->bench            = &bench;
+    // Any one consumer could end up with all of it
+    consumer->latency          = HEAP_ALLOC(u64, GLOBAL_HEAP, total);
+    consumers[i]               = init_test_thread(&consumer_proc, consumer);
+  }
+
+  u64 start = get_bench_time_ns();
+  atomic_ref_store(&bench.go, 1U);
+  join_threads(producers, producer_count);
+  atomic_ref_store(&bench.producers_done, 1U);
+  mpmc_ring_queue_wake_all(&bench.queue);
+  join_threads(consumers, consumer_count);
+  u64 elapsed = get_bench_time_ns() - start;
+
+  // Everything in one array for the percentiles
+  u64* latency = HEAP_ALLOC(u64, GLOBAL_HEAP, total);
+  u64  popped  = 0;
+  for (u32 i = 0; i < producer_count; i++)
+  {
+    destroy_thread(&producers[i]);
+  }
+  for (u32 i = 0; i < consumer_count; i++)
+  {
+    QueueBenchThread* consumer = &params[kMaxThreads + i];
+    destroy_thread(&consumers[i]);
+    memcpy(latency + popped, consumer->latency, consumer->popped * sizeof(u64));
+    popped += consumer->popped;
+    HEAP_FREE(GLOBAL_HEAP, consumer->latency);
+  }
+  ASSERT_MSG_FATAL(popped == total, "Popped %llu values but pushed %llu!", (unsigned long long)popped, (unsigned long long)total);
+
+  u64 p50 = get_bench_percentile(latency, total, 50.0);
+  u64 p99 = get_bench_percentile(latency, total, 99.0);
+  printf("%-8s %4u x %-4u %12.2f %12.2f %12.2f\n",
+         kQueueBenchModeNames[mode],
+         producer_count,
+         consumer_count,
+         (f64)total * 1000.0 / (f64)elapsed,
+         (f64)p50 / 1000.0,
+         (f64)p99 / 1000.0);
+
+  HEAP_FREE(GLOBAL_HEAP, latency);
+  HEAP_FREE(GLOBAL_HEAP, bench.queue.slots);
+}
+
+int
+main(int argc, char** argv)
+{
+  u64 values = get_bench_arg(argc, argv, 1, 100000);
+
+  printf("%llu values per producer, %llu slots, latency is push to pop\n\n", (unsigned long long)values, (unsigned long long)kCapacity);
+  printf("%-8s %11s %12s %12s %12s\n", "mode", "prod x cons", "Mvalues/s", "p50 us", "p99 us");
+  for (u32 mode = kQueueBenchSingle; mode <= kQueueBenchWait; mode++)
+  {
+    for (QueueBenchCounts counts : kQueueBenchCounts)
+    {
+      bench_queue((QueueBenchMode)mode, counts.producers, counts.consumers, values);
+    }
+  }
+
+  return 0;
+}
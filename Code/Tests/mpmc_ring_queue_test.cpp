@@ -0,0 +1,251 @@
+#include "Tests/test.h"
+
+#include "Core/Foundation/Containers/mpmc_ring_queue.h"
+
+// Producers push (producer << 32 | index) and consumers check that every value shows up exactly once and that each producer's values come out
+// in order from the point of view of any one consumer.
+
+static constexpr u64 kValuesPerProducer = 100000;
+static constexpr u32 kMaxThreads        = 4;
+
+enum QueueTestMode : u8
+{
+  kQueueTestSingle,
+  kQueueTestBatch,
+  kQueueTestWait,
+};
+
+struct QueueTest
+{
+  MpmcRingQueue<u64> queue;
+  QueueTestMode      mode           = kQueueTestSingle;
+  u32                producer_count = 0;
+  u64                popped         = 0;
+  u64                sum            = 0;
+  u32                order_errors   = 0;
+};
+
+struct QueueThreadParams
+{
+  QueueTest* test  = nullptr;
+  u32        index = 0;
+};
+
+static u32
+queue_producer_proc(void* param)
+{
+  auto*      params = (QueueThreadParams*)param;
+  QueueTest* test   = params->test;
+
+  u64 values[7];
+  for (u64 i = 0; i < kValuesPerProducer;)
+  {
+    if (test->mode == kQueueTestBatch)
+    {
+      u64 count = MIN((u64)ARRAY_LENGTH(values), kValuesPerProducer - i);
+      for (u64 k = 0; k < count; k++)
+      {
+        values[k] = (u64)params->index << 32 | (i + k);
+      }
+      u64 pushed = mpmc_ring_queue_push_batch(&test->queue, values, count);
+      if (pushed == 0)
+      {
+        yield_current_thread();
+      }
+      i += pushed;
+    }
+    else if (try_mpmc_ring_queue_push(&test->queue, (u64)params->index << 32 | i))
+    {
+      i++;
+    }
+    else
+    {
+      // Full. Spinning without yielding takes forever on machines with fewer cores than threads.
+      yield_current_thread();
+    }
+  }
+
+  return 0;
+}
+
+static u32
+queue_consumer_proc(void* param)
+{
+  auto*      params = (QueueThreadParams*)param;
+  QueueTest* test   = params->test;
+
+  u64 last[kMaxThreads];
+  for (u32 i = 0; i < kMaxThreads; i++)
+  {
+    last[i] = U64_MAX;
+  }
+
+  u64 total = (u64)test->producer_count * kValuesPerProducer;
+  u64 values[5];
+  for (;;)
+  {
+    u64 count = 0;
+    if (test->mode == kQueueTestBatch)
+    {
+      count = mpmc_ring_queue_pop_batch(&test->queue, values, ARRAY_LENGTH(values));
+    }
+    else if (test->mode == kQueueTestWait)
+    {
+      // Only returns false once the main thread has seen everything popped and woken us up
+      if (!mpmc_ring_queue_pop_wait(&test->queue, values))
+      {
+        break;
+      }
+      count = 1;
+    }
+    else
+    {
+      count = try_mpmc_ring_queue_pop(&test->queue, values) ? 1 : 0;
+    }
+
+    for (u64 k = 0; k < count; k++)
+    {
+      u32 producer = (u32)(values[k] >> 32);
+      u64 index    = values[k] & U32_MAX;
+      if (producer >= kMaxThreads || (last[producer] != U64_MAX && index <= last[producer]))
+      {
+        atomic_ref_fetch_add(&test->order_errors, 1U);
+        continue;
+      }
+      last[producer] = index;
+      atomic_ref_fetch_add(&test->sum, index);
+    }
+
+    atomic_ref_fetch_add(&test->popped, count);
+    if (test->mode == kQueueTestWait)
+    {
+      continue;
+    }
+
+    if (atomic_ref_load(&test->popped) >= total)
+    {
+      break;
+    }
+    if (count == 0)
+    {
+      yield_current_thread();
+    }
+  }
+
+  return 0;
+}
+
+static void
+run_queue_test(u32 producer_count, u32 consumer_count, QueueTestMode mode)
+{
+  static QueueTest test;
+  test                = QueueTest();
+  test.queue          = init_mpmc_ring_queue<u64>((AllocHeap)GLOBAL_HEAP, 100);
+  test.mode           = mode;
+  test.producer_count = producer_count;
+
+  Thread            threads[kMaxThreads * 2];
+  QueueThreadParams params [kMaxThreads * 2];
+  u32               thread_count = 0;
+  for (u32 i = 0; i < producer_count; i++, thread_count++)
+  {
+    params[thread_count]  = QueueThreadParams{&test, i};
+    threads[thread_count] = init_test_thread(&queue_producer_proc, &params[thread_count]);
+  }
+  for (u32 i = 0; i < consumer_count; i++, thread_count++)
+  {
+    params[thread_count]  = QueueThreadParams{&test, i};
+    threads[thread_count] = init_test_thread(&queue_consumer_proc, &params[thread_count]);
+  }
+
+  u64 total = (u64)producer_count * kValuesPerProducer;
+  if (mode == kQueueTestWait)
+  {
+    // The consumers are blocked in pop_wait by the time this goes through (or about to be), it has to get every one of them out.
+    while (atomic_ref_load(&test.popped) < total)
+    {
+      yield_current_thread();
+    }
+    mpmc_ring_queue_wake_all(&test.queue);
+  }
+
+  join_threads(threads, thread_count);
+  for (u32 i = 0; i < thread_count; i++)
+  {
+    destroy_thread(&threads[i]);
+  }
+
+  CHECK_MSG(test.order_errors == 0, "P%u C%u mode %u: %u values out of order", producer_count, consumer_count, mode, test.order_errors);
+  CHECK_MSG(test.popped == total, "P%u C%u mode %u: popped %llu of %llu", producer_count, consumer_count, mode, (unsigned long long)test.popped, (unsigned long long)total);
+  CHECK(test.sum == producer_count * (kValuesPerProducer * (kValuesPerProducer - 1) / 2));
+  CHECK(mpmc_ring_queue_is_empty(&test.queue));
+
+  HEAP_FREE(GLOBAL_HEAP, test.queue.slots);
+}
+
+// wake_all has to get out consumers that are already asleep, and it has to stick for consumers that only block afterwards.
+static void
+test_wake_all_shutdown()
+{
+  static MpmcRingQueue<u64> queue;
+  queue = init_mpmc_ring_queue<u64>((AllocHeap)GLOBAL_HEAP, 16);
+
+  auto consumer = [](void* param) -> u32
+  {
+    u64 value = 0;
+    u32 count = 0;
+    while (mpmc_ring_queue_pop_wait((MpmcRingQueue<u64>*)param, &value))
+    {
+      count++;
+    }
+    return count;
+  };
+
+  Thread threads[kMaxThreads];
+  for (u32 i = 0; i < kMaxThreads; i++)
+  {
+    threads[i] = init_test_thread(consumer, &queue);
+  }
+
+  for (u64 i = 0; i < 1000; i++)
+  {
+    while (!try_mpmc_ring_queue_push(&queue, i))
+    {
+      yield_current_thread();
+    }
+  }
+  mpmc_ring_queue_wake_all(&queue);
+
+  join_threads(threads, kMaxThreads);
+  for (u32 i = 0; i < kMaxThreads; i++)
+  {
+    destroy_thread(&threads[i]);
+  }
+  CHECK(mpmc_ring_queue_is_empty(&queue));
+
+  // Nothing left and already woken: doesn't block anymore
+  u64 value = 0;
+  CHECK(!mpmc_ring_queue_pop_wait(&queue, &value));
+  CHECK(!try_mpmc_ring_queue_pop_wait(&queue, &value, U32_MAX));
+
+  HEAP_FREE(GLOBAL_HEAP, queue.slots);
+}
+
+int
+main()
+{
+  static const u32 kCounts[] = { 1, 4 };
+  for (u32 producer_count : kCounts)
+  {
+    for (u32 consumer_count : kCounts)
+    {
+      run_queue_test(producer_count, consumer_count, kQueueTestSingle);
+      run_queue_test(producer_count, consumer_count, kQueueTestBatch);
+      run_queue_test(producer_count, consumer_count, kQueueTestWait);
+    }
+  }
+
+  test_wake_all_shutdown();
+
+  return finish_test("mpmc_ring_queue_test");
+}
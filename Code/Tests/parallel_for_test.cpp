@@ -0,0 +1,282 @@
+#include "Tests/job_test.h"
+
+#include "Core/Foundation/context.h"
+#include "Core/Foundation/sort.h"
+
+#include "Core/Engine/task_graph.h"
+
+static constexpr u32 kMaxVisitCount = 100000;
+
+static u32 g_Visits[kMaxVisitCount];
+static u32 g_BadRanges = 0;
+
+// Every index visited exactly once, and every range but the last one a multiple of grain
+static void
+check_parallel_for(u32 begin, u32 end, u32 grain)
+{
+  zero_memory(g_Visits, sizeof(g_Visits));
+  atomic_ref_store(&g_BadRanges, 0U);
+
+  auto visit = [=](u64 range_begin, u64 range_end)
+  {
+    bool aligned = (range_begin - begin) % grain == 0 && ((range_end - range_begin) % grain == 0 || range_end == end);
+    if (range_begin >= range_end || range_begin < begin || range_end > end || !aligned)
+    {
+      atomic_ref_fetch_add(&g_BadRanges, 1U);
+      return;
+    }
+
+    for (u64 i = range_begin; i < range_end; i++)
+    {
+      atomic_ref_fetch_add(&g_Visits[i], 1U, std::memory_order_relaxed);
+    }
+  };
+  parallel_for(begin, end, grain, visit);
+
+  CHECK_MSG(g_BadRanges == 0, "[%u, %u) grain %u: %u bad ranges", begin, end, grain, g_BadRanges);
+  for (u32 i = 0; i < kMaxVisitCount; i++)
+  {
+    u32 expected = i >= begin && i < end ? 1 : 0;
+    if (g_Visits[i] != expected)
+    {
+      CHECK_MSG(false, "[%u, %u) grain %u: index %u visited %u times", begin, end, grain, i, g_Visits[i]);
+      break;
+    }
+  }
+}
+
+static void
+test_parallel_for()
+{
+  static constexpr u32 kGrains[] = {1, 7, 64, 1000, 100000};
+  for (u32 grain : kGrains)
+  {
+    check_parallel_for(0, kMaxVisitCount, grain);
+    check_parallel_for(13, 20000, grain);
+    check_parallel_for(5, 6, grain);
+  }
+
+  // Nothing to do
+  check_parallel_for(10, 10, 4);
+
+  u64  sum     = 0;
+  auto sum_all = [&](u64 range_begin, u64 range_end)
+  {
+    u64 range_sum = 0;
+    for (u64 i = range_begin; i < range_end; i++)
+    {
+      range_sum += i;
+    }
+    atomic_ref_fetch_add(&sum, range_sum);
+  };
+  parallel_for(0, 1000000, 512, sum_all);
+  CHECK(sum == 999999ULL * 1000000ULL / 2);
+}
+
+static constexpr u32 kNestedJobs  = 8;
+static constexpr u32 kNestedCount = kMaxVisitCount / kNestedJobs;
+
+// parallel_for from inside of jobs, where the calling worker has to switch to other work while it waits
+static void
+test_nested_parallel_for()
+{
+  zero_memory(g_Visits, sizeof(g_Visits));
+
+  JobDesc jobs[kNestedJobs];
+  for (u32 ijob = 0; ijob < kNestedJobs; ijob++)
+  {
+    jobs[ijob] = init_job_desc_from_closure([ijob]()
+    {
+      auto visit = [ijob](u64 range_begin, u64 range_end)
+      {
+        for (u64 i = range_begin; i < range_end; i++)
+        {
+          atomic_ref_fetch_add(&g_Visits[ijob * kNestedCount + i], 1U, std::memory_order_relaxed);
+        }
+      };
+      parallel_for(0, kNestedCount, 97, visit);
+    });
+  }
+  yield_to_counter(kick_job_descs(kJobPriorityMedium, jobs, kNestedJobs));
+
+  for (u32 i = 0; i < kNestedJobs * kNestedCount; i++)
+  {
+    if (g_Visits[i] != 1)
+    {
+      CHECK_MSG(false, "index %u visited %u times", i, g_Visits[i]);
+      break;
+    }
+  }
+}
+
+static constexpr u32 kLayerCount  = 8;
+static constexpr u32 kLayerWidth  = 8;
+static constexpr u32 kChainLength = 32;
+static constexpr u32 kTaskCount   = kLayerCount * kLayerWidth + kChainLength;
+
+// When each task ran in the order of the launch (starting at 1), and how many times
+static u32 g_TaskOrder[kTaskCount];
+static u32 g_TaskRuns [kTaskCount];
+static u32 g_TaskSequence = 0;
+
+static void
+record_task(TaskId task)
+{
+  g_TaskOrder[task] = atomic_ref_fetch_add(&g_TaskSequence, 1U) + 1;
+  atomic_ref_fetch_add(&g_TaskRuns[task], 1U);
+}
+
+struct TestTaskGraph
+{
+  TaskGraph           graph;
+  TaskGraphDependency dependencies[kTaskCount * 3];
+  u32                 dependency_count = 0;
+};
+
+static void
+add_test_dependency(TaskGraphBuilder* builder, TestTaskGraph* test_graph, TaskId task, TaskId depends_on)
+{
+  task_graph_add_dependency(builder, task, depends_on);
+  test_graph->dependencies[test_graph->dependency_count++] = TaskGraphDependency{task, depends_on};
+}
+
+// An 8x8 layered DAG where every task depends on a few in the layer before it, and a chain hanging off of the middle
+// of it that runs inline as continuations
+static void
+init_test_task_graph(TestTaskGraph* test_graph)
+{
+  TaskGraphBuilder builder = init_task_graph_builder((AllocHeap)GLOBAL_HEAP, kTaskCount, ARRAY_LENGTH(test_graph->dependencies));
+  for (TaskId task = 0; task < kTaskCount; task++)
+  {
+    TaskId added = task_graph_add(&builder, (JobPriority)(task % kJobPriorityCount), record_task(task));
+    REQUIRE(added == task);
+  }
+
+  for (u32 ilayer = 1; ilayer < kLayerCount; ilayer++)
+  {
+    for (u32 i = 0; i < kLayerWidth; i++)
+    {
+      TaskId task = ilayer * kLayerWidth + i;
+      TaskId prev = (ilayer - 1) * kLayerWidth;
+      add_test_dependency(&builder, test_graph, task, prev + i);
+      add_test_dependency(&builder, test_graph, task, prev + (i + 1) % kLayerWidth);
+      if ((i * 3) % kLayerWidth != i && (i * 3) % kLayerWidth != (i + 1) % kLayerWidth)
+      {
+        add_test_dependency(&builder, test_graph, task, prev + (i * 3) % kLayerWidth);
+      }
+    }
+  }
+
+  TaskId chain = kLayerCount * kLayerWidth;
+  add_test_dependency(&builder, test_graph, chain, 3 * kLayerWidth + 2);
+  for (u32 i = 1; i < kChainLength; i++)
+  {
+    add_test_dependency(&builder, test_graph, chain + i, chain + i - 1);
+  }
+
+  test_graph->graph = compile_task_graph((AllocHeap)GLOBAL_HEAP, &builder);
+  CHECK(test_graph->graph.root_count == kLayerWidth);
+}
+
+static void
+check_task_graph_launch(const TestTaskGraph* test_graph, u32 launch)
+{
+  for (TaskId task = 0; task < kTaskCount; task++)
+  {
+    CHECK_MSG(g_TaskRuns[task] == 1, "launch %u: task %u ran %u times", launch, task, g_TaskRuns[task]);
+  }
+
+  for (u32 i = 0; i < test_graph->dependency_count; i++)
+  {
+    TaskGraphDependency dependency = test_graph->dependencies[i];
+    CHECK_MSG(g_TaskOrder[dependency.depends_on] < g_TaskOrder[dependency.task], "launch %u: task %u ran before task %u", launch, dependency.task, dependency.depends_on);
+  }
+
+  zero_memory(g_TaskRuns, sizeof(g_TaskRuns));
+}
+
+static void
+launch_and_wait(TaskGraph* graph)
+{
+  yield_to_counter(launch_task_graph(graph));
+}
+
+static void
+test_task_graph()
+{
+  static TestTaskGraph test_graph;
+  test_graph.dependency_count = 0;
+  init_test_task_graph(&test_graph);
+  zero_memory(g_TaskRuns, sizeof(g_TaskRuns));
+
+  for (u32 launch = 0; launch < 50; launch++)
+  {
+    launch_and_wait(&test_graph.graph);
+    check_task_graph_launch(&test_graph, launch);
+  }
+
+  // From inside of a job too
+  TaskGraph* graph = &test_graph.graph;
+  for (u32 launch = 0; launch < 10; launch++)
+  {
+    blocking_kick_job(kJobPriorityLow, launch_and_wait(graph));
+    check_task_graph_launch(&test_graph, launch);
+  }
+}
+
+struct SortElement
+{
+  u32 key;
+  u32 id;
+};
+
+// radix_sort's blocks going through parallel_for have to give the same (stable) result as running them in a row
+static void
+test_parallel_radix_sort()
+{
+  static constexpr u32 kCount = 1200000;
+
+  SortElement* elements = (SortElement*)malloc(sizeof(SortElement) * kCount);
+  TestRng      rng;
+  for (u32 i = 0; i < kCount; i++)
+  {
+    elements[i] = SortElement{(u32)test_rng_next(&rng) & 0xFFFFF, i};
+  }
+
+  ParallelDispatch dispatch = get_job_system_parallel_dispatch();
+  radix_sort(elements, kCount, sizeof(SortElement), offsetof(SortElement, key), kSortIncreasing, &dispatch);
+
+  for (u32 i = 1; i < kCount; i++)
+  {
+    bool ordered = elements[i - 1].key < elements[i].key || (elements[i - 1].key == elements[i].key && elements[i - 1].id < elements[i].id);
+    if (!ordered)
+    {
+      CHECK_MSG(false, "element %u is out of order", i);
+      break;
+    }
+  }
+
+  free(elements);
+}
+
+int
+main()
+{
+  init_thread_context();
+
+  // Oversubscribed on purpose when there are more workers than cores
+  static constexpr u32 kWorkerCounts[] = {1, 4, 16};
+  for (u32 worker_count : kWorkerCounts)
+  {
+    TestJobSystem jobs = init_test_job_system(worker_count);
+
+    test_parallel_for();
+    test_nested_parallel_for();
+    test_task_graph();
+    test_parallel_radix_sort();
+
+    destroy_test_job_system(&jobs);
+  }
+
+  return finish_test("parallel_for_test");
+}
@@ -0,0 +1,300 @@
+#include "Tests/test.h"
+
+#include "Core/Foundation/context.h"
+#include "Core/Foundation/pool_allocator.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+struct PoolObject
+{
+  u64 a;
+  u64 b;
+  u64 c;
+  u32 owner;
+};
+
+// Runs fn in a forked child, true if it crashed (the pool's fatal asserts trap)
+template <typename F>
+static bool
+dies(F fn)
+{
+  fflush(stdout);
+  fflush(stderr);
+
+  pid_t child = fork();
+  if (child == 0)
+  {
+    // The assert backtraces are expected, don't clutter the output with them
+    close(STDERR_FILENO);
+    fn();
+    _exit(0);
+  }
+
+  int status = 0;
+  waitpid(child, &status, 0);
+  return !(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+static int
+compare_pointers(const void* a, const void* b)
+{
+  uintptr_t lhs = *(const uintptr_t*)a;
+  uintptr_t rhs = *(const uintptr_t*)b;
+  return lhs < rhs ? -1 : lhs > rhs ? 1 : 0;
+}
+
+static void
+test_pool_free_count()
+{
+  Pool<PoolObject> pool = init_pool<PoolObject>((AllocHeap)GLOBAL_HEAP, 4);
+
+  PoolObject* objects[4];
+  for (PoolObject*& object : objects)
+  {
+    object = pool_alloc(&pool);
+  }
+  CHECK(pool.free_count == 0);
+
+  pool_free(&pool, objects[2]);
+  pool_free(&pool, objects[0]);
+  CHECK(pool.free_count == 2);
+
+  // Last freed comes back first
+  CHECK(pool_alloc(&pool) == objects[0]);
+  CHECK(pool_alloc(&pool) == objects[2]);
+
+  for (PoolObject* object : objects)
+  {
+    pool_free(&pool, object);
+  }
+  CHECK(pool.free_count == 4);
+
+  CHECK(dies([&]() { pool_free(&pool, objects[1]); }));
+}
+
+static void
+test_concurrent_pool_exhaustion()
+{
+  static constexpr u32 kBlockCount = 1000;
+
+  ConcurrentPoolAllocator allocator = init_concurrent_pool_allocator((AllocHeap)GLOBAL_HEAP, kBlockCount, 48, 16);
+  CHECK(allocator.block_size == 48);
+
+  void** blocks = (void**)malloc(sizeof(void*) * kBlockCount);
+  for (u32 i = 0; i < kBlockCount; i++)
+  {
+    blocks[i] = concurrent_pool_alloc(&allocator, 48, 16);
+    REQUIRE(blocks[i] != nullptr);
+    CHECK((uintptr_t)blocks[i] % 16 == 0);
+  }
+  CHECK(concurrent_pool_alloc(&allocator, 48, 16) == nullptr);
+
+  // Every block exactly once
+  qsort(blocks, kBlockCount, sizeof(void*), &compare_pointers);
+  for (u32 i = 1; i < kBlockCount; i++)
+  {
+    CHECK(blocks[i - 1] != blocks[i]);
+  }
+  CHECK(blocks[0] == allocator.memory);
+  CHECK((u8*)blocks[kBlockCount - 1] == allocator.memory + 48 * (kBlockCount - 1));
+
+  for (u32 i = 0; i < kBlockCount; i++)
+  {
+    concurrent_pool_free(&allocator, blocks[i]);
+  }
+  for (u32 i = 0; i < kBlockCount; i++)
+  {
+    CHECK(concurrent_pool_alloc(&allocator, 8, 8) != nullptr);
+  }
+  CHECK(concurrent_pool_alloc(&allocator, 8, 8) == nullptr);
+
+#if defined(DEBUG)
+  u8* freed = (u8*)blocks[5];
+  concurrent_pool_free(&allocator, freed);
+
+  CHECK(dies([&]() { concurrent_pool_free(&allocator, freed); }));
+  CHECK(dies([&]() { freed[7] = 1; (void)concurrent_pool_alloc(&allocator, 8, 8); }));
+  CHECK(dies([&]() { concurrent_pool_free(&allocator, (u8*)blocks[3] + 4); }));
+  CHECK(dies([&]() { u64 foreign = 0; concurrent_pool_free(&allocator, &foreign); }));
+
+  u8* again = (u8*)concurrent_pool_alloc(&allocator, 8, 8);
+  CHECK(again == freed);
+  CHECK(again[0] == kPoolAllocPoison);
+#endif
+
+  free(blocks);
+  destroy_concurrent_pool_allocator(&allocator);
+}
+
+static void
+test_concurrent_pool_typed()
+{
+  ConcurrentPool<PoolObject> pool   = init_concurrent_pool<PoolObject>((AllocHeap)GLOBAL_HEAP, 10);
+  PoolObject*                object = concurrent_pool_alloc(&pool);
+  CHECK(object->a == 0 && object->owner == 0);
+
+  object->a = 5;
+  concurrent_pool_free(&pool, object);
+  CHECK(concurrent_pool_alloc(&pool)->a == 0);
+
+  destroy_concurrent_pool(&pool);
+}
+
+static constexpr u32 kStressThreads    = 6;
+static constexpr u32 kStressBlocks     = 4096;
+static constexpr u32 kStressIterations = 100000;
+static constexpr u32 kMaxHeldBlocks    = 400;
+static constexpr u32 kMaxHandoffBlocks = kStressBlocks;
+
+struct PoolHandoff
+{
+  SpinLock    lock;
+  PoolObject* objects[kMaxHandoffBlocks];
+  u32         count = 0;
+};
+
+static ConcurrentPoolAllocator g_StressPool;
+// Which thread (+ 1) holds each block, catches the same block being handed out twice
+static u32                     g_StressOwners[kStressBlocks];
+static PoolHandoff             g_StressHandoffs[kStressThreads];
+static u32                     g_StressFailures = 0;
+
+static void
+release_stress_block(PoolObject* object)
+{
+  u32 block = (u32)(((u8*)object - g_StressPool.memory) / g_StressPool.block_size);
+  if (atomic_ref_exchange(&g_StressOwners[block], 0U) == 0)
+  {
+    atomic_ref_fetch_add(&g_StressFailures, 1U);
+  }
+  concurrent_pool_free(&g_StressPool, object);
+}
+
+static void
+release_handoff_blocks(u32 thread_index)
+{
+  PoolHandoff* handoff = &g_StressHandoffs[thread_index];
+  spin_acquire(&handoff->lock);
+  for (u32 i = 0; i < handoff->count; i++)
+  {
+    release_stress_block(handoff->objects[i]);
+  }
+  handoff->count = 0;
+  spin_release(&handoff->lock);
+}
+
+static u32
+pool_stress_thread(void* param)
+{
+  u32 thread_index = (u32)(uintptr_t)param;
+
+  PoolObject* held[kMaxHeldBlocks];
+  u32         held_count = 0;
+
+  TestRng rng;
+  rng.state += thread_index * 7919;
+  for (u32 iteration = 0; iteration < kStressIterations; iteration++)
+  {
+    if (test_rng_range(&rng, 3) != 0 || held_count == 0)
+    {
+      // Running out is expected, every thread caches up to 2 magazines of blocks
+      PoolObject* object = (PoolObject*)concurrent_pool_alloc(&g_StressPool, sizeof(PoolObject), 8);
+      if (object != nullptr)
+      {
+        u32 block = (u32)(((u8*)object - g_StressPool.memory) / g_StressPool.block_size);
+        if (atomic_ref_exchange(&g_StressOwners[block], thread_index + 1) != 0)
+        {
+          atomic_ref_fetch_add(&g_StressFailures, 1U);
+        }
+        object->owner = thread_index;
+        object->a     = iteration;
+        held[held_count++] = object;
+      }
+
+      // Give half of them to the next thread over to free
+      if (held_count == kMaxHeldBlocks)
+      {
+        PoolHandoff* handoff = &g_StressHandoffs[(thread_index + 1) % kStressThreads];
+        spin_acquire(&handoff->lock);
+        for (u32 i = 0; i < kMaxHeldBlocks / 2; i++)
+        {
+          PoolObject* handed = held[--held_count];
+          if (handed->owner != thread_index)
+          {
+            atomic_ref_fetch_add(&g_StressFailures, 1U);
+          }
+          handoff->objects[handoff->count++] = handed;
+        }
+        spin_release(&handoff->lock);
+      }
+    }
+    else
+    {
+      release_stress_block(held[--held_count]);
+    }
+
+    if ((iteration & 255) == 0)
+    {
+      release_handoff_blocks(thread_index);
+    }
+  }
+
+  for (u32 i = 0; i < held_count; i++)
+  {
+    release_stress_block(held[i]);
+  }
+
+  return 0;
+}
+
+// Cross thread frees while the pool keeps running dry
+static void
+test_concurrent_pool_threads()
+{
+  g_StressPool = init_concurrent_pool_allocator((AllocHeap)GLOBAL_HEAP, kStressBlocks, sizeof(PoolObject), 8);
+
+  Thread threads[kStressThreads];
+  // Every lock has to be ready before the first thread can hand anything to its neighbour
+  for (u32 ithread = 0; ithread < kStressThreads; ithread++)
+  {
+    g_StressHandoffs[ithread].lock = init_spin_lock();
+  }
+
+  for (u32 ithread = 0; ithread < kStressThreads; ithread++)
+  {
+    threads[ithread] = init_test_thread(&pool_stress_thread, (void*)(uintptr_t)ithread);
+  }
+
+  join_threads(threads, kStressThreads);
+  for (u32 ithread = 0; ithread < kStressThreads; ithread++)
+  {
+    destroy_thread(&threads[ithread]);
+    release_handoff_blocks(ithread);
+  }
+  CHECK(g_StressFailures == 0);
+
+  // Everything's been freed, so the only blocks we can't get back are the ones cached by the dead threads' magazines
+  u32 reclaimed = 0;
+  while (concurrent_pool_alloc(&g_StressPool, 8, 8) != nullptr)
+  {
+    reclaimed++;
+  }
+  CHECK(reclaimed >= kStressBlocks - kStressThreads * 2 * kPoolMagazineSize);
+  CHECK(reclaimed <= kStressBlocks);
+
+  destroy_concurrent_pool_allocator(&g_StressPool);
+}
+
+int
+main()
+{
+  init_thread_context();
+
+  test_pool_free_count();
+  test_concurrent_pool_exhaustion();
+  test_concurrent_pool_typed();
+  test_concurrent_pool_threads();
+
+  return finish_test("pool_allocator_test");
+}
@@ -0,0 +1,150 @@
+#include "Tests/test.h"
+
+#include "Core/Foundation/Containers/push_buffer.h"
+
+// Producers push messages of random length and the consumer pops the header and then the payload in random sized pieces, checking that
+// every producer's messages show up complete and in order. Tiny segments make producers go through sealing and recycling all the time.
+
+static constexpr u32 kMaxProducerCount = 8;
+static constexpr u32 kMessageCount     = 100000;
+
+struct Message
+{
+  u32 producer;
+  u32 seq;
+  u32 len;
+  u32 pad;
+};
+
+struct TestState
+{
+  PushBuffer pb;
+  u32        producer_count = 0;
+  u32        max_len        = 0;
+  // Producers wait once this many messages are in flight, so the test doesn't just measure overflowing
+  u64        max_in_flight  = 0;
+  u64        produced       = 0;
+  u64        consumed       = 0;
+};
+
+struct ProducerParams
+{
+  TestState* state    = nullptr;
+  u32        producer = 0;
+};
+
+static u32
+producer_proc(void* param)
+{
+  auto*      params = (ProducerParams*)param;
+  TestState* state  = params->state;
+
+  TestRng rng;
+  rng.state += params->producer;
+  for (u32 seq = 0; seq < kMessageCount; seq++)
+  {
+    u32 len = test_rng_range(&rng, state->max_len);
+    while (atomic_ref_load(&state->produced) - atomic_ref_load(&state->consumed) > state->max_in_flight)
+    {
+      yield_current_thread();
+    }
+    atomic_ref_fetch_add(&state->produced, (u64)1);
+
+    u8*     dst    = (u8*)push_buffer_begin_edit(&state->pb, sizeof(Message) + len);
+    Message header = {params->producer, seq, len, 0};
+    memcpy(dst, &header, sizeof(header));
+    for (u32 i = 0; i < len; i++)
+    {
+      dst[sizeof(Message) + i] = (u8)(seq + i + params->producer);
+    }
+    push_buffer_end_edit(&state->pb, dst);
+  }
+
+  return 0;
+}
+
+static void
+run_round(u64 segment_size, u64 commit_size, u32 producer_count, u32 max_len, u64 max_in_flight)
+{
+  static TestState state;
+  state.pb             = init_push_buffer(segment_size, commit_size, MiB(256));
+  state.producer_count = producer_count;
+  state.max_len        = max_len;
+  state.max_in_flight  = max_in_flight;
+  state.produced       = 0;
+  state.consumed       = 0;
+
+  Thread         threads[kMaxProducerCount];
+  ProducerParams params [kMaxProducerCount];
+  for (u32 i = 0; i < producer_count; i++)
+  {
+    params[i].state    = &state;
+    params[i].producer = i;
+    threads[i]         = init_test_thread(&producer_proc, &params[i]);
+  }
+
+  u32 next_seq[kMaxProducerCount] = {0};
+  u8  payload[1024];
+
+  TestRng rng;
+  for (u64 received = 0; received < (u64)producer_count * kMessageCount;)
+  {
+    Message header;
+    if (!try_push_buffer_pop(&state.pb, &header, sizeof(header)))
+    {
+      yield_current_thread();
+      continue;
+    }
+
+    REQUIRE(header.producer < producer_count && header.len < max_len);
+    CHECK_MSG(header.seq == next_seq[header.producer], "producer %u: expected message %u but got %u", header.producer, next_seq[header.producer], header.seq);
+    next_seq[header.producer] = header.seq + 1;
+
+    for (u32 offset = 0; offset < header.len;)
+    {
+      u32 chunk = 1 + test_rng_range(&rng, header.len - offset);
+      push_buffer_pop(&state.pb, payload + offset, chunk);
+      offset += chunk;
+    }
+
+    for (u32 i = 0; i < header.len; i++)
+    {
+      if (payload[i] != (u8)(header.seq + i + header.producer))
+      {
+        CHECK_MSG(false, "producer %u message %u is corrupted at byte %u", header.producer, header.seq, i);
+        break;
+      }
+    }
+
+    received++;
+    atomic_ref_fetch_add(&state.consumed, (u64)1);
+  }
+
+  join_threads(threads, producer_count);
+  for (u32 i = 0; i < producer_count; i++)
+  {
+    destroy_thread(&threads[i]);
+  }
+
+  u8 extra;
+  CHECK(!try_push_buffer_pop(&state.pb, &extra, 1));
+}
+
+int
+main()
+{
+  // Segments a few elements long
+  run_round(256, KiB(16), 4, 100, 40);
+  // Elements bigger than a segment get their own overflow segments
+  run_round(256, KiB(16), 4, 600, 40);
+  // Normal sized segments
+  run_round(KiB(64), KiB(16), 4, 100, 40);
+  // Only a few segments and barely anything in flight, so every segment comes right back around while producers that got
+  // preempted are still holding on to it from its last time as the write segment. A stale producer whose reservation
+  // straddles the end of one of them must not seal it before it's the write segment again (that left the buffer stuck on
+  // a sealed write segment).
+  run_round(256, 1024, kMaxProducerCount, 100, 1);
+  run_round(256, 1024, kMaxProducerCount, 230, 1);
+
+  return finish_test("push_buffer_test");
+}
@@ -0,0 +1,355 @@
+#include "Tests/test.h"
+
+#include "Core/Foundation/context.h"
+#include "Core/Foundation/reclamation.h"
+
+static constexpr u32 kNodeLive  = 0x11FE11FE;
+static constexpr u32 kNodeFreed = 0xDEADDEAD;
+
+struct Node
+{
+  u32 magic;
+  u32 value;
+};
+
+static constexpr u32 kMaxNodes = 200000;
+
+// Nodes never really get freed (or reused), freeing one just marks it dead. Any reader that ever sees a dead node got
+// it freed out from under it.
+static Node g_Nodes[kMaxNodes];
+static u32  g_NodesAllocated = 0;
+static u32  g_NodesFreed     = 0;
+
+static void*
+node_alloc(void*, size_t size, size_t)
+{
+  ASSERT(size == sizeof(Node));
+  u32 index = atomic_ref_fetch_add(&g_NodesAllocated, 1U);
+  REQUIRE(index < kMaxNodes);
+  return &g_Nodes[index];
+}
+
+static void
+node_free(void*, void* ptr)
+{
+  Node* node = (Node*)ptr;
+  if (node->magic != kNodeLive)
+  {
+    CHECK_MSG(false, "node %u freed twice", (u32)(node - g_Nodes));
+  }
+  node->magic = kNodeFreed;
+  atomic_ref_fetch_add(&g_NodesFreed, 1U);
+}
+
+static FreeHeap
+get_node_heap()
+{
+  FreeHeap ret;
+  ret.alloc_fn = &node_alloc;
+  ret.free_fn  = &node_free;
+  return ret;
+}
+
+static Node*
+alloc_node(u32 value)
+{
+  Node* node  = HEAP_ALLOC(Node, (AllocHeap)get_node_heap(), 1);
+  node->magic = kNodeLive;
+  node->value = value;
+  return node;
+}
+
+static void
+reset_nodes()
+{
+  g_NodesAllocated = 0;
+  g_NodesFreed     = 0;
+}
+
+static void
+test_nested_critical_sections()
+{
+  reset_nodes();
+  ReclaimDomain domain = init_reclaim_domain(GLOBAL_HEAP);
+
+  Node* node = alloc_node(1);
+
+  reclaim_enter(&domain);
+  reclaim_enter(&domain);
+  reclaim_retire(&domain, node, get_node_heap());
+  reclaim_exit(&domain);
+
+  // Still inside of the outer one, so the epoch can't get far enough ahead
+  for (u32 i = 0; i < 10; i++)
+  {
+    CHECK(reclaim_collect(&domain) == 0);
+  }
+  CHECK(node->magic == kNodeLive);
+  reclaim_exit(&domain);
+
+  reclaim_flush(&domain);
+  CHECK(node->magic == kNodeFreed);
+  CHECK(g_NodesFreed == 1);
+
+  // Whatever's left in limbo gets freed with the domain
+  reclaim_retire(&domain, alloc_node(2), get_node_heap());
+  destroy_reclaim_domain(&domain);
+  CHECK(g_NodesFreed == 2);
+}
+
+static constexpr u32 kWriterThreads = 2;
+static constexpr u32 kReaderThreads = 3;
+static constexpr u32 kSwapsPerWriter = 30000;
+
+struct SwapTest
+{
+  ReclaimDomain domain;
+  Node*         current         = nullptr;
+  u32           writers_done    = 0;
+  u32           dead_reads      = 0;
+  // Longest any writer's limbo list got
+  u32           max_limbo_count = 0;
+
+  // Hazard mode only, held by one reader for the whole run
+  Node*         pinned          = nullptr;
+};
+
+static SwapTest g_Swap;
+
+static u32
+swap_writer_thread(void* param)
+{
+  u32            index  = (u32)(uintptr_t)param;
+  ReclaimThread* thread = &g_Swap.domain.threads[get_allocator_thread_slot()];
+  for (u32 i = 0; i < kSwapsPerWriter; i++)
+  {
+    Node* node = alloc_node(index * kSwapsPerWriter + i);
+    Node* old  = atomic_ref_exchange(&g_Swap.current, node);
+    reclaim_retire(&g_Swap.domain, old, get_node_heap());
+
+    u32 max_limbo_count = atomic_ref_load(&g_Swap.max_limbo_count, std::memory_order_relaxed);
+    if (thread->limbo_count > max_limbo_count)
+    {
+      atomic_ref_store(&g_Swap.max_limbo_count, thread->limbo_count, std::memory_order_relaxed);
+    }
+  }
+
+  // Done before flushing, the pinned node can't get freed until its reader sees that everyone's done and lets go
+  atomic_ref_fetch_add(&g_Swap.writers_done, 1U);
+  reclaim_flush(&g_Swap.domain);
+
+  return 0;
+}
+
+static void
+read_node(Node* node)
+{
+  // A couple of reads, to give a free in the middle of them a chance to land
+  for (u32 i = 0; i < 4; i++)
+  {
+    if (node->magic != kNodeLive)
+    {
+      atomic_ref_fetch_add(&g_Swap.dead_reads, 1U);
+      return;
+    }
+  }
+}
+
+static u32
+swap_reader_thread(void* param)
+{
+  u32 index = (u32)(uintptr_t)param;
+
+  // One reader in hazard mode holds on to a single node for the entire run without being in a critical section,
+  // which must not hold up anybody else's frees
+  if (g_Swap.domain.hazard_pointers && index == 0)
+  {
+    Node* pinned = reclaim_protect(&g_Swap.domain, 0, &g_Swap.current);
+    atomic_ref_store(&g_Swap.pinned, pinned);
+    while (atomic_ref_load(&g_Swap.writers_done) < kWriterThreads)
+    {
+      read_node(pinned);
+      yield_current_thread();
+    }
+    read_node(pinned);
+    reclaim_clear_hazard(&g_Swap.domain, 0);
+    return 0;
+  }
+
+  u32 reads = 0;
+  while (atomic_ref_load(&g_Swap.writers_done) < kWriterThreads)
+  {
+    if (g_Swap.domain.hazard_pointers)
+    {
+      Node* node = reclaim_protect(&g_Swap.domain, 1, &g_Swap.current);
+      read_node(node);
+      reclaim_clear_hazard(&g_Swap.domain, 1);
+    }
+    else
+    {
+      reclaim_enter(&g_Swap.domain);
+      read_node(atomic_ref_load(&g_Swap.current));
+      reclaim_exit(&g_Swap.domain);
+    }
+
+    if ((++reads & 15) == 0)
+    {
+      yield_current_thread();
+    }
+  }
+
+  return 0;
+}
+
+// Writers keep swapping out the current node and retiring the old one while readers keep reading whatever's current
+static void
+test_swap_and_retire(bool hazard_pointers)
+{
+  reset_nodes();
+
+  g_Swap         = SwapTest();
+  g_Swap.domain  = init_reclaim_domain(GLOBAL_HEAP, hazard_pointers);
+  g_Swap.current = alloc_node(U32_MAX);
+
+  Thread threads[kWriterThreads + kReaderThreads];
+  for (u32 i = 0; i < kReaderThreads; i++)
+  {
+    threads[i] = init_test_thread(&swap_reader_thread, (void*)(uintptr_t)i);
+  }
+
+  // Make sure the pinned node really is pinned before anything gets retired
+  if (hazard_pointers)
+  {
+    while (atomic_ref_load(&g_Swap.pinned) == nullptr)
+    {
+      yield_current_thread();
+    }
+  }
+
+  for (u32 i = 0; i < kWriterThreads; i++)
+  {
+    threads[kReaderThreads + i] = init_test_thread(&swap_writer_thread, (void*)(uintptr_t)i);
+  }
+
+  join_threads(threads, ARRAY_LENGTH(threads));
+  for (Thread& thread : threads)
+  {
+    destroy_thread(&thread);
+  }
+
+  CHECK(g_Swap.dead_reads == 0);
+
+  // Everything but the current one got retired, and the writers flushed before they exited
+  static constexpr u32 kRetiredCount = kWriterThreads * kSwapsPerWriter;
+  CHECK(g_NodesAllocated == kRetiredCount + 1);
+  CHECK_MSG(g_NodesFreed == kRetiredCount, "%u of %u retired nodes freed", g_NodesFreed, kRetiredCount);
+
+  // Nobody's ever inside of a critical section in hazard mode, so the pinned node can't hold anything else up and
+  // the writers' limbo lists stay short. (In epoch mode a reader that gets preempted inside of one holds up every free.)
+  if (hazard_pointers)
+  {
+    CHECK_MSG(g_Swap.max_limbo_count <= kReclaimCollectInterval * 8, "limbo got to %u entries", g_Swap.max_limbo_count);
+    CHECK(g_Swap.pinned->magic == kNodeFreed);
+  }
+
+  reclaim_retire(&g_Swap.domain, g_Swap.current, get_node_heap());
+  destroy_reclaim_domain(&g_Swap.domain);
+  CHECK(g_NodesFreed == g_NodesAllocated);
+}
+
+static constexpr u32 kShortLivedThreads = 4 * kAllocatorMaxThreads;
+static constexpr u32 kShortLivedBatch   = 16;
+
+struct ShortLivedTest
+{
+  ReclaimDomain domain;
+  Node*         current     = nullptr;
+  u32           dead_reads  = 0;
+  // Highest thread slot any of the threads got
+  u32           max_slot    = 0;
+};
+
+static ShortLivedTest g_ShortLived;
+
+static u32
+short_lived_thread(void* param)
+{
+  u32 index = (u32)(uintptr_t)param;
+
+  u32 slot     = get_allocator_thread_slot();
+  u32 max_slot = atomic_ref_load(&g_ShortLived.max_slot);
+  while (slot > max_slot && !atomic_ref_compare_exchange(&g_ShortLived.max_slot, &max_slot, slot))
+  {
+  }
+
+  for (u32 i = 0; i < 8; i++)
+  {
+    reclaim_enter(&g_ShortLived.domain);
+    Node* node = atomic_ref_load(&g_ShortLived.current);
+    if (node->magic != kNodeLive)
+    {
+      atomic_ref_fetch_add(&g_ShortLived.dead_reads, 1U);
+    }
+    reclaim_exit(&g_ShortLived.domain);
+
+    Node* old = atomic_ref_exchange(&g_ShortLived.current, alloc_node(index));
+    reclaim_retire(&g_ShortLived.domain, old, get_node_heap());
+  }
+
+  // Half of them leave their retired nodes behind for whoever gets their slot next
+  if (index & 1)
+  {
+    reclaim_flush(&g_ShortLived.domain);
+  }
+
+  return 0;
+}
+
+// Way more threads than there are slots come and go, none of them can be turned away as long as there's never more
+// than kAllocatorMaxThreads of them around at once
+static void
+test_short_lived_threads()
+{
+  reset_nodes();
+
+  g_ShortLived         = ShortLivedTest();
+  g_ShortLived.domain  = init_reclaim_domain(GLOBAL_HEAP);
+  g_ShortLived.current = alloc_node(U32_MAX);
+
+  for (u32 ithread = 0; ithread < kShortLivedThreads; ithread += kShortLivedBatch)
+  {
+    Thread threads[kShortLivedBatch];
+    for (u32 i = 0; i < kShortLivedBatch; i++)
+    {
+      threads[i] = init_test_thread(&short_lived_thread, (void*)(uintptr_t)(ithread + i));
+    }
+
+    join_threads(threads, kShortLivedBatch);
+    for (Thread& thread : threads)
+    {
+      destroy_thread(&thread);
+    }
+  }
+
+  CHECK(g_ShortLived.dead_reads == 0);
+  CHECK_MSG(g_ShortLived.max_slot < kAllocatorMaxThreads, "thread slot %u handed out after %u threads", g_ShortLived.max_slot, kShortLivedThreads);
+  CHECK(g_NodesAllocated == kShortLivedThreads * 8 + 1);
+
+  // Whatever the threads that didn't flush left behind is either freed by now or still in some slot's limbo list
+  reclaim_retire(&g_ShortLived.domain, g_ShortLived.current, get_node_heap());
+  destroy_reclaim_domain(&g_ShortLived.domain);
+  CHECK(g_NodesFreed == g_NodesAllocated);
+}
+
+int
+main()
+{
+  init_thread_context();
+
+  test_nested_critical_sections();
+  test_swap_and_retire(false);
+  test_swap_and_retire(true);
+  test_short_lived_threads();
+
+  return finish_test("reclamation_test");
+}
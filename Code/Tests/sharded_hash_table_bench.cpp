@@ -0,0 +1,138 @@
+#include "Tests/bench.h"
+
+#include "Core/Foundation/Containers/sharded_hash_table.h"
+
+// Throughput of the 16 shard table against a single spin locked table (a table with one shard is exactly that) as more
+// threads hit it, for a few mixes of lookups and inserts/erases.
+//
+//   sharded_hash_table_bench [ops per thread]
+
+static constexpr u32 kMaxThreads  = 16;
+static constexpr u32 kKeyCount    = 0x4000;
+// Every thread inserts and erases its own keys, so the writes don't change what the lookups find
+static constexpr u32 kPrivateKeys = 64;
+
+struct WorkerParams
+{
+  void* table         = nullptr;
+  u32   thread_index  = 0;
+  u32   write_percent = 0;
+  u64   ops           = 0;
+  u32*  go            = nullptr;
+  u64   misses        = 0;
+};
+
+static u32
+key_at(u32 i)
+{
+  return i * 2654435761U;
+}
+
+template <u32 kNumShards>
+static u32
+worker_proc(void* param)
+{
+  using Table = ShardedHashTable<u32, u64, DefaultHashTraits<u32>, kNumShards>;
+
+  auto*   params = (WorkerParams*)param;
+  auto*   table  = (Table*)params->table;
+  TestRng rng;
+  rng.state += params->thread_index * 0x9E3779B97F4A7C15ULL;
+
+  while (atomic_ref_load(params->go) == 0)
+  {
+    yield_current_thread();
+  }
+
+  u32 private_first = kKeyCount + params->thread_index * kPrivateKeys;
+  for (u64 i = 0; i < params->ops; i++)
+  {
+    u32 roll = test_rng_range(&rng, 100);
+    if (roll < params->write_percent)
+    {
+      u32 key = key_at(private_first + (u32)(i % kPrivateKeys));
+      if (!sharded_hash_table_erase(table, key))
+      {
+        *sharded_hash_table_insert(table, key) = key;
+      }
+    }
+    else
+    {
+      u64* value = sharded_hash_table_find(table, key_at(test_rng_range(&rng, kKeyCount)));
+      if (value == nullptr)
+      {
+        params->misses++;
+      }
+    }
+  }
+
+  return 0;
+}
+
+// Returns millions of ops per second across all of the threads
+template <u32 kNumShards>
+static f64
+bench_table(u32 thread_count, u32 write_percent, u64 ops_per_thread)
+{
+  using Table = ShardedHashTable<u32, u64, DefaultHashTraits<u32>, kNumShards>;
+
+  // One table per shard count, filled the first time around and kept for the rest of the runs
+  static Table table = init_sharded_hash_table<u32, u64, DefaultHashTraits<u32>, kNumShards>((AllocHeap)GLOBAL_HEAP, kKeyCount + kMaxThreads * kPrivateKeys);
+  static bool  filled = false;
+  if (!filled)
+  {
+    for (u32 i = 0; i < kKeyCount; i++)
+    {
+      *sharded_hash_table_insert(&table, key_at(i)) = i;
+    }
+    filled = true;
+  }
+
+  u32          go = 0;
+  Thread       threads[kMaxThreads];
+  WorkerParams params [kMaxThreads];
+  for (u32 i = 0; i < thread_count; i++)
+  {
+    params[i].table         = &table;
+    params[i].thread_index  = i;
+    params[i].write_percent = write_percent;
+    params[i].ops           = ops_per_thread;
+    params[i].go            = &go;
+    threads[i]              = init_test_thread(&worker_proc<kNumShards>, &params[i]);
+  }
+
+  u64 start = get_bench_time_ns();
+  atomic_ref_store(&go, 1U);
+  join_threads(threads, thread_count);
+  u64 elapsed = get_bench_time_ns() - start;
+
+  for (u32 i = 0; i < thread_count; i++)
+  {
+    destroy_thread(&threads[i]);
+    ASSERT_MSG_FATAL(params[i].misses == 0, "Lookups missed keys that were never erased!");
+  }
+
+  return (f64)(ops_per_thread * thread_count) * 1000.0 / (f64)elapsed;
+}
+
+int
+main(int argc, char** argv)
+{
+  u64 ops = get_bench_arg(argc, argv, 1, 200000);
+
+  static constexpr u32 kWritePercents[] = {0, 10, 50};
+
+  printf("%llu ops per thread, %u keys, Mops/s\n\n", (unsigned long long)ops, kKeyCount);
+  printf("%8s %8s %12s %12s %8s\n", "threads", "writes", "1 shard", "16 shards", "speedup");
+  for (u32 write_percent : kWritePercents)
+  {
+    for (u32 thread_count = 1; thread_count <= kMaxThreads; thread_count *= 2)
+    {
+      f64 single  = bench_table<1> (thread_count, write_percent, ops);
+      f64 sharded = bench_table<16>(thread_count, write_percent, ops);
+      printf("%8u %7u%% %12.2f %12.2f %7.2fx\n", thread_count, write_percent, single, sharded, sharded / single);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,117 @@
+#include "Tests/test.h"
+
+#include "Core/Foundation/Containers/sharded_hash_table.h"
+
+static constexpr u32 kThreadCount = 8;
+static constexpr u32 kKeyCount    = 0x4000;
+
+struct WorkerParams
+{
+  ShardedHashTable<u32, u64>* table        = nullptr;
+  u32                         thread_index = 0;
+  u32                         mismatches   = 0;
+};
+
+static u32
+key_at(u32 i)
+{
+  return i * 2654435761U;
+}
+
+// Every thread does find-or-insert on the same keys, only one insert per key should win and everyone has to see its value
+static u32
+insert_proc(void* param)
+{
+  auto* params = (WorkerParams*)param;
+  for (u32 round = 0; round < 8; round++)
+  {
+    for (u32 i = 0; i < kKeyCount; i++)
+    {
+      u32  key   = key_at((i + params->thread_index * 977) % kKeyCount);
+      u64* value = ACQUIRE(sharded_hash_table_shard(params->table, key), auto* shard)
+      {
+        u64* ret = hash_table_find(shard, key);
+        if (ret == nullptr)
+        {
+          ret  = hash_table_insert(shard, key);
+          *ret = (u64)key << 32 | params->thread_index;
+        }
+        return ret;
+      };
+
+      // Values are stable until erased, so reading it outside the lock is fine
+      if ((*value >> 32) != key)
+      {
+        params->mismatches++;
+      }
+    }
+  }
+  return 0;
+}
+
+// Each thread erases its own slice of the keys while looking up everyone else's
+static u32
+erase_proc(void* param)
+{
+  auto* params = (WorkerParams*)param;
+  for (u32 i = params->thread_index; i < kKeyCount; i += kThreadCount)
+  {
+    if (!sharded_hash_table_erase(params->table, key_at(i)))
+    {
+      params->mismatches++;
+    }
+
+    u32  other = key_at((i + 1) % kKeyCount);
+    u64* value = sharded_hash_table_find(params->table, other);
+    if (value != nullptr && (*value >> 32) != other)
+    {
+      params->mismatches++;
+    }
+  }
+  return 0;
+}
+
+static void
+run_workers(ShardedHashTable<u32, u64>* table, ThreadProc proc)
+{
+  Thread       threads[kThreadCount];
+  WorkerParams params [kThreadCount];
+  for (u32 i = 0; i < kThreadCount; i++)
+  {
+    params[i].table        = table;
+    params[i].thread_index = i;
+    threads[i]             = init_test_thread(proc, &params[i]);
+  }
+
+  join_threads(threads, kThreadCount);
+  for (u32 i = 0; i < kThreadCount; i++)
+  {
+    destroy_thread(&threads[i]);
+    CHECK_MSG(params[i].mismatches == 0, "thread %u saw %u mismatches", i, params[i].mismatches);
+  }
+}
+
+int
+main()
+{
+  static ShardedHashTable<u32, u64> table = init_sharded_hash_table<u32, u64>((AllocHeap)GLOBAL_HEAP, kKeyCount);
+
+  run_workers(&table, &insert_proc);
+  CHECK(sharded_hash_table_size(&table) == kKeyCount);
+  for (u32 i = 0; i < kKeyCount; i++)
+  {
+    u64* value = sharded_hash_table_find(&table, key_at(i));
+    CHECK(value != nullptr && (*value >> 32) == key_at(i));
+  }
+
+  run_workers(&table, &erase_proc);
+  CHECK(sharded_hash_table_size(&table) == 0);
+
+  // Heterogeneous lookups pick the shard off the same hash as the key
+  static ShardedHashTable<const char*, u32, CStrHashTraits> names = init_sharded_hash_table<const char*, u32, CStrHashTraits>((AllocHeap)GLOBAL_HEAP, 64);
+  *sharded_hash_table_insert(&names, (const char*)"Sponza/albedo") = 7;
+  u32* albedo = sharded_hash_table_find(&names, Span<char>("Sponza/albedo.png", 13));
+  CHECK(albedo != nullptr && *albedo == 7);
+
+  return finish_test("sharded_hash_table_test");
+}
@@ -0,0 +1,293 @@
+#include "Tests/bench.h"
+
+#include "Core/Foundation/context.h"
+#include "Core/Foundation/slab_allocator.h"
+
+// ns per allocation (including freeing it again) of the slab allocator against glibc malloc, replaying the same
+// allocation traces on both:
+//
+//   frame      every thread allocates a frame's worth of small temporaries and frees them all at the end of the frame
+//   churn      a steady set of live blocks with the engine's mix of sizes, freeing a random one for every allocation
+//   handoff    blocks allocated on one thread and freed on the next one over, like job outputs
+//
+//   slab_allocator_bench [ops per thread]
+
+static constexpr u32 kMaxThreads = 8;
+static constexpr u32 kLiveBlocks = 4096;
+
+enum AllocTrace : u8
+{
+  kAllocTraceFrame,
+  kAllocTraceChurn,
+  kAllocTraceHandoff,
+
+  kAllocTraceCount,
+};
+
+static const char* kAllocTraceNames[] = {"frame", "churn", "handoff"};
+
+// A block size of 0 frees whatever's in the slot instead
+struct AllocOp
+{
+  u32 slot = 0;
+  u32 size = 0;
+};
+
+// Mostly small (array headers, strings, hash nodes), some medium (asset metadata), the odd big one that goes straight to the OS
+static u32
+pick_allocation_size(TestRng* rng)
+{
+  u32 r = test_rng_range(rng, 1000);
+  if (r < 600) return 8    + test_rng_range(rng, 120);
+  if (r < 900) return 128  + test_rng_range(rng, 1920);
+  if (r < 990) return 2048 + test_rng_range(rng, 30000);
+  return KiB(32) + test_rng_range(rng, KiB(256));
+}
+
+// Fills ops with op_count allocations and their frees, returns how many ops that took
+static u32
+build_alloc_trace(AllocTrace trace, u32 thread_index, AllocOp* ops, u32 op_count)
+{
+  TestRng rng;
+  rng.state += thread_index * 0x9E3779B97F4A7C15ULL + trace;
+
+  u32 ret = 0;
+  if (trace == kAllocTraceFrame)
+  {
+    static constexpr u32 kFrameBlocks = 512;
+    for (u32 first = 0; first < op_count; first += kFrameBlocks)
+    {
+      u32 count = MIN(kFrameBlocks, op_count - first);
+      for (u32 i = 0; i < count; i++)
+      {
+        ops[ret++] = AllocOp{i, 16 + test_rng_range(&rng, 240)};
+      }
+      for (u32 i = 0; i < count; i++)
+      {
+        ops[ret++] = AllocOp{i, 0};
+      }
+    }
+    return ret;
+  }
+
+  // Churn and handoff both start by filling up every slot, handoff frees on the other thread instead
+  bool live[kLiveBlocks] = {};
+  for (u32 i = 0; i < op_count; i++)
+  {
+    u32 slot = i < kLiveBlocks ? i : test_rng_range(&rng, kLiveBlocks);
+    if (live[slot])
+    {
+      ops[ret++] = AllocOp{slot, 0};
+    }
+    ops[ret++] = AllocOp{slot, pick_allocation_size(&rng)};
+    live[slot] = true;
+  }
+  for (u32 slot = 0; slot < kLiveBlocks; slot++)
+  {
+    if (live[slot])
+    {
+      ops[ret++] = AllocOp{slot, 0};
+    }
+  }
+
+  return ret;
+}
+
+struct AllocBench;
+
+struct AllocBenchThread
+{
+  AllocBench* bench        = nullptr;
+  u32         thread_index = 0;
+  AllocOp*    ops          = nullptr;
+  u32         op_count     = 0;
+  u32         freed        = 0;
+};
+
+struct AllocBench
+{
+  FreeHeap         heap;
+  AllocTrace       trace        = kAllocTraceFrame;
+  u32              thread_count = 0;
+  AllocBenchThread threads[kMaxThreads];
+
+  // Handoff only, every thread's blocks go through the next thread over's mailbox to get freed
+  void**           mailboxes[kMaxThreads];
+  // Accessed atomically
+  u32              mailbox_counts[kMaxThreads];
+  u32              mailbox_done  [kMaxThreads];
+  u32              go           = 0;
+};
+
+static u32
+alloc_bench_proc(void* param)
+{
+  auto*       thread = (AllocBenchThread*)param;
+  AllocBench* bench  = thread->bench;
+  FreeHeap    heap   = bench->heap;
+
+  while (atomic_ref_load(&bench->go) == 0)
+  {
+    yield_current_thread();
+  }
+
+  void*  live[kLiveBlocks];
+  void** mailbox = bench->mailboxes[thread->thread_index];
+  u32    next    = (thread->thread_index + 1) % bench->thread_count;
+  u32    sent    = 0;
+  for (u32 iop = 0; iop < thread->op_count; iop++)
+  {
+    AllocOp op = thread->ops[iop];
+    if (op.size != 0)
+    {
+      live[op.slot] = heap.alloc_fn(heap.allocator, op.size, 16);
+      // Touch it like a real caller would
+      *(u8*)live[op.slot] = (u8)op.slot;
+    }
+    else if (bench->trace != kAllocTraceHandoff)
+    {
+      heap.free_fn(heap.allocator, live[op.slot]);
+    }
+    else
+    {
+      bench->mailboxes[next][sent] = live[op.slot];
+      atomic_ref_store(&bench->mailbox_counts[next], ++sent, std::memory_order_release);
+    }
+
+    // Free whatever the previous thread has handed over so far
+    if (bench->trace == kAllocTraceHandoff)
+    {
+      u32 count = atomic_ref_load(&bench->mailbox_counts[thread->thread_index], std::memory_order_acquire);
+      for (; thread->freed < count; thread->freed++)
+      {
+        heap.free_fn(heap.allocator, mailbox[thread->freed]);
+      }
+    }
+  }
+
+  if (bench->trace != kAllocTraceHandoff)
+  {
+    return 0;
+  }
+
+  // And whatever it hands over after this thread is done with its own trace
+  atomic_ref_store(&bench->mailbox_done[next], 1U);
+  for (;;)
+  {
+    bool done  = atomic_ref_load(&bench->mailbox_done[thread->thread_index]) != 0;
+    u32  count = atomic_ref_load(&bench->mailbox_counts[thread->thread_index], std::memory_order_acquire);
+    for (; thread->freed < count; thread->freed++)
+    {
+      heap.free_fn(heap.allocator, mailbox[thread->freed]);
+    }
+
+    if (done)
+    {
+      break;
+    }
+    yield_current_thread();
+  }
+
+  return 0;
+}
+
+// Returns ns per allocation
+static f64
+run_alloc_bench(FreeHeap heap, AllocTrace trace, u32 thread_count, AllocOp** ops, u32* op_counts)
+{
+  static AllocBench bench;
+  bench              = AllocBench();
+  bench.heap         = heap;
+  bench.trace        = trace;
+  bench.thread_count = thread_count;
+
+  u64    allocations = 0;
+  Thread threads[kMaxThreads];
+  for (u32 i = 0; i < thread_count; i++)
+  {
+    bench.threads[i]   = AllocBenchThread{&bench, i, ops[i], op_counts[i]};
+    // Big enough for every free in the previous thread's trace
+    bench.mailboxes[i] = (void**)malloc(sizeof(void*) * op_counts[(i + thread_count - 1) % thread_count]);
+    threads[i]         = init_test_thread(&alloc_bench_proc, &bench.threads[i]);
+    allocations       += op_counts[i] / 2;
+  }
+
+  u64 start = get_bench_time_ns();
+  atomic_ref_store(&bench.go, 1U);
+  join_threads(threads, thread_count);
+  u64 elapsed = get_bench_time_ns() - start;
+
+  for (u32 i = 0; i < thread_count; i++)
+  {
+    destroy_thread(&threads[i]);
+    ASSERT_MSG_FATAL(bench.threads[i].freed == bench.mailbox_counts[i], "Blocks handed off to thread %u never got freed!", i);
+    free(bench.mailboxes[i]);
+  }
+
+  return (f64)elapsed / (f64)allocations;
+}
+
+static void*
+malloc_alloc(void* allocator, size_t size, size_t alignment)
+{
+  UNREFERENCED_PARAMETER(allocator);
+  UNREFERENCED_PARAMETER(alignment);
+  return malloc(size);
+}
+
+static void
+malloc_free(void* allocator, void* ptr)
+{
+  UNREFERENCED_PARAMETER(allocator);
+  free(ptr);
+}
+
+int
+main(int argc, char** argv)
+{
+  init_thread_context();
+
+  u32 allocations = (u32)get_bench_arg(argc, argv, 1, 200000);
+
+  static u8 init_memory[MiB(8)];
+  LinearAllocator init_allocator = init_linear_allocator(init_memory, sizeof(init_memory));
+  static SlabAllocator slab      = init_slab_allocator(init_allocator, GiB(4));
+
+  FreeHeap slab_heap   = (ReallocFreeHeap)slab;
+  FreeHeap malloc_heap = {};
+  malloc_heap.alloc_fn = &malloc_alloc;
+  malloc_heap.free_fn  = &malloc_free;
+
+  // Every allocation in a trace has a free, plus the frees of whatever's left at the end
+  AllocOp* ops      [kMaxThreads];
+  u32      op_counts[kMaxThreads];
+  for (u32 i = 0; i < kMaxThreads; i++)
+  {
+    ops[i] = (AllocOp*)malloc(sizeof(AllocOp) * (allocations * 2 + kLiveBlocks));
+  }
+
+  printf("%u allocations per thread, ns per allocation and free\n\n", allocations);
+  printf("%-8s %8s %10s %10s %8s\n", "trace", "threads", "slab", "malloc", "speedup");
+  for (u32 trace = 0; trace < kAllocTraceCount; trace++)
+  {
+    for (u32 thread_count = 1; thread_count <= kMaxThreads; thread_count *= 2)
+    {
+      for (u32 i = 0; i < thread_count; i++)
+      {
+        op_counts[i] = build_alloc_trace((AllocTrace)trace, i, ops[i], allocations);
+      }
+
+      f64 slab_ns   = run_alloc_bench(slab_heap,   (AllocTrace)trace, thread_count, ops, op_counts);
+      f64 malloc_ns = run_alloc_bench(malloc_heap, (AllocTrace)trace, thread_count, ops, op_counts);
+      printf("%-8s %8u %10.1f %10.1f %7.2fx\n", kAllocTraceNames[trace], thread_count, slab_ns, malloc_ns, malloc_ns / slab_ns);
+    }
+  }
+
+  for (u32 i = 0; i < kMaxThreads; i++)
+  {
+    free(ops[i]);
+  }
+  destroy_slab_allocator(&slab);
+
+  return 0;
+}
@@ -0,0 +1,240 @@
+#include "Tests/test.h"
+
+#include "Core/Foundation/context.h"
+#include "Core/Foundation/slab_allocator.h"
+
+static SlabAllocator g_Slab;
+
+// Mostly small (array headers, strings, hash nodes), some medium (asset metadata), the odd big one that goes straight to the OS
+static u32
+pick_allocation_size(TestRng* rng)
+{
+  u32 r = test_rng_range(rng, 1000);
+  if (r < 600) return 8    + test_rng_range(rng, 120);
+  if (r < 900) return 128  + test_rng_range(rng, 1920);
+  if (r < 990) return 2048 + test_rng_range(rng, 30000);
+  return KiB(32) + test_rng_range(rng, MiB(1));
+}
+
+struct SlabBlock
+{
+  u8* memory;
+  u32 size;
+  u8  tag;
+};
+
+static bool
+check_slab_block(SlabBlock block)
+{
+  for (u32 i = 0; i < block.size; i++)
+  {
+    if (block.memory[i] != block.tag)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static constexpr u32 kStressThreads    = 4;
+static constexpr u32 kStressIterations = 50000;
+static constexpr u32 kMaxLiveBlocks    = 2000;
+static constexpr u32 kMaxHandoffBlocks = 4096;
+
+// Blocks allocated on one thread and freed on the next one over, so that the remote free lists get used
+struct SlabHandoff
+{
+  SpinLock  lock;
+  SlabBlock blocks[kMaxHandoffBlocks];
+  u32       count = 0;
+};
+
+static SlabHandoff g_Handoffs[kStressThreads];
+static u32         g_StressDone      = 0;
+static u32         g_StressCorrupted = 0;
+
+static void
+free_slab_block(SlabBlock block)
+{
+  if (!check_slab_block(block))
+  {
+    atomic_ref_fetch_add(&g_StressCorrupted, 1U);
+  }
+  slab_free(&g_Slab, block.memory);
+}
+
+static void
+free_handoff_blocks(u32 thread_index)
+{
+  SlabHandoff* handoff = &g_Handoffs[thread_index];
+  spin_acquire(&handoff->lock);
+  for (u32 i = 0; i < handoff->count; i++)
+  {
+    free_slab_block(handoff->blocks[i]);
+  }
+  handoff->count = 0;
+  spin_release(&handoff->lock);
+}
+
+static u32
+slab_stress_thread(void* param)
+{
+  u32 thread_index = (u32)(uintptr_t)param;
+
+  SlabBlock* live       = (SlabBlock*)malloc(sizeof(SlabBlock) * kMaxLiveBlocks);
+  u32        live_count = 0;
+
+  TestRng rng;
+  rng.state += thread_index * 1337;
+  for (u32 iteration = 0; iteration < kStressIterations; iteration++)
+  {
+    u32 op = test_rng_range(&rng, 10);
+    if (op < 5 || live_count == 0)
+    {
+      u32 size      = pick_allocation_size(&rng);
+      u32 alignment = test_rng_range(&rng, 8) == 0 ? 1U << test_rng_range(&rng, 9) : 16;
+
+      SlabBlock block = {(u8*)slab_alloc(&g_Slab, size, alignment), size, (u8)test_rng_next(&rng)};
+      if (((uintptr_t)block.memory & (alignment - 1)) != 0)
+      {
+        atomic_ref_fetch_add(&g_StressCorrupted, 1U);
+      }
+      memset(block.memory, block.tag, size);
+
+      SlabHandoff* handoff = &g_Handoffs[(thread_index + 1) % kStressThreads];
+      spin_acquire(&handoff->lock);
+      bool handed_off = test_rng_range(&rng, 4) == 0 && handoff->count < kMaxHandoffBlocks;
+      if (handed_off)
+      {
+        handoff->blocks[handoff->count++] = block;
+      }
+      spin_release(&handoff->lock);
+
+      if (!handed_off)
+      {
+        if (live_count == kMaxLiveBlocks)
+        {
+          free_slab_block(live[--live_count]);
+        }
+        live[live_count++] = block;
+      }
+    }
+    else if (op < 9)
+    {
+      u32 index = test_rng_range(&rng, live_count);
+      free_slab_block(live[index]);
+      live[index] = live[--live_count];
+    }
+    else
+    {
+      free_handoff_blocks(thread_index);
+    }
+  }
+
+  for (u32 i = 0; i < live_count; i++)
+  {
+    free_slab_block(live[i]);
+  }
+  free(live);
+
+  // Nobody hands us anything once everyone is done
+  atomic_ref_fetch_add(&g_StressDone, 1U);
+  while (atomic_ref_load(&g_StressDone) < kStressThreads)
+  {
+    yield_current_thread();
+  }
+  free_handoff_blocks(thread_index);
+
+  return 0;
+}
+
+static void
+test_slab_stress()
+{
+  Thread threads[kStressThreads];
+  // Every lock has to be ready before the first thread can hand anything to its neighbour
+  for (u32 ithread = 0; ithread < kStressThreads; ithread++)
+  {
+    g_Handoffs[ithread].lock = init_spin_lock();
+  }
+
+  for (u32 ithread = 0; ithread < kStressThreads; ithread++)
+  {
+    threads[ithread] = init_test_thread(&slab_stress_thread, (void*)(uintptr_t)ithread);
+  }
+
+  join_threads(threads, kStressThreads);
+  for (u32 ithread = 0; ithread < kStressThreads; ithread++)
+  {
+    destroy_thread(&threads[ithread]);
+  }
+
+  CHECK(g_StressCorrupted == 0);
+}
+
+// Growing through every size class (and out to the OS) has to keep the contents
+static void
+test_slab_realloc()
+{
+  ReallocFreeHeap heap = g_Slab;
+
+  u8* memory = HEAP_ALLOC(u8, heap, 10);
+  memset(memory, 7, 10);
+  for (u32 size = 20; size < 200000; size *= 3)
+  {
+    memory = (u8*)heap.realloc_fn(heap.allocator, memory, size, 16);
+    CHECK(slab_usable_size(&g_Slab, memory) >= size);
+    CHECK(check_slab_block(SlabBlock{memory, 10, 7}));
+  }
+  HEAP_FREE(heap, memory);
+}
+
+// Slabs that empty out go back on the free list and get reused instead of bumping further into the reservation
+static void
+test_slab_reuse()
+{
+  static constexpr u32 kBlockCount = 100000;
+
+  void** blocks = (void**)malloc(sizeof(void*) * kBlockCount);
+  for (u32 i = 0; i < kBlockCount; i++)
+  {
+    blocks[i] = slab_alloc(&g_Slab, 64, 16);
+  }
+  u32 bumped = g_Slab.slab_bump;
+
+  for (u32 i = 0; i < kBlockCount; i++)
+  {
+    slab_free(&g_Slab, blocks[i]);
+  }
+  CHECK(g_Slab.slab_free_head != kSlabNullIndex);
+
+  for (u32 i = 0; i < kBlockCount; i++)
+  {
+    blocks[i] = slab_alloc(&g_Slab, 64, 16);
+  }
+  CHECK(g_Slab.slab_bump == bumped);
+
+  for (u32 i = 0; i < kBlockCount; i++)
+  {
+    slab_free(&g_Slab, blocks[i]);
+  }
+  free(blocks);
+}
+
+int
+main()
+{
+  init_thread_context();
+
+  static u8 init_memory[MiB(8)];
+  LinearAllocator init_allocator = init_linear_allocator(init_memory, sizeof(init_memory));
+  g_Slab = init_slab_allocator(init_allocator, GiB(4));
+
+  test_slab_realloc();
+  test_slab_reuse();
+  test_slab_stress();
+
+  destroy_slab_allocator(&g_Slab);
+
+  return finish_test("slab_allocator_test");
+}
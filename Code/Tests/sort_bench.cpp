@@ -0,0 +1,120 @@
+#include "Tests/job_test.h"
+#include "Tests/bench.h"
+
+#include "Core/Foundation/context.h"
+#include "Core/Foundation/sort.h"
+
+#include <algorithm>
+#include <unistd.h>
+
+// ns per element for the radix sorts against std::sort/std::stable_sort, from 1k elements up to whatever's on the
+// command line, on random keys. Parallel runs the blocks through the job system.
+//
+//   sort_bench [max count] [job workers]
+
+struct NarrowElement
+{
+  u32 key;
+  u32 id;
+};
+
+struct Narrow64Element
+{
+  u64 key;
+  u64 id;
+};
+
+// Big enough that it gets sorted as (key, index) pairs
+struct WideElement
+{
+  u32 key;
+  u32 id;
+  u8  payload[40];
+};
+
+// Runs sort on a fresh copy of the same random elements over and over, so that small counts still take long enough
+// to time, and returns the average ns per element
+template <typename T, typename F>
+static f64
+time_sort(u32 count, F sort)
+{
+  static constexpr u64 kElementsPerRun = 1 << 22;
+
+  T* src  = (T*)malloc(sizeof(T) * count);
+  T* data = (T*)malloc(sizeof(T) * count);
+
+  TestRng rng;
+  for (u32 i = 0; i < count; i++)
+  {
+    src[i]     = T();
+    src[i].key = (decltype(T::key))test_rng_next(&rng);
+    src[i].id  = i;
+  }
+
+  u64 runs    = MAX(kElementsPerRun / count, 1ULL);
+  u64 elapsed = 0;
+  for (u64 irun = 0; irun < runs; irun++)
+  {
+    memcpy(data, src, sizeof(T) * count);
+
+    u64 start = get_bench_time_ns();
+    sort(data, count);
+    elapsed  += get_bench_time_ns() - start;
+  }
+
+  for (u32 i = 1; i < count; i++)
+  {
+    ASSERT_MSG_FATAL(data[i - 1].key <= data[i].key, "Element %u is out of order!", i);
+  }
+
+  free(data);
+  free(src);
+
+  return (f64)elapsed / (f64)(runs * count);
+}
+
+template <typename T>
+static bool
+sort_less(const T& lhs, const T& rhs)
+{
+  return lhs.key < rhs.key;
+}
+
+int
+main(int argc, char** argv)
+{
+  init_thread_context();
+
+  u32 max_count = (u32)get_bench_arg(argc, argv, 1, 1000000);
+  u32 workers   = (u32)get_bench_arg(argc, argv, 2, (u64)sysconf(_SC_NPROCESSORS_ONLN));
+
+  TestJobSystem    jobs     = init_test_job_system(workers);
+  ParallelDispatch dispatch = get_job_system_parallel_dispatch();
+
+  printf("ns per element, random keys, %u job workers\n\n", workers);
+  printf("%10s | %10s %10s %10s | %10s %10s | %10s %10s\n", "count", "std 8B", "radix 8B", "parallel", "std 16B", "radix64", "stable 48B", "radix 48B");
+  for (u32 count = 1000; count <= max_count; count *= 10)
+  {
+    f64 std_narrow      = time_sort<NarrowElement>  (count, [](NarrowElement* data, u32 n)   { std::sort(data, data + n, &sort_less<NarrowElement>); });
+    f64 radix_narrow    = time_sort<NarrowElement>  (count, [](NarrowElement* data, u32 n)   { radix_sort(data, n, sizeof(NarrowElement), offsetof(NarrowElement, key)); });
+    f64 parallel_narrow = time_sort<NarrowElement>  (count, [&](NarrowElement* data, u32 n)  { radix_sort(data, n, sizeof(NarrowElement), offsetof(NarrowElement, key), kSortIncreasing, &dispatch); });
+    f64 std_narrow64    = time_sort<Narrow64Element>(count, [](Narrow64Element* data, u32 n) { std::sort(data, data + n, &sort_less<Narrow64Element>); });
+    f64 radix_narrow64  = time_sort<Narrow64Element>(count, [](Narrow64Element* data, u32 n) { radix_sort_u64(data, n, sizeof(Narrow64Element), offsetof(Narrow64Element, key)); });
+    f64 std_wide        = time_sort<WideElement>    (count, [](WideElement* data, u32 n)     { std::stable_sort(data, data + n, &sort_less<WideElement>); });
+    f64 radix_wide      = time_sort<WideElement>    (count, [](WideElement* data, u32 n)     { radix_sort(data, n, sizeof(WideElement), offsetof(WideElement, key)); });
+
+    printf("%10u | %10.2f %10.2f %10.2f | %10.2f %10.2f | %10.2f %10.2f\n",
+           count,
+           std_narrow,
+           radix_narrow,
+           parallel_narrow,
+           std_narrow64,
+           radix_narrow64,
+           std_wide,
+           radix_wide);
+  }
+
+  destroy_test_job_system(&jobs);
+
+  return 0;
+}
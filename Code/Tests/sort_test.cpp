@@ -0,0 +1,172 @@
+#include "Tests/test.h"
+
+#include "Core/Foundation/context.h"
+#include "Core/Foundation/sort.h"
+
+#include <algorithm>
+
+// Big enough that it gets sorted as (key, index) pairs
+template <typename K>
+struct WideElement
+{
+  u32 pad;
+  K   key;
+  u32 id;
+  u8  payload[20];
+};
+
+// Small enough that it gets moved around directly
+template <typename K>
+struct NarrowElement
+{
+  K   key;
+  u32 id;
+};
+
+// One thread per block, so that blocks really do run at the same time
+struct ThreadDispatchBlock
+{
+  void (*fn)(void* ctx, u32 block);
+  void* ctx;
+  u32   block;
+};
+
+static u32
+dispatch_block_thread(void* param)
+{
+  auto* block = (ThreadDispatchBlock*)param;
+  block->fn(block->ctx, block->block);
+  return 0;
+}
+
+static void
+thread_dispatch(void* user, u32 block_count, void (*fn)(void* ctx, u32 block), void* ctx)
+{
+  UNREFERENCED_PARAMETER(user);
+
+  // The sort never splits into more than 8 blocks
+  ThreadDispatchBlock blocks [8];
+  Thread              threads[8];
+  REQUIRE(block_count <= ARRAY_LENGTH(threads));
+
+  for (u32 iblock = 0; iblock < block_count; iblock++)
+  {
+    blocks[iblock]  = ThreadDispatchBlock{fn, ctx, iblock};
+    threads[iblock] = init_test_thread(&dispatch_block_thread, &blocks[iblock]);
+  }
+
+  join_threads(threads, block_count);
+  for (u32 iblock = 0; iblock < block_count; iblock++)
+  {
+    destroy_thread(&threads[iblock]);
+  }
+}
+
+// Blocks in reverse, nothing should depend on the order they run in
+static void
+reverse_dispatch(void* user, u32 block_count, void (*fn)(void* ctx, u32 block), void* ctx)
+{
+  UNREFERENCED_PARAMETER(user);
+
+  for (u32 iblock = block_count; iblock-- > 0;)
+  {
+    fn(ctx, iblock);
+  }
+}
+
+template <typename K, typename T>
+static void
+check_radix_sort(u32 count, SortOp op, u64 key_mask, const ParallelDispatch* dispatch)
+{
+  T* elements = (T*)calloc(MAX(count, 1U), sizeof(T));
+  T* expected = (T*)calloc(MAX(count, 1U), sizeof(T));
+
+  TestRng rng;
+  rng.state += count * 31 + op;
+  for (u32 i = 0; i < count; i++)
+  {
+    elements[i].key = (K)(test_rng_next(&rng) & key_mask);
+    elements[i].id  = i;
+  }
+  memcpy(expected, elements, sizeof(T) * count);
+  std::stable_sort(expected, expected + count, [op](const T& a, const T& b) { return op == kSortIncreasing ? a.key < b.key : a.key > b.key; });
+
+  if constexpr (sizeof(K) == sizeof(u64))
+  {
+    radix_sort_u64(elements, count, sizeof(T), offsetof(T, key), op, dispatch);
+  }
+  else
+  {
+    radix_sort(elements, count, sizeof(T), offsetof(T, key), op, dispatch);
+  }
+
+  for (u32 i = 0; i < count; i++)
+  {
+    if (elements[i].id != expected[i].id || elements[i].key != expected[i].key)
+    {
+      CHECK_MSG(false, "%zu byte keys, stride %zu, count %u, mask 0x%llx, op %u, %s: first mismatch at %u",
+                sizeof(K), sizeof(T), count, (unsigned long long)key_mask, op,
+                dispatch == nullptr ? "no dispatch" : dispatch->run == &thread_dispatch ? "threads" : "reverse", i);
+      break;
+    }
+  }
+
+  free(expected);
+  free(elements);
+}
+
+// Every digit, no digits (every pass skipped), digits that are skipped in between and only the low digits
+static constexpr u64 kKeyMasks[] = {~0ULL, 0, 0xFF00FF0000ULL, 0xFFFF};
+
+template <typename K, typename T>
+static void
+check_radix_sort_all(u32 count, u32 mask_count, const ParallelDispatch* dispatch)
+{
+  for (u32 imask = 0; imask < mask_count; imask++)
+  {
+    check_radix_sort<K, T>(count, kSortIncreasing, kKeyMasks[imask], dispatch);
+    check_radix_sort<K, T>(count, kSortDecreasing, kKeyMasks[imask], dispatch);
+  }
+}
+
+template <typename K>
+static void
+check_radix_sort_key(u32 count, u32 mask_count, const ParallelDispatch* dispatch)
+{
+  check_radix_sort_all<K, WideElement<K>  >(count, mask_count, dispatch);
+  check_radix_sort_all<K, NarrowElement<K>>(count, mask_count, dispatch);
+}
+
+int
+main()
+{
+  init_thread_context();
+
+  ParallelDispatch threads;
+  threads.run          = &thread_dispatch;
+  threads.thread_count = 4;
+
+  ParallelDispatch reverse;
+  reverse.run          = &reverse_dispatch;
+  reverse.thread_count = 8;
+
+  // Around the 8/11-bit digit switch
+  static constexpr u32 kCounts[] = {0, 1, 2, 17, 1000, 65535, 65536, 200000};
+  for (u32 count : kCounts)
+  {
+    check_radix_sort_key<u32>(count, ARRAY_LENGTH(kKeyMasks), nullptr);
+    check_radix_sort_key<u64>(count, ARRAY_LENGTH(kKeyMasks), nullptr);
+  }
+
+  // Big enough to get split into 2 and 4 blocks. These are slow to check, so only the masks that make it skip every
+  // digit, none of them or some of them.
+  static constexpr u32 kBlockedCounts[] = {600000, 1100000};
+  for (u32 count : kBlockedCounts)
+  {
+    check_radix_sort_key<u32>(count, 3, &threads);
+    check_radix_sort_key<u64>(count, 3, &threads);
+  }
+  check_radix_sort_key<u64>(1100000, 3, &reverse);
+
+  return finish_test("sort_test");
+}
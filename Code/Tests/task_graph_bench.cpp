@@ -0,0 +1,188 @@
+#include "Tests/job_test.h"
+#include "Tests/bench.h"
+
+#include "Core/Foundation/context.h"
+
+#include "Core/Engine/task_graph.h"
+
+#include <unistd.h>
+
+// What a frame's worth of small tasks costs to get through the job system:
+//
+//   graph      a compiled task graph launched once per frame
+//   rebuilt    the same graph built and compiled from scratch every frame
+//   levels     no graph, kicking every level of tasks by hand and waiting for it before kicking the next one
+//
+// and then parallel_for against kicking one job per chunk by hand, over a range with a little work per element.
+//
+//   task_graph_bench [frames] [job workers]
+
+static constexpr u32 kLayerCount = 8;
+static constexpr u32 kLayerWidth = 32;
+static constexpr u32 kTaskCount  = kLayerCount * kLayerWidth;
+static constexpr u32 kWorkRounds = 64;
+static constexpr u64 kForCount   = 1 << 18;
+
+static u64 g_WorkSink = 0;
+
+static void
+do_work(u64 seed, u32 rounds)
+{
+  u64 x = seed | 1;
+  for (u32 i = 0; i < rounds; i++)
+  {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+  }
+  atomic_ref_fetch_add(&g_WorkSink, x, std::memory_order_relaxed);
+}
+
+// Every task depends on the two tasks right above it in the previous layer
+static TaskGraph
+build_frame_graph(AllocHeap heap)
+{
+  TaskGraphBuilder builder = init_task_graph_builder(heap, kTaskCount, kTaskCount * 2);
+  for (TaskId task = 0; task < kTaskCount; task++)
+  {
+    task_graph_add(&builder, kJobPriorityHigh, do_work(task, kWorkRounds));
+  }
+
+  for (u32 ilayer = 1; ilayer < kLayerCount; ilayer++)
+  {
+    for (u32 i = 0; i < kLayerWidth; i++)
+    {
+      TaskId prev = (ilayer - 1) * kLayerWidth;
+      task_graph_add_dependency(&builder, ilayer * kLayerWidth + i, prev + i);
+      task_graph_add_dependency(&builder, ilayer * kLayerWidth + i, prev + (i + 1) % kLayerWidth);
+    }
+  }
+
+  return compile_task_graph(heap, &builder);
+}
+
+static void
+run_graph_frames(u32 frames)
+{
+  LinearAllocator graph_allocator = init_linear_allocator(MiB(1), MiB(64));
+  TaskGraph       graph           = build_frame_graph(graph_allocator);
+  for (u32 iframe = 0; iframe < frames; iframe++)
+  {
+    yield_to_counter(launch_task_graph(&graph));
+  }
+  destroy_linear_allocator(&graph_allocator);
+}
+
+static void
+run_rebuilt_graph_frames(u32 frames)
+{
+  LinearAllocator frame_allocator = init_linear_allocator(MiB(1), MiB(64));
+  for (u32 iframe = 0; iframe < frames; iframe++)
+  {
+    reset_linear_allocator(&frame_allocator);
+    TaskGraph graph = build_frame_graph(frame_allocator);
+    yield_to_counter(launch_task_graph(&graph));
+  }
+  destroy_linear_allocator(&frame_allocator);
+}
+
+static void
+run_level_frames(u32 frames)
+{
+  JobDesc jobs[kLayerWidth];
+  for (u32 iframe = 0; iframe < frames; iframe++)
+  {
+    for (u32 ilayer = 0; ilayer < kLayerCount; ilayer++)
+    {
+      for (u32 i = 0; i < kLayerWidth; i++)
+      {
+        u64 seed = ilayer * kLayerWidth + i;
+        jobs[i]  = init_job_desc_from_closure([seed]() { do_work(seed, kWorkRounds); });
+      }
+      yield_to_counter(kick_job_descs(kJobPriorityHigh, jobs, kLayerWidth));
+    }
+  }
+}
+
+static void
+run_parallel_for(u64 grain)
+{
+  parallel_for(0, kForCount, grain, [](u64 begin, u64 end)
+  {
+    for (u64 i = begin; i < end; i++)
+    {
+      do_work(i, 4);
+    }
+  });
+}
+
+// Chunks of grain elements, all of them kicked at once
+static void
+run_chunk_jobs(u64 grain)
+{
+  u32      chunk_count = (u32)UCEIL_DIV(kForCount, grain);
+  JobDesc* jobs        = (JobDesc*)malloc(sizeof(JobDesc) * chunk_count);
+  for (u32 ichunk = 0; ichunk < chunk_count; ichunk++)
+  {
+    u64 begin    = ichunk * grain;
+    u64 end      = MIN(begin + grain, kForCount);
+    jobs[ichunk] = init_job_desc_from_closure([begin, end]()
+    {
+      for (u64 i = begin; i < end; i++)
+      {
+        do_work(i, 4);
+      }
+    });
+  }
+  yield_to_counter(kick_job_descs(kJobPriorityHigh, jobs, chunk_count));
+  free(jobs);
+}
+
+int
+main(int argc, char** argv)
+{
+  init_thread_context();
+
+  u32 frames  = (u32)get_bench_arg(argc, argv, 1, 2000);
+  u32 workers = (u32)get_bench_arg(argc, argv, 2, (u64)sysconf(_SC_NPROCESSORS_ONLN));
+
+  // Enough for every chunk of the smallest grain to be in flight at once
+  TestJobSystem jobs = init_test_job_system(workers, 8192);
+
+  printf("%u job workers\n\n", workers);
+  printf("%u frames of %u layers x %u tasks, us per frame\n", frames, kLayerCount, kLayerWidth);
+  printf("%10s %10s %10s\n", "graph", "rebuilt", "levels");
+
+  u64 start = get_bench_time_ns();
+  blocking_kick_job(kJobPriorityHigh, run_graph_frames(frames));
+  f64 graph_us = get_bench_ns_per_op(start, frames) / 1000.0;
+
+  start = get_bench_time_ns();
+  blocking_kick_job(kJobPriorityHigh, run_rebuilt_graph_frames(frames));
+  f64 rebuilt_us = get_bench_ns_per_op(start, frames) / 1000.0;
+
+  start = get_bench_time_ns();
+  blocking_kick_job(kJobPriorityHigh, run_level_frames(frames));
+  f64 levels_us = get_bench_ns_per_op(start, frames) / 1000.0;
+
+  printf("%10.1f %10.1f %10.1f\n\n", graph_us, rebuilt_us, levels_us);
+
+  printf("%llu elements, ns per element\n", (unsigned long long)kForCount);
+  printf("%10s %14s %14s\n", "grain", "parallel_for", "chunk jobs");
+  for (u64 grain = 64; grain <= 16384; grain *= 4)
+  {
+    start = get_bench_time_ns();
+    blocking_kick_job(kJobPriorityHigh, run_parallel_for(grain));
+    f64 parallel_for_ns = get_bench_ns_per_op(start, kForCount);
+
+    start = get_bench_time_ns();
+    blocking_kick_job(kJobPriorityHigh, run_chunk_jobs(grain));
+    f64 chunk_ns = get_bench_ns_per_op(start, kForCount);
+
+    printf("%10llu %14.2f %14.2f\n", (unsigned long long)grain, parallel_for_ns, chunk_ns);
+  }
+
+  destroy_test_job_system(&jobs);
+
+  return 0;
+}
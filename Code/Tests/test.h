@@ -0,0 +1,119 @@
+#pragma once
+#include "Core/Foundation/types.h"
+#include "Core/Foundation/memory.h"
+#include "Core/Foundation/threading.h"
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Tests are plain executables that ctest runs, a non-zero exit code is a failure.
+// CHECK keeps going so that one run reports everything that's broken, REQUIRE bails out right away.
+
+inline u32 g_TestFailures = 0;
+
+#define CHECK(expr) \
+  do \
+  { \
+    if (expr) { } \
+    else \
+    { \
+      fprintf(stderr, "%s(%d): CHECK failed: %s\n", __FILE__, __LINE__, #expr); \
+      g_TestFailures++; \
+    } \
+  } while (0)
+
+#define CHECK_MSG(expr, msg, ...) \
+  do \
+  { \
+    if (expr) { } \
+    else \
+    { \
+      fprintf(stderr, "%s(%d): CHECK failed: %s: " msg "\n", __FILE__, __LINE__, #expr, ##__VA_ARGS__); \
+      g_TestFailures++; \
+    } \
+  } while (0)
+
+#define REQUIRE(expr) \
+  do \
+  { \
+    if (expr) { } \
+    else \
+    { \
+      fprintf(stderr, "%s(%d): REQUIRE failed: %s\n", __FILE__, __LINE__, #expr); \
+      exit(1); \
+    } \
+  } while (0)
+
+inline int
+finish_test(const char* name)
+{
+  if (g_TestFailures != 0)
+  {
+    fprintf(stderr, "%s: %u checks failed\n", name, g_TestFailures);
+    return 1;
+  }
+
+  printf("%s: passed\n", name);
+  return 0;
+}
+
+// xorshift64*, the tests want the same sequence on every run and platform.
+struct TestRng
+{
+  u64 state = 0x9E3779B97F4A7C15ULL;
+};
+
+inline u64
+test_rng_next(TestRng* rng)
+{
+  rng->state ^= rng->state >> 12;
+  rng->state ^= rng->state << 25;
+  rng->state ^= rng->state >> 27;
+  return rng->state * 0x2545F4914F6CDD1DULL;
+}
+
+// [0, max)
+inline u32
+test_rng_range(TestRng* rng, u32 max)
+{
+  return (u32)(test_rng_next(rng) % max);
+}
+
+// Monotonic, for timeouts
+inline u64
+get_test_time_ms()
+{
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (u64)now.tv_sec * 1000 + (u64)now.tv_nsec / 1000000;
+}
+
+// Every cpu the process is allowed on. Pinning test threads to specific cores would fail on machines (and containers)
+// that don't have those cores.
+inline CpuSet
+get_test_cpus()
+{
+  cpu_set_t affinity;
+  CPU_ZERO(&affinity);
+  sched_getaffinity(0, sizeof(affinity), &affinity);
+
+  CpuSet cpus;
+  for (u32 cpu = 0; cpu < CPU_SETSIZE && cpu < kMaxCpuCount; cpu++)
+  {
+    if (CPU_ISSET(cpu, &affinity))
+    {
+      cpu_set_add(&cpus, cpu);
+    }
+  }
+
+  return cpus;
+}
+
+// Threads for stress tests
+inline Thread
+init_test_thread(ThreadProc proc, void* param)
+{
+  return init_thread((AllocHeap)GLOBAL_HEAP, KiB(256), proc, param, get_test_cpus());
+}
@@ -0,0 +1,587 @@
+#include "Tests/test.h"
+
+#include "Core/Tools/AssetBuilder/texture_mips.h"
+
+#include <math.h>
+#include <string.h>
+
+// Every mip chain gets checked against a straightforward double precision version of the same filters, and the AVX2
+// and SSE paths have to come up with exactly the same bytes.
+
+static constexpr f64 kKaiserRadius = 3.0;
+static constexpr f64 kKaiserBeta   = 4.0;
+
+static f64
+ref_srgb_to_linear(f64 srgb)
+{
+  return srgb <= 0.04045 ? srgb / 12.92 : pow((srgb + 0.055) / 1.055, 2.4);
+}
+
+static f64
+ref_linear_to_srgb(f64 linear)
+{
+  return linear <= 0.0031308 ? linear * 12.92 : 1.055 * pow(linear, 1.0 / 2.4) - 0.055;
+}
+
+static u8
+ref_quantize(f64 val)
+{
+  return (u8)floor(CLAMP(val, 0.0, 1.0) * 255.0 + 0.5);
+}
+
+static f64
+ref_bessel_i0(f64 x)
+{
+  f64 ret  = 1.0;
+  f64 term = 1.0;
+  for (u32 k = 1; k < 64; k++)
+  {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    ret  += term;
+  }
+  return ret;
+}
+
+static f64
+ref_kaiser_sinc(f64 x)
+{
+  f64 t = x / kKaiserRadius;
+  if (t <= -1.0 || t >= 1.0)
+  {
+    return 0.0;
+  }
+
+  f64 sinc = x == 0.0 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+  return sinc * ref_bessel_i0(kKaiserBeta * sqrt(1.0 - t * t)) / ref_bessel_i0(kKaiserBeta);
+}
+
+// Normalized weight of every source texel for destination texel dst along one axis
+static void
+ref_weights(f64* weights, u32 src_count, u32 dst_count, u32 dst, MipFilter filter)
+{
+  f64 scale = (f64)src_count / (f64)dst_count;
+  f64 total = 0.0;
+  zero_memory(weights, src_count * sizeof(f64));
+
+  if (filter == kMipFilterKaiser)
+  {
+    f64 center = (dst + 0.5) * scale;
+    for (s32 j = (s32)floor(center - kKaiserRadius * scale); j <= (s32)ceil(center + kKaiserRadius * scale); j++)
+    {
+      f64 weight = ref_kaiser_sinc((j + 0.5 - center) / scale);
+      weights[((j % (s32)src_count) + (s32)src_count) % (s32)src_count] += weight;
+      total += weight;
+    }
+  }
+  else
+  {
+    f64 begin = dst * scale;
+    f64 end   = (dst + 1) * scale;
+    for (u32 j = 0; j < src_count; j++)
+    {
+      f64 weight = MIN(end, j + 1.0) - MAX(begin, (f64)j);
+      if (weight > 0.0)
+      {
+        weights[j] = weight;
+        total     += weight;
+      }
+    }
+  }
+
+  for (u32 j = 0; j < src_count; j++)
+  {
+    weights[j] /= total;
+  }
+}
+
+static f64*
+ref_decode(const u8* rgba8, u64 texel_count, TextureUsage usage)
+{
+  f64* ret = (f64*)malloc(texel_count * 4 * sizeof(f64));
+  for (u64 i = 0; i < texel_count * 4; i++)
+  {
+    f64  val = rgba8[i] / 255.0;
+    bool rgb = (i & 3) != 3;
+    if (rgb && usage == kTextureUsageColor)
+    {
+      val = ref_srgb_to_linear(val);
+    }
+    else if (rgb && usage == kTextureUsageNormal)
+    {
+      val = val * 2.0 - 1.0;
+    }
+    ret[i] = val;
+  }
+  return ret;
+}
+
+// One mip down from src, clamped and renormalized the same way as generate_mip_chain does before the next one
+static f64*
+ref_downsample(const f64* src, u32 src_width, u32 src_height, u32 dst_width, u32 dst_height, TextureUsage usage, MipFilter filter)
+{
+  f64* ret       = (f64*)calloc((u64)dst_width * dst_height * 4, sizeof(f64));
+  f64* x_weights = (f64*)malloc(src_width  * sizeof(f64));
+  f64* y_weights = (f64*)malloc(src_height * sizeof(f64));
+
+  for (u32 y = 0; y < dst_height; y++)
+  {
+    ref_weights(y_weights, src_height, dst_height, y, filter);
+    for (u32 x = 0; x < dst_width; x++)
+    {
+      ref_weights(x_weights, src_width, dst_width, x, filter);
+
+      f64* out = ret + ((u64)y * dst_width + x) * 4;
+      for (u32 j = 0; j < src_height; j++)
+      {
+        for (u32 i = 0; i < src_width; i++)
+        {
+          f64 weight = x_weights[i] * y_weights[j];
+          if (weight == 0.0)
+          {
+            continue;
+          }
+
+          for (u32 c = 0; c < 4; c++)
+          {
+            out[c] += weight * src[((u64)j * src_width + i) * 4 + c];
+          }
+        }
+      }
+
+      if (usage == kTextureUsageNormal)
+      {
+        f64 len = sqrt(out[0] * out[0] + out[1] * out[1] + out[2] * out[2]);
+        for (u32 c = 0; c < 3; c++)
+        {
+          out[c] = len < 1e-6 ? (c == 2 ? 1.0 : 0.0) : out[c] / len;
+        }
+        out[3] = CLAMP(out[3], 0.0, 1.0);
+      }
+      else
+      {
+        for (u32 c = 0; c < 4; c++)
+        {
+          out[c] = CLAMP(out[c], 0.0, 1.0);
+        }
+      }
+    }
+  }
+
+  free(x_weights);
+  free(y_weights);
+  return ret;
+}
+
+static u8
+ref_encode(f64 val, u32 channel, TextureUsage usage)
+{
+  if (channel < 3 && usage == kTextureUsageColor)
+  {
+    return ref_quantize(ref_linear_to_srgb(val));
+  }
+  else if (channel < 3 && usage == kTextureUsageNormal)
+  {
+    return ref_quantize(val * 0.5 + 0.5);
+  }
+  return ref_quantize(val);
+}
+
+// Largest difference of any byte in any mip from the reference. Color textures need opaque alpha here, since the
+// reference doesn't do alpha coverage preservation.
+static u32
+get_max_ref_diff(const MipChain& chain, const MipChainParams& params)
+{
+  u32  ret       = 0;
+  u32  width     = chain.mips[0].width;
+  u32  height    = chain.mips[0].height;
+  f64* reference = ref_decode(chain.mips[0].buf, (u64)width * height, params.usage);
+  for (u32 imip = 1; imip < chain.mip_count; imip++)
+  {
+    const MipLevel* mip  = &chain.mips[imip];
+    f64*            next = ref_downsample(reference, width, height, mip->width, mip->height, params.usage, params.filter);
+    free(reference);
+    reference = next;
+    width     = mip->width;
+    height    = mip->height;
+
+    for (u64 i = 0; i < (u64)width * height * 4; i++)
+    {
+      s32 diff = (s32)mip->buf[i] - (s32)ref_encode(reference[i], (u32)(i & 3), params.usage);
+      ret      = MAX(ret, (u32)abs(diff));
+    }
+  }
+  free(reference);
+
+  return ret;
+}
+
+static bool
+mip_chains_equal(const MipChain& a, const MipChain& b)
+{
+  if (a.mip_count != b.mip_count)
+  {
+    return false;
+  }
+
+  for (u32 imip = 0; imip < a.mip_count; imip++)
+  {
+    const MipLevel* mip_a = &a.mips[imip];
+    const MipLevel* mip_b = &b.mips[imip];
+    if (mip_a->width != mip_b->width || mip_a->height != mip_b->height || memcmp(mip_a->buf, mip_b->buf, (u64)mip_a->width * mip_a->height * 4) != 0)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static u8*
+alloc_random_texture(TestRng* rng, u32 width, u32 height, bool opaque)
+{
+  u8* ret = (u8*)malloc((u64)width * height * 4);
+  for (u64 i = 0; i < (u64)width * height * 4; i++)
+  {
+    ret[i] = opaque && (i & 3) == 3 ? 255 : (u8)test_rng_next(rng);
+  }
+  return ret;
+}
+
+static void
+test_mip_counts()
+{
+  CHECK(get_mip_count(1, 1)       == 1);
+  CHECK(get_mip_count(4096, 4096) == 13);
+  CHECK(get_mip_count(1024, 512)  == 11);
+  CHECK(get_mip_count(1000, 600)  == 10);
+  CHECK(get_mip_count(1, 7)       == 3);
+
+  // Odd sizes round down, and the short side stops at 1 while the long side keeps going
+  static const u32 kExpected[][2] = { {37, 13}, {18, 6}, {9, 3}, {4, 1}, {2, 1}, {1, 1} };
+
+  TestRng  rng;
+  u8*      texture = alloc_random_texture(&rng, 37, 13, false);
+  MipChain chain   = generate_mip_chain(GLOBAL_HEAP, texture, 37, 13, MipChainParams());
+  REQUIRE(chain.mip_count == ARRAY_LENGTH(kExpected));
+  for (u32 imip = 0; imip < chain.mip_count; imip++)
+  {
+    CHECK(chain.mips[imip].width == kExpected[imip][0] && chain.mips[imip].height == kExpected[imip][1]);
+  }
+  CHECK(chain.mips[0].buf == texture);
+
+  free_mip_chain(GLOBAL_HEAP, &chain);
+  free(texture);
+}
+
+// Power of two and odd sizes, so that both the 2x2 box fast path and the separable filters (and the AVX2 versions'
+// odd width tails) get run
+static const u32 kSizes[][2] =
+{
+  {64, 64}, {32, 8}, {37, 13}, {13, 37}, {33, 32}, {6, 10}, {1, 7}, {5, 1}, {3, 3},
+};
+
+static void
+test_against_reference(MipFilter filter)
+{
+  TestRng rng;
+  for (u32 isize = 0; isize < ARRAY_LENGTH(kSizes); isize++)
+  {
+    u32 width  = kSizes[isize][0];
+    u32 height = kSizes[isize][1];
+    for (u32 usage = 0; usage < kTextureUsageCount; usage++)
+    {
+      MipChainParams params;
+      params.usage  = (TextureUsage)usage;
+      params.filter = filter;
+
+      u8*      texture = alloc_random_texture(&rng, width, height, usage == kTextureUsageColor);
+      MipChain chain   = generate_mip_chain(GLOBAL_HEAP, texture, width, height, params);
+
+      // Only rounding is allowed to be off
+      u32 diff = get_max_ref_diff(chain, params);
+      CHECK_MSG(diff <= 1, "%ux%u %s %s mips are off from the reference by %u", width, height, texture_usage_to_str(params.usage), filter == kMipFilterBox ? "box" : "Kaiser", diff);
+
+      free_mip_chain(GLOBAL_HEAP, &chain);
+      free(texture);
+    }
+  }
+}
+
+static void
+test_avx2_matches_sse()
+{
+  printf("texture_mips_test: %s\n", cpu_supports_avx2() ? "comparing AVX2 against SSE" : "no AVX2, both run SSE");
+
+  TestRng rng;
+  for (u32 isize = 0; isize < ARRAY_LENGTH(kSizes) + 1; isize++)
+  {
+    // Plus one big one, so that the AVX2 loops get more than a couple of iterations
+    u32 width  = isize < ARRAY_LENGTH(kSizes) ? kSizes[isize][0] : 509;
+    u32 height = isize < ARRAY_LENGTH(kSizes) ? kSizes[isize][1] : 256;
+    for (u32 usage = 0; usage < kTextureUsageCount; usage++)
+    {
+      u8* texture = alloc_random_texture(&rng, width, height, false);
+      for (MipFilter filter : {kMipFilterBox, kMipFilterKaiser})
+      {
+        MipChainParams params;
+        params.usage  = (TextureUsage)usage;
+        params.filter = filter;
+        // Low enough that random alpha has partial coverage, so the coverage scale gets compared too
+        params.alpha_cutoff = 0.5f;
+
+        MipChain avx2 = generate_mip_chain(GLOBAL_HEAP, texture, width, height, params);
+        params.force_sse = true;
+        MipChain sse  = generate_mip_chain(GLOBAL_HEAP, texture, width, height, params);
+
+        CHECK_MSG(mip_chains_equal(avx2, sse), "%ux%u %s %s mips differ between AVX2 and SSE", width, height, texture_usage_to_str(params.usage), filter == kMipFilterBox ? "box" : "Kaiser");
+
+        free_mip_chain(GLOBAL_HEAP, &avx2);
+        free_mip_chain(GLOBAL_HEAP, &sse);
+      }
+      free(texture);
+    }
+  }
+}
+
+static void
+test_srgb()
+{
+  // A 1px black and white checkerboard averages to half the light, which is 188 in sRGB and not 128
+  static constexpr u32 kSize = 64;
+  u8* checker = (u8*)malloc(kSize * kSize * 4);
+  for (u32 y = 0; y < kSize; y++)
+  {
+    for (u32 x = 0; x < kSize; x++)
+    {
+      u8* texel = checker + (y * kSize + x) * 4;
+      memset(texel, ((x ^ y) & 1) ? 255 : 0, 3);
+      texel[3] = 255;
+    }
+  }
+
+  for (MipFilter filter : {kMipFilterBox, kMipFilterKaiser})
+  {
+    MipChainParams params;
+    params.usage  = kTextureUsageColor;
+    params.filter = filter;
+
+    MipChain color = generate_mip_chain(GLOBAL_HEAP, checker, kSize, kSize, params);
+    params.usage   = kTextureUsageLinear;
+    MipChain linear = generate_mip_chain(GLOBAL_HEAP, checker, kSize, kSize, params);
+    for (u32 imip = 1; imip < color.mip_count; imip++)
+    {
+      for (u64 i = 0; i < (u64)color.mips[imip].width * color.mips[imip].height; i++)
+      {
+        CHECK(color.mips[imip].buf[i * 4 + 0]  == 188 && color.mips[imip].buf[i * 4 + 3] == 255);
+        CHECK(linear.mips[imip].buf[i * 4 + 0] == 128);
+      }
+    }
+    free_mip_chain(GLOBAL_HEAP, &color);
+    free_mip_chain(GLOBAL_HEAP, &linear);
+  }
+
+  // Every pair of bytes averages to exactly the rounded sRGB value of their linear average, unless that's so close to
+  // halfway between two bytes that f32 can't tell
+  u8* pairs = (u8*)malloc(512 * 2 * 4);
+  for (u32 a = 0; a < 256; a++)
+  {
+    for (u32 i = 0; i < 512 * 2; i++)
+    {
+      u8* texel = pairs + i * 4;
+      texel[0]  = (i & 1) ? (u8)a : (u8)((i % 512) / 2);
+      texel[1]  = texel[0];
+      texel[2]  = texel[0];
+      texel[3]  = 255;
+    }
+
+    MipChainParams params;
+    params.usage   = kTextureUsageColor;
+    MipChain chain = generate_mip_chain(GLOBAL_HEAP, pairs, 512, 2, params);
+    for (u32 b = 0; b < 256; b++)
+    {
+      f64 srgb = ref_linear_to_srgb((ref_srgb_to_linear(a / 255.0) + ref_srgb_to_linear(b / 255.0)) / 2.0) * 255.0;
+      if (fabs(srgb - floor(srgb) - 0.5) > 1e-3)
+      {
+        CHECK_MSG(chain.mips[1].buf[b * 4] == ref_quantize(srgb / 255.0), "%u and %u averaged to %u instead of %u", a, b, chain.mips[1].buf[b * 4], ref_quantize(srgb / 255.0));
+      }
+    }
+    free_mip_chain(GLOBAL_HEAP, &chain);
+  }
+  free(pairs);
+
+  // Going to linear and back has to be lossless for every byte, otherwise flat colors would drift down the chain
+  u8 flat[5 * 3 * 4];
+  for (u32 val = 0; val < 256; val++)
+  {
+    for (u32 i = 0; i < ARRAY_LENGTH(flat); i += 4)
+    {
+      flat[i + 0] = (u8)val;
+      flat[i + 1] = (u8)(255 - val);
+      flat[i + 2] = (u8)(val * 7);
+      flat[i + 3] = 255;
+    }
+
+    for (MipFilter filter : {kMipFilterBox, kMipFilterKaiser})
+    {
+      MipChainParams params;
+      params.usage  = kTextureUsageColor;
+      params.filter = filter;
+
+      MipChain chain = generate_mip_chain(GLOBAL_HEAP, flat, 5, 3, params);
+      for (u32 imip = 1; imip < chain.mip_count; imip++)
+      {
+        for (u64 i = 0; i < (u64)chain.mips[imip].width * chain.mips[imip].height; i++)
+        {
+          CHECK_MSG(memcmp(chain.mips[imip].buf + i * 4, flat, 4) == 0, "flat %u didn't stay flat in mip %u", val, imip);
+        }
+      }
+      free_mip_chain(GLOBAL_HEAP, &chain);
+    }
+  }
+
+  free(checker);
+}
+
+// Amplitude of a horizontal sine after one mip
+static f64
+get_filtered_amplitude(f64 frequency, MipFilter filter)
+{
+  static constexpr u32 kSize = 256;
+  u8* texture = (u8*)malloc(kSize * kSize * 4);
+  for (u32 y = 0; y < kSize; y++)
+  {
+    for (u32 x = 0; x < kSize; x++)
+    {
+      u8* texel = texture + (y * kSize + x) * 4;
+      memset(texel, ref_quantize(0.5 + 0.4 * sin(2.0 * M_PI * frequency * x)), 3);
+      texel[3] = 255;
+    }
+  }
+
+  MipChainParams params;
+  params.filter  = filter;
+  MipChain chain = generate_mip_chain(GLOBAL_HEAP, texture, kSize, kSize, params);
+
+  u32 lo = 255;
+  u32 hi = 0;
+  for (u32 x = 0; x < chain.mips[1].width; x++)
+  {
+    lo = MIN(lo, (u32)chain.mips[1].buf[x * 4]);
+    hi = MAX(hi, (u32)chain.mips[1].buf[x * 4]);
+  }
+
+  free_mip_chain(GLOBAL_HEAP, &chain);
+  free(texture);
+
+  return (hi - lo) / 2.0 / 255.0;
+}
+
+static void
+test_kaiser_response()
+{
+  // Kaiser keeps more of what's well below the new Nyquist than box does, and gets rid of more of what's above it
+  f64 box_pass    = get_filtered_amplitude(1.0 / 8.0, kMipFilterBox);
+  f64 kaiser_pass = get_filtered_amplitude(1.0 / 8.0, kMipFilterKaiser);
+  f64 box_stop    = get_filtered_amplitude(0.4,       kMipFilterBox);
+  f64 kaiser_stop = get_filtered_amplitude(0.4,       kMipFilterKaiser);
+  CHECK_MSG(kaiser_pass > box_pass, "passband: Kaiser %f, box %f", kaiser_pass, box_pass);
+  CHECK_MSG(kaiser_stop < box_stop && kaiser_stop < 0.05, "stopband: Kaiser %f, box %f", kaiser_stop, box_stop);
+}
+
+static void
+test_normals()
+{
+  static constexpr u32 kSize = 16;
+  u8* texture = (u8*)malloc(kSize * kSize * 4);
+
+  // Stripes at +-45 degrees average out to straight up once they're renormalized
+  for (u32 i = 0; i < kSize * kSize; i++)
+  {
+    u8* texel = texture + i * 4;
+    texel[0]  = ref_quantize((i & 1) ? 0.5 + 0.5 * M_SQRT1_2 : 0.5 - 0.5 * M_SQRT1_2);
+    texel[1]  = 128;
+    texel[2]  = ref_quantize(0.5 + 0.5 * M_SQRT1_2);
+    texel[3]  = 255;
+  }
+
+  MipChainParams params;
+  params.usage   = kTextureUsageNormal;
+  MipChain chain = generate_mip_chain(GLOBAL_HEAP, texture, kSize, kSize, params);
+  CHECK(abs((s32)chain.mips[1].buf[0] - 128) <= 1 && abs((s32)chain.mips[1].buf[1] - 128) <= 1 && chain.mips[1].buf[2] == 255);
+  free_mip_chain(GLOBAL_HEAP, &chain);
+
+  // Opposite normals cancel out completely, which falls back to straight up
+  for (u32 i = 0; i < kSize * kSize; i++)
+  {
+    memset(texture + i * 4, (i & 1) ? 255 : 0, 3);
+  }
+  chain = generate_mip_chain(GLOBAL_HEAP, texture, kSize, kSize, params);
+  CHECK(chain.mips[1].buf[2] == 255);
+  free_mip_chain(GLOBAL_HEAP, &chain);
+
+  free(texture);
+}
+
+static void
+test_alpha_coverage()
+{
+  // Opaque discs on a transparent background, like foliage
+  static constexpr u32 kSize = 256;
+  u8* texture = (u8*)calloc(kSize * kSize, 4);
+
+  TestRng rng;
+  for (u32 idisc = 0; idisc < 80; idisc++)
+  {
+    s32 cx     = (s32)test_rng_range(&rng, kSize);
+    s32 cy     = (s32)test_rng_range(&rng, kSize);
+    s32 radius = 2 + (s32)test_rng_range(&rng, 6);
+    for (s32 y = -radius; y <= radius; y++)
+    {
+      for (s32 x = -radius; x <= radius; x++)
+      {
+        if (x * x + y * y <= radius * radius)
+        {
+          u8* texel = texture + (((cy + y) & (kSize - 1)) * kSize + ((cx + x) & (kSize - 1))) * 4;
+          texel[1]  = 160;
+          texel[3]  = 255;
+        }
+      }
+    }
+  }
+
+  for (f32 cutoff : {kTextureAlphaTestCutoff, 0.5f})
+  {
+    f32 target = get_alpha_coverage(texture, kSize, kSize, cutoff);
+    REQUIRE(target > 0.0f && target < 1.0f);
+
+    MipChainParams params;
+    params.usage        = kTextureUsageColor;
+    params.alpha_cutoff = cutoff;
+    MipChain chain      = generate_mip_chain(GLOBAL_HEAP, texture, kSize, kSize, params);
+
+    // Below 16x16 there aren't enough texels left to get close
+    for (u32 imip = 1; imip < chain.mip_count && chain.mips[imip].width >= 16; imip++)
+    {
+      f32 coverage = get_alpha_coverage(chain.mips[imip].buf, chain.mips[imip].width, chain.mips[imip].height, cutoff);
+      CHECK_MSG(fabsf(coverage - target) < 0.01f, "cutoff %.2f mip %u has coverage %f instead of %f", cutoff, imip, coverage, target);
+    }
+    free_mip_chain(GLOBAL_HEAP, &chain);
+  }
+
+  free(texture);
+}
+
+int
+main()
+{
+  test_mip_counts();
+  test_against_reference(kMipFilterBox);
+  test_against_reference(kMipFilterKaiser);
+  test_avx2_matches_sse();
+  test_srgb();
+  test_kaiser_response();
+  test_normals();
+  test_alpha_coverage();
+
+  return finish_test("texture_mips_test");
+}
@@ -0,0 +1,475 @@
+#include "Tests/test.h"
+
+#include "Core/Foundation/context.h"
+
+static constexpr u32 kLockThreads    = 4;
+static constexpr u32 kLockIterations = 20000;
+
+enum LockKind : u32
+{
+  kLockMutex,
+  kLockSpin,
+  kLockRWWrite,
+};
+
+struct LockTest
+{
+  LockKind kind;
+  Mutex    mutex;
+  SpinLock spin_lock;
+  RWLock   rw_lock;
+
+  // Only ever touched with the lock held, so no atomics. A torn pair means two threads were in at once.
+  u64      a = 0;
+  u64      b = 0;
+  u32      torn_reads = 0;
+};
+
+static u32
+lock_test_thread(void* param)
+{
+  LockTest* test = (LockTest*)param;
+  for (u32 i = 0; i < kLockIterations; i++)
+  {
+    switch (test->kind)
+    {
+      case kLockMutex:   mutex_acquire(&test->mutex);       break;
+      case kLockSpin:    spin_acquire(&test->spin_lock);    break;
+      case kLockRWWrite: rw_acquire_write(&test->rw_lock);  break;
+      default: UNREACHABLE;
+    }
+
+    test->a++;
+    if ((i & 63) == 0)
+    {
+      // Give whoever's waiting a chance to barge in if the lock is broken
+      yield_current_thread();
+    }
+    test->b++;
+
+    switch (test->kind)
+    {
+      case kLockMutex:   mutex_release(&test->mutex);       break;
+      case kLockSpin:    spin_release(&test->spin_lock);    break;
+      case kLockRWWrite: rw_release_write(&test->rw_lock);  break;
+      default: UNREACHABLE;
+    }
+
+    // Half of the RWLock threads only read, and have to always see a and b move together
+    if (test->kind == kLockRWWrite)
+    {
+      rw_acquire_read(&test->rw_lock);
+      if (test->a != test->b)
+      {
+        test->torn_reads++;
+      }
+      rw_release_read(&test->rw_lock);
+    }
+  }
+
+  return 0;
+}
+
+static void
+test_mutual_exclusion()
+{
+  static constexpr LockKind kKinds[] = {kLockMutex, kLockSpin, kLockRWWrite};
+  for (LockKind kind : kKinds)
+  {
+    static LockTest test;
+    test           = LockTest();
+    test.kind      = kind;
+    test.spin_lock = init_spin_lock();
+
+    Thread threads[kLockThreads];
+    for (u32 ithread = 0; ithread < kLockThreads; ithread++)
+    {
+      threads[ithread] = init_test_thread(&lock_test_thread, &test);
+    }
+
+    join_threads(threads, kLockThreads);
+    for (u32 ithread = 0; ithread < kLockThreads; ithread++)
+    {
+      destroy_thread(&threads[ithread]);
+    }
+
+    CHECK_MSG(test.a == kLockThreads * kLockIterations && test.b == test.a, "lock kind %u: a = %llu, b = %llu", kind, (unsigned long long)test.a, (unsigned long long)test.b);
+    CHECK(test.torn_reads == 0);
+  }
+}
+
+static u32
+try_acquire_thread(void* param)
+{
+  LockTest* test = (LockTest*)param;
+  if (!try_mutex_acquire(&test->mutex))
+  {
+    test->a = 1;
+  }
+  if (!try_spin_acquire(&test->spin_lock, 1000))
+  {
+    test->b = 1;
+  }
+  return 0;
+}
+
+static void
+test_try_acquire()
+{
+  static LockTest test;
+  test           = LockTest();
+  test.spin_lock = init_spin_lock();
+
+  mutex_acquire(&test.mutex);
+  spin_acquire(&test.spin_lock);
+
+  // Both are held by this thread, so the other one can't get them
+  Thread thread = init_test_thread(&try_acquire_thread, &test);
+  join_threads(&thread, 1);
+  destroy_thread(&thread);
+  CHECK(test.a == 1);
+  CHECK(test.b == 1);
+
+  mutex_release(&test.mutex);
+  spin_release(&test.spin_lock);
+
+  CHECK(try_mutex_acquire(&test.mutex));
+  CHECK(!try_mutex_acquire(&test.mutex));
+  mutex_release(&test.mutex);
+
+  CHECK(try_spin_acquire(&test.spin_lock, 0));
+  CHECK(!try_spin_acquire(&test.spin_lock, 100));
+  spin_release(&test.spin_lock);
+}
+
+static constexpr u32 kQueueSize         = 16;
+static constexpr u32 kProducers         = 2;
+static constexpr u32 kConsumers         = 2;
+static constexpr u32 kItemsPerProducer  = 20000;
+
+// Bounded queue with one condition variable for each direction
+struct BoundedQueue
+{
+  Mutex   lock;
+  CondVar not_empty;
+  CondVar not_full;
+
+  u32     items[kQueueSize];
+  u32     head  = 0;
+  u32     count = 0;
+
+  u32     produced_done = 0;
+  u64     consumed_sum  = 0;
+  u32     consumed      = 0;
+};
+
+static BoundedQueue g_Queue;
+
+static u32
+producer_thread(void* param)
+{
+  u32 index = (u32)(uintptr_t)param;
+  for (u32 i = 0; i < kItemsPerProducer; i++)
+  {
+    mutex_acquire(&g_Queue.lock);
+    while (g_Queue.count == kQueueSize)
+    {
+      cond_var_wait(&g_Queue.not_full, &g_Queue.lock);
+    }
+    g_Queue.items[(g_Queue.head + g_Queue.count) % kQueueSize] = index * kItemsPerProducer + i + 1;
+    g_Queue.count++;
+    mutex_release(&g_Queue.lock);
+    cond_var_notify_one(&g_Queue.not_empty);
+  }
+
+  mutex_acquire(&g_Queue.lock);
+  g_Queue.produced_done++;
+  mutex_release(&g_Queue.lock);
+  cond_var_notify_all(&g_Queue.not_empty);
+
+  return 0;
+}
+
+static u32
+consumer_thread(void*)
+{
+  mutex_acquire(&g_Queue.lock);
+  for (;;)
+  {
+    while (g_Queue.count == 0 && g_Queue.produced_done < kProducers)
+    {
+      cond_var_wait(&g_Queue.not_empty, &g_Queue.lock);
+    }
+
+    if (g_Queue.count == 0)
+    {
+      break;
+    }
+
+    g_Queue.consumed_sum += g_Queue.items[g_Queue.head];
+    g_Queue.consumed++;
+    g_Queue.head = (g_Queue.head + 1) % kQueueSize;
+    g_Queue.count--;
+    cond_var_notify_one(&g_Queue.not_full);
+  }
+  mutex_release(&g_Queue.lock);
+
+  return 0;
+}
+
+static void
+test_cond_var_queue()
+{
+  Thread threads[kProducers + kConsumers];
+  for (u32 i = 0; i < kConsumers; i++)
+  {
+    threads[i] = init_test_thread(&consumer_thread, nullptr);
+  }
+  for (u32 i = 0; i < kProducers; i++)
+  {
+    threads[kConsumers + i] = init_test_thread(&producer_thread, (void*)(uintptr_t)i);
+  }
+
+  join_threads(threads, ARRAY_LENGTH(threads));
+  for (Thread& thread : threads)
+  {
+    destroy_thread(&thread);
+  }
+
+  static constexpr u64 kItemCount = kProducers * kItemsPerProducer;
+  CHECK(g_Queue.consumed == kItemCount);
+  CHECK(g_Queue.consumed_sum == kItemCount * (kItemCount + 1) / 2);
+}
+
+// Everything that takes a timeout has to give up after (about) that long
+static void
+test_timeouts()
+{
+  static constexpr u32 kTimeoutMs = 20;
+
+  Mutex   mutex;
+  CondVar cond_var;
+  mutex_acquire(&mutex);
+  u64 start = get_test_time_ms();
+  CHECK(!cond_var_wait(&cond_var, &mutex, kTimeoutMs));
+  CHECK(get_test_time_ms() - start >= kTimeoutMs - 1);
+  // Still has to be holding the mutex after a timeout
+  CHECK(!try_mutex_acquire(&mutex));
+  mutex_release(&mutex);
+
+  Event event = init_event(false);
+  start       = get_test_time_ms();
+  CHECK(!event_wait(&event, kTimeoutMs));
+  CHECK(get_test_time_ms() - start >= kTimeoutMs - 1);
+  CHECK(!event_wait(&event, 0));
+
+  u32 value   = 5;
+  u32 compare = 5;
+  start       = get_test_time_ms();
+  CHECK(!wait_on_address(&value, &compare, sizeof(value), kTimeoutMs));
+  CHECK(get_test_time_ms() - start >= kTimeoutMs - 1);
+
+  // Doesn't sleep at all when the value already changed
+  compare = 6;
+  CHECK(wait_on_address(&value, &compare, sizeof(value), 10000));
+
+  OsEvent os_event = init_os_event();
+  start            = get_test_time_ms();
+  CHECK(!os_event_wait(&os_event, kTimeoutMs));
+  CHECK(get_test_time_ms() - start >= kTimeoutMs - 1);
+
+  // Signals coalesce
+  os_event_signal(&os_event);
+  os_event_signal(&os_event);
+  CHECK(os_event_wait(&os_event, 0));
+  CHECK(!os_event_wait(&os_event, 0));
+  destroy_os_event(&os_event);
+}
+
+static Event g_Event;
+static u32   g_EventPassed = 0;
+
+static u32
+event_wait_thread(void*)
+{
+  if (event_wait(&g_Event, 2000))
+  {
+    atomic_ref_fetch_add(&g_EventPassed, 1U);
+  }
+  return 0;
+}
+
+static u32
+wait_for_event_waiters(u32 count)
+{
+  Thread threads[4];
+  for (u32 i = 0; i < count; i++)
+  {
+    threads[i] = init_test_thread(&event_wait_thread, nullptr);
+  }
+
+  join_threads(threads, count);
+  for (u32 i = 0; i < count; i++)
+  {
+    destroy_thread(&threads[i]);
+  }
+  return atomic_ref_exchange(&g_EventPassed, 0U);
+}
+
+static void
+test_events()
+{
+  // Auto reset: one waiter through per signal
+  g_Event = init_event(false, true);
+  CHECK(event_wait(&g_Event, 0));
+  CHECK(!event_wait(&g_Event, 0));
+
+  event_signal(&g_Event);
+  event_signal(&g_Event);
+  CHECK(event_wait(&g_Event, 0));
+  CHECK(!event_wait(&g_Event, 0));
+
+  // Manual reset: everyone through until it gets reset
+  g_Event = init_event(true);
+  event_signal(&g_Event);
+  CHECK(wait_for_event_waiters(4) == 4);
+  CHECK(event_wait(&g_Event, 0));
+
+  event_reset(&g_Event);
+  CHECK(!event_wait(&g_Event, 0));
+
+  // Auto reset with the waiters already asleep. Every one of them gets through eventually, but only one per signal.
+  g_Event = init_event(false);
+  Thread threads[3];
+  for (Thread& thread : threads)
+  {
+    thread = init_test_thread(&event_wait_thread, nullptr);
+  }
+  for (u32 i = 1; i <= ARRAY_LENGTH(threads); i++)
+  {
+    event_signal(&g_Event);
+    u64 deadline = get_test_time_ms() + 2000;
+    while (atomic_ref_load(&g_EventPassed) < i && get_test_time_ms() < deadline)
+    {
+      yield_current_thread();
+    }
+    CHECK(atomic_ref_load(&g_EventPassed) == i);
+  }
+  join_threads(threads, ARRAY_LENGTH(threads));
+  for (Thread& thread : threads)
+  {
+    destroy_thread(&thread);
+  }
+  g_EventPassed = 0;
+}
+
+template <typename T>
+struct AddressWaiter
+{
+  T   value    = 0;
+  u32 woken_at = 0;
+};
+
+template <typename T>
+static u32
+address_wait_thread(void* param)
+{
+  AddressWaiter<T>* waiter  = (AddressWaiter<T>*)param;
+  T                 compare = 0;
+  while (atomic_ref_load(&waiter->value) == compare)
+  {
+    wait_on_address(&waiter->value, &compare, sizeof(T));
+  }
+  atomic_ref_store(&waiter->woken_at, (u32)atomic_ref_load(&waiter->value));
+  return 0;
+}
+
+// A bunch of sleepers on neighbouring addresses (the same parking lot buckets, probably) that have to be woken one at a
+// time, and only by a wake on their own address.
+template <typename T>
+static void
+test_wait_on_address()
+{
+  static constexpr u32 kWaiters = 8;
+
+  static AddressWaiter<T> waiters[kWaiters];
+  Thread                  threads[kWaiters];
+  for (u32 i = 0; i < kWaiters; i++)
+  {
+    waiters[i] = AddressWaiter<T>();
+    threads[i] = init_test_thread(&address_wait_thread<T>, &waiters[i]);
+  }
+
+  for (u32 i = 0; i < kWaiters; i++)
+  {
+    AddressWaiter<T>* waiter = &waiters[kWaiters - i - 1];
+
+    // Waking an address with nobody changing the value is a spurious wakeup, nobody should get through
+    wake_all_on_address(&waiter->value);
+
+    atomic_ref_store(&waiter->value, (T)(i + 1));
+    wake_one_on_address(&waiter->value);
+
+    u64 deadline = get_test_time_ms() + 2000;
+    while (atomic_ref_load(&waiter->woken_at) == 0 && get_test_time_ms() < deadline)
+    {
+      yield_current_thread();
+    }
+    CHECK_MSG(waiter->woken_at == i + 1, "%u byte waiter %u never woke up", (u32)sizeof(T), kWaiters - i - 1);
+
+    for (u32 j = 0; j < kWaiters - i - 1; j++)
+    {
+      CHECK(atomic_ref_load(&waiters[j].woken_at) == 0);
+    }
+  }
+
+  join_threads(threads, kWaiters);
+  for (Thread& thread : threads)
+  {
+    destroy_thread(&thread);
+  }
+}
+
+static void
+test_cpu_set()
+{
+  CpuSet cpus;
+  CHECK(cpu_set_count(cpus) == 0);
+
+  cpu_set_add(&cpus, 0);
+  cpu_set_add(&cpus, 63);
+  cpu_set_add(&cpus, 64);
+  cpu_set_add(&cpus, 700);
+  cpu_set_add(&cpus, kMaxCpuCount - 1);
+  CHECK(cpu_set_count(cpus) == 5);
+  CHECK(cpu_set_contains(cpus, 64));
+  CHECK(cpu_set_contains(cpus, 700));
+  CHECK(!cpu_set_contains(cpus, 65));
+
+  cpu_set_remove(&cpus, 64);
+  CHECK(!cpu_set_contains(cpus, 64));
+  CHECK(cpu_set_contains(cpus, 63));
+  CHECK(cpu_set_count(cpus) == 4);
+
+  // The process' own cpus always work
+  CHECK(set_current_thread_affinity(get_test_cpus()));
+}
+
+int
+main()
+{
+  init_thread_context();
+
+  test_mutual_exclusion();
+  test_try_acquire();
+  test_cond_var_queue();
+  test_timeouts();
+  test_events();
+  test_wait_on_address<u8>();
+  test_wait_on_address<u16>();
+  test_wait_on_address<u32>();
+  test_wait_on_address<u64>();
+  test_cpu_set();
+
+  return finish_test("threading_test");
+}
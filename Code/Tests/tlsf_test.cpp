@@ -0,0 +1,203 @@
+#include "Tests/test.h"
+
+#include "Core/Foundation/memory.h"
+#include "Core/Foundation/tlsf_allocator.h"
+
+struct LiveAllocation
+{
+  SubAllocation allocation;
+  u32           size;
+  u32           alignment;
+};
+
+static int
+compare_offsets(const void* a, const void* b)
+{
+  u64 lhs = ((const LiveAllocation*)a)->allocation.offset;
+  u64 rhs = ((const LiveAllocation*)b)->allocation.offset;
+  return lhs < rhs ? -1 : lhs > rhs ? 1 : 0;
+}
+
+static void
+check_no_overlap(LiveAllocation* live, u32 live_count, u32 heap_size)
+{
+  qsort(live, live_count, sizeof(LiveAllocation), &compare_offsets);
+  for (u32 i = 0; i < live_count; i++)
+  {
+    CHECK(live[i].allocation.offset + live[i].size <= heap_size);
+    if (i > 0)
+    {
+      CHECK_MSG(live[i - 1].allocation.offset + live[i - 1].size <= live[i].allocation.offset,
+                "[%llu, +%u) overlaps [%llu, +%u)",
+                (unsigned long long)live[i - 1].allocation.offset, live[i - 1].size,
+                (unsigned long long)live[i].allocation.offset, live[i].size);
+    }
+  }
+}
+
+// Random alloc/free with random sizes and alignments, checking that every block is aligned, in bounds and doesn't overlap any other
+// block, and that everything coalesces back into one block at the end.
+static void
+test_sub_allocator_fuzz()
+{
+  static constexpr u32 kHeapSize   = 1U << 30;
+  static constexpr u32 kMaxAllocs  = 1U << 16;
+  static constexpr u32 kMaxLive    = 8000;
+  static constexpr u32 kIterations = 1000000;
+
+  TlsfSubAllocator allocator = init_tlsf_sub_allocator((AllocHeap)GLOBAL_HEAP, kHeapSize, kMaxAllocs);
+  CHECK(tlsf_sub_allocator_largest_free_block(allocator) == kHeapSize);
+
+  LiveAllocation* live       = (LiveAllocation*)malloc(sizeof(LiveAllocation) * kMaxLive);
+  u32             live_count = 0;
+  u32             failures   = 0;
+
+  TestRng rng;
+  for (u32 iteration = 0; iteration < kIterations; iteration++)
+  {
+    if (live_count < kMaxLive && (live_count == 0 || test_rng_range(&rng, 2) == 0))
+    {
+      // Mostly small, with the odd big one to exercise the top bins
+      u32 size      = 1 + test_rng_range(&rng, test_rng_range(&rng, 4) == 0 ? KiB(64) : 512);
+      u32 alignment = 1U << test_rng_range(&rng, 9);
+
+      Option<SubAllocation> allocation = try_tlsf_sub_alloc(&allocator, size, alignment);
+      if (!allocation)
+      {
+        failures++;
+        continue;
+      }
+
+      CHECK(allocation.value.offset % alignment == 0);
+      live[live_count++] = LiveAllocation{allocation.value, size, alignment};
+    }
+    else
+    {
+      u32 index = test_rng_range(&rng, live_count);
+      tlsf_sub_free(&allocator, live[index].allocation);
+      live[index] = live[--live_count];
+    }
+
+    if (iteration % 100000 == 0)
+    {
+      check_no_overlap(live, live_count, kHeapSize);
+    }
+  }
+
+  check_no_overlap(live, live_count, kHeapSize);
+  // Worst case every live block is 64 KiB with 256 bytes of alignment, which is half of the heap. Fragmentation and rounding up to
+  // the next bin can't make up the other half.
+  CHECK(failures == 0);
+
+  for (u32 i = 0; i < live_count; i++)
+  {
+    tlsf_sub_free(&allocator, live[i].allocation);
+  }
+
+  CHECK(allocator.used_size == 0);
+  CHECK(tlsf_sub_allocator_largest_free_block(allocator) == kHeapSize);
+
+  free(live);
+}
+
+// Running out of nodes or space returns None instead of asserting, and the allocator keeps working afterwards.
+static void
+test_sub_allocator_exhaustion()
+{
+  static constexpr u32 kHeapSize = KiB(64);
+
+  TlsfSubAllocator allocator = init_tlsf_sub_allocator((AllocHeap)GLOBAL_HEAP, kHeapSize, 64);
+
+  Option<SubAllocation> whole = try_tlsf_sub_alloc(&allocator, kHeapSize, 1);
+  REQUIRE(whole);
+  CHECK(whole.value.offset == 0);
+  CHECK(!try_tlsf_sub_alloc(&allocator, 1, 1));
+
+  tlsf_sub_free(&allocator, whole.value);
+  CHECK(allocator.used_size == 0);
+
+  SubAllocation blocks[16];
+  u32           block_count = 0;
+  for (;;)
+  {
+    Option<SubAllocation> block = try_tlsf_sub_alloc(&allocator, KiB(4), 1);
+    if (!block)
+    {
+      break;
+    }
+    REQUIRE(block_count < ARRAY_LENGTH(blocks));
+    blocks[block_count++] = block.value;
+  }
+  CHECK(block_count == 16);
+
+  // Free every other block, then free the rest and make sure they coalesce back
+  for (u32 i = 0; i < block_count; i += 2)
+  {
+    tlsf_sub_free(&allocator, blocks[i]);
+  }
+  CHECK(tlsf_sub_allocator_largest_free_block(allocator) == KiB(4));
+  for (u32 i = 1; i < block_count; i += 2)
+  {
+    tlsf_sub_free(&allocator, blocks[i]);
+  }
+  CHECK(tlsf_sub_allocator_largest_free_block(allocator) == kHeapSize);
+}
+
+// The CPU heap on top of it: every allocation is writable, aligned, and keeps its contents until it's freed.
+static void
+test_cpu_allocator()
+{
+  static constexpr u32 kAllocCount = 2000;
+
+  TlsfAllocator allocator = init_tlsf_allocator((AllocHeap)GLOBAL_HEAP, MiB(16), 4096);
+  FreeHeap      heap      = allocator;
+
+  u8** ptrs  = (u8**)malloc(sizeof(u8*) * kAllocCount);
+  u32* sizes = (u32*)malloc(sizeof(u32) * kAllocCount);
+
+  TestRng rng;
+  for (u32 i = 0; i < kAllocCount; i++)
+  {
+    u32 alignment = 1U << test_rng_range(&rng, 8);
+    sizes[i]      = 1 + test_rng_range(&rng, 2048);
+    ptrs[i]       = (u8*)HEAP_ALLOC_ALIGNED(heap, sizes[i], alignment);
+    REQUIRE(ptrs[i] != nullptr);
+    CHECK((uintptr_t)ptrs[i] % alignment == 0);
+    memset(ptrs[i], (u8)i, sizes[i]);
+  }
+
+  for (u32 i = 0; i < kAllocCount; i += 2)
+  {
+    HEAP_FREE(heap, ptrs[i]);
+    ptrs[i] = nullptr;
+  }
+
+  for (u32 i = 1; i < kAllocCount; i += 2)
+  {
+    for (u32 j = 0; j < sizes[i]; j++)
+    {
+      if (ptrs[i][j] != (u8)i)
+      {
+        CHECK_MSG(false, "allocation %u got stomped at byte %u", i, j);
+        break;
+      }
+    }
+    HEAP_FREE(heap, ptrs[i]);
+  }
+
+  CHECK(allocator.sub_allocator.used_size == 0);
+
+  free(ptrs);
+  free(sizes);
+  destroy_tlsf_allocator(&allocator);
+}
+
+int
+main()
+{
+  test_sub_allocator_fuzz();
+  test_sub_allocator_exhaustion();
+  test_cpu_allocator();
+
+  return finish_test("tlsf_test");
+}
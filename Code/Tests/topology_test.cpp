@@ -0,0 +1,305 @@
+#include "Tests/test.h"
+
+#include "Core/Foundation/context.h"
+#include "Core/Foundation/topology.h"
+
+#include <sys/stat.h>
+
+// Every test builds a fake sysfs tree under here, a new directory each
+static char g_SysfsRoot[256];
+static u32  g_SysfsTreeCount = 0;
+
+static const char*
+new_sysfs_tree()
+{
+  static char root[512];
+  snprintf(root, sizeof(root), "%s/tree%u", g_SysfsRoot, g_SysfsTreeCount++);
+  REQUIRE(mkdir(root, 0755) == 0);
+  return root;
+}
+
+// mkdir -p for everything leading up to the file, then writes contents to it
+static void
+write_sysfs_file(const char* root, const char* contents, const char* fmt, ...)
+{
+  char relative[256];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(relative, sizeof(relative), fmt, args);
+  va_end(args);
+
+  char path[512];
+  snprintf(path, sizeof(path), "%s/%s", root, relative);
+  for (char* c = path + strlen(root) + 1; *c != 0; c++)
+  {
+    if (*c == '/')
+    {
+      *c = 0;
+      mkdir(path, 0755);
+      *c = '/';
+    }
+  }
+
+  FILE* file = fopen(path, "w");
+  REQUIRE(file != nullptr);
+  fprintf(file, "%s\n", contents);
+  fclose(file);
+}
+
+// Per cpu topology for cpus [first, last]: the sibling list and package
+static void
+write_sysfs_cpus(const char* root, u32 first, u32 last, u32 smt_stride, u32 package)
+{
+  char siblings[64];
+  for (u32 cpu = first; cpu <= last; cpu++)
+  {
+    if (smt_stride == 0)
+    {
+      snprintf(siblings, sizeof(siblings), "%u", cpu);
+    }
+    else
+    {
+      u32 core = cpu % smt_stride;
+      snprintf(siblings, sizeof(siblings), "%u,%u", core, core + smt_stride);
+    }
+
+    char package_id[16];
+    snprintf(package_id, sizeof(package_id), "%u", package);
+    write_sysfs_file(root, siblings,   "system/cpu/cpu%u/topology/thread_siblings_list", cpu);
+    write_sysfs_file(root, package_id, "system/cpu/cpu%u/topology/physical_package_id",  cpu);
+  }
+}
+
+static CpuSet
+cpu_range(u32 first, u32 last)
+{
+  CpuSet ret;
+  for (u32 cpu = first; cpu <= last; cpu++)
+  {
+    cpu_set_add(&ret, cpu);
+  }
+  return ret;
+}
+
+static bool
+cpu_sets_equal(const CpuSet& a, const CpuSet& b)
+{
+  return memcmp(a.masks, b.masks, sizeof(a.masks)) == 0;
+}
+
+static const CpuCore*
+find_core(const CpuTopology& topology, u32 cpu)
+{
+  for (const CpuCore& core : topology.cores)
+  {
+    if (cpu_set_contains(core.cpus, cpu))
+    {
+      return &core;
+    }
+  }
+  return nullptr;
+}
+
+// 8 cores, 16 threads, cpu n and n + 8 are on the same core like on most Intel desktops
+static void
+test_smt()
+{
+  const char* root = new_sysfs_tree();
+  write_sysfs_file(root, "0-15", "system/cpu/online");
+  write_sysfs_file(root, "0",    "system/node/online");
+  write_sysfs_file(root, "0-15", "system/node/node0/cpulist");
+  write_sysfs_cpus(root, 0, 15, 8, 0);
+
+  CpuTopology topology = parse_sysfs_cpu_topology((AllocHeap)GLOBAL_HEAP, root, cpu_range(0, 15));
+  CHECK(topology.cpu_count == 16);
+  CHECK(topology.cores.size == 8);
+  CHECK(topology.package_count == 1);
+  CHECK(topology.numa_nodes.size == 1);
+  CHECK(topology.efficiency_class_count == 1);
+
+  for (u32 core = 0; core < 8; core++)
+  {
+    CpuSet expected;
+    cpu_set_add(&expected, core);
+    cpu_set_add(&expected, core + 8);
+    CHECK(cpu_sets_equal(topology.cores[core].cpus, expected));
+  }
+
+  // One worker per core that's left after the main thread takes the first one
+  ThreadPlacement placement = plan_thread_placement((AllocHeap)GLOBAL_HEAP, topology);
+  CHECK(cpu_sets_equal(placement.main_thread, topology.cores[0].cpus));
+  CHECK(placement.job_workers.size == 7);
+  CHECK(cpu_sets_equal(placement.job_workers[0], topology.cores[1].cpus));
+
+  ThreadPlacementDesc desc;
+  desc.job_workers_use_smt = true;
+  placement = plan_thread_placement((AllocHeap)GLOBAL_HEAP, topology, desc);
+  CHECK(placement.job_workers.size == 14);
+  CHECK(cpu_set_count(placement.job_workers[0]) == 1);
+
+  desc.max_job_workers = 3;
+  placement = plan_thread_placement((AllocHeap)GLOBAL_HEAP, topology, desc);
+  CHECK(placement.job_workers.size == 3);
+
+  // Only some of the cpus allowed, a core only has the siblings we can actually run on
+  CpuSet restricted;
+  cpu_set_add(&restricted, 2);
+  cpu_set_add(&restricted, 10);
+  cpu_set_add(&restricted, 3);
+  topology = parse_sysfs_cpu_topology((AllocHeap)GLOBAL_HEAP, root, restricted);
+  CHECK(topology.cpu_count == 3);
+  CHECK(topology.cores.size == 2);
+  CHECK(cpu_set_count(find_core(topology, 2)->cpus) == 2);
+  CHECK(cpu_set_count(find_core(topology, 3)->cpus) == 1);
+}
+
+// 2 sockets with 8 cores each and a NUMA node per socket, plus a node with only memory on it
+static void
+test_numa()
+{
+  const char* root = new_sysfs_tree();
+  write_sysfs_file(root, "0-15", "system/cpu/online");
+  write_sysfs_file(root, "0-2",  "system/node/online");
+  write_sysfs_file(root, "0-7",  "system/node/node0/cpulist");
+  write_sysfs_file(root, "8-15", "system/node/node1/cpulist");
+  write_sysfs_file(root, "",     "system/node/node2/cpulist");
+  write_sysfs_cpus(root, 0, 7,  0, 0);
+  write_sysfs_cpus(root, 8, 15, 0, 1);
+
+  CpuTopology topology = parse_sysfs_cpu_topology((AllocHeap)GLOBAL_HEAP, root, cpu_range(0, 15));
+  CHECK(topology.cores.size == 16);
+  CHECK(topology.package_count == 2);
+  REQUIRE(topology.numa_nodes.size == 2);
+  CHECK(topology.numa_nodes[1].os_index == 1);
+  CHECK(find_core(topology, 3)->numa_node == 0);
+  CHECK(find_core(topology, 9)->numa_node == 1);
+  CHECK(find_core(topology, 9)->package == 1);
+
+  // Workers fill up the main thread's node before going to the other one
+  ThreadPlacement placement = plan_thread_placement((AllocHeap)GLOBAL_HEAP, topology);
+  CHECK(placement.main_thread_numa_node == 0);
+  REQUIRE(placement.job_workers.size == 15);
+  for (u32 iworker = 0; iworker < placement.job_workers.size; iworker++)
+  {
+    CHECK(placement.job_worker_numa_nodes[iworker] == (iworker < 7 ? 0U : 1U));
+  }
+  CHECK(placement.streaming_thread_numa_node == 0);
+}
+
+// Intel hybrid: 6 P-cores with SMT and 8 E-cores
+static void
+test_intel_hybrid()
+{
+  const char* root = new_sysfs_tree();
+  write_sysfs_file(root, "0-19",  "system/cpu/online");
+  write_sysfs_file(root, "0-11",  "cpu_core/cpus");
+  write_sysfs_file(root, "12-19", "cpu_atom/cpus");
+  for (u32 cpu = 0; cpu < 12; cpu++)
+  {
+    char siblings[32];
+    snprintf(siblings, sizeof(siblings), "%u-%u", cpu & ~1U, (cpu & ~1U) + 1);
+    write_sysfs_file(root, siblings, "system/cpu/cpu%u/topology/thread_siblings_list", cpu);
+  }
+  write_sysfs_cpus(root, 12, 19, 0, 0);
+
+  CpuTopology topology = parse_sysfs_cpu_topology((AllocHeap)GLOBAL_HEAP, root, cpu_range(0, 19));
+  CHECK(topology.cores.size == 14);
+  CHECK(topology.efficiency_class_count == 2);
+  CHECK(find_core(topology, 4)->efficiency_class == 1);
+  CHECK(find_core(topology, 15)->efficiency_class == 0);
+
+  // Main thread and the first workers on P-cores, streaming on the E-cores
+  ThreadPlacement placement = plan_thread_placement((AllocHeap)GLOBAL_HEAP, topology);
+  CHECK(cpu_set_contains(placement.main_thread, 0));
+  REQUIRE(placement.job_workers.size == 13);
+  for (u32 iworker = 0; iworker < 5; iworker++)
+  {
+    CHECK(cpu_set_count(placement.job_workers[iworker]) == 2 && !cpu_set_contains(placement.job_workers[iworker], 12));
+  }
+  CHECK(cpu_sets_equal(placement.streaming_thread, cpu_range(12, 19)));
+}
+
+// ARM big.LITTLE with 3 kinds of cores, which only show up as cpu_capacity
+static void
+test_cpu_capacity()
+{
+  const char* root = new_sysfs_tree();
+  write_sysfs_file(root, "0-7", "system/cpu/online");
+  write_sysfs_cpus(root, 0, 7, 0, 0);
+  for (u32 cpu = 0; cpu < 8; cpu++)
+  {
+    write_sysfs_file(root, cpu < 4 ? "446" : cpu < 7 ? "871" : "1024", "system/cpu/cpu%u/cpu_capacity", cpu);
+  }
+
+  CpuTopology topology = parse_sysfs_cpu_topology((AllocHeap)GLOBAL_HEAP, root, cpu_range(0, 7));
+  CHECK(topology.efficiency_class_count == 3);
+  CHECK(find_core(topology, 0)->efficiency_class == 0);
+  CHECK(find_core(topology, 5)->efficiency_class == 1);
+  CHECK(find_core(topology, 7)->efficiency_class == 2);
+
+  ThreadPlacement placement = plan_thread_placement((AllocHeap)GLOBAL_HEAP, topology);
+  CHECK(cpu_set_contains(placement.main_thread, 7));
+  CHECK(cpu_sets_equal(placement.streaming_thread, cpu_range(0, 3)));
+  REQUIRE(placement.job_workers.size == 7);
+  CHECK(cpu_set_contains(placement.job_workers[0], 4));
+}
+
+// Nothing ever gets an empty set, even with just the one cpu
+static void
+test_single_cpu()
+{
+  const char* root = new_sysfs_tree();
+  write_sysfs_file(root, "0", "system/cpu/online");
+  write_sysfs_cpus(root, 0, 0, 0, 0);
+
+  CpuTopology topology = parse_sysfs_cpu_topology((AllocHeap)GLOBAL_HEAP, root, cpu_range(0, 0));
+  CHECK(topology.cores.size == 1);
+
+  ThreadPlacement placement = plan_thread_placement((AllocHeap)GLOBAL_HEAP, topology);
+  CHECK(cpu_sets_equal(placement.main_thread, cpu_range(0, 0)));
+  CHECK(cpu_sets_equal(placement.streaming_thread, cpu_range(0, 0)));
+  REQUIRE(placement.job_workers.size == 1);
+  CHECK(cpu_sets_equal(placement.job_workers[0], cpu_range(0, 0)));
+}
+
+// No sysfs at all (some containers), every allowed cpu is its own core
+static void
+test_missing_sysfs()
+{
+  char root[512];
+  snprintf(root, sizeof(root), "%s/does_not_exist", g_SysfsRoot);
+
+  CpuTopology topology = parse_sysfs_cpu_topology((AllocHeap)GLOBAL_HEAP, root, cpu_range(0, 3));
+  CHECK(topology.cpu_count == 4);
+  CHECK(topology.cores.size == 4);
+  CHECK(topology.numa_nodes.size == 1);
+  CHECK(topology.package_count == 1);
+  CHECK(topology.efficiency_class_count == 1);
+}
+
+int
+main()
+{
+  init_thread_context();
+
+  snprintf(g_SysfsRoot, sizeof(g_SysfsRoot), "/tmp/athena_topology_XXXXXX");
+  REQUIRE(mkdtemp(g_SysfsRoot) != nullptr);
+
+  test_smt();
+  test_numa();
+  test_intel_hybrid();
+  test_cpu_capacity();
+  test_single_cpu();
+  test_missing_sysfs();
+
+  // The real one has to work too, whatever it looks like
+  CpuTopology topology = query_cpu_topology((AllocHeap)GLOBAL_HEAP);
+  CHECK(topology.cores.size > 0);
+  CHECK(plan_thread_placement((AllocHeap)GLOBAL_HEAP, topology).job_workers.size > 0);
+
+  char command[512];
+  snprintf(command, sizeof(command), "rm -rf %s", g_SysfsRoot);
+  CHECK(system(command) == 0);
+
+  return finish_test("topology_test");
+}
@@ -0,0 +1,228 @@
+#include "Tests/test.h"
+
+#include "Core/Foundation/context.h"
+#include "Core/Foundation/slab_allocator.h"
+#include "Core/Foundation/tracking_heap.h"
+
+static SlabAllocator g_Slab;
+
+// Every allocation in here comes from the same call site
+static NO_INLINE void
+alloc_blocks(TrackingHeap* heap, u8** blocks, const u32* sizes, u32 count)
+{
+  ReallocFreeHeap tracked = *heap;
+  for (u32 i = 0; i < count; i++)
+  {
+    blocks[i] = (u8*)tracked.alloc_fn(tracked.allocator, sizes[i], 16);
+  }
+}
+
+static void
+test_tracking_sequence()
+{
+  TrackingHeap    heap    = init_tracking_heap((ReallocFreeHeap)g_Slab, GLOBAL_HEAP);
+  ReallocFreeHeap tracked = heap;
+
+  static constexpr u32 kSizes[] = {100, 200, 300};
+  u8* blocks[ARRAY_LENGTH(kSizes)];
+  alloc_blocks(&heap, blocks, kSizes, ARRAY_LENGTH(kSizes));
+
+  TrackingStats stats = tracking_heap_get_stats(&heap);
+  CHECK(stats.alloc_count == 3);
+  CHECK(stats.live_count  == 3);
+  CHECK(stats.live_bytes  == 600);
+  CHECK(stats.total_bytes == 600);
+
+  Option<TrackingLiveAllocation> live = tracking_heap_get_live_allocation(&heap, blocks[1]);
+  REQUIRE(live);
+  CHECK(live.value.size == 200);
+  CHECK(live.value.epoch == 0);
+
+  uintptr_t                call_site_address = live.value.call_site;
+  Option<TrackingCallSite> call_site         = tracking_heap_get_call_site(&heap, call_site_address);
+  REQUIRE(call_site);
+  CHECK(call_site.value.alloc_count == 3);
+  CHECK(call_site.value.live_bytes  == 600);
+
+  // Freed in the epoch it was made in
+  HEAP_FREE(tracked, blocks[0]);
+
+  // Lived for 2 epochs, so bucket 2: [2, 4)
+  tracking_heap_advance_epoch(&heap);
+  tracking_heap_advance_epoch(&heap);
+  HEAP_FREE(tracked, blocks[1]);
+
+  // Shows up as a free of the old block and an alloc of the new one at the realloc's call site
+  blocks[2] = (u8*)tracked.realloc_fn(tracked.allocator, blocks[2], 5000, 16);
+
+  stats = tracking_heap_get_stats(&heap);
+  CHECK(stats.alloc_count           == 4);
+  CHECK(stats.free_count            == 3);
+  CHECK(stats.live_count            == 1);
+  CHECK(stats.live_bytes            == 5000);
+  CHECK(stats.peak_live_bytes       == 5000);
+  CHECK(stats.lifetime_histogram[0] == 1);
+  CHECK(stats.lifetime_histogram[2] == 2);
+
+  live = tracking_heap_get_live_allocation(&heap, blocks[2]);
+  REQUIRE(live);
+  CHECK(live.value.size      == 5000);
+  CHECK(live.value.epoch     == 2);
+  CHECK(live.value.call_site != call_site_address);
+
+  call_site = tracking_heap_get_call_site(&heap, call_site_address);
+  REQUIRE(call_site);
+  CHECK(call_site.value.free_count      == 3);
+  CHECK(call_site.value.live_count      == 0);
+  CHECK(call_site.value.peak_live_bytes == 600);
+
+  // Something the tracking heap never saw get allocated
+  void* untracked = slab_alloc(&g_Slab, 64, 16);
+  HEAP_FREE(tracked, untracked);
+  CHECK(tracking_heap_get_stats(&heap).unknown_frees == 1);
+
+  Span<char> report = tracking_heap_build_report(&heap, (AllocHeap)GLOBAL_HEAP, kTrackingReportJson);
+  CHECK(report.size > 0 && report[report.size - 1] != 0 && report.memory[report.size] == 0);
+  CHECK(strstr(report.memory, "\"unknown_frees\": 1") != nullptr);
+
+  HEAP_FREE(tracked, blocks[2]);
+  destroy_tracking_heap(&heap);
+}
+
+// A reset counts everything that's still live as freed, and an address handed out again after the reset is a new allocation
+static void
+test_tracking_reset()
+{
+  static u8       memory[KiB(64)];
+  LinearAllocator linear = init_linear_allocator(memory, sizeof(memory));
+  TrackingHeap    heap   = init_tracking_heap((AllocHeap)linear, GLOBAL_HEAP);
+
+  for (u32 frame = 0; frame < 3; frame++)
+  {
+    for (u32 i = 0; i < 10; i++)
+    {
+      (void)HEAP_ALLOC(u8, (AllocHeap)heap, 128);
+    }
+
+    TrackingStats stats = tracking_heap_get_stats(&heap);
+    CHECK(stats.live_count == 10);
+    CHECK(stats.live_bytes == 1280);
+
+    reset_linear_allocator(&linear);
+    tracking_heap_reset(&heap);
+    tracking_heap_advance_epoch(&heap);
+  }
+
+  TrackingStats stats = tracking_heap_get_stats(&heap);
+  CHECK(stats.alloc_count     == 30);
+  CHECK(stats.free_count      == 30);
+  CHECK(stats.live_count      == 0);
+  CHECK(stats.peak_live_bytes == 1280);
+  CHECK(stats.unknown_frees   == 0);
+
+  destroy_tracking_heap(&heap);
+}
+
+static constexpr u32 kStressThreads         = 4;
+static constexpr u32 kStressAllocsPerThread = 20000;
+
+struct TrackingStressThread
+{
+  TrackingHeap* heap;
+  u32           index;
+  // Allocated by this thread, freed by the next one over
+  u8**          blocks;
+  u32           done;
+};
+
+static TrackingStressThread g_StressThreads[kStressThreads];
+
+static u32
+tracking_stress_thread(void* param)
+{
+  TrackingStressThread* self = (TrackingStressThread*)param;
+  FreeHeap              heap = *self->heap;
+
+  TestRng rng;
+  rng.state += self->index;
+  for (u32 i = 0; i < kStressAllocsPerThread; i++)
+  {
+    self->blocks[i] = HEAP_ALLOC(u8, (AllocHeap)heap, 1 + test_rng_range(&rng, 256));
+  }
+  atomic_ref_store(&self->done, 1U, std::memory_order_release);
+
+  // Cross thread frees, which can race with the address getting handed right back out on another thread
+  TrackingStressThread* prev = &g_StressThreads[(self->index + kStressThreads - 1) % kStressThreads];
+  while (atomic_ref_load(&prev->done, std::memory_order_acquire) == 0)
+  {
+    yield_current_thread();
+  }
+
+  for (u32 i = 0; i < kStressAllocsPerThread; i++)
+  {
+    HEAP_FREE(heap, prev->blocks[i]);
+    if (i % 2 == 0)
+    {
+      prev->blocks[i] = HEAP_ALLOC(u8, (AllocHeap)heap, 64);
+      HEAP_FREE(heap, prev->blocks[i]);
+    }
+  }
+
+  return 0;
+}
+
+static void
+test_tracking_threads()
+{
+  TrackingHeap heap = init_tracking_heap((ReallocFreeHeap)g_Slab, GLOBAL_HEAP);
+
+  Thread threads[kStressThreads];
+  for (u32 ithread = 0; ithread < kStressThreads; ithread++)
+  {
+    g_StressThreads[ithread].heap   = &heap;
+    g_StressThreads[ithread].index  = ithread;
+    g_StressThreads[ithread].blocks = (u8**)malloc(sizeof(u8*) * kStressAllocsPerThread);
+    g_StressThreads[ithread].done   = 0;
+  }
+
+  for (u32 ithread = 0; ithread < kStressThreads; ithread++)
+  {
+    threads[ithread] = init_test_thread(&tracking_stress_thread, &g_StressThreads[ithread]);
+  }
+
+  join_threads(threads, kStressThreads);
+  for (u32 ithread = 0; ithread < kStressThreads; ithread++)
+  {
+    destroy_thread(&threads[ithread]);
+    free(g_StressThreads[ithread].blocks);
+  }
+
+  static constexpr u64 kAllocCount = kStressThreads * (kStressAllocsPerThread + kStressAllocsPerThread / 2);
+
+  TrackingStats stats = tracking_heap_get_stats(&heap);
+  CHECK(stats.alloc_count   == kAllocCount);
+  CHECK(stats.free_count    == kAllocCount);
+  CHECK(stats.live_count    == 0);
+  CHECK(stats.live_bytes    == 0);
+  CHECK(stats.unknown_frees == 0);
+
+  destroy_tracking_heap(&heap);
+}
+
+int
+main()
+{
+  init_thread_context();
+
+  static u8 init_memory[MiB(8)];
+  LinearAllocator init_allocator = init_linear_allocator(init_memory, sizeof(init_memory));
+  g_Slab = init_slab_allocator(init_allocator, GiB(1));
+
+  test_tracking_sequence();
+  test_tracking_reset();
+  test_tracking_threads();
+
+  destroy_slab_allocator(&g_Slab);
+
+  return finish_test("tracking_heap_test");
+}
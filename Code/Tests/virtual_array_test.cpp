@@ -0,0 +1,148 @@
+#include "Tests/test.h"
+
+#include "Core/Foundation/context.h"
+#include "Core/Foundation/Containers/virtual_array.h"
+
+#include <unistd.h>
+
+// Resident set size, which is the only way to tell whether pages really got committed/decommitted
+static size_t
+get_resident_size()
+{
+  long  pages    = 0;
+  long  resident = 0;
+  FILE* statm    = fopen("/proc/self/statm", "r");
+  REQUIRE(statm != nullptr);
+  REQUIRE(fscanf(statm, "%ld %ld", &pages, &resident) == 2);
+  fclose(statm);
+
+  return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+static void
+test_page_primitives()
+{
+  u8* pages = (u8*)reserve_commit_pages(KiB(12));
+  REQUIRE(pages != nullptr);
+  CHECK((uintptr_t)pages % kPageSize == 0);
+
+  bool zeroed = true;
+  for (u32 i = 0; i < KiB(12); i++)
+  {
+    zeroed = zeroed && pages[i] == 0;
+  }
+  CHECK(zeroed);
+  pages[KiB(12) - 1] = 1;
+  free_pages(pages);
+
+  // Decommitting throws the page's contents away, the page after it keeps its own
+  u8* reserved = (u8*)reserve_pages(MiB(1));
+  REQUIRE(reserved != nullptr);
+  commit_pages(kPageSize * 2, reserved + kPageSize);
+  reserved[kPageSize]         = 5;
+  reserved[kPageSize * 3 - 1] = 6;
+
+  decommit_pages(kPageSize, reserved + kPageSize);
+  commit_pages(kPageSize, reserved + kPageSize);
+  CHECK(reserved[kPageSize] == 0);
+  CHECK(reserved[kPageSize * 3 - 1] == 6);
+  free_pages(reserved);
+
+  // Reserving at a fixed address only works when nothing else is there
+  u8* fixed = (u8*)reserve_pages(MiB(1));
+  free_pages(fixed);
+
+  u8* again = (u8*)reserve_pages(MiB(1), fixed);
+  CHECK(again == fixed);
+  CHECK(reserve_pages(MiB(1), fixed) == nullptr);
+  free_pages(again);
+}
+
+// Scratch arenas commit as they grow and give the pages back once they're freed
+static void
+test_scratch_arena_commit()
+{
+  size_t before = get_resident_size();
+
+  ScratchAllocator scratch_arena = alloc_scratch_arena();
+  u8*              memory        = HEAP_ALLOC(u8, (AllocHeap)scratch_arena, MiB(64));
+  memset(memory, 1, MiB(64));
+  CHECK(get_resident_size() > before + MiB(60));
+
+  free_scratch_arena(&scratch_arena);
+  CHECK(get_resident_size() < before + MiB(4));
+}
+
+struct BigElement
+{
+  u64 values[8];
+};
+
+static void
+test_virtual_array()
+{
+  static constexpr u64 kCount = 5000000;
+
+  VirtualArray<u64> arr   = init_virtual_array<u64>(100000000);
+  u64*              first = virtual_array_add(&arr);
+  *first = 42;
+  for (u64 i = 1; i < kCount; i++)
+  {
+    *virtual_array_add(&arr) = i;
+  }
+
+  // Growing never moves anything
+  CHECK(first == &arr[0]);
+  CHECK(*first == 42);
+  CHECK(arr[kCount - 1] == kCount - 1);
+
+  u64* range = virtual_array_add(&arr, 1000);
+  CHECK(range == &arr[kCount]);
+  CHECK(range[999] == 0);
+
+  u64 sum = 0;
+  for (u64 value : arr)
+  {
+    sum += value;
+  }
+  CHECK(sum == 42 + (kCount - 1) * kCount / 2);
+
+  virtual_array_remove(&arr, 0);
+  CHECK(arr[0] == 0);
+  CHECK(arr.size == kCount + 999);
+
+  size_t before = get_resident_size();
+  arr.size      = 1000;
+  virtual_array_trim(&arr);
+  CHECK(arr.commit_size == ALIGN_POW2(sizeof(u64) * 1000, (size_t)kPageSize));
+  CHECK(get_resident_size() + MiB(30) < before);
+
+  clear_virtual_array(&arr);
+  for (u64 i = 0; i < 10; i++)
+  {
+    *virtual_array_add(&arr) = i;
+  }
+  CHECK(arr[9] == 9);
+  destroy_virtual_array(&arr);
+
+  // Filling up to exactly the max capacity
+  VirtualArray<BigElement> exact = init_virtual_array<BigElement>(64, 64);
+  for (u64 i = 0; i < 64; i++)
+  {
+    virtual_array_add(&exact)->values[7] = i;
+  }
+  CHECK(exact[63].values[7] == 63);
+  destroy_virtual_array(&exact);
+}
+
+int
+main()
+{
+  init_thread_context();
+
+  test_page_primitives();
+  test_scratch_arena_commit();
+  test_virtual_array();
+
+  return finish_test("virtual_array_test");
+}